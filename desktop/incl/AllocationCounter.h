@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts heap allocations so the frame loop can be checked for staying off the heap
+// once it has warmed up. Counting needs a build with OBS_COUNT_ALLOCATIONS (the CMake
+// option of the same name), which replaces the global operator new/delete; otherwise
+// enabled() is false and count() stays 0. Only operator new is seen, not malloc or
+// OS allocations; BufferPool::stats() covers the pool's own.
+namespace AllocationCounter
+{
+    bool enabled();
+    uint64_t count(); // operator new calls so far, all threads
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Action Message Format 0, the encoding of RTMP commands and FLV script data. Only
+// what those use: numbers, booleans, strings, null and flat objects. Big endian.
+namespace Amf0
+{
+    enum Marker : uint8_t
+    {
+        Number = 0x00,
+        Boolean = 0x01,
+        String = 0x02,
+        Object = 0x03,
+        Null = 0x05,
+        Undefined = 0x06,
+        EcmaArray = 0x08,
+        ObjectEnd = 0x09,
+        StrictArray = 0x0A,
+        Date = 0x0B,
+        LongString = 0x0C,
+    };
+
+    void writeNumber(std::vector<uint8_t>& out, double value);
+    void writeBoolean(std::vector<uint8_t>& out, bool value);
+    void writeString(std::vector<uint8_t>& out, const std::string& value);
+    void writeNull(std::vector<uint8_t>& out);
+
+    // An object is beginObject(), then writeKey() and a value per property, then
+    // endObject(). An ECMA array is the same with its property count up front.
+    void beginObject(std::vector<uint8_t>& out);
+    void beginEcmaArray(std::vector<uint8_t>& out, uint32_t count);
+    void writeKey(std::vector<uint8_t>& out, const char* key);
+    void endObject(std::vector<uint8_t>& out);
+}
+
+// Walks the values of a command or script body in order. Every read fails, and leaves
+// the reader failed, on a marker it didn't expect or a value cut short.
+class Amf0Reader
+{
+public:
+    Amf0Reader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+    bool atEnd() const { return m_at >= m_size; }
+    bool failed() const { return m_failed; }
+    int peekMarker() const { return atEnd() ? -1 : m_data[m_at]; }
+
+    bool readNumber(double& value);
+    bool readString(std::string& value);
+    bool skip(); // any one value, nested objects included
+
+    // An object or ECMA array: the string and number properties it holds, by key.
+    // Properties of other types are skipped; null or undefined reads as no properties.
+    bool readObject(std::vector<std::pair<std::string, std::string>>& strings,
+        std::vector<std::pair<std::string, double>>* numbers = nullptr);
+
+private:
+    bool take(size_t bytes, const uint8_t*& at);
+    bool readUtf8(size_t lengthBytes, std::string& value);
+
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_at = 0;
+    int m_depth = 0; // objects being read, bounded
+    bool m_failed = false;
+};
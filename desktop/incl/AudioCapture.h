@@ -4,27 +4,65 @@
 #include <audioclient.h>
 #include <audiopolicy.h>
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "LoudnessMeter.h"
+#include "AudioFilterChain.h"
+#include "SampleConverter.h"
+#include "SpectrumAnalyzer.h"
+#include "FlacRecorder.h"
+#include "ThreadPool.h"
+#include "RealtimeLane.h"
+#include "Metrics.h"
+#include "DeviceRecovery.h"
 
 class AudioCapture {
 public: 
 	AudioCapture();
 	~AudioCapture();
 
+	// Each may run on its own thread, concurrently with the other; start capture once both returned
 	bool initializeInput(); // For microphone
 	bool initializeOutput(); // For system audio
 	void startCapture();
 	void stopCapture();
 
+	// Loudest packet since the previous call, -100 if none arrived. Capture itself runs
+	// on the audio lane, so these only read what it left behind.
 	float getOutputVolume();
 	float getInputVolume();
 	float getCurrentVolume(); // Returns volums in dbFS
 
+	// EBU R128 loudness, updated as the audio lane drains the devices
+	LoudnessMeter::Snapshot getInputLoudness() const;
+	LoudnessMeter::Snapshot getOutputLoudness() const;
+
+	// Desktop audio spectrum for visualization, analyzed on its own thread
+	SpectrumAnalyzer& getOutputSpectrum() { return m_outputSpectrum; }
+
+	// Lossless recording: mic (after its filters) and desktop audio to separate FLAC files
+	bool startRecording(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath, int bitsPerSample = 16);
+	void stopRecording();
+	bool isRecording() const { return m_inputRecorder.isRecording() || m_outputRecorder.isRecording(); }
+
+	// Mic processing: gate -> EQ -> compressor -> limiter, all bypassed until enabled
+	AudioFilterChain& getInputFilters() { return m_inputFilters; }
+	NoiseGate* getInputGate() { return m_inputGate; }
+	ParametricEq* getInputEq() { return m_inputEq; }
+	Compressor* getInputCompressor() { return m_inputCompressor; }
+	Limiter* getInputLimiter() { return m_inputLimiter; }
+
 	HANDLE m_hInputEvent = nullptr;
 
 private:
 	// device interfaces
 	IMMDeviceEnumerator* m_pEnumerator = nullptr;
+	std::once_flag m_enumeratorOnce;
+	CO_MTA_USAGE_COOKIE m_mtaCookie = nullptr;
 	IMMDevice* m_pInputDevice = nullptr;
 	IMMDevice* m_pOutputDevice = nullptr;
 	IAudioClient* m_pInputAudioClient = nullptr;
@@ -35,7 +73,23 @@ private:
 	WAVEFORMATEX* m_pwfxInput = nullptr;
 	WAVEFORMATEX* m_pwfxOutput = nullptr;
 
-	float calculateRMSVolume(BYTE* pData, UINT32 numFramesAvailable, WAVEFORMATEX* pwfx);
+	bool createEnumerator();
+	void releaseInput();
+	void releaseOutput();
+
+	// Device loss: the lane feeds the recorder silence until the reinit brings the device back
+	struct Silence {
+		int sampleRate = 0; // the lost device's format
+		int channels = 0;
+	};
+	static constexpr int kSilenceBlockFrames = 480; // fallback silence goes to the recorder in blocks this long
+	bool resumeOrHold(DeviceRecovery& recovery, const Silence& silence, FlacRecorder& recorder); // false while lost
+	void reportLost(DeviceRecovery& recovery, Silence& silence, const WAVEFORMATEX* pwfx, bool input, HRESULT hr);
+
+	// Decodes the mix format into m_samples as interleaved float, returns the frames converted
+	static bool configureConverter(SampleConverter& converter, const WAVEFORMATEX* pwfx);
+	UINT32 convertToFloat(BYTE* pData, UINT32 numFramesAvailable, SampleConverter& converter);
+	float calculateRMSVolume(const float* samples, size_t count);
 	float convertToDecibels(float rmsValue);
 
 	// Method to safely get audio buffer
@@ -46,5 +100,48 @@ private:
 		UINT32* pNumFramesAvailable
 	);
 
+	// Audio lane: drains both devices every few ms on its own raised-priority thread
+	void drainAudio();
+	float drainInput();
+	float drainOutput();
+	static void raiseLevel(std::atomic<float>& level, float db);
+	void collectMetrics(MetricsWriter& writer) const;
+
 	bool m_isCapturing = false;
+	RealtimeLane m_audioLane;
+	std::atomic<float> m_inputLevel{ -100.0f };
+	std::atomic<float> m_outputLevel{ -100.0f };
+	mutable std::mutex m_loudnessMutex;
+	LoudnessMeter::Snapshot m_inputLoudnessSnapshot;
+	LoudnessMeter::Snapshot m_outputLoudnessSnapshot;
+
+	std::vector<float> m_samples; // audio lane only
+	std::vector<float> m_silenceBlock; // zeros, sized in the constructor so the lane never allocates them
+	SampleConverter m_inputConverter;
+	SampleConverter m_outputConverter;
+	LoudnessMeter m_inputLoudness;
+	LoudnessMeter m_outputLoudness;
+	SpectrumAnalyzer m_outputSpectrum;
+
+	std::unique_ptr<ThreadPool> m_encodePool; // created on the first recording
+	FlacRecorder m_inputRecorder;
+	FlacRecorder m_outputRecorder;
+
+	AudioFilterChain m_inputFilters;
+	NoiseGate* m_inputGate = nullptr;
+	ParametricEq* m_inputEq = nullptr;
+	Compressor* m_inputCompressor = nullptr;
+	Limiter* m_inputLimiter = nullptr;
+
+	DeviceRecovery m_inputRecovery{ DeviceRecovery::Settings{ "mic", 100, 2000 } };
+	DeviceRecovery m_outputRecovery{ DeviceRecovery::Settings{ "desktop audio", 100, 2000 } };
+	Silence m_inputSilence;
+	Silence m_outputSilence;
+
+	// Health counters for the metrics endpoint, written by the audio lane
+	std::atomic<uint64_t> m_inputFrames{ 0 };
+	std::atomic<uint64_t> m_outputFrames{ 0 };
+	std::atomic<uint64_t> m_inputDiscontinuities{ 0 };
+	std::atomic<uint64_t> m_outputDiscontinuities{ 0 };
+	MetricsRegistration m_metrics; // last, so it is removed before anything it reads
 };
\ No newline at end of file
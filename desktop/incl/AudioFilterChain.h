@@ -0,0 +1,56 @@
+#pragma once
+
+#include "AudioFilters.h"
+#include <memory>
+#include <vector>
+
+// Per-source audio processing. Interleaved float input is cut into fixed-size blocks,
+// repacked into the padded layout the filters use, run through every enabled filter
+// and written back in place:
+//
+//     AudioFilterChain chain;
+//     auto* gate = chain.addFilter(std::make_unique<NoiseGate>());
+//     chain.configure(48000, 2, 480);          // 10 ms blocks
+//     ...
+//     chain.process(samples, frames);          // audio thread
+//     gate->setOpenThreshold(-30.0f);          // any thread
+//
+// Filters are added and the chain configured before audio starts; process() itself
+// never allocates or locks.
+class AudioFilterChain
+{
+public:
+    static constexpr int kMaxChannels = 8;
+
+    template <typename F>
+    F* addFilter(std::unique_ptr<F> filter)
+    {
+        F* raw = filter.get();
+        m_filters.push_back({ std::move(filter), false });
+        return raw;
+    }
+
+    bool configure(int sampleRate, int channels, int blockFrames);
+    void reset();
+
+    void process(float* interleaved, int frames);
+
+    int filterCount() const { return static_cast<int>(m_filters.size()); }
+    AudioFilter* filter(int index) { return m_filters[index].filter.get(); }
+
+    bool isConfigured() const { return m_channels > 0; }
+    int blockFrames() const { return m_blockFrames; }
+
+private:
+    struct Entry
+    {
+        std::unique_ptr<AudioFilter> filter;
+        bool wasEnabled = false; // state is reset when a filter is switched back on
+    };
+
+    std::vector<Entry> m_filters;
+    std::vector<float> m_block;
+    int m_channels = 0;
+    int m_groups = 0;
+    int m_blockFrames = 0;
+};
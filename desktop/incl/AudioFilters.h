@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+// Audio filters for AudioFilterChain. They work on blocks laid out frame by frame with
+// the channels padded to groups of kLanes, so one SIMD vector holds the same instant
+// of up to four channels:
+//
+//     frame 0: [L R - -] frame 1: [L R - -] ...        (stereo: 1 group)
+//     frame 0: [L R C LFE] [Ls Rs - -] ...             (5.1: 2 groups)
+//
+// Parameter setters may be called from any thread. They only store atomics; the
+// audio thread picks them up at the next block and glides towards them, so nothing
+// on the audio path locks or allocates.
+class AudioFilter
+{
+public:
+    static constexpr int kLanes = 4;
+
+    virtual ~AudioFilter() = default;
+
+    // Called before processing starts (allocation happens here only)
+    virtual void configure(int sampleRate, int groups, int maxFrames) = 0;
+    virtual void reset() = 0;
+    virtual void process(float* block, int frames) = 0;
+
+    void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<bool> m_enabled{ true };
+};
+
+// Mutes the signal while it stays below a threshold, with hysteresis and hold
+class NoiseGate : public AudioFilter
+{
+public:
+    void setOpenThreshold(float db) { m_openDb.store(db); }
+    void setCloseThreshold(float db) { m_closeDb.store(db); }
+    void setAttack(float ms) { m_attackMs.store(ms); }
+    void setHold(float ms) { m_holdMs.store(ms); }
+    void setRelease(float ms) { m_releaseMs.store(ms); }
+
+    void configure(int sampleRate, int groups, int maxFrames) override;
+    void reset() override;
+    void process(float* block, int frames) override;
+
+private:
+    std::atomic<float> m_openDb{ -26.0f };
+    std::atomic<float> m_closeDb{ -32.0f };
+    std::atomic<float> m_attackMs{ 5.0f };
+    std::atomic<float> m_holdMs{ 150.0f };
+    std::atomic<float> m_releaseMs{ 100.0f };
+
+    int m_sampleRate = 48000;
+    int m_groups = 1;
+    float m_envelope = 0.0f;
+    float m_gain = 0.0f;
+    int m_holdLeft = 0;
+    bool m_open = false;
+};
+
+// Feed-forward peak compressor with a soft knee, channels linked
+class Compressor : public AudioFilter
+{
+public:
+    void setThreshold(float db) { m_thresholdDb.store(db); }
+    void setRatio(float ratio) { m_ratio.store(ratio); }
+    void setKnee(float db) { m_kneeDb.store(db); }
+    void setAttack(float ms) { m_attackMs.store(ms); }
+    void setRelease(float ms) { m_releaseMs.store(ms); }
+    void setMakeupGain(float db) { m_makeupDb.store(db); }
+
+    void configure(int sampleRate, int groups, int maxFrames) override;
+    void reset() override;
+    void process(float* block, int frames) override;
+
+private:
+    std::atomic<float> m_thresholdDb{ -18.0f };
+    std::atomic<float> m_ratio{ 4.0f };
+    std::atomic<float> m_kneeDb{ 6.0f };
+    std::atomic<float> m_attackMs{ 6.0f };
+    std::atomic<float> m_releaseMs{ 60.0f };
+    std::atomic<float> m_makeupDb{ 0.0f };
+
+    int m_sampleRate = 48000;
+    int m_groups = 1;
+    float m_envelope = 0.0f;
+    // Smoothed copies of the parameters
+    float m_threshold = -18.0f;
+    float m_ratioValue = 4.0f;
+    float m_knee = 6.0f;
+    float m_makeup = 1.0f;
+};
+
+// Brick-wall peak limiter. The signal is delayed by the lookahead so the gain is
+// already down when a peak arrives: gain = moving average over the lookahead of the
+// sliding-window minimum of the required gain, which never lets a peak through.
+class Limiter : public AudioFilter
+{
+public:
+    void setCeiling(float db) { m_ceilingDb.store(db); }
+    void setRelease(float ms) { m_releaseMs.store(ms); }
+    void setLookahead(float ms) { m_lookaheadMs = ms; } // takes effect at configure()
+
+    int latencyFrames() const { return m_window - 1; }
+
+    void configure(int sampleRate, int groups, int maxFrames) override;
+    void reset() override;
+    void process(float* block, int frames) override;
+
+private:
+    std::atomic<float> m_ceilingDb{ -1.0f };
+    std::atomic<float> m_releaseMs{ 50.0f };
+    float m_lookaheadMs = 5.0f;
+
+    int m_sampleRate = 48000;
+    int m_groups = 1;
+    int m_window = 1;
+    float m_ceiling = 0.0f;
+
+    std::vector<float> m_delay;        // window frames of padded audio
+    std::vector<float> m_minValue;     // monotonic queue for the sliding minimum
+    std::vector<long long> m_minTime;
+    std::vector<float> m_average;      // last window smoothed gains
+    long long m_time = 0;
+    int m_minHead = 0;
+    int m_minCount = 0;
+    int m_position = 0;
+    double m_averageSum = 0.0;
+    float m_released = 1.0f;
+};
+
+// Cascade of RBJ biquads, the same coefficients on every channel
+class ParametricEq : public AudioFilter
+{
+public:
+    static constexpr int kMaxBands = 8;
+
+    enum class BandType { Peak, LowShelf, HighShelf, LowPass, HighPass };
+
+    void setBand(int band, BandType type, float frequency, float gainDb, float q);
+    void setBandEnabled(int band, bool enabled);
+
+    void configure(int sampleRate, int groups, int maxFrames) override;
+    void reset() override;
+    void process(float* block, int frames) override;
+
+private:
+    struct Target
+    {
+        std::atomic<int> type{ 0 };
+        std::atomic<float> frequency{ 1000.0f };
+        std::atomic<float> gainDb{ 0.0f };
+        std::atomic<float> q{ 0.707f };
+        std::atomic<bool> enabled{ false };
+    };
+
+    struct Band
+    {
+        int type = -1;
+        float frequency = 1000.0f;
+        float gainDb = 0.0f;
+        float q = 0.707f;
+        float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+        float state[2][2][kLanes] = {}; // [group][s1/s2][lane]
+    };
+
+    void updateCoefficients(Band& band) const;
+
+    Target m_targets[kMaxBands];
+    Band m_bands[kMaxBands];
+    int m_sampleRate = 48000;
+    int m_groups = 1;
+    float m_smoothing = 1.0f;
+};
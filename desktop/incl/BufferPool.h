@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class BufferPool;
+
+// Block of memory on loan from a BufferPool; goes back to the pool when destroyed or
+// reset. Move-only. The capacity is the whole size class, at least what was asked for.
+class PooledBuffer
+{
+public:
+    PooledBuffer() = default;
+    ~PooledBuffer() { reset(); }
+
+    PooledBuffer(PooledBuffer&& other) noexcept;
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    uint8_t* data() const { return m_data; }
+    size_t capacity() const;
+    explicit operator bool() const { return m_data != nullptr; }
+
+    void reset();
+
+private:
+    friend class BufferPool;
+    PooledBuffer(BufferPool* pool, uint8_t* data, int sizeClass)
+        : m_pool(pool), m_data(data), m_sizeClass(sizeClass)
+    {
+    }
+
+    BufferPool* m_pool = nullptr;
+    uint8_t* m_data = nullptr;
+    int m_sizeClass = -1;
+};
+
+// Recycles 64-byte aligned blocks so frames, scratch planes and cursor images that are
+// dropped and re-created every frame reuse the same memory instead of going back to the
+// allocator. Sizes round up to one of four classes per power of two (at most 25% slack),
+// from 4 KB to 1.75 GB. Freed blocks wait on a per-class list; the shared instance also
+// keeps a few small blocks per thread so the common case takes no lock. Blocks of 2 MB
+// and up come straight from the OS and can be backed by huge pages, which saves TLB
+// misses when a pass walks a whole 4K frame.
+class BufferPool
+{
+public:
+    struct Stats
+    {
+        uint64_t hits = 0;        // acquires served from a free list
+        uint64_t misses = 0;      // acquires that had to allocate
+        size_t allocatedBytes = 0; // every block the pool owns, loaned or free
+        size_t cachedBytes = 0;    // free blocks on the shared lists
+    };
+
+    static constexpr size_t kAlignment = 64;
+    static constexpr size_t kMinBlock = 4096;
+    static constexpr size_t kLargeBlock = size_t(2) << 20; // from here on, OS pages
+    static constexpr int kClassCount = 4 * 19;
+
+    BufferPool();
+    ~BufferPool(); // every PooledBuffer must be gone by now
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Shared pool for the capture pipeline. Never destroyed, so buffers held by statics
+    // and exiting threads can still be returned.
+    static BufferPool& instance();
+
+    // Empty buffer if the size is above the largest class or the allocation fails
+    PooledBuffer acquire(size_t bytes);
+
+    // Ask for huge pages for large blocks allocated from now on. Windows needs the "Lock
+    // pages in memory" privilege and falls back to normal pages without it; Linux asks
+    // for transparent huge pages.
+    void setHugePages(bool enabled);
+    bool hugePages() const { return m_hugePages.load(std::memory_order_relaxed); }
+
+    // Free blocks beyond this many bytes are released instead of kept
+    void setCacheLimit(size_t bytes);
+
+    // Release every free block on the shared lists
+    void trim();
+
+    Stats stats() const;
+
+    static int sizeClassFor(size_t bytes); // -1 if too large
+    static size_t classSize(int sizeClass);
+
+private:
+    friend class PooledBuffer;
+    friend struct ThreadBlockCache;
+
+    void release(uint8_t* data, int sizeClass);
+    void releaseShared(uint8_t* data, int sizeClass);
+    uint8_t* allocateBlock(int sizeClass);
+    void freeBlock(uint8_t* data, int sizeClass);
+
+    bool m_threadCache = false; // only the shared instance has per-thread caches
+    std::atomic<bool> m_hugePages{ false };
+
+    mutable std::mutex m_mutex;
+    std::vector<uint8_t*> m_free[kClassCount];
+    std::atomic<size_t> m_cachedBytes{ 0 }; // changed under m_mutex, read without it by stats()
+    size_t m_cacheLimit = size_t(512) << 20;
+
+    std::atomic<uint64_t> m_hits{ 0 };
+    std::atomic<uint64_t> m_misses{ 0 };
+    std::atomic<size_t> m_allocatedBytes{ 0 };
+};
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "FrameChangeDetector.h"
+#include "SampleConverter.h"
+#include "SceneCompositor.h"
+#include "VideoFrame.h"
+#include "VideoSource.h"
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Raw recording of what a capture produced, for replaying a real session through the
+// pipeline offline (TraceReplaySource). Append-only:
+//
+//     FileHeader
+//     Record header + payload, 8-byte aligned, repeated:
+//         Frame:  FramePayload, damage rects, then the pixels - the whole frame for a
+//                 keyframe, else only the damaged rects, row by row, packed
+//         Cursor: CursorPayload, then the shape if it changed
+//         Audio:  AudioPayload, then the interleaved samples
+//     IndexEntry per record, then Footer
+//
+// The index at the end lets a reader find records and keyframes without scanning. A
+// recording that was cut short has no index; the reader rebuilds it by walking the
+// records and stops at the first incomplete one. Little endian, as both platforms are.
+namespace CaptureTrace
+{
+    constexpr char kMagic[8] = { 'O', 'B', 'S', 'C', 'A', 'P', 'T', 'R' };
+    constexpr char kFooterMagic[8] = { 'O', 'B', 'S', 'I', 'N', 'D', 'E', 'X' };
+    constexpr uint32_t kVersion = 1;
+
+    enum RecordType : uint32_t
+    {
+        Frame = 1,
+        Cursor = 2,
+        Audio = 3,
+    };
+
+    enum RecordFlags : uint32_t
+    {
+        Keyframe = 1, // frame record with the full picture
+    };
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerBytes;
+    };
+
+    struct RecordHeader
+    {
+        uint32_t type;
+        uint32_t flags;
+        uint64_t payloadBytes; // before padding
+        int64_t timestampUs;
+    };
+
+    struct FramePayload
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t rectCount; // damage, followed by that many RectPayload
+        uint32_t reserved;
+    };
+
+    struct RectPayload
+    {
+        int32_t x;
+        int32_t y;
+        int32_t width;
+        int32_t height;
+    };
+
+    struct CursorPayload
+    {
+        int32_t x;
+        int32_t y;
+        uint32_t visible;
+        uint32_t shapeType; // CursorUpdate::ShapeType
+        int32_t width;
+        int32_t height;
+        int32_t pitch;
+        int32_t hotX;
+        int32_t hotY;
+        uint32_t shapeBytes;
+    };
+
+    struct AudioPayload
+    {
+        uint32_t sampleRate;
+        uint32_t channels;
+        uint32_t format; // SampleFormat
+        uint32_t frames;
+    };
+
+    struct IndexEntry
+    {
+        uint64_t offset; // of the record header
+        int64_t timestampUs;
+        uint32_t type;
+        uint32_t flags;
+    };
+
+    struct Footer
+    {
+        uint64_t indexOffset;
+        uint64_t indexCount;
+        char magic[8];
+    };
+
+    inline uint64_t padded(uint64_t bytes) { return (bytes + 7) & ~uint64_t(7); }
+}
+
+// Records frames, cursor updates and audio into a capture trace. Frames and cursor
+// updates come from the capture thread; writeAudio() may be called from the audio
+// thread and only queues, so it never waits on the disk. Queued audio goes out ahead
+// of the next frame.
+class CaptureTraceWriter
+{
+public:
+    // Frames between full pictures, so seeking never has to replay far
+    static constexpr int kKeyframeInterval = 120;
+
+    ~CaptureTraceWriter() { close(); }
+
+    bool open(const std::string& path);
+    // Writes the index; a trace closed without it still replays
+    bool close();
+    bool isOpen() const { return m_file.is_open(); }
+
+    // changes null (or a new size) records a keyframe with everything damaged
+    bool writeFrame(int64_t timestampUs, const FrameView& frame, const ChangeMap* changes);
+    bool writeCursor(int64_t timestampUs, const CursorUpdate& cursor);
+    void writeAudio(int64_t timestampUs, int sampleRate, int channels, SampleFormat format,
+        const void* interleaved, int frames);
+
+    uint64_t bytesWritten() const { return m_bytes.load(std::memory_order_relaxed); }
+    uint64_t framesWritten() const { return m_frames.load(std::memory_order_relaxed); }
+    const std::string& lastError() const { return m_error; }
+
+private:
+    void beginRecord(uint32_t type, uint32_t flags, uint64_t payloadBytes, int64_t timestampUs);
+    void append(const void* data, size_t bytes);
+    void endRecord();
+    void flushAudio();
+
+    std::ofstream m_file;
+    uint64_t m_offset = 0;
+    uint64_t m_recordPayload = 0;
+    std::vector<CaptureTrace::IndexEntry> m_index;
+    std::vector<CaptureTrace::RectPayload> m_rects;
+    int m_width = 0;
+    int m_height = 0;
+    int m_sinceKeyframe = 0;
+
+    // Audio packets queued by writeAudio(): header, payload header and samples, each
+    // already laid out as a record
+    std::mutex m_audioMutex;
+    std::vector<uint8_t> m_audioQueue;
+    std::vector<uint8_t> m_audioWriting;
+
+    std::atomic<uint64_t> m_bytes{ 0 };
+    std::atomic<uint64_t> m_frames{ 0 };
+    std::string m_error;
+};
+
+// Memory-maps a capture trace and decodes its records in place
+class CaptureTraceReader
+{
+public:
+    struct Record
+    {
+        uint32_t type = 0;
+        uint32_t flags = 0;
+        int64_t timestampUs = 0;
+        const uint8_t* payload = nullptr;
+        uint64_t payloadBytes = 0;
+    };
+
+    struct AudioPacket
+    {
+        int sampleRate = 0;
+        int channels = 0;
+        SampleFormat format = SampleFormat::F32;
+        int frames = 0;
+        const uint8_t* data = nullptr; // interleaved, in the mapped file
+    };
+
+    CaptureTraceReader() = default;
+    ~CaptureTraceReader() { close(); }
+
+    CaptureTraceReader(const CaptureTraceReader&) = delete;
+    CaptureTraceReader& operator=(const CaptureTraceReader&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+
+    size_t recordCount() const { return m_records.size(); }
+    const Record& record(size_t i) const { return m_records[i]; }
+    bool indexRebuilt() const { return m_indexRebuilt; } // no index at the end, recovered by scanning
+
+    size_t frameCount() const { return m_frameCount; }
+    int width() const { return m_width; }   // of the first frame
+    int height() const { return m_height; }
+    int64_t duration() const; // microseconds from the first record to the last
+
+    // Last keyframe at or before record i, for seeking
+    size_t keyframeBefore(size_t i) const;
+
+    // Brings target (the picture after the previous frame record) up to date with frame
+    // record i and lists its damage. A keyframe resizes target.
+    bool applyFrame(size_t i, FrameBuffer& target, std::vector<SceneRect>& damage) const;
+    // shape points into the mapped file
+    bool readCursor(size_t i, CursorUpdate& cursor) const;
+    bool readAudio(size_t i, AudioPacket& packet) const;
+
+    const std::string& lastError() const { return m_error; }
+
+private:
+    bool loadIndex();
+    bool scanRecords();
+    bool addRecord(uint64_t offset);
+
+    const uint8_t* m_data = nullptr;
+    uint64_t m_size = 0;
+#ifdef _WIN32
+    void* m_fileHandle = nullptr;
+    void* m_mapping = nullptr;
+#endif
+    std::vector<Record> m_records;
+    std::vector<size_t> m_keyframes; // record numbers
+    bool m_indexRebuilt = false;
+    size_t m_frameCount = 0;
+    int m_width = 0;
+    int m_height = 0;
+    std::string m_error;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+// Green/blue screen keying by distance to the key color in BT.709 CbCr or in the HSV
+// hue/saturation plane, with soft edges and spill suppression. Works as a FilterChain
+// per-pixel filter on straight-alpha BGRA: the key is written into alpha and the
+// layer is premultiplied later by the compositor.
+class ChromaKey
+{
+public:
+    // Plane the distance is measured in. HSV drops brightness, so shadows and uneven
+    // light on the screen still key; CbCr keeps dark key-colored detail.
+    enum class Space
+    {
+        CbCr,
+        Hsv,
+    };
+
+    struct Settings
+    {
+        uint32_t keyColor = 0x00FF00; // 0xRRGGBB
+        Space space = Space::CbCr;
+        float similarity = 0.40f;     // chroma distance treated as fully keyed
+        float smoothness = 0.08f;     // width of the soft edge past similarity
+        float spill = 0.10f;          // distance over which key-colored tint is removed
+    };
+
+    ChromaKey();
+    explicit ChromaKey(const Settings& settings);
+
+    const Settings& settings() const { return m_settings; }
+
+    void apply(uint8_t* bgra, int count) const;
+
+    // Plain C++ path, also used for the tail of each run
+    void applyScalar(uint8_t* bgra, int count) const;
+
+private:
+    friend struct ChromaKeyKernels;
+
+    Settings m_settings;
+    float m_keyX = 0.0f; // key color in the distance plane
+    float m_keyY = 0.0f;
+    float m_invSmoothness = 0.0f;
+    float m_invSpill = 0.0f;
+
+    // Kernel picked at construction from the CPU features and setSimdLevel()
+    void (*m_kernel)(const ChromaKey&, uint8_t*, int) = nullptr;
+};
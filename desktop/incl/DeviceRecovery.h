@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Brings a lost capture device back without stalling whoever drives it. The driving
+// thread (capture tick, audio lane) reports the loss and carries on with its fallback,
+// holding the last frame or playing silence, while a background thread retries the
+// init with exponential backoff. The driving thread leaves the device alone until
+// poll() says it is back, so the init has it to itself.
+class DeviceRecovery
+{
+public:
+    struct Settings
+    {
+        std::string name = "device";
+        int initialBackoffMs = 50; // before the second attempt; the first one is immediate
+        int maxBackoffMs = 2000;
+    };
+
+    enum class State
+    {
+        Running,    // device usable
+        Recovering, // lost; attempts under way on the background thread
+        Recovered,  // an attempt succeeded, waiting for the driving thread to poll()
+        Stopped     // still lost, stop() ended the attempts; the next poll() restarts them
+    };
+
+    using Reinit = std::function<bool(std::string& error)>;
+
+    DeviceRecovery() = default;
+    explicit DeviceRecovery(const Settings& settings) : m_settings(settings) {}
+    ~DeviceRecovery() { stop(); }
+
+    DeviceRecovery(const DeviceRecovery&) = delete;
+    DeviceRecovery& operator=(const DeviceRecovery&) = delete;
+
+    void setSettings(const Settings& settings) { m_settings = settings; } // while running only
+
+    // Driving thread. Starts retrying reinit in the background; false if already recovering.
+    bool reportLost(Reinit reinit, const std::string& reason);
+    // Driving thread, every tick while recovering: true once, when the device is back
+    bool poll();
+    // Ends a recovery in progress after the attempt already running, if any. A device
+    // that came back stays Recovered for the next poll(); one still lost is left Stopped,
+    // and the next poll() starts the attempts again with the same reinit, so a driving
+    // thread restarted after stop() picks the recovery back up.
+    void stop();
+
+    // Driving thread while recovering: audio frames of fallback (silence) due since the
+    // previous call, at most maxFrames, so the stream keeps its timeline through the
+    // outage. None while Stopped; the count starts over when the attempts restart.
+    int fallbackFramesDue(int sampleRate, int maxFrames);
+
+    State state() const { return m_state.load(std::memory_order_acquire); }
+    bool isRecovering() const { return state() != State::Running; }
+
+    // Any thread
+    uint64_t losses() const { return m_losses.load(std::memory_order_relaxed); }
+    uint64_t recoveries() const { return m_recoveries.load(std::memory_order_relaxed); }
+    uint64_t attempts() const { return m_attempts.load(std::memory_order_relaxed); } // reinit calls, successful ones included
+    int64_t longestOutageMicros() const { return m_longestOutageUs.load(std::memory_order_relaxed); }
+    int64_t currentOutageMicros() const; // 0 while running
+    std::string lastError() const;       // why the device was lost or the last attempt failed
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void start();
+    void run(Reinit reinit);
+
+    Settings m_settings;
+    std::thread m_thread;
+    std::atomic<State> m_state{ State::Running };
+    std::atomic<int64_t> m_lostAtUs{ 0 };
+    Reinit m_reinit;               // driving thread only, like the fallback count
+    int64_t m_fallbackSinceUs = 0;
+    uint64_t m_fallbackFrames = 0;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+    std::string m_error;
+
+    std::atomic<uint64_t> m_losses{ 0 };
+    std::atomic<uint64_t> m_recoveries{ 0 };
+    std::atomic<uint64_t> m_attempts{ 0 };
+    std::atomic<int64_t> m_longestOutageUs{ 0 };
+};
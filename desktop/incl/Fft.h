@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+// Forward FFT of real input. The N real samples are packed into an N/2-point complex
+// FFT (Stockham radix-4 with a final radix-2 stage when needed, so no bit reversal),
+// which is unpacked into the N/2 + 1 bins of the real spectrum. Data is kept as
+// separate real/imaginary arrays so every butterfly stage runs four at a time in
+// SSE; all twiddles are computed in configure().
+//
+// One instance per thread: forward() uses internal scratch buffers.
+class RealFft
+{
+public:
+    // Size must be a power of two, at least 8
+    bool configure(int size);
+    int size() const { return m_size; }
+    int bins() const { return m_size / 2 + 1; }
+
+    // in: size() samples; re/im: bins() values each
+    void forward(const float* in, float* re, float* im);
+
+private:
+    struct Stage
+    {
+        int m = 0;       // butterflies per group (n / 4)
+        int s = 0;       // stride
+        std::vector<float> w1Re, w1Im, w2Re, w2Im, w3Re, w3Im;
+    };
+
+    // Complex FFT of m_half points from m_re/m_im; returns the buffer holding the result
+    int complexForward();
+
+    int m_size = 0;
+    int m_half = 0;
+    bool m_finalRadix2 = false;
+    std::vector<Stage> m_stages;
+    std::vector<float> m_re[2];
+    std::vector<float> m_im[2];
+
+    // e^(-2*pi*i*k/size) for unpacking the real spectrum
+    std::vector<float> m_unpackRe;
+    std::vector<float> m_unpackIm;
+};
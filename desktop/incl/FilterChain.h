@@ -0,0 +1,189 @@
+#pragma once
+
+#include "Scaler.h"
+#include "ThreadPool.h"
+#include "VideoFrame.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Region of the source a chain reads, empty = whole frame
+struct CropRect
+{
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+
+    bool isEmpty() const { return width <= 0 || height <= 0; }
+};
+
+namespace filterchain {
+    // Output rows handed to one worker
+    constexpr int kStripRows = 16;
+
+    // Pixels run through the per-pixel filters at once (16 KB, stays in L1)
+    constexpr int kChunkPixels = 4096;
+
+    inline FrameView cropView(const FrameView& src, const CropRect& crop)
+    {
+        if (crop.isEmpty()) {
+            return src;
+        }
+        const int x = std::clamp(crop.x, 0, src.width);
+        const int y = std::clamp(crop.y, 0, src.height);
+        const int w = std::min(crop.width, src.width - x);
+        const int h = std::min(crop.height, src.height - y);
+        if (w <= 0 || h <= 0) {
+            return FrameView();
+        }
+        return FrameView(src.row(y) + x * 4, w, h, src.stride);
+    }
+
+    // Crop and scale are applied while each output row is produced, then the row is
+    // handed to applyRow while it is still in cache
+    template <typename ApplyRow>
+    bool runFused(const FrameView& src, const CropRect& crop, Scaler& scaler, const FrameView& dst,
+        ThreadPool* pool, ApplyRow applyRow)
+    {
+        const FrameView in = cropView(src, crop);
+        if (!in.isValid() || !dst.isValid()) {
+            return false;
+        }
+
+        const bool scaled = in.width != dst.width || in.height != dst.height;
+        if (scaled) {
+            scaler.configure(in.width, in.height, dst.width, dst.height);
+        }
+
+        const int strips = (dst.height + kStripRows - 1) / kStripRows;
+        auto runStrips = [&](int begin, int end) {
+            for (int s = begin; s < end; s++) {
+                const int y0 = s * kStripRows;
+                const int y1 = std::min(y0 + kStripRows, dst.height);
+                for (int y = y0; y < y1; y++) {
+                    if (scaled) {
+                        scaler.scaleRows(in, dst, y, y + 1);
+                    }
+                    else if (in.data != dst.data) {
+                        memcpy(dst.row(y), in.row(y), static_cast<size_t>(dst.width) * 4);
+                    }
+
+                    uint8_t* row = dst.row(y);
+                    for (int x = 0; x < dst.width; x += kChunkPixels) {
+                        applyRow(row + x * 4, std::min(kChunkPixels, dst.width - x));
+                    }
+                }
+            }
+        };
+
+        if (pool) {
+            pool->parallelFor(strips, runStrips);
+        }
+        else {
+            runStrips(0, strips);
+        }
+        return true;
+    }
+}
+
+// Crop -> scale -> per-pixel filters fused into one strip-wise pass: every source row
+// is read once and every destination row is written once, with all filters applied
+// in between. The filter list is fixed at compile time so the calls inline, e.g.
+//
+//     FilterChain<ColorMatrix, Lut1D, ForceOpaque> chain(matrix, lut, ForceOpaque());
+//     chain.setCrop(crop);
+//     chain.process(frame, output, &ThreadPool::instance());
+//
+// The output size is taken from dst; a different size than the crop means scaling.
+template <typename... Filters>
+class FilterChain
+{
+public:
+    explicit FilterChain(Filters... filters) : m_filters(std::move(filters)...) {}
+
+    void setCrop(const CropRect& crop) { m_crop = crop; }
+
+    template <size_t Index>
+    auto& filter() { return std::get<Index>(m_filters); }
+
+    bool process(const FrameView& src, const FrameView& dst, ThreadPool* pool = nullptr)
+    {
+        return filterchain::runFused(src, m_crop, m_scaler, dst, pool, [this](uint8_t* bgra, int count) {
+            std::apply([&](const Filters&... f) { (f.apply(bgra, count), ...); }, m_filters);
+        });
+    }
+
+private:
+    std::tuple<Filters...> m_filters;
+    CropRect m_crop;
+    Scaler m_scaler;
+};
+
+// Runtime-built fallback for chains only known at run time (arbitrary order, several
+// crops or scales). Runs of per-pixel filters are still fused with the crop/scale in
+// front of them; each later crop or scale starts a new pass over an intermediate.
+class DynamicFilterChain
+{
+public:
+    class Filter
+    {
+    public:
+        virtual ~Filter() = default;
+        virtual void apply(uint8_t* bgra, int count) const = 0;
+    };
+
+    void clear();
+    void addCrop(const CropRect& crop);
+    void addScale(int width, int height);
+
+    template <typename F>
+    void addFilter(F filter)
+    {
+        struct Adapter : Filter
+        {
+            explicit Adapter(F f) : f(std::move(f)) {}
+            void apply(uint8_t* bgra, int count) const override { f.apply(bgra, count); }
+            F f;
+        };
+        addFilter(std::unique_ptr<Filter>(new Adapter(std::move(filter))));
+    }
+    void addFilter(std::unique_ptr<Filter> filter);
+
+    // Size the chain produces for a given input, or 0x0 when it crops everything away
+    void outputSize(int srcWidth, int srcHeight, int* width, int* height) const;
+
+    bool process(const FrameView& src, const FrameView& dst, ThreadPool* pool = nullptr);
+
+private:
+    struct Stage
+    {
+        enum class Kind { Crop, Scale, Filter };
+        Kind kind = Kind::Filter;
+        CropRect crop;
+        int width = 0;
+        int height = 0;
+        std::unique_ptr<Filter> filter;
+    };
+
+    // One fused pass: optional crop, optional scale, then filters
+    struct Pass
+    {
+        CropRect crop;
+        int width = 0;
+        int height = 0;
+        std::vector<const Filter*> filters;
+        Scaler scaler;
+        FrameBuffer output; // unused for the last pass
+    };
+
+    void plan(int srcWidth, int srcHeight);
+
+    std::vector<Stage> m_stages;
+    std::vector<std::unique_ptr<Pass>> m_passes;
+    int m_plannedWidth = -1;
+    int m_plannedHeight = -1;
+};
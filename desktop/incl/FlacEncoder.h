@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// FLAC encoder for 16/24-bit PCM. Blocks are independent, so encode() codes every
+// block of a batch in parallel and appends the frames in order. Each channel picks
+// the cheapest of constant, fixed and LPC prediction (autocorrelation and Levinson-
+// Durbin, with the order chosen from the prediction error and checked against the
+// fixed predictors), stereo picks the best of left/right, left/side, side/right and
+// mid/side, and residuals use the partition order with the fewest Rice-coded bits.
+//
+//     FlacEncoder encoder;
+//     encoder.configure(48000, 2, 16);
+//     std::vector<uint8_t> out = encoder.header();
+//     encoder.encode(planes, frames, out, &pool);   // as audio arrives
+//     ... then write header() over the first kHeaderBytes for the totals and MD5
+class FlacEncoder
+{
+public:
+    struct Settings
+    {
+        int blockSize = 4096;
+        int maxLpcOrder = 8;          // 0 disables LPC, up to 32
+        int maxPartitionOrder = 6;    // up to 8
+        bool exhaustiveOrderSearch = false; // code every LPC order instead of the estimated best
+    };
+
+    static constexpr int kMaxChannels = 8;
+    static constexpr int kHeaderBytes = 42; // "fLaC" + STREAMINFO
+
+    bool configure(int sampleRate, int channels, int bitsPerSample, const Settings& settings);
+    bool configure(int sampleRate, int channels, int bitsPerSample) { return configure(sampleRate, channels, bitsPerSample, Settings()); }
+
+    // Stream marker and STREAMINFO with the totals so far. Write it first and again over
+    // the start of the file when done; the length never changes.
+    std::vector<uint8_t> header() const;
+
+    // Encodes planar samples (sign-extended, within bitsPerSample) and appends the frames
+    // to out. Every call but the last must pass a multiple of the block size.
+    void encode(const int32_t* const* planes, int frames, std::vector<uint8_t>& out, ThreadPool* pool = nullptr);
+
+    const Settings& settings() const { return m_settings; }
+    uint64_t totalFrames() const { return m_totalFrames; }
+
+private:
+    struct Md5
+    {
+        uint32_t state[4] = { 0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u };
+        uint8_t buffer[64] = {};
+        uint64_t length = 0;
+        void update(const uint8_t* data, size_t size);
+        void finish(uint8_t digest[16]) const;
+    };
+
+    void encodeBlock(const int32_t* const* planes, int offset, int frames, uint64_t frameNumber, std::vector<uint8_t>& out) const;
+    void hashSamples(const int32_t* const* planes, int frames);
+
+    Settings m_settings;
+    int m_sampleRate = 0;
+    int m_channels = 0;
+    int m_bitsPerSample = 0;
+
+    uint64_t m_totalFrames = 0;
+    uint64_t m_nextFrameNumber = 0;
+    uint32_t m_minFrameBytes = 0;
+    uint32_t m_maxFrameBytes = 0;
+    Md5 m_md5;
+    std::vector<uint8_t> m_md5Bytes;
+
+    std::vector<std::vector<uint8_t>> m_blockOutput; // one per block of the current batch
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "FlacEncoder.h"
+#include "SampleConverter.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool;
+
+// Records one audio stream to a FLAC file. The capture thread only appends float
+// samples; a writer thread converts them to 16 or 24-bit PCM, encodes whole batches of
+// blocks across the pool and writes them out. stop() flushes the tail and rewrites the
+// header with the final length and MD5.
+class FlacRecorder
+{
+public:
+    FlacRecorder() = default;
+    ~FlacRecorder();
+
+    bool start(const std::filesystem::path& path, int sampleRate, int channels, int bitsPerSample, ThreadPool* pool);
+    void stop();
+    bool isRecording() const { return m_recording.load(std::memory_order_acquire); }
+
+    // Capture thread: interleaved samples in the channel count given to start()
+    void push(const float* interleaved, int frames);
+
+    // Frames pushed but not encoded yet; any thread
+    size_t queuedFrames() const { return m_queuedFrames.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void encodeBuffered(bool final);
+
+    FlacEncoder m_encoder;
+    SampleConverter m_converter;
+    ThreadPool* m_pool = nullptr;
+    std::ofstream m_file;
+    int m_channels = 0;
+    int m_bitsPerSample = 0;
+    int m_batchFrames = 0;
+
+    // Filled by push(), swapped out by the writer
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::vector<float> m_pending;
+    bool m_stopping = false;
+
+    // Writer thread only
+    std::vector<float> m_incoming;
+    std::vector<int32_t> m_planes[FlacEncoder::kMaxChannels];
+    std::vector<int16_t> m_narrow[FlacEncoder::kMaxChannels];
+    int m_buffered = 0;
+    std::vector<uint8_t> m_output;
+
+    std::thread m_writer;
+    std::atomic<bool> m_recording{ false };
+    std::atomic<size_t> m_queuedFrames{ 0 };
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A compressed packet as an encoder hands it out: H.264 in AVCC form (length-prefixed
+// NAL units) or raw AAC frames. The codec configuration goes out first, with config set.
+struct EncodedPacket
+{
+    enum Type : uint8_t
+    {
+        Video,
+        Audio,
+    };
+
+    // What losing a video packet costs: nothing references a disposable frame, the
+    // rest of the GOP references a reference frame, a keyframe starts a GOP
+    enum Priority : uint8_t
+    {
+        Disposable,
+        Reference,
+        Keyframe,
+    };
+
+    Type type = Video;
+    Priority priority = Keyframe;
+    bool config = false;       // AVCDecoderConfigurationRecord / AudioSpecificConfig
+    int64_t dtsMs = 0;         // decode time since the start of the stream
+    int32_t compositionMs = 0; // pts - dts, video only
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// FLV muxing. A tag body (header bytes from bodyHeader(), then the packet data) is also
+// exactly what RTMP carries in an audio or video message, so RtmpOutput sends bodies
+// and only a file needs the FLV header and tag framing around them.
+//
+//     Flv::writeFileHeader(out, true, true);
+//     Flv::metadataBody(body, settings, false);
+//     Flv::writeTag(out, Flv::ScriptTag, 0, body.data(), body.size());
+//     ... then a tag per packet
+namespace Flv
+{
+    enum TagType : uint8_t
+    {
+        AudioTag = 8,
+        VideoTag = 9,
+        ScriptTag = 18,
+    };
+
+    constexpr size_t kFileHeaderBytes = 13; // signature, flags, PreviousTagSize0
+    constexpr size_t kTagHeaderBytes = 11;
+    constexpr size_t kMaxBodyHeaderBytes = 5;
+    constexpr int kAvcCodec = 7;
+    constexpr int kAacCodec = 10;
+
+    struct Settings
+    {
+        int width = 1920;
+        int height = 1080;
+        double fps = 60.0;
+        int videoKbps = 6000;
+        int audioSampleRate = 48000;
+        int audioChannels = 2;
+        int audioKbps = 160;
+        const char* encoder = "obs-clone";
+    };
+
+    inline TagType tagType(const EncodedPacket& packet) { return packet.type == EncodedPacket::Audio ? AudioTag : VideoTag; }
+
+    // Codec, frame type and packet type bytes ahead of the data; returns how many
+    size_t bodyHeader(const EncodedPacket& packet, uint8_t header[kMaxBodyHeaderBytes]);
+
+    // onMetaData, wrapped in @setDataFrame for RTMP
+    void metadataBody(std::vector<uint8_t>& out, const Settings& settings, bool setDataFrame);
+
+    void writeFileHeader(std::vector<uint8_t>& out, bool hasAudio, bool hasVideo);
+    // Tag header, body (header and data, either may be empty) and PreviousTagSize
+    void writeTag(std::vector<uint8_t>& out, TagType type, uint32_t timestampMs,
+        const uint8_t* bodyHeader, size_t bodyHeaderSize, const uint8_t* data, size_t size);
+    inline void writeTag(std::vector<uint8_t>& out, TagType type, uint32_t timestampMs, const uint8_t* body, size_t size)
+    {
+        writeTag(out, type, timestampMs, nullptr, 0, body, size);
+    }
+}
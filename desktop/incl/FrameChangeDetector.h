@@ -0,0 +1,57 @@
+#pragma once
+
+#include "VideoFrame.h"
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Changed tiles of one frame relative to the previous one
+struct ChangeMap
+{
+    int tileSize = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    int changedCount = 0;
+    std::vector<uint64_t> bits;     // one bit per tile, row-major
+    std::vector<uint8_t> rowChanged; // any tile changed in this tile row
+
+    // Nothing in the frame differs from the previous one
+    bool isDuplicate() const { return changedCount == 0; }
+
+    bool isChanged(int tx, int ty) const
+    {
+        const int i = ty * tilesX + tx;
+        return (bits[i >> 6] >> (i & 63)) & 1;
+    }
+
+    // Any tile changed that touches pixel rows [y0, y1)
+    bool rowsChanged(int y0, int y1) const;
+
+    // For sources that know their damage: size the grid for a frame with nothing
+    // changed, then mark the tiles each rectangle touches (clipped to the frame)
+    void clear(int width, int height, int tile);
+    void markRect(int x, int y, int width, int height);
+};
+
+// Hashes fixed-size tiles of each frame and compares them with the previous frame,
+// so downstream stages can skip regions (or whole frames) that did not change.
+class FrameChangeDetector
+{
+public:
+    static constexpr int kTileSize = 64; // same grid as SceneCompositor
+
+    // Forget the previous frame, the next one reports every tile as changed
+    void reset();
+
+    const ChangeMap& detect(const FrameView& frame, ThreadPool* pool = nullptr);
+    const ChangeMap& changes() const { return m_changes; }
+
+    static uint64_t hashTile(const FrameView& frame, int x, int y, int width, int height);
+
+private:
+    std::vector<uint64_t> m_hashes;
+    std::vector<uint64_t> m_previous;
+    bool m_hasPrevious = false;
+    ChangeMap m_changes;
+};
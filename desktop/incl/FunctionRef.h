@@ -0,0 +1,30 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+template<typename Signature>
+class FunctionRef;
+
+// Non-owning reference to a callable, for passing lambdas to functions that call them
+// before returning. Unlike std::function it never copies the callable, so it never
+// allocates however much the lambda captures. The callable must outlive the reference.
+template<typename R, typename... Args>
+class FunctionRef<R(Args...)>
+{
+public:
+    template<typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, FunctionRef>::value>>
+    FunctionRef(F&& func)
+        : m_object(const_cast<void*>(static_cast<const void*>(std::addressof(func))))
+        , m_call([](void* object, Args... args) -> R {
+              return (*static_cast<std::remove_reference_t<F>*>(object))(std::forward<Args>(args)...);
+          })
+    {
+    }
+
+    R operator()(Args... args) const { return m_call(m_object, std::forward<Args>(args)...); }
+
+private:
+    void* m_object;
+    R (*m_call)(void*, Args...);
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "VideoFrame.h"
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Pixel formats the desktop duplication hands out on an HDR display
+enum class HdrFormat
+{
+    ScRgb16F, // R16G16B16A16_FLOAT: linear BT.709 primaries, 1.0 = 80 nits, may exceed 1 or go negative
+    Hdr10,    // R10G10B10A2_UNORM: PQ-encoded BT.2020 primaries
+    Hlg10,    // R10G10B10A2_UNORM: HLG-encoded BT.2020 primaries (BT.2100), as broadcast sources deliver
+};
+
+// Non-owning view of an HDR frame in one of the formats above
+struct HdrView
+{
+    const uint8_t* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int stride = 0; // bytes per line
+    HdrFormat format = HdrFormat::ScRgb16F;
+
+    HdrView() = default;
+    HdrView(const uint8_t* data, int width, int height, int stride, HdrFormat format)
+        : data(data), width(width), height(height), stride(stride), format(format)
+    {
+    }
+
+    bool isValid() const { return data && width > 0 && height > 0; }
+    const uint8_t* row(int y) const { return data + static_cast<size_t>(y) * stride; }
+};
+
+// 10-bit 4:2:0 frame as encoders take it: a luma plane and an interleaved CbCr plane at
+// half resolution, each sample in the top 10 bits of a 16-bit word
+struct P010Buffer
+{
+    int width = 0;
+    int height = 0;
+    std::vector<uint16_t> luma;   // width per line
+    std::vector<uint16_t> chroma; // chromaWidth() CbCr pairs per line, chromaHeight() lines
+
+    int chromaWidth() const { return (width + 1) / 2; }
+    int chromaHeight() const { return (height + 1) / 2; }
+
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        luma.resize(static_cast<size_t>(w) * h);
+        chroma.resize(static_cast<size_t>(chromaWidth()) * chromaHeight() * 2);
+    }
+};
+
+// Curves that fit the HDR range into SDR. All of them leave SDR white at or near 1.0 and
+// map the display peak to 1.0; they differ in how much highlight detail they keep.
+enum class ToneCurve
+{
+    Clip,     // hard clip at SDR white
+    Reinhard, // extended Reinhard, reaches 1.0 exactly at the peak
+    Hable,    // Uncharted 2 filmic curve, darker mid-tones with a soft shoulder
+    Bt2390,   // ITU-R BT.2390 EETF: identity below the knee, Hermite roll-off in PQ space
+};
+
+// Converts captured HDR frames for the rest of the pipeline:
+//  - toSdr() tone-maps to 8-bit BGRA (BT.709 primaries, sRGB transfer) for the preview,
+//    compositor and SDR encoders. The curve runs on max(R, G, B) and scales all three
+//    channels by the same factor, so hues don't shift as highlights compress.
+//  - toP010() keeps the full range for HDR encoding: BT.2020 PQ, limited range, 4:2:0.
+//    HDR10 input is already PQ/BT.2020 and only goes through the YCbCr matrix; HLG is
+//    taken to display light for a peakNits display and re-encoded as PQ.
+// The curve, sRGB and PQ transfer functions are all table lookups, so the per-pixel
+// work is a few multiplies and gathers. Rows are independent and split across the
+// pool; AVX2 kernels (F16C for the half floats) are picked at run time, with plain
+// C++ everywhere else.
+class HdrConverter
+{
+public:
+    struct Settings
+    {
+        ToneCurve curve = ToneCurve::Bt2390;
+        float sdrWhiteNits = 203.0f; // HDR level that becomes SDR white (BT.2408 reference white)
+        float peakNits = 1000.0f;    // brightest level kept, usually the display's max luminance
+    };
+
+    HdrConverter();
+    explicit HdrConverter(const Settings& settings);
+
+    void setSettings(const Settings& settings);
+    const Settings& settings() const { return m_settings; }
+
+    // dst must be at least as large as src; alpha is written opaque
+    void toSdr(const HdrView& src, const FrameView& dst, ThreadPool* pool = nullptr) const;
+
+    // Resizes dst to the source size
+    void toP010(const HdrView& src, P010Buffer& dst, ThreadPool* pool = nullptr) const;
+
+    // Force the plain C++ kernels, for comparing against the SIMD ones
+    void setUseSimd(bool enabled) { m_useSimd = enabled; }
+
+private:
+    friend struct HdrKernels;
+
+    Settings m_settings;
+    bool m_useSimd = true;
+
+    // curve(m) / m for the max channel m in units of SDR white, sampled at
+    // m = peak * (i / (n - 1))^2 so the dark end gets most of the entries.
+    // Past the peak every curve is 1.0 and the ratio is just 1 / m.
+    std::vector<float> m_toneRatio;
+    float m_peak = 1.0f; // peakNits / sdrWhiteNits
+
+    // HLG OOTF gain peakNits * Ys^(gamma - 1) for scene luminance Ys = (i / (n - 1))^2
+    std::vector<float> m_hlgGain;
+};
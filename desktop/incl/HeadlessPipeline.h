@@ -0,0 +1,144 @@
+#pragma once
+
+#include "CaptureTrace.h"
+#include "FlacRecorder.h"
+#include "LatencyHistogram.h"
+#include "LoudnessMeter.h"
+#include "Metrics.h"
+#include "MetricsServer.h"
+#include "RealtimeLane.h"
+#include "SampleConverter.h"
+#include "ScalerPyramid.h"
+#include "SceneCompositor.h"
+#include "StartupSequencer.h"
+#ifdef OBS_HAVE_SHM
+#include "SharedFrameOutput.h"
+#endif
+#include "SyntheticAudioSource.h"
+#include "VideoSource.h"
+#include "Y4mWriter.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// What a headless run does. Every key can be given as a flag (--frames 600) or as a
+// "key = value" line in a config file (--config run.conf); flags after --config win.
+struct HeadlessConfig
+{
+    std::string source;              // "x11", "dxgi" or "synthetic"; empty = this platform's display capture
+    std::string display;             // X11 display name, empty = $DISPLAY
+    int frames = 0;                  // stop after this many composed frames, 0 = no limit
+    double seconds = 10.0;           // stop after this long, 0 = no limit
+    int fps = 60;                    // capture rate, 0 = as fast as the source delivers
+    std::vector<Rendition> renditions; // scaled outputs, e.g. "1280x720,640x360"
+    std::string output;              // .y4m file of the first rendition (the canvas if none)
+    int threads = 0;                 // pool threads, 0 = one per core
+    bool bench = false;              // run flat out and add the scheduler scaling table
+    std::string trace;               // Chrome trace JSON written at the end, empty = no tracing
+    int metricsPort = 0;             // serve Prometheus metrics on 127.0.0.1, 0 = off
+    std::string shmOutput;           // publish the output frames to this shared-memory ring (Linux)
+    std::string recordTrace;         // capture trace of the source (frames, cursor, audio) for replay
+    std::string replay;              // capture trace to play back as the source
+    bool replayRealtime = false;     // keep the recorded timing instead of going flat out
+    bool loop = false;               // start the replay over when it ends
+
+    // Synthetic source
+    std::string workload = "typing"; // SyntheticSource script, e.g. "typing:300,drag:120,noise"
+    int width = 1920;                // "resolution" key, WxH
+    int height = 1080;
+    int seed = 1;
+    std::string audio;               // SyntheticAudioSource script, e.g. "tone:1,noise:1"; empty = no audio
+    std::string audioFormat = "f32"; // u8, s16, s24, s32 or f32, interleaved
+    int audioRate = 48000;
+    int audioChannels = 2;
+    std::string audioOutput;         // .flac of the generated audio
+
+    bool parseArgs(int argc, char** argv, std::string& error);
+    bool loadFile(const std::string& path, std::string& error);
+    bool set(const std::string& key, const std::string& value, std::string& error);
+
+    static const char* usage();
+};
+
+// Capture -> compose -> scale -> write, without any UI. Runs on the calling thread
+// (stages fan out on the pool) until the frame or time limit, then prints per-stage
+// latency and throughput. In --bench mode it also fails the run if a warmed-up frame
+// allocates, when built with OBS_COUNT_ALLOCATIONS.
+class HeadlessPipeline
+{
+public:
+    explicit HeadlessPipeline(const HeadlessConfig& config);
+    ~HeadlessPipeline();
+
+    int run(); // process exit code
+
+    // Display capture, generator or recording named by config.source
+    static std::unique_ptr<VideoSource> createSource(const HeadlessConfig& config, std::string& error);
+
+private:
+    enum Stage
+    {
+        StageCapture,
+        StageCompose,
+        StageScale,
+        StageWrite,
+        StageTotal,
+        StageCount
+    };
+
+    bool prepareAudio(std::string& error);
+    bool startAudio();
+    void pumpAudio();
+    void replayAudio(const CaptureTraceReader::AudioPacket& packet);
+    void processFrame(const SourceFrame& frame, int64_t captureMicros);
+    void printSummary(double elapsedSeconds) const;
+    void collectMetrics(MetricsWriter& writer) const;
+
+    HeadlessConfig m_config;
+    std::unique_ptr<VideoSource> m_source;
+    std::unique_ptr<ThreadPool> m_pool;
+    StartupSequencer m_startup; // source and audio init, side by side
+
+    SceneCompositor m_scene;
+    int m_captureLayerId = 0;
+    ScalerPyramid m_pyramid;
+    int m_pyramidWidth = 0;
+    int m_pyramidHeight = 0;
+    Y4mWriter m_writer;
+    CaptureTraceWriter m_traceWriter;
+    std::chrono::steady_clock::time_point m_runStart; // trace timestamps count from here
+#ifdef OBS_HAVE_SHM
+    SharedFrameOutput m_shm;
+#endif
+
+    // Atomic where the metrics endpoint reads them
+    LatencyHistogram m_latency[StageCount];
+    std::atomic<uint64_t> m_framesComposed{ 0 };
+    std::atomic<uint64_t> m_duplicates{ 0 };  // source frames identical to the previous one
+    std::atomic<uint64_t> m_emptyPolls{ 0 };  // polls where the source had nothing new
+    std::atomic<uint64_t> m_droppedTicks{ 0 }; // capture ticks skipped because a frame ran long
+    std::atomic<uint64_t> m_shmFrames{ 0 };    // published to the shared-memory ring
+    std::atomic<int> m_shmReaders{ -1 };       // attached to it as of the last publish, -1 = no ring
+    uint64_t m_steadyAllocations = 0; // after warm-up, OBS_COUNT_ALLOCATIONS builds only
+    int m_sourceWidth = 0;
+    int m_sourceHeight = 0;
+
+    // Synthetic audio, generated in real time on its own lane and measured as if captured
+    SyntheticAudioSource m_audioSource;
+    SampleConverter m_audioToFloat;
+    std::vector<uint8_t> m_audioPacket;
+    std::vector<float> m_audioFloat;
+    LoudnessMeter m_loudness;
+    FlacRecorder m_flac;
+    std::chrono::steady_clock::time_point m_audioStart;
+    SampleFormat m_replayFormat = SampleFormat::F32;
+    std::atomic<uint64_t> m_audioFrames{ 0 };
+    RealtimeLane m_audioLane; // after what the tick uses
+
+    MetricsServer m_metricsServer;
+    MetricsRegistration m_metrics; // last, so it is removed before anything it reads
+};
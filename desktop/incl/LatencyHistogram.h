@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Latency distribution in microseconds with fixed log-linear buckets: exact below 8 us,
+// then 8 buckets per power of two (within 12.5%) up to about 25 days. Recording is a
+// handful of relaxed atomic adds and never allocates; one thread records, any thread
+// may read quantiles while it does (they may be a sample or two behind).
+class LatencyHistogram
+{
+public:
+    static constexpr int kSubBuckets = 8;
+    static constexpr int kMaxExponent = 40;
+    static constexpr int kBucketCount = kSubBuckets + (kMaxExponent - 2) * kSubBuckets;
+
+    void record(int64_t micros);
+    void reset();
+
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+    uint64_t sumMicros() const { return m_sum.load(std::memory_order_relaxed); }
+    double meanMicros() const;
+    int64_t maxMicros() const { return static_cast<int64_t>(m_max.load(std::memory_order_relaxed)); }
+
+    // Upper edge of the bucket holding quantile q (0..1), 0 when empty
+    int64_t quantileMicros(double q) const;
+
+    static int bucketFor(uint64_t micros);
+    static uint64_t bucketUpper(int bucket);
+
+private:
+    std::atomic<uint64_t> m_buckets[kBucketCount] = {};
+    std::atomic<uint64_t> m_count{ 0 };
+    std::atomic<uint64_t> m_sum{ 0 };
+    std::atomic<uint64_t> m_max{ 0 };
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// ITU-R BS.1770 / EBU R128 loudness of one audio stream. Fed with interleaved float
+// blocks of any length; all measurements advance in 100 ms steps. Integrated loudness
+// and loudness range come from fixed-size histograms of gating blocks, so memory and
+// per-block cost stay constant no matter how long the stream runs.
+class LoudnessMeter
+{
+public:
+    static constexpr int kMaxChannels = 8;
+    static constexpr double kSilence = -100.0; // Reported while there is nothing to measure
+
+    struct Snapshot
+    {
+        double momentary = kSilence;  // LUFS over the last 400 ms
+        double shortTerm = kSilence;  // LUFS over the last 3 s
+        double integrated = kSilence; // Gated LUFS since reset()
+        double range = 0.0;           // LRA in LU
+    };
+
+    LoudnessMeter() = default;
+
+    // Channel weights follow the WAVE order: L R C LFE Ls Rs ...
+    bool configure(int sampleRate, int channels);
+    void setChannelWeight(int channel, double weight);
+    void reset();
+
+    void process(const float* interleaved, int frames);
+
+    // Values as of the last completed 100 ms step
+    const Snapshot& snapshot() const { return m_snapshot; }
+
+    int sampleRate() const { return m_sampleRate; }
+    int channels() const { return m_channels; }
+
+private:
+    // Gating block loudness histogram: counts and summed energy per 0.01 LU bin
+    class Histogram
+    {
+    public:
+        Histogram();
+        void clear();
+        void add(double energy);
+
+        // Mean loudness of the blocks at least relativeGate LU below the mean of all blocks
+        double gatedLoudness(double relativeGate) const;
+        // Spread between the low and high percentiles of the relatively gated blocks
+        double range(double relativeGate, double lowPercentile, double highPercentile) const;
+
+    private:
+        int gateBin(double relativeGate) const;
+
+        std::vector<uint32_t> m_counts;
+        std::vector<double> m_energy;
+        uint64_t m_totalCount = 0;
+        double m_totalEnergy = 0.0;
+    };
+
+    struct Biquad
+    {
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+    };
+
+    void finishSubBlock();
+
+    int m_sampleRate = 0;
+    int m_channels = 0;
+    int m_subBlockFrames = 0;  // 100 ms
+
+    Biquad m_shelf;            // K-weighting stage 1
+    Biquad m_highPass;         // K-weighting stage 2 (RLB)
+    double m_state[kMaxChannels][4] = {};
+    double m_weight[kMaxChannels] = {};
+
+    // Weighted energy of the last 30 sub-blocks (3 s)
+    static constexpr int kSubBlocks = 30;
+    double m_subBlockEnergy[kSubBlocks] = {};
+    int m_subBlockIndex = 0;
+    int m_subBlocksSeen = 0;
+    int m_framesInSubBlock = 0;
+    double m_energyAccumulator = 0.0;
+
+    Histogram m_momentaryBlocks;
+    Histogram m_shortTermBlocks;
+    Snapshot m_snapshot;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 3D color lookup table (.cube, typically 17^3/33^3/65^3) applied with tetrahedral
+// interpolation. Works as a FilterChain per-pixel filter on BGRA frames, e.g. in place
+// across strips of the shared pool:
+//
+//     FilterChain<Lut3D> grade(lut);
+//     grade.process(frame, frame, &ThreadPool::instance());
+class Lut3D
+{
+public:
+    Lut3D() = default;
+
+    bool loadCube(const std::string& path, std::string* error = nullptr);
+    bool parseCube(std::istream& in, std::string* error = nullptr);
+
+    // LUT that maps every color to itself, mainly for checking the interpolation
+    static Lut3D identity(int size);
+
+    bool isValid() const { return m_data != nullptr; }
+    int size() const { return m_data ? m_data->size : 0; }
+    const std::string& title() const;
+
+    // Exact output for one color in 0..1 (double precision, no per-byte tables)
+    void lookup(double r, double g, double b, double out[3]) const;
+
+    void apply(uint8_t* bgra, int count) const;
+
+private:
+    struct Data
+    {
+        int size = 0;
+        std::string title;
+        float domainMin[3] = { 0.0f, 0.0f, 0.0f };
+        float domainMax[3] = { 1.0f, 1.0f, 1.0f };
+
+        // RGB plus padding per entry so each corner is one aligned 16-byte load.
+        // Red varies fastest, as in the .cube file.
+        std::vector<float> table;
+
+        // Per input byte and channel: cell index and position inside the cell
+        uint16_t cell[3][256];
+        float frac[3][256];
+    };
+
+    static void buildInputTables(Data& data);
+
+    std::shared_ptr<const Data> m_data;
+};
@@ -1,13 +1,26 @@
 #pragma once
 
 #include "VolumeMeter.h"
+#include "PreviewWidget.h"
+#include "SpectrumWidget.h"
 #include <QMainWindow>
 #include <QTimer>
 #include <QLabel>
+#include <QPushButton>
 #include <QProgressBar>
 #include <QDateTime>
+#include <QStringList>
 #include "ScreenCapture.h"
 #include "AudioCapture.h"
+#include "SceneCompositor.h"
+#include "FilterChain.h"
+#include "VideoFilters.h"
+#include "LatencyHistogram.h"
+#include "Metrics.h"
+#include "MetricsServer.h"
+#include "StartupSequencer.h"
+#include "DeviceRecovery.h"
+#include <atomic>
 
 class MainWindow : public QMainWindow
 {
@@ -20,17 +33,32 @@ private slots:
     void updateScreenCapture();
     void updateAudioVolume();
     void updateFPS();
+    void toggleAudioRecording();
+    void toggleTracing();
 
 private:
     void setupUi();
+    void onStartupPhase(const StartupSequencer::Phase& phase);
+    void startScreenCapture();
+    void startAudioCapture();
+    void setDbLabel(QLabel* label, float dbLevel);
+    void collectMetrics(MetricsWriter& writer) const;
 
     // Screen capture related
     ScreenCapture m_screenCapture;
     QTimer m_captureTimer;
-    QLabel* m_displayLabel;
+    PreviewWidget* m_preview;
     int m_displayWidth;
     int m_displayHeight;
 
+    // Scene composited from all sources, shown in the preview
+    SceneCompositor m_scene;
+    int m_captureLayerId = 0;
+    ChangeMap m_changes; // reused every frame
+
+    // Canvas -> preview size in the preview's RGB32 format
+    FilterChain<ForceOpaque> m_previewChain{ ForceOpaque() };
+
     // Audio capture related
     AudioCapture m_audioCapture;
     QTimer m_volumeTimer;
@@ -40,17 +68,45 @@ private:
 
     VolumeMeter* m_inputMeter = nullptr;   // Mic/Aux
     VolumeMeter* m_outputMeter = nullptr;  // Desktop Audio
+    SpectrumWidget* m_outputSpectrum = nullptr;
 
     QLabel* m_inputDbLabel = nullptr;
     QLabel* m_outputDbLabel = nullptr;
+    int m_volumeTicks = 0;
+
+    // Screen and both audio devices come up in the background while the window shows;
+    // after the capture objects, so its threads are joined before those go away
+    StartupSequencer m_startup;
+    DeviceRecovery m_screenRecovery{ DeviceRecovery::Settings{ "screen capture", 50, 2000 } }; // after ACCESS_LOST
+    int m_startupPending = 0;
+    int m_audioDevicesPending = 2;
+    int m_audioDevicesUp = 0;
+    QStringList m_startupFailures;
 
     // FPS and metrics tracking
     QTimer m_fpsUpdateTimer;
     qint64 m_lastFrameTime;
     int m_frameCount;
+    qint64 m_latencySum = 0;
     QLabel* m_fpsLabel;
     QLabel* m_latencyLabel;
+    QLabel* m_previewStatsLabel;
+    QPushButton* m_recordAudioButton = nullptr;
+    QPushButton* m_traceButton = nullptr;
+    quint64 m_lastPresented = 0;
+    quint64 m_lastSkipped = 0;
 
     float m_smoothedVolume = -60.0f; // Initialize to minimum value
     QString m_currentBarColor = "#4CAF50"; // Start with green
+
+    // Prometheus text metrics at http://127.0.0.1:9464/metrics
+    static constexpr int kMetricsPort = 9464;
+    MetricsServer m_metricsServer;
+    LatencyHistogram m_captureLatency;
+    LatencyHistogram m_composeLatency;
+    LatencyHistogram m_previewLatency;
+    LatencyHistogram m_frameLatency;
+    std::atomic<uint64_t> m_duplicateFrames{ 0 };
+    std::atomic<uint64_t> m_droppedFrames{ 0 }; // preview frames replaced before they were painted
+    MetricsRegistration m_metrics; // last, so it is removed before anything it reads
 };
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class LatencyHistogram;
+class MetricsRegistry;
+
+// Formats samples in the Prometheus text exposition format. HELP and TYPE go out with
+// the first sample of a metric; later samples of it, from the same collector or another
+// one, are moved up behind the ones already written, so every family stays one block.
+// Labels are passed preformatted, e.g. "stage=\"capture\"".
+class MetricsWriter
+{
+public:
+    void counter(const char* name, const char* help, double value, const char* labels = nullptr);
+    void gauge(const char* name, const char* help, double value, const char* labels = nullptr);
+
+    // p50/p90/p99 plus _sum and _count, in seconds
+    void summary(const char* name, const char* help, const LatencyHistogram& histogram, const char* labels = nullptr);
+
+private:
+    friend class MetricsRegistry;
+
+    struct Family
+    {
+        const char* name;
+        size_t end; // offset in m_out just past the family's last sample
+    };
+
+    // Only scrapes make writers; the registry keeps the family list between them
+    MetricsWriter(std::string& out, std::vector<Family>& families) : m_out(out), m_families(families) {}
+
+    void family(const char* name, const char* help, const char* type);
+    void sample(const char* name, const char* suffix, const char* labels, const char* extraLabel, double value);
+
+    std::string& m_out;
+    std::vector<Family>& m_families;
+    size_t m_current = 0; // index in m_families of the metric being written
+};
+
+// Removes its collector from the registry when destroyed. Make it the last member of
+// the object whose state the collector reads, so it goes first and no scrape can still
+// be reading the members behind it.
+class MetricsRegistration
+{
+public:
+    MetricsRegistration() = default;
+    ~MetricsRegistration() { reset(); }
+
+    MetricsRegistration(MetricsRegistration&& other) noexcept;
+    MetricsRegistration& operator=(MetricsRegistration&& other) noexcept;
+    MetricsRegistration(const MetricsRegistration&) = delete;
+    MetricsRegistration& operator=(const MetricsRegistration&) = delete;
+
+    void reset();
+
+private:
+    friend class MetricsRegistry;
+    MetricsRegistration(MetricsRegistry* registry, int id) : m_registry(registry), m_id(id) {}
+
+    MetricsRegistry* m_registry = nullptr;
+    int m_id = 0;
+};
+
+// Every component that exports metrics adds a collector that writes its current
+// values. Collectors run on the scraping thread and must only read atomics (counters,
+// LatencyHistogram, ring positions), never take locks the pipeline takes, so a scrape
+// can't stall capture. The registry's own mutex is only held by scrapes and by adding
+// or removing collectors. The buffer pool's figures are always included.
+class MetricsRegistry
+{
+public:
+    using Collector = std::function<void(MetricsWriter&)>;
+
+    static MetricsRegistry& instance();
+
+    MetricsRegistration add(Collector collector);
+
+    // Everything in text format, version 0.0.4. Appends to out, so a caller that keeps
+    // the string scrapes without allocating once it has grown.
+    void scrape(std::string& out);
+
+private:
+    friend class MetricsRegistration;
+    void remove(int id);
+
+    std::mutex m_mutex;
+    std::vector<std::pair<int, Collector>> m_collectors;
+    std::vector<MetricsWriter::Family> m_families; // scrape scratch, kept for its capacity
+    int m_nextId = 1;
+};
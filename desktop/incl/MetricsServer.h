@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+class MetricsRegistry;
+
+// Minimal HTTP server on 127.0.0.1 that answers GET /metrics with a scrape of the
+// registry, for Prometheus or a quick curl. One thread, one request per connection;
+// it only ever touches the pipeline through the registry's collectors.
+class MetricsServer
+{
+public:
+    MetricsServer() = default;
+    ~MetricsServer() { stop(); }
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    // port 0 picks a free one, see port()
+    bool start(int port, MetricsRegistry& registry);
+    bool start(int port);
+    void stop();
+
+    bool isRunning() const { return m_thread.joinable(); }
+    int port() const { return m_port; }
+    const std::string& lastError() const { return m_error; }
+
+private:
+    void run();
+    void serve(intptr_t client);
+
+    MetricsRegistry* m_registry = nullptr;
+    intptr_t m_listenSocket = -1;
+    int m_port = 0;
+    std::string m_error;
+    std::string m_body;     // server thread; kept so steady scrapes don't allocate
+    std::string m_response;
+    std::thread m_thread;
+    std::atomic<bool> m_stopping{ false };
+};
@@ -3,6 +3,7 @@
 #include <d3d11.h>
 #include <dxgi1_2.h>
 #include <windows.h>
+#include "BufferPool.h"
 
 struct PTR_INFO
 {
@@ -17,15 +18,7 @@ struct PTR_INFO
     {
     }
 
-    ~PTR_INFO()
-    {
-        if (PtrShapeBuffer)
-        {
-            delete[] PtrShapeBuffer;
-            PtrShapeBuffer = nullptr;
-        }
-    }
-
+    PooledBuffer ShapeStorage; // backs PtrShapeBuffer
     BYTE* PtrShapeBuffer;
     UINT BufferSize;
     UINT WhoUpdatedPositionLast;
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QWidget>
+#include <QTimer>
+#include <QImage>
+#include "VideoFrame.h"
+
+// Shows the latest composited frame. The producer renders straight into the widget's
+// own RGB32 buffer and calls present(); the widget repaints at most once per display
+// refresh and draws that buffer 1:1 without converting or allocating per frame.
+class PreviewWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PreviewWidget(QWidget* parent = nullptr);
+
+    // Largest size with the given aspect ratio that fits the widget
+    QSize fitSize(const QSize& source) const;
+
+    // Buffer for the next frame; only reallocated when the size changes
+    FrameView frameBuffer(const QSize& size);
+
+    // Publishes the buffer. Frames replaced before they were painted count as skipped.
+    void present();
+
+    quint64 presentedFrames() const { return m_presented; }
+    quint64 skippedFrames() const { return m_skipped; }
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void showEvent(QShowEvent* event) override;
+
+private:
+    void updateRefreshInterval();
+    void onRefresh();
+
+    FrameBuffer m_buffer;
+    QImage m_image;           // Wraps m_buffer, rewrapped on resize only
+    QTimer m_refreshTimer;
+    QRect m_imageRect;        // Where the last frame was drawn
+
+    bool m_pending = false;   // Presented but not painted yet
+    bool m_repaintQueued = false;
+    quint64 m_presented = 0;
+    quint64 m_skipped = 0;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Dedicated thread for work that has to keep its cadence whatever the video pipeline is
+// doing, i.e. audio. It never takes ThreadPool jobs, runs at raised OS priority (MMCSS
+// "Pro Audio" on Windows, SCHED_FIFO on Linux where permitted) and can be pinned to a
+// core, so a busy frame can delay it by a context switch at most. The tick runs every
+// period, or right away after wake().
+class RealtimeLane
+{
+public:
+    struct Settings
+    {
+        std::string name = "realtime";
+        int periodMs = 10;
+        int core = -1; // pin to this core, -1 = let the OS pick
+    };
+
+    RealtimeLane() = default;
+    ~RealtimeLane() { stop(); }
+
+    RealtimeLane(const RealtimeLane&) = delete;
+    RealtimeLane& operator=(const RealtimeLane&) = delete;
+
+    bool start(std::function<void()> tick, const Settings& settings);
+    bool start(std::function<void()> tick) { return start(std::move(tick), Settings()); }
+    void stop();
+    void wake();
+
+    bool isRunning() const { return m_thread.joinable(); }
+    bool isElevated() const { return m_elevated.load(std::memory_order_relaxed); } // priority raise took effect
+    uint64_t overruns() const { return m_overruns.load(std::memory_order_relaxed); } // ticks that ran past the next one's slot
+
+private:
+    void run();
+    bool raisePriority();
+
+    Settings m_settings;
+    std::function<void()> m_tick;
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+    bool m_woken = false;
+    std::atomic<bool> m_elevated{ false };
+    std::atomic<uint64_t> m_overruns{ 0 };
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "DeviceRecovery.h"
+#include "FrameChangeDetector.h"
+#include "VideoFrame.h"
+#include "VideoSource.h"
+#include <atomic>
+#include <memory>
+
+// Wraps a live source so that losing the device doesn't stall the pipeline: while
+// DeviceRecovery brings it back in the background, every call returns a copy of the
+// last good frame, marked held and with nothing changed, so no tick goes without one.
+class RecoveringSource : public VideoSource
+{
+public:
+    explicit RecoveringSource(std::unique_ptr<VideoSource> inner,
+        const DeviceRecovery::Settings& settings = DeviceRecovery::Settings());
+    ~RecoveringSource() override;
+
+    const char* name() const override { return m_inner->name(); }
+    bool initialize() override;
+    bool acquireFrame(SourceFrame& frame) override;
+    bool atEnd() const override { return m_inner->atEnd(); }
+
+    const DeviceRecovery& recovery() const { return m_recovery; }
+    uint64_t heldFrames() const { return m_heldFrames.load(std::memory_order_relaxed); } // any thread
+
+private:
+    bool acquireHeld(SourceFrame& frame);
+
+    std::unique_ptr<VideoSource> m_inner;
+    DeviceRecovery m_recovery;
+    FrameView m_last;       // the inner source's last frame, readable until it reinitializes
+    FrameBuffer m_held;     // sized with every new frame size, copied from m_last when the device is lost
+    bool m_hasHeld = false;
+    ChangeMap m_heldChanges; // nothing changed
+    std::atomic<uint64_t> m_heldFrames{ 0 };
+};
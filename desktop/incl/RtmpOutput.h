@@ -0,0 +1,174 @@
+#pragma once
+
+#include "BufferPool.h"
+#include "Flv.h"
+#include "RtmpProtocol.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class MetricsWriter;
+
+// Streams encoded audio and video to an RTMP ingest. The encoder thread pushes packets
+// into a bounded queue and never waits on the network; a socket thread connects,
+// publishes and sends. When the queue backs up because the link can't keep up, video
+// goes in the order that hurts the picture least: disposable frames first, then, past
+// a second threshold, every queued video frame and whatever follows until the next
+// keyframe, so the receiver never gets a frame whose references it lost. Audio and
+// codec configuration are never dropped. bitrateHintKbps() follows what the link
+// actually carries, for an encoder that can adapt its rate.
+//
+//     RtmpOutput output;
+//     output.start(settings);   // connects in the background
+//     output.push(packet);      // per encoded packet, from the encoder thread
+//     encoder.setBitrate(output.bitrateHintKbps());
+//     output.stop(2000);        // flush for up to 2 s, then unpublish
+class RtmpOutput
+{
+public:
+    struct Settings
+    {
+        std::string url;       // rtmp://host[:port]/app
+        std::string streamKey;
+        Flv::Settings stream;  // for onMetaData; videoKbps is also the ceiling of the hint
+        int minVideoKbps = 300; // floor of the hint
+        int queueSlots = 1024;  // packets the queue holds at most
+        int dropDisposableMs = 500; // queued video duration above which disposable frames go
+        int dropReferenceMs = 900;  // ... and above which all video up to the next keyframe goes
+        int connectTimeoutMs = 5000;
+        int stallTimeoutMs = 10000; // the connection fails when nothing could be sent this long
+        int sendBufferBytes = 0;    // SO_SNDBUF; 0 leaves the system default
+    };
+
+    enum class State
+    {
+        Stopped,
+        Connecting,
+        Live,
+        Failed,
+    };
+
+    struct Stats
+    {
+        uint64_t audioPackets = 0;     // pushed
+        uint64_t videoPackets = 0;
+        uint64_t sentPackets = 0;
+        uint64_t sentBytes = 0;        // on the wire, chunk headers included
+        uint64_t dropped[3] = {};      // by EncodedPacket::Priority
+        int queuedPackets = 0;
+        int queuedVideoMs = 0;         // dts span of the video waiting to go out
+        int maxQueuedVideoMs = 0;
+        int linkKbps = 0;              // measured while the link was the bottleneck, 0 = not yet
+        int bitrateHintKbps = 0;
+    };
+
+    RtmpOutput() = default;
+    ~RtmpOutput() { stop(); }
+
+    RtmpOutput(const RtmpOutput&) = delete;
+    RtmpOutput& operator=(const RtmpOutput&) = delete;
+
+    // False on a URL it can't use; connecting happens on the socket thread, see state()
+    bool start(const Settings& settings);
+    // Sends what is queued for up to drainMs, then unpublishes and disconnects
+    void stop(int drainMs = 0);
+
+    // Encoder thread. Copies the packet; packets must come in dts order per type. False
+    // if the output failed, or the queue is full even after dropping all video.
+    bool push(const EncodedPacket& packet);
+
+    // Any thread
+    State state() const { return m_state.load(std::memory_order_acquire); }
+    bool waitUntilLive(int timeoutMs); // false if it failed or took longer
+    std::string lastError() const;
+    int bitrateHintKbps() const { return m_hintKbps.load(std::memory_order_relaxed); }
+    Stats stats() const;
+    void collectMetrics(MetricsWriter& writer) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Slot
+    {
+        EncodedPacket packet; // data points into buffer
+        PooledBuffer buffer;
+        bool dropped = false;
+    };
+
+    void run();
+    bool connectAndPublish();
+    bool sendCommand(const std::vector<uint8_t>& payload, uint32_t streamId);
+    bool awaitResult(double transaction, std::vector<uint8_t>& payload);
+    bool awaitPublishStart();
+    bool sendBytes(const uint8_t* data, size_t size);
+    bool receive(int timeoutMs);
+    bool handleIncoming(const Rtmp::Message& message);
+    bool flushControl();
+    Clock::time_point giveUpAt(); // when a send in progress should stop trying
+    void unpublish();
+    void fail(const std::string& error);
+
+    // Under m_mutex
+    Slot& slotAt(int index) { return m_slots[(m_head + index) % m_slots.size()]; }
+    void popFront();
+    void dropQueuedVideo(EncodedPacket::Priority upTo);
+    void compact();
+    void updateQueuedVideo();
+
+    void updateHint(Clock::time_point now);
+
+    Settings m_settings;
+    Rtmp::Url m_url;
+    std::thread m_thread;
+    std::atomic<State> m_state{ State::Stopped };
+    intptr_t m_socket = -1;
+
+    // Queue, shared with the encoder thread
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::vector<Slot> m_slots;
+    size_t m_head = 0;
+    int m_count = 0;
+    bool m_sendingHead = false; // the socket thread is sending slotAt(0); leave it alone
+    bool m_dropToKeyframe = false;
+    int64_t m_newestVideoDts = 0;
+    bool m_stopping = false;
+    Clock::time_point m_drainDeadline;
+    std::string m_error;
+
+    // Socket thread only
+    RtmpChunkWriter m_writer;
+    RtmpChunkReader m_reader;
+    Rtmp::Message m_message;
+    std::vector<uint8_t> m_chunks;
+    std::vector<uint8_t> m_control;     // pongs and acks, sent between messages
+    std::vector<uint8_t> m_controlSending;
+    std::vector<uint8_t> m_receiveBuffer;
+    std::vector<std::vector<uint8_t>> m_pendingCommands; // while connecting
+    uint32_t m_streamId = 0;
+    uint64_t m_receivedBytes = 0;
+    uint64_t m_ackedBytes = 0;
+    uint32_t m_ackWindow = 2500000;
+    Clock::time_point m_lastProgress;
+    bool m_unpublishing = false;
+    Clock::time_point m_unpublishBy;
+    Clock::time_point m_windowStart;
+    uint64_t m_windowBytes = 0;
+    int64_t m_windowIdleUs = 0; // waiting with nothing to send, within the window
+
+    std::atomic<uint64_t> m_audioPackets{ 0 };
+    std::atomic<uint64_t> m_videoPackets{ 0 };
+    std::atomic<uint64_t> m_sentPackets{ 0 };
+    std::atomic<uint64_t> m_sentBytes{ 0 };
+    std::atomic<uint64_t> m_dropped[3] = {};
+    std::atomic<int> m_queuedPackets{ 0 };
+    std::atomic<int> m_queuedVideoMs{ 0 };
+    std::atomic<int> m_maxQueuedVideoMs{ 0 };
+    std::atomic<int> m_linkKbps{ 0 };
+    std::atomic<int> m_hintKbps{ 0 };
+};
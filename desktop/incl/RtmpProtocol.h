@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// RTMP wire format: handshake sizes, message types and the chunk stream that carries
+// messages, split into chunks of at most the negotiated chunk size with headers
+// compressed against the previous message on the same chunk stream.
+namespace Rtmp
+{
+    constexpr int kDefaultPort = 1935;
+    constexpr uint8_t kVersion = 3;
+    constexpr size_t kHandshakeBytes = 1536;
+    constexpr uint32_t kDefaultChunkSize = 128;
+    constexpr uint32_t kMaxChunkSize = 1 << 24;
+    constexpr uint32_t kMaxMessageBytes = 1 << 24; // the length field is 24 bits
+
+    enum MessageType : uint8_t
+    {
+        SetChunkSize = 1,
+        Abort = 2,
+        Acknowledgement = 3,
+        UserControl = 4,
+        WindowAckSize = 5,
+        SetPeerBandwidth = 6,
+        AudioMessage = 8,
+        VideoMessage = 9,
+        DataMessage = 18,    // AMF0
+        CommandMessage = 20, // AMF0
+    };
+
+    enum UserControlEvent : uint16_t
+    {
+        StreamBegin = 0,
+        PingRequest = 6,
+        PingResponse = 7,
+    };
+
+    // Chunk streams this code sends on; the ids are only a convention
+    enum ChunkStream : uint32_t
+    {
+        ControlChunks = 2, // must be 2 for protocol control messages
+        CommandChunks = 3,
+        DataChunks = 4,
+        AudioChunks = 5,
+        VideoChunks = 6,
+    };
+
+    struct Message
+    {
+        uint32_t chunkStream = 0;
+        uint8_t type = 0;
+        uint32_t streamId = 0;
+        uint32_t timestamp = 0;
+        std::vector<uint8_t> payload;
+    };
+
+    // rtmp://host[:port]/app[/instance][?query]. tcUrl is the URL as given.
+    struct Url
+    {
+        std::string host;
+        int port = kDefaultPort;
+        std::string app;
+        std::string tcUrl;
+    };
+
+    bool parseUrl(const std::string& url, Url& out, std::string& error);
+
+    // C1 or S1: time, zero, then bytes the peer echoes back
+    void fillHandshake(uint8_t block[kHandshakeBytes], uint32_t timeMs);
+
+    // Payloads of the protocol control messages
+    void putBig32(uint8_t* p, uint32_t value);
+    uint32_t big32(const uint8_t* p);
+}
+
+// Splits messages into chunks. Remembers the last header per chunk stream, so a
+// message on the same stream that only moves the clock costs a 4-byte header.
+class RtmpChunkWriter
+{
+public:
+    void setChunkSize(uint32_t bytes) { m_chunkSize = bytes; }
+    uint32_t chunkSize() const { return m_chunkSize; }
+
+    // Appends the chunks of one message. The payload comes in two parts, head and
+    // data, so an FLV body header doesn't have to be copied in front of the packet.
+    void write(std::vector<uint8_t>& out, uint32_t chunkStream, uint8_t type, uint32_t streamId, uint32_t timestamp,
+        const uint8_t* head, size_t headSize, const uint8_t* data, size_t size);
+    void write(std::vector<uint8_t>& out, uint32_t chunkStream, uint8_t type, uint32_t streamId, uint32_t timestamp,
+        const std::vector<uint8_t>& payload)
+    {
+        write(out, chunkStream, type, streamId, timestamp, nullptr, 0, payload.data(), payload.size());
+    }
+
+private:
+    static constexpr uint32_t kStreams = 64; // ids that fit the one-byte basic header
+
+    struct StreamState
+    {
+        bool used = false;
+        uint8_t type = 0;
+        uint32_t streamId = 0;
+        uint32_t timestamp = 0;
+        uint32_t length = 0;
+    };
+
+    uint32_t m_chunkSize = Rtmp::kDefaultChunkSize;
+    StreamState m_streams[kStreams];
+};
+
+// Reassembles messages from received bytes. Applies Set Chunk Size messages itself,
+// since they change how the very next chunk is framed, and passes them on as well.
+class RtmpChunkReader
+{
+public:
+    void append(const uint8_t* data, size_t size);
+
+    // The next complete message; false until one is in or once the stream turned out malformed
+    bool next(Rtmp::Message& message);
+
+    bool failed() const { return !m_error.empty(); }
+    const std::string& error() const { return m_error; }
+    uint32_t chunkSize() const { return m_chunkSize; }
+
+private:
+    struct StreamState
+    {
+        uint8_t type = 0;
+        uint32_t streamId = 0;
+        uint32_t timestamp = 0;
+        uint32_t timestampField = 0; // as last sent: absolute for type 0, else the delta
+        uint32_t length = 0;
+        bool extended = false;       // continuation chunks repeat the extended timestamp
+        bool started = false;
+        std::vector<uint8_t> payload; // of the message in progress
+    };
+
+    bool fail(const char* error);
+    StreamState& stream(uint32_t chunkStream);
+
+    std::vector<uint8_t> m_buffer;
+    size_t m_readAt = 0;
+    uint32_t m_chunkSize = Rtmp::kDefaultChunkSize;
+    std::vector<std::pair<uint32_t, StreamState>> m_streams; // a handful at most
+    std::string m_error;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum class SampleFormat
+{
+    U8,   // unsigned 8-bit, 128 = silence
+    S16,
+    S24,  // packed, 3 bytes little endian
+    S32,
+    F32,  // -1..1
+};
+
+int bytesPerSample(SampleFormat format);
+
+// Converts audio between sample formats and between interleaved and planar layouts.
+// The kernel for the (source format, destination format, layout) combination is
+// picked once in configure(), so convert() runs without per-sample branching:
+//
+//     SampleConverter converter;
+//     converter.configure(SampleFormat::S24, false, SampleFormat::F32, true, 2);
+//     converter.convert(&packet, planes, frames);
+//
+// Interleaved buffers are passed as a single pointer, planar ones as one pointer per
+// channel. Float to 8/16-bit integer adds triangular (TPDF) dither.
+class SampleConverter
+{
+public:
+    static constexpr int kMaxChannels = 8;
+
+    bool configure(SampleFormat srcFormat, bool srcPlanar, SampleFormat dstFormat, bool dstPlanar, int channels);
+    bool isConfigured() const { return m_kernel != nullptr; }
+
+    void convert(const void* const* src, void* const* dst, int frames);
+
+    // Shorthand for interleaved -> interleaved
+    void convert(const void* src, void* dst, int frames) { convert(&src, &dst, frames); }
+
+    int channels() const { return m_channels; }
+
+    // State shared with the kernels
+    struct Job
+    {
+        const uint8_t* const* src;
+        uint8_t* const* dst;
+        int frames;
+        int channels;
+        uint32_t* dither; // kDitherLanes xorshift states
+    };
+    static constexpr int kDitherLanes = 8;
+
+private:
+    using Kernel = void (*)(const Job& job);
+
+    Kernel m_kernel = nullptr;
+    int m_channels = 0;
+    uint32_t m_dither[kDitherLanes] = { 0x9E3779B9u, 0x7F4A7C15u, 0x85EBCA6Bu, 0xC2B2AE35u,
+        0x27D4EB2Fu, 0x165667B1u, 0xD3A2646Cu, 0xFD7046C5u };
+};
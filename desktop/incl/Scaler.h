@@ -0,0 +1,49 @@
+#pragma once
+
+#include "VideoFrame.h"
+#include <cstdint>
+#include <vector>
+
+// Separable BGRA resampler. Downscaling averages the covered source area, upscaling
+// is bilinear. Output rows can be produced independently, so callers can split a
+// frame into strips and scale them on different threads.
+class Scaler
+{
+public:
+    bool configure(int srcWidth, int srcHeight, int dstWidth, int dstHeight);
+
+    int srcWidth() const { return m_srcWidth; }
+    int srcHeight() const { return m_srcHeight; }
+    int dstWidth() const { return m_dstWidth; }
+    int dstHeight() const { return m_dstHeight; }
+
+    // Source rows [first, last) that output row dstY reads from
+    void sourceRows(int dstY, int* first, int* last) const;
+
+    // Scale output rows [dstY0, dstY1) of src into dst
+    void scaleRows(const FrameView& src, const FrameView& dst, int dstY0, int dstY1) const;
+
+    // Scale the whole frame on the calling thread
+    void scale(const FrameView& src, const FrameView& dst) const;
+
+private:
+    // Contributions of source pixels to one output pixel, weights sum to 1 << kWeightBits
+    struct Taps
+    {
+        int first = 0;
+        int count = 0;
+        int offset = 0; // into m_weights
+    };
+
+    static void buildTaps(int srcSize, int dstSize, std::vector<Taps>& taps, std::vector<int16_t>& weights);
+
+    int m_srcWidth = 0;
+    int m_srcHeight = 0;
+    int m_dstWidth = 0;
+    int m_dstHeight = 0;
+
+    std::vector<Taps> m_xTaps;
+    std::vector<Taps> m_yTaps;
+    std::vector<int16_t> m_xWeights;
+    std::vector<int16_t> m_yWeights;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Scaler.h"
+#include "VideoFrame.h"
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+struct ChangeMap;
+
+struct Rendition
+{
+    int width = 0;
+    int height = 0;
+};
+
+// Produces several renditions of one frame (e.g. 1080p/720p/480p for simulcast).
+// Levels that must read the source are scaled together strip by strip, so each source
+// strip is pulled into cache once for all of them. Smaller levels are derived from the
+// previous level instead of the source when the extra resampling step costs no quality.
+class ScalerPyramid
+{
+public:
+    bool configure(int srcWidth, int srcHeight, const std::vector<Rendition>& renditions);
+
+    // Scale src into every rendition. Without a pool everything runs on the caller.
+    // With a change map, strips whose source rows did not change keep their output.
+    void process(const FrameView& src, ThreadPool* pool = nullptr, const ChangeMap* changes = nullptr);
+
+    int levelCount() const { return static_cast<int>(m_levels.size()); }
+
+    // Output for rendition index (same order as passed to configure)
+    FrameView level(int index);
+
+    // Rendition index a level is derived from, or -1 when it reads the source
+    int parentOf(int index) const;
+
+private:
+    struct Level
+    {
+        Rendition size;
+        int parent = -1;
+        Scaler scaler;
+        FrameBuffer output;
+        std::vector<uint8_t> rowChanged; // output rows rewritten by the last process()
+    };
+
+    void processSourceLevels(const FrameView& src, ThreadPool* pool, const ChangeMap* changes);
+    void processDerivedLevel(int index, ThreadPool* pool);
+
+    int m_srcWidth = 0;
+    int m_srcHeight = 0;
+    std::vector<Level> m_levels;
+    std::vector<int> m_sourceLevels;   // read the source
+    std::vector<int> m_derivedOrder;   // parents always come first
+    bool m_hasOutput = false;          // outputs hold a previous frame that can be kept
+};
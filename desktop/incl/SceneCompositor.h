@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Scaler.h"
+#include "VideoFrame.h"
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+struct SceneRect
+{
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+
+    bool isEmpty() const { return width <= 0 || height <= 0; }
+    bool operator==(const SceneRect& o) const { return x == o.x && y == o.y && width == o.width && height == o.height; }
+    bool operator!=(const SceneRect& o) const { return !(*this == o); }
+};
+
+// One source placed on the scene canvas
+struct SceneLayer
+{
+    enum class Kind
+    {
+        Frame,      // display capture, image or any other BGRA frame
+        SolidColor
+    };
+
+    Kind kind = Kind::Frame;
+
+    FrameView source;          // Frame layers; must stay valid until compose()
+    bool premultiplied = false; // source alpha is already premultiplied
+    bool opaque = false;        // ignore source alpha (e.g. desktop capture)
+    SceneRect crop;             // region of source to show, empty = whole source
+
+    uint32_t color = 0xFF000000; // SolidColor layers, 0xAARRGGBB straight alpha
+
+    SceneRect dest;            // placement on the canvas, crop is scaled to fit
+    float opacity = 1.0f;
+    bool visible = true;
+};
+
+// Layers N sources onto a premultiplied BGRA canvas. The canvas is split into tiles
+// that are composed in parallel, and tiles that no layer touched since the last
+// compose() keep their previous contents.
+class SceneCompositor
+{
+public:
+    static constexpr int kTileSize = 64;
+
+    void setCanvasSize(int width, int height);
+    int canvasWidth() const { return m_canvas.width(); }
+    int canvasHeight() const { return m_canvas.height(); }
+
+    // Layers are stacked bottom to top in the order they are added
+    int addLayer(const SceneLayer& layer);
+    void setLayer(int id, const SceneLayer& layer);
+    void removeLayer(int id);
+
+    // The pixels behind a layer's source changed (whole source or a part of it)
+    void markContentChanged(int id);
+    void markContentChanged(int id, const SceneRect& sourceRect);
+
+    // Recompose dirty tiles. Returns the number of tiles redrawn.
+    int compose(ThreadPool* pool = nullptr);
+
+    FrameView canvas() { return m_canvas.view(); }
+
+private:
+    struct LayerState
+    {
+        int id = 0;
+        SceneLayer layer;
+
+        // Layer pixels at destination size, premultiplied
+        Scaler scaler;
+        FrameBuffer prepared;
+        FrameView pixels;
+        bool pixelsOpaque = false;
+        bool needsPrepare = true;
+        SceneRect prepareRect; // dest-relative rows/cols to refresh
+    };
+
+    LayerState* findLayer(int id);
+    SceneRect sourceRect(const SceneLayer& layer) const;
+    bool coversOpaque(const LayerState& state, const SceneRect& rect) const;
+
+    void markDirty(const SceneRect& canvasRect);
+    void markContentDirty(LayerState& state, const SceneRect& destRect);
+    void prepareLayer(LayerState& state, ThreadPool* pool);
+    void composeTile(int tileIndex);
+
+    FrameBuffer m_canvas;
+    std::vector<LayerState> m_layers;
+    int m_nextId = 1;
+
+    int m_tilesX = 0;
+    int m_tilesY = 0;
+    std::vector<uint8_t> m_dirtyTiles;
+    std::vector<int> m_dirtyList;
+};
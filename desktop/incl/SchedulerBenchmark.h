@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+// Scaling of the ThreadPool from 1 to N threads on a synthetic frame. The frame is a
+// TaskGraph shaped like the capture pipeline: capture copy, then change detection and
+// two source scalers side by side, compose, then preview and encoder conversion side by
+// side, with an audio block chain running alongside. Every video task splits its rows
+// into strips with parallelFor, so the numbers include nested parallelism.
+class SchedulerBenchmark
+{
+public:
+    struct Settings
+    {
+        int width = 1920;
+        int height = 1080;
+        int frames = 60;     // timed frames per thread count, after a few warm-up frames
+        int maxThreads = 0;  // 0 = hardware concurrency
+    };
+
+    struct Result
+    {
+        int threads = 0;
+        double msPerFrame = 0.0;
+        double speedup = 0.0;    // against one thread
+        double efficiency = 0.0; // speedup / threads
+    };
+
+    static std::vector<Result> run(const Settings& settings);
+    static std::vector<Result> run() { return run(Settings()); }
+};
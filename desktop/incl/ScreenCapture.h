@@ -1,11 +1,15 @@
 #pragma once
 
 #include <d3d11.h>
-#include <dxgi1_2.h>
+#include <dxgi1_6.h>
 #include <QImage>
 #include <QMutex>
 #include <QCursor>
+#include <atomic>
 #include "PTR_INFO.h"
+#include "FrameChangeDetector.h"
+#include "HdrConverter.h"
+#include "VideoSource.h"
 
 class ScreenCapture
 {
@@ -13,15 +17,36 @@ public:
     ScreenCapture();
     ~ScreenCapture();
 
+    // Again after isLost(), from any thread, as long as captureFrame() isn't running meanwhile
     bool initialize();
     bool captureFrame();
+    bool isLost() const { return m_lost; } // the duplication went away; initialize() again
     QImage getLatestFrame();
+    void getLatestChanges(ChangeMap& out); // tiles that differ from the previous frame; reuses out's storage
+
+    // Pointer moves and shape changes since the last call, from the capture thread.
+    // The shape points into the pointer buffer and stays valid until the next capture.
+    bool takeCursorUpdate(CursorUpdate& out);
+
+    // HDR desktops are captured in FP16 or 10-bit and tone-mapped into the 8-bit frame
+    bool isHdr() const { return m_captureFormat != DXGI_FORMAT_B8G8R8A8_UNORM; }
+    void setToneMapping(const HdrConverter::Settings& settings);
+
+    // Untouched HDR frame as P010 for HDR encoding (no cursor); only filled while enabled
+    void setP010Output(bool enabled);
+    bool getLatestP010(P010Buffer& out);
+
+    // Health counters, readable from any thread
+    uint64_t framesCaptured() const { return m_framesCaptured.load(std::memory_order_relaxed); }
+    uint64_t accumulatedMisses() const { return m_accumulatedMisses.load(std::memory_order_relaxed); } // desktop updates merged because we polled late
+    uint64_t captureErrors() const { return m_captureErrors.load(std::memory_order_relaxed); }
 
 private:
     bool initDirectX();
     bool initDuplication();
     void cleanup();
     HRESULT getMouse(PTR_INFO* ptrInfo, DXGI_OUTDUPL_FRAME_INFO* frameInfo, int offsetX, int offsetY);
+    void prepareCursor(const PTR_INFO* ptrInfo);
     void drawMouse(QImage& image, PTR_INFO* ptrInfo);
 
     // DirectX objects
@@ -30,10 +55,16 @@ private:
     IDXGIOutputDuplication* m_deskDupl = nullptr;
     ID3D11Texture2D* m_acquiredDesktopImage = nullptr;
     ID3D11Texture2D* m_stagingTexture = nullptr;
+    DXGI_FORMAT m_captureFormat = DXGI_FORMAT_B8G8R8A8_UNORM; // what the duplication hands out
+    bool m_lost = false;
 
     // Frame data
     QImage m_latestFrame;
     QMutex m_frameMutex;
+    FrameChangeDetector m_changeDetector;
+    HdrConverter m_hdrConverter;
+    bool m_p010Enabled = false;
+    P010Buffer m_latestP010;
 
     // Screen dimensions
     int m_screenWidth = 0;
@@ -45,7 +76,21 @@ private:
     // Pointer info
     PTR_INFO m_ptrInfo;
 
+    // Cursor converted to color + XOR planes, rebuilt only when the shape changes
+    PooledBuffer m_cursorStorage;
+    int m_cursorWidth = 0;
+    int m_cursorHeight = 0;
+    bool m_cursorShapeChanged = false;
+
+    // Not yet handed out by takeCursorUpdate()
+    bool m_cursorUpdated = false;
+    bool m_cursorShapeUpdated = false;
+
     // Output number
     UINT m_outputNumber = 0;
 
+    std::atomic<uint64_t> m_framesCaptured{ 0 };
+    std::atomic<uint64_t> m_accumulatedMisses{ 0 };
+    std::atomic<uint64_t> m_captureErrors{ 0 };
+
 };
\ No newline at end of file
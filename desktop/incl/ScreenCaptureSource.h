@@ -0,0 +1,23 @@
+#pragma once
+
+#include "FrameChangeDetector.h"
+#include "ScreenCapture.h"
+#include "VideoSource.h"
+#include <QImage>
+
+// The DXGI desktop duplication capture behind the VideoSource interface, so the
+// headless pipeline drives the same capture code as the GUI.
+class ScreenCaptureSource : public VideoSource
+{
+public:
+    const char* name() const override { return "dxgi"; }
+    bool initialize() override;
+    bool acquireFrame(SourceFrame& frame) override;
+    bool isLost() const override { return m_capture.isLost(); }
+
+private:
+    ScreenCapture m_capture;
+    QImage m_frame;      // shares the capture's latest frame until the next acquire
+    ChangeMap m_changes;
+    CursorUpdate m_cursor;
+};
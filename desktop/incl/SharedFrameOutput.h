@@ -0,0 +1,48 @@
+#pragma once
+
+#include "SharedFrameRing.h"
+#include "VideoFrame.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+class ThreadPool;
+
+// Publishes frames into a named POSIX shared-memory ring (see SharedFrameRing) so other
+// processes on the machine - a recorder, an overlay, a virtual camera bridge - can read
+// them in place with SharedFrameReader. One copy per frame into the ring, none per
+// reader, and readers never slow the producer down.
+class SharedFrameOutput
+{
+public:
+    static constexpr int kDefaultSlots = 3;
+
+    SharedFrameOutput() = default;
+    ~SharedFrameOutput() { close(); }
+
+    SharedFrameOutput(const SharedFrameOutput&) = delete;
+    SharedFrameOutput& operator=(const SharedFrameOutput&) = delete;
+
+    // Creates /name (replacing a stale one) for frames up to maxWidth x maxHeight.
+    // More slots give slow readers longer before a frame they hold is reused.
+    bool open(const std::string& name, int maxWidth, int maxHeight, int slots = kDefaultSlots);
+    // Tells readers the producer is gone and removes the name; attached readers keep
+    // their mapping until they close
+    void close();
+    bool isOpen() const { return m_base != nullptr; }
+
+    bool publish(const FrameView& frame, int64_t timestampUs, ThreadPool* pool = nullptr);
+
+    const std::string& name() const { return m_name; }
+    uint64_t framesPublished() const { return m_published.load(std::memory_order_relaxed); }
+    int readers() const; // attached right now, as far as the header knows
+    const std::string& lastError() const { return m_error; }
+
+private:
+    std::string m_name;
+    uint8_t* m_base = nullptr;
+    size_t m_size = 0;
+    SharedFrameRing::Header* m_header = nullptr;
+    std::atomic<uint64_t> m_published{ 0 };
+    std::string m_error;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "SharedFrameRing.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One frame as a reader sees it. The pixels point into the shared segment: no copy is
+// made, but the producer reuses the slot after slotCount - 1 more frames, so check
+// SharedFrameReader::isValid() once done with them.
+struct SharedFrame
+{
+    const uint8_t* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    uint32_t format = SharedFrameRing::Bgra;
+    uint64_t frameNumber = 0;
+    int64_t timestampUs = 0; // producer's capture time
+    int64_t publishedUs = 0; // SharedFrameRing::monotonicMicros() at publish
+    uint64_t sequence = 0;   // slot sequence the frame was read at
+};
+
+// Consumer side of a SharedFrameOutput, for other processes. Depends on nothing but
+// SharedFrameRing, so it can be linked on its own (obs-shm-reader). Attaching and
+// detaching never affect the producer, and a reader is only ever handed the newest
+// frame: one that can't keep up skips frames rather than falling behind.
+//
+//     SharedFrameReader reader;
+//     reader.open("obs-canvas");
+//     SharedFrame frame;
+//     while (reader.waitFrame(frame, 1000)) {
+//         use(frame.data, frame.width, frame.height, frame.stride);
+//         if (!reader.isValid(frame)) { ... the producer lapped us, discard ... }
+//     }
+class SharedFrameReader
+{
+public:
+    SharedFrameReader() = default;
+    ~SharedFrameReader() { close(); }
+
+    SharedFrameReader(const SharedFrameReader&) = delete;
+    SharedFrameReader& operator=(const SharedFrameReader&) = delete;
+
+    bool open(const std::string& name);
+    void close();
+    bool isOpen() const { return m_base != nullptr; }
+
+    // The newest frame published since the last one returned, waiting up to timeoutMs
+    // for it (0 = just poll, -1 = no limit). False on timeout or once the producer closed.
+    bool waitFrame(SharedFrame& frame, int timeoutMs);
+
+    // The slot still holds the frame, so everything read from it so far is consistent
+    bool isValid(const SharedFrame& frame) const;
+
+    // waitFrame() plus a private copy, retried until the copy is consistent; frame.data
+    // then points into dst with a tight stride
+    bool copyFrame(SharedFrame& frame, std::vector<uint8_t>& dst, int timeoutMs);
+
+    bool producerClosed() const;
+    uint64_t skippedFrames() const { return m_skipped; } // published while we weren't looking
+    int maxWidth() const;
+    int maxHeight() const;
+    const std::string& lastError() const { return m_error; }
+
+private:
+    bool readLatest(SharedFrame& frame);
+
+    uint8_t* m_base = nullptr;
+    size_t m_size = 0;
+    SharedFrameRing::Header* m_header = nullptr;
+    uint64_t m_lastSeen = 0; // header.latest of the last frame returned
+    uint64_t m_skipped = 0;
+    std::string m_error;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Layout of the shared-memory frame ring SharedFrameOutput publishes into and
+// SharedFrameReader attaches to. A segment is one header page followed by slotCount
+// slots, and frame n goes to slot n % slotCount. Each slot is a seqlock: its sequence
+// is odd while the producer writes it and 2 * (n + 1) once frame n is complete, so a
+// reader that sees the same even value before and after touching the pixels knows
+// they weren't torn. The producer never waits for readers; one that falls more than
+// slotCount - 1 frames behind skips ahead. Every publish bumps `wake`, a futex idle
+// readers sleep on. Both sides must be the same build (checked through kVersion).
+namespace SharedFrameRing
+{
+    constexpr uint32_t kMagic = 0x4653424F; // "OBSF"
+    constexpr uint32_t kVersion = 1;
+    constexpr size_t kPageSize = 4096;
+    constexpr size_t kSlotHeaderBytes = 64; // pixels start this far into a slot
+    constexpr int kMaxSlots = 16;
+
+    enum PixelFormat : uint32_t
+    {
+        Bgra = 0, // packed 32-bit BGRA, as FrameView
+    };
+
+    struct Header
+    {
+        std::atomic<uint32_t> magic;   // stored last when the segment is ready
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t maxWidth;
+        uint32_t maxHeight;
+        int32_t producerPid;
+        uint64_t slotBytes;            // distance between slots, page aligned
+        std::atomic<uint64_t> latest;  // newest complete frame number + 1, 0 = none yet
+        std::atomic<uint32_t> wake;    // futex word, bumped on every publish
+        std::atomic<uint32_t> waiters; // readers inside futexWait, so idle publishes skip the syscall
+        std::atomic<uint32_t> readers; // attached readers (a crashed one stays counted)
+        std::atomic<uint32_t> closed;  // producer has gone; readers should detach
+    };
+
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence;
+        uint64_t frameNumber;
+        int64_t timestampUs; // producer's capture time, its own clock
+        int64_t publishedUs; // monotonicMicros() when the frame went out
+        uint32_t width;
+        uint32_t height;
+        uint32_t stride;     // bytes per line
+        uint32_t format;     // PixelFormat
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock-free");
+    static_assert(sizeof(Header) <= kPageSize, "header must fit its page");
+    static_assert(sizeof(Slot) <= kSlotHeaderBytes, "slot header must fit before the pixels");
+
+    inline size_t slotBytes(int maxWidth, int maxHeight)
+    {
+        const size_t bytes = kSlotHeaderBytes + static_cast<size_t>(maxWidth) * maxHeight * 4;
+        return (bytes + kPageSize - 1) / kPageSize * kPageSize;
+    }
+
+    inline size_t segmentBytes(int maxWidth, int maxHeight, int slotCount)
+    {
+        return kPageSize + slotBytes(maxWidth, maxHeight) * slotCount;
+    }
+
+    inline Slot* slotFor(uint8_t* base, const Header& header, uint64_t frameNumber)
+    {
+        return reinterpret_cast<Slot*>(base + kPageSize + header.slotBytes * (frameNumber % header.slotCount));
+    }
+
+    // CLOCK_MONOTONIC, comparable between processes
+    int64_t monotonicMicros();
+
+    // Sleeps while *word == expected, up to timeoutMs (-1 = no limit)
+    void futexWait(std::atomic<uint32_t>* word, uint32_t expected, int timeoutMs);
+    void futexWakeAll(std::atomic<uint32_t>* word);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+
+// SSE2 is part of the x86-64 baseline, so kernels can use it without runtime checks
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OBS_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// AVX2 kernels are compiled on every x86 build and picked at run time with cpuHasAvx2()
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define OBS_HAVE_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define OBS_TARGET_AVX2
+#else
+#define OBS_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#endif
+#endif
+
+// True when the CPU and OS support AVX2, FMA and F16C (every AVX2 CPU has the latter two)
+inline bool cpuHasAvx2()
+{
+#if defined(OBS_HAVE_AVX2) && defined(_MSC_VER)
+    static const bool supported = [] {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        const bool fma = (info[2] & (1 << 12)) != 0;
+        const bool f16c = (info[2] & (1 << 29)) != 0;
+        if (!osxsave || !avx || !fma || !f16c || (_xgetbv(0) & 6) != 6) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return supported;
+#elif defined(OBS_HAVE_AVX2)
+    static const bool supported = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c");
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// Highest instruction set kernels may pick. It defaults to everything the CPU has;
+// benchmarks and tests lower it to run the same data through the scalar, SSE2 and
+// AVX2 paths in turn. Set it before the kernels run, not while they do.
+enum class SimdLevel
+{
+    Scalar,
+    Sse2,
+    Avx2,
+};
+
+inline std::atomic<SimdLevel> g_simdLimit{ SimdLevel::Avx2 };
+
+inline void setSimdLevel(SimdLevel level)
+{
+    g_simdLimit.store(level, std::memory_order_relaxed);
+}
+
+inline bool useSse2()
+{
+#ifdef OBS_HAVE_SSE2
+    return g_simdLimit.load(std::memory_order_relaxed) >= SimdLevel::Sse2;
+#else
+    return false;
+#endif
+}
+
+inline bool useAvx2()
+{
+    return g_simdLimit.load(std::memory_order_relaxed) >= SimdLevel::Avx2 && cpuHasAvx2();
+}
+
+// The level kernels actually run at under the current limit
+inline SimdLevel simdLevel()
+{
+    return useAvx2() ? SimdLevel::Avx2 : useSse2() ? SimdLevel::Sse2 : SimdLevel::Scalar;
+}
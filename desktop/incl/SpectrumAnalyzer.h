@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Fft.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Spectrum of one audio stream for visualization. The capture side only copies a mono
+// downmix into a lock-free ring; a worker thread runs Hann-windowed FFTs at the
+// configured overlap and reduces them to log-spaced bands. Results are handed to the
+// GUI through a triple buffer, so neither side ever waits on the other.
+class SpectrumAnalyzer
+{
+public:
+    struct Settings
+    {
+        int fftSize = 2048;         // power of two, 512..8192 is typical
+        float overlap = 0.75f;      // 0 .. 0.95
+        int bands = 64;
+        float minFrequency = 30.0f;
+        float maxFrequency = 16000.0f;
+    };
+
+    struct Snapshot
+    {
+        std::vector<float> levels;  // dBFS per band, low to high
+        uint64_t sequence = 0;      // increases with every published spectrum
+    };
+
+    SpectrumAnalyzer() = default;
+    ~SpectrumAnalyzer();
+
+    bool start(int sampleRate, const Settings& settings);
+    bool start(int sampleRate) { return start(sampleRate, Settings()); }
+    void stop();
+    bool isRunning() const { return m_worker.joinable(); }
+
+    // Capture thread; never blocks. Samples that do not fit are dropped.
+    void push(const float* interleaved, int frames, int channels);
+
+    // GUI thread (single reader): newest spectrum, valid until the next call
+    const Snapshot& latest();
+
+    const Settings& settings() const { return m_settings; }
+    uint64_t droppedSamples() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    // Samples waiting for the worker, out of ringCapacity(); any thread, while running
+    size_t ringFill() const { return static_cast<size_t>(m_written.load(std::memory_order_relaxed) - m_read.load(std::memory_order_relaxed)); }
+    size_t ringCapacity() const { return m_ring.size(); }
+
+private:
+    void run();
+    void analyze();
+    void publish();
+
+    Settings m_settings;
+    int m_sampleRate = 0;
+    int m_hop = 0;
+
+    // Single-producer/single-consumer ring of mono samples
+    std::vector<float> m_ring;
+    size_t m_ringMask = 0;
+    std::atomic<uint64_t> m_written{ 0 };
+    std::atomic<uint64_t> m_read{ 0 };
+    std::atomic<uint64_t> m_dropped{ 0 };
+
+    // Worker state
+    RealFft m_fft;
+    std::vector<float> m_window;
+    std::vector<float> m_history;   // last fftSize samples
+    std::vector<float> m_windowed;
+    std::vector<float> m_re;
+    std::vector<float> m_im;
+    std::vector<int> m_bandFirst;   // FFT bin range per band
+    std::vector<int> m_bandLast;
+    float m_normalization = 1.0f;
+    int m_filled = 0;
+
+    // Triple buffer: the worker fills m_back, the reader owns m_front, and m_middle
+    // holds the last published one (with kFresh set until the reader takes it)
+    static constexpr int kFresh = 4;
+    Snapshot m_buffers[3];
+    int m_back = 0;
+    int m_front = 1;
+    std::atomic<int> m_middle{ 2 };
+    uint64_t m_sequence = 0;
+
+    std::thread m_worker;
+    std::atomic<bool> m_running{ false };
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QWidget>
+#include <QTimer>
+#include <QImage>
+#include <QVector>
+#include "SpectrumAnalyzer.h"
+
+// Bar graph of the latest spectrum above a scrolling waterfall of the recent ones.
+// Polls the analyzer's snapshot on its own timer, so the audio side never touches Qt.
+class SpectrumWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    SpectrumWidget(QWidget* parent = nullptr, const QString& label = "Spectrum");
+
+    // Analyzer must outlive the widget or be reset to nullptr first
+    void setAnalyzer(SpectrumAnalyzer* analyzer);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+
+private:
+    void poll();
+    int levelToIndex(float db) const;
+
+    SpectrumAnalyzer* m_analyzer = nullptr;
+    QTimer m_pollTimer;
+    quint64 m_lastSequence = 0;
+
+    QString m_label;
+    QVector<float> m_bars;      // Displayed levels with falloff, dB
+    QRect m_barsRect;
+    QRect m_waterfallRect;
+
+    // One row per spectrum, used as a ring: m_waterfallRow is the newest row
+    QImage m_waterfall;
+    int m_waterfallRow = 0;
+    QVector<QRgb> m_colormap;   // dB index -> color
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Metrics.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Brings capture backends up concurrently instead of one after another on the UI
+// thread. Each phase gets its own thread (device init blocks inside drivers, so the
+// frame pool is the wrong place for it) and its callback runs on that thread as soon
+// as it finishes, so a caller can show one source while slower ones are still
+// starting. A phase that fails fails alone.
+//
+//     StartupSequencer startup;
+//     startup.add("screen", [&](std::string& error) { return capture.initialize(); },
+//         [&](const StartupSequencer::Phase& phase) { /* post to the UI thread */ });
+//     startup.start();
+class StartupSequencer
+{
+public:
+    struct Phase
+    {
+        std::string name;
+        bool finished = false;
+        bool ok = false;
+        std::string error;
+        int64_t startMicros = 0;    // since start()
+        int64_t durationMicros = 0;
+    };
+
+    using Task = std::function<bool(std::string& error)>;
+    using Callback = std::function<void(const Phase& phase)>;
+
+    StartupSequencer() = default;
+    ~StartupSequencer(); // waits for phases still running
+
+    StartupSequencer(const StartupSequencer&) = delete;
+    StartupSequencer& operator=(const StartupSequencer&) = delete;
+
+    // Before start() only; returns the phase's index
+    int add(const std::string& name, Task task, Callback ready = nullptr);
+
+    // Serial runs the phases in the order added on one background thread, for comparison
+    void start(bool parallel = true);
+    void wait();
+    bool waitFor(std::chrono::milliseconds timeout); // true when every phase finished
+
+    bool isStarted() const { return m_started; }
+    bool isFinished() const;
+    Phase phase(int index) const;
+    std::vector<Phase> phases() const;
+    int64_t elapsedMicros() const; // start() to the last phase finishing, or to now while running
+
+    // One line per phase plus the total, for the log
+    std::string report() const;
+    // obs_startup_phase_seconds per finished phase; safe from the scrape thread
+    void collectMetrics(MetricsWriter& writer) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        Task task;
+        Callback ready;
+    };
+
+    void runPhase(size_t index);
+
+    std::vector<Entry> m_entries;
+    std::vector<std::thread> m_threads;
+    bool m_started = false;
+    Clock::time_point m_start;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_done;
+    std::vector<Phase> m_phases; // guarded by m_mutex once started
+    size_t m_finished = 0;
+    Clock::time_point m_end;
+};
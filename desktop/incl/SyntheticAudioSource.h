@@ -0,0 +1,74 @@
+#pragma once
+
+#include "SampleConverter.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Audio counterpart of SyntheticSource: a script of tones, white noise and silence,
+// delivered in whatever shape a WASAPI endpoint might use (rate, channel count, sample
+// format, interleaved or planar). Samples depend on the position and seed only, so two
+// runs produce the same stream.
+class SyntheticAudioSource
+{
+public:
+    enum class Signal
+    {
+        Tone,    // sine at Settings::frequency, same on every channel
+        Noise,   // uniform white noise, independent per channel
+        Silence,
+    };
+
+    struct Segment
+    {
+        Signal signal = Signal::Tone;
+        double seconds = 0.0; // 0 = until the end of the run
+    };
+
+    struct Settings
+    {
+        int sampleRate = 48000;
+        int channels = 2;
+        SampleFormat format = SampleFormat::F32;
+        bool planar = false;
+        double frequency = 1000.0;
+        double levelDb = -12.0; // peak level of tones and noise, dBFS
+        uint32_t seed = 1;
+        std::vector<Segment> script{ Segment() }; // repeats when every segment has played
+    };
+
+    // "tone:2,silence:0.5,noise" - signal[:seconds], comma separated
+    static bool parseScript(const std::string& text, std::vector<Segment>& script, std::string& error);
+    // "s16", "s24", "s32", "f32" or "u8"
+    static bool parseFormat(const std::string& text, SampleFormat& format);
+
+    bool configure(const Settings& settings);
+    const Settings& settings() const { return m_settings; }
+    int bytesPerFrame() const { return bytesPerSample(m_settings.format) * m_settings.channels; }
+
+    // The next frames in the configured format: one pointer for interleaved output,
+    // one per channel for planar
+    void generate(void* const* out, int frames);
+    void generate(void* out, int frames) { generate(&out, frames); }
+
+    uint64_t position() const { return m_position; } // frames generated so far
+    Signal signal() const { return m_settings.script[m_segment].signal; }
+
+private:
+    static constexpr int kBlockFrames = 480;
+
+    void render(float* interleaved, int frames);
+    void nextSegment();
+    uint32_t random();
+
+    Settings m_settings;
+    SampleConverter m_converter;
+    std::vector<float> m_block; // kBlockFrames interleaved float frames
+    float m_amplitude = 0.0f;
+    double m_phase = 0.0;
+    double m_phaseStep = 0.0;
+    uint32_t m_rng = 1;
+    uint64_t m_position = 0;
+    int m_segment = 0;
+    int64_t m_segmentLeft = 0; // frames, -1 = no end
+};
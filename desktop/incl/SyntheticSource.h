@@ -0,0 +1,125 @@
+#pragma once
+
+#include "FrameChangeDetector.h"
+#include "SceneCompositor.h"
+#include "VideoFrame.h"
+#include "VideoSource.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Deterministic desktop for reproducible benchmarks: a gradient background with one
+// text window, driven by a script of workloads. Every frame also reports the rectangles
+// it changed (and the matching ChangeMap), the way a compositor's damage would, and
+// draws a cursor whose shape follows the workload. Everything depends on the frame
+// number and the seed only, never on time, so two runs produce identical frames.
+class SyntheticSource : public VideoSource
+{
+public:
+    enum class Workload
+    {
+        Idle,         // caret blink twice a second, nothing else
+        Typing,       // one glyph per frame into the window, I-beam cursor
+        WindowDrag,   // the window follows a loop across the screen
+        Scrolling,    // the window's text scrolls up a few lines a second
+        VideoNoise,   // every pixel changes every frame
+        CursorMotion, // static desktop, cursor sweeps and changes shape
+    };
+
+    enum class CursorShape
+    {
+        Arrow,
+        IBeam,
+        Crosshair,
+    };
+
+    struct Step
+    {
+        Workload workload = Workload::Typing;
+        int frames = 0; // 0 = until the end of the run
+    };
+
+    struct Settings
+    {
+        int width = 1920;  // up to 8K (7680x4320)
+        int height = 1080;
+        int fps = 60;      // only for timestamps
+        uint32_t seed = 1;
+        std::vector<Step> script{ Step() }; // repeats when every step has run
+    };
+
+    static constexpr int kMaxWidth = 7680;
+    static constexpr int kMaxHeight = 4320;
+
+    SyntheticSource();
+    explicit SyntheticSource(const Settings& settings);
+
+    // "typing:300,drag:120,noise" - workload[:frames], comma separated
+    static bool parseScript(const std::string& text, std::vector<Step>& script, std::string& error);
+    static const char* workloadName(Workload workload);
+
+    const char* name() const override { return "synthetic"; }
+    bool initialize() override;
+    bool acquireFrame(SourceFrame& frame) override;
+
+    // What the last frame changed, clipped to the frame
+    const std::vector<SceneRect>& damage() const { return m_damage; }
+    CursorShape cursorShape() const { return m_cursorShape; }
+    Workload workload() const { return m_settings.script[m_step].workload; }
+
+private:
+    void beginStep();
+    void runWorkload();
+    void typeGlyph();
+    void dragWindow();
+    void scrollWindow();
+    void fillNoise();
+
+    void drawDesktop();
+    void fillBackground(const SceneRect& rect);
+    void fillRect(const SceneRect& rect, uint32_t color);
+    void drawGlyph(int x, int y, uint32_t code, uint32_t color);
+    void drawDocumentRows(int firstRow, int rowCount);
+    void snapshotWindow();
+
+    void setCursorShape(CursorShape shape);
+    void buildCursor(CursorShape shape);
+    void restoreUnderCursor();
+    void drawCursor(int x, int y);
+
+    void addDamage(const SceneRect& rect);
+    void buildChangeMap();
+    uint32_t random();
+
+    SceneRect contentRect() const;
+    uint32_t backgroundColor(int y) const;
+
+    Settings m_settings;
+    FrameBuffer m_frame;
+    int m_scale = 1;       // UI scale: 1 at 1080p, 2 at 4K, 4 at 8K
+    uint32_t m_rng = 1;
+    uint64_t m_frameIndex = 0;
+
+    int m_step = 0;
+    int m_stepFrame = 0;
+
+    SceneRect m_window;
+    FrameBuffer m_windowImage; // window pixels while dragging
+    int m_caretX = 0;
+    int m_caretY = 0;
+    int m_lineLength = 0;
+    int m_documentTop = 0;     // document pixel row shown at the top of the window
+    bool m_noiseOnScreen = false;
+
+    CursorShape m_cursorShape = CursorShape::Arrow;
+    std::vector<uint32_t> m_cursor; // premultiplied BGRA, alpha 0 or 255
+    int m_cursorSize = 0;
+    int m_cursorX = 0;
+    int m_cursorY = 0;
+    SceneRect m_savedRect;          // frame area under the drawn cursor
+    std::vector<uint32_t> m_saveUnder;
+    CursorUpdate m_cursorUpdate;
+
+    std::vector<SceneRect> m_damage;
+    ChangeMap m_changes;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Per-frame work as tasks with dependencies, run on a ThreadPool. Build the graph once
+// and run() it every frame; running allocates nothing. A task starts as soon as every
+// task it depends on has finished, so independent branches (say, scaling two sources)
+// overlap, and a task can itself split into strips with parallelFor.
+//
+//     TaskGraph graph;
+//     int capture = graph.addTask("capture", [&] { ... });
+//     int compose = graph.addTask("compose", [&] { ... });
+//     graph.addDependency(capture, compose);
+//     graph.run(ThreadPool::instance());   // per frame
+class TaskGraph
+{
+public:
+    TaskGraph() = default;
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    int addTask(const std::string& name, std::function<void()> func);
+
+    // after waits for before; false if either id is unknown or it would form a cycle
+    bool addDependency(int before, int after);
+
+    // Runs every task once and returns when they are all done
+    void run(ThreadPool& pool);
+
+    int taskCount() const { return static_cast<int>(m_tasks.size()); }
+    const std::string& taskName(int id) const { return m_tasks[id]->name; }
+
+private:
+    struct Task : ThreadPool::Job
+    {
+        TaskGraph* graph = nullptr;
+        std::string name;
+        std::function<void()> func;
+        std::vector<Task*> successors;
+        int dependencies = 0;
+        std::atomic<int> remaining{ 0 }; // dependencies left in the current run
+    };
+
+    static void runTask(ThreadPool::Job* job);
+    bool reaches(int from, int to) const;
+
+    std::vector<std::unique_ptr<Task>> m_tasks; // stable addresses; tasks are queued by pointer
+    ThreadPool* m_pool = nullptr;               // during run()
+    std::atomic<int> m_pending{ 0 };
+};
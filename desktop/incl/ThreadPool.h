@@ -0,0 +1,90 @@
+#pragma once
+
+#include "FunctionRef.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing scheduler used to split per-frame work into strips and to run task
+// graphs (see TaskGraph.h). Each worker owns a deque: it pushes and pops its own jobs
+// at the back, idle workers steal from the front of the others. Threads outside the
+// pool hand jobs over through a shared inbox. A thread waiting for its jobs keeps
+// running queued ones, so nested parallelFor calls spread out over idle threads
+// instead of blocking one. Because of that, code holding thread_local scratch must
+// not call parallelFor while it still needs the scratch.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int threadCount = 0); // 0 = hardware concurrency
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Shared pool for the video pipeline
+    static ThreadPool& instance();
+
+    int threadCount() const { return static_cast<int>(m_workers.size()) + 1; }
+
+    // Calls func(begin, end) for chunks of [0, count) on all threads, including the
+    // caller, and returns when every chunk is done. Takes the callable by reference,
+    // so a call per frame never allocates.
+    void parallelFor(int count, FunctionRef<void(int, int)> func, int grain = 1);
+
+    // Unit of work. The submitter owns it and keeps it alive until wait() on its
+    // counter returns; the counter is decremented once run() has returned.
+    struct Job
+    {
+        void (*run)(Job* job) = nullptr;
+        std::atomic<int>* pending = nullptr;
+    };
+
+    void submit(Job* job);
+    void wait(std::atomic<int>& pending); // runs queued jobs until pending reaches 0
+
+private:
+    // Chase-Lev deque with a fixed capacity; a full deque makes submit() run the job
+    class JobDeque
+    {
+    public:
+        static constexpr int64_t kCapacity = 1024;
+
+        bool push(Job* job); // owner only
+        Job* pop();          // owner only
+        Job* steal();        // any thread
+
+    private:
+        alignas(64) std::atomic<int64_t> m_top{ 0 };
+        alignas(64) std::atomic<int64_t> m_bottom{ 0 };
+        std::atomic<Job*> m_items[kCapacity];
+    };
+
+    void workerLoop(int index);
+    Job* findJob(int index); // index -1 for threads outside the pool
+    void execute(Job* job);
+    void wakeWorkers(int count);
+    int workerIndex() const; // -1 unless called on one of this pool's workers
+
+    std::vector<std::thread> m_workers;
+    std::vector<std::unique_ptr<JobDeque>> m_deques; // one per worker
+
+    // Jobs from threads outside the pool
+    std::mutex m_inboxMutex;
+    std::vector<Job*> m_inbox;
+    std::atomic<int> m_inboxSize{ 0 };
+
+    // Idle workers sleep until the epoch moves
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::atomic<unsigned> m_epoch{ 0 };
+    std::atomic<int> m_sleepers{ 0 };
+    bool m_stopping = false;
+
+    // Waiters with nothing to help with sleep until some job counter reaches zero
+    std::mutex m_doneMutex;
+    std::condition_variable m_done;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "CaptureTrace.h"
+#include "FrameChangeDetector.h"
+#include "SceneCompositor.h"
+#include "VideoFrame.h"
+#include "VideoSource.h"
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Plays a capture trace back as a VideoSource: the recorded pixels, damage (as the
+// ChangeMap) and cursor updates, frame for frame. Fast mode hands out the next frame on
+// every call, for pushing a recording through the pipeline flat out; real-time mode
+// keeps the recorded spacing. Audio packets go to the sink as they come up.
+class TraceReplaySource : public VideoSource
+{
+public:
+    struct Settings
+    {
+        std::string path;
+        bool realtime = false;
+        bool loop = false; // start over at the end instead of finishing
+    };
+
+    using AudioSink = std::function<void(int64_t timestampUs, const CaptureTraceReader::AudioPacket& packet)>;
+
+    explicit TraceReplaySource(const Settings& settings);
+
+    void setAudioSink(AudioSink sink) { m_audioSink = std::move(sink); }
+
+    const char* name() const override { return "replay"; }
+    bool initialize() override;
+    bool acquireFrame(SourceFrame& frame) override;
+    bool atEnd() const override { return m_atEnd; } // lastError() is empty if it just ran out
+
+    const CaptureTraceReader& reader() const { return m_reader; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void restart();
+
+    Settings m_settings;
+    CaptureTraceReader m_reader;
+    AudioSink m_audioSink;
+
+    size_t m_next = 0;          // record to look at next
+    bool m_atEnd = false;
+    int64_t m_firstTimestamp = 0;
+    int64_t m_loopOffset = 0;   // added to recorded timestamps after each loop
+    Clock::time_point m_start;  // when the first record is due in real-time mode
+
+    FrameBuffer m_frame;
+    std::vector<SceneRect> m_damage;
+    ChangeMap m_changes;
+    CursorUpdate m_cursor;
+    bool m_cursorPending = false;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct TraceBuffer;
+struct TraceThreadExit;
+
+// Flight recorder for the stalls averages hide (a slow Map, a late audio drain).
+// Each thread that records gets its own ring of begin/end/counter events; writing one
+// is a clock read and a few stores, with no lock and no allocation after the thread's
+// first event. When a ring is full the oldest events are overwritten, so the recorder
+// always holds the last few seconds. A thread's ring goes on a free list when it exits
+// and is handed to the next new thread, so short-lived threads don't add 2 MB each.
+// writeJson() exports them as Chrome trace events for chrome://tracing or
+// ui.perfetto.dev and can run while recording continues.
+// Off by default; call sites check enabled() inline, so a disabled tracer costs one
+// relaxed load per scope.
+class Tracer
+{
+public:
+    static constexpr int kEventsPerThread = 1 << 16; // 2 MB per thread, about 10 s of 4K60 capture
+
+    // Never destroyed, so threads can record until the process exits
+    static Tracer& instance();
+
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    // Names are kept by pointer and must outlive the trace; use string literals
+    void begin(const char* name);
+    void end(const char* name);
+    void counter(const char* name, int64_t value);
+
+    // Shown for the calling thread in the timeline; the string is copied
+    void setThreadName(const char* name);
+
+    // Drop everything recorded so far
+    void clear();
+
+    bool writeJson(const std::filesystem::path& path) const;
+
+private:
+    friend struct TraceThreadExit;
+
+    Tracer();
+
+    TraceBuffer* threadBuffer();
+    void releaseThreadBuffer();
+    void record(int type, const char* name, int64_t value);
+
+    static std::atomic<bool> s_enabled;
+
+    int64_t m_epochNs = 0; // steady clock at construction, timestamps count from here
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> m_buffers;
+    std::vector<TraceBuffer*> m_free; // rings of exited threads, oldest exit first
+    int m_nextThreadId = 1;
+};
+
+// Begin/end pair around a scope. Whether it records is decided once, at the start,
+// so toggling the tracer mid-scope can't leave an unmatched end.
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name)
+        : m_name(Tracer::enabled() ? name : nullptr)
+    {
+        if (m_name) {
+            Tracer::instance().begin(m_name);
+        }
+    }
+
+    ~TraceScope()
+    {
+        if (m_name) {
+            Tracer::instance().end(m_name);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_name;
+};
+
+// Counter sample, skipped when the tracer is off
+inline void traceCounter(const char* name, int64_t value)
+{
+    if (Tracer::enabled()) {
+        Tracer::instance().counter(name, value);
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+// Per-pixel filters for FilterChain. Each one rewrites a run of BGRA pixels in place
+// through apply(bgra, count), so any number of them can run back to back on a chunk
+// that is still in L1.
+
+// 3x4 color matrix in RGB order (the fourth column is an offset in 0..255 units)
+class ColorMatrix
+{
+public:
+    ColorMatrix(); // identity
+    ColorMatrix(const float matrix[3][4]);
+
+    // Brightness in -1..1, contrast and saturation as factors (1 = unchanged)
+    static ColorMatrix fromAdjustments(float brightness, float contrast, float saturation);
+
+    void apply(uint8_t* bgra, int count) const;
+
+private:
+    static constexpr int kFracBits = 12;
+    int32_t m_coeff[3][4]; // fixed point, rows are R, G, B
+};
+
+// Independent 8-bit lookup per color channel, alpha untouched
+class Lut1D
+{
+public:
+    Lut1D(); // identity
+    static Lut1D gamma(float gamma);
+
+    uint8_t* table(int channel) { return m_table[channel]; } // 0 = B, 1 = G, 2 = R
+
+    void apply(uint8_t* bgra, int count) const;
+
+private:
+    uint8_t m_table[3][256];
+};
+
+// Format conversions that stay in 32 bits per pixel
+
+// Straight BGRA to QImage::Format_RGB32 (alpha forced to 255)
+struct ForceOpaque
+{
+    void apply(uint8_t* bgra, int count) const;
+};
+
+// Straight to premultiplied alpha (QImage::Format_ARGB32_Premultiplied)
+struct Premultiply
+{
+    void apply(uint8_t* bgra, int count) const;
+};
+
+// BGRA <-> RGBA channel order
+struct SwapRedBlue
+{
+    void apply(uint8_t* bgra, int count) const;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "BufferPool.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Non-owning view of a packed 32-bit BGRA frame (the layout ScreenCapture produces)
+struct FrameView
+{
+    uint8_t* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int stride = 0; // bytes per line
+
+    FrameView() = default;
+    FrameView(uint8_t* data, int width, int height, int stride)
+        : data(data), width(width), height(height), stride(stride)
+    {
+    }
+
+    bool isValid() const { return data && width > 0 && height > 0; }
+    uint8_t* row(int y) const { return data + static_cast<size_t>(y) * stride; }
+};
+
+// Owning BGRA frame storage with a 64-byte aligned stride. The pixels come from the
+// shared BufferPool and are only replaced when a resize outgrows them. Move-only.
+class FrameBuffer
+{
+public:
+    FrameBuffer() = default;
+    FrameBuffer(int width, int height) { resize(width, height); }
+
+    void resize(int width, int height)
+    {
+        m_width = width;
+        m_height = height;
+        m_stride = ((width * 4) + 63) & ~63;
+
+        const size_t bytes = static_cast<size_t>(m_stride) * height;
+        if (bytes > m_storage.capacity()) {
+            m_storage = BufferPool::instance().acquire(bytes);
+            if (m_storage) {
+                memset(m_storage.data(), 0, bytes);
+            }
+        }
+    }
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int stride() const { return m_stride; }
+
+    FrameView view() { return FrameView(m_storage.data(), m_width, m_height, m_stride); }
+
+private:
+    PooledBuffer m_storage;
+    int m_width = 0;
+    int m_height = 0;
+    int m_stride = 0;
+};
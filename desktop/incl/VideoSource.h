@@ -0,0 +1,73 @@
+#pragma once
+
+#include "VideoFrame.h"
+#include <cstdint>
+#include <string>
+
+struct ChangeMap;
+
+// Pointer state as the capture saw it, the way PTR_INFO carries it. The frame already
+// has the cursor drawn in; this is for recording and overlays. The shape only comes
+// along when it changed.
+struct CursorUpdate
+{
+    enum ShapeType : uint32_t // DXGI_OUTDUPL_POINTER_SHAPE_TYPE values
+    {
+        Unchanged = 0,
+        Monochrome = 1,  // AND mask then XOR mask, 1 bpp, height covers both
+        Color = 2,       // BGRA, straight alpha
+        MaskedColor = 4, // BGRA, alpha 0xFF = XOR the color in
+    };
+
+    int x = 0; // top-left of the shape on the frame
+    int y = 0;
+    bool visible = false;
+    uint32_t shapeType = Unchanged;
+    int width = 0;
+    int height = 0;
+    int pitch = 0;
+    int hotX = 0;
+    int hotY = 0;
+    const uint8_t* shape = nullptr; // pitch * height bytes, valid until the next acquireFrame()
+};
+
+// One frame as a source hands it out. The pixels stay valid until the source's next
+// acquireFrame() call.
+struct SourceFrame
+{
+    FrameView pixels;
+    const ChangeMap* changes = nullptr; // tiles changed since the previous frame, null = assume all
+    int64_t timestampUs = 0;            // steady clock at capture
+    const CursorUpdate* cursor = nullptr; // pointer moved or changed shape, null = no news
+    bool held = false;                  // the last good frame again, while the source recovers
+};
+
+// Something the pipeline pulls BGRA frames from: a display capture, a generator, a
+// recording. All calls come from the thread driving the pipeline.
+class VideoSource
+{
+public:
+    virtual ~VideoSource() = default;
+
+    virtual const char* name() const = 0;
+
+    // Device setup; may block for a while
+    virtual bool initialize() = 0;
+
+    // True with frame filled in when a new frame is ready; false if there is none yet
+    // or capture failed
+    virtual bool acquireFrame(SourceFrame& frame) = 0;
+
+    // A recording that has played out; live sources never end
+    virtual bool atEnd() const { return false; }
+
+    // The device went away (desktop switch, secure desktop, mode change) and
+    // initialize() has to run again. Until it does, the last frame stays readable.
+    virtual bool isLost() const { return false; }
+
+    // Why initialize() or acquireFrame() last failed
+    const std::string& lastError() const { return m_error; }
+
+protected:
+    std::string m_error;
+};
@@ -1,7 +1,8 @@
 #pragma once
 
 #include <QWidget>
-#include <QTimer>
+#include <QPixmap>
+#include <atomic>
 
 class VolumeMeter : public QWidget
 {
@@ -9,20 +10,38 @@ class VolumeMeter : public QWidget
 
 public:
     VolumeMeter(QWidget* parent = nullptr, const QString& label = "Volume");
+    ~VolumeMeter();
+
+    // Safe to call from any thread (e.g. the audio thread)
     void setLevel(float dbLevel); // range: -60.0 to 0.0 dB
+    void setLoudness(float momentaryLufs, float integratedLufs);
     float getCurrentLevel() const { return m_currentLevel; }
 
+    // Advances the animation; driven by the clock shared by all meters
+    void tick();
+
 protected:
     void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
 
 private:
     float m_currentLevel;      // Smoothed level
-    float m_targetLevel;       // Latest volume input
+    std::atomic<float> m_targetLevel; // Latest volume input
+    std::atomic<float> m_inputPeak;   // Highest input since the last tick
     float m_peakLevel;
-    QTimer m_animationTimer;
+    std::atomic<float> m_momentary;
+    std::atomic<float> m_integrated;
+
+    // Pixel positions last painted, to repaint only what moved
+    int m_paintedLevelX = -1;
+    int m_paintedPeakX = -1;
+    int m_paintedMomentaryX = -1;
+    int m_paintedIntegrated = 0;   // Tenths of LU, as shown
 
     QString m_label;
+    QRect m_barRect;
+    QRect m_loudnessRect;      // Integrated loudness readout under the label
+    QPixmap m_gradient;        // Shared with other meters of the same bar size
 
-    void updateAnimation();
-    QLinearGradient createColorGradient() const;
+    int levelToX(float dbLevel) const;
 };
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "BufferPool.h"
+#include "VideoFrame.h"
+#include <filesystem>
+#include <fstream>
+
+class ThreadPool;
+
+// Writes BGRA frames as uncompressed YUV4MPEG2 (I420, BT.709 limited range), which
+// ffmpeg, x264 and most players read directly. Meant for headless runs and checking
+// pipeline output, not for recording sessions of any length.
+class Y4mWriter
+{
+public:
+    ~Y4mWriter() { close(); }
+
+    bool open(const std::filesystem::path& path, int width, int height, int fps);
+    void close();
+    bool isOpen() const { return m_file.is_open(); }
+
+    // frame must be the size given to open()
+    bool write(const FrameView& frame, ThreadPool* pool = nullptr);
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+private:
+    std::ofstream m_file;
+    int m_width = 0;
+    int m_height = 0;
+    PooledBuffer m_planes; // Y, then U, then V
+};
@@ -0,0 +1,120 @@
+#include "incl/AllocationCounter.h"
+
+#ifdef OBS_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<uint64_t> g_allocations{ 0 };
+
+    void* allocate(size_t size)
+    {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        return std::malloc(size ? size : 1);
+    }
+
+    void* allocateAligned(size_t size, size_t alignment)
+    {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+#ifdef _WIN32
+        return _aligned_malloc(size ? size : 1, alignment);
+#else
+        // aligned_alloc wants the size to be a multiple of the alignment
+        return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+    }
+
+    void freeAligned(void* data)
+    {
+#ifdef _WIN32
+        _aligned_free(data);
+#else
+        std::free(data);
+#endif
+    }
+}
+
+void* operator new(size_t size)
+{
+    if (void* data = allocate(size)) {
+        return data;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    if (void* data = allocateAligned(size, static_cast<size_t>(alignment))) {
+        return data;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* data) noexcept { std::free(data); }
+void operator delete[](void* data) noexcept { std::free(data); }
+void operator delete(void* data, size_t) noexcept { std::free(data); }
+void operator delete[](void* data, size_t) noexcept { std::free(data); }
+void operator delete(void* data, const std::nothrow_t&) noexcept { std::free(data); }
+void operator delete[](void* data, const std::nothrow_t&) noexcept { std::free(data); }
+void operator delete(void* data, std::align_val_t) noexcept { freeAligned(data); }
+void operator delete[](void* data, std::align_val_t) noexcept { freeAligned(data); }
+void operator delete(void* data, size_t, std::align_val_t) noexcept { freeAligned(data); }
+void operator delete[](void* data, size_t, std::align_val_t) noexcept { freeAligned(data); }
+void operator delete(void* data, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(data); }
+void operator delete[](void* data, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(data); }
+
+bool AllocationCounter::enabled()
+{
+    return true;
+}
+
+uint64_t AllocationCounter::count()
+{
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool AllocationCounter::enabled()
+{
+    return false;
+}
+
+uint64_t AllocationCounter::count()
+{
+    return 0;
+}
+
+#endif
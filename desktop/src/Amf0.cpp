@@ -0,0 +1,223 @@
+#include "incl/Amf0.h"
+#include <cstring>
+
+namespace {
+    void putBig16(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void putBig32(std::vector<uint8_t>& out, uint32_t value)
+    {
+        putBig16(out, value >> 16);
+        putBig16(out, value & 0xFFFF);
+    }
+
+    uint32_t big(const uint8_t* p, size_t bytes)
+    {
+        uint32_t value = 0;
+        for (size_t i = 0; i < bytes; i++) {
+            value = (value << 8) | p[i];
+        }
+        return value;
+    }
+
+    // Nested objects only turn up in metadata we skip; bound them all the same
+    constexpr int kMaxDepth = 16;
+}
+
+void Amf0::writeNumber(std::vector<uint8_t>& out, double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    out.push_back(Number);
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<uint8_t>(bits >> shift));
+    }
+}
+
+void Amf0::writeBoolean(std::vector<uint8_t>& out, bool value)
+{
+    out.push_back(Boolean);
+    out.push_back(value ? 1 : 0);
+}
+
+void Amf0::writeString(std::vector<uint8_t>& out, const std::string& value)
+{
+    if (value.size() > 0xFFFF) {
+        out.push_back(LongString);
+        putBig32(out, static_cast<uint32_t>(value.size()));
+    }
+    else {
+        out.push_back(String);
+        putBig16(out, static_cast<uint32_t>(value.size()));
+    }
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+void Amf0::writeNull(std::vector<uint8_t>& out)
+{
+    out.push_back(Null);
+}
+
+void Amf0::beginObject(std::vector<uint8_t>& out)
+{
+    out.push_back(Object);
+}
+
+void Amf0::beginEcmaArray(std::vector<uint8_t>& out, uint32_t count)
+{
+    out.push_back(EcmaArray);
+    putBig32(out, count);
+}
+
+void Amf0::writeKey(std::vector<uint8_t>& out, const char* key)
+{
+    const size_t length = std::strlen(key);
+    putBig16(out, static_cast<uint32_t>(length));
+    out.insert(out.end(), key, key + length);
+}
+
+void Amf0::endObject(std::vector<uint8_t>& out)
+{
+    putBig16(out, 0);
+    out.push_back(ObjectEnd);
+}
+
+bool Amf0Reader::take(size_t bytes, const uint8_t*& at)
+{
+    if (m_failed || m_size - m_at < bytes) {
+        m_failed = true;
+        return false;
+    }
+    at = m_data + m_at;
+    m_at += bytes;
+    return true;
+}
+
+bool Amf0Reader::readUtf8(size_t lengthBytes, std::string& value)
+{
+    const uint8_t* p;
+    if (!take(lengthBytes, p)) {
+        return false;
+    }
+    const size_t length = big(p, lengthBytes);
+    if (!take(length, p)) {
+        return false;
+    }
+    value.assign(reinterpret_cast<const char*>(p), length);
+    return true;
+}
+
+bool Amf0Reader::readNumber(double& value)
+{
+    const uint8_t* p;
+    if (peekMarker() != Amf0::Number || !take(9, p)) {
+        m_failed = true;
+        return false;
+    }
+    uint64_t bits = 0;
+    for (int i = 1; i < 9; i++) {
+        bits = (bits << 8) | p[i];
+    }
+    std::memcpy(&value, &bits, sizeof(value));
+    return true;
+}
+
+bool Amf0Reader::readString(std::string& value)
+{
+    const int marker = peekMarker();
+    if (marker != Amf0::String && marker != Amf0::LongString) {
+        m_failed = true;
+        return false;
+    }
+    m_at++;
+    return readUtf8(marker == Amf0::String ? 2 : 4, value);
+}
+
+bool Amf0Reader::skip()
+{
+    std::vector<std::pair<std::string, std::string>> ignored;
+    const uint8_t* p;
+    switch (peekMarker()) {
+    case Amf0::Number:
+        return take(9, p);
+    case Amf0::Boolean:
+        return take(2, p);
+    case Amf0::Null:
+    case Amf0::Undefined:
+        return take(1, p);
+    case Amf0::Date:
+        return take(11, p);
+    case Amf0::String:
+    case Amf0::LongString: {
+        std::string value;
+        return readString(value);
+    }
+    case Amf0::Object:
+    case Amf0::EcmaArray:
+        return readObject(ignored);
+    case Amf0::StrictArray: {
+        if (!take(5, p)) {
+            return false;
+        }
+        for (uint32_t count = big(p + 1, 4); count > 0; count--) {
+            if (!skip()) {
+                return false;
+            }
+        }
+        return true;
+    }
+    default:
+        m_failed = true;
+        return false;
+    }
+}
+
+bool Amf0Reader::readObject(std::vector<std::pair<std::string, std::string>>& strings,
+    std::vector<std::pair<std::string, double>>* numbers)
+{
+    const uint8_t* p;
+    const int marker = peekMarker();
+    if (marker == Amf0::Null || marker == Amf0::Undefined) {
+        return take(1, p);
+    }
+    if ((marker != Amf0::Object && marker != Amf0::EcmaArray) || m_depth >= kMaxDepth ||
+        !take(marker == Amf0::Object ? 1 : 5, p)) {
+        m_failed = true;
+        return false;
+    }
+
+    m_depth++;
+    std::string key;
+    bool ok = true;
+    for (;;) {
+        if (!readUtf8(2, key)) {
+            ok = false;
+            break;
+        }
+        if (key.empty() && peekMarker() == Amf0::ObjectEnd) {
+            take(1, p);
+            break;
+        }
+        if (peekMarker() == Amf0::String || peekMarker() == Amf0::LongString) {
+            std::string value;
+            ok = readString(value);
+            strings.emplace_back(key, value);
+        }
+        else if (numbers && peekMarker() == Amf0::Number) {
+            double value = 0;
+            ok = readNumber(value);
+            numbers->emplace_back(key, value);
+        }
+        else {
+            ok = skip();
+        }
+        if (!ok) {
+            break;
+        }
+    }
+    m_depth--;
+    return ok;
+}
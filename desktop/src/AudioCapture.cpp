@@ -1,55 +1,101 @@
 #include "incl/AudioCapture.h"
+#include "incl/Tracer.h"
+#include <mmreg.h>
+#include <ksmedia.h>
 #include <iostream>
 #include <thread>
 #include <chrono>
 #include <QDebug>
 
+namespace {
+    // Threads other than the GUI's that talk to the devices (startup, the audio lane)
+    // need a COM apartment of their own
+    struct ComApartment {
+        HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+        ~ComApartment() { if (SUCCEEDED(hr)) CoUninitialize(); }
+    };
+}
+
 AudioCapture::AudioCapture() {
     HRESULT hr = CoInitialize(nullptr);
     if (FAILED(hr)) {
         qDebug() << "Failed to initialize COM library";
     }
 
-    // Create device enumerator
-    hr = CoCreateInstance(
-        __uuidof(MMDeviceEnumerator),
-        nullptr,
-        CLSCTX_ALL,
-        __uuidof(IMMDeviceEnumerator),
-        (void**)&m_pEnumerator
-    );
-
+    // The devices are opened on startup threads and drained on the audio lane; keep the
+    // multithreaded apartment they live in up while neither thread exists
+    hr = CoIncrementMTAUsage(&m_mtaCookie);
     if (FAILED(hr)) {
-        qDebug() << "Failed to create device enumerator: " << hr;
+        qDebug() << "Failed to hold the COM MTA: " << hr;
+    }
+
+    // Mic filter chain, every filter bypassed until the user enables it
+    m_inputGate = m_inputFilters.addFilter(std::make_unique<NoiseGate>());
+    m_inputEq = m_inputFilters.addFilter(std::make_unique<ParametricEq>());
+    m_inputCompressor = m_inputFilters.addFilter(std::make_unique<Compressor>());
+    m_inputLimiter = m_inputFilters.addFilter(std::make_unique<Limiter>());
+    for (int i = 0; i < m_inputFilters.filterCount(); i++) {
+        m_inputFilters.filter(i)->setEnabled(false);
     }
+
+    m_silenceBlock.assign(static_cast<size_t>(kSilenceBlockFrames) * FlacEncoder::kMaxChannels, 0.0f);
 }
 
 AudioCapture::~AudioCapture() {
     
     stopCapture();
+    stopRecording();
 
-    if (m_pInputAudioClient) m_pInputAudioClient->Release();
-    if (m_pOutputAudioClient) m_pOutputAudioClient->Release();
-    if (m_pInputCaptureClient) m_pInputCaptureClient->Release();
-    if (m_pOutputCaptureClient) m_pOutputCaptureClient->Release();
-    if (m_pInputDevice) m_pInputDevice->Release();
-    if (m_pOutputDevice) m_pOutputDevice->Release();
+    releaseInput();
+    releaseOutput();
     if (m_pEnumerator) m_pEnumerator->Release();
 
-    if (m_pwfxInput) CoTaskMemFree(m_pwfxInput);
-    if (m_pwfxOutput) CoTaskMemFree(m_pwfxOutput);
+    if (m_mtaCookie) CoDecrementMTAUsage(m_mtaCookie);
+    CoUninitialize();
+}
+
+bool AudioCapture::createEnumerator() {
+    // Deferred to the first device init, which may run on a startup thread; the
+    // enumerator is free-threaded, so both inits and the lane can share it
+    std::call_once(m_enumeratorOnce, [this] {
+        HRESULT hr = CoCreateInstance(
+            __uuidof(MMDeviceEnumerator),
+            nullptr,
+            CLSCTX_ALL,
+            __uuidof(IMMDeviceEnumerator),
+            (void**)&m_pEnumerator
+        );
+        if (FAILED(hr)) {
+            qDebug() << "Failed to create device enumerator: " << hr;
+            m_pEnumerator = nullptr;
+        }
+    });
+    return m_pEnumerator != nullptr;
+}
+
+void AudioCapture::releaseInput() {
+    if (m_pInputCaptureClient) { m_pInputCaptureClient->Release(); m_pInputCaptureClient = nullptr; }
+    if (m_pInputAudioClient) { m_pInputAudioClient->Release(); m_pInputAudioClient = nullptr; }
+    if (m_pInputDevice) { m_pInputDevice->Release(); m_pInputDevice = nullptr; }
+    if (m_pwfxInput) { CoTaskMemFree(m_pwfxInput); m_pwfxInput = nullptr; }
 
     if (m_hInputEvent) {
         CloseHandle(m_hInputEvent);
         m_hInputEvent = nullptr;
     }
+}
 
-    CoUninitialize();
+void AudioCapture::releaseOutput() {
+    if (m_pOutputCaptureClient) { m_pOutputCaptureClient->Release(); m_pOutputCaptureClient = nullptr; }
+    if (m_pOutputAudioClient) { m_pOutputAudioClient->Release(); m_pOutputAudioClient = nullptr; }
+    if (m_pOutputDevice) { m_pOutputDevice->Release(); m_pOutputDevice = nullptr; }
+    if (m_pwfxOutput) { CoTaskMemFree(m_pwfxOutput); m_pwfxOutput = nullptr; }
 }
 
 bool AudioCapture::initializeInput() {
-    
-    if (!m_pEnumerator) {
+    thread_local ComApartment com;
+
+    if (!createEnumerator()) {
         qDebug() << "Device enumerator not initialized";
         return false;
     }
@@ -78,6 +124,20 @@ bool AudioCapture::initializeInput() {
         return false;
     }
 
+    if (!configureConverter(m_inputConverter, m_pwfxInput)) {
+        qDebug() << "Unsupported input mix format";
+    }
+
+    if (!m_inputLoudness.configure(m_pwfxInput->nSamplesPerSec, m_pwfxInput->nChannels)) {
+        qDebug() << "Loudness metering not supported for the input format";
+    }
+
+    // 10 ms blocks
+    if (!m_inputFilters.configure(m_pwfxInput->nSamplesPerSec, m_pwfxInput->nChannels,
+        std::max<int>(1, m_pwfxInput->nSamplesPerSec / 100))) {
+        qDebug() << "Audio filters not supported for the input format";
+    }
+
     // Create event for audio processing
     m_hInputEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
     if (!m_hInputEvent) {
@@ -116,7 +176,9 @@ bool AudioCapture::initializeInput() {
 }
 
 bool AudioCapture::initializeOutput() {
-    if (!m_pEnumerator) {
+    thread_local ComApartment com;
+
+    if (!createEnumerator()) {
         qDebug() << "Device enumerator not initialized";
         return false;
     }
@@ -145,6 +207,19 @@ bool AudioCapture::initializeOutput() {
         return false;
     }
 
+    if (!configureConverter(m_outputConverter, m_pwfxOutput)) {
+        qDebug() << "Unsupported output mix format";
+    }
+
+    if (!m_outputLoudness.configure(m_pwfxOutput->nSamplesPerSec, m_pwfxOutput->nChannels)) {
+        qDebug() << "Loudness metering not supported for the output format";
+    }
+
+    // Already running after a device recovery; the widget may be reading it
+    if (!m_outputSpectrum.isRunning() && !m_outputSpectrum.start(m_pwfxOutput->nSamplesPerSec)) {
+        qDebug() << "Failed to start the output spectrum analyzer";
+    }
+
     // Initialize audio client in loopback mode
     hr = m_pOutputAudioClient->Initialize(
         AUDCLNT_SHAREMODE_SHARED,
@@ -187,148 +262,351 @@ void AudioCapture::startCapture() {
     }
 
     m_isCapturing = true;
+
+    // Drain both devices off the GUI thread so a slow video frame can't make them overflow
+    RealtimeLane::Settings lane;
+    lane.name = "audio capture";
+    lane.periodMs = 5;
+    m_audioLane.start([this] { drainAudio(); }, lane);
+
+    m_metrics = MetricsRegistry::instance().add([this](MetricsWriter& writer) { collectMetrics(writer); });
 }
 
 void AudioCapture::stopCapture() {
 
+    m_metrics.reset();
+    m_audioLane.stop();
+    // After the lane, which starts them; an attempt in flight finishes first
+    m_inputRecovery.stop();
+    m_outputRecovery.stop();
     if (m_pInputAudioClient) m_pInputAudioClient->Stop();
     if (m_pOutputAudioClient) m_pOutputAudioClient->Stop();
     m_isCapturing = false;
 }
 
-float AudioCapture::getOutputVolume() {
-
-    if (!m_pOutputAudioClient || !m_pOutputCaptureClient) {
-        qDebug() << "Output audio client not initialized";
-        return -100.0f;
+bool AudioCapture::startRecording(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath, int bitsPerSample) {
+    if (m_inputRecovery.isRecovering() || m_outputRecovery.isRecovering()) {
+        qDebug() << "Audio device reconnecting, cannot record yet";
+        return false;
+    }
+    if (!m_pwfxInput || !m_pwfxOutput) {
+        qDebug() << "Audio capture not initialized, cannot record";
+        return false;
     }
 
-    UINT32 packetLength = 0;
-    HRESULT hr = m_pOutputCaptureClient->GetNextPacketSize(&packetLength);
+    stopRecording();
 
-    if (FAILED(hr) || packetLength == 0) {
-        return -100.0f;
+    // Blocks are encoded on their own pool so recording never waits on the video pipeline
+    if (!m_encodePool) {
+        int threads = static_cast<int>(std::thread::hardware_concurrency()) / 2;
+        m_encodePool = std::make_unique<ThreadPool>(std::max(threads, 1));
     }
 
-    BYTE* pData;
-    UINT32 numFramesAvailable;
-    DWORD flags;
+    if (!m_inputRecorder.start(inputPath, m_pwfxInput->nSamplesPerSec, m_pwfxInput->nChannels, bitsPerSample, m_encodePool.get())) {
+        qDebug() << "Failed to start mic recording";
+        return false;
+    }
+    if (!m_outputRecorder.start(outputPath, m_pwfxOutput->nSamplesPerSec, m_pwfxOutput->nChannels, bitsPerSample, m_encodePool.get())) {
+        qDebug() << "Failed to start desktop audio recording";
+        m_inputRecorder.stop();
+        return false;
+    }
 
-    hr = m_pOutputCaptureClient->GetBuffer(
-        &pData, &numFramesAvailable, &flags, nullptr, nullptr);
+    qDebug() << "Recording audio to" << QString::fromStdWString(inputPath.wstring())
+             << "and" << QString::fromStdWString(outputPath.wstring());
+    return true;
+}
 
-    if (FAILED(hr) || numFramesAvailable == 0) {
-        return -100.0f;
+void AudioCapture::stopRecording() {
+    m_inputRecorder.stop();
+    m_outputRecorder.stop();
+}
+
+float AudioCapture::getOutputVolume() {
+    return m_outputLevel.exchange(-100.0f, std::memory_order_relaxed);
+}
+
+float AudioCapture::getInputVolume() {
+    return m_inputLevel.exchange(-100.0f, std::memory_order_relaxed);
+}
+
+LoudnessMeter::Snapshot AudioCapture::getInputLoudness() const {
+    std::lock_guard<std::mutex> lock(m_loudnessMutex);
+    return m_inputLoudnessSnapshot;
+}
+
+LoudnessMeter::Snapshot AudioCapture::getOutputLoudness() const {
+    std::lock_guard<std::mutex> lock(m_loudnessMutex);
+    return m_outputLoudnessSnapshot;
+}
+
+void AudioCapture::raiseLevel(std::atomic<float>& level, float db) {
+    float current = level.load(std::memory_order_relaxed);
+    while (db > current && !level.compare_exchange_weak(current, db, std::memory_order_relaxed)) {
     }
+}
 
-    float rmsVolume = calculateRMSVolume(pData, numFramesAvailable, m_pwfxOutput);
-    float volumeDb = convertToDecibels(rmsVolume);
+void AudioCapture::drainAudio() {
+    // The capture clients are used from this thread only
+    thread_local ComApartment com;
 
-    // Always release the buffer
-    m_pOutputCaptureClient->ReleaseBuffer(numFramesAvailable);
+    TraceScope trace("audio drain");
+    float inputDb = drainInput();
+    float outputDb = drainOutput();
+    raiseLevel(m_inputLevel, inputDb);
+    raiseLevel(m_outputLevel, outputDb);
 
-    return volumeDb;
+    // A recovering device's meter belongs to its reinit; keep the last snapshot
+    std::lock_guard<std::mutex> lock(m_loudnessMutex);
+    if (!m_inputRecovery.isRecovering()) {
+        m_inputLoudnessSnapshot = m_inputLoudness.snapshot();
+    }
+    if (!m_outputRecovery.isRecovering()) {
+        m_outputLoudnessSnapshot = m_outputLoudness.snapshot();
+    }
 }
 
-float AudioCapture::getInputVolume() {
-    if (!m_pInputAudioClient || !m_pInputCaptureClient) {
-        qDebug() << "Input audio client not initialized";
-        return -100.0f;
+bool AudioCapture::resumeOrHold(DeviceRecovery& recovery, const Silence& silence, FlacRecorder& recorder) {
+    if (!recovery.isRecovering()) {
+        return true;
     }
 
-    UINT32 packetLength = 0;
-    HRESULT hr = m_pInputCaptureClient->GetNextPacketSize(&packetLength);
+    // Silence on the lane's schedule keeps the recording in step with the other track,
+    // up to the moment the device takes over again
+    const bool recordable = silence.channels > 0 && silence.channels <= FlacEncoder::kMaxChannels;
+    const int frames = recordable ? recovery.fallbackFramesDue(silence.sampleRate, silence.sampleRate) : 0;
+    for (int done = 0; done < frames; done += kSilenceBlockFrames) {
+        recorder.push(m_silenceBlock.data(), std::min(frames - done, kSilenceBlockFrames));
+    }
 
-    if (FAILED(hr) || packetLength == 0) {
-        return -100.0f;
+    const int64_t outageMs = recovery.currentOutageMicros() / 1000;
+    if (recovery.poll()) {
+        qDebug() << "Audio device back after" << outageMs << "ms";
+        return true;
     }
+    return false;
+}
 
-    BYTE* pData;
-    UINT32 numFramesAvailable;
-    DWORD flags;
+void AudioCapture::reportLost(DeviceRecovery& recovery, Silence& silence, const WAVEFORMATEX* pwfx, bool input, HRESULT hr) {
+    qDebug() << (input ? "Mic" : "Desktop audio") << "device lost, HRESULT:" << hr;
+    silence.sampleRate = pwfx ? pwfx->nSamplesPerSec : 48000;
+    silence.channels = pwfx ? pwfx->nChannels : 0;
+
+    // Everything the reinit replaces belongs to it until the lane's next successful poll()
+    recovery.reportLost([this, input](std::string& error) {
+        input ? releaseInput() : releaseOutput();
+        if (!(input ? initializeInput() : initializeOutput())) {
+            error = "device not back yet";
+            return false;
+        }
+        IAudioClient* client = input ? m_pInputAudioClient : m_pOutputAudioClient;
+        if (FAILED(client->Start())) {
+            error = "device did not start";
+            return false;
+        }
+        return true;
+    }, input ? "mic device invalidated" : "desktop audio device invalidated");
+}
 
-    hr = m_pInputCaptureClient->GetBuffer(
-        &pData, &numFramesAvailable, &flags, nullptr, nullptr);
+float AudioCapture::drainOutput() {
 
-    if (FAILED(hr) || numFramesAvailable == 0) {
+    if (!resumeOrHold(m_outputRecovery, m_outputSilence, m_outputRecorder)) {
         return -100.0f;
     }
+    if (!m_pOutputAudioClient || !m_pOutputCaptureClient) {
+        return -100.0f;
+    }
+
+    // Take every packet that is ready, not just one, so nothing backs up between ticks
+    TraceScope trace("desktop audio read");
+    float loudestDb = -100.0f;
+    UINT32 framesRead = 0;
+    for (;;) {
+        UINT32 packetLength = 0;
+        HRESULT hr = m_pOutputCaptureClient->GetNextPacketSize(&packetLength);
+
+        if (hr == AUDCLNT_E_DEVICE_INVALIDATED) {
+            reportLost(m_outputRecovery, m_outputSilence, m_pwfxOutput, false, hr);
+            break;
+        }
+        if (FAILED(hr) || packetLength == 0) {
+            break;
+        }
 
-    float rmsVolume = calculateRMSVolume(pData, numFramesAvailable, m_pwfxInput);
-    float volumeDb = convertToDecibels(rmsVolume);
+        BYTE* pData;
+        UINT32 numFramesAvailable;
+        DWORD flags;
 
-    // Always release the buffer
-    m_pInputCaptureClient->ReleaseBuffer(numFramesAvailable);
+        hr = m_pOutputCaptureClient->GetBuffer(
+            &pData, &numFramesAvailable, &flags, nullptr, nullptr);
 
-    return volumeDb;
+        if (FAILED(hr)) {
+            break;
+        }
+
+        UINT32 numFrames = convertToFloat(pData, numFramesAvailable, m_outputConverter);
+        framesRead += numFrames;
+        if (flags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) {
+            m_outputDiscontinuities.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_outputLoudness.process(m_samples.data(), numFrames);
+        m_outputSpectrum.push(m_samples.data(), numFrames, m_outputConverter.channels());
+        m_outputRecorder.push(m_samples.data(), numFrames);
+
+        float rmsVolume = calculateRMSVolume(m_samples.data(), m_samples.size());
+        loudestDb = std::max(loudestDb, convertToDecibels(rmsVolume));
+
+        // Always release the buffer
+        m_pOutputCaptureClient->ReleaseBuffer(numFramesAvailable);
+    }
+
+    traceCounter("desktop audio frames", framesRead);
+    m_outputFrames.fetch_add(framesRead, std::memory_order_relaxed);
+    return loudestDb;
 }
 
-float AudioCapture::calculateRMSVolume(
-    BYTE* pData, UINT32 numFramesAvailable, WAVEFORMATEX* pwfx) {
+float AudioCapture::drainInput() {
+    if (!resumeOrHold(m_inputRecovery, m_inputSilence, m_inputRecorder)) {
+        return -100.0f;
+    }
+    if (!m_pInputAudioClient || !m_pInputCaptureClient) {
+        return -100.0f;
+    }
 
-    if (!pData || numFramesAvailable == 0 || !pwfx) return 0.0f;
+    TraceScope trace("mic audio read");
+    float loudestDb = -100.0f;
+    UINT32 framesRead = 0;
+    for (;;) {
+        UINT32 packetLength = 0;
+        HRESULT hr = m_pInputCaptureClient->GetNextPacketSize(&packetLength);
 
-    double sumSquared = 0.0;
-    int bytesPerSample = pwfx->wBitsPerSample / 8;
-    int channelCount = pwfx->nChannels;
-    int totalSamples = numFramesAvailable * channelCount;
-
-    // Process each sample
-    for (int i = 0; i < totalSamples; ++i) {
-        // Handle different bit depths correctly
-        float sample = 0.0f;
-
-        if (pwfx->wFormatTag == WAVE_FORMAT_PCM ||
-            (pwfx->wFormatTag == WAVE_FORMAT_EXTENSIBLE &&
-                pwfx->wBitsPerSample <= 16)) {
-
-            // For 16-bit PCM audio
-            if (pwfx->wBitsPerSample == 16) {
-                int16_t sample16 = 0;
-                memcpy(&sample16, pData + (i * bytesPerSample), bytesPerSample);
-                sample = sample16 / 32768.0f;
-            }
-            // For 8-bit PCM audio
-            else if (pwfx->wBitsPerSample == 8) {
-                uint8_t sample8 = pData[i];
-                sample = (sample8 - 128) / 128.0f; // 8-bit is unsigned
-            }
+        if (hr == AUDCLNT_E_DEVICE_INVALIDATED) {
+            reportLost(m_inputRecovery, m_inputSilence, m_pwfxInput, true, hr);
+            break;
         }
-        // For float format (common in WASAPI)
-        else if (pwfx->wFormatTag == WAVE_FORMAT_IEEE_FLOAT ||
-            (pwfx->wFormatTag == WAVE_FORMAT_EXTENSIBLE &&
-                pwfx->wBitsPerSample == 32)) {
-
-            float sampleFloat = 0.0f;
-            memcpy(&sampleFloat, pData + (i * bytesPerSample), bytesPerSample);
-            sample = sampleFloat; // already normalized between -1.0 and 1.0
+        if (FAILED(hr) || packetLength == 0) {
+            break;
+        }
+
+        BYTE* pData;
+        UINT32 numFramesAvailable;
+        DWORD flags;
+
+        hr = m_pInputCaptureClient->GetBuffer(
+            &pData, &numFramesAvailable, &flags, nullptr, nullptr);
+
+        if (FAILED(hr)) {
+            break;
         }
-        // For 24-bit or 32-bit integer PCM
-        else if (pwfx->wBitsPerSample == 24 || pwfx->wBitsPerSample == 32) {
-            int32_t sample32 = 0;
-
-            if (pwfx->wBitsPerSample == 24) {
-                // 24-bit samples need special handling
-                sample32 = (pData[i * 3] << 8) | (pData[i * 3 + 1] << 16) | (pData[i * 3 + 2] << 24);
-                sample32 >>= 8; // Align to 24 bits
-                sample = sample32 / 8388608.0f; // 2^23
-            }
-            else {
-                memcpy(&sample32, pData + (i * bytesPerSample), bytesPerSample);
-                sample = sample32 / 2147483648.0f; // 2^31
-            }
+
+        UINT32 numFrames = convertToFloat(pData, numFramesAvailable, m_inputConverter);
+        framesRead += numFrames;
+        if (flags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) {
+            m_inputDiscontinuities.fetch_add(1, std::memory_order_relaxed);
         }
+        m_inputFilters.process(m_samples.data(), numFrames);
+        m_inputRecorder.push(m_samples.data(), numFrames);
+        m_inputLoudness.process(m_samples.data(), numFrames);
+
+        float rmsVolume = calculateRMSVolume(m_samples.data(), m_samples.size());
+        loudestDb = std::max(loudestDb, convertToDecibels(rmsVolume));
 
-        // Square and accumulate
-        sumSquared += sample * sample;
+        // Always release the buffer
+        m_pInputCaptureClient->ReleaseBuffer(numFramesAvailable);
     }
 
-    // Calculate RMS
-    if (totalSamples > 0) {
-        return std::sqrt(sumSquared / totalSamples);
+    traceCounter("mic audio frames", framesRead);
+    m_inputFrames.fetch_add(framesRead, std::memory_order_relaxed);
+    return loudestDb;
+}
+
+void AudioCapture::collectMetrics(MetricsWriter& writer) const {
+    // Scrape thread: atomics only
+    writer.counter("obs_audio_frames_total", "Audio frames read from the device.",
+        static_cast<double>(m_inputFrames.load(std::memory_order_relaxed)), "device=\"mic\"");
+    writer.counter("obs_audio_frames_total", "Audio frames read from the device.",
+        static_cast<double>(m_outputFrames.load(std::memory_order_relaxed)), "device=\"desktop\"");
+    writer.counter("obs_audio_discontinuities_total", "Packets the device flagged as not following the previous one.",
+        static_cast<double>(m_inputDiscontinuities.load(std::memory_order_relaxed)), "device=\"mic\"");
+    writer.counter("obs_audio_discontinuities_total", "Packets the device flagged as not following the previous one.",
+        static_cast<double>(m_outputDiscontinuities.load(std::memory_order_relaxed)), "device=\"desktop\"");
+    writer.counter("obs_audio_lane_overruns_total", "Audio drain ticks that ran past the next tick's slot.",
+        static_cast<double>(m_audioLane.overruns()));
+    writer.counter("obs_device_losses_total", "Times a capture device went away and recovery started.",
+        static_cast<double>(m_inputRecovery.losses()), "device=\"mic\"");
+    writer.counter("obs_device_losses_total", "Times a capture device went away and recovery started.",
+        static_cast<double>(m_outputRecovery.losses()), "device=\"desktop\"");
+
+    const size_t capacity = m_outputSpectrum.ringCapacity();
+    writer.gauge("obs_audio_ring_fill_ratio", "Fill level of the ring between capture and its consumer.",
+        capacity > 0 ? static_cast<double>(m_outputSpectrum.ringFill()) / capacity : 0.0, "ring=\"desktop_spectrum\"");
+    writer.counter("obs_audio_ring_dropped_samples_total", "Samples dropped because the ring was full.",
+        static_cast<double>(m_outputSpectrum.droppedSamples()), "ring=\"desktop_spectrum\"");
+
+    writer.gauge("obs_output_queue_frames", "Frames queued for an output and not written yet.",
+        static_cast<double>(m_inputRecorder.queuedFrames()), "output=\"flac_mic\"");
+    writer.gauge("obs_output_queue_frames", "Frames queued for an output and not written yet.",
+        static_cast<double>(m_outputRecorder.queuedFrames()), "output=\"flac_desktop\"");
+}
+
+bool AudioCapture::configureConverter(SampleConverter& converter, const WAVEFORMATEX* pwfx) {
+
+    if (!pwfx) return false;
+
+    // Work out the sample format once per stream instead of per sample
+    bool isFloat = pwfx->wFormatTag == WAVE_FORMAT_IEEE_FLOAT;
+    if (pwfx->wFormatTag == WAVE_FORMAT_EXTENSIBLE && pwfx->cbSize >= 22) {
+        const WAVEFORMATEXTENSIBLE* ext = reinterpret_cast<const WAVEFORMATEXTENSIBLE*>(pwfx);
+        isFloat = IsEqualGUID(ext->SubFormat, KSDATAFORMAT_SUBTYPE_IEEE_FLOAT) != FALSE;
     }
 
-    return 0.0f;
+    SampleFormat format;
+    if (isFloat && pwfx->wBitsPerSample == 32) {
+        format = SampleFormat::F32;
+    }
+    else if (pwfx->wBitsPerSample == 8) {
+        format = SampleFormat::U8;
+    }
+    else if (pwfx->wBitsPerSample == 16) {
+        format = SampleFormat::S16;
+    }
+    else if (pwfx->wBitsPerSample == 24) {
+        format = SampleFormat::S24;
+    }
+    else if (pwfx->wBitsPerSample == 32) {
+        format = SampleFormat::S32;
+    }
+    else {
+        qDebug() << "Unsupported sample size:" << pwfx->wBitsPerSample;
+        return false;
+    }
+
+    return converter.configure(format, false, SampleFormat::F32, false, pwfx->nChannels);
+}
+
+UINT32 AudioCapture::convertToFloat(
+    BYTE* pData, UINT32 numFramesAvailable, SampleConverter& converter) {
+
+    m_samples.clear();
+    if (!pData || numFramesAvailable == 0 || !converter.isConfigured()) return 0;
+
+    m_samples.resize(static_cast<size_t>(numFramesAvailable) * converter.channels());
+    converter.convert(pData, m_samples.data(), numFramesAvailable);
+    return numFramesAvailable;
+}
+
+float AudioCapture::calculateRMSVolume(const float* samples, size_t count) {
+
+    if (!samples || count == 0) return 0.0f;
+
+    // Square and accumulate
+    double sumSquared = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        sumSquared += samples[i] * samples[i];
+    }
+
+    // Calculate RMS
+    return static_cast<float>(std::sqrt(sumSquared / count));
 }
 
 float AudioCapture::convertToDecibels(float rmsValue) {
@@ -0,0 +1,64 @@
+#include "incl/AudioFilterChain.h"
+#include <algorithm>
+
+bool AudioFilterChain::configure(int sampleRate, int channels, int blockFrames)
+{
+    if (sampleRate <= 0 || channels < 1 || channels > kMaxChannels || blockFrames < 1) {
+        return false;
+    }
+
+    m_channels = channels;
+    m_groups = (channels + AudioFilter::kLanes - 1) / AudioFilter::kLanes;
+    m_blockFrames = blockFrames;
+    m_block.assign(static_cast<size_t>(blockFrames) * m_groups * AudioFilter::kLanes, 0.0f);
+
+    for (Entry& entry : m_filters) {
+        entry.filter->configure(sampleRate, m_groups, blockFrames);
+        entry.wasEnabled = entry.filter->isEnabled();
+    }
+    return true;
+}
+
+void AudioFilterChain::reset()
+{
+    for (Entry& entry : m_filters) {
+        entry.filter->reset();
+    }
+}
+
+void AudioFilterChain::process(float* interleaved, int frames)
+{
+    if (m_channels == 0 || m_filters.empty()) {
+        return;
+    }
+
+    const int stride = m_groups * AudioFilter::kLanes;
+
+    while (frames > 0) {
+        const int n = std::min(frames, m_blockFrames);
+
+        // Interleaved -> padded groups; the padding lanes stay zero
+        float* block = m_block.data();
+        for (int i = 0; i < n; i++) {
+            std::copy(interleaved + i * m_channels, interleaved + (i + 1) * m_channels, block + i * stride);
+        }
+
+        for (Entry& entry : m_filters) {
+            const bool enabled = entry.filter->isEnabled();
+            if (enabled && !entry.wasEnabled) {
+                entry.filter->reset();
+            }
+            entry.wasEnabled = enabled;
+            if (enabled) {
+                entry.filter->process(block, n);
+            }
+        }
+
+        for (int i = 0; i < n; i++) {
+            std::copy(block + i * stride, block + i * stride + m_channels, interleaved + i * m_channels);
+        }
+
+        interleaved += static_cast<size_t>(n) * m_channels;
+        frames -= n;
+    }
+}
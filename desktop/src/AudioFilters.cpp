@@ -0,0 +1,452 @@
+#include "incl/AudioFilters.h"
+#include "incl/Simd.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr float kPi = 3.14159265358979323846f;
+    constexpr int kLanes = AudioFilter::kLanes;
+
+    // Parameters glide over roughly this long
+    constexpr float kSmoothingMs = 20.0f;
+
+    // One frame of up to four channels
+#ifdef OBS_HAVE_SSE2
+    struct Lanes
+    {
+        __m128 v;
+    };
+    inline Lanes load(const float* p) { return { _mm_loadu_ps(p) }; }
+    inline void store(float* p, Lanes a) { _mm_storeu_ps(p, a.v); }
+    inline Lanes splat(float x) { return { _mm_set1_ps(x) }; }
+    inline Lanes operator+(Lanes a, Lanes b) { return { _mm_add_ps(a.v, b.v) }; }
+    inline Lanes operator-(Lanes a, Lanes b) { return { _mm_sub_ps(a.v, b.v) }; }
+    inline Lanes operator*(Lanes a, Lanes b) { return { _mm_mul_ps(a.v, b.v) }; }
+    inline Lanes absLanes(Lanes a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+    inline Lanes maxLanes(Lanes a, Lanes b) { return { _mm_max_ps(a.v, b.v) }; }
+    inline float horizontalMax(Lanes a)
+    {
+        __m128 m = _mm_max_ps(a.v, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(1, 0, 3, 2)));
+        m = _mm_max_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(m);
+    }
+    // Zeroes lanes that decayed into denormal range
+    inline Lanes flushTiny(Lanes a)
+    {
+        return { _mm_and_ps(a.v, _mm_cmpge_ps(absLanes(a).v, _mm_set1_ps(1e-20f))) };
+    }
+#else
+    struct Lanes
+    {
+        float v[kLanes];
+    };
+    inline Lanes load(const float* p) { Lanes r; for (int i = 0; i < kLanes; i++) r.v[i] = p[i]; return r; }
+    inline void store(float* p, Lanes a) { for (int i = 0; i < kLanes; i++) p[i] = a.v[i]; }
+    inline Lanes splat(float x) { Lanes r; for (int i = 0; i < kLanes; i++) r.v[i] = x; return r; }
+    inline Lanes operator+(Lanes a, Lanes b) { for (int i = 0; i < kLanes; i++) a.v[i] += b.v[i]; return a; }
+    inline Lanes operator-(Lanes a, Lanes b) { for (int i = 0; i < kLanes; i++) a.v[i] -= b.v[i]; return a; }
+    inline Lanes operator*(Lanes a, Lanes b) { for (int i = 0; i < kLanes; i++) a.v[i] *= b.v[i]; return a; }
+    inline Lanes absLanes(Lanes a) { for (int i = 0; i < kLanes; i++) a.v[i] = std::fabs(a.v[i]); return a; }
+    inline Lanes maxLanes(Lanes a, Lanes b) { for (int i = 0; i < kLanes; i++) a.v[i] = std::max(a.v[i], b.v[i]); return a; }
+    inline float horizontalMax(Lanes a) { return std::max(std::max(a.v[0], a.v[1]), std::max(a.v[2], a.v[3])); }
+    inline Lanes flushTiny(Lanes a) { for (int i = 0; i < kLanes; i++) if (std::fabs(a.v[i]) < 1e-20f) a.v[i] = 0.0f; return a; }
+#endif
+
+    // Largest magnitude across all channels of one frame
+    inline float framePeak(const float* frame, int groups)
+    {
+        Lanes peak = absLanes(load(frame));
+        for (int g = 1; g < groups; g++) {
+            peak = maxLanes(peak, absLanes(load(frame + g * kLanes)));
+        }
+        return horizontalMax(peak);
+    }
+
+    inline void scaleFrame(float* frame, int groups, float gain)
+    {
+        const Lanes g = splat(gain);
+        for (int i = 0; i < groups; i++) {
+            store(frame + i * kLanes, load(frame + i * kLanes) * g);
+        }
+    }
+
+    // One-pole coefficient for a time constant in ms
+    inline float timeCoefficient(float ms, int sampleRate)
+    {
+        return ms <= 0.0f ? 0.0f : std::exp(-1.0f / (ms * 0.001f * sampleRate));
+    }
+
+    // Per-block step towards a target, for parameters that must not jump
+    inline float glide(float current, float target, float amount)
+    {
+        const float next = current + (target - current) * amount;
+        return std::fabs(next - target) < 1e-4f ? target : next;
+    }
+
+    inline float dbToGain(float db)
+    {
+        return std::pow(10.0f, db / 20.0f);
+    }
+
+    inline float blockSmoothing(int frames, int sampleRate)
+    {
+        return 1.0f - std::exp(-frames / (kSmoothingMs * 0.001f * sampleRate));
+    }
+}
+
+// NoiseGate
+
+void NoiseGate::configure(int sampleRate, int groups, int)
+{
+    m_sampleRate = sampleRate;
+    m_groups = groups;
+    reset();
+}
+
+void NoiseGate::reset()
+{
+    m_envelope = 0.0f;
+    m_gain = 0.0f;
+    m_holdLeft = 0;
+    m_open = false;
+}
+
+void NoiseGate::process(float* block, int frames)
+{
+    const float openLevel = dbToGain(m_openDb.load(std::memory_order_relaxed));
+    const float closeLevel = std::min(dbToGain(m_closeDb.load(std::memory_order_relaxed)), openLevel);
+    const float attack = timeCoefficient(m_attackMs.load(std::memory_order_relaxed), m_sampleRate);
+    const float release = timeCoefficient(m_releaseMs.load(std::memory_order_relaxed), m_sampleRate);
+    const int holdFrames = static_cast<int>(m_holdMs.load(std::memory_order_relaxed) * 0.001f * m_sampleRate);
+    const float detectorDecay = timeCoefficient(10.0f, m_sampleRate);
+
+    for (int i = 0; i < frames; i++) {
+        float* frame = block + i * m_groups * kLanes;
+
+        const float peak = framePeak(frame, m_groups);
+        m_envelope = std::max(peak, m_envelope * detectorDecay);
+
+        if (m_envelope >= openLevel) {
+            m_open = true;
+            m_holdLeft = holdFrames;
+        }
+        else if (m_open && m_envelope < closeLevel) {
+            if (m_holdLeft > 0) {
+                m_holdLeft--;
+            }
+            else {
+                m_open = false;
+            }
+        }
+
+        const float target = m_open ? 1.0f : 0.0f;
+        const float coefficient = m_open ? attack : release;
+        m_gain = target + (m_gain - target) * coefficient;
+
+        scaleFrame(frame, m_groups, m_gain);
+    }
+}
+
+// Compressor
+
+void Compressor::configure(int sampleRate, int groups, int)
+{
+    m_sampleRate = sampleRate;
+    m_groups = groups;
+    reset();
+}
+
+void Compressor::reset()
+{
+    m_envelope = 0.0f;
+    m_threshold = m_thresholdDb.load();
+    m_ratioValue = std::max(1.0f, m_ratio.load());
+    m_knee = std::max(0.0f, m_kneeDb.load());
+    m_makeup = dbToGain(m_makeupDb.load());
+}
+
+void Compressor::process(float* block, int frames)
+{
+    const float smoothing = blockSmoothing(frames, m_sampleRate);
+    m_threshold = glide(m_threshold, m_thresholdDb.load(std::memory_order_relaxed), smoothing);
+    m_ratioValue = glide(m_ratioValue, std::max(1.0f, m_ratio.load(std::memory_order_relaxed)), smoothing);
+    m_knee = glide(m_knee, std::max(0.0f, m_kneeDb.load(std::memory_order_relaxed)), smoothing);
+
+    // Makeup gain ramps linearly across the block
+    const float makeupStart = m_makeup;
+    const float makeupEnd = glide(m_makeup, dbToGain(m_makeupDb.load(std::memory_order_relaxed)), smoothing);
+    const float makeupStep = (makeupEnd - makeupStart) / frames;
+    m_makeup = makeupEnd;
+
+    const float attack = timeCoefficient(m_attackMs.load(std::memory_order_relaxed), m_sampleRate);
+    const float release = timeCoefficient(m_releaseMs.load(std::memory_order_relaxed), m_sampleRate);
+    const float slope = 1.0f - 1.0f / m_ratioValue;
+    const float kneeStart = m_threshold - m_knee * 0.5f;
+    const float kneeStartLevel = dbToGain(kneeStart);
+
+    for (int i = 0; i < frames; i++) {
+        float* frame = block + i * m_groups * kLanes;
+
+        const float peak = framePeak(frame, m_groups);
+        const float coefficient = peak > m_envelope ? attack : release;
+        m_envelope = peak + (m_envelope - peak) * coefficient;
+
+        // Logs only while the envelope is in or above the knee
+        float gain = makeupStart + makeupStep * i;
+        if (m_envelope > kneeStartLevel) {
+            const float levelDb = 20.0f * std::log10(m_envelope);
+            float reductionDb;
+            if (levelDb < m_threshold + m_knee * 0.5f) {
+                const float over = levelDb - kneeStart;
+                reductionDb = slope * over * over / (2.0f * std::max(m_knee, 1e-3f));
+            }
+            else {
+                reductionDb = slope * (levelDb - m_threshold);
+            }
+            gain *= dbToGain(-reductionDb);
+        }
+
+        scaleFrame(frame, m_groups, gain);
+    }
+}
+
+// Limiter
+
+void Limiter::configure(int sampleRate, int groups, int)
+{
+    m_sampleRate = sampleRate;
+    m_groups = groups;
+    m_window = std::max(1, static_cast<int>(m_lookaheadMs * 0.001f * sampleRate + 0.5f));
+
+    m_delay.assign(static_cast<size_t>(m_window) * groups * kLanes, 0.0f);
+    m_minValue.assign(m_window, 1.0f);
+    m_minTime.assign(m_window, 0);
+    m_average.assign(m_window, 1.0f);
+    reset();
+}
+
+void Limiter::reset()
+{
+    std::fill(m_delay.begin(), m_delay.end(), 0.0f);
+    std::fill(m_average.begin(), m_average.end(), 1.0f);
+    m_time = 0;
+    m_minHead = 0;
+    m_minCount = 0;
+    m_position = 0;
+    m_averageSum = m_window;
+    m_released = 1.0f;
+    m_ceiling = dbToGain(m_ceilingDb.load());
+}
+
+void Limiter::process(float* block, int frames)
+{
+    const float smoothing = blockSmoothing(frames, m_sampleRate);
+    m_ceiling = glide(m_ceiling, dbToGain(m_ceilingDb.load(std::memory_order_relaxed)), smoothing);
+    const float release = timeCoefficient(m_releaseMs.load(std::memory_order_relaxed), m_sampleRate);
+    const int frameFloats = m_groups * kLanes;
+
+    for (int i = 0; i < frames; i++, m_time++) {
+        float* frame = block + i * frameFloats;
+
+        const float peak = framePeak(frame, m_groups);
+        const float required = peak > m_ceiling ? m_ceiling / peak : 1.0f;
+
+        // Sliding minimum of the required gain over the window
+        while (m_minCount > 0) {
+            const int back = (m_minHead + m_minCount - 1) % m_window;
+            if (m_minValue[back] < required) {
+                break;
+            }
+            m_minCount--;
+        }
+        if (m_minCount > 0 && m_minTime[m_minHead] <= m_time - m_window) {
+            m_minHead = (m_minHead + 1) % m_window;
+            m_minCount--;
+        }
+        const int slot = (m_minHead + m_minCount) % m_window;
+        m_minValue[slot] = required;
+        m_minTime[slot] = m_time;
+        m_minCount++;
+        const float windowMin = m_minValue[m_minHead];
+
+        // Drop at once, recover with the release time
+        m_released = windowMin < m_released ? windowMin : windowMin + (m_released - windowMin) * release;
+
+        // Averaging over the window keeps the gain curve smooth and still reaches the
+        // window minimum when the peak leaves the delay line
+        m_averageSum += m_released - m_average[m_position];
+        m_average[m_position] = m_released;
+        const float gain = static_cast<float>(m_averageSum / m_window);
+
+        // Swap the new frame into the delay line and output the one from window - 1 ago
+        float* delayed = m_delay.data() + static_cast<size_t>(m_position) * frameFloats;
+        std::copy(frame, frame + frameFloats, delayed);
+        const int oldest = (m_position + 1) % m_window;
+        const float* out = m_delay.data() + static_cast<size_t>(oldest) * frameFloats;
+        std::copy(out, out + frameFloats, frame);
+        scaleFrame(frame, m_groups, gain);
+
+        m_position = oldest;
+    }
+
+    // Keep the running sum from drifting
+    double sum = 0.0;
+    for (float g : m_average) {
+        sum += g;
+    }
+    m_averageSum = sum;
+}
+
+// ParametricEq
+
+void ParametricEq::setBand(int band, BandType type, float frequency, float gainDb, float q)
+{
+    if (band < 0 || band >= kMaxBands) {
+        return;
+    }
+    Target& t = m_targets[band];
+    t.type.store(static_cast<int>(type));
+    t.frequency.store(frequency);
+    t.gainDb.store(gainDb);
+    t.q.store(q);
+    t.enabled.store(true);
+}
+
+void ParametricEq::setBandEnabled(int band, bool enabled)
+{
+    if (band >= 0 && band < kMaxBands) {
+        m_targets[band].enabled.store(enabled);
+    }
+}
+
+void ParametricEq::configure(int sampleRate, int groups, int)
+{
+    m_sampleRate = sampleRate;
+    m_groups = std::min(groups, 2);
+    reset();
+}
+
+void ParametricEq::reset()
+{
+    for (int i = 0; i < kMaxBands; i++) {
+        Band& band = m_bands[i];
+        band = Band();
+        band.type = m_targets[i].type.load();
+        band.frequency = m_targets[i].frequency.load();
+        band.gainDb = m_targets[i].gainDb.load();
+        band.q = m_targets[i].q.load();
+        updateCoefficients(band);
+    }
+}
+
+void ParametricEq::updateCoefficients(Band& band) const
+{
+    // RBJ audio EQ cookbook
+    const float frequency = std::clamp(band.frequency, 10.0f, m_sampleRate * 0.49f);
+    const float q = std::max(band.q, 0.05f);
+    const float w0 = 2.0f * kPi * frequency / m_sampleRate;
+    const float cosw = std::cos(w0);
+    const float alpha = std::sin(w0) / (2.0f * q);
+    const float a = std::pow(10.0f, band.gainDb / 40.0f);
+
+    float b0, b1, b2, a0, a1, a2;
+    switch (static_cast<BandType>(band.type)) {
+    case BandType::LowShelf: {
+        const float s = 2.0f * std::sqrt(a) * alpha;
+        b0 = a * ((a + 1) - (a - 1) * cosw + s);
+        b1 = 2 * a * ((a - 1) - (a + 1) * cosw);
+        b2 = a * ((a + 1) - (a - 1) * cosw - s);
+        a0 = (a + 1) + (a - 1) * cosw + s;
+        a1 = -2 * ((a - 1) + (a + 1) * cosw);
+        a2 = (a + 1) + (a - 1) * cosw - s;
+        break;
+    }
+    case BandType::HighShelf: {
+        const float s = 2.0f * std::sqrt(a) * alpha;
+        b0 = a * ((a + 1) + (a - 1) * cosw + s);
+        b1 = -2 * a * ((a - 1) + (a + 1) * cosw);
+        b2 = a * ((a + 1) + (a - 1) * cosw - s);
+        a0 = (a + 1) - (a - 1) * cosw + s;
+        a1 = 2 * ((a - 1) - (a + 1) * cosw);
+        a2 = (a + 1) - (a - 1) * cosw - s;
+        break;
+    }
+    case BandType::LowPass:
+        b0 = (1 - cosw) / 2;
+        b1 = 1 - cosw;
+        b2 = (1 - cosw) / 2;
+        a0 = 1 + alpha;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha;
+        break;
+    case BandType::HighPass:
+        b0 = (1 + cosw) / 2;
+        b1 = -(1 + cosw);
+        b2 = (1 + cosw) / 2;
+        a0 = 1 + alpha;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha;
+        break;
+    case BandType::Peak:
+    default:
+        b0 = 1 + alpha * a;
+        b1 = -2 * cosw;
+        b2 = 1 - alpha * a;
+        a0 = 1 + alpha / a;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha / a;
+        break;
+    }
+
+    band.b0 = b0 / a0;
+    band.b1 = b1 / a0;
+    band.b2 = b2 / a0;
+    band.a1 = a1 / a0;
+    band.a2 = a2 / a0;
+}
+
+void ParametricEq::process(float* block, int frames)
+{
+    const float smoothing = blockSmoothing(frames, m_sampleRate);
+    const int stride = m_groups * kLanes;
+
+    for (int i = 0; i < kMaxBands; i++) {
+        const Target& target = m_targets[i];
+        Band& band = m_bands[i];
+        if (!target.enabled.load(std::memory_order_relaxed)) {
+            continue;
+        }
+
+        // Glide frequency (in octaves), gain and Q; a type change switches at once
+        const int type = target.type.load(std::memory_order_relaxed);
+        const float frequency = std::exp2(glide(std::log2(band.frequency),
+            std::log2(std::max(target.frequency.load(std::memory_order_relaxed), 1.0f)), smoothing));
+        const float gainDb = glide(band.gainDb, target.gainDb.load(std::memory_order_relaxed), smoothing);
+        const float q = glide(band.q, target.q.load(std::memory_order_relaxed), smoothing);
+        if (type != band.type || frequency != band.frequency || gainDb != band.gainDb || q != band.q) {
+            band.type = type;
+            band.frequency = frequency;
+            band.gainDb = gainDb;
+            band.q = q;
+            updateCoefficients(band);
+        }
+
+        // Transposed direct form II, all channels of a group in one vector
+        const Lanes b0 = splat(band.b0), b1 = splat(band.b1), b2 = splat(band.b2);
+        const Lanes a1 = splat(band.a1), a2 = splat(band.a2);
+        for (int g = 0; g < m_groups; g++) {
+            Lanes s1 = load(band.state[g][0]);
+            Lanes s2 = load(band.state[g][1]);
+            float* p = block + g * kLanes;
+            for (int n = 0; n < frames; n++, p += stride) {
+                const Lanes x = load(p);
+                const Lanes y = b0 * x + s1;
+                s1 = b1 * x - a1 * y + s2;
+                s2 = b2 * x - a2 * y;
+                store(p, y);
+            }
+            store(band.state[g][0], flushTiny(s1));
+            store(band.state[g][1], flushTiny(s2));
+        }
+    }
+}
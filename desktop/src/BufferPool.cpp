@@ -0,0 +1,309 @@
+#include "incl/BufferPool.h"
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+    : m_pool(other.m_pool), m_data(other.m_data), m_sizeClass(other.m_sizeClass)
+{
+    other.m_pool = nullptr;
+    other.m_data = nullptr;
+    other.m_sizeClass = -1;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept
+{
+    if (this != &other) {
+        reset();
+        m_pool = other.m_pool;
+        m_data = other.m_data;
+        m_sizeClass = other.m_sizeClass;
+        other.m_pool = nullptr;
+        other.m_data = nullptr;
+        other.m_sizeClass = -1;
+    }
+    return *this;
+}
+
+size_t PooledBuffer::capacity() const
+{
+    return m_data ? BufferPool::classSize(m_sizeClass) : 0;
+}
+
+void PooledBuffer::reset()
+{
+    if (m_data) {
+        m_pool->release(m_data, m_sizeClass);
+        m_pool = nullptr;
+        m_data = nullptr;
+        m_sizeClass = -1;
+    }
+}
+
+namespace {
+    enum class CacheState { Unused, Alive, Destroyed };
+    thread_local CacheState t_cacheState = CacheState::Unused;
+
+#ifdef _WIN32
+    // Large pages need SeLockMemoryPrivilege, which an account may hold but a process
+    // has to switch on before the first MEM_LARGE_PAGES allocation
+    bool enableLockMemoryPrivilege()
+    {
+        HANDLE token = nullptr;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+            return false;
+        }
+
+        TOKEN_PRIVILEGES privileges = {};
+        privileges.PrivilegeCount = 1;
+        privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+        // AdjustTokenPrivileges succeeds with ERROR_NOT_ALL_ASSIGNED if the account lacks it
+        bool enabled = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)
+            && AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+            && GetLastError() == ERROR_SUCCESS;
+
+        CloseHandle(token);
+        return enabled;
+    }
+#endif
+}
+
+// A few blocks per small size class kept by each thread, so acquire/release pairs on
+// the same thread (scratch rows, cursor images) don't touch the shared lock. Whatever
+// is left goes back to the shared lists when the thread exits.
+struct ThreadBlockCache
+{
+    static constexpr int kClasses = 33; // 4 KB .. 1 MB
+    static constexpr int kBlocks = 4;
+
+    uint8_t* blocks[kClasses][kBlocks] = {};
+    int counts[kClasses] = {};
+
+    ThreadBlockCache() { t_cacheState = CacheState::Alive; }
+
+    ~ThreadBlockCache()
+    {
+        t_cacheState = CacheState::Destroyed;
+
+        BufferPool& pool = BufferPool::instance();
+        for (int sizeClass = 0; sizeClass < kClasses; sizeClass++) {
+            for (int i = 0; i < counts[sizeClass]; i++) {
+                pool.releaseShared(blocks[sizeClass][i], sizeClass);
+            }
+        }
+    }
+};
+
+namespace {
+    thread_local ThreadBlockCache t_blockCache;
+
+    // Null once the thread is tearing down its thread_locals
+    ThreadBlockCache* threadCache()
+    {
+        return t_cacheState == CacheState::Destroyed ? nullptr : &t_blockCache;
+    }
+}
+
+BufferPool::BufferPool()
+{
+    for (std::vector<uint8_t*>& list : m_free) {
+        list.reserve(4);
+    }
+}
+
+BufferPool::~BufferPool()
+{
+    trim();
+}
+
+BufferPool& BufferPool::instance()
+{
+    static BufferPool* pool = [] {
+        BufferPool* shared = new BufferPool();
+        shared->m_threadCache = true;
+        return shared;
+    }();
+    return *pool;
+}
+
+int BufferPool::sizeClassFor(size_t bytes)
+{
+    if (bytes <= kMinBlock) {
+        return 0;
+    }
+
+    // bytes falls in (base, 2 * base]; split that octave in quarters
+    int octave = 0;
+    while ((kMinBlock << (octave + 1)) < bytes) {
+        octave++;
+    }
+    const size_t base = kMinBlock << octave;
+    const size_t quarter = base / 4;
+    const int sizeClass = octave * 4 + static_cast<int>((bytes - base + quarter - 1) / quarter);
+
+    return sizeClass < kClassCount ? sizeClass : -1;
+}
+
+size_t BufferPool::classSize(int sizeClass)
+{
+    const size_t base = kMinBlock << (sizeClass / 4);
+    return base / 4 * (4 + sizeClass % 4);
+}
+
+PooledBuffer BufferPool::acquire(size_t bytes)
+{
+    const int sizeClass = sizeClassFor(bytes);
+    if (sizeClass < 0) {
+        return PooledBuffer();
+    }
+
+    if (m_threadCache && sizeClass < ThreadBlockCache::kClasses) {
+        ThreadBlockCache* cache = threadCache();
+        if (cache && cache->counts[sizeClass] > 0) {
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return PooledBuffer(this, cache->blocks[sizeClass][--cache->counts[sizeClass]], sizeClass);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<uint8_t*>& list = m_free[sizeClass];
+        if (!list.empty()) {
+            uint8_t* data = list.back();
+            list.pop_back();
+            m_cachedBytes -= classSize(sizeClass);
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return PooledBuffer(this, data, sizeClass);
+        }
+    }
+
+    uint8_t* data = allocateBlock(sizeClass);
+    if (!data) {
+        return PooledBuffer();
+    }
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    m_allocatedBytes.fetch_add(classSize(sizeClass), std::memory_order_relaxed);
+    return PooledBuffer(this, data, sizeClass);
+}
+
+void BufferPool::release(uint8_t* data, int sizeClass)
+{
+    if (m_threadCache && sizeClass < ThreadBlockCache::kClasses) {
+        ThreadBlockCache* cache = threadCache();
+        if (cache && cache->counts[sizeClass] < ThreadBlockCache::kBlocks) {
+            cache->blocks[sizeClass][cache->counts[sizeClass]++] = data;
+            return;
+        }
+    }
+    releaseShared(data, sizeClass);
+}
+
+void BufferPool::releaseShared(uint8_t* data, int sizeClass)
+{
+    const size_t size = classSize(sizeClass);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_cachedBytes + size <= m_cacheLimit) {
+            m_free[sizeClass].push_back(data);
+            m_cachedBytes += size;
+            return;
+        }
+    }
+    freeBlock(data, sizeClass);
+}
+
+void BufferPool::setHugePages(bool enabled)
+{
+#ifdef _WIN32
+    // Only report huge pages when the process can actually get them
+    static const bool privileged = enableLockMemoryPrivilege();
+    enabled = enabled && privileged && GetLargePageMinimum() > 0;
+#endif
+    m_hugePages.store(enabled, std::memory_order_relaxed);
+}
+
+void BufferPool::setCacheLimit(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cacheLimit = bytes;
+}
+
+void BufferPool::trim()
+{
+    for (int sizeClass = 0; sizeClass < kClassCount; sizeClass++) {
+        std::vector<uint8_t*> blocks;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            blocks.swap(m_free[sizeClass]);
+            m_cachedBytes -= blocks.size() * classSize(sizeClass);
+        }
+        for (uint8_t* data : blocks) {
+            freeBlock(data, sizeClass);
+        }
+    }
+}
+
+BufferPool::Stats BufferPool::stats() const
+{
+    Stats stats;
+    stats.hits = m_hits.load(std::memory_order_relaxed);
+    stats.misses = m_misses.load(std::memory_order_relaxed);
+    stats.allocatedBytes = m_allocatedBytes.load(std::memory_order_relaxed);
+    stats.cachedBytes = m_cachedBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+uint8_t* BufferPool::allocateBlock(int sizeClass)
+{
+    const size_t size = classSize(sizeClass);
+
+    if (size >= kLargeBlock) {
+#ifdef _WIN32
+        if (hugePages()) {
+            const size_t pageSize = GetLargePageMinimum();
+            const size_t rounded = (size + pageSize - 1) / pageSize * pageSize;
+            void* data = VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (data) {
+                return static_cast<uint8_t*>(data);
+            }
+            // Physical memory too fragmented for large pages; fall back to normal ones
+        }
+        return static_cast<uint8_t*>(VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            return nullptr;
+        }
+#ifdef MADV_HUGEPAGE
+        if (hugePages()) {
+            madvise(data, size, MADV_HUGEPAGE);
+        }
+#endif
+        return static_cast<uint8_t*>(data);
+#endif
+    }
+
+    return static_cast<uint8_t*>(::operator new(size, std::align_val_t(kAlignment), std::nothrow));
+}
+
+void BufferPool::freeBlock(uint8_t* data, int sizeClass)
+{
+    const size_t size = classSize(sizeClass);
+    m_allocatedBytes.fetch_sub(size, std::memory_order_relaxed);
+
+    if (size >= kLargeBlock) {
+#ifdef _WIN32
+        VirtualFree(data, 0, MEM_RELEASE);
+#else
+        munmap(data, size);
+#endif
+        return;
+    }
+
+    ::operator delete(data, std::align_val_t(kAlignment));
+}
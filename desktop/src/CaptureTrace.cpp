@@ -0,0 +1,545 @@
+#include "incl/CaptureTrace.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace CaptureTrace;
+
+namespace {
+    // Enough for about 18 minutes at 60 fps before the index grows
+    constexpr size_t kIndexReserve = 1 << 16;
+
+    const uint8_t kPadding[8] = {};
+
+    template <typename T>
+    bool readAt(const uint8_t* data, uint64_t size, uint64_t offset, T& out)
+    {
+        if (offset > size || size - offset < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&out, data + offset, sizeof(T));
+        return true;
+    }
+}
+
+bool CaptureTraceWriter::open(const std::string& path)
+{
+    close();
+
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        m_error = "cannot create " + path;
+        return false;
+    }
+
+    FileHeader header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.headerBytes = sizeof(FileHeader);
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    m_offset = sizeof(header);
+    m_index.clear();
+    m_index.reserve(kIndexReserve);
+    m_width = 0;
+    m_height = 0;
+    m_sinceKeyframe = 0;
+    m_bytes.store(m_offset, std::memory_order_relaxed);
+    m_frames.store(0, std::memory_order_relaxed);
+    return static_cast<bool>(m_file);
+}
+
+bool CaptureTraceWriter::close()
+{
+    if (!m_file.is_open()) {
+        return false;
+    }
+    flushAudio();
+
+    Footer footer = {};
+    footer.indexOffset = m_offset;
+    footer.indexCount = m_index.size();
+    std::memcpy(footer.magic, kFooterMagic, sizeof(kFooterMagic));
+    m_file.write(reinterpret_cast<const char*>(m_index.data()), m_index.size() * sizeof(IndexEntry));
+    m_file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+
+    const bool ok = static_cast<bool>(m_file);
+    m_file.close();
+    if (!ok) {
+        m_error = "write failed";
+    }
+    return ok;
+}
+
+bool CaptureTraceWriter::writeFrame(int64_t timestampUs, const FrameView& frame, const ChangeMap* changes)
+{
+    if (!m_file.is_open() || !frame.isValid()) {
+        return false;
+    }
+    TraceScope trace("trace frame");
+    flushAudio();
+
+    // Damage as runs of changed tiles along each tile row
+    m_rects.clear();
+    const bool sizeChanged = frame.width != m_width || frame.height != m_height;
+    if (!changes || changes->tileSize <= 0 || sizeChanged) {
+        m_rects.push_back(RectPayload{ 0, 0, frame.width, frame.height });
+    }
+    else {
+        const int tile = changes->tileSize;
+        for (int ty = 0; ty < changes->tilesY; ty++) {
+            if (!changes->rowChanged[ty]) {
+                continue;
+            }
+            for (int tx = 0; tx < changes->tilesX;) {
+                if (!changes->isChanged(tx, ty)) {
+                    tx++;
+                    continue;
+                }
+                const int first = tx;
+                while (tx < changes->tilesX && changes->isChanged(tx, ty)) {
+                    tx++;
+                }
+                const int x = first * tile;
+                const int y = ty * tile;
+                m_rects.push_back(RectPayload{ x, y, std::min(tx * tile, frame.width) - x, std::min(y + tile, frame.height) - y });
+            }
+        }
+    }
+
+    const bool keyframe = sizeChanged || m_sinceKeyframe >= kKeyframeInterval;
+    uint64_t pixelBytes = 0;
+    if (keyframe) {
+        pixelBytes = static_cast<uint64_t>(frame.width) * frame.height * 4;
+    }
+    else {
+        for (const RectPayload& rect : m_rects) {
+            pixelBytes += static_cast<uint64_t>(rect.width) * rect.height * 4;
+        }
+    }
+
+    FramePayload payload = {};
+    payload.width = static_cast<uint32_t>(frame.width);
+    payload.height = static_cast<uint32_t>(frame.height);
+    payload.rectCount = static_cast<uint32_t>(m_rects.size());
+    beginRecord(Frame, keyframe ? uint32_t(Keyframe) : uint32_t(0),
+        sizeof(payload) + m_rects.size() * sizeof(RectPayload) + pixelBytes, timestampUs);
+    append(&payload, sizeof(payload));
+    append(m_rects.data(), m_rects.size() * sizeof(RectPayload));
+    if (keyframe) {
+        for (int y = 0; y < frame.height; y++) {
+            append(frame.row(y), static_cast<size_t>(frame.width) * 4);
+        }
+    }
+    else {
+        for (const RectPayload& rect : m_rects) {
+            for (int y = rect.y; y < rect.y + rect.height; y++) {
+                append(frame.row(y) + static_cast<size_t>(rect.x) * 4, static_cast<size_t>(rect.width) * 4);
+            }
+        }
+    }
+    endRecord();
+
+    m_width = frame.width;
+    m_height = frame.height;
+    m_sinceKeyframe = keyframe ? 1 : m_sinceKeyframe + 1;
+    m_frames.fetch_add(1, std::memory_order_relaxed);
+    if (!m_file) {
+        m_error = "write failed";
+        return false;
+    }
+    return true;
+}
+
+bool CaptureTraceWriter::writeCursor(int64_t timestampUs, const CursorUpdate& cursor)
+{
+    if (!m_file.is_open()) {
+        return false;
+    }
+    flushAudio();
+
+    CursorPayload payload = {};
+    payload.x = cursor.x;
+    payload.y = cursor.y;
+    payload.visible = cursor.visible ? 1 : 0;
+    payload.shapeType = cursor.shape ? cursor.shapeType : CursorUpdate::Unchanged;
+    payload.width = cursor.width;
+    payload.height = cursor.height;
+    payload.pitch = cursor.pitch;
+    payload.hotX = cursor.hotX;
+    payload.hotY = cursor.hotY;
+    payload.shapeBytes = payload.shapeType != CursorUpdate::Unchanged ? static_cast<uint32_t>(cursor.pitch * cursor.height) : 0;
+
+    beginRecord(Cursor, 0, sizeof(payload) + payload.shapeBytes, timestampUs);
+    append(&payload, sizeof(payload));
+    append(cursor.shape, payload.shapeBytes);
+    endRecord();
+    return static_cast<bool>(m_file);
+}
+
+void CaptureTraceWriter::writeAudio(int64_t timestampUs, int sampleRate, int channels, SampleFormat format,
+    const void* interleaved, int frames)
+{
+    if (frames <= 0) {
+        return;
+    }
+
+    AudioPayload payload = {};
+    payload.sampleRate = static_cast<uint32_t>(sampleRate);
+    payload.channels = static_cast<uint32_t>(channels);
+    payload.format = static_cast<uint32_t>(format);
+    payload.frames = static_cast<uint32_t>(frames);
+    const size_t sampleBytes = static_cast<size_t>(frames) * channels * bytesPerSample(format);
+
+    RecordHeader header = {};
+    header.type = Audio;
+    header.payloadBytes = sizeof(payload) + sampleBytes;
+    header.timestampUs = timestampUs;
+
+    // Laid out as the record will be on disk, so the capture thread just copies it over
+    std::lock_guard<std::mutex> lock(m_audioMutex);
+    const size_t start = m_audioQueue.size();
+    m_audioQueue.resize(start + sizeof(header) + padded(header.payloadBytes));
+    uint8_t* out = m_audioQueue.data() + start;
+    std::memcpy(out, &header, sizeof(header));
+    std::memcpy(out + sizeof(header), &payload, sizeof(payload));
+    std::memcpy(out + sizeof(header) + sizeof(payload), interleaved, sampleBytes);
+    std::memset(out + sizeof(header) + header.payloadBytes, 0, padded(header.payloadBytes) - header.payloadBytes);
+}
+
+void CaptureTraceWriter::flushAudio()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_audioMutex);
+        if (m_audioQueue.empty()) {
+            return;
+        }
+        m_audioWriting.clear();
+        std::swap(m_audioWriting, m_audioQueue);
+    }
+
+    for (size_t at = 0; at < m_audioWriting.size();) {
+        RecordHeader header;
+        std::memcpy(&header, m_audioWriting.data() + at, sizeof(header));
+        const size_t bytes = sizeof(header) + padded(header.payloadBytes);
+        m_index.push_back(IndexEntry{ m_offset, header.timestampUs, header.type, header.flags });
+        m_file.write(reinterpret_cast<const char*>(m_audioWriting.data() + at), bytes);
+        m_offset += bytes;
+        at += bytes;
+    }
+    m_bytes.store(m_offset, std::memory_order_relaxed);
+}
+
+void CaptureTraceWriter::beginRecord(uint32_t type, uint32_t flags, uint64_t payloadBytes, int64_t timestampUs)
+{
+    m_index.push_back(IndexEntry{ m_offset, timestampUs, type, flags });
+
+    RecordHeader header = {};
+    header.type = type;
+    header.flags = flags;
+    header.payloadBytes = payloadBytes;
+    header.timestampUs = timestampUs;
+    append(&header, sizeof(header));
+    m_recordPayload = payloadBytes;
+}
+
+void CaptureTraceWriter::append(const void* data, size_t bytes)
+{
+    if (bytes > 0) {
+        m_file.write(static_cast<const char*>(data), bytes);
+        m_offset += bytes;
+    }
+}
+
+void CaptureTraceWriter::endRecord()
+{
+    append(kPadding, padded(m_recordPayload) - m_recordPayload);
+    m_bytes.store(m_offset, std::memory_order_relaxed);
+}
+
+bool CaptureTraceReader::open(const std::string& path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        m_error = "cannot open " + path;
+        return false;
+    }
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!data) {
+        m_error = "cannot map " + path;
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return false;
+    }
+    m_fileHandle = file;
+    m_mapping = mapping;
+    m_size = static_cast<uint64_t>(size.QuadPart);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        m_error = "cannot open " + path;
+        return false;
+    }
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        m_error = "cannot map " + path;
+        return false;
+    }
+    // Replay reads front to back
+    madvise(data, info.st_size, MADV_SEQUENTIAL);
+    m_size = static_cast<uint64_t>(info.st_size);
+#endif
+    m_data = static_cast<const uint8_t*>(data);
+
+    FileHeader header;
+    if (!readAt(m_data, m_size, 0, header) || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        m_error = path + " is not a capture trace";
+        close();
+        return false;
+    }
+    if (header.version != kVersion) {
+        m_error = path + " is capture trace version " + std::to_string(header.version) +
+            ", expected " + std::to_string(kVersion);
+        close();
+        return false;
+    }
+
+    m_indexRebuilt = !loadIndex();
+    if (m_indexRebuilt && !scanRecords()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void CaptureTraceReader::close()
+{
+    if (m_data) {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+        CloseHandle(m_fileHandle);
+        m_mapping = nullptr;
+        m_fileHandle = nullptr;
+#else
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_records.clear();
+    m_keyframes.clear();
+    m_frameCount = 0;
+    m_width = 0;
+    m_height = 0;
+}
+
+bool CaptureTraceReader::loadIndex()
+{
+    Footer footer;
+    if (m_size < sizeof(FileHeader) + sizeof(Footer) || !readAt(m_data, m_size, m_size - sizeof(Footer), footer) ||
+        std::memcmp(footer.magic, kFooterMagic, sizeof(kFooterMagic)) != 0 ||
+        footer.indexOffset > m_size - sizeof(Footer) ||
+        footer.indexCount != (m_size - sizeof(Footer) - footer.indexOffset) / sizeof(IndexEntry)) {
+        return false;
+    }
+
+    m_records.reserve(footer.indexCount);
+    for (uint64_t i = 0; i < footer.indexCount; i++) {
+        IndexEntry entry;
+        readAt(m_data, m_size, footer.indexOffset + i * sizeof(IndexEntry), entry);
+        if (entry.offset >= footer.indexOffset || !addRecord(entry.offset)) {
+            m_records.clear();
+            m_keyframes.clear();
+            m_frameCount = 0;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CaptureTraceReader::scanRecords()
+{
+    // No usable index: the recording was cut short, keep every complete record
+    uint64_t offset = sizeof(FileHeader);
+    while (addRecord(offset)) {
+        offset += sizeof(RecordHeader) + padded(m_records.back().payloadBytes);
+    }
+    if (m_frameCount == 0) {
+        m_error = "capture trace has no complete frames";
+        return false;
+    }
+    return true;
+}
+
+bool CaptureTraceReader::addRecord(uint64_t offset)
+{
+    RecordHeader header;
+    if (!readAt(m_data, m_size, offset, header) || header.payloadBytes > m_size - offset - sizeof(header) ||
+        (header.type != Frame && header.type != Cursor && header.type != Audio)) {
+        return false;
+    }
+
+    Record record;
+    record.type = header.type;
+    record.flags = header.flags;
+    record.timestampUs = header.timestampUs;
+    record.payload = m_data + offset + sizeof(header);
+    record.payloadBytes = header.payloadBytes;
+
+    if (record.type == Frame) {
+        FramePayload frame;
+        if (!readAt(record.payload, record.payloadBytes, 0, frame)) {
+            return false;
+        }
+        if (m_frameCount == 0) {
+            m_width = static_cast<int>(frame.width);
+            m_height = static_cast<int>(frame.height);
+        }
+        if (record.flags & Keyframe) {
+            m_keyframes.push_back(m_records.size());
+        }
+        m_frameCount++;
+    }
+    m_records.push_back(record);
+    return true;
+}
+
+int64_t CaptureTraceReader::duration() const
+{
+    return m_records.empty() ? 0 : m_records.back().timestampUs - m_records.front().timestampUs;
+}
+
+size_t CaptureTraceReader::keyframeBefore(size_t i) const
+{
+    const auto next = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), i);
+    return next == m_keyframes.begin() ? 0 : *(next - 1);
+}
+
+bool CaptureTraceReader::applyFrame(size_t i, FrameBuffer& target, std::vector<SceneRect>& damage) const
+{
+    TraceScope trace("trace replay");
+    const Record& record = m_records[i];
+    FramePayload payload;
+    if (record.type != Frame || !readAt(record.payload, record.payloadBytes, 0, payload)) {
+        return false;
+    }
+    const int width = static_cast<int>(payload.width);
+    const int height = static_cast<int>(payload.height);
+    const bool keyframe = (record.flags & Keyframe) != 0;
+    const uint64_t rectBytes = static_cast<uint64_t>(payload.rectCount) * sizeof(RectPayload);
+    if (rectBytes > record.payloadBytes - sizeof(payload)) {
+        return false;
+    }
+
+    damage.clear();
+    uint64_t pixelBytes = 0;
+    const uint8_t* rects = record.payload + sizeof(payload);
+    for (uint32_t r = 0; r < payload.rectCount; r++) {
+        RectPayload rect;
+        std::memcpy(&rect, rects + r * sizeof(RectPayload), sizeof(rect));
+        if (rect.x < 0 || rect.y < 0 || rect.width <= 0 || rect.height <= 0 ||
+            rect.x > width - rect.width || rect.y > height - rect.height) {
+            return false;
+        }
+        damage.push_back(SceneRect{ rect.x, rect.y, rect.width, rect.height });
+        pixelBytes += static_cast<uint64_t>(rect.width) * rect.height * 4;
+    }
+    if (keyframe) {
+        pixelBytes = static_cast<uint64_t>(width) * height * 4;
+    }
+    if (pixelBytes > record.payloadBytes - sizeof(payload) - rectBytes) {
+        return false;
+    }
+
+    const uint8_t* pixels = rects + rectBytes;
+    if (keyframe) {
+        target.resize(width, height);
+        const FrameView view = target.view();
+        for (int y = 0; y < height; y++) {
+            std::memcpy(view.row(y), pixels + static_cast<size_t>(y) * width * 4, static_cast<size_t>(width) * 4);
+        }
+        return view.isValid();
+    }
+
+    // A delta only makes sense on top of the frame before it
+    const FrameView view = target.view();
+    if (view.width != width || view.height != height) {
+        return false;
+    }
+    for (const SceneRect& rect : damage) {
+        const size_t rowBytes = static_cast<size_t>(rect.width) * 4;
+        for (int y = rect.y; y < rect.y + rect.height; y++) {
+            std::memcpy(view.row(y) + static_cast<size_t>(rect.x) * 4, pixels, rowBytes);
+            pixels += rowBytes;
+        }
+    }
+    return true;
+}
+
+bool CaptureTraceReader::readCursor(size_t i, CursorUpdate& cursor) const
+{
+    const Record& record = m_records[i];
+    CursorPayload payload;
+    if (record.type != Cursor || !readAt(record.payload, record.payloadBytes, 0, payload) ||
+        payload.shapeBytes > record.payloadBytes - sizeof(payload)) {
+        return false;
+    }
+    cursor.x = payload.x;
+    cursor.y = payload.y;
+    cursor.visible = payload.visible != 0;
+    cursor.shapeType = payload.shapeBytes ? payload.shapeType : CursorUpdate::Unchanged;
+    cursor.width = payload.width;
+    cursor.height = payload.height;
+    cursor.pitch = payload.pitch;
+    cursor.hotX = payload.hotX;
+    cursor.hotY = payload.hotY;
+    cursor.shape = payload.shapeBytes ? record.payload + sizeof(payload) : nullptr;
+    return true;
+}
+
+bool CaptureTraceReader::readAudio(size_t i, AudioPacket& packet) const
+{
+    const Record& record = m_records[i];
+    AudioPayload payload;
+    if (record.type != Audio || !readAt(record.payload, record.payloadBytes, 0, payload) ||
+        payload.format > static_cast<uint32_t>(SampleFormat::F32) || payload.channels == 0) {
+        return false;
+    }
+    const SampleFormat format = static_cast<SampleFormat>(payload.format);
+    if (static_cast<uint64_t>(payload.frames) * payload.channels * bytesPerSample(format) >
+        record.payloadBytes - sizeof(payload)) {
+        return false;
+    }
+    packet.sampleRate = static_cast<int>(payload.sampleRate);
+    packet.channels = static_cast<int>(payload.channels);
+    packet.format = format;
+    packet.frames = static_cast<int>(payload.frames);
+    packet.data = record.payload + sizeof(payload);
+    return true;
+}
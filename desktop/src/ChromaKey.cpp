@@ -0,0 +1,243 @@
+#include "incl/ChromaKey.h"
+#include "incl/Simd.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // BT.709 chroma and luma weights
+    constexpr float kCbR = -0.1146f, kCbG = -0.3854f, kCbB = 0.5f;
+    constexpr float kCrR = 0.5f, kCrG = -0.4542f, kCrB = -0.0458f;
+    constexpr float kLumaR = 0.2126f, kLumaG = 0.7152f, kLumaB = 0.0722f;
+
+    constexpr float kMinRange = 0.001f;
+
+    // HSV plane: the hexcone's chroma point divided by value. Below kMinValue a pixel
+    // has no usable hue and sits at the center, like gray.
+    constexpr float kHalfSqrt3 = 0.8660254f;
+    constexpr float kMinValue = 0.02f;
+
+    inline void chromaPoint(float r, float g, float b, bool hsv, float& x, float& y)
+    {
+        if (hsv) {
+            const float v = std::max(r, std::max(g, b));
+            const float inv = v > kMinValue ? 1.0f / v : 0.0f;
+            x = (r - 0.5f * (g + b)) * inv;
+            y = kHalfSqrt3 * (g - b) * inv;
+        }
+        else {
+            x = kCbR * r + kCbG * g + kCbB * b;
+            y = kCrR * r + kCrG * g + kCrB * b;
+        }
+    }
+}
+
+struct ChromaKeyKernels
+{
+    static void scalar(const ChromaKey& key, uint8_t* bgra, int count)
+    {
+        key.applyScalar(bgra, count);
+    }
+
+#ifdef OBS_HAVE_SSE2
+    template <bool Hsv>
+    static void sse2(const ChromaKey& key, uint8_t* bgra, int count)
+    {
+        const __m128 inv255 = _mm_set1_ps(1.0f / 255.0f);
+        const __m128 v255 = _mm_set1_ps(255.0f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128i byteMask = _mm_set1_epi32(0xFF);
+        const __m128 keyX = _mm_set1_ps(key.m_keyX);
+        const __m128 keyY = _mm_set1_ps(key.m_keyY);
+        const __m128 similarity = _mm_set1_ps(key.m_settings.similarity);
+        const __m128 invSmooth = _mm_set1_ps(key.m_invSmoothness);
+        const __m128 invSpill = _mm_set1_ps(key.m_invSpill);
+
+        int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i* p = reinterpret_cast<__m128i*>(bgra + i * 4);
+            const __m128i px = _mm_loadu_si128(p);
+
+            const __m128 b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(px, byteMask)), inv255);
+            const __m128 g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 8), byteMask)), inv255);
+            const __m128 r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 16), byteMask)), inv255);
+            const __m128 a = _mm_cvtepi32_ps(_mm_srli_epi32(px, 24));
+
+            __m128 dx;
+            __m128 dy;
+            if constexpr (Hsv) {
+                // 1 / v, masked to 0 where v is too dark to have a hue
+                const __m128 v = _mm_max_ps(r, _mm_max_ps(g, b));
+                const __m128 inv = _mm_and_ps(_mm_cmpgt_ps(v, _mm_set1_ps(kMinValue)), _mm_div_ps(one, v));
+                dx = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(r, _mm_mul_ps(_mm_set1_ps(0.5f), _mm_add_ps(g, b))), inv), keyX);
+                dy = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(kHalfSqrt3), _mm_sub_ps(g, b)), inv), keyY);
+            }
+            else {
+                const __m128 cb = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(kCbR)), _mm_mul_ps(g, _mm_set1_ps(kCbG))), _mm_mul_ps(b, _mm_set1_ps(kCbB)));
+                const __m128 cr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(kCrR)), _mm_mul_ps(g, _mm_set1_ps(kCrG))), _mm_mul_ps(b, _mm_set1_ps(kCrB)));
+                dx = _mm_sub_ps(cb, keyX);
+                dy = _mm_sub_ps(cr, keyY);
+            }
+            const __m128 base = _mm_sub_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))), similarity);
+
+            // pow(saturate(x), 1.5) as x * sqrt(x)
+            __m128 mask = _mm_min_ps(_mm_max_ps(_mm_mul_ps(base, invSmooth), zero), one);
+            mask = _mm_mul_ps(mask, _mm_sqrt_ps(mask));
+            __m128 spill = _mm_min_ps(_mm_max_ps(_mm_mul_ps(base, invSpill), zero), one);
+            spill = _mm_mul_ps(spill, _mm_sqrt_ps(spill));
+
+            // Pull the color towards its own luma where it is close to the key
+            const __m128 luma = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(kLumaR)), _mm_mul_ps(g, _mm_set1_ps(kLumaG))), _mm_mul_ps(b, _mm_set1_ps(kLumaB)));
+            const __m128 outR = _mm_add_ps(luma, _mm_mul_ps(_mm_sub_ps(r, luma), spill));
+            const __m128 outG = _mm_add_ps(luma, _mm_mul_ps(_mm_sub_ps(g, luma), spill));
+            const __m128 outB = _mm_add_ps(luma, _mm_mul_ps(_mm_sub_ps(b, luma), spill));
+            const __m128 outA = _mm_mul_ps(a, mask);
+
+            const __m128i ib = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(outB, v255), zero), v255));
+            const __m128i ig = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(outG, v255), zero), v255));
+            const __m128i ir = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(outR, v255), zero), v255));
+            const __m128i ia = _mm_cvtps_epi32(outA);
+
+            __m128i out = _mm_or_si128(ib, _mm_slli_epi32(ig, 8));
+            out = _mm_or_si128(out, _mm_slli_epi32(ir, 16));
+            out = _mm_or_si128(out, _mm_slli_epi32(ia, 24));
+            _mm_storeu_si128(p, out);
+        }
+
+        key.applyScalar(bgra + i * 4, count - i);
+    }
+#endif
+
+#ifdef OBS_HAVE_AVX2
+    template <bool Hsv>
+    OBS_TARGET_AVX2 static void avx2(const ChromaKey& key, uint8_t* bgra, int count)
+    {
+        const __m256 inv255 = _mm256_set1_ps(1.0f / 255.0f);
+        const __m256 v255 = _mm256_set1_ps(255.0f);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256i byteMask = _mm256_set1_epi32(0xFF);
+        const __m256 keyX = _mm256_set1_ps(key.m_keyX);
+        const __m256 keyY = _mm256_set1_ps(key.m_keyY);
+        const __m256 similarity = _mm256_set1_ps(key.m_settings.similarity);
+        const __m256 invSmooth = _mm256_set1_ps(key.m_invSmoothness);
+        const __m256 invSpill = _mm256_set1_ps(key.m_invSpill);
+
+        int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i* p = reinterpret_cast<__m256i*>(bgra + i * 4);
+            const __m256i px = _mm256_loadu_si256(p);
+
+            const __m256 b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(px, byteMask)), inv255);
+            const __m256 g = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 8), byteMask)), inv255);
+            const __m256 r = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 16), byteMask)), inv255);
+            const __m256 a = _mm256_cvtepi32_ps(_mm256_srli_epi32(px, 24));
+
+            __m256 dx;
+            __m256 dy;
+            if constexpr (Hsv) {
+                const __m256 v = _mm256_max_ps(r, _mm256_max_ps(g, b));
+                const __m256 inv = _mm256_and_ps(_mm256_cmp_ps(v, _mm256_set1_ps(kMinValue), _CMP_GT_OQ), _mm256_div_ps(one, v));
+                dx = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(r, _mm256_mul_ps(_mm256_set1_ps(0.5f), _mm256_add_ps(g, b))), inv), keyX);
+                dy = _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(kHalfSqrt3), _mm256_sub_ps(g, b)), inv), keyY);
+            }
+            else {
+                const __m256 cb = _mm256_fmadd_ps(b, _mm256_set1_ps(kCbB), _mm256_fmadd_ps(g, _mm256_set1_ps(kCbG), _mm256_mul_ps(r, _mm256_set1_ps(kCbR))));
+                const __m256 cr = _mm256_fmadd_ps(b, _mm256_set1_ps(kCrB), _mm256_fmadd_ps(g, _mm256_set1_ps(kCrG), _mm256_mul_ps(r, _mm256_set1_ps(kCrR))));
+                dx = _mm256_sub_ps(cb, keyX);
+                dy = _mm256_sub_ps(cr, keyY);
+            }
+            const __m256 base = _mm256_sub_ps(_mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy))), similarity);
+
+            __m256 mask = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(base, invSmooth), zero), one);
+            mask = _mm256_mul_ps(mask, _mm256_sqrt_ps(mask));
+            __m256 spill = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(base, invSpill), zero), one);
+            spill = _mm256_mul_ps(spill, _mm256_sqrt_ps(spill));
+
+            const __m256 luma = _mm256_fmadd_ps(b, _mm256_set1_ps(kLumaB), _mm256_fmadd_ps(g, _mm256_set1_ps(kLumaG), _mm256_mul_ps(r, _mm256_set1_ps(kLumaR))));
+            const __m256 outR = _mm256_fmadd_ps(_mm256_sub_ps(r, luma), spill, luma);
+            const __m256 outG = _mm256_fmadd_ps(_mm256_sub_ps(g, luma), spill, luma);
+            const __m256 outB = _mm256_fmadd_ps(_mm256_sub_ps(b, luma), spill, luma);
+            const __m256 outA = _mm256_mul_ps(a, mask);
+
+            const __m256i ib = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(outB, v255), zero), v255));
+            const __m256i ig = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(outG, v255), zero), v255));
+            const __m256i ir = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(outR, v255), zero), v255));
+            const __m256i ia = _mm256_cvtps_epi32(outA);
+
+            __m256i out = _mm256_or_si256(ib, _mm256_slli_epi32(ig, 8));
+            out = _mm256_or_si256(out, _mm256_slli_epi32(ir, 16));
+            out = _mm256_or_si256(out, _mm256_slli_epi32(ia, 24));
+            _mm256_storeu_si256(p, out);
+        }
+
+        key.applyScalar(bgra + i * 4, count - i);
+    }
+#endif
+};
+
+ChromaKey::ChromaKey()
+    : ChromaKey(Settings())
+{
+}
+
+ChromaKey::ChromaKey(const Settings& settings)
+    : m_settings(settings)
+{
+    const float r = ((settings.keyColor >> 16) & 0xFF) / 255.0f;
+    const float g = ((settings.keyColor >> 8) & 0xFF) / 255.0f;
+    const float b = (settings.keyColor & 0xFF) / 255.0f;
+    const bool hsv = settings.space == Space::Hsv;
+    chromaPoint(r, g, b, hsv, m_keyX, m_keyY);
+    m_invSmoothness = 1.0f / std::max(settings.smoothness, kMinRange);
+    m_invSpill = 1.0f / std::max(settings.spill, kMinRange);
+
+    m_kernel = &ChromaKeyKernels::scalar;
+#ifdef OBS_HAVE_SSE2
+    if (useSse2()) {
+        m_kernel = hsv ? &ChromaKeyKernels::sse2<true> : &ChromaKeyKernels::sse2<false>;
+    }
+#endif
+#ifdef OBS_HAVE_AVX2
+    if (useAvx2()) {
+        m_kernel = hsv ? &ChromaKeyKernels::avx2<true> : &ChromaKeyKernels::avx2<false>;
+    }
+#endif
+}
+
+void ChromaKey::apply(uint8_t* bgra, int count) const
+{
+    m_kernel(*this, bgra, count);
+}
+
+void ChromaKey::applyScalar(uint8_t* bgra, int count) const
+{
+    const bool hsv = m_settings.space == Space::Hsv;
+    for (int i = 0; i < count; i++, bgra += 4) {
+        const float b = bgra[0] / 255.0f;
+        const float g = bgra[1] / 255.0f;
+        const float r = bgra[2] / 255.0f;
+
+        float x;
+        float y;
+        chromaPoint(r, g, b, hsv, x, y);
+        const float dx = x - m_keyX;
+        const float dy = y - m_keyY;
+        const float base = std::sqrt(dx * dx + dy * dy) - m_settings.similarity;
+
+        float mask = std::clamp(base * m_invSmoothness, 0.0f, 1.0f);
+        mask *= std::sqrt(mask);
+        float spill = std::clamp(base * m_invSpill, 0.0f, 1.0f);
+        spill *= std::sqrt(spill);
+
+        const float luma = kLumaR * r + kLumaG * g + kLumaB * b;
+        const float outR = luma + (r - luma) * spill;
+        const float outG = luma + (g - luma) * spill;
+        const float outB = luma + (b - luma) * spill;
+
+        bgra[0] = static_cast<uint8_t>(std::lround(std::clamp(outB * 255.0f, 0.0f, 255.0f)));
+        bgra[1] = static_cast<uint8_t>(std::lround(std::clamp(outG * 255.0f, 0.0f, 255.0f)));
+        bgra[2] = static_cast<uint8_t>(std::lround(std::clamp(outR * 255.0f, 0.0f, 255.0f)));
+        bgra[3] = static_cast<uint8_t>(std::lround(bgra[3] * mask));
+    }
+}
@@ -0,0 +1,148 @@
+#include "incl/DeviceRecovery.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+
+namespace {
+    int64_t nowMicros()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+bool DeviceRecovery::reportLost(Reinit reinit, const std::string& reason)
+{
+    if (state() != State::Running) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_error = reason;
+    }
+    m_reinit = std::move(reinit);
+    m_lostAtUs.store(nowMicros(), std::memory_order_relaxed);
+    m_losses.fetch_add(1, std::memory_order_relaxed);
+    start();
+    return true;
+}
+
+void DeviceRecovery::start()
+{
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = false;
+    }
+    m_fallbackSinceUs = nowMicros();
+    m_fallbackFrames = 0;
+    m_state.store(State::Recovering, std::memory_order_release);
+    m_thread = std::thread(&DeviceRecovery::run, this, m_reinit);
+}
+
+void DeviceRecovery::run(Reinit reinit)
+{
+    const std::string threadName = m_settings.name + " recovery";
+    Tracer::instance().setThreadName(threadName.c_str());
+
+    std::chrono::milliseconds backoff(0);
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_wake.wait_for(lock, backoff, [this] { return m_stopping; })) {
+                return;
+            }
+        }
+
+        m_attempts.fetch_add(1, std::memory_order_relaxed);
+        std::string error;
+        bool ok;
+        {
+            TraceScope trace("device reinit");
+            ok = reinit(error);
+        }
+        if (ok) {
+            // The driving thread picks the device back up in poll()
+            m_state.store(State::Recovered, std::memory_order_release);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_error = error.empty() ? "reinit failed" : error;
+        backoff = backoff.count() == 0 ? std::chrono::milliseconds(m_settings.initialBackoffMs)
+            : std::min(backoff * 2, std::chrono::milliseconds(m_settings.maxBackoffMs));
+    }
+}
+
+bool DeviceRecovery::poll()
+{
+    const State current = state();
+    if (current == State::Stopped) {
+        // Stopped with the device still gone, and the driving thread is back
+        start();
+        return false;
+    }
+    if (current != State::Recovered) {
+        return false;
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    const int64_t outage = nowMicros() - m_lostAtUs.load(std::memory_order_relaxed);
+    if (outage > m_longestOutageUs.load(std::memory_order_relaxed)) {
+        m_longestOutageUs.store(outage, std::memory_order_relaxed);
+    }
+    m_recoveries.fetch_add(1, std::memory_order_relaxed);
+    m_state.store(State::Running, std::memory_order_release);
+    return true;
+}
+
+void DeviceRecovery::stop()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+
+    // No attempt is running now, so a device still lost must not look Recovering
+    if (state() == State::Recovering) {
+        m_state.store(State::Stopped, std::memory_order_release);
+    }
+}
+
+int DeviceRecovery::fallbackFramesDue(int sampleRate, int maxFrames)
+{
+    const State current = state();
+    if (current == State::Running || current == State::Stopped || sampleRate <= 0) {
+        return 0;
+    }
+    const int64_t elapsed = nowMicros() - m_fallbackSinceUs;
+    const uint64_t due = static_cast<uint64_t>(elapsed) * static_cast<uint64_t>(sampleRate) / 1000000;
+    if (due <= m_fallbackFrames) {
+        return 0;
+    }
+    const int frames = static_cast<int>(std::min<uint64_t>(due - m_fallbackFrames, static_cast<uint64_t>(maxFrames)));
+    m_fallbackFrames += frames;
+    return frames;
+}
+
+int64_t DeviceRecovery::currentOutageMicros() const
+{
+    if (state() == State::Running) {
+        return 0;
+    }
+    return nowMicros() - m_lostAtUs.load(std::memory_order_relaxed);
+}
+
+std::string DeviceRecovery::lastError() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_error;
+}
@@ -0,0 +1,256 @@
+#include "incl/Fft.h"
+#include "incl/Simd.h"
+#include <cmath>
+
+namespace {
+    constexpr double kPi = 3.14159265358979323846;
+
+    // One radix-4 butterfly; (a, b, c, d) are the four inputs, outputs are untwiddled
+    // except through w1..w3
+    inline void butterfly4(float ar, float ai, float br, float bi, float cr, float ci, float dr, float di,
+        float w1r, float w1i, float w2r, float w2i, float w3r, float w3i,
+        float* y0r, float* y0i, float* y1r, float* y1i, float* y2r, float* y2i, float* y3r, float* y3i)
+    {
+        const float apcR = ar + cr, apcI = ai + ci;
+        const float amcR = ar - cr, amcI = ai - ci;
+        const float bpdR = br + dr, bpdI = bi + di;
+        // j * (b - d)
+        const float jbmdR = -(bi - di), jbmdI = br - dr;
+
+        *y0r = apcR + bpdR;
+        *y0i = apcI + bpdI;
+        const float t1r = amcR - jbmdR, t1i = amcI - jbmdI;
+        *y1r = w1r * t1r - w1i * t1i;
+        *y1i = w1r * t1i + w1i * t1r;
+        const float t2r = apcR - bpdR, t2i = apcI - bpdI;
+        *y2r = w2r * t2r - w2i * t2i;
+        *y2i = w2r * t2i + w2i * t2r;
+        const float t3r = amcR + jbmdR, t3i = amcI + jbmdI;
+        *y3r = w3r * t3r - w3i * t3i;
+        *y3i = w3r * t3i + w3i * t3r;
+    }
+
+#ifdef OBS_HAVE_SSE2
+    struct Complex4
+    {
+        __m128 re, im;
+    };
+
+    inline Complex4 cmul(__m128 wr, __m128 wi, __m128 xr, __m128 xi)
+    {
+        return { _mm_sub_ps(_mm_mul_ps(wr, xr), _mm_mul_ps(wi, xi)), _mm_add_ps(_mm_mul_ps(wr, xi), _mm_mul_ps(wi, xr)) };
+    }
+
+    // Four butterflies at once
+    inline void butterfly4(__m128 ar, __m128 ai, __m128 br, __m128 bi, __m128 cr, __m128 ci, __m128 dr, __m128 di,
+        __m128 w1r, __m128 w1i, __m128 w2r, __m128 w2i, __m128 w3r, __m128 w3i, Complex4 y[4])
+    {
+        const __m128 apcR = _mm_add_ps(ar, cr), apcI = _mm_add_ps(ai, ci);
+        const __m128 amcR = _mm_sub_ps(ar, cr), amcI = _mm_sub_ps(ai, ci);
+        const __m128 bpdR = _mm_add_ps(br, dr), bpdI = _mm_add_ps(bi, di);
+        const __m128 jbmdR = _mm_sub_ps(di, bi), jbmdI = _mm_sub_ps(br, dr);
+
+        y[0] = { _mm_add_ps(apcR, bpdR), _mm_add_ps(apcI, bpdI) };
+        y[1] = cmul(w1r, w1i, _mm_sub_ps(amcR, jbmdR), _mm_sub_ps(amcI, jbmdI));
+        y[2] = cmul(w2r, w2i, _mm_sub_ps(apcR, bpdR), _mm_sub_ps(apcI, bpdI));
+        y[3] = cmul(w3r, w3i, _mm_add_ps(amcR, jbmdR), _mm_add_ps(amcI, jbmdI));
+    }
+#endif
+}
+
+bool RealFft::configure(int size)
+{
+    if (size < 8 || (size & (size - 1)) != 0) {
+        return false;
+    }
+
+    m_size = size;
+    m_half = size / 2;
+    m_stages.clear();
+
+    for (int b = 0; b < 2; b++) {
+        m_re[b].assign(m_half, 0.0f);
+        m_im[b].assign(m_half, 0.0f);
+    }
+
+    // Radix-4 stages while at least 4 points remain per group
+    int n = m_half;
+    int s = 1;
+    while (n >= 4) {
+        Stage stage;
+        stage.m = n / 4;
+        stage.s = s;
+        stage.w1Re.resize(stage.m);
+        stage.w1Im.resize(stage.m);
+        stage.w2Re.resize(stage.m);
+        stage.w2Im.resize(stage.m);
+        stage.w3Re.resize(stage.m);
+        stage.w3Im.resize(stage.m);
+        for (int p = 0; p < stage.m; p++) {
+            const double angle = -2.0 * kPi * p / n;
+            stage.w1Re[p] = static_cast<float>(std::cos(angle));
+            stage.w1Im[p] = static_cast<float>(std::sin(angle));
+            stage.w2Re[p] = static_cast<float>(std::cos(2.0 * angle));
+            stage.w2Im[p] = static_cast<float>(std::sin(2.0 * angle));
+            stage.w3Re[p] = static_cast<float>(std::cos(3.0 * angle));
+            stage.w3Im[p] = static_cast<float>(std::sin(3.0 * angle));
+        }
+        m_stages.push_back(std::move(stage));
+        n /= 4;
+        s *= 4;
+    }
+    m_finalRadix2 = n == 2;
+
+    m_unpackRe.resize(m_half + 1);
+    m_unpackIm.resize(m_half + 1);
+    for (int k = 0; k <= m_half; k++) {
+        const double angle = -2.0 * kPi * k / size;
+        m_unpackRe[k] = static_cast<float>(std::cos(angle));
+        m_unpackIm[k] = static_cast<float>(std::sin(angle));
+    }
+    return true;
+}
+
+int RealFft::complexForward()
+{
+    int cur = 0;
+#ifdef OBS_HAVE_SSE2
+    const bool sse2 = useSse2();
+#endif
+
+    for (const Stage& stage : m_stages) {
+        const float* xr = m_re[cur].data();
+        const float* xi = m_im[cur].data();
+        float* yr = m_re[cur ^ 1].data();
+        float* yi = m_im[cur ^ 1].data();
+        const int m = stage.m;
+        const int s = stage.s;
+
+#ifdef OBS_HAVE_SSE2
+        if (sse2 && s >= 4) {
+            // Vectorize over q: twiddles are constant per p
+            for (int p = 0; p < m; p++) {
+                const __m128 w1r = _mm_set1_ps(stage.w1Re[p]), w1i = _mm_set1_ps(stage.w1Im[p]);
+                const __m128 w2r = _mm_set1_ps(stage.w2Re[p]), w2i = _mm_set1_ps(stage.w2Im[p]);
+                const __m128 w3r = _mm_set1_ps(stage.w3Re[p]), w3i = _mm_set1_ps(stage.w3Im[p]);
+                for (int q = 0; q < s; q += 4) {
+                    const int in = q + s * p;
+                    const int sm = s * m;
+                    Complex4 y[4];
+                    butterfly4(_mm_loadu_ps(xr + in), _mm_loadu_ps(xi + in),
+                        _mm_loadu_ps(xr + in + sm), _mm_loadu_ps(xi + in + sm),
+                        _mm_loadu_ps(xr + in + 2 * sm), _mm_loadu_ps(xi + in + 2 * sm),
+                        _mm_loadu_ps(xr + in + 3 * sm), _mm_loadu_ps(xi + in + 3 * sm),
+                        w1r, w1i, w2r, w2i, w3r, w3i, y);
+                    const int out = q + s * 4 * p;
+                    for (int k = 0; k < 4; k++) {
+                        _mm_storeu_ps(yr + out + k * s, y[k].re);
+                        _mm_storeu_ps(yi + out + k * s, y[k].im);
+                    }
+                }
+            }
+            cur ^= 1;
+            continue;
+        }
+        if (sse2 && m >= 4) {
+            // First stage (s == 1): vectorize over p, transpose so each group of four
+            // outputs is stored contiguously
+            for (int p = 0; p < m; p += 4) {
+                Complex4 y[4];
+                butterfly4(_mm_loadu_ps(xr + p), _mm_loadu_ps(xi + p),
+                    _mm_loadu_ps(xr + p + m), _mm_loadu_ps(xi + p + m),
+                    _mm_loadu_ps(xr + p + 2 * m), _mm_loadu_ps(xi + p + 2 * m),
+                    _mm_loadu_ps(xr + p + 3 * m), _mm_loadu_ps(xi + p + 3 * m),
+                    _mm_loadu_ps(&stage.w1Re[p]), _mm_loadu_ps(&stage.w1Im[p]),
+                    _mm_loadu_ps(&stage.w2Re[p]), _mm_loadu_ps(&stage.w2Im[p]),
+                    _mm_loadu_ps(&stage.w3Re[p]), _mm_loadu_ps(&stage.w3Im[p]), y);
+                _MM_TRANSPOSE4_PS(y[0].re, y[1].re, y[2].re, y[3].re);
+                _MM_TRANSPOSE4_PS(y[0].im, y[1].im, y[2].im, y[3].im);
+                for (int k = 0; k < 4; k++) {
+                    _mm_storeu_ps(yr + 4 * (p + k), y[k].re);
+                    _mm_storeu_ps(yi + 4 * (p + k), y[k].im);
+                }
+            }
+            cur ^= 1;
+            continue;
+        }
+#endif
+        for (int p = 0; p < m; p++) {
+            for (int q = 0; q < s; q++) {
+                const int in = q + s * p;
+                const int sm = s * m;
+                const int out = q + s * 4 * p;
+                butterfly4(xr[in], xi[in], xr[in + sm], xi[in + sm],
+                    xr[in + 2 * sm], xi[in + 2 * sm], xr[in + 3 * sm], xi[in + 3 * sm],
+                    stage.w1Re[p], stage.w1Im[p], stage.w2Re[p], stage.w2Im[p], stage.w3Re[p], stage.w3Im[p],
+                    yr + out, yi + out, yr + out + s, yi + out + s,
+                    yr + out + 2 * s, yi + out + 2 * s, yr + out + 3 * s, yi + out + 3 * s);
+            }
+        }
+        cur ^= 1;
+    }
+
+    if (m_finalRadix2) {
+        const float* xr = m_re[cur].data();
+        const float* xi = m_im[cur].data();
+        float* yr = m_re[cur ^ 1].data();
+        float* yi = m_im[cur ^ 1].data();
+        const int s = m_half / 2;
+        int q = 0;
+#ifdef OBS_HAVE_SSE2
+        for (; sse2 && q + 4 <= s; q += 4) {
+            const __m128 ar = _mm_loadu_ps(xr + q), ai = _mm_loadu_ps(xi + q);
+            const __m128 br = _mm_loadu_ps(xr + q + s), bi = _mm_loadu_ps(xi + q + s);
+            _mm_storeu_ps(yr + q, _mm_add_ps(ar, br));
+            _mm_storeu_ps(yi + q, _mm_add_ps(ai, bi));
+            _mm_storeu_ps(yr + q + s, _mm_sub_ps(ar, br));
+            _mm_storeu_ps(yi + q + s, _mm_sub_ps(ai, bi));
+        }
+#endif
+        for (; q < s; q++) {
+            const float ar = xr[q], ai = xi[q];
+            const float br = xr[q + s], bi = xi[q + s];
+            yr[q] = ar + br;
+            yi[q] = ai + bi;
+            yr[q + s] = ar - br;
+            yi[q + s] = ai - bi;
+        }
+        cur ^= 1;
+    }
+    return cur;
+}
+
+void RealFft::forward(const float* in, float* re, float* im)
+{
+    if (m_size == 0) {
+        return;
+    }
+
+    // Even samples as the real part, odd samples as the imaginary part
+    float* zr = m_re[0].data();
+    float* zi = m_im[0].data();
+    for (int k = 0; k < m_half; k++) {
+        zr[k] = in[2 * k];
+        zi[k] = in[2 * k + 1];
+    }
+
+    const int result = complexForward();
+    const float* Zr = m_re[result].data();
+    const float* Zi = m_im[result].data();
+
+    // Split into the spectra of the even and odd samples and recombine:
+    // X[k] = E[k] + W^k O[k]
+    re[0] = Zr[0] + Zi[0];
+    im[0] = 0.0f;
+    re[m_half] = Zr[0] - Zi[0];
+    im[m_half] = 0.0f;
+    for (int k = 1; k < m_half; k++) {
+        const float ar = Zr[k], ai = Zi[k];
+        const float br = Zr[m_half - k], bi = -Zi[m_half - k];
+        const float er = 0.5f * (ar + br), ei = 0.5f * (ai + bi);
+        const float or_ = 0.5f * (ai - bi), oi = -0.5f * (ar - br);
+        const float wr = m_unpackRe[k], wi = m_unpackIm[k];
+        re[k] = er + wr * or_ - wi * oi;
+        im[k] = ei + wr * oi + wi * or_;
+    }
+}
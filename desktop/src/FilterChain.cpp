@@ -0,0 +1,166 @@
+#include "incl/FilterChain.h"
+
+void DynamicFilterChain::clear()
+{
+    m_stages.clear();
+    m_passes.clear();
+    m_plannedWidth = -1;
+}
+
+void DynamicFilterChain::addCrop(const CropRect& crop)
+{
+    Stage stage;
+    stage.kind = Stage::Kind::Crop;
+    stage.crop = crop;
+    m_stages.push_back(std::move(stage));
+    m_plannedWidth = -1;
+}
+
+void DynamicFilterChain::addScale(int width, int height)
+{
+    Stage stage;
+    stage.kind = Stage::Kind::Scale;
+    stage.width = width;
+    stage.height = height;
+    m_stages.push_back(std::move(stage));
+    m_plannedWidth = -1;
+}
+
+void DynamicFilterChain::addFilter(std::unique_ptr<Filter> filter)
+{
+    Stage stage;
+    stage.kind = Stage::Kind::Filter;
+    stage.filter = std::move(filter);
+    m_stages.push_back(std::move(stage));
+    m_plannedWidth = -1;
+}
+
+void DynamicFilterChain::plan(int srcWidth, int srcHeight)
+{
+    m_passes.clear();
+    m_plannedWidth = srcWidth;
+    m_plannedHeight = srcHeight;
+
+    int width = srcWidth;
+    int height = srcHeight;
+    Pass* pass = nullptr;
+    bool passScales = false;
+
+    auto startPass = [&]() {
+        m_passes.push_back(std::make_unique<Pass>());
+        pass = m_passes.back().get();
+        pass->width = width;
+        pass->height = height;
+        passScales = false;
+    };
+
+    for (const Stage& stage : m_stages) {
+        switch (stage.kind) {
+        case Stage::Kind::Crop:
+        {
+            // A crop can only go in front of this pass's scale and filters
+            if (!pass || passScales || !pass->filters.empty()) {
+                startPass();
+            }
+
+            // Crops in a row combine into one
+            const int x = std::clamp(stage.crop.x, 0, width);
+            const int y = std::clamp(stage.crop.y, 0, height);
+            const int w = std::max(0, std::min(stage.crop.width, width - x));
+            const int h = std::max(0, std::min(stage.crop.height, height - y));
+            pass->crop.x += x;
+            pass->crop.y += y;
+            pass->crop.width = w;
+            pass->crop.height = h;
+            width = w;
+            height = h;
+            pass->width = width;
+            pass->height = height;
+            break;
+        }
+        case Stage::Kind::Scale:
+            if (!pass || passScales || !pass->filters.empty()) {
+                startPass();
+            }
+            width = stage.width;
+            height = stage.height;
+            pass->width = width;
+            pass->height = height;
+            passScales = true;
+            break;
+        case Stage::Kind::Filter:
+            if (!pass) {
+                startPass();
+            }
+            pass->filters.push_back(stage.filter.get());
+            break;
+        }
+    }
+
+    // Intermediate results need their own storage
+    for (size_t i = 0; i + 1 < m_passes.size(); i++) {
+        if (m_passes[i]->width > 0 && m_passes[i]->height > 0) {
+            m_passes[i]->output.resize(m_passes[i]->width, m_passes[i]->height);
+        }
+    }
+}
+
+void DynamicFilterChain::outputSize(int srcWidth, int srcHeight, int* width, int* height) const
+{
+    *width = srcWidth;
+    *height = srcHeight;
+    for (const Stage& stage : m_stages) {
+        if (stage.kind == Stage::Kind::Crop) {
+            const int x = std::clamp(stage.crop.x, 0, *width);
+            const int y = std::clamp(stage.crop.y, 0, *height);
+            *width = std::max(0, std::min(stage.crop.width, *width - x));
+            *height = std::max(0, std::min(stage.crop.height, *height - y));
+        }
+        else if (stage.kind == Stage::Kind::Scale) {
+            *width = stage.width;
+            *height = stage.height;
+        }
+    }
+}
+
+bool DynamicFilterChain::process(const FrameView& src, const FrameView& dst, ThreadPool* pool)
+{
+    if (!src.isValid() || !dst.isValid()) {
+        return false;
+    }
+
+    if (src.width != m_plannedWidth || src.height != m_plannedHeight) {
+        plan(src.width, src.height);
+    }
+
+    // No stages at all is a plain copy
+    if (m_passes.empty()) {
+        Scaler scaler;
+        return filterchain::runFused(src, CropRect(), scaler, dst, pool, [](uint8_t*, int) {});
+    }
+
+    if (m_passes.back()->width != dst.width || m_passes.back()->height != dst.height) {
+        return false;
+    }
+
+    FrameView input = src;
+    for (size_t i = 0; i < m_passes.size(); i++) {
+        Pass& pass = *m_passes[i];
+        const bool last = i + 1 == m_passes.size();
+        const FrameView output = last ? dst : pass.output.view();
+
+        const std::vector<const Filter*>& filters = pass.filters;
+        const bool ok = filterchain::runFused(input, pass.crop, pass.scaler, output, pool,
+            [&filters](uint8_t* bgra, int count) {
+                for (const Filter* f : filters) {
+                    f->apply(bgra, count);
+                }
+            });
+        if (!ok) {
+            return false;
+        }
+        input = output;
+    }
+
+    return true;
+}
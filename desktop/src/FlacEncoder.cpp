@@ -0,0 +1,1139 @@
+#include "incl/FlacEncoder.h"
+#include "incl/Simd.h"
+#include "incl/ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    constexpr int kMaxLpcOrder = 32;
+    constexpr int kMaxPartitionOrder = 8;
+    constexpr size_t kMaxPartitions = size_t(1) << kMaxPartitionOrder;
+    constexpr int kMaxRiceParameter = 30;  // 5-bit parameters; 4-bit ones stop at 14
+    constexpr int kMaxFixedOrder = 4;
+
+    // CRC-16 uses eight tables so it can consume eight bytes per step
+    struct CrcTables
+    {
+        uint8_t crc8[256];
+        uint16_t crc16[8][256];
+
+        CrcTables()
+        {
+            for (int i = 0; i < 256; i++) {
+                unsigned c8 = i;
+                unsigned c16 = i << 8;
+                for (int bit = 0; bit < 8; bit++) {
+                    c8 = (c8 & 0x80) ? (c8 << 1) ^ 0x07 : c8 << 1;
+                    c16 = (c16 & 0x8000) ? (c16 << 1) ^ 0x8005 : c16 << 1;
+                }
+                crc8[i] = static_cast<uint8_t>(c8);
+                crc16[0][i] = static_cast<uint16_t>(c16);
+            }
+            for (int k = 1; k < 8; k++) {
+                for (int i = 0; i < 256; i++) {
+                    const uint16_t previous = crc16[k - 1][i];
+                    crc16[k][i] = static_cast<uint16_t>((previous << 8) ^ crc16[0][previous >> 8]);
+                }
+            }
+        }
+    };
+
+    const CrcTables& crcTables()
+    {
+        static const CrcTables tables;
+        return tables;
+    }
+
+    uint8_t crc8(const uint8_t* data, size_t size)
+    {
+        const CrcTables& tables = crcTables();
+        uint8_t crc = 0;
+        for (size_t i = 0; i < size; i++) {
+            crc = tables.crc8[crc ^ data[i]];
+        }
+        return crc;
+    }
+
+    uint16_t crc16(const uint8_t* data, size_t size)
+    {
+        const CrcTables& tables = crcTables();
+        const uint16_t (*t)[256] = tables.crc16;
+        unsigned crc = 0;
+        for (; size >= 8; data += 8, size -= 8) {
+            crc ^= (data[0] << 8) | data[1];
+            crc = t[7][crc >> 8] ^ t[6][crc & 0xFF] ^ t[5][data[2]] ^ t[4][data[3]]
+                ^ t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        }
+        for (size_t i = 0; i < size; i++) {
+            crc = ((crc << 8) ^ t[0][(crc >> 8) ^ data[i]]) & 0xFFFF;
+        }
+        return static_cast<uint16_t>(crc);
+    }
+
+    inline uint32_t lowMask(int bits)
+    {
+        return bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+    }
+
+    // MSB-first bit packing into memory the caller has sized, stored 32 bits at a time
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(uint8_t* out) : m_begin(out), m_out(out) {}
+
+        void put(uint32_t value, int bits)
+        {
+            m_acc = (m_acc << bits) | (value & lowMask(bits));
+            m_count += bits;
+            if (m_count >= 32) {
+                m_count -= 32;
+                const uint32_t word = static_cast<uint32_t>(m_acc >> m_count);
+                m_out[0] = static_cast<uint8_t>(word >> 24);
+                m_out[1] = static_cast<uint8_t>(word >> 16);
+                m_out[2] = static_cast<uint8_t>(word >> 8);
+                m_out[3] = static_cast<uint8_t>(word);
+                m_out += 4;
+            }
+        }
+
+        void putSigned(int32_t value, int bits) { put(static_cast<uint32_t>(value), bits); }
+
+        void putZeros(uint32_t count)
+        {
+            while (count >= 32) {
+                put(0, 32);
+                count -= 32;
+            }
+            put(0, static_cast<int>(count));
+        }
+
+        void putRice(const uint32_t* folded, int count, int parameter)
+        {
+            const uint32_t mask = lowMask(parameter);
+            for (int i = 0; i < count; i++) {
+                const uint32_t quotient = folded[i] >> parameter;
+                if (quotient + 1 + parameter <= 32) {
+                    // Unary zeros, the stop bit and the low bits in one go
+                    put((1u << parameter) | (folded[i] & mask), static_cast<int>(quotient) + 1 + parameter);
+                }
+                else {
+                    putZeros(quotient);
+                    put(1, 1);
+                    put(folded[i] & mask, parameter);
+                }
+            }
+        }
+
+        void align()
+        {
+            if (m_count % 8 != 0) {
+                put(0, 8 - m_count % 8);
+            }
+        }
+
+        // Stores pending whole bytes and returns the bytes written so far; call when aligned
+        size_t flush()
+        {
+            while (m_count >= 8) {
+                m_count -= 8;
+                *m_out++ = static_cast<uint8_t>(m_acc >> m_count);
+            }
+            return static_cast<size_t>(m_out - m_begin);
+        }
+
+    private:
+        uint8_t* m_begin;
+        uint8_t* m_out;
+        uint64_t m_acc = 0;
+        int m_count = 0;
+    };
+
+    // Frame number or sample number in FLAC's extended UTF-8 coding
+    void putUtf8(BitWriter& writer, uint64_t value)
+    {
+        if (value < 0x80) {
+            writer.put(static_cast<uint32_t>(value), 8);
+            return;
+        }
+        int bytes = 2;
+        while (bytes < 7 && value >= (uint64_t(1) << (5 * bytes + 1))) {
+            bytes++;
+        }
+        const uint32_t lead = (0xFF00u >> bytes) & 0xFF;
+        writer.put(lead | static_cast<uint32_t>(value >> (6 * (bytes - 1))), 8);
+        for (int i = bytes - 2; i >= 0; i--) {
+            writer.put(0x80 | static_cast<uint32_t>((value >> (6 * i)) & 0x3F), 8);
+        }
+    }
+
+    int blockSizeCode(int frames)
+    {
+        if (frames == 192) {
+            return 1;
+        }
+        for (int code = 2; code <= 5; code++) {
+            if (frames == 576 << (code - 2)) {
+                return code;
+            }
+        }
+        for (int code = 8; code <= 15; code++) {
+            if (frames == 256 << (code - 8)) {
+                return code;
+            }
+        }
+        return frames <= 256 ? 6 : 7; // 8 or 16 bit size at the end of the header
+    }
+
+    int sampleRateCode(int rate)
+    {
+        switch (rate) {
+        case 88200: return 1;
+        case 176400: return 2;
+        case 192000: return 3;
+        case 8000: return 4;
+        case 16000: return 5;
+        case 22050: return 6;
+        case 24000: return 7;
+        case 32000: return 8;
+        case 44100: return 9;
+        case 48000: return 10;
+        case 96000: return 11;
+        default: return 0; // from STREAMINFO
+        }
+    }
+
+    int sampleSizeCode(int bits)
+    {
+        switch (bits) {
+        case 8: return 1;
+        case 12: return 2;
+        case 16: return 4;
+        case 20: return 5;
+        case 24: return 6;
+        default: return 0;
+        }
+    }
+
+    inline uint32_t fold(int32_t value)
+    {
+        return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+    }
+
+    int floorLog2(uint64_t value)
+    {
+        int bits = -1;
+        while (value) {
+            value >>= 1;
+            bits++;
+        }
+        return bits;
+    }
+
+    // How one channel of a block is coded
+    struct Subframe
+    {
+        enum Type { Constant, Verbatim, Fixed, Lpc };
+
+        Type type = Verbatim;
+        int order = 0;
+        int precision = 0;
+        int shift = 0;
+        int32_t coefficients[kMaxLpcOrder] = {};
+
+        int partitionOrder = 0;
+        bool rice2 = false;
+        uint8_t parameters[kMaxPartitions] = {};
+
+        uint64_t bits = 0;
+        std::vector<int32_t> residual;   // residual[order..n)
+    };
+
+    // Per-thread buffers, sized on first use
+    struct Scratch
+    {
+        std::vector<int32_t> mid;
+        std::vector<int32_t> side;
+        std::vector<uint32_t> folded;
+        std::vector<float> windowed;
+        std::vector<float> window;
+        Subframe subframes[FlacEncoder::kMaxChannels];
+        Subframe trial;
+    };
+
+    thread_local Scratch t_scratch;
+
+    // Tukey(0.5) window, the usual choice for FLAC's LPC analysis
+    const std::vector<float>& analysisWindow(Scratch& scratch, int n)
+    {
+        if (static_cast<int>(scratch.window.size()) != n) {
+            scratch.window.assign(n, 1.0f);
+            const int taper = n / 4;
+            const double pi = 3.14159265358979323846;
+            for (int i = 0; i < taper; i++) {
+                const float w = static_cast<float>(0.5 - 0.5 * std::cos(pi * i / taper));
+                scratch.window[i] = w;
+                scratch.window[n - 1 - i] = w;
+            }
+        }
+        return scratch.window;
+    }
+
+
+    int lpcPrecision(int frames, int bitsPerSample)
+    {
+        int precision = frames <= 192 ? 7 : frames <= 384 ? 8 : frames <= 576 ? 9
+            : frames <= 1152 ? 10 : frames <= 2304 ? 11 : frames <= 4608 ? 12 : 13;
+        if (bitsPerSample > 16) {
+            precision += 2;
+        }
+        return std::min(precision, 15);
+    }
+
+    // autoc[lag] for lags [first, last]. The SIMD versions compute whole groups of lags,
+    // so data must be zero-padded by kLagPadding samples past maxLag and autoc must have
+    // room for the extra lags.
+    constexpr int kLagPadding = 8;
+
+    void autocorrelationScalar(const float* data, int n, int first, int last, double* autoc)
+    {
+        for (int lag = first; lag <= last; lag++) {
+            double sum = 0.0;
+            for (int i = 0; i < n; i++) {
+                sum += static_cast<double>(data[i]) * data[i + lag];
+            }
+            autoc[lag] = sum;
+        }
+    }
+
+    void autocorrelationSse2(const float* data, int n, int maxLag, double* autoc)
+    {
+        int lag = 0;
+#if defined(OBS_HAVE_SSE2)
+        // Two lags per register: the sample is broadcast against x[i + lag], x[i + lag + 1]
+        const bool sse2 = useSse2();
+        for (; sse2 && lag <= maxLag; lag += 2) {
+            __m128d acc = _mm_setzero_pd();
+            for (int i = 0; i < n; i++) {
+                const __m128d pair = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data + i + lag))));
+                acc = _mm_add_pd(acc, _mm_mul_pd(_mm_set1_pd(data[i]), pair));
+            }
+            _mm_storeu_pd(autoc + lag, acc);
+        }
+#endif
+        autocorrelationScalar(data, n, lag, maxLag, autoc);
+    }
+
+#if defined(OBS_HAVE_AVX2)
+    OBS_TARGET_AVX2 void autocorrelationAvx2(const float* data, int n, int maxLag, double* autoc)
+    {
+        // Up to three groups of four lags per pass over the data
+        for (int lag = 0; lag <= maxLag; lag += 12) {
+            const int groups = std::min(3, (maxLag - lag) / 4 + 1);
+            __m256d acc[3] = { _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd() };
+            for (int i = 0; i < n; i++) {
+                const __m256d x = _mm256_set1_pd(data[i]);
+                for (int g = 0; g < groups; g++) {
+                    acc[g] = _mm256_fmadd_pd(x, _mm256_cvtps_pd(_mm_loadu_ps(data + i + lag + 4 * g)), acc[g]);
+                }
+            }
+            for (int g = 0; g < groups; g++) {
+                _mm256_storeu_pd(autoc + lag + 4 * g, acc[g]);
+            }
+        }
+    }
+#endif
+
+    // Levinson-Durbin: lp[order - 1][j] predicts x[i] from x[i - 1 - j]. Returns the
+    // highest usable order.
+    int levinson(const double* autoc, int maxOrder, double lp[][kMaxLpcOrder], double* error)
+    {
+        double a[kMaxLpcOrder] = {};
+        double err = autoc[0];
+
+        for (int i = 0; i < maxOrder; i++) {
+            double acc = autoc[i + 1];
+            for (int j = 0; j < i; j++) {
+                acc -= a[j] * autoc[i - j];
+            }
+            const double k = acc / err;
+
+            double next[kMaxLpcOrder];
+            for (int j = 0; j < i; j++) {
+                next[j] = a[j] - k * a[i - 1 - j];
+            }
+            next[i] = k;
+            std::copy(next, next + i + 1, a);
+            std::copy(a, a + i + 1, lp[i]);
+
+            err *= 1.0 - k * k;
+            error[i] = err;
+            if (err <= 0.0) {
+                return i + 1;
+            }
+        }
+        return maxOrder;
+    }
+
+    // Coefficients to `precision`-bit integers with error feedback; false if they do not fit
+    bool quantize(const double* lp, int order, int precision, int32_t* qlp, int* shift)
+    {
+        double cmax = 0.0;
+        for (int i = 0; i < order; i++) {
+            cmax = std::max(cmax, std::fabs(lp[i]));
+        }
+        if (!(cmax > 0.0)) {
+            return false;
+        }
+
+        int log2cmax;
+        std::frexp(cmax, &log2cmax);
+        log2cmax--;
+        *shift = std::min(precision - 1 - log2cmax, 15);
+        if (*shift < 0) {
+            return false;
+        }
+
+        const int32_t qmax = (1 << (precision - 1)) - 1;
+        const int32_t qmin = -(1 << (precision - 1));
+        double error = 0.0;
+        for (int i = 0; i < order; i++) {
+            error += lp[i] * (1 << *shift);
+            const int32_t q = std::clamp(static_cast<int32_t>(std::lround(error)), qmin, qmax);
+            error -= q;
+            qlp[i] = q;
+        }
+        return true;
+    }
+
+    // Residuals have to stay well inside 32 bits for the decoder
+    constexpr int64_t kMaxResidual = (int64_t(1) << 30) - 1;
+
+    bool lpcResidualScalar(const int32_t* x, int begin, int n, const int32_t* qlp, int order, int shift, int32_t* residual)
+    {
+        for (int i = begin; i < n; i++) {
+            int64_t sum = 0;
+            for (int j = 0; j < order; j++) {
+                sum += static_cast<int64_t>(qlp[j]) * x[i - 1 - j];
+            }
+            const int64_t r = x[i] - (sum >> shift);
+            if (r > kMaxResidual || r < -kMaxResidual) {
+                return false;
+            }
+            residual[i] = static_cast<int32_t>(r);
+        }
+        return true;
+    }
+
+#if defined(OBS_HAVE_AVX2)
+    // Eight residuals at a time with 32-bit sums. Only valid when the sums cannot
+    // overflow, and then identical to the 64-bit version.
+    OBS_TARGET_AVX2 bool lpcResidualAvx2(const int32_t* x, int n, const int32_t* qlp, int order, int shift, int32_t* residual)
+    {
+        const __m128i count = _mm_cvtsi32_si128(shift);
+        __m256i magnitude = _mm256_setzero_si256();
+        int i = order;
+        for (; i + 8 <= n; i += 8) {
+            __m256i sum = _mm256_setzero_si256();
+            for (int j = 0; j < order; j++) {
+                const __m256i samples = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i - 1 - j));
+                sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_set1_epi32(qlp[j]), samples));
+            }
+            const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));
+            const __m256i r = _mm256_sub_epi32(current, _mm256_sra_epi32(sum, count));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(residual + i), r);
+            magnitude = _mm256_or_si256(magnitude, _mm256_abs_epi32(r));
+        }
+
+        // Any lane at or above 2^30 sets a bit the mask keeps
+        const __m256i tooLarge = _mm256_andnot_si256(_mm256_set1_epi32(static_cast<int32_t>(kMaxResidual)), magnitude);
+        if (!_mm256_testz_si256(tooLarge, tooLarge)) {
+            return false;
+        }
+        return lpcResidualScalar(x, i, n, qlp, order, shift, residual);
+    }
+
+    // Four residuals at a time with 64-bit sums, for 24-bit audio and side channels
+    OBS_TARGET_AVX2 bool lpcResidualWideAvx2(const int32_t* x, int n, const int32_t* qlp, int order, int shift, int32_t* residual)
+    {
+        const __m128i count = _mm_cvtsi32_si128(shift);
+        const __m256i limit = _mm256_set1_epi64x(kMaxResidual);
+        const __m256i negativeLimit = _mm256_set1_epi64x(-kMaxResidual);
+        const __m256i evenLanes = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+        __m256i outOfRange = _mm256_setzero_si256();
+        int i = order;
+        for (; i + 4 <= n; i += 4) {
+            __m256i sum = _mm256_setzero_si256();
+            for (int j = 0; j < order; j++) {
+                const __m256i samples = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i - 1 - j)));
+                sum = _mm256_add_epi64(sum, _mm256_mul_epi32(_mm256_set1_epi64x(qlp[j]), samples));
+            }
+            // Arithmetic 64-bit shift from a logical one: flip negative values around it
+            const __m256i sign = _mm256_cmpgt_epi64(_mm256_setzero_si256(), sum);
+            const __m256i prediction = _mm256_xor_si256(_mm256_srl_epi64(_mm256_xor_si256(sum, sign), count), sign);
+
+            const __m256i current = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i)));
+            const __m256i r = _mm256_sub_epi64(current, prediction);
+            outOfRange = _mm256_or_si256(outOfRange, _mm256_or_si256(_mm256_cmpgt_epi64(r, limit), _mm256_cmpgt_epi64(negativeLimit, r)));
+
+            const __m256i packed = _mm256_permutevar8x32_epi32(r, evenLanes);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(residual + i), _mm256_castsi256_si128(packed));
+        }
+        if (!_mm256_testz_si256(outOfRange, outOfRange)) {
+            return false;
+        }
+        return lpcResidualScalar(x, i, n, qlp, order, shift, residual);
+    }
+#endif
+
+    bool lpcResidual(const int32_t* x, int n, int bitsPerSample, const int32_t* qlp, int precision, int order, int shift, int32_t* residual)
+    {
+#if defined(OBS_HAVE_AVX2)
+        if (useAvx2()) {
+            // Sums stay below 2^30 when this holds, so 32-bit lanes are exact
+            if (bitsPerSample + precision + floorLog2(static_cast<uint64_t>(order) * 2 - 1) <= 32) {
+                return lpcResidualAvx2(x, n, qlp, order, shift, residual);
+            }
+            return lpcResidualWideAvx2(x, n, qlp, order, shift, residual);
+        }
+#endif
+        return lpcResidualScalar(x, order, n, qlp, order, shift, residual);
+    }
+
+    void fixedResidual(const int32_t* x, int n, int order, int32_t* residual)
+    {
+        switch (order) {
+        case 0:
+            std::copy(x, x + n, residual);
+            break;
+        case 1:
+            for (int i = 1; i < n; i++) {
+                residual[i] = x[i] - x[i - 1];
+            }
+            break;
+        case 2:
+            for (int i = 2; i < n; i++) {
+                residual[i] = x[i] - 2 * x[i - 1] + x[i - 2];
+            }
+            break;
+        case 3:
+            for (int i = 3; i < n; i++) {
+                residual[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+            }
+            break;
+        default:
+            for (int i = 4; i < n; i++) {
+                residual[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+            }
+            break;
+        }
+    }
+
+    // Fixed predictor with the smallest sum of absolute residuals
+    int bestFixedOrder(const int32_t* x, int n)
+    {
+        uint64_t total[kMaxFixedOrder + 1] = {};
+        int i = kMaxFixedOrder;
+#if defined(OBS_HAVE_SSE2)
+        // From the first differences a..d of x[i]..x[i-4]; |e| summed in 64-bit lanes
+        const __m128i zero = _mm_setzero_si128();
+        __m128i sums[kMaxFixedOrder + 1] = { zero, zero, zero, zero, zero };
+        const bool sse2 = useSse2();
+        auto accumulate = [&](int order, __m128i e) {
+            const __m128i sign = _mm_srai_epi32(e, 31);
+            const __m128i magnitude = _mm_sub_epi32(_mm_xor_si128(e, sign), sign);
+            sums[order] = _mm_add_epi64(sums[order], _mm_unpacklo_epi32(magnitude, zero));
+            sums[order] = _mm_add_epi64(sums[order], _mm_unpackhi_epi32(magnitude, zero));
+        };
+        for (; sse2 && i + 4 <= n; i += 4) {
+            const __m128i x0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+            const __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i - 1));
+            const __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i - 2));
+            const __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i - 3));
+            const __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i - 4));
+            const __m128i a = _mm_sub_epi32(x0, x1);
+            const __m128i b = _mm_sub_epi32(x1, x2);
+            const __m128i c = _mm_sub_epi32(x2, x3);
+            const __m128i d = _mm_sub_epi32(x3, x4);
+            const __m128i b2 = _mm_sub_epi32(b, c);
+            const __m128i e2 = _mm_sub_epi32(a, b);
+            const __m128i e3 = _mm_sub_epi32(e2, b2);
+            accumulate(0, x0);
+            accumulate(1, a);
+            accumulate(2, e2);
+            accumulate(3, e3);
+            accumulate(4, _mm_sub_epi32(e3, _mm_sub_epi32(b2, _mm_sub_epi32(c, d))));
+        }
+        for (int order = 0; order <= kMaxFixedOrder; order++) {
+            alignas(16) uint64_t lanes[2];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sums[order]);
+            total[order] = lanes[0] + lanes[1];
+        }
+#endif
+        for (; i < n; i++) {
+            const int64_t e0 = x[i];
+            const int64_t e1 = e0 - x[i - 1];
+            const int64_t e2 = e1 - (static_cast<int64_t>(x[i - 1]) - x[i - 2]);
+            const int64_t e3 = e2 - (static_cast<int64_t>(x[i - 1]) - 2 * static_cast<int64_t>(x[i - 2]) + x[i - 3]);
+            const int64_t e4 = e3 - (static_cast<int64_t>(x[i - 1]) - 3 * static_cast<int64_t>(x[i - 2]) + 3 * static_cast<int64_t>(x[i - 3]) - x[i - 4]);
+            total[0] += std::abs(e0);
+            total[1] += std::abs(e1);
+            total[2] += std::abs(e2);
+            total[3] += std::abs(e3);
+            total[4] += std::abs(e4);
+        }
+        return static_cast<int>(std::min_element(total, total + kMaxFixedOrder + 1) - total);
+    }
+
+    // Zigzag-folds residuals and returns their sum
+    uint64_t foldResidual(const int32_t* residual, int count, uint32_t* folded)
+    {
+        int i = 0;
+        uint64_t sum = 0;
+#if defined(OBS_HAVE_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = zero;
+        const bool sse2 = useSse2();
+        for (; sse2 && i + 4 <= count; i += 4) {
+            const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(residual + i));
+            const __m128i u = _mm_xor_si128(_mm_slli_epi32(r, 1), _mm_srai_epi32(r, 31));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(folded + i), u);
+            acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(u, zero));
+            acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(u, zero));
+        }
+        alignas(16) uint64_t lanes[2];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        sum = lanes[0] + lanes[1];
+#endif
+        for (; i < count; i++) {
+            folded[i] = fold(residual[i]);
+            sum += folded[i];
+        }
+        return sum;
+    }
+
+    // Rice parameter with the fewest estimated bits for a partition
+    int riceParameter(uint64_t sum, int count, uint64_t* bits)
+    {
+        if (count == 0) {
+            *bits = 0;
+            return 0;
+        }
+        const uint64_t mean = sum / count;
+        int best = mean > 0 ? std::min(floorLog2(mean), kMaxRiceParameter) : 0;
+        uint64_t bestBits = static_cast<uint64_t>(count) * (best + 1) + (sum >> best);
+        if (best < kMaxRiceParameter) {
+            const uint64_t up = static_cast<uint64_t>(count) * (best + 2) + (sum >> (best + 1));
+            if (up < bestBits) {
+                best++;
+                bestBits = up;
+            }
+        }
+        *bits = bestBits;
+        return best;
+    }
+
+    // Picks the partition order and Rice parameters for residual[order..n) and returns
+    // the estimated size of the residual section. Sums at the finest order are merged
+    // pairwise for each coarser one.
+    uint64_t choosePartitions(const int32_t* residual, int n, int order, int maxPartitionOrder, Subframe& subframe, Scratch& scratch)
+    {
+        // Clamped here too, so the compiler sees every partition count fits the arrays
+        int finest = std::clamp(maxPartitionOrder, 0, kMaxPartitionOrder);
+        while (finest > 0 && ((n & ((1 << finest) - 1)) != 0 || (n >> finest) <= order)) {
+            finest--;
+        }
+
+        scratch.folded.resize(n);
+        uint64_t sums[kMaxPartitions];
+        const int length = n >> finest;
+        for (int p = 0; p < (1 << finest); p++) {
+            const int begin = p == 0 ? order : p * length;
+            const int end = (p + 1) * length;
+            sums[p] = foldResidual(residual + begin, end - begin, scratch.folded.data() + begin);
+        }
+
+        uint64_t bestBits = ~uint64_t(0);
+        for (int partitionOrder = finest; partitionOrder >= 0; partitionOrder--) {
+            const size_t partitions = std::min(size_t(1) << partitionOrder, kMaxPartitions);
+            const int partitionLength = n >> partitionOrder;
+            uint8_t parameters[kMaxPartitions];
+            uint64_t bits = 6;
+            int maxParameter = 0;
+            for (size_t p = 0; p < partitions; p++) {
+                uint64_t partitionBits;
+                parameters[p] = static_cast<uint8_t>(riceParameter(sums[p], partitionLength - (p == 0 ? order : 0), &partitionBits));
+                maxParameter = std::max<int>(maxParameter, parameters[p]);
+                bits += partitionBits;
+            }
+            const bool rice2 = maxParameter > 14;
+            bits += partitions * (rice2 ? 5 : 4);
+
+            if (bits < bestBits) {
+                bestBits = bits;
+                subframe.partitionOrder = partitionOrder;
+                subframe.rice2 = rice2;
+                std::copy(parameters, parameters + partitions, subframe.parameters);
+            }
+
+            for (size_t p = 0; p < partitions / 2; p++) {
+                sums[p] = sums[2 * p] + sums[2 * p + 1];
+            }
+        }
+        return bestBits;
+    }
+
+    // Chooses how to code one channel; x has n samples of bitsPerSample bits
+    void analyzeChannel(const int32_t* x, int n, int bitsPerSample, const FlacEncoder::Settings& settings, Subframe& best, Scratch& scratch)
+    {
+        best.order = 0;
+        if (std::all_of(x + 1, x + n, [&](int32_t v) { return v == x[0]; })) {
+            best.type = Subframe::Constant;
+            best.bits = 8 + bitsPerSample;
+            return;
+        }
+        best.type = Subframe::Verbatim;
+        best.bits = 8 + static_cast<uint64_t>(n) * bitsPerSample;
+        if (n <= kMaxFixedOrder) {
+            return;
+        }
+
+        Subframe& trial = scratch.trial;
+        trial.residual.resize(n);
+        best.residual.resize(n);
+
+        const int fixedOrder = bestFixedOrder(x, n);
+        fixedResidual(x, n, fixedOrder, trial.residual.data());
+        const uint64_t fixedBits = 8 + static_cast<uint64_t>(fixedOrder) * bitsPerSample
+            + choosePartitions(trial.residual.data(), n, fixedOrder, settings.maxPartitionOrder, trial, scratch);
+        if (fixedBits < best.bits) {
+            trial.type = Subframe::Fixed;
+            trial.order = fixedOrder;
+            trial.bits = fixedBits;
+            std::swap(best, trial);
+        }
+
+        const int maxOrder = std::min(settings.maxLpcOrder, n - 1);
+        if (maxOrder <= 0) {
+            return;
+        }
+
+        // Windowed copy padded for the autocorrelation loads
+        const std::vector<float>& window = analysisWindow(scratch, n);
+        scratch.windowed.assign(n + maxOrder + kLagPadding, 0.0f);
+        for (int i = 0; i < n; i++) {
+            scratch.windowed[i] = x[i] * window[i];
+        }
+
+        double autoc[kMaxLpcOrder + kLagPadding];
+#if defined(OBS_HAVE_AVX2)
+        if (useAvx2()) {
+            autocorrelationAvx2(scratch.windowed.data(), n, maxOrder, autoc);
+        }
+        else
+#endif
+        {
+            autocorrelationSse2(scratch.windowed.data(), n, maxOrder, autoc);
+        }
+        if (!(autoc[0] > 0.0)) {
+            return;
+        }
+
+        double lp[kMaxLpcOrder][kMaxLpcOrder];
+        double error[kMaxLpcOrder];
+        const int orders = levinson(autoc, maxOrder, lp, error);
+        const int precision = lpcPrecision(n, bitsPerSample);
+
+        // Expected size from the prediction error; code either that order or all of them
+        int firstOrder = 1;
+        int lastOrder = orders;
+        if (!settings.exhaustiveOrderSearch) {
+            double bestEstimate = 0.0;
+            for (int order = 1; order <= orders; order++) {
+                const double bitsPerResidual = error[order - 1] > 0.0
+                    ? std::max(0.0, 0.5 * std::log2(0.5 * error[order - 1] / n)) : 0.0;
+                const double estimate = bitsPerResidual * (n - order) + order * (bitsPerSample + precision);
+                if (order == 1 || estimate < bestEstimate) {
+                    bestEstimate = estimate;
+                    firstOrder = order;
+                }
+            }
+            lastOrder = firstOrder;
+        }
+
+        for (int order = firstOrder; order <= lastOrder; order++) {
+            if (!quantize(lp[order - 1], order, precision, trial.coefficients, &trial.shift)) {
+                continue;
+            }
+            if (!lpcResidual(x, n, bitsPerSample, trial.coefficients, precision, order, trial.shift, trial.residual.data())) {
+                continue;
+            }
+            const uint64_t bits = 8 + static_cast<uint64_t>(order) * (bitsPerSample + precision) + 4 + 5
+                + choosePartitions(trial.residual.data(), n, order, settings.maxPartitionOrder, trial, scratch);
+            if (bits < best.bits) {
+                trial.type = Subframe::Lpc;
+                trial.order = order;
+                trial.precision = precision;
+                trial.bits = bits;
+                std::swap(best, trial);
+                trial.residual.resize(n);
+            }
+        }
+    }
+
+    void writeSubframe(BitWriter& writer, const Subframe& subframe, const int32_t* x, int n, int bitsPerSample, Scratch& scratch)
+    {
+        const int order = subframe.order;
+        switch (subframe.type) {
+        case Subframe::Constant:
+            writer.put(0x00, 8);
+            writer.putSigned(x[0], bitsPerSample);
+            return;
+        case Subframe::Verbatim:
+            writer.put(0x02, 8);
+            for (int i = 0; i < n; i++) {
+                writer.putSigned(x[i], bitsPerSample);
+            }
+            return;
+        case Subframe::Fixed:
+            writer.put((0x08 | order) << 1, 8);
+            break;
+        case Subframe::Lpc:
+            writer.put((0x20 | (order - 1)) << 1, 8);
+            break;
+        }
+
+        for (int i = 0; i < order; i++) {
+            writer.putSigned(x[i], bitsPerSample);
+        }
+        if (subframe.type == Subframe::Lpc) {
+            writer.put(subframe.precision - 1, 4);
+            writer.putSigned(subframe.shift, 5);
+            for (int i = 0; i < order; i++) {
+                writer.putSigned(subframe.coefficients[i], subframe.precision);
+            }
+        }
+
+        // Residual, Rice coded per partition
+        const int partitions = 1 << subframe.partitionOrder;
+        const int length = n >> subframe.partitionOrder;
+        scratch.folded.resize(n);
+        foldResidual(subframe.residual.data() + order, n - order, scratch.folded.data() + order);
+
+        writer.put(subframe.rice2 ? 1 : 0, 2);
+        writer.put(subframe.partitionOrder, 4);
+        for (int p = 0; p < partitions; p++) {
+            const int begin = p == 0 ? order : p * length;
+            const int end = (p + 1) * length;
+            writer.put(subframe.parameters[p], subframe.rice2 ? 5 : 4);
+            writer.putRice(scratch.folded.data() + begin, end - begin, subframe.parameters[p]);
+        }
+    }
+}
+
+void FlacEncoder::Md5::update(const uint8_t* data, size_t size)
+{
+    static const uint32_t k[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391 };
+
+    auto transform = [this](const uint8_t* chunk) {
+        uint32_t m[16];
+        for (int i = 0; i < 16; i++) {
+            m[i] = chunk[4 * i] | (chunk[4 * i + 1] << 8) | (chunk[4 * i + 2] << 16) | (static_cast<uint32_t>(chunk[4 * i + 3]) << 24);
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+
+        // One step per round function, so the compiler can unroll each loop
+        auto step = [&](uint32_t f, int i, int g, int s) {
+            const uint32_t sum = a + f + k[i] + m[g];
+            a = d;
+            d = c;
+            c = b;
+            b += (sum << s) | (sum >> (32 - s));
+        };
+        static const int s1[4] = { 7, 12, 17, 22 }, s2[4] = { 5, 9, 14, 20 };
+        static const int s3[4] = { 4, 11, 16, 23 }, s4[4] = { 6, 10, 15, 21 };
+        for (int i = 0; i < 16; i++) {
+            step((b & c) | (~b & d), i, i, s1[i & 3]);
+        }
+        for (int i = 16; i < 32; i++) {
+            step((d & b) | (~d & c), i, (5 * i + 1) & 15, s2[i & 3]);
+        }
+        for (int i = 32; i < 48; i++) {
+            step(b ^ c ^ d, i, (3 * i + 5) & 15, s3[i & 3]);
+        }
+        for (int i = 48; i < 64; i++) {
+            step(c ^ (b | ~d), i, (7 * i) & 15, s4[i & 3]);
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+    };
+
+    size_t used = static_cast<size_t>(length % 64);
+    length += size;
+    if (used > 0) {
+        const size_t take = std::min(64 - used, size);
+        memcpy(buffer + used, data, take);
+        data += take;
+        size -= take;
+        if (used + take < 64) {
+            return;
+        }
+        transform(buffer);
+    }
+    for (; size >= 64; data += 64, size -= 64) {
+        transform(data);
+    }
+    memcpy(buffer, data, size);
+}
+
+void FlacEncoder::Md5::finish(uint8_t digest[16]) const
+{
+    Md5 copy = *this;
+    const uint64_t bits = length * 8;
+    const size_t used = static_cast<size_t>(length % 64);
+    uint8_t padding[72] = { 0x80 };
+    copy.update(padding, used < 56 ? 56 - used : 120 - used);
+    uint8_t lengthBytes[8];
+    for (int i = 0; i < 8; i++) {
+        lengthBytes[i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+    copy.update(lengthBytes, 8);
+    for (int i = 0; i < 16; i++) {
+        digest[i] = static_cast<uint8_t>(copy.state[i / 4] >> (8 * (i % 4)));
+    }
+}
+
+bool FlacEncoder::configure(int sampleRate, int channels, int bitsPerSample, const Settings& settings)
+{
+    if (sampleRate <= 0 || sampleRate >= (1 << 20) || channels < 1 || channels > kMaxChannels
+        || bitsPerSample < 8 || bitsPerSample > 24
+        || settings.blockSize < 16 || settings.blockSize > 65535) {
+        return false;
+    }
+
+    m_settings = settings;
+    m_settings.maxLpcOrder = std::clamp(settings.maxLpcOrder, 0, kMaxLpcOrder);
+    m_settings.maxPartitionOrder = std::clamp(settings.maxPartitionOrder, 0, kMaxPartitionOrder);
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_bitsPerSample = bitsPerSample;
+
+    m_totalFrames = 0;
+    m_nextFrameNumber = 0;
+    m_minFrameBytes = 0;
+    m_maxFrameBytes = 0;
+    m_md5 = Md5();
+    return true;
+}
+
+std::vector<uint8_t> FlacEncoder::header() const
+{
+    std::vector<uint8_t> out(kHeaderBytes);
+    BitWriter writer(out.data());
+    writer.put(0x664C6143, 32); // "fLaC"
+
+    // Last metadata block, type 0 (STREAMINFO), 34 bytes
+    writer.put(0x80, 8);
+    writer.put(34, 24);
+    writer.put(m_settings.blockSize, 16);
+    writer.put(m_settings.blockSize, 16);
+    writer.put(m_minFrameBytes, 24);
+    writer.put(m_maxFrameBytes, 24);
+    writer.put(m_sampleRate, 20);
+    writer.put(m_channels - 1, 3);
+    writer.put(m_bitsPerSample - 1, 5);
+    writer.put(static_cast<uint32_t>(m_totalFrames >> 32), 4);
+    writer.put(static_cast<uint32_t>(m_totalFrames), 32);
+
+    uint8_t digest[16] = {};
+    if (m_totalFrames > 0) {
+        m_md5.finish(digest);
+    }
+    for (uint8_t byte : digest) {
+        writer.put(byte, 8);
+    }
+    writer.flush();
+    return out;
+}
+
+void FlacEncoder::hashSamples(const int32_t* const* planes, int frames)
+{
+    // MD5 of the interleaved little-endian samples, as the decoder will see them
+    const int bytes = (m_bitsPerSample + 7) / 8;
+    m_md5Bytes.resize(static_cast<size_t>(frames) * m_channels * bytes);
+    for (int c = 0; c < m_channels; c++) {
+        const int32_t* plane = planes[c];
+        uint8_t* out = m_md5Bytes.data() + c * bytes;
+        const size_t stride = static_cast<size_t>(m_channels) * bytes;
+        for (int i = 0; i < frames; i++, out += stride) {
+            const uint32_t sample = static_cast<uint32_t>(plane[i]);
+            out[0] = static_cast<uint8_t>(sample);
+            if (bytes > 1) {
+                out[1] = static_cast<uint8_t>(sample >> 8);
+            }
+            if (bytes > 2) {
+                out[2] = static_cast<uint8_t>(sample >> 16);
+            }
+        }
+    }
+    m_md5.update(m_md5Bytes.data(), m_md5Bytes.size());
+}
+
+void FlacEncoder::encode(const int32_t* const* planes, int frames, std::vector<uint8_t>& out, ThreadPool* pool)
+{
+    if (m_channels == 0 || frames <= 0) {
+        return;
+    }
+
+    const int blockSize = m_settings.blockSize;
+    const int blocks = (frames + blockSize - 1) / blockSize;
+    if (static_cast<int>(m_blockOutput.size()) < blocks) {
+        m_blockOutput.resize(blocks);
+    }
+
+    // The MD5 runs as one more task next to the blocks
+    auto encodeBlocks = [&](int begin, int end) {
+        for (int b = begin; b < end; b++) {
+            if (b == blocks) {
+                hashSamples(planes, frames);
+                continue;
+            }
+            const int offset = b * blockSize;
+            m_blockOutput[b].clear();
+            encodeBlock(planes, offset, std::min(blockSize, frames - offset), m_nextFrameNumber + b, m_blockOutput[b]);
+        }
+    };
+    if (pool) {
+        pool->parallelFor(blocks + 1, encodeBlocks);
+    }
+    else {
+        encodeBlocks(0, blocks + 1);
+    }
+
+    for (int b = 0; b < blocks; b++) {
+        const std::vector<uint8_t>& frame = m_blockOutput[b];
+        const uint32_t size = static_cast<uint32_t>(frame.size());
+        m_minFrameBytes = m_minFrameBytes == 0 ? size : std::min(m_minFrameBytes, size);
+        m_maxFrameBytes = std::max(m_maxFrameBytes, size);
+        out.insert(out.end(), frame.begin(), frame.end());
+    }
+    m_nextFrameNumber += blocks;
+    m_totalFrames += frames;
+}
+
+void FlacEncoder::encodeBlock(const int32_t* const* planes, int offset, int frames, uint64_t frameNumber, std::vector<uint8_t>& out) const
+{
+    Scratch& scratch = t_scratch;
+    const int n = frames;
+
+    const int32_t* data[kMaxChannels];
+    const Subframe* subframes[kMaxChannels];
+    int bits[kMaxChannels];
+    int assignment = m_channels - 1;
+
+    if (m_channels == 2) {
+        // Try every stereo decorrelation and keep the cheapest pair
+        const int32_t* left = planes[0] + offset;
+        const int32_t* right = planes[1] + offset;
+        scratch.side.resize(n);
+        scratch.mid.resize(n);
+        for (int i = 0; i < n; i++) {
+            scratch.side[i] = left[i] - right[i];
+            scratch.mid[i] = (left[i] + right[i]) >> 1;
+        }
+
+        Subframe* candidates = scratch.subframes;
+        analyzeChannel(left, n, m_bitsPerSample, m_settings, candidates[0], scratch);
+        analyzeChannel(right, n, m_bitsPerSample, m_settings, candidates[1], scratch);
+        analyzeChannel(scratch.side.data(), n, m_bitsPerSample + 1, m_settings, candidates[2], scratch);
+        analyzeChannel(scratch.mid.data(), n, m_bitsPerSample, m_settings, candidates[3], scratch);
+
+        const uint64_t independent = candidates[0].bits + candidates[1].bits;
+        const uint64_t leftSide = candidates[0].bits + candidates[2].bits;
+        const uint64_t sideRight = candidates[2].bits + candidates[1].bits;
+        const uint64_t midSide = candidates[3].bits + candidates[2].bits;
+        const uint64_t smallest = std::min({ independent, leftSide, sideRight, midSide });
+
+        int first = 0;
+        int second = 1;
+        if (smallest == independent) {
+            assignment = 1;
+        }
+        else if (smallest == leftSide) {
+            assignment = 8;
+            second = 2;
+        }
+        else if (smallest == sideRight) {
+            assignment = 9;
+            first = 2;
+        }
+        else {
+            assignment = 10;
+            first = 3;
+            second = 2;
+        }
+
+        const int32_t* sources[4] = { left, right, scratch.side.data(), scratch.mid.data() };
+        const int sourceBits[4] = { m_bitsPerSample, m_bitsPerSample, m_bitsPerSample + 1, m_bitsPerSample };
+        data[0] = sources[first];
+        data[1] = sources[second];
+        subframes[0] = &candidates[first];
+        subframes[1] = &candidates[second];
+        bits[0] = sourceBits[first];
+        bits[1] = sourceBits[second];
+    }
+    else {
+        for (int c = 0; c < m_channels; c++) {
+            data[c] = planes[c] + offset;
+            analyzeChannel(data[c], n, m_bitsPerSample, m_settings, scratch.subframes[c], scratch);
+            subframes[c] = &scratch.subframes[c];
+            bits[c] = m_bitsPerSample;
+        }
+    }
+
+    // Subframe sizes are upper bounds (Rice estimates never undercount), so the frame
+    // fits in the header, the subframes and the CRC
+    uint64_t bound = 16 + 2 + 8;
+    for (int c = 0; c < m_channels; c++) {
+        bound += subframes[c]->bits / 8 + 1;
+    }
+    const size_t start = out.size();
+    out.resize(start + bound);
+    BitWriter writer(out.data() + start);
+
+    // Frame header
+    const int sizeCode = blockSizeCode(n);
+    writer.put(0xFFF8, 16); // sync, fixed block size
+    writer.put(sizeCode, 4);
+    writer.put(sampleRateCode(m_sampleRate), 4);
+    writer.put(assignment, 4);
+    writer.put(sampleSizeCode(m_bitsPerSample), 3);
+    writer.put(0, 1);
+    putUtf8(writer, frameNumber);
+    if (sizeCode == 6) {
+        writer.put(n - 1, 8);
+    }
+    else if (sizeCode == 7) {
+        writer.put(n - 1, 16);
+    }
+    writer.put(crc8(out.data() + start, writer.flush()), 8);
+
+    for (int c = 0; c < m_channels; c++) {
+        writeSubframe(writer, *subframes[c], data[c], n, bits[c], scratch);
+    }
+
+    writer.align();
+    writer.put(crc16(out.data() + start, writer.flush()), 16);
+    out.resize(start + writer.flush());
+}
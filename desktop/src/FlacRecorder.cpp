@@ -0,0 +1,183 @@
+#include "incl/FlacRecorder.h"
+#include "incl/ThreadPool.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+
+namespace {
+    // Blocks handed to the pool at once, about 1.4 s at 48 kHz
+    constexpr int kBatchBlocks = 16;
+}
+
+FlacRecorder::~FlacRecorder()
+{
+    stop();
+}
+
+bool FlacRecorder::start(const std::filesystem::path& path, int sampleRate, int channels, int bitsPerSample, ThreadPool* pool)
+{
+    stop();
+
+    if (bitsPerSample != 16 && bitsPerSample != 24) {
+        return false;
+    }
+    if (!m_encoder.configure(sampleRate, channels, bitsPerSample)) {
+        return false;
+    }
+
+    // 16-bit gets dithered by the converter; 24-bit is converted at 32 and shifted down
+    const SampleFormat format = bitsPerSample == 16 ? SampleFormat::S16 : SampleFormat::S32;
+    if (!m_converter.configure(SampleFormat::F32, false, format, true, channels)) {
+        return false;
+    }
+
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        return false;
+    }
+    const std::vector<uint8_t> header = m_encoder.header();
+    m_file.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+    m_pool = pool;
+    m_bitsPerSample = bitsPerSample;
+    m_buffered = 0;
+    {
+        // The audio thread may still be inside a push() from the previous recording
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_channels = channels;
+        m_batchFrames = m_encoder.settings().blockSize * kBatchBlocks;
+        m_pending.clear();
+        m_pending.reserve(static_cast<size_t>(m_batchFrames) * channels * 2);
+        m_stopping = false;
+    }
+    m_queuedFrames.store(0, std::memory_order_relaxed);
+    for (int c = 0; c < channels; c++) {
+        m_planes[c].assign(m_batchFrames * 2, 0);
+    }
+
+    m_writer = std::thread(&FlacRecorder::run, this);
+    m_recording.store(true, std::memory_order_release);
+    return true;
+}
+
+void FlacRecorder::stop()
+{
+    if (!m_writer.joinable()) {
+        return;
+    }
+    m_recording.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    m_writer.join();
+
+    // Final totals and MD5 over the placeholder header
+    const std::vector<uint8_t> header = m_encoder.header();
+    m_file.seekp(0);
+    m_file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    m_file.close();
+}
+
+void FlacRecorder::push(const float* interleaved, int frames)
+{
+    if (frames <= 0 || !isRecording()) {
+        return;
+    }
+
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+            return;
+        }
+        m_pending.insert(m_pending.end(), interleaved, interleaved + static_cast<size_t>(frames) * m_channels);
+        m_queuedFrames.fetch_add(frames, std::memory_order_relaxed);
+        wake = m_pending.size() >= static_cast<size_t>(m_batchFrames) * m_channels;
+    }
+    if (wake) {
+        m_wake.notify_one();
+    }
+}
+
+void FlacRecorder::run()
+{
+    Tracer::instance().setThreadName("flac writer");
+
+    for (;;) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] {
+                return m_stopping || m_pending.size() >= static_cast<size_t>(m_batchFrames) * m_channels;
+            });
+            stopping = m_stopping;
+            m_incoming.clear();
+            std::swap(m_incoming, m_pending);
+        }
+
+        // Convert to planar PCM behind what is already buffered, in batch-sized pieces
+        const int frames = static_cast<int>(m_incoming.size() / m_channels);
+        for (int done = 0; done < frames;) {
+            const int count = std::min(frames - done, m_batchFrames);
+            const void* src = m_incoming.data() + static_cast<size_t>(done) * m_channels;
+            void* dst[FlacEncoder::kMaxChannels];
+            for (int c = 0; c < m_channels; c++) {
+                if (m_bitsPerSample == 16) {
+                    m_narrow[c].resize(count);
+                    dst[c] = m_narrow[c].data();
+                }
+                else {
+                    dst[c] = m_planes[c].data() + m_buffered;
+                }
+            }
+            m_converter.convert(&src, dst, count);
+
+            for (int c = 0; c < m_channels; c++) {
+                int32_t* plane = m_planes[c].data() + m_buffered;
+                if (m_bitsPerSample == 16) {
+                    std::copy(m_narrow[c].begin(), m_narrow[c].end(), plane);
+                }
+                else {
+                    for (int i = 0; i < count; i++) {
+                        plane[i] >>= 8;
+                    }
+                }
+            }
+            m_buffered += count;
+            done += count;
+            encodeBuffered(false);
+        }
+
+        if (stopping) {
+            encodeBuffered(true);
+            return;
+        }
+    }
+}
+
+void FlacRecorder::encodeBuffered(bool final)
+{
+    TraceScope trace("flac encode");
+    // Whole blocks only, except for the tail when stopping
+    const int blockSize = m_encoder.settings().blockSize;
+    const int frames = final ? m_buffered : m_buffered - m_buffered % blockSize;
+    if (frames == 0) {
+        return;
+    }
+
+    const int32_t* planes[FlacEncoder::kMaxChannels];
+    for (int c = 0; c < m_channels; c++) {
+        planes[c] = m_planes[c].data();
+    }
+    m_output.clear();
+    m_encoder.encode(planes, frames, m_output, m_pool);
+    m_file.write(reinterpret_cast<const char*>(m_output.data()), m_output.size());
+    m_queuedFrames.fetch_sub(frames, std::memory_order_relaxed);
+
+    // Keep the partial block for the next batch
+    m_buffered -= frames;
+    for (int c = 0; c < m_channels; c++) {
+        std::copy(m_planes[c].begin() + frames, m_planes[c].begin() + frames + m_buffered, m_planes[c].begin());
+    }
+}
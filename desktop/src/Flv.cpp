@@ -0,0 +1,94 @@
+#include "incl/Flv.h"
+#include "incl/Amf0.h"
+
+size_t Flv::bodyHeader(const EncodedPacket& packet, uint8_t header[kMaxBodyHeaderBytes])
+{
+    if (packet.type == EncodedPacket::Audio) {
+        // AAC is always flagged 44 kHz, 16-bit stereo; the AudioSpecificConfig says what it is
+        header[0] = static_cast<uint8_t>(kAacCodec << 4 | 3 << 2 | 1 << 1 | 1);
+        header[1] = packet.config ? 0 : 1;
+        return 2;
+    }
+
+    // Frame type 1 = key, 2 = inter; the composition time is signed 24-bit
+    const int frameType = packet.priority == EncodedPacket::Keyframe || packet.config ? 1 : 2;
+    const int32_t composition = packet.config ? 0 : packet.compositionMs;
+    header[0] = static_cast<uint8_t>(frameType << 4 | kAvcCodec);
+    header[1] = packet.config ? 0 : 1;
+    header[2] = static_cast<uint8_t>(composition >> 16);
+    header[3] = static_cast<uint8_t>(composition >> 8);
+    header[4] = static_cast<uint8_t>(composition);
+    return 5;
+}
+
+void Flv::metadataBody(std::vector<uint8_t>& out, const Settings& settings, bool setDataFrame)
+{
+    if (setDataFrame) {
+        Amf0::writeString(out, "@setDataFrame");
+    }
+    Amf0::writeString(out, "onMetaData");
+    Amf0::beginEcmaArray(out, 12);
+    Amf0::writeKey(out, "duration");
+    Amf0::writeNumber(out, 0.0); // live
+    Amf0::writeKey(out, "width");
+    Amf0::writeNumber(out, settings.width);
+    Amf0::writeKey(out, "height");
+    Amf0::writeNumber(out, settings.height);
+    Amf0::writeKey(out, "videodatarate");
+    Amf0::writeNumber(out, settings.videoKbps);
+    Amf0::writeKey(out, "framerate");
+    Amf0::writeNumber(out, settings.fps);
+    Amf0::writeKey(out, "videocodecid");
+    Amf0::writeNumber(out, kAvcCodec);
+    Amf0::writeKey(out, "audiodatarate");
+    Amf0::writeNumber(out, settings.audioKbps);
+    Amf0::writeKey(out, "audiosamplerate");
+    Amf0::writeNumber(out, settings.audioSampleRate);
+    Amf0::writeKey(out, "audiosamplesize");
+    Amf0::writeNumber(out, 16.0);
+    Amf0::writeKey(out, "stereo");
+    Amf0::writeBoolean(out, settings.audioChannels == 2);
+    Amf0::writeKey(out, "audiocodecid");
+    Amf0::writeNumber(out, kAacCodec);
+    Amf0::writeKey(out, "encoder");
+    Amf0::writeString(out, settings.encoder);
+    Amf0::endObject(out);
+}
+
+void Flv::writeFileHeader(std::vector<uint8_t>& out, bool hasAudio, bool hasVideo)
+{
+    const uint8_t header[kFileHeaderBytes] = {
+        'F', 'L', 'V', 1,
+        static_cast<uint8_t>((hasAudio ? 4 : 0) | (hasVideo ? 1 : 0)),
+        0, 0, 0, 9, // header size
+        0, 0, 0, 0, // PreviousTagSize0
+    };
+    out.insert(out.end(), header, header + kFileHeaderBytes);
+}
+
+void Flv::writeTag(std::vector<uint8_t>& out, TagType type, uint32_t timestampMs,
+    const uint8_t* bodyHeader, size_t bodyHeaderSize, const uint8_t* data, size_t size)
+{
+    const uint32_t bodySize = static_cast<uint32_t>(bodyHeaderSize + size);
+    // Timestamp is 24 bits plus an extension byte holding bits 24-31
+    const uint8_t header[kTagHeaderBytes] = {
+        type,
+        static_cast<uint8_t>(bodySize >> 16), static_cast<uint8_t>(bodySize >> 8), static_cast<uint8_t>(bodySize),
+        static_cast<uint8_t>(timestampMs >> 16), static_cast<uint8_t>(timestampMs >> 8), static_cast<uint8_t>(timestampMs),
+        static_cast<uint8_t>(timestampMs >> 24),
+        0, 0, 0, // stream id
+    };
+    out.insert(out.end(), header, header + kTagHeaderBytes);
+    if (bodyHeaderSize > 0) {
+        out.insert(out.end(), bodyHeader, bodyHeader + bodyHeaderSize);
+    }
+    if (size > 0) {
+        out.insert(out.end(), data, data + size);
+    }
+    const uint32_t tagSize = static_cast<uint32_t>(kTagHeaderBytes) + bodySize;
+    const uint8_t previous[4] = {
+        static_cast<uint8_t>(tagSize >> 24), static_cast<uint8_t>(tagSize >> 16),
+        static_cast<uint8_t>(tagSize >> 8), static_cast<uint8_t>(tagSize),
+    };
+    out.insert(out.end(), previous, previous + 4);
+}
@@ -0,0 +1,195 @@
+#include "incl/FrameChangeDetector.h"
+#include "incl/Simd.h"
+#include "incl/ThreadPool.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    // Sixteen independent 32-bit multiply-xor lanes (four vectors, so consecutive
+    // multiplies do not wait on each other). Each step is a bijection of the lane
+    // state, so a single changed word can never be cancelled out by identical data.
+    constexpr int kLanes = 16;
+    constexpr uint32_t kPrime = 0x9E3779B1u;
+
+    inline uint32_t mixWord(uint32_t state, uint32_t word)
+    {
+        return (state ^ word) * kPrime;
+    }
+
+#ifdef OBS_HAVE_SSE2
+    // 32-bit lane multiply (SSE4.1 has _mm_mullo_epi32, SSE2 needs two 64-bit products)
+    inline __m128i mullo32(__m128i a, __m128i b)
+    {
+        __m128i even = _mm_mul_epu32(a, b);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+#endif
+
+    inline uint64_t finalize(const uint32_t lanes[kLanes])
+    {
+        uint64_t h = 0;
+        for (int i = 0; i < kLanes; i++) {
+            h = (h ^ lanes[i]) * 0x100000001B3ull;
+        }
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        return h;
+    }
+}
+
+bool ChangeMap::rowsChanged(int y0, int y1) const
+{
+    if (tileSize <= 0 || y1 <= y0) {
+        return false;
+    }
+
+    const int t0 = std::max(y0 / tileSize, 0);
+    const int t1 = std::min((y1 - 1) / tileSize, tilesY - 1);
+    for (int t = t0; t <= t1; t++) {
+        if (rowChanged[t]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ChangeMap::clear(int width, int height, int tile)
+{
+    tileSize = tile;
+    tilesX = (width + tile - 1) / tile;
+    tilesY = (height + tile - 1) / tile;
+    changedCount = 0;
+    bits.assign((static_cast<size_t>(tilesX) * tilesY + 63) / 64, 0);
+    rowChanged.assign(tilesY, 0);
+}
+
+void ChangeMap::markRect(int x, int y, int width, int height)
+{
+    if (width <= 0 || height <= 0 || x + width <= 0 || y + height <= 0) {
+        return;
+    }
+    const int tx0 = std::max(x, 0) / tileSize;
+    const int ty0 = std::max(y, 0) / tileSize;
+    const int tx1 = std::min((x + width - 1) / tileSize, tilesX - 1);
+    const int ty1 = std::min((y + height - 1) / tileSize, tilesY - 1);
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            const int i = ty * tilesX + tx;
+            if (!((bits[i >> 6] >> (i & 63)) & 1)) {
+                bits[i >> 6] |= 1ull << (i & 63);
+                changedCount++;
+            }
+            rowChanged[ty] = 1;
+        }
+    }
+}
+
+uint64_t FrameChangeDetector::hashTile(const FrameView& frame, int x, int y, int width, int height)
+{
+    uint32_t lanes[kLanes];
+    for (int i = 0; i < kLanes; i++) {
+        lanes[i] = 0x85EBCA77u + i * 0x27D4EB2Fu;
+    }
+
+#ifdef OBS_HAVE_SSE2
+    const bool sse2 = useSse2();
+    const __m128i prime = _mm_set1_epi32(static_cast<int>(kPrime));
+#endif
+
+    for (int row = 0; row < height; row++) {
+        const uint8_t* p = frame.row(y + row) + x * 4;
+        int i = 0;
+
+#ifdef OBS_HAVE_SSE2
+        if (sse2) {
+            __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes));
+            __m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes + 4));
+            __m128i s2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes + 8));
+            __m128i s3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes + 12));
+            for (; i + kLanes <= width; i += kLanes) {
+                const __m128i* d = reinterpret_cast<const __m128i*>(p + i * 4);
+                s0 = mullo32(_mm_xor_si128(s0, _mm_loadu_si128(d)), prime);
+                s1 = mullo32(_mm_xor_si128(s1, _mm_loadu_si128(d + 1)), prime);
+                s2 = mullo32(_mm_xor_si128(s2, _mm_loadu_si128(d + 2)), prime);
+                s3 = mullo32(_mm_xor_si128(s3, _mm_loadu_si128(d + 3)), prime);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), s0);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes + 4), s1);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes + 8), s2);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes + 12), s3);
+        }
+#endif
+
+        // Remaining pixels go to the lane they would have used in a full pass
+        for (; i < width; i++) {
+            uint32_t word;
+            memcpy(&word, p + i * 4, 4);
+            lanes[i % kLanes] = mixWord(lanes[i % kLanes], word);
+        }
+    }
+
+    return finalize(lanes);
+}
+
+void FrameChangeDetector::reset()
+{
+    m_hasPrevious = false;
+}
+
+const ChangeMap& FrameChangeDetector::detect(const FrameView& frame, ThreadPool* pool)
+{
+    TraceScope trace("change detection");
+    ChangeMap& map = m_changes;
+    const int tilesX = (frame.width + kTileSize - 1) / kTileSize;
+    const int tilesY = (frame.height + kTileSize - 1) / kTileSize;
+    const int tileCount = tilesX * tilesY;
+
+    if (map.tilesX != tilesX || map.tilesY != tilesY) {
+        m_hasPrevious = false;
+    }
+
+    map.tileSize = kTileSize;
+    map.tilesX = tilesX;
+    map.tilesY = tilesY;
+    map.bits.assign((tileCount + 63) / 64, 0);
+    map.rowChanged.assign(tilesY, 0);
+    m_hashes.resize(tileCount);
+
+    // One task per tile row; rows write disjoint hash slots
+    auto hashRows = [&](int begin, int end) {
+        for (int ty = begin; ty < end; ty++) {
+            const int y = ty * kTileSize;
+            const int h = std::min(kTileSize, frame.height - y);
+            for (int tx = 0; tx < tilesX; tx++) {
+                const int x = tx * kTileSize;
+                const int w = std::min(kTileSize, frame.width - x);
+                m_hashes[ty * tilesX + tx] = hashTile(frame, x, y, w, h);
+            }
+        }
+    };
+
+    if (pool) {
+        pool->parallelFor(tilesY, hashRows);
+    }
+    else {
+        hashRows(0, tilesY);
+    }
+
+    map.changedCount = 0;
+    for (int i = 0; i < tileCount; i++) {
+        if (!m_hasPrevious || m_hashes[i] != m_previous[i]) {
+            map.bits[i >> 6] |= 1ull << (i & 63);
+            map.rowChanged[i / tilesX] = 1;
+            map.changedCount++;
+        }
+    }
+
+    m_previous.swap(m_hashes);
+    m_hasPrevious = true;
+    traceCounter("changed tiles", map.changedCount);
+    return map;
+}
@@ -0,0 +1,780 @@
+#include "incl/HdrConverter.h"
+#include "incl/Simd.h"
+#include "incl/ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    constexpr double kScRgbNits = 80.0;     // scRGB 1.0
+    constexpr double kPqMaxNits = 10000.0;  // PQ 1.0
+
+    // SMPTE ST 2084
+    constexpr double kPqM1 = 2610.0 / 16384.0;
+    constexpr double kPqM2 = 2523.0 / 4096.0 * 128.0;
+    constexpr double kPqC1 = 3424.0 / 4096.0;
+    constexpr double kPqC2 = 2413.0 / 4096.0 * 32.0;
+    constexpr double kPqC3 = 2392.0 / 4096.0 * 32.0;
+
+    // BT.2100 HLG
+    constexpr double kHlgA = 0.17883277;
+    constexpr double kHlgB = 1.0 - 4.0 * kHlgA;
+    constexpr double kHlgC = 0.55991072952956202016; // 0.5 - a * ln(4a)
+
+    // Linear-light primaries conversion (BT.2087 and its inverse), row-major
+    constexpr float k709To2020[9] = {
+        0.627404f, 0.329283f, 0.043313f,
+        0.069097f, 0.919540f, 0.011362f,
+        0.016391f, 0.088013f, 0.895595f,
+    };
+    constexpr float k2020To709[9] = {
+        1.660491f, -0.587641f, -0.072850f,
+        -0.124550f, 1.132900f, -0.008349f,
+        -0.018151f, -0.100579f, 1.118730f,
+    };
+
+    // BT.2020 non-constant luminance YCbCr, 10-bit limited range
+    constexpr float kLumaR = 0.2627f, kLumaG = 0.6780f, kLumaB = 0.0593f;
+    constexpr float kCbScale = 1.0f / 1.8814f, kCrScale = 1.0f / 1.4746f;
+
+    // Hable's filmic curve as published, with its usual exposure bias
+    constexpr double kHableA = 0.15, kHableB = 0.50, kHableC = 0.10;
+    constexpr double kHableD = 0.20, kHableE = 0.02, kHableF = 0.30;
+    constexpr double kHableExposure = 2.0;
+
+    // Tone ratio entries; the step between neighbours stays well under one 8-bit code
+    constexpr int kToneEntries = 8192;
+
+    // HLG OOTF gain entries, spaced like the tone ratio
+    constexpr int kHlgGainEntries = 4096;
+
+    // sRGB encode of [0, 1] in 1/16383 steps, padded so a 32-bit gather at the last
+    // entry stays inside the table
+    constexpr int kSrgbEntries = 16384;
+
+    // PQ encode indexed by the bits of nits / 10000: exponent plus the top 7 mantissa
+    // bits, from 2^-30 (0.00001 nits, far below one code) up to 1.0
+    constexpr uint32_t kPqTableBase = 0x30800000;       // 2^-30
+    constexpr int kPqTableEntries = ((0x3F800000 - kPqTableBase) >> 16) + 2;
+    constexpr int kPqTableShift = 16;
+
+    constexpr int kRowGrain = 8;
+
+    float bitsToFloat(uint32_t bits)
+    {
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    uint32_t floatToBits(float f)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        return bits;
+    }
+
+    float halfToFloat(uint16_t h)
+    {
+        const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+        const uint32_t exponent = (h >> 10) & 0x1F;
+        const uint32_t mantissa = h & 0x3FF;
+        if (exponent == 0) {
+            // Zero or subnormal: mantissa * 2^-24
+            const float value = mantissa * (1.0f / 16777216.0f);
+            return sign ? -value : value;
+        }
+        if (exponent == 31) {
+            return bitsToFloat(sign | 0x7F800000 | (mantissa << 13));
+        }
+        return bitsToFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+    }
+
+    // Exact transfer functions, only used to fill the tables
+    double pqEncode(double nits)
+    {
+        const double ym = std::pow(std::max(nits, 0.0) / kPqMaxNits, kPqM1);
+        return std::pow((kPqC1 + kPqC2 * ym) / (1.0 + kPqC3 * ym), kPqM2);
+    }
+
+    double pqDecode(double e)
+    {
+        const double ep = std::pow(std::max(e, 0.0), 1.0 / kPqM2);
+        const double num = std::max(ep - kPqC1, 0.0);
+        return kPqMaxNits * std::pow(num / (kPqC2 - kPqC3 * ep), 1.0 / kPqM1);
+    }
+
+    // HLG signal -> scene light in [0, 1]
+    double hlgDecode(double e)
+    {
+        e = std::min(std::max(e, 0.0), 1.0);
+        return e <= 0.5 ? e * e / 3.0 : (std::exp((e - kHlgC) / kHlgA) + kHlgB) / 12.0;
+    }
+
+    double hable(double x)
+    {
+        return (x * (kHableA * x + kHableC * kHableB) + kHableD * kHableE)
+            / (x * (kHableA * x + kHableB) + kHableD * kHableF) - kHableE / kHableF;
+    }
+
+    // PQ code value -> nits for every 10-bit code
+    const float* pqDecodeTable()
+    {
+        static const std::vector<float> table = [] {
+            std::vector<float> t(1024);
+            for (int i = 0; i < 1024; i++) {
+                t[i] = static_cast<float>(pqDecode(i / 1023.0));
+            }
+            return t;
+        }();
+        return table.data();
+    }
+
+    // HLG code value -> scene light for every 10-bit code
+    const float* hlgDecodeTable()
+    {
+        static const std::vector<float> table = [] {
+            std::vector<float> t(1024);
+            for (int i = 0; i < 1024; i++) {
+                t[i] = static_cast<float>(hlgDecode(i / 1023.0));
+            }
+            return t;
+        }();
+        return table.data();
+    }
+
+    const float* pqEncodeTable()
+    {
+        static const std::vector<float> table = [] {
+            std::vector<float> t(kPqTableEntries);
+            for (int i = 0; i < kPqTableEntries; i++) {
+                t[i] = static_cast<float>(pqEncode(kPqMaxNits * bitsToFloat(kPqTableBase + (static_cast<uint32_t>(i) << kPqTableShift))));
+            }
+            return t;
+        }();
+        return table.data();
+    }
+
+    const uint8_t* srgbTable()
+    {
+        static const std::vector<uint8_t> table = [] {
+            std::vector<uint8_t> t(kSrgbEntries + 3, 255);
+            for (int i = 0; i < kSrgbEntries; i++) {
+                const double v = i / static_cast<double>(kSrgbEntries - 1);
+                const double s = v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+                t[i] = static_cast<uint8_t>(std::lround(s * 255.0));
+            }
+            return t;
+        }();
+        return table.data();
+    }
+
+    // Linear nits -> PQ signal, interpolated within each 1/128 octave
+    float pqEncodeFast(const float* table, float nits)
+    {
+        const float y = std::min(std::max(nits * static_cast<float>(1.0 / kPqMaxNits), bitsToFloat(kPqTableBase)), 1.0f);
+        const uint32_t offset = floatToBits(y) - kPqTableBase;
+        const uint32_t i = offset >> kPqTableShift;
+        const float frac = static_cast<float>(offset & 0xFFFF) * (1.0f / 65536.0f);
+        return table[i] + frac * (table[i + 1] - table[i]);
+    }
+
+    uint16_t toP010Sample(float v)
+    {
+        const int code = static_cast<int>(v + 0.5f);
+        return static_cast<uint16_t>(std::min(std::max(code, 0), 1023) << 6);
+    }
+}
+
+struct HdrKernels
+{
+    // --- Plain C++ ---
+
+    // scRGB halfs -> linear BT.709 nits
+    static void decodeScRgb(const uint8_t* src, int first, int last, float* r, float* g, float* b)
+    {
+        const uint16_t* px = reinterpret_cast<const uint16_t*>(src);
+        const float scale = static_cast<float>(kScRgbNits);
+        for (int x = first; x < last; x++) {
+            r[x] = halfToFloat(px[x * 4 + 0]) * scale;
+            g[x] = halfToFloat(px[x * 4 + 1]) * scale;
+            b[x] = halfToFloat(px[x * 4 + 2]) * scale;
+        }
+    }
+
+    // HDR10 -> linear nits, BT.709 primaries for tone mapping or BT.2020 as stored
+    static void decodeHdr10(const uint8_t* src, int first, int last, float* r, float* g, float* b, bool to709)
+    {
+        const uint32_t* px = reinterpret_cast<const uint32_t*>(src);
+        const float* table = pqDecodeTable();
+        for (int x = first; x < last; x++) {
+            const float cr = table[px[x] & 0x3FF];
+            const float cg = table[(px[x] >> 10) & 0x3FF];
+            const float cb = table[(px[x] >> 20) & 0x3FF];
+            if (to709) {
+                r[x] = k2020To709[0] * cr + k2020To709[1] * cg + k2020To709[2] * cb;
+                g[x] = k2020To709[3] * cr + k2020To709[4] * cg + k2020To709[5] * cb;
+                b[x] = k2020To709[6] * cr + k2020To709[7] * cg + k2020To709[8] * cb;
+            }
+            else {
+                r[x] = cr;
+                g[x] = cg;
+                b[x] = cb;
+            }
+        }
+    }
+
+    // HLG -> display light nits through the OOTF, which scales all three channels by a
+    // gain that depends on the scene luminance
+    static void decodeHlg(const HdrConverter& c, const uint8_t* src, int first, int last, float* r, float* g, float* b, bool to709)
+    {
+        const uint32_t* px = reinterpret_cast<const uint32_t*>(src);
+        const float* table = hlgDecodeTable();
+        const float* gain = c.m_hlgGain.data();
+        const float scale = static_cast<float>(kHlgGainEntries - 1);
+        for (int x = first; x < last; x++) {
+            float cr = table[px[x] & 0x3FF];
+            float cg = table[(px[x] >> 10) & 0x3FF];
+            float cb = table[(px[x] >> 20) & 0x3FF];
+            const float ys = kLumaR * cr + kLumaG * cg + kLumaB * cb;
+            const float k = gain[static_cast<int>(std::nearbyint(std::sqrt(ys) * scale))];
+            cr *= k;
+            cg *= k;
+            cb *= k;
+            if (to709) {
+                r[x] = k2020To709[0] * cr + k2020To709[1] * cg + k2020To709[2] * cb;
+                g[x] = k2020To709[3] * cr + k2020To709[4] * cg + k2020To709[5] * cb;
+                b[x] = k2020To709[6] * cr + k2020To709[7] * cg + k2020To709[8] * cb;
+            }
+            else {
+                r[x] = cr;
+                g[x] = cg;
+                b[x] = cb;
+            }
+        }
+    }
+
+    // HDR10 -> PQ signal values, no transfer function involved
+    static void hdr10Signal(const uint8_t* src, int first, int last, float* r, float* g, float* b)
+    {
+        const uint32_t* px = reinterpret_cast<const uint32_t*>(src);
+        const float scale = 1.0f / 1023.0f;
+        for (int x = first; x < last; x++) {
+            r[x] = static_cast<float>(px[x] & 0x3FF) * scale;
+            g[x] = static_cast<float>((px[x] >> 10) & 0x3FF) * scale;
+            b[x] = static_cast<float>((px[x] >> 20) & 0x3FF) * scale;
+        }
+    }
+
+    // Linear BT.709 nits -> tone-mapped sRGB BGRA
+    static void toneMap(const HdrConverter& c, const float* r, const float* g, const float* b, int first, int last, uint8_t* dst)
+    {
+        const float* ratio = c.m_toneRatio.data();
+        const uint8_t* srgb = srgbTable();
+        const float invWhite = 1.0f / c.m_settings.sdrWhiteNits;
+        const float invPeak = 1.0f / c.m_peak;
+        const float scale = static_cast<float>(kToneEntries - 1);
+        auto encode = [srgb](float v) {
+            return srgb[static_cast<int>(std::min(std::max(v, 0.0f), 1.0f) * (kSrgbEntries - 1) + 0.5f)];
+        };
+        for (int x = first; x < last; x++) {
+            const float m = std::max(std::max(std::max(r[x], g[x]), b[x]) * invWhite, 0.0f);
+            float k;
+            if (m >= c.m_peak) {
+                k = 1.0f / m;
+            }
+            else {
+                k = ratio[static_cast<int>(std::nearbyint(std::sqrt(m * invPeak) * scale))];
+            }
+            k *= invWhite;
+            dst[x * 4 + 0] = encode(b[x] * k);
+            dst[x * 4 + 1] = encode(g[x] * k);
+            dst[x * 4 + 2] = encode(r[x] * k);
+            dst[x * 4 + 3] = 255;
+        }
+    }
+
+    // Linear BT.709 nits -> PQ BT.2020 signal, in place
+    static void pqSignal(float* r, float* g, float* b, int first, int last)
+    {
+        const float* table = pqEncodeTable();
+        for (int x = first; x < last; x++) {
+            const float cr = k709To2020[0] * r[x] + k709To2020[1] * g[x] + k709To2020[2] * b[x];
+            const float cg = k709To2020[3] * r[x] + k709To2020[4] * g[x] + k709To2020[5] * b[x];
+            const float cb = k709To2020[6] * r[x] + k709To2020[7] * g[x] + k709To2020[8] * b[x];
+            r[x] = pqEncodeFast(table, cr);
+            g[x] = pqEncodeFast(table, cg);
+            b[x] = pqEncodeFast(table, cb);
+        }
+    }
+
+    // PQ R'G'B' line -> limited range luma
+    static void p010Luma(const float* const* line, int first, int width, uint16_t* y)
+    {
+        for (int x = first; x < width; x++) {
+            y[x] = toP010Sample(64.0f + 876.0f * (kLumaR * line[0][x] + kLumaG * line[1][x] + kLumaB * line[2][x]));
+        }
+    }
+
+    // Two PQ R'G'B' lines -> one line of CbCr from each 2x2 block's average. The last
+    // column pairs with itself on odd widths; line1 repeats line0 on odd heights.
+    static void p010Chroma(const float* const* line0, const float* const* line1, int first, int width, uint16_t* uv)
+    {
+        for (int cx = first; cx < (width + 1) / 2; cx++) {
+            const int x0 = cx * 2;
+            const int x1 = std::min(x0 + 1, width - 1);
+            const float avgR = 0.25f * (line0[0][x0] + line0[0][x1] + line1[0][x0] + line1[0][x1]);
+            const float avgG = 0.25f * (line0[1][x0] + line0[1][x1] + line1[1][x0] + line1[1][x1]);
+            const float avgB = 0.25f * (line0[2][x0] + line0[2][x1] + line1[2][x0] + line1[2][x1]);
+            const float luma = kLumaR * avgR + kLumaG * avgG + kLumaB * avgB;
+            uv[cx * 2 + 0] = toP010Sample(512.0f + 896.0f * (avgB - luma) * kCbScale);
+            uv[cx * 2 + 1] = toP010Sample(512.0f + 896.0f * (avgR - luma) * kCrScale);
+        }
+    }
+
+#ifdef OBS_HAVE_AVX2
+    // --- AVX2 + FMA + F16C, 8 pixels at a time; callers finish the tail in C++ ---
+
+    OBS_TARGET_AVX2 static __m256 srgbAvx2(const uint8_t* srgb, __m256 v)
+    {
+        const __m256 clamped = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+        const __m256i index = _mm256_cvttps_epi32(_mm256_fmadd_ps(clamped, _mm256_set1_ps(kSrgbEntries - 1), _mm256_set1_ps(0.5f)));
+        return _mm256_castsi256_ps(_mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int*>(srgb), index, 1), _mm256_set1_epi32(0xFF)));
+    }
+
+    OBS_TARGET_AVX2 static __m256 pqEncodeAvx2(const float* table, __m256 nits)
+    {
+        __m256 y = _mm256_mul_ps(nits, _mm256_set1_ps(static_cast<float>(1.0 / kPqMaxNits)));
+        y = _mm256_min_ps(_mm256_max_ps(y, _mm256_set1_ps(bitsToFloat(kPqTableBase))), _mm256_set1_ps(1.0f));
+        const __m256i offset = _mm256_sub_epi32(_mm256_castps_si256(y), _mm256_set1_epi32(static_cast<int>(kPqTableBase)));
+        const __m256i i = _mm256_srli_epi32(offset, kPqTableShift);
+        const __m256 frac = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(offset, _mm256_set1_epi32(0xFFFF))), _mm256_set1_ps(1.0f / 65536.0f));
+        const __m256 v0 = _mm256_i32gather_ps(table, i, 4);
+        const __m256 v1 = _mm256_i32gather_ps(table + 1, i, 4);
+        return _mm256_fmadd_ps(frac, _mm256_sub_ps(v1, v0), v0);
+    }
+
+    OBS_TARGET_AVX2 static int decodeScRgbAvx2(const uint8_t* src, int width, float* r, float* g, float* b)
+    {
+        // Each conversion yields two RGBA pixels; transposing four of them leaves even
+        // pixels in the low lane and odd ones in the high lane, which the permute undoes
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        const __m256 scale = _mm256_set1_ps(static_cast<float>(kScRgbNits));
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const __m128i* p = reinterpret_cast<const __m128i*>(src + static_cast<size_t>(x) * 8);
+            const __m256 v0 = _mm256_cvtph_ps(_mm_loadu_si128(p + 0));
+            const __m256 v1 = _mm256_cvtph_ps(_mm_loadu_si128(p + 1));
+            const __m256 v2 = _mm256_cvtph_ps(_mm_loadu_si128(p + 2));
+            const __m256 v3 = _mm256_cvtph_ps(_mm_loadu_si128(p + 3));
+            const __m256 rg01 = _mm256_unpacklo_ps(v0, v1);
+            const __m256 ba01 = _mm256_unpackhi_ps(v0, v1);
+            const __m256 rg23 = _mm256_unpacklo_ps(v2, v3);
+            const __m256 ba23 = _mm256_unpackhi_ps(v2, v3);
+            const __m256 vr = _mm256_shuffle_ps(rg01, rg23, _MM_SHUFFLE(1, 0, 1, 0));
+            const __m256 vg = _mm256_shuffle_ps(rg01, rg23, _MM_SHUFFLE(3, 2, 3, 2));
+            const __m256 vb = _mm256_shuffle_ps(ba01, ba23, _MM_SHUFFLE(1, 0, 1, 0));
+            _mm256_storeu_ps(r + x, _mm256_mul_ps(_mm256_permutevar8x32_ps(vr, order), scale));
+            _mm256_storeu_ps(g + x, _mm256_mul_ps(_mm256_permutevar8x32_ps(vg, order), scale));
+            _mm256_storeu_ps(b + x, _mm256_mul_ps(_mm256_permutevar8x32_ps(vb, order), scale));
+        }
+        return x;
+    }
+
+    OBS_TARGET_AVX2 static int decodeHdr10Avx2(const uint8_t* src, int width, float* r, float* g, float* b, bool to709)
+    {
+        const float* table = pqDecodeTable();
+        const __m256i mask = _mm256_set1_epi32(0x3FF);
+        const float* k = k2020To709;
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + static_cast<size_t>(x) * 4));
+            const __m256 cr = _mm256_i32gather_ps(table, _mm256_and_si256(px, mask), 4);
+            const __m256 cg = _mm256_i32gather_ps(table, _mm256_and_si256(_mm256_srli_epi32(px, 10), mask), 4);
+            const __m256 cb = _mm256_i32gather_ps(table, _mm256_and_si256(_mm256_srli_epi32(px, 20), mask), 4);
+            if (to709) {
+                _mm256_storeu_ps(r + x, _mm256_fmadd_ps(cr, _mm256_set1_ps(k[0]), _mm256_fmadd_ps(cg, _mm256_set1_ps(k[1]), _mm256_mul_ps(cb, _mm256_set1_ps(k[2])))));
+                _mm256_storeu_ps(g + x, _mm256_fmadd_ps(cr, _mm256_set1_ps(k[3]), _mm256_fmadd_ps(cg, _mm256_set1_ps(k[4]), _mm256_mul_ps(cb, _mm256_set1_ps(k[5])))));
+                _mm256_storeu_ps(b + x, _mm256_fmadd_ps(cr, _mm256_set1_ps(k[6]), _mm256_fmadd_ps(cg, _mm256_set1_ps(k[7]), _mm256_mul_ps(cb, _mm256_set1_ps(k[8])))));
+            }
+            else {
+                _mm256_storeu_ps(r + x, cr);
+                _mm256_storeu_ps(g + x, cg);
+                _mm256_storeu_ps(b + x, cb);
+            }
+        }
+        return x;
+    }
+
+    OBS_TARGET_AVX2 static int decodeHlgAvx2(const HdrConverter& c, const uint8_t* src, int width, float* r, float* g, float* b, bool to709)
+    {
+        const float* table = hlgDecodeTable();
+        const float* gain = c.m_hlgGain.data();
+        const __m256i mask = _mm256_set1_epi32(0x3FF);
+        const __m256 scale = _mm256_set1_ps(static_cast<float>(kHlgGainEntries - 1));
+        const float* k = k2020To709;
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + static_cast<size_t>(x) * 4));
+            __m256 cr = _mm256_i32gather_ps(table, _mm256_and_si256(px, mask), 4);
+            __m256 cg = _mm256_i32gather_ps(table, _mm256_and_si256(_mm256_srli_epi32(px, 10), mask), 4);
+            __m256 cb = _mm256_i32gather_ps(table, _mm256_and_si256(_mm256_srli_epi32(px, 20), mask), 4);
+            // Scene luminance in the C++ path's operation order
+            const __m256 ys = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cr, _mm256_set1_ps(kLumaR)), _mm256_mul_ps(cg, _mm256_set1_ps(kLumaG))),
+                _mm256_mul_ps(cb, _mm256_set1_ps(kLumaB)));
+            const __m256 kg = _mm256_i32gather_ps(gain, _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_sqrt_ps(ys), scale)), 4);
+            cr = _mm256_mul_ps(cr, kg);
+            cg = _mm256_mul_ps(cg, kg);
+            cb = _mm256_mul_ps(cb, kg);
+            if (to709) {
+                _mm256_storeu_ps(r + x, _mm256_fmadd_ps(cr, _mm256_set1_ps(k[0]), _mm256_fmadd_ps(cg, _mm256_set1_ps(k[1]), _mm256_mul_ps(cb, _mm256_set1_ps(k[2])))));
+                _mm256_storeu_ps(g + x, _mm256_fmadd_ps(cr, _mm256_set1_ps(k[3]), _mm256_fmadd_ps(cg, _mm256_set1_ps(k[4]), _mm256_mul_ps(cb, _mm256_set1_ps(k[5])))));
+                _mm256_storeu_ps(b + x, _mm256_fmadd_ps(cr, _mm256_set1_ps(k[6]), _mm256_fmadd_ps(cg, _mm256_set1_ps(k[7]), _mm256_mul_ps(cb, _mm256_set1_ps(k[8])))));
+            }
+            else {
+                _mm256_storeu_ps(r + x, cr);
+                _mm256_storeu_ps(g + x, cg);
+                _mm256_storeu_ps(b + x, cb);
+            }
+        }
+        return x;
+    }
+
+    OBS_TARGET_AVX2 static int toneMapAvx2(const HdrConverter& c, const float* r, const float* g, const float* b, int width, uint8_t* dst)
+    {
+        const float* ratio = c.m_toneRatio.data();
+        const uint8_t* srgb = srgbTable();
+        const __m256 invWhite = _mm256_set1_ps(1.0f / c.m_settings.sdrWhiteNits);
+        const __m256 invPeak = _mm256_set1_ps(1.0f / c.m_peak);
+        const __m256 peak = _mm256_set1_ps(c.m_peak);
+        const __m256 scale = _mm256_set1_ps(static_cast<float>(kToneEntries - 1));
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const __m256 vr = _mm256_loadu_ps(r + x);
+            const __m256 vg = _mm256_loadu_ps(g + x);
+            const __m256 vb = _mm256_loadu_ps(b + x);
+            const __m256 m = _mm256_max_ps(_mm256_mul_ps(_mm256_max_ps(_mm256_max_ps(vr, vg), vb), invWhite), _mm256_setzero_ps());
+
+            // Nearest table ratio below the peak, 1 / m above it
+            const __m256 pos = _mm256_mul_ps(_mm256_sqrt_ps(_mm256_min_ps(_mm256_mul_ps(m, invPeak), one)), scale);
+            __m256 k = _mm256_i32gather_ps(ratio, _mm256_cvtps_epi32(pos), 4);
+            k = _mm256_blendv_ps(k, _mm256_div_ps(one, m), _mm256_cmp_ps(m, peak, _CMP_GE_OQ));
+            k = _mm256_mul_ps(k, invWhite);
+
+            const __m256i ir = _mm256_castps_si256(srgbAvx2(srgb, _mm256_mul_ps(vr, k)));
+            const __m256i ig = _mm256_castps_si256(srgbAvx2(srgb, _mm256_mul_ps(vg, k)));
+            const __m256i ib = _mm256_castps_si256(srgbAvx2(srgb, _mm256_mul_ps(vb, k)));
+            const __m256i px = _mm256_or_si256(_mm256_or_si256(ib, _mm256_slli_epi32(ig, 8)),
+                _mm256_or_si256(_mm256_slli_epi32(ir, 16), alpha));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + static_cast<size_t>(x) * 4), px);
+        }
+        return x;
+    }
+
+    OBS_TARGET_AVX2 static int pqSignalAvx2(float* r, float* g, float* b, int width)
+    {
+        const float* table = pqEncodeTable();
+        const float* k = k709To2020;
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const __m256 vr = _mm256_loadu_ps(r + x);
+            const __m256 vg = _mm256_loadu_ps(g + x);
+            const __m256 vb = _mm256_loadu_ps(b + x);
+            const __m256 cr = _mm256_fmadd_ps(vr, _mm256_set1_ps(k[0]), _mm256_fmadd_ps(vg, _mm256_set1_ps(k[1]), _mm256_mul_ps(vb, _mm256_set1_ps(k[2]))));
+            const __m256 cg = _mm256_fmadd_ps(vr, _mm256_set1_ps(k[3]), _mm256_fmadd_ps(vg, _mm256_set1_ps(k[4]), _mm256_mul_ps(vb, _mm256_set1_ps(k[5]))));
+            const __m256 cb = _mm256_fmadd_ps(vr, _mm256_set1_ps(k[6]), _mm256_fmadd_ps(vg, _mm256_set1_ps(k[7]), _mm256_mul_ps(vb, _mm256_set1_ps(k[8]))));
+            _mm256_storeu_ps(r + x, pqEncodeAvx2(table, cr));
+            _mm256_storeu_ps(g + x, pqEncodeAvx2(table, cg));
+            _mm256_storeu_ps(b + x, pqEncodeAvx2(table, cb));
+        }
+        return x;
+    }
+
+    OBS_TARGET_AVX2 static int hdr10SignalAvx2(const uint8_t* src, int width, float* r, float* g, float* b)
+    {
+        const __m256i mask = _mm256_set1_epi32(0x3FF);
+        const __m256 scale = _mm256_set1_ps(1.0f / 1023.0f);
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + static_cast<size_t>(x) * 4));
+            _mm256_storeu_ps(r + x, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(px, mask)), scale));
+            _mm256_storeu_ps(g + x, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 10), mask)), scale));
+            _mm256_storeu_ps(b + x, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 20), mask)), scale));
+        }
+        return x;
+    }
+
+    // Rounds, clamps to 10 bits and moves into the top of each 32-bit lane's low half
+    OBS_TARGET_AVX2 static __m256i p010SamplesAvx2(__m256 v)
+    {
+        const __m256i code = _mm256_cvttps_epi32(_mm256_add_ps(v, _mm256_set1_ps(0.5f)));
+        const __m256i clamped = _mm256_min_epi32(_mm256_max_epi32(code, _mm256_setzero_si256()), _mm256_set1_epi32(1023));
+        return _mm256_slli_epi32(clamped, 6);
+    }
+
+    OBS_TARGET_AVX2 static int p010LumaAvx2(const float* const* line, int width, uint16_t* y)
+    {
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            __m256 v = _mm256_mul_ps(_mm256_loadu_ps(line[0] + x), _mm256_set1_ps(kLumaR));
+            v = _mm256_fmadd_ps(_mm256_loadu_ps(line[1] + x), _mm256_set1_ps(kLumaG), v);
+            v = _mm256_fmadd_ps(_mm256_loadu_ps(line[2] + x), _mm256_set1_ps(kLumaB), v);
+            const __m256i codes = p010SamplesAvx2(_mm256_fmadd_ps(v, _mm256_set1_ps(876.0f), _mm256_set1_ps(64.0f)));
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(codes, codes), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(y + x), _mm256_castsi256_si128(packed));
+        }
+        return x;
+    }
+
+    // 8 chroma samples (16 pixels) per step; hadd sums neighbours within lanes and the
+    // permute puts the pair sums back in pixel order
+    OBS_TARGET_AVX2 static int p010ChromaAvx2(const float* const* line0, const float* const* line1, int width, uint16_t* uv)
+    {
+        __m256 avg[3];
+        int cx = 0;
+        for (; cx * 2 + 16 <= width; cx += 8) {
+            const int x = cx * 2;
+            for (int c = 0; c < 3; c++) {
+                const __m256 lo = _mm256_add_ps(_mm256_loadu_ps(line0[c] + x), _mm256_loadu_ps(line1[c] + x));
+                const __m256 hi = _mm256_add_ps(_mm256_loadu_ps(line0[c] + x + 8), _mm256_loadu_ps(line1[c] + x + 8));
+                const __m256 sums = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_hadd_ps(lo, hi)), _MM_SHUFFLE(3, 1, 2, 0)));
+                avg[c] = _mm256_mul_ps(sums, _mm256_set1_ps(0.25f));
+            }
+            __m256 luma = _mm256_mul_ps(avg[0], _mm256_set1_ps(kLumaR));
+            luma = _mm256_fmadd_ps(avg[1], _mm256_set1_ps(kLumaG), luma);
+            luma = _mm256_fmadd_ps(avg[2], _mm256_set1_ps(kLumaB), luma);
+            const __m256 cb = _mm256_fmadd_ps(_mm256_sub_ps(avg[2], luma), _mm256_set1_ps(896.0f * kCbScale), _mm256_set1_ps(512.0f));
+            const __m256 cr = _mm256_fmadd_ps(_mm256_sub_ps(avg[0], luma), _mm256_set1_ps(896.0f * kCrScale), _mm256_set1_ps(512.0f));
+            const __m256i pairs = _mm256_or_si256(p010SamplesAvx2(cb), _mm256_slli_epi32(p010SamplesAvx2(cr), 16));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(uv + cx * 2), pairs);
+        }
+        return cx;
+    }
+#endif
+
+    // --- Dispatch ---
+
+    static void linearRow(const HdrConverter& c, const HdrView& src, int y, int width, float* r, float* g, float* b, bool to709, bool avx2)
+    {
+        int x = 0;
+#ifdef OBS_HAVE_AVX2
+        if (avx2) {
+            switch (src.format) {
+            case HdrFormat::ScRgb16F:
+                x = decodeScRgbAvx2(src.row(y), width, r, g, b);
+                break;
+            case HdrFormat::Hdr10:
+                x = decodeHdr10Avx2(src.row(y), width, r, g, b, to709);
+                break;
+            case HdrFormat::Hlg10:
+                x = decodeHlgAvx2(c, src.row(y), width, r, g, b, to709);
+                break;
+            }
+        }
+#endif
+        switch (src.format) {
+        case HdrFormat::ScRgb16F:
+            decodeScRgb(src.row(y), x, width, r, g, b);
+            break;
+        case HdrFormat::Hdr10:
+            decodeHdr10(src.row(y), x, width, r, g, b, to709);
+            break;
+        case HdrFormat::Hlg10:
+            decodeHlg(c, src.row(y), x, width, r, g, b, to709);
+            break;
+        }
+    }
+
+    static void toneMapRow(const HdrConverter& c, const float* r, const float* g, const float* b, int width, uint8_t* dst, bool avx2)
+    {
+        int x = 0;
+#ifdef OBS_HAVE_AVX2
+        if (avx2) {
+            x = toneMapAvx2(c, r, g, b, width, dst);
+        }
+#endif
+        toneMap(c, r, g, b, x, width, dst);
+    }
+
+    // One line of PQ BT.2020 signal for the P010 path
+    static void signalRow(const HdrConverter& c, const HdrView& src, int y, int width, float* r, float* g, float* b, bool avx2)
+    {
+        int x = 0;
+        if (src.format == HdrFormat::Hdr10) {
+#ifdef OBS_HAVE_AVX2
+            if (avx2) {
+                x = hdr10SignalAvx2(src.row(y), width, r, g, b);
+            }
+#endif
+            hdr10Signal(src.row(y), x, width, r, g, b);
+            return;
+        }
+
+        // pqSignal takes BT.709, so HLG goes there and back; both steps are linear
+        linearRow(c, src, y, width, r, g, b, src.format == HdrFormat::Hlg10, avx2);
+#ifdef OBS_HAVE_AVX2
+        if (avx2) {
+            x = pqSignalAvx2(r, g, b, width);
+        }
+#endif
+        pqSignal(r, g, b, x, width);
+    }
+
+    // Two signal lines -> two luma lines and their chroma line. With an odd height
+    // line1 repeats line0 and y1 is null.
+    static void p010Lines(const float* const* line0, const float* const* line1, int width, uint16_t* y0, uint16_t* y1, uint16_t* uv, bool avx2)
+    {
+        int x0 = 0, x1 = 0, cx = 0;
+#ifdef OBS_HAVE_AVX2
+        if (avx2) {
+            x0 = p010LumaAvx2(line0, width, y0);
+            x1 = y1 ? p010LumaAvx2(line1, width, y1) : 0;
+            cx = p010ChromaAvx2(line0, line1, width, uv);
+        }
+#endif
+        p010Luma(line0, x0, width, y0);
+        if (y1) {
+            p010Luma(line1, x1, width, y1);
+        }
+        p010Chroma(line0, line1, cx, width, uv);
+    }
+};
+
+HdrConverter::HdrConverter()
+{
+    setSettings(Settings());
+}
+
+HdrConverter::HdrConverter(const Settings& settings)
+{
+    setSettings(settings);
+}
+
+void HdrConverter::setSettings(const Settings& settings)
+{
+    m_settings = settings;
+    m_settings.sdrWhiteNits = std::min(std::max(settings.sdrWhiteNits, 1.0f), static_cast<float>(kPqMaxNits));
+    m_settings.peakNits = std::min(std::max(settings.peakNits, m_settings.sdrWhiteNits), static_cast<float>(kPqMaxNits));
+
+    const double white = m_settings.sdrWhiteNits;
+    const double peak = m_settings.peakNits / white;
+    m_peak = static_cast<float>(peak);
+
+    // BT.2390 with source and target black at zero. Signals are normalized to the
+    // source peak; a target at the peak puts the knee at 1.0 and leaves the identity.
+    const double pqPeak = pqEncode(m_settings.peakNits);
+    const double pqTarget = pqEncode(white) / pqPeak;
+    const double kneeStart = std::min(1.5 * pqTarget - 0.5, 1.0);
+    const double hableWhite = hable(peak * kHableExposure);
+
+    // Maps x (max channel, in units of SDR white) into [0, 1]
+    auto curve = [&](double x) {
+        switch (m_settings.curve) {
+        case ToneCurve::Reinhard:
+            return x * (1.0 + x / (peak * peak)) / (1.0 + x);
+        case ToneCurve::Hable:
+            return hable(x * kHableExposure) / hableWhite;
+        case ToneCurve::Bt2390: {
+            double e = std::min(pqEncode(x * white) / pqPeak, 1.0);
+            if (e > kneeStart) {
+                const double t = (e - kneeStart) / (1.0 - kneeStart);
+                const double t2 = t * t;
+                const double t3 = t2 * t;
+                e = (2.0 * t3 - 3.0 * t2 + 1.0) * kneeStart + (t3 - 2.0 * t2 + t) * (1.0 - kneeStart)
+                    + (-2.0 * t3 + 3.0 * t2) * pqTarget;
+            }
+            return pqDecode(e * pqPeak) / white;
+        }
+        case ToneCurve::Clip:
+        default:
+            return x;
+        }
+    };
+
+    m_toneRatio.resize(kToneEntries);
+    for (int i = 0; i < kToneEntries; i++) {
+        const double u = static_cast<double>(i) / (kToneEntries - 1);
+        const double x = std::max(peak * u * u, 1e-6); // the ratio's limit at zero
+        m_toneRatio[i] = static_cast<float>(std::min(curve(x), 1.0) / x);
+    }
+
+    // BT.2100 system gamma for the display peak; the gain sends HLG 1.0 to peakNits
+    const double gamma = 1.2 + 0.42 * std::log10(m_settings.peakNits / 1000.0);
+    m_hlgGain.resize(kHlgGainEntries);
+    for (int i = 0; i < kHlgGainEntries; i++) {
+        const double u = static_cast<double>(i) / (kHlgGainEntries - 1);
+        m_hlgGain[i] = static_cast<float>(m_settings.peakNits * std::pow(std::max(u * u, 1e-6), gamma - 1.0));
+    }
+}
+
+void HdrConverter::toSdr(const HdrView& src, const FrameView& dst, ThreadPool* pool) const
+{
+    if (!src.isValid() || !dst.isValid() || dst.width < src.width || dst.height < src.height) {
+        return;
+    }
+
+    const bool avx2 = m_useSimd && useAvx2();
+    const int width = src.width;
+    auto rows = [&](int first, int last) {
+        thread_local std::vector<float> scratch;
+        scratch.resize(static_cast<size_t>(width) * 3);
+        float* r = scratch.data();
+        float* g = r + width;
+        float* b = g + width;
+        for (int y = first; y < last; y++) {
+            HdrKernels::linearRow(*this, src, y, width, r, g, b, true, avx2);
+            HdrKernels::toneMapRow(*this, r, g, b, width, dst.row(y), avx2);
+        }
+    };
+
+    if (pool) {
+        pool->parallelFor(src.height, rows, kRowGrain);
+    }
+    else {
+        rows(0, src.height);
+    }
+}
+
+void HdrConverter::toP010(const HdrView& src, P010Buffer& dst, ThreadPool* pool) const
+{
+    if (!src.isValid()) {
+        return;
+    }
+    dst.resize(src.width, src.height);
+
+    const bool avx2 = m_useSimd && useAvx2();
+    const int width = src.width;
+    const int height = src.height;
+    const int chromaWidth = dst.chromaWidth();
+
+    // Work in line pairs so each task owns whole chroma lines
+    auto pairs = [&](int first, int last) {
+        thread_local std::vector<float> scratch;
+        scratch.resize(static_cast<size_t>(width) * 6);
+        float* s = scratch.data();
+        const float* line0[3] = { s, s + width, s + width * 2 };
+        const float* line1[3] = { s + width * 3, s + width * 4, s + width * 5 };
+        for (int pair = first; pair < last; pair++) {
+            const int y0 = pair * 2;
+            const bool hasSecond = y0 + 1 < height;
+            HdrKernels::signalRow(*this, src, y0, width, s, s + width, s + width * 2, avx2);
+            if (hasSecond) {
+                HdrKernels::signalRow(*this, src, y0 + 1, width, s + width * 3, s + width * 4, s + width * 5, avx2);
+            }
+            HdrKernels::p010Lines(line0, hasSecond ? line1 : line0, width,
+                dst.luma.data() + static_cast<size_t>(y0) * width,
+                hasSecond ? dst.luma.data() + static_cast<size_t>(y0 + 1) * width : nullptr,
+                dst.chroma.data() + static_cast<size_t>(pair) * chromaWidth * 2, avx2);
+        }
+    };
+
+    const int pairCount = dst.chromaHeight();
+    if (pool) {
+        pool->parallelFor(pairCount, pairs, kRowGrain / 2);
+    }
+    else {
+        pairs(0, pairCount);
+    }
+}
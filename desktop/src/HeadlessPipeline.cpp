@@ -0,0 +1,795 @@
+#include "incl/HeadlessPipeline.h"
+#include "incl/AllocationCounter.h"
+#include "incl/BufferPool.h"
+#include "incl/FrameChangeDetector.h"
+#include "incl/RecoveringSource.h"
+#include "incl/SchedulerBenchmark.h"
+#include "incl/SyntheticSource.h"
+#include "incl/TraceReplaySource.h"
+#include "incl/ThreadPool.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+
+#ifdef OBS_HAVE_X11
+#include "incl/X11Capture.h"
+#endif
+#ifdef OBS_HAVE_DXGI
+#include "incl/ScreenCaptureSource.h"
+#endif
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Frames before the allocation check starts; pools and scratch fill up first
+    constexpr int kWarmupFrames = 30;
+
+    // Synthetic audio is generated every 10 ms, at most this many frames at a time
+    constexpr int kAudioPeriodMs = 10;
+    constexpr int kAudioChunkFrames = 1024;
+
+    int64_t microsBetween(Clock::time_point a, Clock::time_point b)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(b - a).count();
+    }
+
+    std::string trim(const std::string& text)
+    {
+        const size_t first = text.find_first_not_of(" \t\r\n");
+        if (first == std::string::npos) {
+            return std::string();
+        }
+        const size_t last = text.find_last_not_of(" \t\r\n");
+        return text.substr(first, last - first + 1);
+    }
+
+    bool parseInt(const std::string& text, int& out)
+    {
+        char* end = nullptr;
+        const long value = std::strtol(text.c_str(), &end, 10);
+        if (text.empty() || *end != '\0' || value < 0 || value > 1000000000) {
+            return false;
+        }
+        out = static_cast<int>(value);
+        return true;
+    }
+
+    // Keys that are switches: "--bench" alone turns it on
+    bool isSwitch(const std::string& key)
+    {
+        return key == "bench" || key == "replay-realtime" || key == "loop";
+    }
+
+    uint64_t allocationsSoFar()
+    {
+        return AllocationCounter::count() + BufferPool::instance().stats().misses;
+    }
+}
+
+const char* HeadlessConfig::usage()
+{
+    return
+        "usage: obs-headless [options]\n"
+        "  --config FILE        read \"key = value\" lines with the keys below\n"
+        "  --source NAME        video source: x11, dxgi, synthetic (default: this platform's\n"
+        "                       capture, synthetic where there is none)\n"
+        "  --display NAME       X11 display (default: $DISPLAY)\n"
+        "  --frames N           stop after N frames (default: no limit)\n"
+        "  --seconds S          stop after S seconds (default: 10, 0 = no limit)\n"
+        "  --fps N              capture rate (default: 60, 0 = flat out)\n"
+        "  --renditions WxH,..  scaled outputs, e.g. 1280x720,640x360\n"
+        "  --output FILE.y4m    write the first rendition (or the canvas)\n"
+        "  --threads N          worker threads (default: one per core)\n"
+        "  --bench              run flat out, check for steady-state allocations and\n"
+        "                       print the scheduler scaling table\n"
+        "  --trace FILE.json    record a timeline for chrome://tracing or ui.perfetto.dev\n"
+        "  --metrics-port N     serve Prometheus metrics on 127.0.0.1:N/metrics while running\n"
+        "  --shm-output NAME    publish frames to shared memory for SharedFrameReader (Linux)\n"
+        "  --record-trace FILE  record the source's frames, damage, cursor and audio\n"
+        "replay (--source replay):\n"
+        "  --replay FILE        play a recorded capture trace back as the source\n"
+        "  --replay-realtime    keep the recorded timing (default: as fast as frames are\n"
+        "                       asked for; add --fps 0 for flat out)\n"
+        "  --loop               start over at the end instead of stopping\n"
+        "synthetic source:\n"
+        "  --workload SCRIPT    idle, typing, drag, scroll, noise, cursor with optional frame\n"
+        "                       counts, e.g. typing:300,drag:120,noise (default: typing)\n"
+        "  --resolution WxH     frame size up to 7680x4320 (default: 1920x1080)\n"
+        "  --seed N             same seed, same frames and samples (default: 1)\n"
+        "  --audio SCRIPT       tone, noise, silence with optional seconds, e.g. tone:1,noise:1\n"
+        "  --audio-format F     u8, s16, s24, s32 or f32 (default: f32)\n"
+        "  --audio-rate N       sample rate (default: 48000)\n"
+        "  --audio-channels N   channel count (default: 2)\n"
+        "  --audio-output FILE  write the generated audio as FLAC\n";
+}
+
+bool HeadlessConfig::set(const std::string& key, const std::string& value, std::string& error)
+{
+    if (key == "source") {
+        source = value;
+    }
+    else if (key == "display") {
+        display = value;
+    }
+    else if (key == "output") {
+        output = value;
+    }
+    else if (key == "trace") {
+        trace = value;
+    }
+    else if (key == "shm-output") {
+        shmOutput = value;
+    }
+    else if (key == "record-trace") {
+        recordTrace = value;
+    }
+    else if (key == "replay") {
+        replay = value;
+    }
+    else if (key == "workload") {
+        std::vector<SyntheticSource::Step> script;
+        if (!SyntheticSource::parseScript(value, script, error)) {
+            return false;
+        }
+        workload = value;
+    }
+    else if (key == "audio") {
+        std::vector<SyntheticAudioSource::Segment> script;
+        if (!value.empty() && !SyntheticAudioSource::parseScript(value, script, error)) {
+            return false;
+        }
+        audio = value;
+    }
+    else if (key == "audio-format") {
+        SampleFormat format;
+        if (!SyntheticAudioSource::parseFormat(value, format)) {
+            error = "bad audio format: " + value + " (u8, s16, s24, s32, f32)";
+            return false;
+        }
+        audioFormat = value;
+    }
+    else if (key == "audio-output") {
+        audioOutput = value;
+    }
+    else if (key == "frames" || key == "fps" || key == "threads" || key == "metrics-port" || key == "seed" ||
+        key == "audio-rate" || key == "audio-channels") {
+        int number = 0;
+        if (!parseInt(value, number) || (key == "metrics-port" && number > 65535) ||
+            (key == "audio-channels" && (number < 1 || number > LoudnessMeter::kMaxChannels))) {
+            error = "bad number for " + key + ": " + value;
+            return false;
+        }
+        (key == "frames" ? frames : key == "fps" ? fps : key == "threads" ? threads : key == "metrics-port" ? metricsPort :
+            key == "seed" ? seed : key == "audio-rate" ? audioRate : audioChannels) = number;
+    }
+    else if (key == "resolution") {
+        const size_t x = value.find('x');
+        if (x == std::string::npos || !parseInt(value.substr(0, x), width) || !parseInt(value.substr(x + 1), height)) {
+            error = "bad resolution: " + value;
+            return false;
+        }
+    }
+    else if (key == "seconds") {
+        char* end = nullptr;
+        seconds = std::strtod(value.c_str(), &end);
+        if (value.empty() || *end != '\0' || seconds < 0.0) {
+            error = "bad number for seconds: " + value;
+            return false;
+        }
+    }
+    else if (key == "renditions") {
+        renditions.clear();
+        size_t begin = 0;
+        while (begin <= value.size()) {
+            size_t end = value.find(',', begin);
+            if (end == std::string::npos) {
+                end = value.size();
+            }
+            const std::string item = trim(value.substr(begin, end - begin));
+            const size_t x = item.find('x');
+            Rendition rendition;
+            if (x == std::string::npos || !parseInt(item.substr(0, x), rendition.width) ||
+                !parseInt(item.substr(x + 1), rendition.height) || rendition.width == 0 || rendition.height == 0) {
+                error = "bad rendition: " + item;
+                return false;
+            }
+            renditions.push_back(rendition);
+            begin = end + 1;
+        }
+    }
+    else if (isSwitch(key)) {
+        const bool on = value.empty() || value == "1" || value == "true" || value == "yes" || value == "on";
+        (key == "bench" ? bench : key == "loop" ? loop : replayRealtime) = on;
+    }
+    else {
+        error = "unknown option: " + key;
+        return false;
+    }
+    return true;
+}
+
+bool HeadlessConfig::loadFile(const std::string& path, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot read config file " + path;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) {
+            continue;
+        }
+        const size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            error = path + ":" + std::to_string(lineNumber) + ": expected key = value";
+            return false;
+        }
+        if (!set(trim(line.substr(0, equals)), trim(line.substr(equals + 1)), error)) {
+            error = path + ":" + std::to_string(lineNumber) + ": " + error;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HeadlessConfig::parseArgs(int argc, char** argv, std::string& error)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            error.clear();
+            return false;
+        }
+        if (arg.compare(0, 2, "--") != 0) {
+            error = "unexpected argument: " + arg;
+            return false;
+        }
+
+        std::string key = arg.substr(2);
+        std::string value;
+        const size_t equals = key.find('=');
+        if (equals != std::string::npos) {
+            value = key.substr(equals + 1);
+            key = key.substr(0, equals);
+        }
+        else if (!isSwitch(key)) {
+            if (i + 1 >= argc) {
+                error = "missing value for --" + key;
+                return false;
+            }
+            value = argv[++i];
+        }
+
+        if (key == "config") {
+            if (!loadFile(value, error)) {
+                return false;
+            }
+        }
+        else if (!set(key, value, error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+HeadlessPipeline::HeadlessPipeline(const HeadlessConfig& config)
+    : m_config(config)
+{
+}
+
+HeadlessPipeline::~HeadlessPipeline() = default;
+
+std::unique_ptr<VideoSource> HeadlessPipeline::createSource(const HeadlessConfig& config, std::string& error)
+{
+    std::string name = config.source;
+    if (name.empty() && !config.replay.empty()) {
+        name = "replay";
+    }
+    if (name.empty()) {
+#if defined(OBS_HAVE_DXGI)
+        name = "dxgi";
+#elif defined(OBS_HAVE_X11)
+        name = "x11";
+#else
+        name = "synthetic";
+#endif
+    }
+
+    if (name == "synthetic") {
+        SyntheticSource::Settings settings;
+        settings.width = config.width;
+        settings.height = config.height;
+        settings.fps = std::max(config.fps, 1);
+        settings.seed = static_cast<uint32_t>(config.seed);
+        if (!SyntheticSource::parseScript(config.workload, settings.script, error)) {
+            return nullptr;
+        }
+        return std::make_unique<SyntheticSource>(settings);
+    }
+    if (name == "replay") {
+        if (config.replay.empty()) {
+            error = "--source replay needs --replay FILE";
+            return nullptr;
+        }
+        TraceReplaySource::Settings settings;
+        settings.path = config.replay;
+        settings.realtime = config.replayRealtime;
+        settings.loop = config.loop;
+        return std::make_unique<TraceReplaySource>(settings);
+    }
+
+#ifdef OBS_HAVE_X11
+    if (name == "x11") {
+        return std::make_unique<X11Capture>(config.display);
+    }
+#endif
+#ifdef OBS_HAVE_DXGI
+    if (name == "dxgi") {
+        // Desktop switches and UAC prompts hold the last frame instead of stalling the run
+        DeviceRecovery::Settings recovery;
+        recovery.name = "dxgi";
+        return std::make_unique<RecoveringSource>(std::make_unique<ScreenCaptureSource>(), recovery);
+    }
+#endif
+
+    error = "unknown or unavailable video source: " + name;
+    return nullptr;
+}
+
+int HeadlessPipeline::run()
+{
+    std::string error;
+    m_source = createSource(m_config, error);
+    if (!m_source) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    m_pool = std::make_unique<ThreadPool>(m_config.threads);
+    if (!m_config.trace.empty()) {
+        Tracer::instance().setThreadName("pipeline");
+        Tracer::instance().setEnabled(true);
+    }
+    if (m_config.metricsPort > 0) {
+        m_metrics = MetricsRegistry::instance().add([this](MetricsWriter& writer) { collectMetrics(writer); });
+        if (!m_metricsServer.start(m_config.metricsPort)) {
+            std::fprintf(stderr, "Metrics endpoint unavailable: %s\n", m_metricsServer.lastError().c_str());
+        }
+    }
+
+    // The display connection and the audio setup don't wait for each other
+    const int videoPhase = m_startup.add("video source", [this](std::string& error) {
+        if (!m_source->initialize()) {
+            error = m_source->lastError();
+            return false;
+        }
+        return true;
+    });
+    const int audioPhase = m_config.audio.empty() ? -1 :
+        m_startup.add("audio", [this](std::string& error) { return prepareAudio(error); });
+    m_startup.start();
+    m_startup.wait();
+    std::printf("startup:\n%s", m_startup.report().c_str());
+    if (!m_startup.phase(videoPhase).ok) {
+        std::fprintf(stderr, "Failed to initialize %s source: %s\n", m_source->name(),
+            m_startup.phase(videoPhase).error.c_str());
+        return 1;
+    }
+    if (audioPhase >= 0 && !m_startup.phase(audioPhase).ok) {
+        std::fprintf(stderr, "%s\n", m_startup.phase(audioPhase).error.c_str());
+        return 1;
+    }
+    if (auto* replay = dynamic_cast<TraceReplaySource*>(m_source.get())) {
+        replay->setAudioSink([this](int64_t, const CaptureTraceReader::AudioPacket& packet) { replayAudio(packet); });
+        if (replay->reader().indexRebuilt()) {
+            std::fprintf(stderr, "%s has no index (recording cut short?), recovered %zu frames by scanning\n",
+                m_config.replay.c_str(), replay->reader().frameCount());
+        }
+    }
+
+    // Before the audio starts, which records into it too
+    m_runStart = Clock::now();
+    if (!m_config.recordTrace.empty() && !m_traceWriter.open(m_config.recordTrace)) {
+        std::fprintf(stderr, "%s\n", m_traceWriter.lastError().c_str());
+        return 1;
+    }
+    if (!m_config.audio.empty() && !startAudio()) {
+        return 1;
+    }
+#ifndef OBS_HAVE_SHM
+    if (!m_config.shmOutput.empty()) {
+        std::fprintf(stderr, "Shared-memory output is not available in this build\n");
+        return 2;
+    }
+#endif
+
+    const bool paced = m_config.fps > 0 && !m_config.bench;
+    const auto period = std::chrono::microseconds(paced ? 1000000 / m_config.fps : 0);
+    const Clock::time_point start = Clock::now();
+    Clock::time_point next = start;
+
+    for (;;) {
+        const Clock::time_point now = Clock::now();
+        if (m_config.seconds > 0.0 && microsBetween(start, now) >= static_cast<int64_t>(m_config.seconds * 1e6)) {
+            break;
+        }
+        if (m_config.frames > 0 && m_framesComposed.load(std::memory_order_relaxed) >= static_cast<uint64_t>(m_config.frames)) {
+            break;
+        }
+
+        const uint64_t allocationsBefore = allocationsSoFar();
+        SourceFrame frame;
+        const bool captured = m_source->acquireFrame(frame);
+        const int64_t captureMicros = microsBetween(now, Clock::now());
+
+        if (captured && m_traceWriter.isOpen()) {
+            const int64_t at = microsBetween(m_runStart, now);
+            if (frame.cursor) {
+                m_traceWriter.writeCursor(at, *frame.cursor);
+            }
+            m_traceWriter.writeFrame(at, frame.pixels, frame.changes);
+        }
+
+        if (!captured && m_source->atEnd()) {
+            break;
+        }
+        if (!captured) {
+            m_emptyPolls.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if (frame.changes && frame.changes->isDuplicate() && !frame.held && m_framesComposed.load(std::memory_order_relaxed) > 0) {
+            m_duplicates.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            processFrame(frame, captureMicros);
+
+            if (AllocationCounter::enabled() && m_framesComposed.load(std::memory_order_relaxed) > static_cast<uint64_t>(kWarmupFrames)) {
+                m_steadyAllocations += allocationsSoFar() - allocationsBefore;
+            }
+        }
+
+        if (paced) {
+            next += period;
+            const Clock::time_point after = Clock::now();
+            if (next < after) {
+                m_droppedTicks.fetch_add((after - next) / period, std::memory_order_relaxed);
+                next = after; // fell behind; don't burst to catch up
+            }
+            std::this_thread::sleep_until(next);
+        }
+        else if (!captured) {
+            std::this_thread::yield();
+        }
+    }
+
+    const double elapsed = microsBetween(start, Clock::now()) / 1e6;
+    m_audioLane.stop();
+    m_flac.stop();
+    if (m_traceWriter.isOpen()) {
+        const uint64_t frames = m_traceWriter.framesWritten();
+        if (m_traceWriter.close()) {
+            std::printf("capture trace written to %s: %llu frames, %.1f MB\n", m_config.recordTrace.c_str(),
+                static_cast<unsigned long long>(frames), m_traceWriter.bytesWritten() / 1e6);
+        }
+        else {
+            std::fprintf(stderr, "Cannot write %s: %s\n", m_config.recordTrace.c_str(), m_traceWriter.lastError().c_str());
+        }
+    }
+    if (m_source->atEnd() && !m_source->lastError().empty()) {
+        std::fprintf(stderr, "%s stopped: %s\n", m_source->name(), m_source->lastError().c_str());
+    }
+    m_metricsServer.stop();
+    m_metrics.reset();
+    m_writer.close();
+#ifdef OBS_HAVE_SHM
+    m_shm.close();
+#endif
+    printSummary(elapsed);
+
+    if (!m_config.trace.empty()) {
+        Tracer::instance().setEnabled(false);
+        if (Tracer::instance().writeJson(m_config.trace)) {
+            std::printf("trace written to %s\n", m_config.trace.c_str());
+        }
+        else {
+            std::fprintf(stderr, "Cannot write %s\n", m_config.trace.c_str());
+        }
+    }
+
+    if (m_config.bench) {
+        SchedulerBenchmark::Settings settings;
+        if (m_sourceWidth > 0) {
+            settings.width = m_sourceWidth;
+            settings.height = m_sourceHeight;
+        }
+        settings.maxThreads = m_pool->threadCount();
+        std::printf("\nscheduler scaling, synthetic %dx%d frame graph\n", settings.width, settings.height);
+        std::printf("%8s %10s %9s %11s\n", "threads", "ms/frame", "speedup", "efficiency");
+        for (const SchedulerBenchmark::Result& result : SchedulerBenchmark::run(settings)) {
+            std::printf("%8d %10.2f %8.2fx %10.0f%%\n", result.threads, result.msPerFrame, result.speedup, result.efficiency * 100.0);
+        }
+
+        if (AllocationCounter::enabled() && m_steadyAllocations > 0) {
+            std::fprintf(stderr, "FAIL: %llu heap allocations after warm-up\n", static_cast<unsigned long long>(m_steadyAllocations));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+bool HeadlessPipeline::prepareAudio(std::string& error)
+{
+    SyntheticAudioSource::Settings settings;
+    settings.sampleRate = m_config.audioRate;
+    settings.channels = m_config.audioChannels;
+    settings.seed = static_cast<uint32_t>(m_config.seed);
+    if (!SyntheticAudioSource::parseFormat(m_config.audioFormat, settings.format) ||
+        !SyntheticAudioSource::parseScript(m_config.audio, settings.script, error) ||
+        !m_audioSource.configure(settings) ||
+        !m_audioToFloat.configure(settings.format, false, SampleFormat::F32, false, settings.channels) ||
+        !m_loudness.configure(settings.sampleRate, settings.channels)) {
+        error = "Bad synthetic audio settings: " + m_config.audioFormat + " " + std::to_string(settings.sampleRate) +
+            " Hz " + std::to_string(settings.channels) + " channels" + (error.empty() ? "" : " (" + error + ")");
+        return false;
+    }
+    m_audioPacket.assign(static_cast<size_t>(kAudioChunkFrames) * m_audioSource.bytesPerFrame(), 0);
+    m_audioFloat.assign(static_cast<size_t>(kAudioChunkFrames) * settings.channels, 0.0f);
+
+    if (!m_config.audioOutput.empty()) {
+        // Keep 24 bits when the source has more than 16
+        const int bits = bytesPerSample(settings.format) > 2 ? 24 : 16;
+        if (!m_flac.start(m_config.audioOutput, settings.sampleRate, settings.channels, bits, m_pool.get())) {
+            error = "Cannot write " + m_config.audioOutput;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HeadlessPipeline::startAudio()
+{
+    m_audioStart = Clock::now();
+    RealtimeLane::Settings lane;
+    lane.name = "synthetic audio";
+    lane.periodMs = kAudioPeriodMs;
+    return m_audioLane.start([this] { pumpAudio(); }, lane);
+}
+
+void HeadlessPipeline::pumpAudio()
+{
+    // Catch up to the wall clock, like a capture client draining its endpoint buffer
+    TraceScope trace("audio");
+    const int64_t due = microsBetween(m_audioStart, Clock::now()) * m_audioSource.settings().sampleRate / 1000000;
+    int64_t pending = due - static_cast<int64_t>(m_audioFrames.load(std::memory_order_relaxed));
+    while (pending > 0) {
+        const int frames = static_cast<int>(std::min<int64_t>(pending, kAudioChunkFrames));
+        m_audioSource.generate(m_audioPacket.data(), frames);
+        if (m_traceWriter.isOpen()) {
+            m_traceWriter.writeAudio(microsBetween(m_runStart, Clock::now()), m_audioSource.settings().sampleRate,
+                m_audioSource.settings().channels, m_audioSource.settings().format, m_audioPacket.data(), frames);
+        }
+        m_audioToFloat.convert(m_audioPacket.data(), m_audioFloat.data(), frames);
+        m_loudness.process(m_audioFloat.data(), frames);
+        m_flac.push(m_audioFloat.data(), frames);
+
+        m_audioFrames.fetch_add(frames, std::memory_order_relaxed);
+        pending -= frames;
+    }
+}
+
+void HeadlessPipeline::replayAudio(const CaptureTraceReader::AudioPacket& packet)
+{
+    // Recorded audio is measured like the live kind, on the pipeline thread
+    if (packet.channels > LoudnessMeter::kMaxChannels) {
+        return;
+    }
+    if (packet.sampleRate != m_loudness.sampleRate() || packet.channels != m_loudness.channels() ||
+        packet.format != m_replayFormat || !m_audioToFloat.isConfigured()) {
+        if (!m_loudness.configure(packet.sampleRate, packet.channels) ||
+            !m_audioToFloat.configure(packet.format, false, SampleFormat::F32, false, packet.channels)) {
+            return;
+        }
+        m_replayFormat = packet.format;
+        m_audioFloat.assign(static_cast<size_t>(kAudioChunkFrames) * packet.channels, 0.0f);
+    }
+
+    const size_t bytesPerFrame = static_cast<size_t>(bytesPerSample(packet.format)) * packet.channels;
+    for (int done = 0; done < packet.frames;) {
+        const int frames = std::min(packet.frames - done, kAudioChunkFrames);
+        m_audioToFloat.convert(packet.data + bytesPerFrame * done, m_audioFloat.data(), frames);
+        m_loudness.process(m_audioFloat.data(), frames);
+        done += frames;
+    }
+    m_audioFrames.fetch_add(packet.frames, std::memory_order_relaxed);
+}
+
+void HeadlessPipeline::processFrame(const SourceFrame& frame, int64_t captureMicros)
+{
+    TraceScope trace("frame");
+    const Clock::time_point composeStart = Clock::now();
+    const FrameView& pixels = frame.pixels;
+    m_sourceWidth = pixels.width;
+    m_sourceHeight = pixels.height;
+
+    // The source fills the canvas, as the display capture does in the GUI
+    SceneLayer layer;
+    layer.source = pixels;
+    layer.opaque = true;
+    layer.dest = SceneRect{ 0, 0, pixels.width, pixels.height };
+
+    m_scene.setCanvasSize(pixels.width, pixels.height);
+    if (m_captureLayerId == 0) {
+        m_captureLayerId = m_scene.addLayer(layer);
+    }
+    else {
+        m_scene.setLayer(m_captureLayerId, layer);
+        if (!frame.changes) {
+            m_scene.markContentChanged(m_captureLayerId);
+        }
+        else {
+            const ChangeMap& changes = *frame.changes;
+            for (int ty = 0; ty < changes.tilesY; ty++) {
+                if (!changes.rowChanged[ty]) {
+                    continue;
+                }
+                for (int tx = 0; tx < changes.tilesX; tx++) {
+                    if (changes.isChanged(tx, ty)) {
+                        m_scene.markContentChanged(m_captureLayerId, SceneRect{
+                            tx * changes.tileSize, ty * changes.tileSize, changes.tileSize, changes.tileSize });
+                    }
+                }
+            }
+        }
+    }
+    m_scene.compose(m_pool.get());
+    const FrameView canvas = m_scene.canvas();
+    const Clock::time_point scaleStart = Clock::now();
+
+    FrameView output = canvas;
+    if (!m_config.renditions.empty()) {
+        if (canvas.width != m_pyramidWidth || canvas.height != m_pyramidHeight) {
+            if (!m_pyramid.configure(canvas.width, canvas.height, m_config.renditions)) {
+                std::fprintf(stderr, "Renditions don't fit a %dx%d canvas, writing the canvas\n", canvas.width, canvas.height);
+                m_config.renditions.clear();
+            }
+            m_pyramidWidth = canvas.width;
+            m_pyramidHeight = canvas.height;
+        }
+    }
+    if (!m_config.renditions.empty()) {
+        m_pyramid.process(canvas, m_pool.get(), frame.changes);
+        output = m_pyramid.level(0);
+    }
+    const Clock::time_point writeStart = Clock::now();
+
+    if (!m_config.output.empty()) {
+        if (!m_writer.isOpen() && !m_writer.open(m_config.output, output.width, output.height, std::max(m_config.fps, 1))) {
+            std::fprintf(stderr, "Cannot write %s\n", m_config.output.c_str());
+            m_config.output.clear();
+        }
+        else {
+            m_writer.write(output, m_pool.get());
+        }
+    }
+#ifdef OBS_HAVE_SHM
+    if (!m_config.shmOutput.empty()) {
+        // Sized for the first frame; the canvas and renditions don't change during a run
+        if (!m_shm.isOpen() && !m_shm.open(m_config.shmOutput, output.width, output.height)) {
+            std::fprintf(stderr, "Cannot publish to shared memory: %s\n", m_shm.lastError().c_str());
+            m_config.shmOutput.clear();
+        }
+        else {
+            m_shm.publish(output, frame.timestampUs, m_pool.get());
+            m_shmFrames.store(m_shm.framesPublished(), std::memory_order_relaxed);
+            m_shmReaders.store(m_shm.readers(), std::memory_order_relaxed);
+        }
+    }
+#endif
+    const Clock::time_point end = Clock::now();
+
+    m_latency[StageCapture].record(captureMicros);
+    m_latency[StageCompose].record(microsBetween(composeStart, scaleStart));
+    m_latency[StageScale].record(microsBetween(scaleStart, writeStart));
+    m_latency[StageWrite].record(microsBetween(writeStart, end));
+    m_latency[StageTotal].record(captureMicros + microsBetween(composeStart, end));
+    m_framesComposed.fetch_add(1, std::memory_order_relaxed);
+}
+
+void HeadlessPipeline::printSummary(double elapsedSeconds) const
+{
+    static const char* const kStageNames[StageCount] = { "capture", "compose", "scale", "write", "total" };
+
+    const uint64_t frames = m_framesComposed.load(std::memory_order_relaxed);
+    std::printf("%s %dx%d: %llu frames in %.2f s (%.1f fps), %llu duplicates skipped, %llu empty polls, %llu ticks dropped\n",
+        m_source->name(), m_sourceWidth, m_sourceHeight,
+        static_cast<unsigned long long>(frames), elapsedSeconds,
+        elapsedSeconds > 0.0 ? frames / elapsedSeconds : 0.0,
+        static_cast<unsigned long long>(m_duplicates.load(std::memory_order_relaxed)),
+        static_cast<unsigned long long>(m_emptyPolls.load(std::memory_order_relaxed)),
+        static_cast<unsigned long long>(m_droppedTicks.load(std::memory_order_relaxed)));
+    if (const auto* recovering = dynamic_cast<const RecoveringSource*>(m_source.get())) {
+        const DeviceRecovery& recovery = recovering->recovery();
+        if (recovery.losses() > 0) {
+            std::printf("device lost %llu times, recovered %llu (%llu attempts), %llu frames held, longest outage %.1f ms\n",
+                static_cast<unsigned long long>(recovery.losses()), static_cast<unsigned long long>(recovery.recoveries()),
+                static_cast<unsigned long long>(recovery.attempts()), static_cast<unsigned long long>(recovering->heldFrames()),
+                recovery.longestOutageMicros() / 1000.0);
+        }
+    }
+
+    // Synthetic or replayed
+    const uint64_t audioFrames = m_audioFrames.load(std::memory_order_relaxed);
+    if (!m_config.audio.empty()) {
+        std::printf("audio %s %d Hz %d ch: %llu frames, %.1f LUFS integrated, %llu lane overruns\n",
+            m_config.audioFormat.c_str(), m_loudness.sampleRate(), m_loudness.channels(),
+            static_cast<unsigned long long>(audioFrames), m_loudness.snapshot().integrated,
+            static_cast<unsigned long long>(m_audioLane.overruns()));
+    }
+    else if (audioFrames > 0) {
+        std::printf("audio %d Hz %d ch: %llu frames, %.1f LUFS integrated\n", m_loudness.sampleRate(),
+            m_loudness.channels(), static_cast<unsigned long long>(audioFrames), m_loudness.snapshot().integrated);
+    }
+
+    std::printf("%-8s %9s %9s %9s %9s %9s\n", "stage", "mean ms", "p50", "p95", "p99", "max");
+    for (int stage = 0; stage < StageCount; stage++) {
+        const LatencyHistogram& h = m_latency[stage];
+        std::printf("%-8s %9.2f %9.2f %9.2f %9.2f %9.2f\n", kStageNames[stage], h.meanMicros() / 1000.0,
+            h.quantileMicros(0.5) / 1000.0, h.quantileMicros(0.95) / 1000.0,
+            h.quantileMicros(0.99) / 1000.0, h.maxMicros() / 1000.0);
+    }
+
+    if (AllocationCounter::enabled()) {
+        std::printf("heap allocations after %d warm-up frames: %llu\n", kWarmupFrames,
+            static_cast<unsigned long long>(m_steadyAllocations));
+    }
+    else {
+        std::printf("heap allocations: not counted (configure with -DOBS_COUNT_ALLOCATIONS=ON)\n");
+    }
+}
+
+void HeadlessPipeline::collectMetrics(MetricsWriter& writer) const
+{
+    static const char* const kStageLabels[StageCount] = {
+        "stage=\"capture\"", "stage=\"compose\"", "stage=\"scale\"", "stage=\"write\"", "stage=\"total\"" };
+
+    // Scrape thread: atomics and histograms only
+    writer.counter("obs_frames_captured_total", "Frames taken from the source and composed.",
+        static_cast<double>(m_framesComposed.load(std::memory_order_relaxed)));
+    writer.counter("obs_frames_duplicate_total", "Source frames identical to the previous one, skipped.",
+        static_cast<double>(m_duplicates.load(std::memory_order_relaxed)));
+    writer.counter("obs_frames_dropped_total", "Capture ticks skipped because a frame ran past its slot.",
+        static_cast<double>(m_droppedTicks.load(std::memory_order_relaxed)));
+    writer.counter("obs_source_empty_polls_total", "Polls where the source had no new frame.",
+        static_cast<double>(m_emptyPolls.load(std::memory_order_relaxed)));
+    if (const auto* recovering = dynamic_cast<const RecoveringSource*>(m_source.get())) {
+        writer.counter("obs_device_losses_total", "Times a capture device went away and recovery started.",
+            static_cast<double>(recovering->recovery().losses()), "device=\"screen\"");
+        writer.counter("obs_source_held_frames_total", "Frames repeated from the last good one while the source recovered.",
+            static_cast<double>(recovering->heldFrames()));
+    }
+
+    const int shmReaders = m_shmReaders.load(std::memory_order_relaxed);
+    if (shmReaders >= 0) {
+        writer.counter("obs_shm_frames_published_total", "Frames published to the shared-memory ring.",
+            static_cast<double>(m_shmFrames.load(std::memory_order_relaxed)));
+        writer.gauge("obs_shm_readers", "Readers attached to the shared-memory ring.", shmReaders);
+    }
+    m_startup.collectMetrics(writer);
+    if (!m_config.audio.empty() || !m_config.replay.empty()) {
+        writer.counter("obs_audio_frames_total", "Synthetic or replayed audio frames measured.",
+            static_cast<double>(m_audioFrames.load(std::memory_order_relaxed)));
+    }
+
+    for (int stage = 0; stage < StageCount; stage++) {
+        writer.summary("obs_stage_latency_seconds", "Time spent per frame in each pipeline stage.",
+            m_latency[stage], kStageLabels[stage]);
+    }
+}
@@ -0,0 +1,83 @@
+#include "incl/LatencyHistogram.h"
+#include <algorithm>
+#include <cmath>
+
+int LatencyHistogram::bucketFor(uint64_t micros)
+{
+    if (micros < kSubBuckets) {
+        return static_cast<int>(micros);
+    }
+
+    int exponent = 3;
+    while (exponent < kMaxExponent && (micros >> (exponent + 1)) != 0) {
+        exponent++;
+    }
+    if ((micros >> (exponent + 1)) != 0) {
+        return kBucketCount - 1; // past the last power of two
+    }
+
+    // Top three bits below the leading one pick the sub-bucket
+    const int sub = static_cast<int>((micros >> (exponent - 3)) & (kSubBuckets - 1));
+    return kSubBuckets + (exponent - 3) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpper(int bucket)
+{
+    if (bucket < kSubBuckets) {
+        return static_cast<uint64_t>(bucket);
+    }
+    const int exponent = (bucket - kSubBuckets) / kSubBuckets + 3;
+    const uint64_t sub = static_cast<uint64_t>((bucket - kSubBuckets) % kSubBuckets);
+    return ((kSubBuckets + sub + 1) << (exponent - 3)) - 1;
+}
+
+void LatencyHistogram::record(int64_t micros)
+{
+    const uint64_t value = micros > 0 ? static_cast<uint64_t>(micros) : 0;
+    m_buckets[bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+
+    // Single writer, so a plain compare is enough
+    if (value > m_max.load(std::memory_order_relaxed)) {
+        m_max.store(value, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (std::atomic<uint64_t>& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::meanMicros() const
+{
+    const uint64_t n = count();
+    return n ? static_cast<double>(m_sum.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+int64_t LatencyHistogram::quantileMicros(double q) const
+{
+    // Sum the buckets first; the count may already include samples still being added
+    uint64_t total = 0;
+    for (const std::atomic<uint64_t>& bucket : m_buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::min(std::max(q, 0.0), 1.0) * total)));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return static_cast<int64_t>(std::min<uint64_t>(bucketUpper(i), m_max.load(std::memory_order_relaxed)));
+        }
+    }
+    return maxMicros();
+}
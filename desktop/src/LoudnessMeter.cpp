@@ -0,0 +1,281 @@
+#include "incl/LoudnessMeter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr double kPi = 3.14159265358979323846;
+
+    // BS.1770 absolute gate and the histogram span above it
+    constexpr double kAbsoluteGate = -70.0;
+    constexpr double kMaxLoudness = 10.0;
+    constexpr double kBinWidth = 0.01;
+    constexpr int kBins = static_cast<int>((kMaxLoudness - kAbsoluteGate) / kBinWidth);
+
+    constexpr double kIntegratedGate = -10.0; // LU below the ungated mean
+    constexpr double kRangeGate = -20.0;
+    constexpr double kRangeLow = 0.10;
+    constexpr double kRangeHigh = 0.95;
+
+    constexpr int kMomentarySubBlocks = 4;   // 400 ms
+    constexpr int kShortTermHop = 10;        // LRA uses a short-term block every second
+
+    inline double energyToLoudness(double energy)
+    {
+        return energy > 0.0 ? -0.691 + 10.0 * std::log10(energy) : LoudnessMeter::kSilence;
+    }
+
+    inline double binCenter(int bin)
+    {
+        return kAbsoluteGate + (bin + 0.5) * kBinWidth;
+    }
+
+    inline double flushDenormal(double v)
+    {
+        return std::fabs(v) < 1e-30 ? 0.0 : v;
+    }
+}
+
+LoudnessMeter::Histogram::Histogram()
+    : m_counts(kBins, 0),
+    m_energy(kBins, 0.0)
+{
+}
+
+void LoudnessMeter::Histogram::clear()
+{
+    std::fill(m_counts.begin(), m_counts.end(), 0u);
+    std::fill(m_energy.begin(), m_energy.end(), 0.0);
+    m_totalCount = 0;
+    m_totalEnergy = 0.0;
+}
+
+void LoudnessMeter::Histogram::add(double energy)
+{
+    const double loudness = energyToLoudness(energy);
+    if (loudness < kAbsoluteGate) {
+        return;
+    }
+
+    const int bin = std::min(static_cast<int>((loudness - kAbsoluteGate) / kBinWidth), kBins - 1);
+    m_counts[bin]++;
+    m_energy[bin] += energy;
+    m_totalCount++;
+    m_totalEnergy += energy;
+}
+
+int LoudnessMeter::Histogram::gateBin(double relativeGate) const
+{
+    // Bins whose center reaches the gate are counted as above it
+    const double gate = energyToLoudness(m_totalEnergy / m_totalCount) + relativeGate;
+    const int bin = static_cast<int>(std::ceil((gate - kAbsoluteGate) / kBinWidth - 0.5));
+    return std::clamp(bin, 0, kBins);
+}
+
+double LoudnessMeter::Histogram::gatedLoudness(double relativeGate) const
+{
+    if (m_totalCount == 0) {
+        return kSilence;
+    }
+
+    uint64_t count = 0;
+    double energy = 0.0;
+    for (int i = gateBin(relativeGate); i < kBins; i++) {
+        count += m_counts[i];
+        energy += m_energy[i];
+    }
+    return count > 0 ? energyToLoudness(energy / count) : kSilence;
+}
+
+double LoudnessMeter::Histogram::range(double relativeGate, double lowPercentile, double highPercentile) const
+{
+    if (m_totalCount == 0) {
+        return 0.0;
+    }
+
+    const int first = gateBin(relativeGate);
+    uint64_t count = 0;
+    for (int i = first; i < kBins; i++) {
+        count += m_counts[i];
+    }
+    if (count == 0) {
+        return 0.0;
+    }
+
+    // Nearest-rank percentiles over the sorted block loudness values
+    const uint64_t lowRank = static_cast<uint64_t>((count - 1) * lowPercentile + 0.5);
+    const uint64_t highRank = static_cast<uint64_t>((count - 1) * highPercentile + 0.5);
+    double low = 0.0;
+    double high = 0.0;
+    uint64_t seen = 0;
+    for (int i = first; i < kBins; i++) {
+        if (m_counts[i] == 0) {
+            continue;
+        }
+        if (seen <= lowRank && lowRank < seen + m_counts[i]) {
+            low = binCenter(i);
+        }
+        seen += m_counts[i];
+        if (highRank < seen) {
+            high = binCenter(i);
+            break;
+        }
+    }
+    return high - low;
+}
+
+bool LoudnessMeter::configure(int sampleRate, int channels)
+{
+    if (sampleRate < 8000 || channels < 1 || channels > kMaxChannels) {
+        return false;
+    }
+
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_subBlockFrames = (sampleRate + 5) / 10;
+
+    // K-weighting, parameterized for any sample rate (BS.1770 defines it at 48 kHz)
+    {
+        const double f0 = 1681.974450955533;
+        const double gain = 3.999843853973347;
+        const double q = 0.7071752369554196;
+        const double k = std::tan(kPi * f0 / sampleRate);
+        const double vh = std::pow(10.0, gain / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+        m_shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        m_shelf.b1 = 2.0 * (k * k - vh) / a0;
+        m_shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        m_shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        m_shelf.a2 = (1.0 - k / q + k * k) / a0;
+    }
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+        const double k = std::tan(kPi * f0 / sampleRate);
+        const double a0 = 1.0 + k / q + k * k;
+        m_highPass.b0 = 1.0;
+        m_highPass.b1 = -2.0;
+        m_highPass.b2 = 1.0;
+        m_highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+        m_highPass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    // LFE is not measured; surround channels are weighted +1.5 dB
+    for (int c = 0; c < kMaxChannels; c++) {
+        m_weight[c] = 1.0;
+    }
+    if (channels >= 6) {
+        m_weight[3] = 0.0;
+        for (int c = 4; c < channels; c++) {
+            m_weight[c] = 1.41;
+        }
+    }
+
+    reset();
+    return true;
+}
+
+void LoudnessMeter::setChannelWeight(int channel, double weight)
+{
+    if (channel >= 0 && channel < kMaxChannels) {
+        m_weight[channel] = weight;
+    }
+}
+
+void LoudnessMeter::reset()
+{
+    for (auto& state : m_state) {
+        std::fill(std::begin(state), std::end(state), 0.0);
+    }
+    std::fill(std::begin(m_subBlockEnergy), std::end(m_subBlockEnergy), 0.0);
+    m_subBlockIndex = 0;
+    m_subBlocksSeen = 0;
+    m_framesInSubBlock = 0;
+    m_energyAccumulator = 0.0;
+    m_momentaryBlocks.clear();
+    m_shortTermBlocks.clear();
+    m_snapshot = Snapshot();
+}
+
+void LoudnessMeter::process(const float* interleaved, int frames)
+{
+    if (m_channels == 0) {
+        return;
+    }
+
+    const Biquad s = m_shelf;
+    const Biquad h = m_highPass;
+
+    while (frames > 0) {
+        const int n = std::min(frames, m_subBlockFrames - m_framesInSubBlock);
+
+        for (int c = 0; c < m_channels; c++) {
+            if (m_weight[c] == 0.0) {
+                continue;
+            }
+
+            // Both K-weighting stages in transposed direct form II
+            double s1 = m_state[c][0], s2 = m_state[c][1];
+            double h1 = m_state[c][2], h2 = m_state[c][3];
+            double sum = 0.0;
+            const float* in = interleaved + c;
+            for (int i = 0; i < n; i++, in += m_channels) {
+                const double x = *in;
+                const double y = s.b0 * x + s1;
+                s1 = s.b1 * x - s.a1 * y + s2;
+                s2 = s.b2 * x - s.a2 * y;
+                const double z = h.b0 * y + h1;
+                h1 = h.b1 * y - h.a1 * z + h2;
+                h2 = h.b2 * y - h.a2 * z;
+                sum += z * z;
+            }
+            m_state[c][0] = flushDenormal(s1);
+            m_state[c][1] = flushDenormal(s2);
+            m_state[c][2] = flushDenormal(h1);
+            m_state[c][3] = flushDenormal(h2);
+            m_energyAccumulator += m_weight[c] * sum;
+        }
+
+        interleaved += static_cast<size_t>(n) * m_channels;
+        frames -= n;
+        m_framesInSubBlock += n;
+        if (m_framesInSubBlock == m_subBlockFrames) {
+            finishSubBlock();
+        }
+    }
+}
+
+void LoudnessMeter::finishSubBlock()
+{
+    m_subBlockEnergy[m_subBlockIndex] = m_energyAccumulator / m_subBlockFrames;
+    m_subBlockIndex = (m_subBlockIndex + 1) % kSubBlocks;
+    m_subBlocksSeen++;
+    m_framesInSubBlock = 0;
+    m_energyAccumulator = 0.0;
+
+    // Mean energy of the newest count sub-blocks
+    auto windowEnergy = [this](int count) {
+        double sum = 0.0;
+        for (int i = 1; i <= count; i++) {
+            sum += m_subBlockEnergy[(m_subBlockIndex - i + kSubBlocks) % kSubBlocks];
+        }
+        return sum / count;
+    };
+
+    // Momentary blocks overlap by 75% and feed integrated loudness
+    if (m_subBlocksSeen >= kMomentarySubBlocks) {
+        const double energy = windowEnergy(kMomentarySubBlocks);
+        m_snapshot.momentary = energyToLoudness(energy);
+        m_momentaryBlocks.add(energy);
+        m_snapshot.integrated = m_momentaryBlocks.gatedLoudness(kIntegratedGate);
+    }
+
+    if (m_subBlocksSeen >= kSubBlocks) {
+        const double energy = windowEnergy(kSubBlocks);
+        m_snapshot.shortTerm = energyToLoudness(energy);
+        if ((m_subBlocksSeen - kSubBlocks) % kShortTermHop == 0) {
+            m_shortTermBlocks.add(energy);
+            m_snapshot.range = m_shortTermBlocks.range(kRangeGate, kRangeLow, kRangeHigh);
+        }
+    }
+}
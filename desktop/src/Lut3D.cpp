@@ -0,0 +1,332 @@
+#include "incl/Lut3D.h"
+#include "incl/Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace {
+    constexpr int kMinSize = 2;
+    constexpr int kMaxSize = 256;
+
+    void setError(std::string* error, const std::string& message)
+    {
+        if (error) {
+            *error = message;
+        }
+    }
+
+    // Offsets (in entries) of the two inner corners of the tetrahedron containing
+    // (fr, fg, fb), and the weights of c000, those two corners and c111
+    template <typename T>
+    inline void selectTetrahedron(T fr, T fg, T fb, int dr, int dg, int db, int offset[2], T weight[4])
+    {
+        if (fr > fg) {
+            if (fg > fb) {
+                offset[0] = dr; offset[1] = dr + dg;
+                weight[0] = 1 - fr; weight[1] = fr - fg; weight[2] = fg - fb; weight[3] = fb;
+            }
+            else if (fr > fb) {
+                offset[0] = dr; offset[1] = dr + db;
+                weight[0] = 1 - fr; weight[1] = fr - fb; weight[2] = fb - fg; weight[3] = fg;
+            }
+            else {
+                offset[0] = db; offset[1] = dr + db;
+                weight[0] = 1 - fb; weight[1] = fb - fr; weight[2] = fr - fg; weight[3] = fg;
+            }
+        }
+        else {
+            if (fb > fg) {
+                offset[0] = db; offset[1] = dg + db;
+                weight[0] = 1 - fb; weight[1] = fb - fg; weight[2] = fg - fr; weight[3] = fr;
+            }
+            else if (fb > fr) {
+                offset[0] = dg; offset[1] = dg + db;
+                weight[0] = 1 - fg; weight[1] = fg - fb; weight[2] = fb - fr; weight[3] = fr;
+            }
+            else {
+                offset[0] = dg; offset[1] = dr + dg;
+                weight[0] = 1 - fg; weight[1] = fg - fr; weight[2] = fr - fb; weight[3] = fb;
+            }
+        }
+    }
+
+    inline uint8_t toByte(float v)
+    {
+        v = std::min(std::max(v, 0.0f), 1.0f);
+        return static_cast<uint8_t>(v * 255.0f + 0.5f);
+    }
+}
+
+const std::string& Lut3D::title() const
+{
+    static const std::string empty;
+    return m_data ? m_data->title : empty;
+}
+
+bool Lut3D::loadCube(const std::string& path, std::string* error)
+{
+    std::ifstream file(path);
+    if (!file) {
+        setError(error, "Cannot open " + path);
+        return false;
+    }
+    return parseCube(file, error);
+}
+
+bool Lut3D::parseCube(std::istream& in, std::string* error)
+{
+    auto data = std::make_shared<Data>();
+    std::string line;
+    int lineNumber = 0;
+    size_t entries = 0;
+    size_t expected = 0;
+
+    while (std::getline(in, line)) {
+        lineNumber++;
+
+        // Strip comments and surrounding whitespace
+        const size_t hash = line.find('#');
+        if (hash != std::string::npos) {
+            line.erase(hash);
+        }
+        const size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos) {
+            continue;
+        }
+
+        std::istringstream tokens(line.substr(begin));
+        const char first = line[begin];
+
+        if ((first >= '0' && first <= '9') || first == '-' || first == '+' || first == '.') {
+            if (data->size == 0) {
+                setError(error, "Table data before LUT_3D_SIZE at line " + std::to_string(lineNumber));
+                return false;
+            }
+            float r, g, b;
+            if (!(tokens >> r >> g >> b)) {
+                setError(error, "Malformed table entry at line " + std::to_string(lineNumber));
+                return false;
+            }
+            if (entries >= expected) {
+                setError(error, "Too many table entries at line " + std::to_string(lineNumber));
+                return false;
+            }
+            float* entry = &data->table[entries * 4];
+            entry[0] = r;
+            entry[1] = g;
+            entry[2] = b;
+            entry[3] = 0.0f;
+            entries++;
+            continue;
+        }
+
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "TITLE") {
+            const size_t open = line.find('"');
+            const size_t close = line.rfind('"');
+            if (open != std::string::npos && close > open) {
+                data->title = line.substr(open + 1, close - open - 1);
+            }
+        }
+        else if (keyword == "LUT_3D_SIZE") {
+            int size = 0;
+            if (!(tokens >> size) || size < kMinSize || size > kMaxSize) {
+                setError(error, "Invalid LUT_3D_SIZE at line " + std::to_string(lineNumber));
+                return false;
+            }
+            data->size = size;
+            expected = static_cast<size_t>(size) * size * size;
+            data->table.assign(expected * 4, 0.0f);
+        }
+        else if (keyword == "DOMAIN_MIN") {
+            if (!(tokens >> data->domainMin[0] >> data->domainMin[1] >> data->domainMin[2])) {
+                setError(error, "Invalid DOMAIN_MIN at line " + std::to_string(lineNumber));
+                return false;
+            }
+        }
+        else if (keyword == "DOMAIN_MAX") {
+            if (!(tokens >> data->domainMax[0] >> data->domainMax[1] >> data->domainMax[2])) {
+                setError(error, "Invalid DOMAIN_MAX at line " + std::to_string(lineNumber));
+                return false;
+            }
+        }
+        else if (keyword == "LUT_1D_SIZE") {
+            setError(error, "1D .cube LUTs are not supported");
+            return false;
+        }
+        // Unknown keywords (e.g. LUT_IN_VIDEO_RANGE) are ignored like other tools do
+    }
+
+    if (data->size == 0 || entries != expected) {
+        setError(error, "Expected " + std::to_string(expected) + " table entries, found " + std::to_string(entries));
+        return false;
+    }
+
+    for (int c = 0; c < 3; c++) {
+        if (!(data->domainMax[c] > data->domainMin[c])) {
+            setError(error, "DOMAIN_MAX must be greater than DOMAIN_MIN");
+            return false;
+        }
+    }
+
+    buildInputTables(*data);
+    m_data = data;
+    return true;
+}
+
+Lut3D Lut3D::identity(int size)
+{
+    size = std::clamp(size, kMinSize, kMaxSize);
+
+    auto data = std::make_shared<Data>();
+    data->size = size;
+    data->title = "Identity";
+    data->table.resize(static_cast<size_t>(size) * size * size * 4);
+
+    float* entry = data->table.data();
+    for (int b = 0; b < size; b++) {
+        for (int g = 0; g < size; g++) {
+            for (int r = 0; r < size; r++) {
+                entry[0] = static_cast<float>(r) / (size - 1);
+                entry[1] = static_cast<float>(g) / (size - 1);
+                entry[2] = static_cast<float>(b) / (size - 1);
+                entry[3] = 0.0f;
+                entry += 4;
+            }
+        }
+    }
+
+    buildInputTables(*data);
+    Lut3D lut;
+    lut.m_data = data;
+    return lut;
+}
+
+void Lut3D::buildInputTables(Data& data)
+{
+    const int last = data.size - 1;
+    for (int c = 0; c < 3; c++) {
+        const double range = data.domainMax[c] - data.domainMin[c];
+        for (int v = 0; v < 256; v++) {
+            double pos = (v / 255.0 - data.domainMin[c]) / range * last;
+            pos = std::clamp(pos, 0.0, static_cast<double>(last));
+            const int cell = std::min(static_cast<int>(pos), last - 1);
+            data.cell[c][v] = static_cast<uint16_t>(cell);
+            data.frac[c][v] = static_cast<float>(pos - cell);
+        }
+    }
+}
+
+void Lut3D::lookup(double r, double g, double b, double out[3]) const
+{
+    const Data& data = *m_data;
+    const int n = data.size;
+    const int last = n - 1;
+    const double in[3] = { r, g, b };
+    int cell[3];
+    double frac[3];
+
+    for (int c = 0; c < 3; c++) {
+        double pos = (in[c] - data.domainMin[c]) / (data.domainMax[c] - data.domainMin[c]) * last;
+        pos = std::clamp(pos, 0.0, static_cast<double>(last));
+        cell[c] = std::min(static_cast<int>(pos), last - 1);
+        frac[c] = pos - cell[c];
+    }
+
+    const int base = (cell[2] * n + cell[1]) * n + cell[0];
+    int offset[2];
+    double weight[4];
+    selectTetrahedron(frac[0], frac[1], frac[2], 1, n, n * n, offset, weight);
+
+    const float* c000 = &data.table[static_cast<size_t>(base) * 4];
+    const float* c1 = c000 + offset[0] * 4;
+    const float* c2 = c000 + offset[1] * 4;
+    const float* c111 = c000 + (1 + n + n * n) * 4;
+    for (int c = 0; c < 3; c++) {
+        out[c] = weight[0] * c000[c] + weight[1] * c1[c] + weight[2] * c2[c] + weight[3] * c111[c];
+    }
+}
+
+void Lut3D::apply(uint8_t* bgra, int count) const
+{
+    if (!m_data) {
+        return;
+    }
+
+    const Data& data = *m_data;
+    const int n = data.size;
+    const int dg = n;
+    const int db = n * n;
+    const int far = 1 + dg + db;
+    const float* table = data.table.data();
+
+#ifdef OBS_HAVE_SSE2
+    const bool sse2 = useSse2();
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+#endif
+
+    // Desktop content has long runs of one color, so remember the last result
+    uint32_t lastIn = 0xFFFFFFFFu;
+    uint8_t lastOut[3] = { 0, 0, 0 };
+
+    for (int i = 0; i < count; i++, bgra += 4) {
+        const int b = bgra[0];
+        const int g = bgra[1];
+        const int r = bgra[2];
+
+        const uint32_t key = static_cast<uint32_t>(b | (g << 8) | (r << 16));
+        if (key == lastIn) {
+            bgra[0] = lastOut[0];
+            bgra[1] = lastOut[1];
+            bgra[2] = lastOut[2];
+            continue;
+        }
+        lastIn = key;
+
+        const int base = (data.cell[2][b] * n + data.cell[1][g]) * n + data.cell[0][r];
+        int offset[2];
+        float weight[4];
+        selectTetrahedron(data.frac[0][r], data.frac[1][g], data.frac[2][b], 1, dg, db, offset, weight);
+
+        const float* c000 = table + static_cast<size_t>(base) * 4;
+
+#ifdef OBS_HAVE_SSE2
+        if (sse2) {
+            // All three channels of a corner in one vector
+            __m128 out = _mm_mul_ps(_mm_loadu_ps(c000), _mm_set1_ps(weight[0]));
+            out = _mm_add_ps(out, _mm_mul_ps(_mm_loadu_ps(c000 + offset[0] * 4), _mm_set1_ps(weight[1])));
+            out = _mm_add_ps(out, _mm_mul_ps(_mm_loadu_ps(c000 + offset[1] * 4), _mm_set1_ps(weight[2])));
+            out = _mm_add_ps(out, _mm_mul_ps(_mm_loadu_ps(c000 + far * 4), _mm_set1_ps(weight[3])));
+            out = _mm_min_ps(_mm_max_ps(out, zero), one);
+
+            __m128i v = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(out, scale), half));
+            alignas(16) int32_t rgb[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(rgb), v);
+            bgra[0] = static_cast<uint8_t>(rgb[2]);
+            bgra[1] = static_cast<uint8_t>(rgb[1]);
+            bgra[2] = static_cast<uint8_t>(rgb[0]);
+        }
+        else
+#endif
+        {
+            const float* c1 = c000 + offset[0] * 4;
+            const float* c2 = c000 + offset[1] * 4;
+            const float* c111 = c000 + far * 4;
+            float out[3];
+            for (int c = 0; c < 3; c++) {
+                out[c] = weight[0] * c000[c] + weight[1] * c1[c] + weight[2] * c2[c] + weight[3] * c111[c];
+            }
+            bgra[0] = toByte(out[2]);
+            bgra[1] = toByte(out[1]);
+            bgra[2] = toByte(out[0]);
+        }
+        lastOut[0] = bgra[0];
+        lastOut[1] = bgra[1];
+        lastOut[2] = bgra[2];
+    }
+}
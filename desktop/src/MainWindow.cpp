@@ -1,30 +1,111 @@
 #include "incl/MainWindow.h"
+#include "incl/ThreadPool.h"
+#include "incl/Tracer.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QDebug>
 #include <QScreen>
+#include <QStatusBar>
+#include <QDir>
+#include <QStandardPaths>
+#include <chrono>
 
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent)
 {
+    Tracer::instance().setThreadName("GUI");
     setupUi();
 
-    // Initialize screen capture
-    if (!m_screenCapture.initialize()) {
-        qDebug() << "Failed to initialize screen capture";
-        return;
+    // Up before capture so a box whose capture fails to start still reports it
+    m_metrics = MetricsRegistry::instance().add([this](MetricsWriter& writer) { collectMetrics(writer); });
+    if (!m_metricsServer.start(kMetricsPort)) {
+        qDebug() << "Metrics endpoint unavailable:" << QString::fromStdString(m_metricsServer.lastError());
     }
 
-    // Initialize audio capture
-    if (!m_audioCapture.initializeInput() ||
-        !m_audioCapture.initializeOutput()) {
-        qDebug() << "Failed to initialize audio capture";
-        return;
+    // D3D device and duplication, and each WASAPI device, on their own threads: the
+    // window shows now and every source is filled in once its backend is up. One that
+    // fails no longer keeps the others from starting.
+    auto onGuiThread = [this](const StartupSequencer::Phase& phase) {
+        QMetaObject::invokeMethod(this, [this, phase] { onStartupPhase(phase); }, Qt::QueuedConnection);
+    };
+    m_startup.add("screen capture", [this](std::string& error) {
+        if (!m_screenCapture.initialize()) {
+            error = "DXGI desktop duplication unavailable";
+            return false;
+        }
+        return true;
+    }, onGuiThread);
+    m_startup.add("mic", [this](std::string& error) {
+        if (!m_audioCapture.initializeInput()) {
+            error = "input device unavailable";
+            return false;
+        }
+        return true;
+    }, onGuiThread);
+    m_startup.add("desktop audio", [this](std::string& error) {
+        if (!m_audioCapture.initializeOutput()) {
+            error = "output device unavailable";
+            return false;
+        }
+        return true;
+    }, onGuiThread);
+    m_startupPending = static_cast<int>(m_startup.phases().size());
+    statusBar()->showMessage("Starting screen capture and audio devices...");
+    m_startup.start();
+
+    // Make audio updates more frequent than screen updates for responsiveness
+    // Using a much shorter interval for audio capturing; silent until the devices are up
+    connect(&m_volumeTimer, &QTimer::timeout, this, &MainWindow::updateAudioVolume);
+    m_volumeTimer.start(10); // 10ms intervals = ~100 updates per second
+
+    // Enable Qt's high DPI scaling
+    setWindowFlag(Qt::Window);
+}
+
+MainWindow::~MainWindow()
+{
+    // A device still starting has to finish before anything is torn down
+    m_startup.wait();
+    m_captureTimer.stop();
+    m_volumeTimer.stop();
+    m_audioCapture.stopCapture();
+}
+
+void MainWindow::onStartupPhase(const StartupSequencer::Phase& phase)
+{
+    qDebug().noquote() << QString("Startup: %1 %2 after %3 ms").arg(QString::fromStdString(phase.name),
+        phase.ok ? "ready" : "failed (" + QString::fromStdString(phase.error) + ")",
+        QString::number(phase.durationMicros / 1000.0, 'f', 1));
+    if (!phase.ok) {
+        m_startupFailures << QString::fromStdString(phase.name);
     }
 
-    // Start audio capture
-    m_audioCapture.startCapture();
+    if (phase.name == "screen capture") {
+        if (phase.ok) {
+            startScreenCapture();
+        }
+    }
+    else {
+        // Audio starts once both devices have settled, with whichever came up
+        m_audioDevicesUp += phase.ok ? 1 : 0;
+        if (--m_audioDevicesPending == 0) {
+            startAudioCapture();
+        }
+    }
 
+    if (--m_startupPending == 0) {
+        qDebug().noquote() << "Startup phases:\n" + QString::fromStdString(m_startup.report());
+        if (m_startupFailures.isEmpty()) {
+            statusBar()->showMessage(QString("Ready in %1 ms").arg(m_startup.elapsedMicros() / 1000.0, 0, 'f', 0), 5000);
+        }
+        else {
+            statusBar()->showMessage("Unavailable: " + m_startupFailures.join(", "));
+        }
+    }
+}
+
+void MainWindow::startScreenCapture()
+{
     // Get the refresh rate of the primary screen
     QScreen* primaryScreen = QGuiApplication::primaryScreen();
     int refreshRate = primaryScreen->refreshRate();
@@ -44,22 +125,21 @@ MainWindow::MainWindow(QWidget* parent)
     // Set up timers with refresh rate matching
     connect(&m_captureTimer, &QTimer::timeout, this, &MainWindow::updateScreenCapture);
     m_captureTimer.start(captureInterval);
-
-
-    // Make audio updates more frequent than screen updates for responsiveness
-    // Using a much shorter interval for audio capturing
-    connect(&m_volumeTimer, &QTimer::timeout, this, &MainWindow::updateAudioVolume);
-    m_volumeTimer.start(10); // 10ms intervals = ~100 updates per second
-
-    // Enable Qt's high DPI scaling
-    setWindowFlag(Qt::Window);
 }
 
-MainWindow::~MainWindow()
+void MainWindow::startAudioCapture()
 {
-    m_captureTimer.stop();
-    m_volumeTimer.stop();
-    m_audioCapture.stopCapture();
+    if (m_audioDevicesUp == 0) {
+        qDebug() << "Failed to initialize audio capture";
+        return;
+    }
+
+    // Start audio capture
+    m_audioCapture.startCapture();
+
+    // Both devices are written by now, so the widgets may read them
+    m_outputSpectrum->setAnalyzer(&m_audioCapture.getOutputSpectrum());
+    m_recordAudioButton->setEnabled(m_audioDevicesUp == 2);
 }
 
 void MainWindow::setupUi()
@@ -71,29 +151,35 @@ void MainWindow::setupUi()
     QWidget* centralWidget = new QWidget(this);
     QVBoxLayout* mainLayout = new QVBoxLayout(centralWidget);
 
-    // Create display label
-    m_displayLabel = new QLabel(this);
-    m_displayLabel->setMinimumSize(640, 480);
-    m_displayLabel->setAlignment(Qt::AlignCenter);
-    m_displayLabel->setScaledContents(false);
+    // Create preview
+    m_preview = new PreviewWidget(this);
 
     // Add FPS and latency indicators
     QHBoxLayout* statsLayout = new QHBoxLayout();
     m_fpsLabel = new QLabel("FPS: --", this);
     m_latencyLabel = new QLabel("Update Latency: -- ms", this);
     statsLayout->addWidget(m_fpsLabel);
+    m_previewStatsLabel = new QLabel("Preview: -- presented, -- skipped", this);
     statsLayout->addWidget(m_latencyLabel);
+    statsLayout->addWidget(m_previewStatsLabel);
     statsLayout->addStretch();
+    m_recordAudioButton = new QPushButton("Record Audio", this);
+    m_recordAudioButton->setEnabled(false); // until both audio devices are up
+    connect(m_recordAudioButton, &QPushButton::clicked, this, &MainWindow::toggleAudioRecording);
+    statsLayout->addWidget(m_recordAudioButton);
+    m_traceButton = new QPushButton("Record Trace", this);
+    connect(m_traceButton, &QPushButton::clicked, this, &MainWindow::toggleTracing);
+    statsLayout->addWidget(m_traceButton);
 
     // Add widgets to layout
-    mainLayout->addWidget(m_displayLabel);
+    mainLayout->addWidget(m_preview);
     mainLayout->addLayout(statsLayout);
 
     setCentralWidget(centralWidget);
 
     // Store display dimensions
-    m_displayWidth = m_displayLabel->width();
-    m_displayHeight = m_displayLabel->height();
+    m_displayWidth = m_preview->width();
+    m_displayHeight = m_preview->height();
 
     // Initialize frame timing variables
     m_lastFrameTime = QDateTime::currentMSecsSinceEpoch();
@@ -123,38 +209,113 @@ void MainWindow::setupUi()
 
     // Add meters with dB labels
     mainLayout->addLayout(volumeMeterLayout);
+
+    // Desktop audio spectrum under the meters
+    m_outputSpectrum = new SpectrumWidget(this, "Desktop Audio Spectrum");
+    mainLayout->addWidget(m_outputSpectrum);
 }
 
 void MainWindow::updateScreenCapture()
 {
+    TraceScope trace("capture tick");
+
+    // Lost (desktop switch, UAC prompt): the preview holds the last frame while the
+    // duplication comes back in the background, and the tick stays cheap meanwhile
+    if (m_screenRecovery.isRecovering()) {
+        const int64_t outageMs = m_screenRecovery.currentOutageMicros() / 1000;
+        if (!m_screenRecovery.poll()) {
+            return;
+        }
+        statusBar()->showMessage(QString("Screen capture back after %1 ms").arg(outageMs), 5000);
+    }
+
     // Time the capture operation
     qint64 startTime = QDateTime::currentMSecsSinceEpoch();
 
+    using Clock = std::chrono::steady_clock;
+    auto micros = [](Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(b - a).count();
+    };
+    const Clock::time_point captureStart = Clock::now();
+
     if (m_screenCapture.captureFrame()) {
-        QImage frame = m_screenCapture.getLatestFrame();
-
-        // Only scale if necessary (avoid unnecessary operations)
-        QSize targetSize = m_displayLabel->size();
-        if (frame.size() != targetSize) {
-            // Use fast transformation for real-time display
-            QImage scaledFrame = frame.scaled(
-                targetSize,
-                Qt::KeepAspectRatio,
-                Qt::FastTransformation
-            );
-            m_displayLabel->setPixmap(QPixmap::fromImage(scaledFrame));
+        // Nothing on screen changed (e.g. the cursor moved within a static image)
+        m_screenCapture.getLatestChanges(m_changes);
+        const ChangeMap& changes = m_changes;
+        if (changes.isDuplicate()) {
+            m_duplicateFrames.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        const Clock::time_point composeStart = Clock::now();
+
+        QImage capture = m_screenCapture.getLatestFrame();
+
+        // Display capture is the bottom layer and fills the canvas
+        SceneLayer captureLayer;
+        captureLayer.source = FrameView(const_cast<uchar*>(capture.constBits()),
+            capture.width(), capture.height(), static_cast<int>(capture.bytesPerLine()));
+        captureLayer.opaque = true;
+        captureLayer.dest = SceneRect{ 0, 0, capture.width(), capture.height() };
+
+        m_scene.setCanvasSize(capture.width(), capture.height());
+        if (m_captureLayerId == 0) {
+            m_captureLayerId = m_scene.addLayer(captureLayer);
         }
         else {
-            m_displayLabel->setPixmap(QPixmap::fromImage(frame));
+            m_scene.setLayer(m_captureLayerId, captureLayer);
+
+            // Only redraw the tiles the capture reported as changed
+            for (int ty = 0; ty < changes.tilesY; ty++) {
+                if (!changes.rowChanged[ty]) {
+                    continue;
+                }
+                for (int tx = 0; tx < changes.tilesX; tx++) {
+                    if (changes.isChanged(tx, ty)) {
+                        m_scene.markContentChanged(m_captureLayerId, SceneRect{
+                            tx * changes.tileSize, ty * changes.tileSize, changes.tileSize, changes.tileSize });
+                    }
+                }
+            }
         }
+        m_scene.compose(&ThreadPool::instance());
+        const Clock::time_point previewStart = Clock::now();
+
+        // Scale to the preview and convert to RGB32 in one pass over the canvas
+        FrameView canvas = m_scene.canvas();
+        QSize targetSize = m_preview->fitSize(QSize(canvas.width, canvas.height));
+        if (targetSize.isEmpty()) {
+            return;
+        }
+
+        FrameView preview = m_preview->frameBuffer(targetSize);
+        {
+            TraceScope scaleTrace("preview scale");
+            m_previewChain.process(canvas, preview, &ThreadPool::instance());
+        }
+
+        m_preview->present();
+        m_droppedFrames.store(m_preview->skippedFrames(), std::memory_order_relaxed);
+
+        const Clock::time_point end = Clock::now();
+        m_captureLatency.record(micros(captureStart, composeStart));
+        m_composeLatency.record(micros(composeStart, previewStart));
+        m_previewLatency.record(micros(previewStart, end));
+        m_frameLatency.record(micros(captureStart, end));
 
         // Track frame timing for FPS calculation
         m_frameCount++;
         qint64 now = QDateTime::currentMSecsSinceEpoch();
-        qint64 frameDuration = now - startTime;
-
-        // Update latency display (for screen capture operation)
-        m_latencyLabel->setText(QString("Update Latency: %1 ms").arg(frameDuration));
+        m_latencySum += now - startTime;
+    }
+    else if (m_screenCapture.isLost()) {
+        m_screenRecovery.reportLost([this](std::string& error) {
+            if (!m_screenCapture.initialize()) {
+                error = "desktop duplication not available yet";
+                return false;
+            }
+            return true;
+        }, "desktop duplication access lost");
+        statusBar()->showMessage("Screen capture lost, reconnecting...");
     }
 }
 
@@ -165,17 +326,103 @@ void MainWindow::updateAudioVolume()
 
     if (m_inputMeter) {
         m_inputMeter->setLevel(inputLevel);
-        if (m_inputDbLabel)
-            m_inputDbLabel->setText(QString::number(inputLevel, 'f', 1) + " dB");
+        LoudnessMeter::Snapshot loudness = m_audioCapture.getInputLoudness();
+        m_inputMeter->setLoudness(loudness.momentary, loudness.integrated);
     }
-
     if (m_outputMeter) {
         m_outputMeter->setLevel(outputLevel);
-        if (m_outputDbLabel)
-            m_outputDbLabel->setText(QString::number(outputLevel, 'f', 1) + " dB");
+        LoudnessMeter::Snapshot loudness = m_audioCapture.getOutputLoudness();
+        m_outputMeter->setLoudness(loudness.momentary, loudness.integrated);
+    }
+
+    // Numbers are unreadable at 100 Hz anyway; refresh them at 10 Hz
+    if (++m_volumeTicks % 10 == 0) {
+        setDbLabel(m_inputDbLabel, inputLevel);
+        setDbLabel(m_outputDbLabel, outputLevel);
     }
 }
 
+void MainWindow::collectMetrics(MetricsWriter& writer) const
+{
+    // Scrape thread: atomics and histograms only, nothing the GUI thread locks
+    writer.counter("obs_frames_captured_total", "Frames captured from the display.",
+        static_cast<double>(m_screenCapture.framesCaptured()));
+    writer.counter("obs_frames_duplicate_total", "Captured frames identical to the previous one, skipped.",
+        static_cast<double>(m_duplicateFrames.load(std::memory_order_relaxed)));
+    writer.counter("obs_frames_dropped_total", "Frames processed but never shown or written.",
+        static_cast<double>(m_droppedFrames.load(std::memory_order_relaxed)));
+    writer.counter("obs_capture_accumulated_misses_total", "Desktop updates merged into a later frame because capture polled late.",
+        static_cast<double>(m_screenCapture.accumulatedMisses()));
+    writer.counter("obs_capture_errors_total", "Capture attempts that failed.",
+        static_cast<double>(m_screenCapture.captureErrors()));
+
+    const char* help = "Time spent per frame in each pipeline stage.";
+    writer.summary("obs_stage_latency_seconds", help, m_captureLatency, "stage=\"capture\"");
+    writer.summary("obs_stage_latency_seconds", help, m_composeLatency, "stage=\"compose\"");
+    writer.summary("obs_stage_latency_seconds", help, m_previewLatency, "stage=\"preview\"");
+    writer.summary("obs_stage_latency_seconds", help, m_frameLatency, "stage=\"total\"");
+
+    writer.counter("obs_device_losses_total", "Times a capture device went away and recovery started.",
+        static_cast<double>(m_screenRecovery.losses()), "device=\"screen\"");
+
+    // Copied out under the sequencer's own brief lock
+    m_startup.collectMetrics(writer);
+}
+
+void MainWindow::setDbLabel(QLabel* label, float dbLevel)
+{
+    if (!label)
+        return;
+
+    // setText relayouts the label, so skip it when the text is unchanged
+    QString text = QString::number(dbLevel, 'f', 1) + " dB";
+    if (label->text() != text)
+        label->setText(text);
+}
+
+void MainWindow::toggleAudioRecording()
+{
+    if (m_audioCapture.isRecording()) {
+        m_audioCapture.stopRecording();
+        m_recordAudioButton->setText("Record Audio");
+        return;
+    }
+
+    // One lossless track per source, next to each other in the music folder
+    QDir folder(QStandardPaths::writableLocation(QStandardPaths::MusicLocation));
+    QString stamp = QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss");
+    QString micPath = folder.filePath(QString("obs-%1-mic.flac").arg(stamp));
+    QString desktopPath = folder.filePath(QString("obs-%1-desktop.flac").arg(stamp));
+
+    if (m_audioCapture.startRecording(micPath.toStdWString(), desktopPath.toStdWString())) {
+        m_recordAudioButton->setText("Stop Recording");
+    }
+}
+
+void MainWindow::toggleTracing()
+{
+    Tracer& tracer = Tracer::instance();
+    if (!Tracer::enabled()) {
+        tracer.clear();
+        tracer.setEnabled(true);
+        m_traceButton->setText("Save Trace");
+        return;
+    }
+
+    // Open in ui.perfetto.dev or chrome://tracing
+    tracer.setEnabled(false);
+    QDir folder(QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation));
+    QString stamp = QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss");
+    QString path = folder.filePath(QString("obs-trace-%1.json").arg(stamp));
+    if (tracer.writeJson(path.toStdWString())) {
+        qDebug() << "Trace written to" << path;
+    }
+    else {
+        qDebug() << "Failed to write trace" << path;
+    }
+    m_traceButton->setText("Record Trace");
+}
+
 void MainWindow::updateFPS()
 {
     // Calculate and display current FPS
@@ -187,6 +434,20 @@ void MainWindow::updateFPS()
         m_fpsLabel->setText(QString("FPS: %1").arg(fps, 0, 'f', 1));
     }
 
+    // Average capture-to-preview latency; setText every frame would relayout every frame
+    if (m_frameCount > 0) {
+        m_latencyLabel->setText(QString("Update Latency: %1 ms").arg(m_latencySum / m_frameCount));
+    }
+
     m_frameCount = 0;
+    m_latencySum = 0;
     m_lastFrameTime = now;
+
+    // Preview frames painted vs. replaced before the next refresh
+    quint64 presented = m_preview->presentedFrames();
+    quint64 skipped = m_preview->skippedFrames();
+    m_previewStatsLabel->setText(QString("Preview: %1 presented, %2 skipped")
+        .arg(presented - m_lastPresented).arg(skipped - m_lastSkipped));
+    m_lastPresented = presented;
+    m_lastSkipped = skipped;
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "incl/Metrics.h"
+#include "incl/BufferPool.h"
+#include "incl/LatencyHistogram.h"
+#include <algorithm>
+#include <cstdio>
+
+void MetricsWriter::family(const char* name, const char* help, const char* type)
+{
+    if (m_current < m_families.size() && std::strcmp(m_families[m_current].name, name) == 0) {
+        return;
+    }
+    for (size_t i = 0; i < m_families.size(); i++) {
+        if (std::strcmp(m_families[i].name, name) == 0) {
+            m_current = i;
+            return;
+        }
+    }
+    m_out += "# HELP ";
+    m_out += name;
+    m_out += ' ';
+    m_out += help;
+    m_out += "\n# TYPE ";
+    m_out += name;
+    m_out += ' ';
+    m_out += type;
+    m_out += '\n';
+    m_current = m_families.size();
+    m_families.push_back(Family{ name, m_out.size() });
+}
+
+void MetricsWriter::sample(const char* name, const char* suffix, const char* labels, const char* extraLabel, double value)
+{
+    const size_t at = m_families[m_current].end;
+    const size_t start = m_out.size();
+    m_out += name;
+    m_out += suffix;
+    const bool hasLabels = labels && *labels;
+    if (hasLabels || extraLabel) {
+        m_out += '{';
+        if (hasLabels) {
+            m_out += labels;
+        }
+        if (extraLabel) {
+            if (hasLabels) {
+                m_out += ',';
+            }
+            m_out += extraLabel;
+        }
+        m_out += '}';
+    }
+
+    // Counters and byte counts print as integers, the rest with enough digits to round-trip
+    char text[40];
+    if (value == static_cast<double>(static_cast<int64_t>(value))) {
+        std::snprintf(text, sizeof(text), " %lld\n", static_cast<long long>(value));
+    }
+    else {
+        std::snprintf(text, sizeof(text), " %.9g\n", value);
+    }
+    m_out += text;
+
+    // Written at the end; rotate it into place when later families follow this one
+    const size_t length = m_out.size() - start;
+    if (at < start) {
+        std::rotate(m_out.begin() + at, m_out.begin() + start, m_out.end());
+    }
+    for (Family& family : m_families) {
+        if (family.end >= at) {
+            family.end += length;
+        }
+    }
+}
+
+void MetricsWriter::counter(const char* name, const char* help, double value, const char* labels)
+{
+    family(name, help, "counter");
+    sample(name, "", labels, nullptr, value);
+}
+
+void MetricsWriter::gauge(const char* name, const char* help, double value, const char* labels)
+{
+    family(name, help, "gauge");
+    sample(name, "", labels, nullptr, value);
+}
+
+void MetricsWriter::summary(const char* name, const char* help, const LatencyHistogram& histogram, const char* labels)
+{
+    family(name, help, "summary");
+    sample(name, "", labels, "quantile=\"0.5\"", histogram.quantileMicros(0.5) / 1e6);
+    sample(name, "", labels, "quantile=\"0.9\"", histogram.quantileMicros(0.9) / 1e6);
+    sample(name, "", labels, "quantile=\"0.99\"", histogram.quantileMicros(0.99) / 1e6);
+    sample(name, "_sum", labels, nullptr, histogram.sumMicros() / 1e6);
+    sample(name, "_count", labels, nullptr, static_cast<double>(histogram.count()));
+}
+
+MetricsRegistration::MetricsRegistration(MetricsRegistration&& other) noexcept
+    : m_registry(other.m_registry), m_id(other.m_id)
+{
+    other.m_registry = nullptr;
+}
+
+MetricsRegistration& MetricsRegistration::operator=(MetricsRegistration&& other) noexcept
+{
+    if (this != &other) {
+        reset();
+        m_registry = other.m_registry;
+        m_id = other.m_id;
+        other.m_registry = nullptr;
+    }
+    return *this;
+}
+
+void MetricsRegistration::reset()
+{
+    if (m_registry) {
+        m_registry->remove(m_id);
+        m_registry = nullptr;
+    }
+}
+
+MetricsRegistry& MetricsRegistry::instance()
+{
+    // Never destroyed, so registrations in statics can still unregister at exit
+    static MetricsRegistry* registry = new MetricsRegistry();
+    return *registry;
+}
+
+MetricsRegistration MetricsRegistry::add(Collector collector)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const int id = m_nextId++;
+    m_collectors.emplace_back(id, std::move(collector));
+    return MetricsRegistration(this, id);
+}
+
+void MetricsRegistry::remove(int id)
+{
+    // Waits for a scrape in progress, which may be running this collector
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_collectors.begin(); it != m_collectors.end(); ++it) {
+        if (it->first == id) {
+            m_collectors.erase(it);
+            return;
+        }
+    }
+}
+
+void MetricsRegistry::scrape(std::string& out)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_families.clear();
+    MetricsWriter writer(out, m_families);
+
+    const BufferPool::Stats pool = BufferPool::instance().stats();
+    writer.gauge("obs_buffer_pool_allocated_bytes", "Bytes of every block the frame buffer pool owns, loaned or free.",
+        static_cast<double>(pool.allocatedBytes));
+    writer.gauge("obs_buffer_pool_cached_bytes", "Bytes of free blocks waiting on the pool's shared lists.",
+        static_cast<double>(pool.cachedBytes));
+    writer.counter("obs_buffer_pool_hits_total", "Pool acquires served from a free list.", static_cast<double>(pool.hits));
+    writer.counter("obs_buffer_pool_misses_total", "Pool acquires that had to allocate.", static_cast<double>(pool.misses));
+
+    for (const auto& collector : m_collectors) {
+        collector.second(writer);
+    }
+}
@@ -0,0 +1,197 @@
+#include "incl/MetricsServer.h"
+#include "incl/Metrics.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifdef _WIN32
+    using Socket = SOCKET;
+    constexpr Socket kInvalidSocket = INVALID_SOCKET;
+    void closeSocket(Socket s) { closesocket(s); }
+    constexpr int kSendFlags = 0;
+#else
+    using Socket = int;
+    constexpr Socket kInvalidSocket = -1;
+    void closeSocket(Socket s) { close(s); }
+    constexpr int kSendFlags = MSG_NOSIGNAL; // a client hanging up must not raise SIGPIPE
+#endif
+
+    // How often the accept loop checks for stop()
+    constexpr int kPollMs = 100;
+
+    // A client that stalls mid-request is dropped after this long
+    constexpr int kClientTimeoutMs = 1000;
+
+    Socket toSocket(intptr_t s) { return static_cast<Socket>(s); }
+
+    bool sendAll(Socket s, const char* data, size_t size)
+    {
+        while (size > 0) {
+            const int sent = send(s, data, static_cast<int>(size), kSendFlags);
+            if (sent <= 0) {
+                return false;
+            }
+            data += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    void setTimeouts(Socket s)
+    {
+#ifdef _WIN32
+        DWORD timeout = kClientTimeoutMs;
+#else
+        timeval timeout{ kClientTimeoutMs / 1000, (kClientTimeoutMs % 1000) * 1000 };
+#endif
+        setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+        setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    }
+}
+
+bool MetricsServer::start(int port)
+{
+    return start(port, MetricsRegistry::instance());
+}
+
+bool MetricsServer::start(int port, MetricsRegistry& registry)
+{
+    stop();
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        m_error = "WSAStartup failed";
+        return false;
+    }
+#endif
+
+    Socket s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == kInvalidSocket) {
+        m_error = "cannot create socket";
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+    // Loopback only: the endpoint has no authentication
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(s, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(s, 8) != 0) {
+        m_error = "cannot listen on 127.0.0.1:" + std::to_string(port);
+        closeSocket(s);
+        return false;
+    }
+
+    socklen_t length = sizeof(address);
+    getsockname(s, reinterpret_cast<sockaddr*>(&address), &length);
+    m_port = ntohs(address.sin_port);
+    m_listenSocket = static_cast<intptr_t>(s);
+    m_registry = &registry;
+    m_body.reserve(64 * 1024);
+    m_response.reserve(64 * 1024);
+    m_stopping.store(false, std::memory_order_relaxed);
+    m_thread = std::thread(&MetricsServer::run, this);
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_stopping.store(true, std::memory_order_relaxed);
+    m_thread.join();
+    closeSocket(toSocket(m_listenSocket));
+    m_listenSocket = -1;
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+void MetricsServer::run()
+{
+    const Socket listener = toSocket(m_listenSocket);
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listener, &readable);
+        timeval timeout{ 0, kPollMs * 1000 };
+        if (select(static_cast<int>(listener) + 1, &readable, nullptr, nullptr, &timeout) <= 0) {
+            continue;
+        }
+
+        const Socket client = accept(listener, nullptr, nullptr);
+        if (client == kInvalidSocket) {
+            continue;
+        }
+        setTimeouts(client);
+        serve(static_cast<intptr_t>(client));
+        closeSocket(client);
+    }
+}
+
+void MetricsServer::serve(intptr_t handle)
+{
+    const Socket client = toSocket(handle);
+
+    // Only the request line matters; read until the end of the headers
+    char request[2048];
+    size_t received = 0;
+    while (received < sizeof(request) - 1) {
+        const int n = recv(client, request + received, static_cast<int>(sizeof(request) - 1 - received), 0);
+        if (n <= 0) {
+            break;
+        }
+        received += n;
+        request[received] = '\0';
+        if (std::strstr(request, "\r\n\r\n") || std::strstr(request, "\n\n")) {
+            break;
+        }
+    }
+    request[received] = '\0';
+
+    const bool isGet = std::strncmp(request, "GET ", 4) == 0;
+    const bool isMetrics = isGet && (std::strncmp(request + 4, "/metrics ", 9) == 0 || std::strncmp(request + 4, "/metrics?", 9) == 0);
+
+    m_body.clear();
+    const char* status;
+    const char* contentType = "text/plain; charset=utf-8";
+    if (isMetrics) {
+        m_registry->scrape(m_body);
+        status = "200 OK";
+        contentType = "text/plain; version=0.0.4; charset=utf-8";
+    }
+    else if (isGet) {
+        m_body = "Metrics are at /metrics\n";
+        status = "404 Not Found";
+    }
+    else {
+        m_body = "Only GET is supported\n";
+        status = "405 Method Not Allowed";
+    }
+
+    char header[160];
+    const int headerSize = std::snprintf(header, sizeof(header),
+        "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+        status, contentType, m_body.size());
+    m_response.assign(header, headerSize);
+    m_response += m_body;
+    sendAll(client, m_response.data(), m_response.size());
+}
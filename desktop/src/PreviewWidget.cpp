@@ -0,0 +1,114 @@
+#include "incl/PreviewWidget.h"
+#include "incl/Tracer.h"
+#include <QPainter>
+#include <QPaintEvent>
+#include <QScreen>
+#include <QWindow>
+
+PreviewWidget::PreviewWidget(QWidget* parent)
+    : QWidget(parent)
+{
+    // Every pixel is painted below, so Qt can skip erasing the background
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setMinimumSize(640, 480);
+
+    m_refreshTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_refreshTimer, &QTimer::timeout, this, &PreviewWidget::onRefresh);
+    updateRefreshInterval();
+}
+
+QSize PreviewWidget::fitSize(const QSize& source) const
+{
+    return source.scaled(size(), Qt::KeepAspectRatio);
+}
+
+FrameView PreviewWidget::frameBuffer(const QSize& size)
+{
+    if (m_buffer.width() != size.width() || m_buffer.height() != size.height()) {
+        m_buffer.resize(size.width(), size.height());
+        FrameView view = m_buffer.view();
+        m_image = QImage(view.data, view.width, view.height, view.stride, QImage::Format_RGB32);
+    }
+    return m_buffer.view();
+}
+
+void PreviewWidget::present()
+{
+    if (m_pending) {
+        m_skipped++;
+    }
+    m_pending = true;
+
+    if (!m_refreshTimer.isActive()) {
+        m_refreshTimer.start();
+    }
+}
+
+void PreviewWidget::onRefresh()
+{
+    if (!m_pending) {
+        // Idle until the next present()
+        m_refreshTimer.stop();
+        return;
+    }
+    if (m_repaintQueued) {
+        return;
+    }
+    m_repaintQueued = true;
+
+    // Same placement as last time: only the image needs repainting
+    QRect imageRect(QPoint(0, 0), m_image.size());
+    imageRect.moveCenter(rect().center());
+    if (imageRect == m_imageRect) {
+        update(imageRect);
+    }
+    else {
+        update();
+    }
+}
+
+void PreviewWidget::paintEvent(QPaintEvent* event)
+{
+    TraceScope trace("preview paint");
+    QPainter painter(this);
+
+    QRect imageRect(QPoint(0, 0), m_image.size());
+    imageRect.moveCenter(rect().center());
+    m_imageRect = imageRect;
+
+    // Letterbox bars
+    const QRegion bars = event->region().subtracted(imageRect);
+    for (const QRect& r : bars) {
+        painter.fillRect(r, Qt::black);
+    }
+
+    if (!m_image.isNull()) {
+        painter.drawImage(imageRect.topLeft(), m_image);
+    }
+
+    if (m_pending) {
+        m_pending = false;
+        m_presented++;
+    }
+    m_repaintQueued = false;
+}
+
+void PreviewWidget::showEvent(QShowEvent* event)
+{
+    QWidget::showEvent(event);
+
+    if (QWindow* window = windowHandle()) {
+        connect(window, &QWindow::screenChanged, this, &PreviewWidget::updateRefreshInterval, Qt::UniqueConnection);
+    }
+    updateRefreshInterval();
+}
+
+void PreviewWidget::updateRefreshInterval()
+{
+    QScreen* current = screen();
+    qreal refreshRate = current ? current->refreshRate() : 0.0;
+    if (refreshRate < 30.0) {
+        refreshRate = 60.0;
+    }
+    m_refreshTimer.setInterval(qMax(1, qRound(1000.0 / refreshRate)));
+}
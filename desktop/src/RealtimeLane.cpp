@@ -0,0 +1,115 @@
+#include "incl/RealtimeLane.h"
+#include "incl/Tracer.h"
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <avrt.h>
+#pragma comment(lib, "avrt.lib")
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+bool RealtimeLane::start(std::function<void()> tick, const Settings& settings)
+{
+    stop();
+    if (!tick) {
+        return false;
+    }
+
+    m_settings = settings;
+    m_tick = std::move(tick);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = false;
+        m_woken = false;
+    }
+    m_thread = std::thread(&RealtimeLane::run, this);
+    return true;
+}
+
+void RealtimeLane::stop()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+    m_tick = nullptr;
+}
+
+void RealtimeLane::wake()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_woken = true;
+    }
+    m_wake.notify_one();
+}
+
+bool RealtimeLane::raisePriority()
+{
+#ifdef _WIN32
+    if (m_settings.core >= 0 && m_settings.core < 64) {
+        SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << m_settings.core);
+    }
+
+    // MMCSS boosts the thread into the real-time range while it is registered
+    DWORD taskIndex = 0;
+    if (AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex)) {
+        return true;
+    }
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != FALSE;
+#else
+#ifdef __linux__
+    if (m_settings.core >= 0 && m_settings.core < CPU_SETSIZE) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(m_settings.core, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+    pthread_setname_np(pthread_self(), m_settings.name.substr(0, 15).c_str());
+#endif
+    // Needs CAP_SYS_NICE or an rtprio limit; without it the lane stays a normal thread
+    sched_param param = {};
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#endif
+}
+
+void RealtimeLane::run()
+{
+    m_elevated.store(raisePriority(), std::memory_order_relaxed);
+    Tracer::instance().setThreadName(m_settings.name.c_str());
+
+    // Ticks are scheduled on a fixed grid so a slow tick doesn't push the later ones back
+    const auto period = std::chrono::milliseconds(m_settings.periodMs);
+    auto next = std::chrono::steady_clock::now();
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait_until(lock, next, [this] { return m_stopping || m_woken; });
+            if (m_stopping) {
+                return;
+            }
+            m_woken = false;
+        }
+
+        m_tick();
+
+        const auto now = std::chrono::steady_clock::now();
+        next += period;
+        if (next < now) {
+            m_overruns.fetch_add(1, std::memory_order_relaxed);
+            traceCounter("realtime lane overrun us",
+                std::chrono::duration_cast<std::chrono::microseconds>(now - next).count());
+            next = now + period; // fell behind; don't tick in a burst to catch up
+        }
+    }
+}
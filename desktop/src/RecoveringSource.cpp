@@ -0,0 +1,78 @@
+#include "incl/RecoveringSource.h"
+#include <chrono>
+#include <cstring>
+
+RecoveringSource::RecoveringSource(std::unique_ptr<VideoSource> inner, const DeviceRecovery::Settings& settings)
+    : m_inner(std::move(inner)), m_recovery(settings)
+{
+}
+
+RecoveringSource::~RecoveringSource()
+{
+    // Before the source an attempt may still be initializing goes away
+    m_recovery.stop();
+}
+
+bool RecoveringSource::initialize()
+{
+    if (!m_inner->initialize()) {
+        m_error = m_inner->lastError();
+        return false;
+    }
+    return true;
+}
+
+bool RecoveringSource::acquireFrame(SourceFrame& frame)
+{
+    if (m_recovery.isRecovering() && !m_recovery.poll()) {
+        return acquireHeld(frame);
+    }
+
+    if (m_inner->acquireFrame(frame)) {
+        m_last = frame.pixels;
+        // Sized while the device works, so the tick that sees the loss only copies
+        if (m_held.width() != m_last.width || m_held.height() != m_last.height) {
+            m_held.resize(m_last.width, m_last.height);
+        }
+        return true;
+    }
+    if (!m_inner->isLost()) {
+        m_error = m_inner->lastError();
+        return false;
+    }
+
+    // Keep the last frame before the reinit can touch it, then hand the device over
+    if (m_last.data) {
+        const FrameView held = m_held.view();
+        for (int y = 0; y < m_last.height; y++) {
+            std::memcpy(held.row(y), m_last.row(y), static_cast<size_t>(m_last.width) * 4);
+        }
+        m_heldChanges.clear(m_last.width, m_last.height, FrameChangeDetector::kTileSize);
+        m_hasHeld = true;
+        m_last = FrameView();
+    }
+    m_recovery.reportLost([this](std::string& error) {
+        if (!m_inner->initialize()) {
+            error = m_inner->lastError();
+            return false;
+        }
+        return true;
+    }, m_inner->lastError());
+    return acquireHeld(frame);
+}
+
+bool RecoveringSource::acquireHeld(SourceFrame& frame)
+{
+    if (!m_hasHeld) {
+        m_error = "lost before the first frame: " + m_recovery.lastError();
+        return false;
+    }
+    frame.pixels = m_held.view();
+    frame.changes = &m_heldChanges;
+    frame.cursor = nullptr;
+    frame.held = true;
+    frame.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    m_heldFrames.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
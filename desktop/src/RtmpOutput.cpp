@@ -0,0 +1,939 @@
+#include "incl/RtmpOutput.h"
+#include "incl/Amf0.h"
+#include "incl/Metrics.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifdef _WIN32
+    using Socket = SOCKET;
+    constexpr Socket kInvalidSocket = INVALID_SOCKET;
+    void closeSocket(Socket s) { closesocket(s); }
+    constexpr int kSendFlags = 0;
+    bool wouldBlock()
+    {
+        const int error = WSAGetLastError();
+        return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS;
+    }
+    void setNonBlocking(Socket s)
+    {
+        u_long on = 1;
+        ioctlsocket(s, FIONBIO, &on);
+    }
+#else
+    using Socket = int;
+    constexpr Socket kInvalidSocket = -1;
+    void closeSocket(Socket s) { close(s); }
+    constexpr int kSendFlags = MSG_NOSIGNAL; // a server hanging up must not raise SIGPIPE
+    bool wouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS || errno == EINTR; }
+    void setNonBlocking(Socket s) { fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK); }
+#endif
+
+    Socket toSocket(intptr_t s) { return static_cast<Socket>(s); }
+
+    // How often a socket wait checks for stop() and the stall timeout
+    constexpr int kPollMs = 50;
+
+    // Chunk size asked of the server: big enough that a frame is a few chunks
+    constexpr uint32_t kChunkSize = 4096;
+
+    // The bitrate hint moves at most this often
+    constexpr int kHintIntervalMs = 250;
+
+    enum Ready
+    {
+        Readable = 1,
+        Writable = 2,
+    };
+
+    // Readiness bits, 0 on timeout
+    int waitSocket(Socket s, bool forWrite, int timeoutMs)
+    {
+        fd_set readable;
+        fd_set writable;
+        FD_ZERO(&readable);
+        FD_ZERO(&writable);
+        FD_SET(s, &readable);
+        if (forWrite) {
+            FD_SET(s, &writable);
+        }
+        timeval timeout{ timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+        if (select(static_cast<int>(s) + 1, &readable, forWrite ? &writable : nullptr, nullptr, &timeout) <= 0) {
+            return 0;
+        }
+        return (FD_ISSET(s, &readable) ? Readable : 0) | (forWrite && FD_ISSET(s, &writable) ? Writable : 0);
+    }
+
+    int64_t microsBetween(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(b - a).count();
+    }
+
+    struct Status
+    {
+        std::string name;
+        double transaction = 0;
+        std::string level;
+        std::string code;
+        std::string description;
+    };
+
+    // Command name, transaction id and, for _result, _error and onStatus, the info object
+    bool parseCommand(const std::vector<uint8_t>& payload, Status& status)
+    {
+        Amf0Reader reader(payload.data(), payload.size());
+        if (!reader.readString(status.name) || !reader.readNumber(status.transaction)) {
+            return false;
+        }
+        if (reader.atEnd() || !reader.skip() || reader.atEnd()) {
+            return true;
+        }
+        std::vector<std::pair<std::string, std::string>> strings;
+        if (reader.peekMarker() == Amf0::Object && reader.readObject(strings)) {
+            for (const auto& property : strings) {
+                if (property.first == "level") {
+                    status.level = property.second;
+                }
+                else if (property.first == "code") {
+                    status.code = property.second;
+                }
+                else if (property.first == "description") {
+                    status.description = property.second;
+                }
+            }
+        }
+        return true;
+    }
+
+    void beginCommand(std::vector<uint8_t>& out, const char* name, double transaction)
+    {
+        out.clear();
+        Amf0::writeString(out, name);
+        Amf0::writeNumber(out, transaction);
+    }
+
+    enum Transaction
+    {
+        ConnectTransaction = 1,
+        ReleaseStreamTransaction,
+        FCPublishTransaction,
+        CreateStreamTransaction,
+        PublishTransaction,
+        FCUnpublishTransaction,
+        DeleteStreamTransaction,
+    };
+}
+
+bool RtmpOutput::start(const Settings& settings)
+{
+    stop();
+
+    std::string error;
+    Rtmp::Url url;
+    if (!Rtmp::parseUrl(settings.url, url, error)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_error = error;
+        m_state.store(State::Failed, std::memory_order_release);
+        return false;
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_error = "WSAStartup failed";
+        m_state.store(State::Failed, std::memory_order_release);
+        return false;
+    }
+#endif
+
+    m_settings = settings;
+    m_settings.queueSlots = std::max(m_settings.queueSlots, 16);
+    m_settings.minVideoKbps = std::min(m_settings.minVideoKbps, m_settings.stream.videoKbps);
+    m_url = url;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_slots.clear();
+        m_slots.resize(m_settings.queueSlots);
+        m_head = 0;
+        m_count = 0;
+        m_sendingHead = false;
+        m_dropToKeyframe = false;
+        m_newestVideoDts = 0;
+        m_stopping = false;
+        m_error.clear();
+    }
+    m_writer = RtmpChunkWriter();
+    m_reader = RtmpChunkReader();
+    m_pendingCommands.clear();
+    m_control.clear();
+    m_receiveBuffer.resize(16 * 1024);
+    m_streamId = 0;
+    m_receivedBytes = 0;
+    m_ackedBytes = 0;
+    m_ackWindow = 2500000;
+    m_unpublishing = false;
+
+    m_audioPackets.store(0, std::memory_order_relaxed);
+    m_videoPackets.store(0, std::memory_order_relaxed);
+    m_sentPackets.store(0, std::memory_order_relaxed);
+    m_sentBytes.store(0, std::memory_order_relaxed);
+    for (auto& dropped : m_dropped) {
+        dropped.store(0, std::memory_order_relaxed);
+    }
+    m_queuedPackets.store(0, std::memory_order_relaxed);
+    m_queuedVideoMs.store(0, std::memory_order_relaxed);
+    m_maxQueuedVideoMs.store(0, std::memory_order_relaxed);
+    m_linkKbps.store(0, std::memory_order_relaxed);
+    m_hintKbps.store(m_settings.stream.videoKbps, std::memory_order_relaxed);
+
+    m_state.store(State::Connecting, std::memory_order_release);
+    m_thread = std::thread(&RtmpOutput::run, this);
+    return true;
+}
+
+void RtmpOutput::stop(int drainMs)
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_drainDeadline = Clock::now() + std::chrono::milliseconds(std::max(drainMs, 0));
+    }
+    m_wake.notify_all();
+    m_thread.join();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_slots.clear();
+    m_count = 0;
+    m_queuedPackets.store(0, std::memory_order_relaxed);
+    if (state() != State::Failed) {
+        m_state.store(State::Stopped, std::memory_order_release);
+    }
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+bool RtmpOutput::waitUntilLive(int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_wake.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return state() != State::Connecting; });
+    return state() == State::Live;
+}
+
+std::string RtmpOutput::lastError() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_error;
+}
+
+void RtmpOutput::fail(const std::string& error)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping && state() == State::Connecting) {
+            return; // stop() cut the connect short; that's no failure
+        }
+        if (m_error.empty()) {
+            m_error = error;
+        }
+        m_state.store(State::Failed, std::memory_order_release);
+    }
+    m_wake.notify_all();
+}
+
+bool RtmpOutput::push(const EncodedPacket& packet)
+{
+    const State current = state();
+    if (current != State::Connecting && current != State::Live) {
+        return false;
+    }
+    const bool video = packet.type == EncodedPacket::Video;
+    (video ? m_videoPackets : m_audioPackets).fetch_add(1, std::memory_order_relaxed);
+    // Configuration is as precious as audio; only coded frames are ever dropped
+    const bool droppable = video && !packet.config;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (droppable) {
+        if (m_dropToKeyframe && packet.priority != EncodedPacket::Keyframe) {
+            m_dropped[packet.priority].fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        m_dropToKeyframe = false;
+        m_newestVideoDts = packet.dtsMs;
+        updateQueuedVideo();
+
+        const int queuedMs = m_queuedVideoMs.load(std::memory_order_relaxed);
+        if (queuedMs > m_settings.dropReferenceMs) {
+            // Whatever is queued may be referenced by what is queued after it; only a
+            // keyframe starts over cleanly
+            dropQueuedVideo(EncodedPacket::Keyframe);
+            if (packet.priority != EncodedPacket::Keyframe) {
+                m_dropToKeyframe = true;
+                m_dropped[packet.priority].fetch_add(1, std::memory_order_relaxed);
+                updateQueuedVideo();
+                return true;
+            }
+        }
+        else if (queuedMs > m_settings.dropDisposableMs) {
+            dropQueuedVideo(EncodedPacket::Disposable);
+            if (packet.priority == EncodedPacket::Disposable) {
+                m_dropped[packet.priority].fetch_add(1, std::memory_order_relaxed);
+                updateQueuedVideo();
+                return true;
+            }
+        }
+    }
+
+    if (m_count == static_cast<int>(m_slots.size())) {
+        compact();
+    }
+    if (m_count == static_cast<int>(m_slots.size())) {
+        // Full of packets that all have to go out: the queue duration thresholds didn't
+        // catch it (tiny frames), so make room the hard way
+        dropQueuedVideo(EncodedPacket::Keyframe);
+        compact();
+        if (droppable && packet.priority != EncodedPacket::Keyframe) {
+            m_dropToKeyframe = true;
+            m_dropped[packet.priority].fetch_add(1, std::memory_order_relaxed);
+            updateQueuedVideo();
+            return true;
+        }
+        if (m_count == static_cast<int>(m_slots.size())) {
+            lock.unlock();
+            fail("send queue full of audio: the link can't carry even that");
+            return false;
+        }
+    }
+
+    Slot& slot = slotAt(m_count);
+    if (packet.size > 0) {
+        slot.buffer = BufferPool::instance().acquire(packet.size);
+        if (!slot.buffer) {
+            lock.unlock();
+            fail("out of memory for a " + std::to_string(packet.size) + " byte packet");
+            return false;
+        }
+        std::memcpy(slot.buffer.data(), packet.data, packet.size);
+    }
+    slot.packet = packet;
+    slot.packet.data = slot.buffer.data();
+    slot.dropped = false;
+    m_count++;
+    updateQueuedVideo();
+    lock.unlock();
+    m_wake.notify_all();
+    return true;
+}
+
+void RtmpOutput::popFront()
+{
+    Slot& slot = slotAt(0);
+    slot.buffer.reset();
+    slot.dropped = false;
+    m_head = (m_head + 1) % m_slots.size();
+    m_count--;
+}
+
+void RtmpOutput::dropQueuedVideo(EncodedPacket::Priority upTo)
+{
+    for (int i = m_sendingHead ? 1 : 0; i < m_count; i++) {
+        Slot& slot = slotAt(i);
+        if (slot.dropped || slot.packet.type != EncodedPacket::Video || slot.packet.config || slot.packet.priority > upTo) {
+            continue;
+        }
+        slot.dropped = true;
+        slot.buffer.reset();
+        m_dropped[slot.packet.priority].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void RtmpOutput::compact()
+{
+    int kept = 0;
+    for (int i = 0; i < m_count; i++) {
+        Slot& slot = slotAt(i);
+        if (slot.dropped && !(i == 0 && m_sendingHead)) {
+            continue;
+        }
+        if (kept != i) {
+            slotAt(kept) = std::move(slot);
+            slot.dropped = false;
+        }
+        kept++;
+    }
+    m_count = kept;
+}
+
+void RtmpOutput::updateQueuedVideo()
+{
+    int live = 0;
+    bool anyVideo = false;
+    int64_t oldestVideo = 0;
+    for (int i = 0; i < m_count; i++) {
+        const Slot& slot = slotAt(i);
+        if (slot.dropped) {
+            continue;
+        }
+        live++;
+        if (!anyVideo && slot.packet.type == EncodedPacket::Video && !slot.packet.config) {
+            anyVideo = true;
+            oldestVideo = slot.packet.dtsMs;
+        }
+    }
+    const int queuedMs = anyVideo ? static_cast<int>(std::max<int64_t>(m_newestVideoDts - oldestVideo, 0)) : 0;
+    m_queuedPackets.store(live, std::memory_order_relaxed);
+    m_queuedVideoMs.store(queuedMs, std::memory_order_relaxed);
+    if (queuedMs > m_maxQueuedVideoMs.load(std::memory_order_relaxed)) {
+        m_maxQueuedVideoMs.store(queuedMs, std::memory_order_relaxed);
+    }
+}
+
+RtmpOutput::Clock::time_point RtmpOutput::giveUpAt()
+{
+    if (m_unpublishing) {
+        return m_unpublishBy;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_stopping) {
+        return Clock::time_point::max();
+    }
+    // Only a live stream has anything worth draining
+    return state() == State::Live ? m_drainDeadline : Clock::time_point::min();
+}
+
+void RtmpOutput::run()
+{
+    Tracer::instance().setThreadName("rtmp send");
+
+    if (connectAndPublish()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (state() == State::Connecting) {
+                m_state.store(State::Live, std::memory_order_release);
+            }
+        }
+        m_wake.notify_all();
+        m_windowStart = Clock::now();
+        m_windowBytes = 0;
+        m_windowIdleUs = 0;
+    }
+
+    while (state() == State::Live) {
+        EncodedPacket packet;
+        bool sending = false;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_count > 0 && slotAt(0).dropped) {
+                popFront();
+            }
+            if (m_stopping && (m_count == 0 || Clock::now() >= m_drainDeadline)) {
+                break;
+            }
+            if (m_count == 0) {
+                const Clock::time_point idleStart = Clock::now();
+                m_wake.wait_for(lock, std::chrono::milliseconds(kPollMs), [this] { return m_stopping || m_count > 0; });
+                m_windowIdleUs += microsBetween(idleStart, Clock::now());
+            }
+            else {
+                m_sendingHead = true;
+                packet = slotAt(0).packet;
+                sending = true;
+            }
+        }
+
+        if (!sending) {
+            if (receive(0)) {
+                flushControl();
+            }
+            updateHint(Clock::now());
+            continue;
+        }
+
+        uint8_t head[Flv::kMaxBodyHeaderBytes];
+        const size_t headSize = Flv::bodyHeader(packet, head);
+        const bool audio = packet.type == EncodedPacket::Audio;
+        m_chunks.clear();
+        m_writer.write(m_chunks, audio ? Rtmp::AudioChunks : Rtmp::VideoChunks, audio ? Rtmp::AudioMessage : Rtmp::VideoMessage,
+            m_streamId, static_cast<uint32_t>(std::max<int64_t>(packet.dtsMs, 0)), head, headSize, packet.data, packet.size);
+        bool sent;
+        {
+            TraceScope trace("rtmp send");
+            sent = sendBytes(m_chunks.data(), m_chunks.size());
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_sendingHead = false;
+            popFront();
+            updateQueuedVideo();
+        }
+        if (sent) {
+            m_sentPackets.fetch_add(1, std::memory_order_relaxed);
+            flushControl();
+        }
+        updateHint(Clock::now());
+    }
+
+    if (state() == State::Live) {
+        unpublish();
+    }
+    if (m_socket != -1) {
+        closeSocket(toSocket(m_socket));
+        m_socket = -1;
+    }
+}
+
+bool RtmpOutput::connectAndPublish()
+{
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    addrinfo* addresses = nullptr;
+    const std::string port = std::to_string(m_url.port);
+    if (getaddrinfo(m_url.host.c_str(), port.c_str(), &hints, &addresses) != 0 || !addresses) {
+        fail("cannot resolve " + m_url.host);
+        return false;
+    }
+
+    const Clock::time_point connectBy = Clock::now() + std::chrono::milliseconds(m_settings.connectTimeoutMs);
+    Socket s = kInvalidSocket;
+    for (addrinfo* address = addresses; address && s == kInvalidSocket; address = address->ai_next) {
+        s = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (s == kInvalidSocket) {
+            continue;
+        }
+        setNonBlocking(s);
+        if (m_settings.sendBufferBytes > 0) {
+            setsockopt(s, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&m_settings.sendBufferBytes), sizeof(int));
+        }
+        bool connected = connect(s, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0;
+        while (!connected && wouldBlock() && giveUpAt() > Clock::now() && Clock::now() < connectBy) {
+            if (waitSocket(s, true, kPollMs) & Writable) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length);
+                connected = error == 0;
+                break;
+            }
+        }
+        if (!connected) {
+            closeSocket(s);
+            s = kInvalidSocket;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (s == kInvalidSocket) {
+        fail("cannot connect to " + m_url.host + ":" + port);
+        return false;
+    }
+    int noDelay = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+    m_socket = static_cast<intptr_t>(s);
+    m_lastProgress = Clock::now();
+
+    // Handshake: C0 C1 out, S0 S1 S2 in, S1 echoed back as C2. Plain, without the
+    // digest Flash used; every ingest accepts it.
+    uint8_t hello[1 + Rtmp::kHandshakeBytes];
+    hello[0] = Rtmp::kVersion;
+    Rtmp::fillHandshake(hello + 1, 0);
+    if (!sendBytes(hello, sizeof(hello))) {
+        fail("handshake failed");
+        return false;
+    }
+    std::vector<uint8_t> answer(1 + 2 * Rtmp::kHandshakeBytes);
+    size_t received = 0;
+    while (received < answer.size()) {
+        if (Clock::now() >= connectBy || giveUpAt() <= Clock::now()) {
+            fail("no handshake from " + m_url.host);
+            return false;
+        }
+        if (!(waitSocket(s, false, kPollMs) & Readable)) {
+            continue;
+        }
+        const int n = recv(s, reinterpret_cast<char*>(answer.data() + received), static_cast<int>(answer.size() - received), 0);
+        if (n == 0 || (n < 0 && !wouldBlock())) {
+            fail("connection closed during the handshake");
+            return false;
+        }
+        received += std::max(n, 0);
+    }
+    if (answer[0] != Rtmp::kVersion) {
+        fail("server speaks RTMP version " + std::to_string(answer[0]));
+        return false;
+    }
+    if (!sendBytes(answer.data() + 1, Rtmp::kHandshakeBytes)) {
+        fail("handshake failed");
+        return false;
+    }
+
+    std::vector<uint8_t> payload(4);
+    Rtmp::putBig32(payload.data(), kChunkSize);
+    m_chunks.clear();
+    m_writer.write(m_chunks, Rtmp::ControlChunks, Rtmp::SetChunkSize, 0, 0, payload);
+    if (!sendBytes(m_chunks.data(), m_chunks.size())) {
+        return false;
+    }
+    m_writer.setChunkSize(kChunkSize);
+
+    beginCommand(payload, "connect", ConnectTransaction);
+    Amf0::beginObject(payload);
+    Amf0::writeKey(payload, "app");
+    Amf0::writeString(payload, m_url.app);
+    Amf0::writeKey(payload, "type");
+    Amf0::writeString(payload, "nonprivate");
+    Amf0::writeKey(payload, "flashVer");
+    Amf0::writeString(payload, "FMLE/3.0 (compatible; obs-clone)");
+    Amf0::writeKey(payload, "tcUrl");
+    Amf0::writeString(payload, m_url.tcUrl);
+    Amf0::endObject(payload);
+    if (!sendCommand(payload, 0) || !awaitResult(ConnectTransaction, payload)) {
+        return false;
+    }
+
+    beginCommand(payload, "releaseStream", ReleaseStreamTransaction);
+    Amf0::writeNull(payload);
+    Amf0::writeString(payload, m_settings.streamKey);
+    if (!sendCommand(payload, 0)) {
+        return false;
+    }
+    beginCommand(payload, "FCPublish", FCPublishTransaction);
+    Amf0::writeNull(payload);
+    Amf0::writeString(payload, m_settings.streamKey);
+    if (!sendCommand(payload, 0)) {
+        return false;
+    }
+    beginCommand(payload, "createStream", CreateStreamTransaction);
+    Amf0::writeNull(payload);
+    if (!sendCommand(payload, 0) || !awaitResult(CreateStreamTransaction, payload)) {
+        return false;
+    }
+    Amf0Reader result(payload.data(), payload.size());
+    std::string name;
+    double transaction = 0;
+    double streamId = 0;
+    if (!result.readString(name) || !result.readNumber(transaction) || !result.skip() || !result.readNumber(streamId)) {
+        fail("createStream answered without a stream id");
+        return false;
+    }
+    m_streamId = static_cast<uint32_t>(streamId);
+
+    beginCommand(payload, "publish", PublishTransaction);
+    Amf0::writeNull(payload);
+    Amf0::writeString(payload, m_settings.streamKey);
+    Amf0::writeString(payload, "live");
+    if (!sendCommand(payload, m_streamId) || !awaitPublishStart()) {
+        return false;
+    }
+
+    payload.clear();
+    Flv::metadataBody(payload, m_settings.stream, true);
+    m_chunks.clear();
+    m_writer.write(m_chunks, Rtmp::DataChunks, Rtmp::DataMessage, m_streamId, 0, payload);
+    return sendBytes(m_chunks.data(), m_chunks.size());
+}
+
+bool RtmpOutput::sendCommand(const std::vector<uint8_t>& payload, uint32_t streamId)
+{
+    m_chunks.clear();
+    m_writer.write(m_chunks, Rtmp::CommandChunks, Rtmp::CommandMessage, streamId, 0, payload);
+    return sendBytes(m_chunks.data(), m_chunks.size());
+}
+
+bool RtmpOutput::awaitResult(double transaction, std::vector<uint8_t>& payload)
+{
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(m_settings.connectTimeoutMs);
+    for (;;) {
+        while (!m_pendingCommands.empty()) {
+            std::vector<uint8_t> command = std::move(m_pendingCommands.front());
+            m_pendingCommands.erase(m_pendingCommands.begin());
+            Status status;
+            if (!parseCommand(command, status) || status.transaction != transaction) {
+                continue; // onBWDone, onFCPublish and the like
+            }
+            if (status.name == "_result") {
+                payload = std::move(command);
+                return true;
+            }
+            if (status.name == "_error") {
+                fail("server refused: " + (status.description.empty() ? status.code : status.description));
+                return false;
+            }
+        }
+        const Clock::time_point now = Clock::now();
+        if (now >= deadline || now >= giveUpAt()) {
+            fail("no answer from " + m_url.host);
+            return false;
+        }
+        if (!receive(kPollMs) || !flushControl()) {
+            return false;
+        }
+    }
+}
+
+bool RtmpOutput::awaitPublishStart()
+{
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(m_settings.connectTimeoutMs);
+    for (;;) {
+        while (!m_pendingCommands.empty()) {
+            Status status;
+            const bool parsed = parseCommand(m_pendingCommands.front(), status);
+            m_pendingCommands.erase(m_pendingCommands.begin());
+            if (!parsed || status.name != "onStatus") {
+                continue;
+            }
+            if (status.code == "NetStream.Publish.Start") {
+                return true;
+            }
+            if (status.level == "error") {
+                fail(status.code + (status.description.empty() ? "" : ": " + status.description));
+                return false;
+            }
+        }
+        const Clock::time_point now = Clock::now();
+        if (now >= deadline || now >= giveUpAt()) {
+            fail("server never started the stream");
+            return false;
+        }
+        if (!receive(kPollMs) || !flushControl()) {
+            return false;
+        }
+    }
+}
+
+bool RtmpOutput::sendBytes(const uint8_t* data, size_t size)
+{
+    const Socket s = toSocket(m_socket);
+    while (size > 0) {
+        const Clock::time_point now = Clock::now();
+        if (now >= giveUpAt()) {
+            return false;
+        }
+        if (now - m_lastProgress > std::chrono::milliseconds(m_settings.stallTimeoutMs)) {
+            fail("send stalled for " + std::to_string(m_settings.stallTimeoutMs / 1000) + " s");
+            return false;
+        }
+
+        const int ready = waitSocket(s, true, kPollMs);
+        if (ready & Readable) {
+            // Keep answering pings and acknowledging while a big frame goes out
+            if (!receive(0)) {
+                return false;
+            }
+        }
+        if (!(ready & Writable)) {
+            updateHint(Clock::now());
+            continue;
+        }
+        const int sent = send(s, reinterpret_cast<const char*>(data), static_cast<int>(size), kSendFlags);
+        if (sent < 0 && !wouldBlock()) {
+            fail("connection lost");
+            return false;
+        }
+        if (sent > 0) {
+            data += sent;
+            size -= sent;
+            m_windowBytes += sent;
+            m_sentBytes.fetch_add(sent, std::memory_order_relaxed);
+            m_lastProgress = Clock::now();
+        }
+    }
+    return true;
+}
+
+bool RtmpOutput::receive(int timeoutMs)
+{
+    const Socket s = toSocket(m_socket);
+    if (!(waitSocket(s, false, timeoutMs) & Readable)) {
+        return true;
+    }
+    const int n = recv(s, reinterpret_cast<char*>(m_receiveBuffer.data()), static_cast<int>(m_receiveBuffer.size()), 0);
+    if (n == 0) {
+        fail("server closed the connection");
+        return false;
+    }
+    if (n < 0) {
+        if (wouldBlock()) {
+            return true;
+        }
+        fail("connection lost");
+        return false;
+    }
+
+    m_receivedBytes += n;
+    m_reader.append(m_receiveBuffer.data(), n);
+    while (m_reader.next(m_message)) {
+        if (!handleIncoming(m_message)) {
+            return false;
+        }
+    }
+    if (m_reader.failed()) {
+        fail("bad data from server: " + m_reader.error());
+        return false;
+    }
+
+    if (m_receivedBytes - m_ackedBytes >= m_ackWindow) {
+        uint8_t sequence[4];
+        Rtmp::putBig32(sequence, static_cast<uint32_t>(m_receivedBytes));
+        m_ackedBytes = m_receivedBytes;
+        m_writer.write(m_control, Rtmp::ControlChunks, Rtmp::Acknowledgement, 0, 0, nullptr, 0, sequence, sizeof(sequence));
+    }
+    return true;
+}
+
+bool RtmpOutput::flushControl()
+{
+    if (m_control.empty()) {
+        return true;
+    }
+    // Swapped out first: sending may receive, and that may queue more
+    m_controlSending.swap(m_control);
+    m_control.clear();
+    const bool sent = sendBytes(m_controlSending.data(), m_controlSending.size());
+    m_controlSending.clear();
+    return sent;
+}
+
+bool RtmpOutput::handleIncoming(const Rtmp::Message& message)
+{
+    const std::vector<uint8_t>& payload = message.payload;
+    switch (message.type) {
+    case Rtmp::WindowAckSize:
+        if (payload.size() >= 4) {
+            m_ackWindow = std::max<uint32_t>(Rtmp::big32(payload.data()), 1);
+        }
+        return true;
+    case Rtmp::UserControl:
+        if (payload.size() >= 6 && (payload[0] << 8 | payload[1]) == Rtmp::PingRequest) {
+            const uint8_t pong[6] = { 0, Rtmp::PingResponse, payload[2], payload[3], payload[4], payload[5] };
+            m_writer.write(m_control, Rtmp::ControlChunks, Rtmp::UserControl, 0, 0, nullptr, 0, pong, sizeof(pong));
+        }
+        return true;
+    case Rtmp::CommandMessage:
+        if (state() == State::Connecting) {
+            m_pendingCommands.push_back(payload);
+            return true;
+        }
+        else {
+            // Once live the server only speaks up to end the stream
+            Status status;
+            if (parseCommand(payload, status) && (status.level == "error" || status.name == "close")) {
+                fail(status.name == "close" ? "server closed the stream" : status.code + ": " + status.description);
+                return false;
+            }
+        }
+        return true;
+    default:
+        return true;
+    }
+}
+
+void RtmpOutput::unpublish()
+{
+    // Best effort, briefly: the server cleans up after a dropped connection as well
+    m_unpublishing = true;
+    m_unpublishBy = Clock::now() + std::chrono::milliseconds(500);
+    std::vector<uint8_t> payload;
+    beginCommand(payload, "FCUnpublish", FCUnpublishTransaction);
+    Amf0::writeNull(payload);
+    Amf0::writeString(payload, m_settings.streamKey);
+    if (sendCommand(payload, 0)) {
+        beginCommand(payload, "deleteStream", DeleteStreamTransaction);
+        Amf0::writeNull(payload);
+        Amf0::writeNumber(payload, m_streamId);
+        sendCommand(payload, 0);
+    }
+    m_unpublishing = false;
+}
+
+void RtmpOutput::updateHint(Clock::time_point now)
+{
+    const int64_t windowUs = microsBetween(m_windowStart, now);
+    if (windowUs < kHintIntervalMs * 1000) {
+        return;
+    }
+
+    // Only a window in which there was always something waiting to go out tells what
+    // the link carries; otherwise it only says the link keeps up
+    int link = m_linkKbps.load(std::memory_order_relaxed);
+    const int64_t busyUs = windowUs - m_windowIdleUs;
+    if (busyUs * 10 >= windowUs * 9) {
+        const int measured = static_cast<int>(m_windowBytes * 8000 / std::max<int64_t>(busyUs, 1));
+        link = link == 0 ? measured : (link * 3 + measured) / 4;
+        m_linkKbps.store(link, std::memory_order_relaxed);
+    }
+
+    const int ceiling = m_settings.stream.videoKbps;
+    const int queuedMs = m_queuedVideoMs.load(std::memory_order_relaxed);
+    int hint = m_hintKbps.load(std::memory_order_relaxed);
+    if (queuedMs >= m_settings.dropDisposableMs / 2 && link > 0) {
+        // Backing up: fit under the link with room to drain the queue; audio comes first
+        hint = std::min(hint, link * 85 / 100 - m_settings.stream.audioKbps);
+    }
+    else if (queuedMs < m_settings.dropDisposableMs / 5) {
+        // Keeping up: probe back towards the ceiling, 5% of it a second
+        hint += std::max(ceiling * kHintIntervalMs / 20000, 1);
+    }
+    m_hintKbps.store(std::max(std::min(hint, ceiling), m_settings.minVideoKbps), std::memory_order_relaxed);
+
+    m_windowStart = now;
+    m_windowBytes = 0;
+    m_windowIdleUs = 0;
+}
+
+RtmpOutput::Stats RtmpOutput::stats() const
+{
+    Stats stats;
+    stats.audioPackets = m_audioPackets.load(std::memory_order_relaxed);
+    stats.videoPackets = m_videoPackets.load(std::memory_order_relaxed);
+    stats.sentPackets = m_sentPackets.load(std::memory_order_relaxed);
+    stats.sentBytes = m_sentBytes.load(std::memory_order_relaxed);
+    for (int i = 0; i < 3; i++) {
+        stats.dropped[i] = m_dropped[i].load(std::memory_order_relaxed);
+    }
+    stats.queuedPackets = m_queuedPackets.load(std::memory_order_relaxed);
+    stats.queuedVideoMs = m_queuedVideoMs.load(std::memory_order_relaxed);
+    stats.maxQueuedVideoMs = m_maxQueuedVideoMs.load(std::memory_order_relaxed);
+    stats.linkKbps = m_linkKbps.load(std::memory_order_relaxed);
+    stats.bitrateHintKbps = m_hintKbps.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void RtmpOutput::collectMetrics(MetricsWriter& writer) const
+{
+    const Stats current = stats();
+    writer.gauge("obs_rtmp_live", "1 while the RTMP output is publishing.", state() == State::Live ? 1.0 : 0.0);
+    writer.counter("obs_rtmp_sent_bytes_total", "Bytes sent to the RTMP server, chunk headers included.",
+        static_cast<double>(current.sentBytes));
+    static const char* const kPriorityLabels[3] = {
+        "priority=\"disposable\"", "priority=\"reference\"", "priority=\"keyframe\"",
+    };
+    for (int i = 0; i < 3; i++) {
+        writer.counter("obs_rtmp_dropped_frames_total", "Video frames dropped because the send queue backed up.",
+            static_cast<double>(current.dropped[i]), kPriorityLabels[i]);
+    }
+    writer.gauge("obs_rtmp_queue_seconds", "Duration of the video waiting in the send queue.", current.queuedVideoMs / 1000.0);
+    writer.gauge("obs_rtmp_link_kbps", "Throughput measured while the link was the bottleneck.", current.linkKbps);
+    writer.gauge("obs_rtmp_bitrate_hint_kbps", "Video bitrate the link is estimated to sustain.", current.bitrateHintKbps);
+}
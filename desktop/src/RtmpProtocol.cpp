@@ -0,0 +1,313 @@
+#include "incl/RtmpProtocol.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    constexpr uint32_t kExtendedTimestamp = 0xFFFFFF;
+
+    void put24(uint8_t* p, uint32_t value)
+    {
+        p[0] = static_cast<uint8_t>(value >> 16);
+        p[1] = static_cast<uint8_t>(value >> 8);
+        p[2] = static_cast<uint8_t>(value);
+    }
+
+    uint32_t get24(const uint8_t* p)
+    {
+        return uint32_t(p[0]) << 16 | uint32_t(p[1]) << 8 | p[2];
+    }
+
+    // Basic header: format in the top two bits, then the chunk stream id in one to three bytes
+    size_t putBasicHeader(uint8_t* p, int format, uint32_t chunkStream)
+    {
+        if (chunkStream < 64) {
+            p[0] = static_cast<uint8_t>(format << 6 | chunkStream);
+            return 1;
+        }
+        if (chunkStream < 320) {
+            p[0] = static_cast<uint8_t>(format << 6);
+            p[1] = static_cast<uint8_t>(chunkStream - 64);
+            return 2;
+        }
+        p[0] = static_cast<uint8_t>(format << 6 | 1);
+        p[1] = static_cast<uint8_t>((chunkStream - 64) & 0xFF);
+        p[2] = static_cast<uint8_t>((chunkStream - 64) >> 8);
+        return 3;
+    }
+}
+
+bool Rtmp::parseUrl(const std::string& url, Url& out, std::string& error)
+{
+    const std::string scheme = "rtmp://";
+    if (url.compare(0, scheme.size(), scheme) != 0) {
+        error = url.compare(0, 8, "rtmps://") == 0 ? "rtmps (TLS) is not supported" : "not an rtmp:// URL: " + url;
+        return false;
+    }
+    const size_t hostStart = scheme.size();
+    const size_t pathStart = url.find('/', hostStart);
+    if (pathStart == std::string::npos || pathStart + 1 >= url.size()) {
+        error = "URL has no application: " + url;
+        return false;
+    }
+
+    std::string authority = url.substr(hostStart, pathStart - hostStart);
+    out.port = kDefaultPort;
+    const size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']', colon) == std::string::npos) {
+        const int port = std::atoi(authority.c_str() + colon + 1);
+        if (port <= 0 || port > 65535) {
+            error = "bad port in " + url;
+            return false;
+        }
+        out.port = port;
+        authority.resize(colon);
+    }
+    if (authority.size() > 2 && authority.front() == '[' && authority.back() == ']') {
+        authority = authority.substr(1, authority.size() - 2);
+    }
+    if (authority.empty()) {
+        error = "URL has no host: " + url;
+        return false;
+    }
+
+    out.host = authority;
+    out.app = url.substr(pathStart + 1);
+    out.tcUrl = url;
+    return true;
+}
+
+void Rtmp::fillHandshake(uint8_t block[kHandshakeBytes], uint32_t timeMs)
+{
+    putBig32(block, timeMs);
+    std::memset(block + 4, 0, 4);
+    // Anything will do; peers only echo it back
+    uint32_t state = timeMs * 2654435761u + 1;
+    for (size_t i = 8; i < kHandshakeBytes; i++) {
+        state = state * 1664525u + 1013904223u;
+        block[i] = static_cast<uint8_t>(state >> 24);
+    }
+}
+
+void Rtmp::putBig32(uint8_t* p, uint32_t value)
+{
+    p[0] = static_cast<uint8_t>(value >> 24);
+    p[1] = static_cast<uint8_t>(value >> 16);
+    p[2] = static_cast<uint8_t>(value >> 8);
+    p[3] = static_cast<uint8_t>(value);
+}
+
+uint32_t Rtmp::big32(const uint8_t* p)
+{
+    return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+}
+
+void RtmpChunkWriter::write(std::vector<uint8_t>& out, uint32_t chunkStream, uint8_t type, uint32_t streamId,
+    uint32_t timestamp, const uint8_t* head, size_t headSize, const uint8_t* data, size_t size)
+{
+    const uint32_t length = static_cast<uint32_t>(headSize + size);
+
+    // Type 0 carries everything; type 1 a delta, length and type; type 2 only a delta
+    StreamState scratch;
+    StreamState& last = chunkStream < kStreams ? m_streams[chunkStream] : scratch;
+    int format = 0;
+    uint32_t timestampField = timestamp;
+    if (last.used && last.streamId == streamId && timestamp >= last.timestamp) {
+        format = last.length == length && last.type == type ? 2 : 1;
+        timestampField = timestamp - last.timestamp;
+    }
+    last.used = true;
+    last.type = type;
+    last.streamId = streamId;
+    last.timestamp = timestamp;
+    last.length = length;
+
+    const bool extended = timestampField >= kExtendedTimestamp;
+    uint8_t header[18];
+    size_t headerSize = putBasicHeader(header, format, chunkStream);
+    put24(header + headerSize, extended ? kExtendedTimestamp : timestampField);
+    headerSize += 3;
+    if (format <= 1) {
+        put24(header + headerSize, length);
+        header[headerSize + 3] = type;
+        headerSize += 4;
+    }
+    if (format == 0) {
+        // The message stream id alone is little endian
+        header[headerSize] = static_cast<uint8_t>(streamId);
+        header[headerSize + 1] = static_cast<uint8_t>(streamId >> 8);
+        header[headerSize + 2] = static_cast<uint8_t>(streamId >> 16);
+        header[headerSize + 3] = static_cast<uint8_t>(streamId >> 24);
+        headerSize += 4;
+    }
+    if (extended) {
+        Rtmp::putBig32(header + headerSize, timestampField);
+        headerSize += 4;
+    }
+
+    uint8_t continuation[8];
+    size_t continuationSize = putBasicHeader(continuation, 3, chunkStream);
+    if (extended) {
+        Rtmp::putBig32(continuation + continuationSize, timestampField);
+        continuationSize += 4;
+    }
+
+    const size_t chunks = length == 0 ? 1 : (length + m_chunkSize - 1) / m_chunkSize;
+    out.reserve(out.size() + length + headerSize + (chunks - 1) * continuationSize);
+    out.insert(out.end(), header, header + headerSize);
+    size_t written = 0;
+    while (written < length) {
+        if (written > 0) {
+            out.insert(out.end(), continuation, continuation + continuationSize);
+        }
+        size_t chunk = std::min<size_t>(m_chunkSize, length - written);
+        const size_t end = written + chunk;
+        if (written < headSize) {
+            const size_t fromHead = std::min(headSize, end) - written;
+            out.insert(out.end(), head + written, head + written + fromHead);
+            written += fromHead;
+        }
+        if (written < end) {
+            const uint8_t* from = data + (written - headSize);
+            out.insert(out.end(), from, from + (end - written));
+            written = end;
+        }
+    }
+}
+
+void RtmpChunkReader::append(const uint8_t* data, size_t size)
+{
+    // Drop what was parsed once it is most of the buffer, so it doesn't grow forever
+    if (m_readAt > 0 && m_readAt * 2 >= m_buffer.size()) {
+        m_buffer.erase(m_buffer.begin(), m_buffer.begin() + m_readAt);
+        m_readAt = 0;
+    }
+    m_buffer.insert(m_buffer.end(), data, data + size);
+}
+
+bool RtmpChunkReader::fail(const char* error)
+{
+    m_error = error;
+    return false;
+}
+
+RtmpChunkReader::StreamState& RtmpChunkReader::stream(uint32_t chunkStream)
+{
+    for (auto& entry : m_streams) {
+        if (entry.first == chunkStream) {
+            return entry.second;
+        }
+    }
+    m_streams.emplace_back(chunkStream, StreamState());
+    return m_streams.back().second;
+}
+
+bool RtmpChunkReader::next(Rtmp::Message& message)
+{
+    while (!failed()) {
+        const uint8_t* p = m_buffer.data() + m_readAt;
+        const size_t available = m_buffer.size() - m_readAt;
+        if (available < 1) {
+            return false;
+        }
+
+        const int format = p[0] >> 6;
+        uint32_t chunkStream = p[0] & 0x3F;
+        size_t at = 1;
+        if (chunkStream < 2) {
+            const size_t extra = chunkStream == 0 ? 1 : 2;
+            if (available < 1 + extra) {
+                return false;
+            }
+            chunkStream = 64 + p[1] + (extra == 2 ? uint32_t(p[2]) << 8 : 0);
+            at += extra;
+        }
+
+        static const size_t kHeaderBytes[4] = { 11, 7, 3, 0 };
+        if (available < at + kHeaderBytes[format]) {
+            return false;
+        }
+        StreamState& state = stream(chunkStream);
+        if (format == 3 && !state.started) {
+            return fail("type 3 chunk on a chunk stream without a header");
+        }
+
+        // A new header always starts a message; a type 3 chunk continues one if it is open
+        const bool continuing = format == 3 && !state.payload.empty();
+        uint32_t timestampField = state.timestampField;
+        uint32_t length = state.length;
+        uint8_t type = state.type;
+        uint32_t streamId = state.streamId;
+        if (format <= 2) {
+            timestampField = get24(p + at);
+        }
+        if (format <= 1) {
+            length = get24(p + at + 3);
+            type = p[at + 6];
+        }
+        if (format == 0) {
+            streamId = uint32_t(p[at + 7]) | uint32_t(p[at + 8]) << 8 | uint32_t(p[at + 9]) << 16 | uint32_t(p[at + 10]) << 24;
+        }
+        at += kHeaderBytes[format];
+
+        const bool extended = format <= 2 ? timestampField == kExtendedTimestamp : state.extended;
+        if (extended) {
+            if (available < at + 4) {
+                return false;
+            }
+            if (format <= 2) {
+                timestampField = Rtmp::big32(p + at);
+            }
+            at += 4;
+        }
+
+        if (length > Rtmp::kMaxMessageBytes) {
+            return fail("message too long");
+        }
+        const size_t already = continuing ? state.payload.size() : 0;
+        const size_t chunk = std::min<size_t>(m_chunkSize, length - already);
+        if (available < at + chunk) {
+            return false;
+        }
+
+        // The whole chunk is in; commit it
+        if (!continuing) {
+            if (state.payload.capacity() == 0) {
+                state.payload.reserve(length);
+            }
+            state.timestamp = format == 0 ? timestampField : state.timestamp + timestampField;
+            state.timestampField = timestampField;
+            state.length = length;
+            state.type = type;
+            state.streamId = streamId;
+            state.extended = extended;
+            state.started = true;
+        }
+        state.payload.insert(state.payload.end(), p + at, p + at + chunk);
+        m_readAt += at + chunk;
+
+        if (state.payload.size() < state.length) {
+            continue;
+        }
+
+        message.chunkStream = chunkStream;
+        message.type = state.type;
+        message.streamId = state.streamId;
+        message.timestamp = state.timestamp;
+        message.payload.swap(state.payload);
+        state.payload.clear();
+
+        if (message.type == Rtmp::SetChunkSize) {
+            if (message.payload.size() < 4) {
+                return fail("short Set Chunk Size");
+            }
+            const uint32_t size = Rtmp::big32(message.payload.data()) & 0x7FFFFFFF;
+            if (size < 1 || size > Rtmp::kMaxChunkSize) {
+                return fail("bad chunk size");
+            }
+            m_chunkSize = size;
+        }
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,417 @@
+#include "incl/SampleConverter.h"
+#include "incl/Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    using Job = SampleConverter::Job;
+
+    // Frames per pass when the layout changes (fits the stack for 8 x 32-bit channels)
+    constexpr int kChunkFrames = 256;
+
+    constexpr bool isInteger(SampleFormat format)
+    {
+        return format != SampleFormat::F32;
+    }
+
+    template <SampleFormat F>
+    constexpr int sampleBytes()
+    {
+        return F == SampleFormat::U8 ? 1 : F == SampleFormat::S16 ? 2 : F == SampleFormat::S24 ? 3 : 4;
+    }
+
+    inline uint32_t xorshift(uint32_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Triangular dither in LSB units, -1..1
+    inline float tpdf(uint32_t* dither)
+    {
+        const int32_t a = static_cast<int32_t>(xorshift(dither[0]));
+        const int32_t b = static_cast<int32_t>(xorshift(dither[4]));
+        return (static_cast<float>(a) + static_cast<float>(b)) * (1.0f / 4294967296.0f);
+    }
+
+    // Integer samples widened to a left-aligned int32, so integer to integer
+    // conversions stay exact
+    template <SampleFormat F>
+    inline int32_t readInt(const uint8_t* p)
+    {
+        if constexpr (F == SampleFormat::U8) {
+            return (static_cast<int32_t>(p[0]) - 128) * (1 << 24);
+        }
+        else if constexpr (F == SampleFormat::S16) {
+            int16_t v;
+            memcpy(&v, p, 2);
+            return static_cast<int32_t>(v) * (1 << 16);
+        }
+        else if constexpr (F == SampleFormat::S24) {
+            return static_cast<int32_t>(static_cast<uint32_t>(p[0]) << 8 | static_cast<uint32_t>(p[1]) << 16 | static_cast<uint32_t>(p[2]) << 24);
+        }
+        else {
+            int32_t v;
+            memcpy(&v, p, 4);
+            return v;
+        }
+    }
+
+    template <SampleFormat F>
+    inline void writeInt(uint8_t* p, int32_t v)
+    {
+        if constexpr (F == SampleFormat::U8) {
+            p[0] = static_cast<uint8_t>((v >> 24) + 128);
+        }
+        else if constexpr (F == SampleFormat::S16) {
+            const int16_t s = static_cast<int16_t>(v >> 16);
+            memcpy(p, &s, 2);
+        }
+        else if constexpr (F == SampleFormat::S24) {
+            p[0] = static_cast<uint8_t>(v >> 8);
+            p[1] = static_cast<uint8_t>(v >> 16);
+            p[2] = static_cast<uint8_t>(v >> 24);
+        }
+        else {
+            memcpy(p, &v, 4);
+        }
+    }
+
+    template <SampleFormat F>
+    inline float readFloat(const uint8_t* p)
+    {
+        if constexpr (F == SampleFormat::F32) {
+            float v;
+            memcpy(&v, p, 4);
+            return v;
+        }
+        else {
+            return static_cast<float>(readInt<F>(p)) * (1.0f / 2147483648.0f);
+        }
+    }
+
+    template <SampleFormat F>
+    inline void writeFloat(uint8_t* p, float v, uint32_t* dither)
+    {
+        if constexpr (F == SampleFormat::F32) {
+            memcpy(p, &v, 4);
+        }
+        else if constexpr (F == SampleFormat::U8 || F == SampleFormat::S16) {
+            // Dithered and saturated
+            constexpr float scale = F == SampleFormat::U8 ? 128.0f : 32768.0f;
+            const float s = std::nearbyint(v * scale + tpdf(dither));
+            const float clamped = std::min(std::max(s, -scale), scale - 1.0f);
+            writeInt<F>(p, static_cast<int32_t>(clamped) * static_cast<int32_t>(2147483648.0f / scale));
+        }
+        else if constexpr (F == SampleFormat::S24) {
+            const float s = std::nearbyint(v * 8388608.0f);
+            writeInt<F>(p, static_cast<int32_t>(std::min(std::max(s, -8388608.0f), 8388607.0f)) * 256);
+        }
+        else {
+            // 2147483520 is the largest float below 2^31
+            const float s = std::nearbyint(std::min(std::max(v * 2147483648.0f, -2147483648.0f), 2147483520.0f));
+            writeInt<F>(p, static_cast<int32_t>(s));
+        }
+    }
+
+#ifdef OBS_HAVE_AVX2
+    // 8 samples per step: one shuffle per 128-bit lane moves each 3-byte sample into
+    // the top of a dword. Reads 4 bytes past the samples used, so the caller keeps a
+    // margin of two samples.
+    OBS_TARGET_AVX2 size_t s24ToF32Avx2(const uint8_t* src, float* dst, size_t count)
+    {
+        const __m256i shuffle = _mm256_setr_epi8(
+            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+        const __m256 scale = _mm256_set1_ps(1.0f / 8388608.0f);
+
+        size_t i = 0;
+        for (; i + 10 <= count; i += 8) {
+            const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+            const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 12));
+            const __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            const __m256i samples = _mm256_srai_epi32(_mm256_shuffle_epi8(bytes, shuffle), 8);
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+        }
+        return i;
+    }
+#endif
+
+    // Converts a contiguous run of samples; both sides have the same layout
+    template <SampleFormat S, SampleFormat D>
+    void convertRun(const uint8_t* src, uint8_t* dst, size_t count, uint32_t* dither)
+    {
+        constexpr int sb = sampleBytes<S>();
+        constexpr int db = sampleBytes<D>();
+        size_t i = 0;
+
+        if constexpr (S == D) {
+            memcpy(dst, src, count * sb);
+            return;
+        }
+#ifdef OBS_HAVE_SSE2
+        else if constexpr (S == SampleFormat::S16 && D == SampleFormat::F32) {
+            if (useSse2()) {
+                const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+                const __m128i zero = _mm_setzero_si128();
+                float* out = reinterpret_cast<float*>(dst);
+                for (; i + 8 <= count; i += 8) {
+                    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+                    const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(zero, v), 16);
+                    const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(zero, v), 16);
+                    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+                    _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+                }
+            }
+        }
+        else if constexpr (S == SampleFormat::F32 && D == SampleFormat::S16) {
+            if (useSse2()) {
+                // TPDF dither from two 4-lane xorshift generators, saturating pack
+                const __m128 scale = _mm_set1_ps(32768.0f);
+                const __m128 lsb = _mm_set1_ps(1.0f / 4294967296.0f);
+                const __m128 minimum = _mm_set1_ps(-32768.0f);
+                const __m128 maximum = _mm_set1_ps(32767.0f);
+                __m128i stateA = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dither));
+                __m128i stateB = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dither + 4));
+                auto next = [](__m128i& s) {
+                    s = _mm_xor_si128(s, _mm_slli_epi32(s, 13));
+                    s = _mm_xor_si128(s, _mm_srli_epi32(s, 17));
+                    s = _mm_xor_si128(s, _mm_slli_epi32(s, 5));
+                    return _mm_cvtepi32_ps(s);
+                };
+                auto quantize = [&](__m128 x) {
+                    const __m128 noise = _mm_mul_ps(_mm_add_ps(next(stateA), next(stateB)), lsb);
+                    const __m128 v = _mm_add_ps(_mm_mul_ps(x, scale), noise);
+                    return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(v, minimum), maximum));
+                };
+                const float* in = reinterpret_cast<const float*>(src);
+                for (; i + 8 <= count; i += 8) {
+                    const __m128i lo = quantize(_mm_loadu_ps(in + i));
+                    const __m128i hi = quantize(_mm_loadu_ps(in + i + 4));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), _mm_packs_epi32(lo, hi));
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dither), stateA);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dither + 4), stateB);
+            }
+        }
+        else if constexpr (S == SampleFormat::S32 && D == SampleFormat::F32) {
+            if (useSse2()) {
+                const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+                float* out = reinterpret_cast<float*>(dst);
+                for (; i + 4 <= count; i += 4) {
+                    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+                    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+                }
+            }
+        }
+        else if constexpr (S == SampleFormat::F32 && D == SampleFormat::S32) {
+            if (useSse2()) {
+                const __m128 scale = _mm_set1_ps(2147483648.0f);
+                const __m128 lo = _mm_set1_ps(-2147483648.0f);
+                const __m128 hi = _mm_set1_ps(2147483520.0f);
+                const float* in = reinterpret_cast<const float*>(src);
+                for (; i + 4 <= count; i += 4) {
+                    const __m128 v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), lo), hi);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_cvtps_epi32(v));
+                }
+            }
+        }
+#endif
+#ifdef OBS_HAVE_AVX2
+        if constexpr (S == SampleFormat::S24 && D == SampleFormat::F32) {
+            if (useAvx2()) {
+                i = s24ToF32Avx2(src, reinterpret_cast<float*>(dst), count);
+            }
+        }
+#endif
+
+        for (; i < count; i++) {
+            if constexpr (isInteger(S) && isInteger(D)) {
+                writeInt<D>(dst + i * db, readInt<S>(src + i * sb));
+            }
+            else {
+                writeFloat<D>(dst + i * db, readFloat<S>(src + i * sb), dither);
+            }
+        }
+    }
+
+    // Byte shuffles between one interleaved buffer and per-channel planes
+    template <int Bytes>
+    void deinterleave(const uint8_t* src, uint8_t* const* planes, size_t offset, int frames, int channels)
+    {
+#ifdef OBS_HAVE_SSE2
+        if constexpr (Bytes == 4) {
+            if (channels == 2 && useSse2()) {
+                const float* in = reinterpret_cast<const float*>(src);
+                float* left = reinterpret_cast<float*>(planes[0] + offset * 4);
+                float* right = reinterpret_cast<float*>(planes[1] + offset * 4);
+                int i = 0;
+                for (; i + 4 <= frames; i += 4) {
+                    const __m128 a = _mm_loadu_ps(in + i * 2);
+                    const __m128 b = _mm_loadu_ps(in + i * 2 + 4);
+                    _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+                    _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+                }
+                for (; i < frames; i++) {
+                    left[i] = in[i * 2];
+                    right[i] = in[i * 2 + 1];
+                }
+                return;
+            }
+        }
+#endif
+        for (int c = 0; c < channels; c++) {
+            const uint8_t* in = src + c * Bytes;
+            uint8_t* out = planes[c] + offset * Bytes;
+            for (int i = 0; i < frames; i++, in += channels * Bytes, out += Bytes) {
+                memcpy(out, in, Bytes);
+            }
+        }
+    }
+
+    template <int Bytes>
+    void interleave(const uint8_t* const* planes, size_t offset, uint8_t* dst, int frames, int channels)
+    {
+#ifdef OBS_HAVE_SSE2
+        if constexpr (Bytes == 4) {
+            if (channels == 2 && useSse2()) {
+                const float* left = reinterpret_cast<const float*>(planes[0] + offset * 4);
+                const float* right = reinterpret_cast<const float*>(planes[1] + offset * 4);
+                float* out = reinterpret_cast<float*>(dst);
+                int i = 0;
+                for (; i + 4 <= frames; i += 4) {
+                    const __m128 l = _mm_loadu_ps(left + i);
+                    const __m128 r = _mm_loadu_ps(right + i);
+                    _mm_storeu_ps(out + i * 2, _mm_unpacklo_ps(l, r));
+                    _mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(l, r));
+                }
+                for (; i < frames; i++) {
+                    out[i * 2] = left[i];
+                    out[i * 2 + 1] = right[i];
+                }
+                return;
+            }
+        }
+#endif
+        for (int c = 0; c < channels; c++) {
+            const uint8_t* in = planes[c] + offset * Bytes;
+            uint8_t* out = dst + c * Bytes;
+            for (int i = 0; i < frames; i++, in += Bytes, out += channels * Bytes) {
+                memcpy(out, in, Bytes);
+            }
+        }
+    }
+
+    template <SampleFormat S, SampleFormat D, bool SrcPlanar, bool DstPlanar>
+    void convertKernel(const Job& job)
+    {
+        constexpr int sb = sampleBytes<S>();
+        constexpr int db = sampleBytes<D>();
+        const int channels = job.channels;
+
+        if constexpr (!SrcPlanar && !DstPlanar) {
+            convertRun<S, D>(job.src[0], job.dst[0], static_cast<size_t>(job.frames) * channels, job.dither);
+        }
+        else if constexpr (SrcPlanar && DstPlanar) {
+            for (int c = 0; c < channels; c++) {
+                convertRun<S, D>(job.src[c], job.dst[c], job.frames, job.dither);
+            }
+        }
+        else if constexpr (!SrcPlanar) {
+            // Convert a chunk while still interleaved, then split it into the planes
+            alignas(16) uint8_t scratch[kChunkFrames * SampleConverter::kMaxChannels * 4];
+            for (int f = 0; f < job.frames; f += kChunkFrames) {
+                const int n = std::min(kChunkFrames, job.frames - f);
+                convertRun<S, D>(job.src[0] + static_cast<size_t>(f) * channels * sb, scratch,
+                    static_cast<size_t>(n) * channels, job.dither);
+                deinterleave<db>(scratch, job.dst, f, n, channels);
+            }
+        }
+        else {
+            // Gather a chunk from the planes, then convert it interleaved
+            alignas(16) uint8_t scratch[kChunkFrames * SampleConverter::kMaxChannels * 4];
+            for (int f = 0; f < job.frames; f += kChunkFrames) {
+                const int n = std::min(kChunkFrames, job.frames - f);
+                interleave<sb>(job.src, f, scratch, n, channels);
+                convertRun<S, D>(scratch, job.dst[0] + static_cast<size_t>(f) * channels * db,
+                    static_cast<size_t>(n) * channels, job.dither);
+            }
+        }
+    }
+
+    using Kernel = void (*)(const Job&);
+
+    template <SampleFormat S, SampleFormat D>
+    Kernel pickLayout(bool srcPlanar, bool dstPlanar)
+    {
+        if (srcPlanar) {
+            return dstPlanar ? &convertKernel<S, D, true, true> : &convertKernel<S, D, true, false>;
+        }
+        return dstPlanar ? &convertKernel<S, D, false, true> : &convertKernel<S, D, false, false>;
+    }
+
+    template <SampleFormat S>
+    Kernel pickDestination(SampleFormat dst, bool srcPlanar, bool dstPlanar)
+    {
+        switch (dst) {
+        case SampleFormat::U8: return pickLayout<S, SampleFormat::U8>(srcPlanar, dstPlanar);
+        case SampleFormat::S16: return pickLayout<S, SampleFormat::S16>(srcPlanar, dstPlanar);
+        case SampleFormat::S24: return pickLayout<S, SampleFormat::S24>(srcPlanar, dstPlanar);
+        case SampleFormat::S32: return pickLayout<S, SampleFormat::S32>(srcPlanar, dstPlanar);
+        case SampleFormat::F32: return pickLayout<S, SampleFormat::F32>(srcPlanar, dstPlanar);
+        }
+        return nullptr;
+    }
+}
+
+int bytesPerSample(SampleFormat format)
+{
+    switch (format) {
+    case SampleFormat::U8: return 1;
+    case SampleFormat::S16: return 2;
+    case SampleFormat::S24: return 3;
+    case SampleFormat::S32: return 4;
+    case SampleFormat::F32: return 4;
+    }
+    return 0;
+}
+
+bool SampleConverter::configure(SampleFormat srcFormat, bool srcPlanar, SampleFormat dstFormat, bool dstPlanar, int channels)
+{
+    m_kernel = nullptr;
+    m_channels = 0;
+    if (channels < 1 || channels > kMaxChannels) {
+        return false;
+    }
+
+    switch (srcFormat) {
+    case SampleFormat::U8: m_kernel = pickDestination<SampleFormat::U8>(dstFormat, srcPlanar, dstPlanar); break;
+    case SampleFormat::S16: m_kernel = pickDestination<SampleFormat::S16>(dstFormat, srcPlanar, dstPlanar); break;
+    case SampleFormat::S24: m_kernel = pickDestination<SampleFormat::S24>(dstFormat, srcPlanar, dstPlanar); break;
+    case SampleFormat::S32: m_kernel = pickDestination<SampleFormat::S32>(dstFormat, srcPlanar, dstPlanar); break;
+    case SampleFormat::F32: m_kernel = pickDestination<SampleFormat::F32>(dstFormat, srcPlanar, dstPlanar); break;
+    }
+
+    if (m_kernel) {
+        m_channels = channels;
+    }
+    return m_kernel != nullptr;
+}
+
+void SampleConverter::convert(const void* const* src, void* const* dst, int frames)
+{
+    if (!m_kernel || frames <= 0) {
+        return;
+    }
+
+    Job job;
+    job.src = reinterpret_cast<const uint8_t* const*>(src);
+    job.dst = reinterpret_cast<uint8_t* const*>(dst);
+    job.frames = frames;
+    job.channels = m_channels;
+    job.dither = m_dither;
+    m_kernel(job);
+}
@@ -0,0 +1,164 @@
+#include "incl/Scaler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr int kWeightBits = 14;
+    constexpr int kWeightOne = 1 << kWeightBits;
+
+    // The vertical pass keeps 8 extra bits of precision in a 16-bit intermediate row
+    constexpr int kIntermediateShift = kWeightBits - 8;
+    constexpr int kFinalShift = kWeightBits + 8;
+}
+
+bool Scaler::configure(int srcWidth, int srcHeight, int dstWidth, int dstHeight)
+{
+    if (srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0) {
+        return false;
+    }
+
+    if (srcWidth == m_srcWidth && srcHeight == m_srcHeight &&
+        dstWidth == m_dstWidth && dstHeight == m_dstHeight) {
+        return true;
+    }
+
+    m_srcWidth = srcWidth;
+    m_srcHeight = srcHeight;
+    m_dstWidth = dstWidth;
+    m_dstHeight = dstHeight;
+
+    buildTaps(srcWidth, dstWidth, m_xTaps, m_xWeights);
+    buildTaps(srcHeight, dstHeight, m_yTaps, m_yWeights);
+    return true;
+}
+
+void Scaler::buildTaps(int srcSize, int dstSize, std::vector<Taps>& taps, std::vector<int16_t>& weights)
+{
+    taps.assign(dstSize, Taps());
+    weights.clear();
+
+    const double scale = static_cast<double>(srcSize) / dstSize;
+    std::vector<double> contribution;
+
+    for (int i = 0; i < dstSize; i++) {
+        int first = 0;
+        contribution.clear();
+
+        if (scale > 1.0) {
+            // Area average over the source span covered by this output pixel
+            double start = i * scale;
+            double end = start + scale;
+            first = static_cast<int>(std::floor(start));
+            int last = std::min(static_cast<int>(std::ceil(end)), srcSize);
+            for (int j = first; j < last; j++) {
+                double overlap = std::min(end, j + 1.0) - std::max(start, static_cast<double>(j));
+                contribution.push_back(overlap / scale);
+            }
+        }
+        else {
+            // Bilinear between the two nearest source pixels
+            double center = (i + 0.5) * scale - 0.5;
+            int left = static_cast<int>(std::floor(center));
+            double frac = center - left;
+            int right = left + 1;
+            left = std::clamp(left, 0, srcSize - 1);
+            right = std::clamp(right, 0, srcSize - 1);
+            first = left;
+            if (left == right || frac == 0.0) {
+                contribution.push_back(1.0);
+            }
+            else {
+                contribution.push_back(1.0 - frac);
+                contribution.push_back(frac);
+            }
+        }
+
+        // Quantize, folding the rounding error into the largest weight so they sum exactly to one
+        Taps& t = taps[i];
+        t.first = first;
+        t.count = static_cast<int>(contribution.size());
+        t.offset = static_cast<int>(weights.size());
+
+        int sum = 0;
+        int largest = 0;
+        for (int k = 0; k < t.count; k++) {
+            int w = static_cast<int>(std::lround(contribution[k] * kWeightOne));
+            weights.push_back(static_cast<int16_t>(w));
+            sum += w;
+            if (w > weights[t.offset + largest]) {
+                largest = k;
+            }
+        }
+        weights[t.offset + largest] = static_cast<int16_t>(weights[t.offset + largest] + (kWeightOne - sum));
+    }
+}
+
+void Scaler::sourceRows(int dstY, int* first, int* last) const
+{
+    const Taps& t = m_yTaps[dstY];
+    *first = t.first;
+    *last = t.first + t.count;
+}
+
+void Scaler::scaleRows(const FrameView& src, const FrameView& dst, int dstY0, int dstY1) const
+{
+    const int rowValues = m_srcWidth * 4;
+
+    // Per-thread scratch so strips can run concurrently without reallocating
+    thread_local std::vector<uint32_t> accum;
+    thread_local std::vector<uint16_t> intermediate;
+    accum.resize(rowValues);
+    intermediate.resize(rowValues);
+
+    for (int y = dstY0; y < dstY1; y++) {
+        // Vertical pass: weighted sum of the covered source rows
+        const Taps& ty = m_yTaps[y];
+        const int16_t* wy = &m_yWeights[ty.offset];
+
+        std::fill(accum.begin(), accum.end(), 0u);
+        for (int k = 0; k < ty.count; k++) {
+            const uint8_t* srcRow = src.row(ty.first + k);
+            const uint32_t w = static_cast<uint32_t>(wy[k]);
+            uint32_t* acc = accum.data();
+            for (int i = 0; i < rowValues; i++) {
+                acc[i] += srcRow[i] * w;
+            }
+        }
+
+        const uint32_t round = 1u << (kIntermediateShift - 1);
+        for (int i = 0; i < rowValues; i++) {
+            intermediate[i] = static_cast<uint16_t>((accum[i] + round) >> kIntermediateShift);
+        }
+
+        // Horizontal pass into the destination row
+        uint8_t* dstRow = dst.row(y);
+        const uint16_t* in = intermediate.data();
+        for (int x = 0; x < m_dstWidth; x++) {
+            const Taps& tx = m_xTaps[x];
+            const int16_t* wx = &m_xWeights[tx.offset];
+            const uint16_t* px = in + tx.first * 4;
+
+            uint32_t b = 0, g = 0, r = 0, a = 0;
+            for (int k = 0; k < tx.count; k++) {
+                const uint32_t w = static_cast<uint32_t>(wx[k]);
+                b += px[0] * w;
+                g += px[1] * w;
+                r += px[2] * w;
+                a += px[3] * w;
+                px += 4;
+            }
+
+            const uint32_t finalRound = 1u << (kFinalShift - 1);
+            dstRow[0] = static_cast<uint8_t>(std::min<uint32_t>((b + finalRound) >> kFinalShift, 255));
+            dstRow[1] = static_cast<uint8_t>(std::min<uint32_t>((g + finalRound) >> kFinalShift, 255));
+            dstRow[2] = static_cast<uint8_t>(std::min<uint32_t>((r + finalRound) >> kFinalShift, 255));
+            dstRow[3] = static_cast<uint8_t>(std::min<uint32_t>((a + finalRound) >> kFinalShift, 255));
+            dstRow += 4;
+        }
+    }
+}
+
+void Scaler::scale(const FrameView& src, const FrameView& dst) const
+{
+    scaleRows(src, dst, 0, m_dstHeight);
+}
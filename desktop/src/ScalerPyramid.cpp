@@ -0,0 +1,196 @@
+#include "incl/ScalerPyramid.h"
+#include "incl/FrameChangeDetector.h"
+#include "incl/ThreadPool.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+#include <numeric>
+
+namespace {
+    // A level is only derived from a larger one when that one is at least this much
+    // bigger on both axes. Closer sizes would stack two blurs with no bandwidth win.
+    constexpr double kMinDeriveRatio = 1.4;
+
+    // Output rows per strip handed to a worker
+    constexpr int kStripRows = 16;
+
+    bool canDerive(const Rendition& parent, const Rendition& child)
+    {
+        if (parent.width == child.width && parent.height == child.height) {
+            return true;
+        }
+        return parent.width >= child.width * kMinDeriveRatio &&
+               parent.height >= child.height * kMinDeriveRatio;
+    }
+}
+
+bool ScalerPyramid::configure(int srcWidth, int srcHeight, const std::vector<Rendition>& renditions)
+{
+    if (srcWidth <= 0 || srcHeight <= 0 || renditions.empty()) {
+        return false;
+    }
+
+    for (const Rendition& r : renditions) {
+        if (r.width <= 0 || r.height <= 0) {
+            return false;
+        }
+    }
+
+    m_srcWidth = srcWidth;
+    m_srcHeight = srcHeight;
+    m_levels.clear();
+    m_levels.resize(renditions.size());
+    m_sourceLevels.clear();
+    m_derivedOrder.clear();
+    m_hasOutput = false;
+
+    // Plan from the largest rendition down so parents are always planned first
+    std::vector<int> order(renditions.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return renditions[a].width * renditions[a].height > renditions[b].width * renditions[b].height;
+    });
+
+    std::vector<int> planned;
+    for (int index : order) {
+        Level& level = m_levels[index];
+        level.size = renditions[index];
+        level.parent = -1;
+
+        // Prefer the smallest already planned level that still preserves quality
+        for (auto it = planned.rbegin(); it != planned.rend(); ++it) {
+            if (canDerive(m_levels[*it].size, level.size)) {
+                level.parent = *it;
+                break;
+            }
+        }
+
+        if (level.parent < 0) {
+            level.scaler.configure(srcWidth, srcHeight, level.size.width, level.size.height);
+            m_sourceLevels.push_back(index);
+        }
+        else {
+            const Rendition& p = m_levels[level.parent].size;
+            level.scaler.configure(p.width, p.height, level.size.width, level.size.height);
+            m_derivedOrder.push_back(index);
+        }
+
+        level.output.resize(level.size.width, level.size.height);
+        level.rowChanged.assign(level.size.height, 1);
+        planned.push_back(index);
+    }
+
+    return true;
+}
+
+FrameView ScalerPyramid::level(int index)
+{
+    return m_levels[index].output.view();
+}
+
+int ScalerPyramid::parentOf(int index) const
+{
+    return m_levels[index].parent;
+}
+
+void ScalerPyramid::process(const FrameView& src, ThreadPool* pool, const ChangeMap* changes)
+{
+    TraceScope trace("scale");
+    if (!src.isValid() || src.width != m_srcWidth || src.height != m_srcHeight) {
+        return;
+    }
+
+    // Nothing to keep until every level has been written once
+    if (!m_hasOutput) {
+        changes = nullptr;
+    }
+
+    processSourceLevels(src, pool, changes);
+
+    for (int index : m_derivedOrder) {
+        processDerivedLevel(index, pool);
+    }
+
+    m_hasOutput = true;
+}
+
+void ScalerPyramid::processSourceLevels(const FrameView& src, ThreadPool* pool, const ChangeMap* changes)
+{
+    if (m_sourceLevels.empty()) {
+        return;
+    }
+
+    // Strip s covers the same fraction of every source level, so all of them read
+    // the same band of source rows while it is still in cache
+    int tallest = 0;
+    for (int index : m_sourceLevels) {
+        tallest = std::max(tallest, m_levels[index].size.height);
+    }
+    const int strips = std::max(1, (tallest + kStripRows - 1) / kStripRows);
+
+    auto scaleStrips = [&](int begin, int end) {
+        for (int s = begin; s < end; s++) {
+            for (int index : m_sourceLevels) {
+                Level& level = m_levels[index];
+                const int h = level.size.height;
+                const int y0 = static_cast<int>(static_cast<long long>(h) * s / strips);
+                const int y1 = static_cast<int>(static_cast<long long>(h) * (s + 1) / strips);
+                if (y0 >= y1) {
+                    continue;
+                }
+
+                int first = 0, last = 0, unused = 0;
+                level.scaler.sourceRows(y0, &first, &unused);
+                level.scaler.sourceRows(y1 - 1, &unused, &last);
+                const bool changed = !changes || changes->rowsChanged(first, last);
+
+                std::fill(level.rowChanged.begin() + y0, level.rowChanged.begin() + y1, changed ? 1 : 0);
+                if (changed) {
+                    level.scaler.scaleRows(src, level.output.view(), y0, y1);
+                }
+            }
+        }
+    };
+
+    if (pool) {
+        pool->parallelFor(strips, scaleStrips);
+    }
+    else {
+        scaleStrips(0, strips);
+    }
+}
+
+void ScalerPyramid::processDerivedLevel(int index, ThreadPool* pool)
+{
+    Level& level = m_levels[index];
+    const Level& parentLevel = m_levels[level.parent];
+    const FrameView parent = m_levels[level.parent].output.view();
+    const FrameView output = level.output.view();
+    const int h = level.size.height;
+    const int strips = (h + kStripRows - 1) / kStripRows;
+
+    auto scaleStrips = [&](int begin, int end) {
+        for (int s = begin; s < end; s++) {
+            const int y0 = s * kStripRows;
+            const int y1 = std::min(y0 + kStripRows, h);
+
+            // Only rescale when one of the parent rows this strip reads was rewritten
+            int first = 0, last = 0, unused = 0;
+            level.scaler.sourceRows(y0, &first, &unused);
+            level.scaler.sourceRows(y1 - 1, &unused, &last);
+            const bool changed = std::any_of(parentLevel.rowChanged.begin() + first,
+                parentLevel.rowChanged.begin() + last, [](uint8_t c) { return c != 0; });
+
+            std::fill(level.rowChanged.begin() + y0, level.rowChanged.begin() + y1, changed ? 1 : 0);
+            if (changed) {
+                level.scaler.scaleRows(parent, output, y0, y1);
+            }
+        }
+    };
+
+    if (pool) {
+        pool->parallelFor(strips, scaleStrips);
+    }
+    else {
+        scaleStrips(0, strips);
+    }
+}
@@ -0,0 +1,531 @@
+#include "incl/SceneCompositor.h"
+#include "incl/Simd.h"
+#include "incl/ThreadPool.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace {
+    constexpr uint32_t kBackground = 0xFF000000; // opaque black
+    constexpr int kPrepareStripRows = 16;
+
+    SceneRect intersect(const SceneRect& a, const SceneRect& b)
+    {
+        SceneRect r;
+        r.x = std::max(a.x, b.x);
+        r.y = std::max(a.y, b.y);
+        r.width = std::min(a.x + a.width, b.x + b.width) - r.x;
+        r.height = std::min(a.y + a.height, b.y + b.height) - r.y;
+        if (r.isEmpty()) {
+            return SceneRect();
+        }
+        return r;
+    }
+
+    SceneRect unite(const SceneRect& a, const SceneRect& b)
+    {
+        if (a.isEmpty()) return b;
+        if (b.isEmpty()) return a;
+        SceneRect r;
+        r.x = std::min(a.x, b.x);
+        r.y = std::min(a.y, b.y);
+        r.width = std::max(a.x + a.width, b.x + b.width) - r.x;
+        r.height = std::max(a.y + a.height, b.y + b.height) - r.y;
+        return r;
+    }
+
+    bool contains(const SceneRect& outer, const SceneRect& inner)
+    {
+        return inner.x >= outer.x && inner.y >= outer.y &&
+               inner.x + inner.width <= outer.x + outer.width &&
+               inner.y + inner.height <= outer.y + outer.height;
+    }
+
+    int opacity256(float opacity)
+    {
+        return static_cast<int>(std::lround(std::clamp(opacity, 0.0f, 1.0f) * 256.0f));
+    }
+
+    inline uint32_t div255(uint32_t x)
+    {
+        x += 128;
+        return (x + (x >> 8)) >> 8;
+    }
+
+    // dst = src * opacity + dst * (1 - srcAlpha * opacity), all premultiplied
+    inline uint32_t blendPixel(uint32_t d, uint32_t s, uint32_t op)
+    {
+        uint32_t sb = ((s & 0xFF) * op) >> 8;
+        uint32_t sg = (((s >> 8) & 0xFF) * op) >> 8;
+        uint32_t sr = (((s >> 16) & 0xFF) * op) >> 8;
+        uint32_t sa = ((s >> 24) * op) >> 8;
+        uint32_t inv = 255 - sa;
+
+        uint32_t b = sb + div255((d & 0xFF) * inv);
+        uint32_t g = sg + div255(((d >> 8) & 0xFF) * inv);
+        uint32_t r = sr + div255(((d >> 16) & 0xFF) * inv);
+        uint32_t a = sa + div255((d >> 24) * inv);
+        return b | (g << 8) | (r << 16) | (a << 24);
+    }
+
+#ifdef OBS_HAVE_SSE2
+    inline __m128i div255Epi16(__m128i x)
+    {
+        x = _mm_add_epi16(x, _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    }
+
+    // Blend two premultiplied pixels held as 16-bit lanes
+    inline __m128i blendEpi16(__m128i d, __m128i s, __m128i op)
+    {
+        s = _mm_srli_epi16(_mm_mullo_epi16(s, op), 8);
+        __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+        return _mm_add_epi16(s, div255Epi16(_mm_mullo_epi16(d, inv)));
+    }
+#endif
+
+    void blendRow(uint32_t* dst, const uint32_t* src, int count, int op, bool forceOpaque)
+    {
+        const uint32_t alphaMask = forceOpaque ? 0xFF000000u : 0u;
+
+        // Fully opaque source at full opacity is a plain copy
+        if (forceOpaque && op >= 256) {
+            int i = 0;
+#ifdef OBS_HAVE_SSE2
+            if (useSse2()) {
+                const __m128i mask = _mm_set1_epi32(static_cast<int>(alphaMask));
+                for (; i + 4 <= count; i += 4) {
+                    __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(s, mask));
+                }
+            }
+#endif
+            for (; i < count; i++) {
+                dst[i] = src[i] | alphaMask;
+            }
+            return;
+        }
+
+        int i = 0;
+#ifdef OBS_HAVE_SSE2
+        if (useSse2()) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i mask = _mm_set1_epi32(static_cast<int>(alphaMask));
+            const __m128i opv = _mm_set1_epi16(static_cast<short>(op));
+            for (; i + 4 <= count; i += 4) {
+                __m128i s = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), mask);
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+                __m128i lo = blendEpi16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), opv);
+                __m128i hi = blendEpi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), opv);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+            }
+        }
+#endif
+        for (; i < count; i++) {
+            dst[i] = blendPixel(dst[i], src[i] | alphaMask, static_cast<uint32_t>(op));
+        }
+    }
+
+    // Blend one premultiplied color (opacity already applied) over a row
+    void blendSolidRow(uint32_t* dst, uint32_t color, int count)
+    {
+        if ((color >> 24) == 255) {
+            std::fill(dst, dst + count, color);
+            return;
+        }
+
+        int i = 0;
+#ifdef OBS_HAVE_SSE2
+        if (useSse2()) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i opv = _mm_set1_epi16(256);
+            const __m128i s16 = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(color)), zero);
+            for (; i + 4 <= count; i += 4) {
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+                __m128i lo = blendEpi16(_mm_unpacklo_epi8(d, zero), s16, opv);
+                __m128i hi = blendEpi16(_mm_unpackhi_epi8(d, zero), s16, opv);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+            }
+        }
+#endif
+        for (; i < count; i++) {
+            dst[i] = blendPixel(dst[i], color, 256);
+        }
+    }
+
+    void premultiplyRow(uint32_t* row, int count)
+    {
+        for (int i = 0; i < count; i++) {
+            uint32_t p = row[i];
+            uint32_t a = p >> 24;
+            if (a == 255) {
+                continue;
+            }
+            uint32_t b = div255((p & 0xFF) * a);
+            uint32_t g = div255(((p >> 8) & 0xFF) * a);
+            uint32_t r = div255(((p >> 16) & 0xFF) * a);
+            row[i] = b | (g << 8) | (r << 16) | (a << 24);
+        }
+    }
+
+    // Straight 0xAARRGGBB color to premultiplied with layer opacity applied
+    uint32_t premultipliedColor(uint32_t color, int op)
+    {
+        uint32_t a = ((color >> 24) * static_cast<uint32_t>(op)) >> 8;
+        uint32_t b = div255((color & 0xFF) * a);
+        uint32_t g = div255(((color >> 8) & 0xFF) * a);
+        uint32_t r = div255(((color >> 16) & 0xFF) * a);
+        return b | (g << 8) | (r << 16) | (a << 24);
+    }
+}
+
+void SceneCompositor::setCanvasSize(int width, int height)
+{
+    if (width == m_canvas.width() && height == m_canvas.height()) {
+        return;
+    }
+
+    m_canvas.resize(width, height);
+    m_tilesX = (width + kTileSize - 1) / kTileSize;
+    m_tilesY = (height + kTileSize - 1) / kTileSize;
+    m_dirtyTiles.assign(static_cast<size_t>(m_tilesX) * m_tilesY, 1);
+}
+
+SceneCompositor::LayerState* SceneCompositor::findLayer(int id)
+{
+    for (LayerState& state : m_layers) {
+        if (state.id == id) {
+            return &state;
+        }
+    }
+    return nullptr;
+}
+
+SceneRect SceneCompositor::sourceRect(const SceneLayer& layer) const
+{
+    SceneRect whole{ 0, 0, layer.source.width, layer.source.height };
+    if (layer.crop.isEmpty()) {
+        return whole;
+    }
+    return intersect(layer.crop, whole);
+}
+
+int SceneCompositor::addLayer(const SceneLayer& layer)
+{
+    LayerState state;
+    state.id = m_nextId++;
+    state.layer = layer;
+    m_layers.push_back(std::move(state));
+
+    LayerState& added = m_layers.back();
+    markContentDirty(added, SceneRect{ 0, 0, layer.dest.width, layer.dest.height });
+    return added.id;
+}
+
+void SceneCompositor::setLayer(int id, const SceneLayer& layer)
+{
+    LayerState* state = findLayer(id);
+    if (!state) {
+        return;
+    }
+
+    const SceneLayer old = state->layer;
+    state->layer = layer;
+
+    const bool contentChanged =
+        old.kind != layer.kind ||
+        old.source.data != layer.source.data ||
+        old.source.width != layer.source.width ||
+        old.source.height != layer.source.height ||
+        old.source.stride != layer.source.stride ||
+        old.premultiplied != layer.premultiplied ||
+        old.opaque != layer.opaque ||
+        old.crop != layer.crop ||
+        old.color != layer.color ||
+        old.dest.width != layer.dest.width ||
+        old.dest.height != layer.dest.height;
+
+    const bool placementChanged =
+        old.dest != layer.dest ||
+        old.opacity != layer.opacity ||
+        old.visible != layer.visible;
+
+    if (contentChanged || placementChanged) {
+        markDirty(old.dest);
+        markDirty(layer.dest);
+    }
+
+    if (contentChanged) {
+        markContentDirty(*state, SceneRect{ 0, 0, layer.dest.width, layer.dest.height });
+    }
+}
+
+void SceneCompositor::removeLayer(int id)
+{
+    for (auto it = m_layers.begin(); it != m_layers.end(); ++it) {
+        if (it->id == id) {
+            markDirty(it->layer.dest);
+            m_layers.erase(it);
+            return;
+        }
+    }
+}
+
+void SceneCompositor::markContentChanged(int id)
+{
+    LayerState* state = findLayer(id);
+    if (state) {
+        markContentDirty(*state, SceneRect{ 0, 0, state->layer.dest.width, state->layer.dest.height });
+    }
+}
+
+void SceneCompositor::markContentChanged(int id, const SceneRect& rect)
+{
+    LayerState* state = findLayer(id);
+    if (!state) {
+        return;
+    }
+
+    const SceneLayer& layer = state->layer;
+    const SceneRect src = sourceRect(layer);
+    const SceneRect changed = intersect(rect, src);
+    if (changed.isEmpty() || layer.dest.isEmpty()) {
+        return;
+    }
+
+    // Map into destination space, padded for the resampling footprint: bilinear
+    // upscaling spreads one source pixel over about scale / 2 output pixels each way
+    const double sx = static_cast<double>(layer.dest.width) / src.width;
+    const double sy = static_cast<double>(layer.dest.height) / src.height;
+    const bool sameSize = src.width == layer.dest.width && src.height == layer.dest.height;
+    const int pad = sameSize ? 0 : static_cast<int>(std::ceil(std::max(sx, sy) / 2.0)) + 1;
+    SceneRect mapped;
+    mapped.x = static_cast<int>(std::floor((changed.x - src.x) * sx)) - pad;
+    mapped.y = static_cast<int>(std::floor((changed.y - src.y) * sy)) - pad;
+    mapped.width = static_cast<int>(std::ceil((changed.x + changed.width - src.x) * sx)) + pad - mapped.x;
+    mapped.height = static_cast<int>(std::ceil((changed.y + changed.height - src.y) * sy)) + pad - mapped.y;
+
+    markContentDirty(*state, intersect(mapped, SceneRect{ 0, 0, layer.dest.width, layer.dest.height }));
+}
+
+void SceneCompositor::markDirty(const SceneRect& canvasRect)
+{
+    const SceneRect r = intersect(canvasRect, SceneRect{ 0, 0, m_canvas.width(), m_canvas.height() });
+    if (r.isEmpty()) {
+        return;
+    }
+
+    const int tx0 = r.x / kTileSize;
+    const int ty0 = r.y / kTileSize;
+    const int tx1 = (r.x + r.width - 1) / kTileSize;
+    const int ty1 = (r.y + r.height - 1) / kTileSize;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            m_dirtyTiles[ty * m_tilesX + tx] = 1;
+        }
+    }
+}
+
+void SceneCompositor::markContentDirty(LayerState& state, const SceneRect& destRect)
+{
+    if (destRect.isEmpty()) {
+        return;
+    }
+
+    state.needsPrepare = true;
+    state.prepareRect = unite(state.prepareRect, destRect);
+
+    if (state.layer.visible) {
+        SceneRect onCanvas = destRect;
+        onCanvas.x += state.layer.dest.x;
+        onCanvas.y += state.layer.dest.y;
+        markDirty(onCanvas);
+    }
+}
+
+void SceneCompositor::prepareLayer(LayerState& state, ThreadPool* pool)
+{
+    const SceneLayer& layer = state.layer;
+    state.needsPrepare = false;
+
+    SceneRect rows = state.prepareRect;
+    state.prepareRect = SceneRect();
+
+    if (layer.kind != SceneLayer::Kind::Frame) {
+        return;
+    }
+
+    state.pixels = FrameView();
+    const SceneRect src = sourceRect(layer);
+    if (!layer.source.isValid() || src.isEmpty() || layer.dest.isEmpty()) {
+        return;
+    }
+
+    const FrameView cropped(layer.source.row(src.y) + src.x * 4, src.width, src.height, layer.source.stride);
+    const bool sameSize = src.width == layer.dest.width && src.height == layer.dest.height;
+    const bool premultiplied = layer.premultiplied || layer.opaque;
+
+    state.pixelsOpaque = layer.opaque;
+
+    // Already in the right form: blend straight from the source
+    if (sameSize && premultiplied) {
+        state.pixels = cropped;
+        return;
+    }
+
+    if (state.prepared.width() != layer.dest.width || state.prepared.height() != layer.dest.height) {
+        state.prepared.resize(layer.dest.width, layer.dest.height);
+        rows = SceneRect{ 0, 0, layer.dest.width, layer.dest.height };
+    }
+    state.pixels = state.prepared.view();
+
+    if (!sameSize) {
+        state.scaler.configure(src.width, src.height, layer.dest.width, layer.dest.height);
+    }
+
+    const FrameView out = state.pixels;
+    const int y0 = std::max(rows.y, 0);
+    const int y1 = std::min(rows.y + rows.height, out.height);
+    const int strips = (y1 - y0 + kPrepareStripRows - 1) / kPrepareStripRows;
+
+    auto prepareStrips = [&](int begin, int end) {
+        for (int s = begin; s < end; s++) {
+            const int a = y0 + s * kPrepareStripRows;
+            const int b = std::min(a + kPrepareStripRows, y1);
+            if (sameSize) {
+                for (int y = a; y < b; y++) {
+                    memcpy(out.row(y), cropped.row(y), static_cast<size_t>(out.width) * 4);
+                }
+            }
+            else {
+                state.scaler.scaleRows(cropped, out, a, b);
+            }
+            if (!premultiplied) {
+                for (int y = a; y < b; y++) {
+                    premultiplyRow(reinterpret_cast<uint32_t*>(out.row(y)), out.width);
+                }
+            }
+        }
+    };
+
+    if (pool) {
+        pool->parallelFor(strips, prepareStrips);
+    }
+    else {
+        prepareStrips(0, strips);
+    }
+}
+
+bool SceneCompositor::coversOpaque(const LayerState& state, const SceneRect& rect) const
+{
+    const SceneLayer& layer = state.layer;
+    if (!layer.visible || opacity256(layer.opacity) < 256 || !contains(layer.dest, rect)) {
+        return false;
+    }
+
+    if (layer.kind == SceneLayer::Kind::SolidColor) {
+        return (layer.color >> 24) == 255;
+    }
+    return state.pixels.isValid() && state.pixelsOpaque;
+}
+
+int SceneCompositor::compose(ThreadPool* pool)
+{
+    TraceScope trace("compose");
+    if (!m_canvas.view().isValid()) {
+        return 0;
+    }
+
+    for (LayerState& state : m_layers) {
+        if (state.needsPrepare) {
+            prepareLayer(state, pool);
+        }
+    }
+
+    m_dirtyList.clear();
+    for (int i = 0; i < static_cast<int>(m_dirtyTiles.size()); i++) {
+        if (m_dirtyTiles[i]) {
+            m_dirtyList.push_back(i);
+            m_dirtyTiles[i] = 0;
+        }
+    }
+
+    auto composeTiles = [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            composeTile(m_dirtyList[i]);
+        }
+    };
+
+    const int count = static_cast<int>(m_dirtyList.size());
+    if (pool) {
+        pool->parallelFor(count, composeTiles);
+    }
+    else {
+        composeTiles(0, count);
+    }
+
+    return count;
+}
+
+void SceneCompositor::composeTile(int tileIndex)
+{
+    const FrameView canvas = m_canvas.view();
+    const int tx = tileIndex % m_tilesX;
+    const int ty = tileIndex / m_tilesX;
+    const SceneRect tile = intersect(
+        SceneRect{ tx * kTileSize, ty * kTileSize, kTileSize, kTileSize },
+        SceneRect{ 0, 0, canvas.width, canvas.height });
+
+    // Start at the topmost layer that hides everything below it in this tile
+    int first = 0;
+    bool covered = false;
+    for (int i = static_cast<int>(m_layers.size()) - 1; i >= 0; i--) {
+        if (coversOpaque(m_layers[i], tile)) {
+            first = i;
+            covered = true;
+            break;
+        }
+    }
+
+    if (!covered) {
+        for (int y = tile.y; y < tile.y + tile.height; y++) {
+            uint32_t* row = reinterpret_cast<uint32_t*>(canvas.row(y)) + tile.x;
+            std::fill(row, row + tile.width, kBackground);
+        }
+    }
+
+    for (int i = first; i < static_cast<int>(m_layers.size()); i++) {
+        const LayerState& state = m_layers[i];
+        const SceneLayer& layer = state.layer;
+        if (!layer.visible) {
+            continue;
+        }
+
+        const SceneRect area = intersect(layer.dest, tile);
+        const int op = opacity256(layer.opacity);
+        if (area.isEmpty() || op == 0) {
+            continue;
+        }
+
+        if (layer.kind == SceneLayer::Kind::SolidColor) {
+            const uint32_t color = premultipliedColor(layer.color, op);
+            for (int y = area.y; y < area.y + area.height; y++) {
+                blendSolidRow(reinterpret_cast<uint32_t*>(canvas.row(y)) + area.x, color, area.width);
+            }
+            continue;
+        }
+
+        if (!state.pixels.isValid()) {
+            continue;
+        }
+
+        for (int y = area.y; y < area.y + area.height; y++) {
+            const uint32_t* src = reinterpret_cast<const uint32_t*>(state.pixels.row(y - layer.dest.y)) + (area.x - layer.dest.x);
+            uint32_t* dst = reinterpret_cast<uint32_t*>(canvas.row(y)) + area.x;
+            blendRow(dst, src, area.width, op, layer.opaque);
+        }
+    }
+}
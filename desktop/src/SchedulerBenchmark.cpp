@@ -0,0 +1,219 @@
+#include "incl/SchedulerBenchmark.h"
+#include "incl/TaskGraph.h"
+#include "incl/ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+namespace {
+    constexpr int kStripRows = 16;
+    constexpr int kWarmupFrames = 5;
+    constexpr int kAudioBlocks = 8;
+    constexpr int kAudioBlockFrames = 480; // 10 ms at 48 kHz
+
+    // Buffers for one synthetic frame; sizes follow the pipeline's (BGRA, 4:2:0 luma)
+    struct Frame
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<uint32_t> desktop;
+        std::vector<uint32_t> canvas;
+        std::vector<uint32_t> half;
+        std::vector<uint32_t> third;
+        std::vector<uint32_t> preview;
+        std::vector<uint8_t> luma;
+        std::vector<uint64_t> rowHashes;
+        std::vector<float> audio;
+        float audioState[4] = {};
+        int index = 0;
+
+        Frame(int w, int h)
+            : width(w), height(h),
+              desktop(static_cast<size_t>(w) * h), canvas(desktop.size()),
+              half(static_cast<size_t>(w / 2) * (h / 2)), third(static_cast<size_t>(w / 3) * (h / 3)),
+              preview(static_cast<size_t>(w / 2) * (h / 2)), luma(desktop.size()),
+              rowHashes(h), audio(static_cast<size_t>(kAudioBlocks) * kAudioBlockFrames * 2)
+        {
+            for (size_t i = 0; i < desktop.size(); i++) {
+                desktop[i] = static_cast<uint32_t>(i * 2654435761u) | 0xFF000000u;
+            }
+            for (size_t i = 0; i < audio.size(); i++) {
+                audio[i] = std::sin(static_cast<float>(i) * 0.01f);
+            }
+        }
+    };
+
+    int strips(int rows)
+    {
+        return (rows + kStripRows - 1) / kStripRows;
+    }
+
+    // Box-filter downscale of one channel set by an integer factor
+    void downscale(ThreadPool& pool, const uint32_t* src, int srcWidth, int srcHeight, uint32_t* dst, int factor)
+    {
+        const int dstWidth = srcWidth / factor;
+        const int dstHeight = srcHeight / factor;
+        pool.parallelFor(strips(dstHeight), [&](int begin, int end) {
+            for (int y = begin * kStripRows; y < std::min(end * kStripRows, dstHeight); y++) {
+                for (int x = 0; x < dstWidth; x++) {
+                    uint32_t sum[4] = {};
+                    for (int sy = 0; sy < factor; sy++) {
+                        const uint32_t* row = src + static_cast<size_t>(y * factor + sy) * srcWidth + x * factor;
+                        for (int sx = 0; sx < factor; sx++) {
+                            for (int c = 0; c < 4; c++) {
+                                sum[c] += (row[sx] >> (c * 8)) & 0xFF;
+                            }
+                        }
+                    }
+                    uint32_t out = 0;
+                    for (int c = 0; c < 4; c++) {
+                        out |= (sum[c] / (factor * factor)) << (c * 8);
+                    }
+                    dst[static_cast<size_t>(y) * dstWidth + x] = out;
+                }
+            }
+        });
+    }
+
+    void buildGraph(TaskGraph& graph, Frame& frame, ThreadPool& pool)
+    {
+        const int w = frame.width;
+        const int h = frame.height;
+
+        // A moving band of the desktop changes every frame
+        const int capture = graph.addTask("capture", [&frame, &pool, w, h] {
+            pool.parallelFor(strips(h), [&](int begin, int end) {
+                for (int y = begin * kStripRows; y < std::min(end * kStripRows, h); y++) {
+                    uint32_t* dst = frame.canvas.data() + static_cast<size_t>(y) * w;
+                    memcpy(dst, frame.desktop.data() + static_cast<size_t>(y) * w, static_cast<size_t>(w) * 4);
+                    if ((y + frame.index * 8) % h < 64) {
+                        for (int x = 0; x < w; x++) {
+                            dst[x] ^= 0x00FFFFFFu;
+                        }
+                    }
+                }
+            });
+        });
+
+        const int detect = graph.addTask("detect", [&frame, &pool, w, h] {
+            pool.parallelFor(strips(h), [&](int begin, int end) {
+                for (int y = begin * kStripRows; y < std::min(end * kStripRows, h); y++) {
+                    const uint32_t* row = frame.canvas.data() + static_cast<size_t>(y) * w;
+                    uint64_t hash = 1469598103934665603ull;
+                    for (int x = 0; x < w; x++) {
+                        hash = (hash ^ row[x]) * 1099511628211ull;
+                    }
+                    frame.rowHashes[y] = hash;
+                }
+            });
+        });
+
+        const int scaleHalf = graph.addTask("scale 1/2", [&frame, &pool, w, h] {
+            downscale(pool, frame.desktop.data(), w, h, frame.half.data(), 2);
+        });
+        const int scaleThird = graph.addTask("scale 1/3", [&frame, &pool, w, h] {
+            downscale(pool, frame.desktop.data(), w, h, frame.third.data(), 3);
+        });
+
+        // Both scaled sources as overlays in the top-left corner, 50% blend
+        const int compose = graph.addTask("compose", [&frame, &pool, w, h] {
+            const int halfWidth = w / 2;
+            const int halfHeight = h / 2;
+            pool.parallelFor(strips(halfHeight), [&](int begin, int end) {
+                for (int y = begin * kStripRows; y < std::min(end * kStripRows, halfHeight); y++) {
+                    uint32_t* dst = frame.canvas.data() + static_cast<size_t>(y) * w;
+                    const uint32_t* src = frame.half.data() + static_cast<size_t>(y) * halfWidth;
+                    for (int x = 0; x < halfWidth; x++) {
+                        dst[x] = ((dst[x] >> 1) & 0x7F7F7F7Fu) + ((src[x] >> 1) & 0x7F7F7F7Fu);
+                    }
+                    if (y < h / 3) {
+                        const uint32_t* overlay = frame.third.data() + static_cast<size_t>(y) * (w / 3);
+                        for (int x = 0; x < w / 3; x++) {
+                            dst[x] = ((dst[x] >> 1) & 0x7F7F7F7Fu) + ((overlay[x] >> 1) & 0x7F7F7F7Fu);
+                        }
+                    }
+                }
+            });
+        });
+
+        const int preview = graph.addTask("preview", [&frame, &pool, w, h] {
+            downscale(pool, frame.canvas.data(), w, h, frame.preview.data(), 2);
+        });
+
+        const int encode = graph.addTask("encode", [&frame, &pool, w, h] {
+            pool.parallelFor(strips(h), [&](int begin, int end) {
+                for (int y = begin * kStripRows; y < std::min(end * kStripRows, h); y++) {
+                    const uint32_t* row = frame.canvas.data() + static_cast<size_t>(y) * w;
+                    uint8_t* out = frame.luma.data() + static_cast<size_t>(y) * w;
+                    for (int x = 0; x < w; x++) {
+                        const uint32_t p = row[x];
+                        out[x] = static_cast<uint8_t>((66 * ((p >> 16) & 0xFF) + 129 * ((p >> 8) & 0xFF) + 25 * (p & 0xFF) + 4224) >> 8);
+                    }
+                }
+            });
+        });
+
+        // A frame's worth of stereo audio through a low-pass biquad, serial like the real chain
+        graph.addTask("audio", [&frame] {
+            float* samples = frame.audio.data();
+            for (size_t i = 0; i < frame.audio.size(); i += 2) {
+                for (int c = 0; c < 2; c++) {
+                    float* state = frame.audioState + c * 2;
+                    const float in = samples[i + c];
+                    const float out = 0.2929f * in + state[0];
+                    state[0] = 0.5858f * in + state[1];
+                    state[1] = 0.2929f * in - 0.1716f * out;
+                    samples[i + c] = out;
+                }
+            }
+        });
+
+        graph.addDependency(capture, detect);
+        graph.addDependency(detect, compose);
+        graph.addDependency(capture, compose);
+        graph.addDependency(scaleHalf, compose);
+        graph.addDependency(scaleThird, compose);
+        graph.addDependency(compose, preview);
+        graph.addDependency(compose, encode);
+    }
+}
+
+std::vector<SchedulerBenchmark::Result> SchedulerBenchmark::run(const Settings& settings)
+{
+    int maxThreads = settings.maxThreads;
+    if (maxThreads <= 0) {
+        maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    std::vector<Result> results;
+    Frame frame(std::max(settings.width, 6), std::max(settings.height, 6));
+
+    for (int threads = 1; threads <= maxThreads; threads++) {
+        ThreadPool pool(threads);
+        TaskGraph graph;
+        buildGraph(graph, frame, pool);
+
+        for (int i = 0; i < kWarmupFrames; i++) {
+            frame.index++;
+            graph.run(pool);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < settings.frames; i++) {
+            frame.index++;
+            graph.run(pool);
+        }
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        Result result;
+        result.threads = threads;
+        result.msPerFrame = elapsed.count() / std::max(settings.frames, 1);
+        result.speedup = results.empty() ? 1.0 : results.front().msPerFrame / result.msPerFrame;
+        result.efficiency = result.speedup / threads;
+        results.push_back(result);
+    }
+    return results;
+}
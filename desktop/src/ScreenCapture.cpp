@@ -1,7 +1,9 @@
 #include "incl/ScreenCapture.h"
+#include "incl/ThreadPool.h"
+#include "incl/Tracer.h"
 #include <QDebug>
 #include <sstream>
-#include <QPainter>
+#include <algorithm>
 
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
@@ -17,7 +19,13 @@ ScreenCapture::~ScreenCapture()
 
 bool ScreenCapture::initialize()
 {
-    if (!initDirectX()) {
+    // Also the way back after the duplication was lost; the device is kept unless it went too
+    if (m_d3dDevice && m_d3dDevice->GetDeviceRemovedReason() != S_OK) {
+        qDebug() << "D3D11 device removed, recreating it";
+        cleanup();
+    }
+
+    if (!m_d3dDevice && !initDirectX()) {
         qDebug() << "Failed to initialize DirectX";
         return false;
     }
@@ -27,6 +35,7 @@ bool ScreenCapture::initialize()
         return false;
     }
 
+    m_lost = false;
     return true;
 }
 
@@ -60,6 +69,16 @@ bool ScreenCapture::initDirectX()
 
 bool ScreenCapture::initDuplication()
 {
+    // Let go of the previous duplication's objects when this is a reinit
+    if (m_deskDupl) {
+        m_deskDupl->Release();
+        m_deskDupl = nullptr;
+    }
+    if (m_stagingTexture) {
+        m_stagingTexture->Release();
+        m_stagingTexture = nullptr;
+    }
+
     // Get DXGI Device
     IDXGIDevice* dxgiDevice = nullptr;
     HRESULT hr = m_d3dDevice->QueryInterface(__uuidof(IDXGIDevice), (void**)&dxgiDevice);
@@ -95,22 +114,66 @@ bool ScreenCapture::initDuplication()
         qDebug() << "Screen dimensions:" << m_screenWidth << "x" << m_screenHeight;
     }
 
-    // QI for Output 1
-    IDXGIOutput1* dxgiOutput1 = nullptr;
-    hr = dxgiOutput->QueryInterface(__uuidof(IDXGIOutput1), (void**)&dxgiOutput1);
-    dxgiOutput->Release();
-    if (FAILED(hr)) {
-        qDebug() << "Failed to get IDXGIOutput1";
-        return false;
+    // Tone-map towards what the display can actually show
+    IDXGIOutput6* dxgiOutput6 = nullptr;
+    hr = dxgiOutput->QueryInterface(__uuidof(IDXGIOutput6), (void**)&dxgiOutput6);
+    if (SUCCEEDED(hr)) {
+        DXGI_OUTPUT_DESC1 outputDesc1;
+        if (SUCCEEDED(dxgiOutput6->GetDesc1(&outputDesc1)) && outputDesc1.MaxLuminance > 0.0f) {
+            HdrConverter::Settings settings = m_hdrConverter.settings();
+            settings.peakNits = outputDesc1.MaxLuminance;
+            m_hdrConverter.setSettings(settings);
+        }
+        dxgiOutput6->Release();
     }
 
-    // Create desktop duplication
-    hr = dxgiOutput1->DuplicateOutput(m_d3dDevice, &m_deskDupl);
-    dxgiOutput1->Release();
-    if (FAILED(hr)) {
-        qDebug() << "Failed to duplicate output. HRESULT:" << hr;
-        return false;
+    // Prefer DuplicateOutput1: on an HDR desktop it hands out the FP16 (or 10-bit)
+    // image instead of a clipped 8-bit copy, and plain BGRA on an SDR one
+    IDXGIOutput5* dxgiOutput5 = nullptr;
+    hr = dxgiOutput->QueryInterface(__uuidof(IDXGIOutput5), (void**)&dxgiOutput5);
+    if (SUCCEEDED(hr)) {
+        const DXGI_FORMAT formats[] = {
+            DXGI_FORMAT_R16G16B16A16_FLOAT,
+            DXGI_FORMAT_R10G10B10A2_UNORM,
+            DXGI_FORMAT_B8G8R8A8_UNORM,
+        };
+        hr = dxgiOutput5->DuplicateOutput1(m_d3dDevice, 0, ARRAYSIZE(formats), formats, &m_deskDupl);
+        dxgiOutput5->Release();
+        if (FAILED(hr)) {
+            qDebug() << "DuplicateOutput1 failed, falling back to 8-bit duplication. HRESULT:" << hr;
+            m_deskDupl = nullptr;
+        }
+    }
+
+    if (!m_deskDupl) {
+        // QI for Output 1
+        IDXGIOutput1* dxgiOutput1 = nullptr;
+        hr = dxgiOutput->QueryInterface(__uuidof(IDXGIOutput1), (void**)&dxgiOutput1);
+        if (FAILED(hr)) {
+            dxgiOutput->Release();
+            qDebug() << "Failed to get IDXGIOutput1";
+            return false;
+        }
+
+        // Create desktop duplication
+        hr = dxgiOutput1->DuplicateOutput(m_d3dDevice, &m_deskDupl);
+        dxgiOutput1->Release();
+        if (FAILED(hr)) {
+            dxgiOutput->Release();
+            qDebug() << "Failed to duplicate output. HRESULT:" << hr;
+            return false;
+        }
+    }
+    dxgiOutput->Release();
+
+    // The duplication picks the pixel format; the staging copy has to match it
+    DXGI_OUTDUPL_DESC duplDesc;
+    m_deskDupl->GetDesc(&duplDesc);
+    m_captureFormat = duplDesc.ModeDesc.Format;
+    if (m_captureFormat != DXGI_FORMAT_R16G16B16A16_FLOAT && m_captureFormat != DXGI_FORMAT_R10G10B10A2_UNORM) {
+        m_captureFormat = DXGI_FORMAT_B8G8R8A8_UNORM;
     }
+    qDebug() << "Desktop format:" << m_captureFormat << (isHdr() ? "(HDR)" : "(SDR)");
 
     // Create staging texture for CPU access
     D3D11_TEXTURE2D_DESC stagingDesc = {};
@@ -118,7 +181,7 @@ bool ScreenCapture::initDuplication()
     stagingDesc.Height = m_screenHeight;
     stagingDesc.MipLevels = 1;
     stagingDesc.ArraySize = 1;
-    stagingDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    stagingDesc.Format = m_captureFormat;
     stagingDesc.SampleDesc.Count = 1;
     stagingDesc.Usage = D3D11_USAGE_STAGING;
     stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
@@ -130,8 +193,12 @@ bool ScreenCapture::initDuplication()
         return false;
     }
 
-    // Initialize QImage with the correct size
-    m_latestFrame = QImage(m_screenWidth, m_screenHeight, QImage::Format_ARGB32);
+    // Initialize QImage with the correct size; readers may still hold the previous one
+    QMutexLocker locker(&m_frameMutex);
+    if (m_latestFrame.width() != m_screenWidth || m_latestFrame.height() != m_screenHeight) {
+        m_latestFrame = QImage(m_screenWidth, m_screenHeight, QImage::Format_ARGB32);
+    }
+    m_changeDetector.reset();
 
     return true;
 }
@@ -143,6 +210,8 @@ bool ScreenCapture::captureFrame()
         return false;
     }
 
+    TraceScope trace("capture");
+
     // Release any previous frame
     if (m_acquiredDesktopImage) {
         m_acquiredDesktopImage->Release();
@@ -152,7 +221,11 @@ bool ScreenCapture::captureFrame()
     // Get next frame
     IDXGIResource* desktopResource = nullptr;
     DXGI_OUTDUPL_FRAME_INFO frameInfo;
-    HRESULT hr = m_deskDupl->AcquireNextFrame(0, &frameInfo, &desktopResource);
+    HRESULT hr;
+    {
+        TraceScope acquireTrace("AcquireNextFrame");
+        hr = m_deskDupl->AcquireNextFrame(0, &frameInfo, &desktopResource);
+    }
 
     if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
         // No new frame available
@@ -160,21 +233,26 @@ bool ScreenCapture::captureFrame()
     }
 
     if (FAILED(hr)) {
-        if (hr == DXGI_ERROR_ACCESS_LOST) {
-            qDebug() << "Access lost to desktop duplication";
-            // Try to reinitialize
-            if (m_deskDupl) {
-                m_deskDupl->Release();
-                m_deskDupl = nullptr;
-            }
-            initDuplication();
+        if (hr == DXGI_ERROR_ACCESS_LOST || hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET) {
+            // Desktop switch, secure desktop, mode change or GPU reset. Reinitializing can
+            // take a while, so it is left to the caller (initialize() again, off this thread).
+            qDebug() << "Access lost to desktop duplication. HRESULT:" << hr;
+            m_deskDupl->Release();
+            m_deskDupl = nullptr;
+            m_lost = true;
         }
         else {
             qDebug() << "Failed to acquire frame. HRESULT:" << hr;
         }
+        m_captureErrors.fetch_add(1, std::memory_order_relaxed);
         return false;
     }
 
+    // More than one means the desktop changed again before we got to the previous update
+    if (frameInfo.AccumulatedFrames > 1) {
+        m_accumulatedMisses.fetch_add(frameInfo.AccumulatedFrames - 1, std::memory_order_relaxed);
+    }
+
     // Get mouse info
     int offsetX = m_outputDesc.DesktopCoordinates.left;
     int offsetY = m_outputDesc.DesktopCoordinates.top;
@@ -185,6 +263,7 @@ bool ScreenCapture::captureFrame()
     desktopResource->Release();
     if (FAILED(hr)) {
         qDebug() << "Failed to QI for ID3D11Texture2D";
+        m_captureErrors.fetch_add(1, std::memory_order_relaxed);
         m_deskDupl->ReleaseFrame();
         return false;
     }
@@ -192,31 +271,55 @@ bool ScreenCapture::captureFrame()
     // Copy to staging texture
     m_d3dContext->CopyResource(m_stagingTexture, m_acquiredDesktopImage);
 
-    // Map staging texture to read pixels
+    // Map staging texture to read pixels; this waits for the copy, so GPU stalls show up here
     D3D11_MAPPED_SUBRESOURCE mappedResource;
-    hr = m_d3dContext->Map(m_stagingTexture, 0, D3D11_MAP_READ, 0, &mappedResource);
+    {
+        TraceScope mapTrace("Map");
+        hr = m_d3dContext->Map(m_stagingTexture, 0, D3D11_MAP_READ, 0, &mappedResource);
+    }
     if (SUCCEEDED(hr)) {
         // Lock the frame mutex while we update the frame
         QMutexLocker locker(&m_frameMutex);
 
-        // Copy from staging texture to QImage
-        uchar* dest = m_latestFrame.bits();
-        uchar* src = (uchar*)mappedResource.pData;
-        const int bytesPerLine = m_screenWidth * 4;
-
-        for (int y = 0; y < m_screenHeight; y++) {
-            memcpy(dest, src, bytesPerLine);
-            dest += m_latestFrame.bytesPerLine();
-            src += mappedResource.RowPitch;
+        if (isHdr()) {
+            // Tone-map straight out of the mapped texture into the 8-bit frame
+            TraceScope toneTrace("tone map");
+            HdrView hdr(static_cast<const uint8_t*>(mappedResource.pData), m_screenWidth, m_screenHeight,
+                static_cast<int>(mappedResource.RowPitch),
+                m_captureFormat == DXGI_FORMAT_R16G16B16A16_FLOAT ? HdrFormat::ScRgb16F : HdrFormat::Hdr10);
+            m_hdrConverter.toSdr(hdr, FrameView(m_latestFrame.bits(), m_latestFrame.width(),
+                m_latestFrame.height(), static_cast<int>(m_latestFrame.bytesPerLine())), &ThreadPool::instance());
+            if (m_p010Enabled) {
+                m_hdrConverter.toP010(hdr, m_latestP010, &ThreadPool::instance());
+            }
+        }
+        else {
+            // Copy from staging texture to QImage
+            TraceScope copyTrace("frame copy");
+            uchar* dest = m_latestFrame.bits();
+            uchar* src = (uchar*)mappedResource.pData;
+            const int bytesPerLine = m_screenWidth * 4;
+
+            for (int y = 0; y < m_screenHeight; y++) {
+                memcpy(dest, src, bytesPerLine);
+                dest += m_latestFrame.bytesPerLine();
+                src += mappedResource.RowPitch;
+            }
         }
 
         m_d3dContext->Unmap(m_stagingTexture, 0);
 
         // Draw mouse cursor on top of the frame
         drawMouse(m_latestFrame, &m_ptrInfo);
+
+        // Find what actually changed; mouse-only updates usually touch a few tiles
+        m_changeDetector.detect(FrameView(m_latestFrame.bits(), m_latestFrame.width(),
+            m_latestFrame.height(), static_cast<int>(m_latestFrame.bytesPerLine())), &ThreadPool::instance());
+        m_framesCaptured.fetch_add(1, std::memory_order_relaxed);
     }
     else {
         qDebug() << "Failed to map staging texture:" << hr;
+        m_captureErrors.fetch_add(1, std::memory_order_relaxed);
     }
 
     // Release frame
@@ -230,6 +333,37 @@ QImage ScreenCapture::getLatestFrame()
     return m_latestFrame;
 }
 
+void ScreenCapture::getLatestChanges(ChangeMap& out)
+{
+    QMutexLocker locker(&m_frameMutex);
+    out = m_changeDetector.changes();
+}
+
+void ScreenCapture::setToneMapping(const HdrConverter::Settings& settings)
+{
+    QMutexLocker locker(&m_frameMutex);
+    m_hdrConverter.setSettings(settings);
+}
+
+void ScreenCapture::setP010Output(bool enabled)
+{
+    QMutexLocker locker(&m_frameMutex);
+    m_p010Enabled = enabled;
+    if (!enabled) {
+        m_latestP010 = P010Buffer();
+    }
+}
+
+bool ScreenCapture::getLatestP010(P010Buffer& out)
+{
+    QMutexLocker locker(&m_frameMutex);
+    if (!m_p010Enabled || m_latestP010.luma.empty()) {
+        return false;
+    }
+    out = m_latestP010;
+    return true;
+}
+
 void ScreenCapture::cleanup()
 {
     if (m_deskDupl) {
@@ -294,6 +428,7 @@ HRESULT ScreenCapture::getMouse(PTR_INFO* ptrInfo, DXGI_OUTDUPL_FRAME_INFO* fram
         ptrInfo->WhoUpdatedPositionLast = m_outputNumber;
         ptrInfo->LastTimeStamp = frameInfo->LastMouseUpdateTime;
         ptrInfo->Visible = frameInfo->PointerPosition.Visible != 0;
+        m_cursorUpdated = true;
     }
 
     // No new shape
@@ -305,12 +440,8 @@ HRESULT ScreenCapture::getMouse(PTR_INFO* ptrInfo, DXGI_OUTDUPL_FRAME_INFO* fram
     // Old buffer too small
     if (frameInfo->PointerShapeBufferSize > ptrInfo->BufferSize)
     {
-        if (ptrInfo->PtrShapeBuffer)
-        {
-            delete[] ptrInfo->PtrShapeBuffer;
-            ptrInfo->PtrShapeBuffer = nullptr;
-        }
-        ptrInfo->PtrShapeBuffer = new (std::nothrow) BYTE[frameInfo->PointerShapeBufferSize];
+        ptrInfo->ShapeStorage = BufferPool::instance().acquire(frameInfo->PointerShapeBufferSize);
+        ptrInfo->PtrShapeBuffer = ptrInfo->ShapeStorage.data();
         if (!ptrInfo->PtrShapeBuffer)
         {
             qDebug() << "Failed to allocate memory for pointer shape";
@@ -318,7 +449,7 @@ HRESULT ScreenCapture::getMouse(PTR_INFO* ptrInfo, DXGI_OUTDUPL_FRAME_INFO* fram
             return E_OUTOFMEMORY;
         }
         // Update buffer size
-        ptrInfo->BufferSize = frameInfo->PointerShapeBufferSize;
+        ptrInfo->BufferSize = static_cast<UINT>(ptrInfo->ShapeStorage.capacity());
     }
 
     UINT bufferSizeRequired;
@@ -335,137 +466,172 @@ HRESULT ScreenCapture::getMouse(PTR_INFO* ptrInfo, DXGI_OUTDUPL_FRAME_INFO* fram
         {
             qDebug() << "Failed to get frame pointer shape. HRESULT:" << hr;
         }
-        delete[] ptrInfo->PtrShapeBuffer;
+        ptrInfo->ShapeStorage.reset();
         ptrInfo->PtrShapeBuffer = nullptr;
         ptrInfo->BufferSize = 0;
         return hr;
     }
 
+    // Rebuild the cursor image before it is next drawn
+    m_cursorShapeChanged = true;
+    m_cursorUpdated = true;
+    m_cursorShapeUpdated = true;
+
     return hr;
 }
 
-void ScreenCapture::drawMouse(QImage& image, PTR_INFO* ptrInfo)
+bool ScreenCapture::takeCursorUpdate(CursorUpdate& out)
 {
-    // If pointer is not visible or there's no shape data, nothing to draw
-    if (!ptrInfo->Visible || !ptrInfo->PtrShapeBuffer) {
-        return;
+    if (!m_cursorUpdated) {
+        return false;
     }
 
-    // Get the cursor position
-    int x = ptrInfo->Position.x;
-    int y = ptrInfo->Position.y;
-
-    // Get pointer shape information
-    DXGI_OUTDUPL_POINTER_SHAPE_INFO shapeInfo = ptrInfo->ShapeInfo;
-    UINT width = shapeInfo.Width;
-    UINT height = shapeInfo.Height;
-    UINT pitch = shapeInfo.Pitch;
-    BYTE* buffer = ptrInfo->PtrShapeBuffer;
+    const DXGI_OUTDUPL_POINTER_SHAPE_INFO& shapeInfo = m_ptrInfo.ShapeInfo;
+    out.x = m_ptrInfo.Position.x;
+    out.y = m_ptrInfo.Position.y;
+    out.visible = m_ptrInfo.Visible;
+    out.shapeType = m_cursorShapeUpdated && m_ptrInfo.PtrShapeBuffer ? shapeInfo.Type : CursorUpdate::Unchanged;
+    out.width = static_cast<int>(shapeInfo.Width);
+    out.height = static_cast<int>(shapeInfo.Height);
+    out.pitch = static_cast<int>(shapeInfo.Pitch);
+    out.hotX = shapeInfo.HotSpot.x;
+    out.hotY = shapeInfo.HotSpot.y;
+    out.shape = m_ptrInfo.PtrShapeBuffer;
+
+    m_cursorUpdated = false;
+    m_cursorShapeUpdated = false;
+    return true;
+}
 
-    // Ensure the mouse cursor is within the image boundaries
-    if (x < 0 || y < 0 || x >= image.width() || y >= image.height()) {
+void ScreenCapture::prepareCursor(const PTR_INFO* ptrInfo)
+{
+    const DXGI_OUTDUPL_POINTER_SHAPE_INFO& shapeInfo = ptrInfo->ShapeInfo;
+    const BYTE* buffer = ptrInfo->PtrShapeBuffer;
+    const bool monochrome = shapeInfo.Type == DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME;
+    const int width = static_cast<int>(shapeInfo.Width);
+    const int height = static_cast<int>(monochrome ? shapeInfo.Height / 2 : shapeInfo.Height);
+    const UINT pitch = shapeInfo.Pitch;
+
+    if (!monochrome &&
+        shapeInfo.Type != DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR &&
+        shapeInfo.Type != DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR) {
+        qDebug() << "Unknown cursor type:" << shapeInfo.Type;
+        m_cursorWidth = m_cursorHeight = 0;
         return;
     }
 
-    QPainter painter(&image);
-
-    // Handle different cursor types
-    switch (shapeInfo.Type) {
-    case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME:
-    {
-        // Monochrome cursor (AND/XOR masks)
-        QImage cursorImage(width, height, QImage::Format_ARGB32);
-        cursorImage.fill(Qt::transparent);
-
-        // XOR mask is in the first half, AND mask in the second half
-        int andMaskOffset = pitch * (height / 2);
-
-        for (UINT row = 0; row < height / 2; row++) {
-            for (UINT col = 0; col < width; col++) {
-                // Get AND and XOR mask values for this pixel
-                UINT byteIndex = row * pitch + col / 8;
-                UINT bitIndex = 7 - (col % 8); // Most significant bit first
-
-                bool andMask = (buffer[andMaskOffset + byteIndex] & (1 << bitIndex)) != 0;
-                bool xorMask = (buffer[byteIndex] & (1 << bitIndex)) != 0;
-
-                QRgb color;
-                if (andMask) {
-                    if (xorMask) {
-                        // Inverted screen without transparency
-                        color = qRgba(255, 255, 255, 255); // White
-                    }
-                    else {
-                        // Transparent
-                        color = qRgba(0, 0, 0, 0);
-                    }
+    // Two planes of one word per pixel: color blended over the screen (straight alpha),
+    // then bits XORed into the result
+    const size_t pixels = static_cast<size_t>(width) * height;
+    if (m_cursorStorage.capacity() < pixels * 8) {
+        m_cursorStorage = BufferPool::instance().acquire(pixels * 8);
+        if (!m_cursorStorage) {
+            m_cursorWidth = m_cursorHeight = 0;
+            return;
+        }
+    }
+    uint32_t* color = reinterpret_cast<uint32_t*>(m_cursorStorage.data());
+    uint32_t* invert = color + pixels;
+
+    for (int row = 0; row < height; row++) {
+        for (int col = 0; col < width; col++) {
+            const size_t i = static_cast<size_t>(row) * width + col;
+            color[i] = 0;
+            invert[i] = 0;
+
+            switch (shapeInfo.Type) {
+            case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME:
+            {
+                // AND mask in the first half, XOR mask in the second, most significant bit first
+                const UINT byteIndex = row * pitch + col / 8;
+                const BYTE bit = static_cast<BYTE>(0x80 >> (col % 8));
+                const bool andMask = (buffer[byteIndex] & bit) != 0;
+                const bool xorMask = (buffer[byteIndex + height * pitch] & bit) != 0;
+
+                if (!andMask) {
+                    color[i] = xorMask ? 0xFFFFFFFF : 0xFF000000; // white or black
+                }
+                else if (xorMask) {
+                    invert[i] = 0x00FFFFFF; // inverts the screen
+                }
+                break;
+            }
+            case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR:
+                color[i] = reinterpret_cast<const uint32_t*>(buffer + row * pitch)[col];
+                break;
+            case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR:
+            {
+                // Alpha is a mask: 0 replaces the screen pixel, 0xFF XORs the color into it
+                const uint32_t pixel = reinterpret_cast<const uint32_t*>(buffer + row * pitch)[col];
+                if ((pixel >> 24) == 0) {
+                    color[i] = pixel | 0xFF000000;
                 }
                 else {
-                    if (xorMask) {
-                        // Inverted screen
-                        color = qRgba(0, 0, 0, 255); // Black
-                    }
-                    else {
-                        // Opaque
-                        color = qRgba(0, 0, 0, 255); // Black
-                    }
+                    invert[i] = pixel & 0x00FFFFFF;
                 }
-
-                cursorImage.setPixel(col, row, color);
+                break;
+            }
             }
         }
+    }
 
-        // Draw the cursor onto the image
-        painter.drawImage(x, y, cursorImage);
-        break;
+    m_cursorWidth = width;
+    m_cursorHeight = height;
+}
+
+void ScreenCapture::drawMouse(QImage& image, PTR_INFO* ptrInfo)
+{
+    TraceScope trace("cursor");
+    // If pointer is not visible or there's no shape data, nothing to draw
+    if (!ptrInfo->Visible || !ptrInfo->PtrShapeBuffer) {
+        return;
     }
-    case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR:
-    {
-        // Color cursor (BGRA format)
-        QImage cursorImage(buffer, width, height, pitch, QImage::Format_ARGB32);
-        painter.drawImage(x, y, cursorImage);
-        break;
+
+    // The shape only arrives when it changes; convert it once, not every frame
+    if (m_cursorShapeChanged) {
+        prepareCursor(ptrInfo);
+        m_cursorShapeChanged = false;
     }
-    case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR:
-    {
-        // Masked color cursor
-        QImage cursorImage(width, height, QImage::Format_ARGB32);
-        cursorImage.fill(Qt::transparent);
-
-        for (UINT row = 0; row < height; row++) {
-            BYTE* srcRow = buffer + (row * pitch);
-            for (UINT col = 0; col < width; col++) {
-                // BGRA format
-                BYTE b = srcRow[col * 4];
-                BYTE g = srcRow[col * 4 + 1];
-                BYTE r = srcRow[col * 4 + 2];
-                BYTE a = srcRow[col * 4 + 3];
-
-                // If the alpha channel is 0, this is a masked area
-                if (a == 0) {
-                    // The color data contains the mask
-                    if (b == 0 && g == 0 && r == 0) {
-                        // Transparent area
-                        cursorImage.setPixel(col, row, qRgba(0, 0, 0, 0));
-                    }
-                    else {
-                        // Inverted area (XOR)
-                        // For simplicity, just use black
-                        cursorImage.setPixel(col, row, qRgba(0, 0, 0, 255));
-                    }
-                }
-                else {
-                    // Normal color
-                    cursorImage.setPixel(col, row, qRgba(r, g, b, a));
+
+    // Clip the cursor to the frame so it stays visible at the screen edges
+    const int x = ptrInfo->Position.x;
+    const int y = ptrInfo->Position.y;
+    const int firstCol = std::max(0, -x);
+    const int firstRow = std::max(0, -y);
+    const int lastCol = std::min(m_cursorWidth, image.width() - x);
+    const int lastRow = std::min(m_cursorHeight, image.height() - y);
+    if (firstCol >= lastCol || firstRow >= lastRow) {
+        return;
+    }
+
+    const size_t pixels = static_cast<size_t>(m_cursorWidth) * m_cursorHeight;
+    const uint32_t* color = reinterpret_cast<const uint32_t*>(m_cursorStorage.data());
+    const uint32_t* invert = color + pixels;
+
+    for (int row = firstRow; row < lastRow; row++) {
+        uint32_t* dst = reinterpret_cast<uint32_t*>(image.scanLine(y + row)) + x;
+        const size_t rowOffset = static_cast<size_t>(row) * m_cursorWidth;
+
+        for (int col = firstCol; col < lastCol; col++) {
+            const uint32_t src = color[rowOffset + col];
+            const uint32_t alpha = src >> 24;
+            uint32_t out = dst[col];
+
+            if (alpha == 255) {
+                out = (src & 0x00FFFFFF) | (out & 0xFF000000);
+            }
+            else if (alpha != 0) {
+                // Blend each color channel, keep the frame's alpha
+                uint32_t blended = out & 0xFF000000;
+                for (int shift = 0; shift < 24; shift += 8) {
+                    const uint32_t s = (src >> shift) & 0xFF;
+                    const uint32_t d = (out >> shift) & 0xFF;
+                    blended |= ((s * alpha + d * (255 - alpha) + 127) / 255) << shift;
                 }
+                out = blended;
             }
-        }
 
-        painter.drawImage(x, y, cursorImage);
-        break;
-    }
-    default:
-        qDebug() << "Unknown cursor type:" << shapeInfo.Type;
-        break;
+            dst[col] = out ^ invert[rowOffset + col];
+        }
     }
 }
\ No newline at end of file
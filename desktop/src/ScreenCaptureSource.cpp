@@ -0,0 +1,38 @@
+#include "incl/ScreenCaptureSource.h"
+#include <chrono>
+
+bool ScreenCaptureSource::initialize()
+{
+    if (!m_capture.initialize()) {
+        m_error = "DXGI desktop duplication is not available";
+        return false;
+    }
+    return true;
+}
+
+bool ScreenCaptureSource::acquireFrame(SourceFrame& frame)
+{
+    // Drop our reference first, or the capture would detach (copy) its frame on write
+    m_frame = QImage();
+    if (!m_capture.captureFrame()) {
+        if (m_capture.isLost()) {
+            m_error = "desktop duplication access lost";
+        }
+        return false;
+    }
+
+    m_capture.getLatestChanges(m_changes);
+    m_frame = m_capture.getLatestFrame();
+    if (m_frame.isNull()) {
+        m_error = "capture returned an empty frame";
+        return false;
+    }
+
+    frame.pixels = FrameView(const_cast<uchar*>(m_frame.constBits()),
+        m_frame.width(), m_frame.height(), static_cast<int>(m_frame.bytesPerLine()));
+    frame.changes = &m_changes;
+    frame.cursor = m_capture.takeCursorUpdate(m_cursor) ? &m_cursor : nullptr;
+    frame.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    return true;
+}
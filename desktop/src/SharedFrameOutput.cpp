@@ -0,0 +1,134 @@
+#include "incl/SharedFrameOutput.h"
+#include "incl/ThreadPool.h"
+#include "incl/Tracer.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace SharedFrameRing;
+
+bool SharedFrameOutput::open(const std::string& name, int maxWidth, int maxHeight, int slots)
+{
+    close();
+
+    if (maxWidth <= 0 || maxHeight <= 0 || slots < 2 || slots > kMaxSlots) {
+        m_error = "bad shared memory ring size";
+        return false;
+    }
+
+    // A producer that crashed leaves its segment behind. Replace it; readers still
+    // mapping the old one stop getting frames and have to reopen
+    const std::string path = name.empty() || name[0] != '/' ? "/" + name : name;
+    shm_unlink(path.c_str());
+    const int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        m_error = "cannot create shared memory " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    const size_t size = segmentBytes(maxWidth, maxHeight, slots);
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        m_error = "cannot size shared memory " + path + ": " + std::strerror(errno);
+        ::close(fd);
+        shm_unlink(path.c_str());
+        return false;
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        m_error = std::string("mmap failed: ") + std::strerror(errno);
+        shm_unlink(path.c_str());
+        return false;
+    }
+
+    // The pages come zeroed; construct the atomics in place and publish the magic last
+    m_base = static_cast<uint8_t*>(base);
+    m_size = size;
+    m_name = path;
+    m_header = new (m_base) Header();
+    m_header->version = kVersion;
+    m_header->slotCount = static_cast<uint32_t>(slots);
+    m_header->maxWidth = static_cast<uint32_t>(maxWidth);
+    m_header->maxHeight = static_cast<uint32_t>(maxHeight);
+    m_header->producerPid = static_cast<int32_t>(getpid());
+    m_header->slotBytes = slotBytes(maxWidth, maxHeight);
+    for (int i = 0; i < slots; i++) {
+        new (slotFor(m_base, *m_header, i)) Slot();
+    }
+    m_published.store(0, std::memory_order_relaxed);
+    m_header->magic.store(kMagic, std::memory_order_release);
+    return true;
+}
+
+void SharedFrameOutput::close()
+{
+    if (!m_base) {
+        return;
+    }
+    m_header->closed.store(1, std::memory_order_release);
+    m_header->wake.fetch_add(1, std::memory_order_seq_cst);
+    futexWakeAll(&m_header->wake);
+
+    munmap(m_base, m_size);
+    shm_unlink(m_name.c_str());
+    m_base = nullptr;
+    m_header = nullptr;
+    m_size = 0;
+}
+
+bool SharedFrameOutput::publish(const FrameView& frame, int64_t timestampUs, ThreadPool* pool)
+{
+    if (!m_base) {
+        return false;
+    }
+    if (frame.width > static_cast<int>(m_header->maxWidth) || frame.height > static_cast<int>(m_header->maxHeight)) {
+        m_error = "frame larger than the shared memory ring";
+        return false;
+    }
+    TraceScope trace("shm publish");
+
+    const uint64_t frameNumber = m_published.load(std::memory_order_relaxed);
+    Slot* slot = slotFor(m_base, *m_header, frameNumber);
+    slot->sequence.store(2 * frameNumber + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->frameNumber = frameNumber;
+    slot->timestampUs = timestampUs;
+    slot->width = static_cast<uint32_t>(frame.width);
+    slot->height = static_cast<uint32_t>(frame.height);
+    slot->stride = static_cast<uint32_t>(frame.width) * 4;
+    slot->format = Bgra;
+
+    uint8_t* pixels = reinterpret_cast<uint8_t*>(slot) + kSlotHeaderBytes;
+    const size_t rowBytes = static_cast<size_t>(frame.width) * 4;
+    auto copyRows = [&](int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            std::memcpy(pixels + rowBytes * y, frame.row(y), rowBytes);
+        }
+    };
+    if (pool) {
+        pool->parallelFor(frame.height, copyRows, 64);
+    }
+    else {
+        copyRows(0, frame.height);
+    }
+    slot->publishedUs = monotonicMicros();
+
+    slot->sequence.store(2 * (frameNumber + 1), std::memory_order_release);
+    m_header->latest.store(frameNumber + 1, std::memory_order_seq_cst);
+    m_published.store(frameNumber + 1, std::memory_order_relaxed);
+
+    // Readers count themselves as waiters before their last look, see SharedFrameReader
+    m_header->wake.fetch_add(1, std::memory_order_seq_cst);
+    if (m_header->waiters.load(std::memory_order_seq_cst) > 0) {
+        futexWakeAll(&m_header->wake);
+    }
+    return true;
+}
+
+int SharedFrameOutput::readers() const
+{
+    return m_header ? static_cast<int>(m_header->readers.load(std::memory_order_relaxed)) : 0;
+}
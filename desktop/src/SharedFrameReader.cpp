@@ -0,0 +1,189 @@
+#include "incl/SharedFrameReader.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace SharedFrameRing;
+
+bool SharedFrameReader::open(const std::string& name)
+{
+    close();
+
+    const std::string path = name.empty() || name[0] != '/' ? "/" + name : name;
+    const int fd = shm_open(path.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        m_error = "cannot open shared memory " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < kPageSize) {
+        m_error = "shared memory " + path + " is not a frame ring";
+        ::close(fd);
+        return false;
+    }
+    // Read-write: readers sleep on and count themselves in the header
+    void* base = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        m_error = std::string("mmap failed: ") + std::strerror(errno);
+        return false;
+    }
+
+    Header* header = static_cast<Header*>(base);
+    if (header->magic.load(std::memory_order_acquire) != kMagic || header->version != kVersion ||
+        header->slotCount == 0 || header->slotCount > kMaxSlots ||
+        header->slotBytes != slotBytes(header->maxWidth, header->maxHeight) ||
+        static_cast<size_t>(info.st_size) < segmentBytes(header->maxWidth, header->maxHeight, header->slotCount)) {
+        m_error = "shared memory " + path + " is not ready or from another version";
+        munmap(base, info.st_size);
+        return false;
+    }
+
+    m_base = static_cast<uint8_t*>(base);
+    m_size = info.st_size;
+    m_header = header;
+    m_header->readers.fetch_add(1, std::memory_order_relaxed);
+    // Start from the current frame, not from the beginning of the run
+    const uint64_t latest = m_header->latest.load(std::memory_order_acquire);
+    m_lastSeen = latest > 0 ? latest - 1 : 0;
+    m_skipped = 0;
+    return true;
+}
+
+void SharedFrameReader::close()
+{
+    if (!m_base) {
+        return;
+    }
+    m_header->readers.fetch_sub(1, std::memory_order_relaxed);
+    munmap(m_base, m_size);
+    m_base = nullptr;
+    m_header = nullptr;
+    m_size = 0;
+}
+
+bool SharedFrameReader::waitFrame(SharedFrame& frame, int timeoutMs)
+{
+    if (!m_base) {
+        m_error = "not open";
+        return false;
+    }
+
+    const int64_t deadline = timeoutMs < 0 ? 0 : monotonicMicros() + static_cast<int64_t>(timeoutMs) * 1000;
+    for (;;) {
+        if (readLatest(frame)) {
+            return true;
+        }
+        if (producerClosed()) {
+            m_error = "producer closed";
+            return false;
+        }
+
+        int waitMs = -1;
+        if (timeoutMs >= 0) {
+            const int64_t left = deadline - monotonicMicros();
+            if (left <= 0) {
+                m_error = "timed out";
+                return false;
+            }
+            waitMs = static_cast<int>((left + 999) / 1000);
+        }
+
+        // Counted as a waiter before the last look, so a publish either shows up in
+        // readLatest() or sees us and wakes the futex
+        m_header->waiters.fetch_add(1, std::memory_order_seq_cst);
+        const uint32_t word = m_header->wake.load(std::memory_order_seq_cst);
+        if (m_header->latest.load(std::memory_order_seq_cst) <= m_lastSeen &&
+            !m_header->closed.load(std::memory_order_relaxed)) {
+            futexWait(&m_header->wake, word, waitMs);
+        }
+        m_header->waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+bool SharedFrameReader::readLatest(SharedFrame& frame)
+{
+    for (;;) {
+        const uint64_t latest = m_header->latest.load(std::memory_order_acquire);
+        if (latest <= m_lastSeen) {
+            return false;
+        }
+
+        const uint64_t frameNumber = latest - 1;
+        const Slot* slot = slotFor(m_base, *m_header, frameNumber);
+        const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * (frameNumber + 1)) {
+            sched_yield(); // already being reused, a newer frame is on its way
+            continue;
+        }
+
+        SharedFrame next;
+        next.width = static_cast<int>(slot->width);
+        next.height = static_cast<int>(slot->height);
+        next.stride = static_cast<int>(slot->stride);
+        next.format = slot->format;
+        next.frameNumber = slot->frameNumber;
+        next.timestampUs = slot->timestampUs;
+        next.publishedUs = slot->publishedUs;
+        next.data = reinterpret_cast<const uint8_t*>(slot) + kSlotHeaderBytes;
+        next.sequence = sequence;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+
+        m_skipped += latest - m_lastSeen - 1;
+        m_lastSeen = latest;
+        frame = next;
+        return true;
+    }
+}
+
+bool SharedFrameReader::isValid(const SharedFrame& frame) const
+{
+    if (!m_base || !frame.data) {
+        return false;
+    }
+    const Slot* slot = slotFor(m_base, *m_header, frame.frameNumber);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->sequence.load(std::memory_order_relaxed) == frame.sequence;
+}
+
+bool SharedFrameReader::copyFrame(SharedFrame& frame, std::vector<uint8_t>& dst, int timeoutMs)
+{
+    while (waitFrame(frame, timeoutMs)) {
+        const size_t rowBytes = static_cast<size_t>(frame.width) * 4;
+        dst.resize(rowBytes * frame.height);
+        for (int y = 0; y < frame.height; y++) {
+            std::memcpy(dst.data() + rowBytes * y, frame.data + static_cast<size_t>(frame.stride) * y, rowBytes);
+        }
+        if (isValid(frame)) {
+            frame.data = dst.data();
+            frame.stride = static_cast<int>(rowBytes);
+            return true;
+        }
+        // Lapped mid-copy; the next wait returns the newer frame right away
+        m_skipped++;
+    }
+    return false;
+}
+
+bool SharedFrameReader::producerClosed() const
+{
+    return m_header && m_header->closed.load(std::memory_order_acquire) != 0;
+}
+
+int SharedFrameReader::maxWidth() const
+{
+    return m_header ? static_cast<int>(m_header->maxWidth) : 0;
+}
+
+int SharedFrameReader::maxHeight() const
+{
+    return m_header ? static_cast<int>(m_header->maxHeight) : 0;
+}
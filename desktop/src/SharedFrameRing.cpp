@@ -0,0 +1,29 @@
+#include "incl/SharedFrameRing.h"
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace SharedFrameRing
+{
+    int64_t monotonicMicros()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+    }
+
+    // Not FUTEX_PRIVATE_FLAG: the word is shared between processes
+    void futexWait(std::atomic<uint32_t>* word, uint32_t expected, int timeoutMs)
+    {
+        timespec timeout{ timeoutMs / 1000, (timeoutMs % 1000) * 1000000L };
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected,
+            timeoutMs < 0 ? nullptr : &timeout, nullptr, 0);
+    }
+
+    void futexWakeAll(std::atomic<uint32_t>* word)
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
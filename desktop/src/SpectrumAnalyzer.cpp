@@ -0,0 +1,194 @@
+#include "incl/SpectrumAnalyzer.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    constexpr double kPi = 3.14159265358979323846;
+    constexpr float kFloorDb = -120.0f;
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer()
+{
+    stop();
+}
+
+bool SpectrumAnalyzer::start(int sampleRate, const Settings& settings)
+{
+    stop();
+
+    if (sampleRate <= 0 || settings.bands < 1 || !m_fft.configure(settings.fftSize)) {
+        return false;
+    }
+
+    m_settings = settings;
+    m_settings.overlap = std::clamp(settings.overlap, 0.0f, 0.95f);
+    m_settings.maxFrequency = std::min(settings.maxFrequency, sampleRate * 0.5f);
+    m_settings.minFrequency = std::clamp(settings.minFrequency, 1.0f, m_settings.maxFrequency * 0.5f);
+    m_sampleRate = sampleRate;
+
+    const int n = settings.fftSize;
+    m_hop = std::max(1, static_cast<int>(n * (1.0f - m_settings.overlap)));
+
+    // Room for a few hops of scheduling delay on the worker
+    size_t capacity = 1;
+    while (capacity < static_cast<size_t>(n) * 4) {
+        capacity <<= 1;
+    }
+    m_ring.assign(capacity, 0.0f);
+    m_ringMask = capacity - 1;
+    m_written = 0;
+    m_read = 0;
+    m_dropped = 0;
+
+    m_window.resize(n);
+    for (int i = 0; i < n; i++) {
+        m_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * i / n));
+    }
+    m_history.assign(n, 0.0f);
+    m_windowed.resize(n);
+    m_re.resize(m_fft.bins());
+    m_im.resize(m_fft.bins());
+    m_filled = 0;
+
+    // A full-scale sine reads 0 dBFS: |X| = n/2 times the Hann coherent gain of 0.5
+    m_normalization = 1.0f / (0.25f * n * 0.25f * n);
+
+    // Log-spaced band edges mapped to FFT bins; narrow low bands use their nearest bin
+    const int bands = settings.bands;
+    const double binHz = static_cast<double>(sampleRate) / n;
+    const double ratio = std::log(static_cast<double>(m_settings.maxFrequency) / m_settings.minFrequency);
+    m_bandFirst.resize(bands);
+    m_bandLast.resize(bands);
+    for (int b = 0; b < bands; b++) {
+        const double lo = m_settings.minFrequency * std::exp(ratio * b / bands);
+        const double hi = m_settings.minFrequency * std::exp(ratio * (b + 1) / bands);
+        int first = static_cast<int>(std::ceil(lo / binHz));
+        int last = static_cast<int>(std::floor(hi / binHz));
+        if (last < first) {
+            first = last = static_cast<int>(std::lround(0.5 * (lo + hi) / binHz));
+        }
+        m_bandFirst[b] = std::clamp(first, 0, m_fft.bins() - 1);
+        m_bandLast[b] = std::clamp(last, m_bandFirst[b], m_fft.bins() - 1);
+    }
+
+    for (Snapshot& snapshot : m_buffers) {
+        snapshot.levels.assign(bands, kFloorDb);
+        snapshot.sequence = 0;
+    }
+    m_back = 0;
+    m_front = 1;
+    m_middle = 2;
+    m_sequence = 0;
+
+    m_running = true;
+    m_worker = std::thread(&SpectrumAnalyzer::run, this);
+    return true;
+}
+
+void SpectrumAnalyzer::stop()
+{
+    if (!m_worker.joinable()) {
+        return;
+    }
+    m_running = false;
+    m_wake.notify_one();
+    m_worker.join();
+}
+
+void SpectrumAnalyzer::push(const float* interleaved, int frames, int channels)
+{
+    if (!m_running.load(std::memory_order_relaxed) || frames <= 0 || channels <= 0) {
+        return;
+    }
+
+    const uint64_t written = m_written.load(std::memory_order_relaxed);
+    const uint64_t read = m_read.load(std::memory_order_acquire);
+    const size_t space = m_ring.size() - static_cast<size_t>(written - read);
+    const int count = static_cast<int>(std::min<size_t>(frames, space));
+    if (count < frames) {
+        m_dropped.fetch_add(frames - count, std::memory_order_relaxed);
+    }
+
+    const float scale = 1.0f / channels;
+    for (int i = 0; i < count; i++) {
+        const float* frame = interleaved + static_cast<size_t>(i) * channels;
+        float sum = 0.0f;
+        for (int c = 0; c < channels; c++) {
+            sum += frame[c];
+        }
+        m_ring[(written + i) & m_ringMask] = sum * scale;
+    }
+    m_written.store(written + count, std::memory_order_release);
+
+    // No lock here: a missed wakeup only delays the worker until its timeout
+    m_wake.notify_one();
+}
+
+void SpectrumAnalyzer::run()
+{
+    const int n = m_settings.fftSize;
+    Tracer::instance().setThreadName("spectrum analyzer");
+
+    while (m_running.load(std::memory_order_relaxed)) {
+        const uint64_t read = m_read.load(std::memory_order_relaxed);
+        const uint64_t available = m_written.load(std::memory_order_acquire) - read;
+        const int needed = m_filled < n ? n - m_filled : m_hop;
+
+        if (available < static_cast<uint64_t>(needed)) {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait_for(lock, std::chrono::milliseconds(10));
+            continue;
+        }
+
+        // Slide the history and append the new samples
+        const int keep = n - needed;
+        if (keep > 0 && needed > 0) {
+            memmove(m_history.data(), m_history.data() + needed, keep * sizeof(float));
+        }
+        for (int i = 0; i < needed; i++) {
+            m_history[keep + i] = m_ring[(read + i) & m_ringMask];
+        }
+        m_read.store(read + needed, std::memory_order_release);
+        m_filled = n;
+
+        analyze();
+        publish();
+    }
+}
+
+void SpectrumAnalyzer::analyze()
+{
+    const int n = m_settings.fftSize;
+    for (int i = 0; i < n; i++) {
+        m_windowed[i] = m_history[i] * m_window[i];
+    }
+    m_fft.forward(m_windowed.data(), m_re.data(), m_im.data());
+
+    // Peak power per band
+    std::vector<float>& levels = m_buffers[m_back].levels;
+    for (size_t b = 0; b < levels.size(); b++) {
+        float power = 0.0f;
+        for (int k = m_bandFirst[b]; k <= m_bandLast[b]; k++) {
+            power = std::max(power, m_re[k] * m_re[k] + m_im[k] * m_im[k]);
+        }
+        power *= m_normalization;
+        levels[b] = power > 1e-12f ? std::max(10.0f * std::log10(power), kFloorDb) : kFloorDb;
+    }
+}
+
+void SpectrumAnalyzer::publish()
+{
+    m_buffers[m_back].sequence = ++m_sequence;
+    m_back = m_middle.exchange(m_back | kFresh, std::memory_order_acq_rel) & ~kFresh;
+}
+
+const SpectrumAnalyzer::Snapshot& SpectrumAnalyzer::latest()
+{
+    if (m_middle.load(std::memory_order_relaxed) & kFresh) {
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & ~kFresh;
+    }
+    return m_buffers[m_front];
+}
@@ -0,0 +1,150 @@
+#include "incl/SpectrumWidget.h"
+#include "incl/Tracer.h"
+#include <QPainter>
+#include <QPaintEvent>
+#include <algorithm>
+
+namespace {
+    constexpr float kMinDb = -90.0f;
+    constexpr float kMaxDb = 0.0f;
+    constexpr float kFalloffDb = 1.5f;  // Per poll, ~45 dB/s
+    constexpr int kHistory = 128;       // Waterfall rows
+    constexpr int kColors = 256;
+
+    // Black -> blue -> magenta -> orange -> yellow -> white
+    QRgb heatColor(float t)
+    {
+        static const QColor stops[] = { QColor(0, 0, 0), QColor(20, 20, 140), QColor(160, 30, 160),
+            QColor(240, 120, 30), QColor(250, 230, 60), QColor(255, 255, 255) };
+        constexpr int last = sizeof(stops) / sizeof(stops[0]) - 1;
+        const float x = std::clamp(t, 0.0f, 1.0f) * last;
+        const int i = std::min(static_cast<int>(x), last - 1);
+        const float f = x - i;
+        const QColor& a = stops[i];
+        const QColor& b = stops[i + 1];
+        return qRgb(a.red() + (b.red() - a.red()) * f,
+            a.green() + (b.green() - a.green()) * f,
+            a.blue() + (b.blue() - a.blue()) * f);
+    }
+}
+
+SpectrumWidget::SpectrumWidget(QWidget* parent, const QString& label)
+    : QWidget(parent),
+    m_label(label)
+{
+    setMinimumHeight(120);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+
+    m_colormap.resize(kColors);
+    for (int i = 0; i < kColors; i++) {
+        m_colormap[i] = heatColor(static_cast<float>(i) / (kColors - 1));
+    }
+
+    m_pollTimer.setInterval(33); // ~30 FPS, about the analyzer's update rate
+    connect(&m_pollTimer, &QTimer::timeout, this, &SpectrumWidget::poll);
+}
+
+void SpectrumWidget::setAnalyzer(SpectrumAnalyzer* analyzer)
+{
+    m_analyzer = analyzer;
+    m_lastSequence = 0;
+    m_bars.clear();
+    m_waterfall = QImage();
+
+    if (m_analyzer) {
+        m_pollTimer.start();
+    }
+    else {
+        m_pollTimer.stop();
+    }
+    update();
+}
+
+int SpectrumWidget::levelToIndex(float db) const
+{
+    const float t = (db - kMinDb) / (kMaxDb - kMinDb);
+    return std::clamp(static_cast<int>(t * (kColors - 1)), 0, kColors - 1);
+}
+
+void SpectrumWidget::poll()
+{
+    if (!m_analyzer || !m_analyzer->isRunning()) {
+        return;
+    }
+
+    const SpectrumAnalyzer::Snapshot& snapshot = m_analyzer->latest();
+    if (snapshot.sequence == m_lastSequence || snapshot.levels.empty()) {
+        return;
+    }
+    m_lastSequence = snapshot.sequence;
+
+    const int bands = static_cast<int>(snapshot.levels.size());
+    if (m_bars.size() != bands) {
+        m_bars.fill(kMinDb, bands);
+        m_waterfall = QImage(bands, kHistory, QImage::Format_RGB32);
+        m_waterfall.fill(m_colormap[0]);
+        m_waterfallRow = 0;
+    }
+
+    // Bars jump up and fall off slowly; the waterfall shows the raw levels
+    m_waterfallRow = (m_waterfallRow + kHistory - 1) % kHistory;
+    QRgb* row = reinterpret_cast<QRgb*>(m_waterfall.scanLine(m_waterfallRow));
+    for (int b = 0; b < bands; b++) {
+        const float level = snapshot.levels[b];
+        m_bars[b] = std::max(level, m_bars[b] - kFalloffDb);
+        row[b] = m_colormap[levelToIndex(level)];
+    }
+
+    update();
+}
+
+void SpectrumWidget::resizeEvent(QResizeEvent* event)
+{
+    QWidget::resizeEvent(event);
+
+    const QRect area = rect().adjusted(5, 20, -5, -5);
+    const int barsHeight = area.height() * 2 / 5;
+    m_barsRect = QRect(area.left(), area.top(), area.width(), barsHeight);
+    m_waterfallRect = QRect(area.left(), m_barsRect.bottom() + 3, area.width(), area.bottom() - m_barsRect.bottom() - 2);
+}
+
+void SpectrumWidget::paintEvent(QPaintEvent* event)
+{
+    TraceScope trace("spectrum paint");
+    QPainter painter(this);
+    painter.fillRect(event->rect(), QColor(40, 40, 40));
+
+    painter.setPen(Qt::white);
+    painter.drawText(QRect(5, 0, width() - 10, 20), Qt::AlignLeft | Qt::AlignVCenter, m_label);
+
+    painter.fillRect(m_barsRect, Qt::black);
+    const int bands = m_bars.size();
+    if (bands == 0) {
+        return;
+    }
+
+    // Bars, colored by level
+    for (int b = 0; b < bands; b++) {
+        const int left = m_barsRect.left() + m_barsRect.width() * b / bands;
+        const int right = m_barsRect.left() + m_barsRect.width() * (b + 1) / bands - 1;
+        const float t = (m_bars[b] - kMinDb) / (kMaxDb - kMinDb);
+        const int height = static_cast<int>(std::clamp(t, 0.0f, 1.0f) * m_barsRect.height());
+        if (height > 0 && right >= left) {
+            painter.fillRect(QRect(left, m_barsRect.bottom() - height + 1, right - left + 1, height),
+                QColor(m_colormap[levelToIndex(m_bars[b])]));
+        }
+    }
+
+    // Waterfall ring, newest row at the top: [row, end) then [0, row)
+    if (!m_waterfall.isNull() && m_waterfallRect.height() > 0) {
+        const int rowsAbove = kHistory - m_waterfallRow;
+        const int split = m_waterfallRect.top() + m_waterfallRect.height() * rowsAbove / kHistory;
+        painter.drawImage(QRect(m_waterfallRect.left(), m_waterfallRect.top(), m_waterfallRect.width(), split - m_waterfallRect.top()),
+            m_waterfall, QRect(0, m_waterfallRow, bands, rowsAbove));
+        if (m_waterfallRow > 0) {
+            painter.drawImage(QRect(m_waterfallRect.left(), split, m_waterfallRect.width(), m_waterfallRect.bottom() + 1 - split),
+                m_waterfall, QRect(0, 0, bands, m_waterfallRow));
+        }
+    }
+}
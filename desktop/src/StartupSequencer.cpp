@@ -0,0 +1,172 @@
+#include "incl/StartupSequencer.h"
+#include "incl/Tracer.h"
+#include <cstdio>
+
+StartupSequencer::~StartupSequencer()
+{
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+int StartupSequencer::add(const std::string& name, Task task, Callback ready)
+{
+    if (m_started) {
+        return -1;
+    }
+    Phase phase;
+    phase.name = name;
+    {
+        // The metrics scrape may already be reading
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_phases.push_back(phase);
+    }
+    m_entries.push_back(Entry{ std::move(task), std::move(ready) });
+    return static_cast<int>(m_phases.size()) - 1;
+}
+
+void StartupSequencer::start(bool parallel)
+{
+    if (m_started) {
+        return;
+    }
+    m_started = true;
+    m_start = Clock::now();
+    m_end = m_start;
+    if (m_entries.empty()) {
+        return;
+    }
+
+    if (parallel) {
+        for (size_t i = 0; i < m_entries.size(); i++) {
+            m_threads.emplace_back(&StartupSequencer::runPhase, this, i);
+        }
+    }
+    else {
+        m_threads.emplace_back([this] {
+            for (size_t i = 0; i < m_entries.size(); i++) {
+                runPhase(i);
+            }
+        });
+    }
+}
+
+void StartupSequencer::runPhase(size_t index)
+{
+    std::string threadName;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        threadName = "startup: " + m_phases[index].name;
+        m_phases[index].startMicros = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_start).count();
+    }
+    Tracer::instance().setThreadName(threadName.c_str());
+
+    const Clock::time_point begin = Clock::now();
+    std::string error;
+    bool ok;
+    {
+        TraceScope trace("startup phase");
+        ok = m_entries[index].task(error);
+    }
+    const Clock::time_point end = Clock::now();
+
+    Phase result;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Phase& phase = m_phases[index];
+        phase.finished = true;
+        phase.ok = ok;
+        phase.error = ok ? std::string() : (error.empty() ? "failed" : error);
+        phase.durationMicros = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+        result = phase;
+    }
+
+    // Before the phase counts as finished, so wait() returning means every callback ran
+    if (m_entries[index].ready) {
+        m_entries[index].ready(result);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finished++;
+        m_end = Clock::now();
+    }
+    m_done.notify_all();
+}
+
+void StartupSequencer::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_finished == m_phases.size(); });
+}
+
+bool StartupSequencer::waitFor(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_done.wait_for(lock, timeout, [this] { return m_finished == m_phases.size(); });
+}
+
+bool StartupSequencer::isFinished() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_started && m_finished == m_phases.size();
+}
+
+StartupSequencer::Phase StartupSequencer::phase(int index) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_phases.at(index);
+}
+
+std::vector<StartupSequencer::Phase> StartupSequencer::phases() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_phases;
+}
+
+int64_t StartupSequencer::elapsedMicros() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_started) {
+        return 0;
+    }
+    const Clock::time_point end = m_finished == m_phases.size() ? m_end : Clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(end - m_start).count();
+}
+
+std::string StartupSequencer::report() const
+{
+    std::string text;
+    char line[256];
+    for (const Phase& phase : phases()) {
+        if (!phase.finished) {
+            std::snprintf(line, sizeof(line), "  %-16s still running\n", phase.name.c_str());
+        }
+        else {
+            std::snprintf(line, sizeof(line), "  %-16s +%7.1f ms  %7.1f ms  %s\n", phase.name.c_str(),
+                phase.startMicros / 1000.0, phase.durationMicros / 1000.0, phase.ok ? "ok" : phase.error.c_str());
+        }
+        text += line;
+    }
+    std::snprintf(line, sizeof(line), "  %-16s %19.1f ms\n", "total", elapsedMicros() / 1000.0);
+    text += line;
+    return text;
+}
+
+void StartupSequencer::collectMetrics(MetricsWriter& writer) const
+{
+    const std::vector<Phase> finished = phases();
+    for (const Phase& phase : finished) {
+        if (phase.finished) {
+            const std::string labels = "phase=\"" + phase.name + "\"";
+            writer.gauge("obs_startup_phase_seconds", "Time each startup phase took to bring its backend up.",
+                phase.durationMicros / 1e6, labels.c_str());
+        }
+    }
+    for (const Phase& phase : finished) {
+        if (phase.finished) {
+            const std::string labels = "phase=\"" + phase.name + "\"";
+            writer.gauge("obs_startup_phase_ok", "1 if the startup phase succeeded.", phase.ok ? 1.0 : 0.0, labels.c_str());
+        }
+    }
+}
@@ -0,0 +1,153 @@
+#include "incl/SyntheticAudioSource.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+    constexpr double kTwoPi = 6.283185307179586;
+}
+
+bool SyntheticAudioSource::parseScript(const std::string& text, std::vector<Segment>& script, std::string& error)
+{
+    script.clear();
+    size_t begin = 0;
+    while (begin <= text.size()) {
+        size_t end = text.find(',', begin);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        const std::string item = text.substr(begin, end - begin);
+        const size_t colon = item.find(':');
+        const std::string name = item.substr(0, colon);
+
+        Segment segment;
+        if (name == "tone") {
+            segment.signal = Signal::Tone;
+        }
+        else if (name == "noise") {
+            segment.signal = Signal::Noise;
+        }
+        else if (name == "silence") {
+            segment.signal = Signal::Silence;
+        }
+        else {
+            error = "unknown audio signal \"" + name + "\" (tone, noise, silence)";
+            return false;
+        }
+        if (colon != std::string::npos) {
+            char* last = nullptr;
+            segment.seconds = std::strtod(item.c_str() + colon + 1, &last);
+            if (*last != '\0' || segment.seconds < 0.0) {
+                error = "bad duration in \"" + item + "\"";
+                return false;
+            }
+        }
+        script.push_back(segment);
+        begin = end + 1;
+    }
+    return true;
+}
+
+bool SyntheticAudioSource::parseFormat(const std::string& text, SampleFormat& format)
+{
+    static const struct { const char* name; SampleFormat format; } kFormats[] = {
+        { "u8", SampleFormat::U8 }, { "s16", SampleFormat::S16 }, { "s24", SampleFormat::S24 },
+        { "s32", SampleFormat::S32 }, { "f32", SampleFormat::F32 },
+    };
+    for (const auto& entry : kFormats) {
+        if (text == entry.name) {
+            format = entry.format;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SyntheticAudioSource::configure(const Settings& settings)
+{
+    if (settings.sampleRate < 8000 || settings.sampleRate > 384000 || settings.script.empty()) {
+        return false;
+    }
+    if (!m_converter.configure(SampleFormat::F32, false, settings.format, settings.planar, settings.channels)) {
+        return false;
+    }
+
+    m_settings = settings;
+    m_block.assign(static_cast<size_t>(kBlockFrames) * settings.channels, 0.0f);
+    m_amplitude = static_cast<float>(std::pow(10.0, settings.levelDb / 20.0));
+    m_phase = 0.0;
+    m_phaseStep = kTwoPi * settings.frequency / settings.sampleRate;
+    m_rng = settings.seed ? settings.seed : 1;
+    m_position = 0;
+    m_segment = static_cast<int>(settings.script.size()) - 1;
+    nextSegment();
+    return true;
+}
+
+void SyntheticAudioSource::generate(void* const* out, int frames)
+{
+    // Float blocks through the converter, which writes straight into the caller's buffers
+    const int planes = m_settings.planar ? m_settings.channels : 1;
+    const int advance = m_settings.planar ? bytesPerSample(m_settings.format) : bytesPerFrame();
+    for (int done = 0; done < frames;) {
+        const int count = std::min(frames - done, kBlockFrames);
+        render(m_block.data(), count);
+
+        void* dst[SampleConverter::kMaxChannels];
+        for (int p = 0; p < planes; p++) {
+            dst[p] = static_cast<uint8_t*>(out[p]) + static_cast<size_t>(done) * advance;
+        }
+        const void* src = m_block.data();
+        m_converter.convert(&src, dst, count);
+        done += count;
+    }
+}
+
+void SyntheticAudioSource::render(float* interleaved, int frames)
+{
+    const int channels = m_settings.channels;
+    for (int i = 0; i < frames; i++) {
+        if (m_segmentLeft == 0) {
+            nextSegment();
+        }
+        float* frame = interleaved + static_cast<size_t>(i) * channels;
+        switch (signal()) {
+        case Signal::Tone: {
+            const float sample = m_amplitude * static_cast<float>(std::sin(m_phase));
+            std::fill_n(frame, channels, sample);
+            m_phase += m_phaseStep;
+            if (m_phase >= kTwoPi) {
+                m_phase -= kTwoPi;
+            }
+            break;
+        }
+        case Signal::Noise:
+            for (int c = 0; c < channels; c++) {
+                frame[c] = m_amplitude * (static_cast<float>(random() >> 8) * (2.0f / 16777216.0f) - 1.0f);
+            }
+            break;
+        case Signal::Silence:
+            std::fill_n(frame, channels, 0.0f);
+            break;
+        }
+        if (m_segmentLeft > 0) {
+            m_segmentLeft--;
+        }
+        m_position++;
+    }
+}
+
+void SyntheticAudioSource::nextSegment()
+{
+    m_segment = (m_segment + 1) % static_cast<int>(m_settings.script.size());
+    const double seconds = m_settings.script[m_segment].seconds;
+    m_segmentLeft = seconds > 0.0 ? std::max<int64_t>(1, std::llround(seconds * m_settings.sampleRate)) : -1;
+}
+
+uint32_t SyntheticAudioSource::random()
+{
+    m_rng ^= m_rng << 13;
+    m_rng ^= m_rng >> 17;
+    m_rng ^= m_rng << 5;
+    return m_rng;
+}
@@ -0,0 +1,633 @@
+#include "incl/SyntheticSource.h"
+#include "incl/ThreadPool.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    constexpr uint32_t kWhite = 0xFFFFFFFF;
+    constexpr uint32_t kText = 0xFF202020;
+    constexpr uint32_t kTitleBar = 0xFF5A3A1E; // BGRA: dark blue
+    constexpr uint32_t kBorder = 0xFF404040;
+
+    // Unit grid the cursors are drawn on, scaled up with the UI
+    constexpr int kCursorUnits = 32;
+
+    // Frames per cursor shape in the cursor workload, and per caret blink
+    constexpr int kShapeFrames = 90;
+    constexpr int kBlinkFrames = 30;
+
+    uint32_t mix(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7FEB352Du;
+        x ^= x >> 15;
+        x *= 0x846CA68Bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    uint32_t hash(uint32_t a, uint32_t b)
+    {
+        return mix(a * 0x9E3779B9u ^ mix(b + 0x632BE5ABu));
+    }
+
+    // 5x7 glyph for a character code: a few set bits per row, code 0 is a space
+    uint32_t glyphRow(uint32_t code, int row)
+    {
+        if (code == 0) {
+            return 0;
+        }
+        const uint32_t bits = hash(code, row) & 0x1F;
+        return bits | (row == 6 ? 0 : 0x04); // a stem keeps rows from looking like noise
+    }
+
+    SceneRect intersect(const SceneRect& a, const SceneRect& b)
+    {
+        const int x0 = std::max(a.x, b.x);
+        const int y0 = std::max(a.y, b.y);
+        const int x1 = std::min(a.x + a.width, b.x + b.width);
+        const int y1 = std::min(a.y + a.height, b.y + b.height);
+        return x1 > x0 && y1 > y0 ? SceneRect{ x0, y0, x1 - x0, y1 - y0 } : SceneRect();
+    }
+
+    uint32_t* pixelAt(const FrameView& frame, int x, int y)
+    {
+        return reinterpret_cast<uint32_t*>(frame.row(y)) + x;
+    }
+
+    bool insidePolygon(const float* points, int count, float x, float y)
+    {
+        bool inside = false;
+        for (int i = 0, j = count - 1; i < count; j = i++) {
+            const float xi = points[i * 2], yi = points[i * 2 + 1];
+            const float xj = points[j * 2], yj = points[j * 2 + 1];
+            if ((yi > y) != (yj > y) && x < (xj - xi) * (y - yi) / (yj - yi) + xi) {
+                inside = !inside;
+            }
+        }
+        return inside;
+    }
+
+    struct WorkloadName
+    {
+        SyntheticSource::Workload workload;
+        const char* name;
+    };
+
+    const WorkloadName kWorkloadNames[] = {
+        { SyntheticSource::Workload::Idle, "idle" },
+        { SyntheticSource::Workload::Typing, "typing" },
+        { SyntheticSource::Workload::WindowDrag, "drag" },
+        { SyntheticSource::Workload::Scrolling, "scroll" },
+        { SyntheticSource::Workload::VideoNoise, "noise" },
+        { SyntheticSource::Workload::CursorMotion, "cursor" },
+    };
+}
+
+SyntheticSource::SyntheticSource()
+{
+}
+
+SyntheticSource::SyntheticSource(const Settings& settings)
+    : m_settings(settings)
+{
+}
+
+const char* SyntheticSource::workloadName(Workload workload)
+{
+    for (const WorkloadName& entry : kWorkloadNames) {
+        if (entry.workload == workload) {
+            return entry.name;
+        }
+    }
+    return "unknown";
+}
+
+bool SyntheticSource::parseScript(const std::string& text, std::vector<Step>& script, std::string& error)
+{
+    script.clear();
+    size_t begin = 0;
+    while (begin <= text.size()) {
+        size_t end = text.find(',', begin);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        const std::string item = text.substr(begin, end - begin);
+        const size_t colon = item.find(':');
+        const std::string name = item.substr(0, colon);
+
+        Step step;
+        bool known = false;
+        for (const WorkloadName& entry : kWorkloadNames) {
+            if (name == entry.name) {
+                step.workload = entry.workload;
+                known = true;
+            }
+        }
+        if (!known) {
+            error = "unknown workload \"" + name + "\" (idle, typing, drag, scroll, noise, cursor)";
+            return false;
+        }
+        if (colon != std::string::npos) {
+            char* last = nullptr;
+            const long frames = std::strtol(item.c_str() + colon + 1, &last, 10);
+            if (*last != '\0' || frames < 0 || frames > 100000000) {
+                error = "bad frame count in \"" + item + "\"";
+                return false;
+            }
+            step.frames = static_cast<int>(frames);
+        }
+        script.push_back(step);
+        begin = end + 1;
+    }
+    return true;
+}
+
+bool SyntheticSource::initialize()
+{
+    const int width = m_settings.width;
+    const int height = m_settings.height;
+    if (width < 320 || height < 240 || width > kMaxWidth || height > kMaxHeight) {
+        m_error = "synthetic size must be between 320x240 and 7680x4320";
+        return false;
+    }
+    if (m_settings.script.empty()) {
+        m_error = "empty workload script";
+        return false;
+    }
+
+    m_frame.resize(width, height);
+    if (!m_frame.view().isValid()) {
+        m_error = "cannot allocate the frame";
+        return false;
+    }
+
+    m_scale = std::max(1, (height + 540) / 1080);
+    m_rng = m_settings.seed ? m_settings.seed : 1;
+    m_frameIndex = 0;
+    m_step = 0;
+    m_stepFrame = 0;
+    m_window = SceneRect{ width / 8, height / 8, width * 11 / 20, height * 3 / 5 };
+    m_windowImage.resize(m_window.width, m_window.height);
+    m_documentTop = 0;
+    m_noiseOnScreen = false;
+    m_damage.reserve(16);
+
+    m_cursorSize = kCursorUnits * m_scale;
+    m_cursor.assign(static_cast<size_t>(m_cursorSize) * m_cursorSize, 0);
+    m_saveUnder.assign(m_cursor.size(), 0);
+    m_savedRect = SceneRect();
+    m_cursorX = m_window.x + m_window.width / 2;
+    m_cursorY = m_window.y + m_window.height / 2;
+    buildCursor(CursorShape::Arrow);
+    m_caretX = contentRect().x + 4 * m_scale;
+    m_caretY = contentRect().y + 4 * m_scale;
+
+    drawDesktop();
+    return true;
+}
+
+bool SyntheticSource::acquireFrame(SourceFrame& frame)
+{
+    TraceScope trace("capture");
+    const FrameView view = m_frame.view();
+    if (!view.isValid()) {
+        m_error = "not initialized";
+        return false;
+    }
+
+    m_damage.clear();
+    if (m_frameIndex == 0) {
+        addDamage(SceneRect{ 0, 0, view.width, view.height });
+    }
+
+    // Take the cursor off so the workload sees the bare desktop
+    const SceneRect oldCursor = m_savedRect;
+    const CursorShape oldShape = m_cursorShape;
+    restoreUnderCursor();
+
+    if (m_stepFrame == 0) {
+        beginStep();
+    }
+    runWorkload();
+
+    drawCursor(m_cursorX, m_cursorY);
+    const bool cursorMoved = m_savedRect != oldCursor || m_frameIndex == 0;
+    const bool shapeChanged = m_cursorShape != oldShape || m_frameIndex == 0;
+    if (cursorMoved || shapeChanged) {
+        addDamage(oldCursor);
+        addDamage(m_savedRect);
+
+        m_cursorUpdate.x = m_cursorX;
+        m_cursorUpdate.y = m_cursorY;
+        m_cursorUpdate.visible = true;
+        m_cursorUpdate.shapeType = shapeChanged ? CursorUpdate::Color : CursorUpdate::Unchanged;
+        m_cursorUpdate.width = m_cursorSize;
+        m_cursorUpdate.height = m_cursorSize;
+        m_cursorUpdate.pitch = m_cursorSize * 4;
+        m_cursorUpdate.shape = reinterpret_cast<const uint8_t*>(m_cursor.data());
+    }
+    buildChangeMap();
+
+    frame.pixels = view;
+    frame.changes = &m_changes;
+    frame.cursor = cursorMoved || shapeChanged ? &m_cursorUpdate : nullptr;
+    frame.timestampUs = static_cast<int64_t>(m_frameIndex * 1000000 / std::max(m_settings.fps, 1));
+
+    m_frameIndex++;
+    m_stepFrame++;
+    const Step& step = m_settings.script[m_step];
+    if (step.frames > 0 && m_stepFrame >= step.frames) {
+        m_step = (m_step + 1) % static_cast<int>(m_settings.script.size());
+        m_stepFrame = 0;
+    }
+    return true;
+}
+
+void SyntheticSource::beginStep()
+{
+    if (m_noiseOnScreen && workload() != Workload::VideoNoise) {
+        // Back from full-screen video: the desktop comes back as it was
+        const FrameView view = m_frame.view();
+        drawDesktop();
+        addDamage(SceneRect{ 0, 0, view.width, view.height });
+        m_noiseOnScreen = false;
+    }
+
+    const SceneRect content = contentRect();
+    switch (workload()) {
+    case Workload::Typing:
+        // Fresh page, caret at the top left
+        fillRect(content, kWhite);
+        addDamage(content);
+        m_caretX = content.x + 4 * m_scale;
+        m_caretY = content.y + 4 * m_scale;
+        m_lineLength = 20 + random() % 60;
+        break;
+    case Workload::WindowDrag:
+        snapshotWindow();
+        break;
+    default:
+        break;
+    }
+}
+
+void SyntheticSource::runWorkload()
+{
+    const SceneRect content = contentRect();
+    const int t = m_stepFrame;
+
+    switch (workload()) {
+    case Workload::Idle: {
+        // Caret blink, cursor resting
+        if (t % kBlinkFrames == 0) {
+            const SceneRect caret{ m_caretX, m_caretY, m_scale, 9 * m_scale };
+            fillRect(caret, (t / kBlinkFrames) % 2 ? kWhite : kText);
+            addDamage(caret);
+        }
+        setCursorShape(CursorShape::Arrow);
+        break;
+    }
+    case Workload::Typing:
+        typeGlyph();
+        setCursorShape(CursorShape::IBeam);
+        m_cursorX = content.x + content.width * 2 / 3;
+        m_cursorY = content.y + content.height / 3;
+        break;
+    case Workload::WindowDrag:
+        dragWindow();
+        setCursorShape(CursorShape::Arrow);
+        m_cursorX = m_window.x + 60 * m_scale;
+        m_cursorY = m_window.y + 8 * m_scale;
+        break;
+    case Workload::Scrolling:
+        scrollWindow();
+        setCursorShape(CursorShape::Arrow);
+        m_cursorX = content.x + content.width / 2;
+        m_cursorY = content.y + content.height / 2;
+        break;
+    case Workload::VideoNoise:
+        fillNoise();
+        break;
+    case Workload::CursorMotion: {
+        const FrameView view = m_frame.view();
+        const int rangeX = (view.width - m_cursorSize) / 2;
+        const int rangeY = (view.height - m_cursorSize) / 2;
+        m_cursorX = rangeX + static_cast<int>(rangeX * std::sin(t * 0.05));
+        m_cursorY = rangeY + static_cast<int>(rangeY * std::sin(t * 0.037));
+        setCursorShape(static_cast<CursorShape>((t / kShapeFrames) % 3));
+        break;
+    }
+    }
+}
+
+void SyntheticSource::typeGlyph()
+{
+    const SceneRect content = contentRect();
+    const int cellWidth = 6 * m_scale;
+    const int lineHeight = 11 * m_scale;
+    const int left = content.x + 4 * m_scale;
+
+    // Caret comes off, the glyph goes where it was
+    const SceneRect cell{ m_caretX, m_caretY, cellWidth, 9 * m_scale };
+    fillRect(cell, kWhite);
+    const uint32_t code = random() % 7 == 0 ? 0 : 1 + random() % 94;
+    drawGlyph(m_caretX, m_caretY + m_scale, code, kText);
+    addDamage(cell);
+
+    m_caretX += cellWidth;
+    m_lineLength--;
+    if (m_lineLength <= 0 || m_caretX + cellWidth > content.x + content.width - 4 * m_scale) {
+        m_caretX = left;
+        m_caretY += lineHeight;
+        m_lineLength = 20 + random() % 60;
+    }
+    if (m_caretY + lineHeight > content.y + content.height) {
+        // Page full: start over
+        fillRect(content, kWhite);
+        addDamage(content);
+        m_caretX = left;
+        m_caretY = content.y + 4 * m_scale;
+    }
+
+    const SceneRect caret{ m_caretX, m_caretY, m_scale, 9 * m_scale };
+    fillRect(caret, kText);
+    addDamage(caret);
+}
+
+void SyntheticSource::dragWindow()
+{
+    const FrameView view = m_frame.view();
+    const int rangeX = (view.width - m_window.width) / 2;
+    const int rangeY = (view.height - m_window.height) / 2;
+    const double t = m_stepFrame;
+    const SceneRect target{ rangeX + static_cast<int>(rangeX * std::sin(t * 0.021)),
+        rangeY + static_cast<int>(rangeY * std::sin(t * 0.033)), m_window.width, m_window.height };
+    if (target == m_window) {
+        return;
+    }
+
+    fillBackground(m_window);
+    addDamage(m_window);
+
+    const FrameView image = m_windowImage.view();
+    for (int y = 0; y < target.height; y++) {
+        std::memcpy(pixelAt(view, target.x, target.y + y), image.row(y), static_cast<size_t>(target.width) * 4);
+    }
+    m_window = target;
+    addDamage(m_window);
+}
+
+void SyntheticSource::scrollWindow()
+{
+    // Smooth scrolling, about ten lines a second at 60 fps
+    const SceneRect content = contentRect();
+    const int step = 2 * m_scale;
+    const FrameView view = m_frame.view();
+    for (int y = 0; y + step < content.height; y++) {
+        std::memcpy(pixelAt(view, content.x, content.y + y), pixelAt(view, content.x, content.y + y + step),
+            static_cast<size_t>(content.width) * 4);
+    }
+    m_documentTop += step;
+    drawDocumentRows(content.height - step, step);
+    addDamage(content);
+}
+
+void SyntheticSource::fillNoise()
+{
+    // Rows are seeded from the frame and row number, so the split doesn't matter
+    const FrameView view = m_frame.view();
+    const uint32_t frameSeed = hash(m_settings.seed, static_cast<uint32_t>(m_frameIndex));
+    ThreadPool::instance().parallelFor(view.height, [&](int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            uint32_t state = hash(frameSeed, y) | 1;
+            uint32_t* row = pixelAt(view, 0, y);
+            for (int x = 0; x < view.width; x++) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                row[x] = state | 0xFF000000;
+            }
+        }
+    }, 16);
+    addDamage(SceneRect{ 0, 0, view.width, view.height });
+    m_noiseOnScreen = true;
+}
+
+void SyntheticSource::drawDesktop()
+{
+    const FrameView view = m_frame.view();
+    fillBackground(SceneRect{ 0, 0, view.width, view.height });
+
+    // Window: border, title bar, then the document
+    fillRect(m_window, kBorder);
+    fillRect(SceneRect{ m_window.x + m_scale, m_window.y + m_scale, m_window.width - 2 * m_scale, 24 * m_scale }, kTitleBar);
+    for (int i = 0; i < 3; i++) {
+        const int size = 12 * m_scale;
+        fillRect(SceneRect{ m_window.x + m_window.width - (i + 1) * (size + 6 * m_scale), m_window.y + 7 * m_scale, size, size },
+            0xFFC0C0C0);
+    }
+    drawDocumentRows(0, contentRect().height);
+}
+
+void SyntheticSource::fillBackground(const SceneRect& rect)
+{
+    const FrameView view = m_frame.view();
+    const SceneRect clipped = intersect(rect, SceneRect{ 0, 0, view.width, view.height });
+    for (int y = clipped.y; y < clipped.y + clipped.height; y++) {
+        std::fill_n(pixelAt(view, clipped.x, y), clipped.width, backgroundColor(y));
+    }
+}
+
+void SyntheticSource::fillRect(const SceneRect& rect, uint32_t color)
+{
+    const FrameView view = m_frame.view();
+    const SceneRect clipped = intersect(rect, SceneRect{ 0, 0, view.width, view.height });
+    for (int y = clipped.y; y < clipped.y + clipped.height; y++) {
+        std::fill_n(pixelAt(view, clipped.x, y), clipped.width, color);
+    }
+}
+
+void SyntheticSource::drawGlyph(int x, int y, uint32_t code, uint32_t color)
+{
+    for (int row = 0; row < 7; row++) {
+        const uint32_t bits = glyphRow(code, row);
+        for (int column = 0; column < 5; column++) {
+            if (bits & (1u << column)) {
+                fillRect(SceneRect{ x + column * m_scale, y + row * m_scale, m_scale, m_scale }, color);
+            }
+        }
+    }
+}
+
+void SyntheticSource::drawDocumentRows(int firstRow, int rowCount)
+{
+    // Document lines are a pure function of the line number, so any part can be redrawn
+    const FrameView view = m_frame.view();
+    const SceneRect content = contentRect();
+    const int cellWidth = 6 * m_scale;
+    const int lineHeight = 11 * m_scale;
+    const int left = 4 * m_scale;
+    const int columns = (content.width - 2 * left) / cellWidth;
+
+    for (int row = firstRow; row < firstRow + rowCount; row++) {
+        uint32_t* pixels = pixelAt(view, content.x, content.y + row);
+        std::fill_n(pixels, content.width, kWhite);
+
+        const int documentY = m_documentTop + row;
+        const int line = documentY / lineHeight;
+        const int glyphY = (documentY % lineHeight) / m_scale - 2;
+        if (glyphY < 0 || glyphY >= 7) {
+            continue;
+        }
+        const uint32_t lineHash = hash(m_settings.seed, line);
+        const int length = line % 12 == 11 ? 0 : std::min(columns, static_cast<int>(10 + lineHash % 70));
+        for (int column = 0; column < length; column++) {
+            const uint32_t code = hash(lineHash, column) % 7 == 0 ? 0 : 1 + hash(lineHash, column) % 94;
+            const uint32_t bits = glyphRow(code, glyphY);
+            for (int bit = 0; bit < 5; bit++) {
+                if (bits & (1u << bit)) {
+                    std::fill_n(pixels + left + column * cellWidth + bit * m_scale, m_scale, kText);
+                }
+            }
+        }
+    }
+}
+
+void SyntheticSource::snapshotWindow()
+{
+    const FrameView view = m_frame.view();
+    const FrameView image = m_windowImage.view();
+    for (int y = 0; y < m_window.height; y++) {
+        std::memcpy(image.row(y), pixelAt(view, m_window.x, m_window.y + y), static_cast<size_t>(m_window.width) * 4);
+    }
+}
+
+void SyntheticSource::setCursorShape(CursorShape shape)
+{
+    if (shape != m_cursorShape) {
+        buildCursor(shape);
+    }
+}
+
+void SyntheticSource::buildCursor(CursorShape shape)
+{
+    m_cursorShape = shape;
+    // Shape mask on the unit grid; the arrow is filled white with a black edge, the
+    // others are black with a white halo, like the system cursors
+    bool mask[kCursorUnits][kCursorUnits] = {};
+    static const float kArrow[] = { 0, 0, 0, 21, 5, 16, 9, 25, 12, 24, 8, 15, 15, 15 };
+    for (int y = 0; y < kCursorUnits; y++) {
+        for (int x = 0; x < kCursorUnits; x++) {
+            switch (shape) {
+            case CursorShape::Arrow:
+                mask[y][x] = insidePolygon(kArrow, 7, x + 0.5f, y + 0.5f);
+                break;
+            case CursorShape::IBeam:
+                mask[y][x] = (x >= 15 && x < 17 && y >= 4 && y < 28) ||
+                    ((y == 3 || y == 28) && x >= 12 && x < 20);
+                break;
+            case CursorShape::Crosshair:
+                mask[y][x] = ((x >= 15 && x < 17) || (y >= 15 && y < 17)) &&
+                    x >= 4 && x < 28 && y >= 4 && y < 28;
+                break;
+            }
+        }
+    }
+
+    auto masked = [&](int x, int y) {
+        return x >= 0 && y >= 0 && x < kCursorUnits && y < kCursorUnits && mask[y][x];
+    };
+    for (int uy = 0; uy < kCursorUnits; uy++) {
+        for (int ux = 0; ux < kCursorUnits; ux++) {
+            const bool inside = mask[uy][ux];
+            const bool nearby = masked(ux - 1, uy) || masked(ux + 1, uy) || masked(ux, uy - 1) || masked(ux, uy + 1);
+            const bool edge = inside && !(masked(ux - 1, uy) && masked(ux + 1, uy) && masked(ux, uy - 1) && masked(ux, uy + 1));
+            uint32_t color = 0;
+            if (shape == CursorShape::Arrow) {
+                color = inside ? (edge ? 0xFF000000 : kWhite) : 0;
+            }
+            else {
+                color = inside ? 0xFF000000 : (nearby ? kWhite : 0);
+            }
+            for (int sy = 0; sy < m_scale; sy++) {
+                std::fill_n(&m_cursor[static_cast<size_t>(uy * m_scale + sy) * m_cursorSize + ux * m_scale], m_scale, color);
+            }
+        }
+    }
+}
+
+void SyntheticSource::restoreUnderCursor()
+{
+    if (m_savedRect.isEmpty()) {
+        return;
+    }
+    const FrameView view = m_frame.view();
+    for (int y = 0; y < m_savedRect.height; y++) {
+        std::memcpy(pixelAt(view, m_savedRect.x, m_savedRect.y + y), &m_saveUnder[static_cast<size_t>(y) * m_savedRect.width],
+            static_cast<size_t>(m_savedRect.width) * 4);
+    }
+}
+
+void SyntheticSource::drawCursor(int x, int y)
+{
+    const FrameView view = m_frame.view();
+    m_savedRect = intersect(SceneRect{ x, y, m_cursorSize, m_cursorSize }, SceneRect{ 0, 0, view.width, view.height });
+    for (int row = 0; row < m_savedRect.height; row++) {
+        uint32_t* pixels = pixelAt(view, m_savedRect.x, m_savedRect.y + row);
+        std::memcpy(&m_saveUnder[static_cast<size_t>(row) * m_savedRect.width], pixels, static_cast<size_t>(m_savedRect.width) * 4);
+
+        const uint32_t* cursor = &m_cursor[static_cast<size_t>(m_savedRect.y + row - y) * m_cursorSize + (m_savedRect.x - x)];
+        for (int i = 0; i < m_savedRect.width; i++) {
+            if (cursor[i]) {
+                pixels[i] = cursor[i];
+            }
+        }
+    }
+}
+
+void SyntheticSource::addDamage(const SceneRect& rect)
+{
+    const FrameView view = m_frame.view();
+    const SceneRect clipped = intersect(rect, SceneRect{ 0, 0, view.width, view.height });
+    if (!clipped.isEmpty()) {
+        m_damage.push_back(clipped);
+    }
+}
+
+void SyntheticSource::buildChangeMap()
+{
+    const FrameView view = m_frame.view();
+    m_changes.clear(view.width, view.height, FrameChangeDetector::kTileSize);
+    for (const SceneRect& rect : m_damage) {
+        m_changes.markRect(rect.x, rect.y, rect.width, rect.height);
+    }
+}
+
+uint32_t SyntheticSource::random()
+{
+    m_rng ^= m_rng << 13;
+    m_rng ^= m_rng >> 17;
+    m_rng ^= m_rng << 5;
+    return m_rng;
+}
+
+SceneRect SyntheticSource::contentRect() const
+{
+    const int titleHeight = 25 * m_scale;
+    return SceneRect{ m_window.x + m_scale, m_window.y + titleHeight,
+        m_window.width - 2 * m_scale, m_window.height - titleHeight - m_scale };
+}
+
+uint32_t SyntheticSource::backgroundColor(int y) const
+{
+    // Vertical teal-to-navy gradient
+    const int height = m_settings.height;
+    const uint32_t b = 0x90 - 0x50 * y / height;
+    const uint32_t g = 0x70 - 0x48 * y / height;
+    const uint32_t r = 0x20 + 0x10 * y / height;
+    return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
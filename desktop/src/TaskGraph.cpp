@@ -0,0 +1,89 @@
+#include "incl/TaskGraph.h"
+#include <algorithm>
+
+int TaskGraph::addTask(const std::string& name, std::function<void()> func)
+{
+    auto task = std::make_unique<Task>();
+    task->run = &TaskGraph::runTask;
+    task->pending = &m_pending;
+    task->graph = this;
+    task->name = name;
+    task->func = std::move(func);
+    m_tasks.push_back(std::move(task));
+    return static_cast<int>(m_tasks.size()) - 1;
+}
+
+bool TaskGraph::addDependency(int before, int after)
+{
+    const int count = taskCount();
+    if (before < 0 || before >= count || after < 0 || after >= count || before == after) {
+        return false;
+    }
+    if (reaches(after, before)) {
+        return false;
+    }
+
+    std::vector<Task*>& successors = m_tasks[before]->successors;
+    if (std::find(successors.begin(), successors.end(), m_tasks[after].get()) != successors.end()) {
+        return true;
+    }
+    successors.push_back(m_tasks[after].get());
+    m_tasks[after]->dependencies++;
+    return true;
+}
+
+bool TaskGraph::reaches(int from, int to) const
+{
+    // Depth-first over successors; only runs while building the graph
+    std::vector<const Task*> stack{ m_tasks[from].get() };
+    std::vector<const Task*> seen;
+    while (!stack.empty()) {
+        const Task* task = stack.back();
+        stack.pop_back();
+        if (task == m_tasks[to].get()) {
+            return true;
+        }
+        if (std::find(seen.begin(), seen.end(), task) != seen.end()) {
+            continue;
+        }
+        seen.push_back(task);
+        stack.insert(stack.end(), task->successors.begin(), task->successors.end());
+    }
+    return false;
+}
+
+void TaskGraph::run(ThreadPool& pool)
+{
+    if (m_tasks.empty()) {
+        return;
+    }
+
+    m_pool = &pool;
+    for (const std::unique_ptr<Task>& task : m_tasks) {
+        task->remaining.store(task->dependencies, std::memory_order_relaxed);
+    }
+    m_pending.store(taskCount(), std::memory_order_release);
+
+    for (const std::unique_ptr<Task>& task : m_tasks) {
+        if (task->dependencies == 0) {
+            pool.submit(task.get());
+        }
+    }
+    pool.wait(m_pending);
+    m_pool = nullptr;
+}
+
+void TaskGraph::runTask(ThreadPool::Job* job)
+{
+    Task* task = static_cast<Task*>(job);
+    if (task->func) {
+        task->func();
+    }
+
+    // The last dependency to finish queues the successor
+    for (Task* successor : task->successors) {
+        if (successor->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            task->graph->m_pool->submit(successor);
+        }
+    }
+}
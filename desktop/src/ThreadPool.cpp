@@ -0,0 +1,310 @@
+#include "incl/ThreadPool.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+    // Which pool's worker this thread is, if any
+    thread_local const ThreadPool* t_pool = nullptr;
+    thread_local int t_workerIndex = -1;
+
+    constexpr int kMaxForHelpers = 63;
+    constexpr int kSpinRounds = 64;
+    constexpr size_t kInboxCapacity = 1024;
+}
+
+bool ThreadPool::JobDeque::push(Job* job)
+{
+    const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    const int64_t top = m_top.load(std::memory_order_acquire);
+    if (bottom - top >= kCapacity) {
+        return false;
+    }
+    m_items[bottom & (kCapacity - 1)].store(job, std::memory_order_relaxed);
+    m_bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+}
+
+ThreadPool::Job* ThreadPool::JobDeque::pop()
+{
+    const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = m_items[bottom & (kCapacity - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // Last job: race the thieves for it
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+ThreadPool::Job* ThreadPool::JobDeque::steal()
+{
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom) {
+        return nullptr;
+    }
+
+    Job* job = m_items[top & (kCapacity - 1)].load(std::memory_order_relaxed);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return job;
+}
+
+ThreadPool::ThreadPool(int threadCount)
+{
+    if (threadCount <= 0) {
+        threadCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    threadCount = std::max(threadCount, 1);
+
+    m_inbox.reserve(kInboxCapacity);
+
+    // The calling thread always takes part, so start one less worker
+    for (int i = 1; i < threadCount; i++) {
+        m_deques.push_back(std::make_unique<JobDeque>());
+    }
+    for (int i = 0; i < threadCount - 1; i++) {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::instance()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+int ThreadPool::workerIndex() const
+{
+    return t_pool == this ? t_workerIndex : -1;
+}
+
+void ThreadPool::parallelFor(int count, FunctionRef<void(int, int)> func, int grain)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    grain = std::max(grain, 1);
+    const int chunks = (count + grain - 1) / grain;
+
+    // Small jobs and single-threaded pools run inline
+    if (m_workers.empty() || chunks <= 1) {
+        func(0, count);
+        return;
+    }
+
+    // Helpers claim chunks from a shared counter until it runs dry, so a helper that
+    // starts late just finds nothing left. The caller claims chunks as well.
+    struct ForJob : Job
+    {
+        FunctionRef<void(int, int)>* func;
+        std::atomic<int>* next;
+        int count;
+        int grain;
+
+        static void runChunks(FunctionRef<void(int, int)>& func, std::atomic<int>& next, int count, int grain)
+        {
+            for (;;) {
+                const int begin = next.fetch_add(grain, std::memory_order_relaxed);
+                if (begin >= count) {
+                    break;
+                }
+                func(begin, std::min(begin + grain, count));
+            }
+        }
+    };
+
+    std::atomic<int> next{ 0 };
+    std::atomic<int> pending{ 0 };
+    ForJob helpers[kMaxForHelpers];
+    const int helperCount = std::min({ chunks - 1, static_cast<int>(m_workers.size()), kMaxForHelpers });
+
+    pending.store(helperCount, std::memory_order_relaxed);
+    for (int i = 0; i < helperCount; i++) {
+        ForJob& helper = helpers[i];
+        helper.run = [](Job* job) {
+            ForJob* self = static_cast<ForJob*>(job);
+            ForJob::runChunks(*self->func, *self->next, self->count, self->grain);
+        };
+        helper.pending = &pending;
+        helper.func = &func;
+        helper.next = &next;
+        helper.count = count;
+        helper.grain = grain;
+        submit(&helper);
+    }
+
+    ForJob::runChunks(func, next, count, grain);
+    wait(pending);
+}
+
+void ThreadPool::submit(Job* job)
+{
+    const int index = workerIndex();
+    bool queued;
+    if (index >= 0) {
+        queued = m_deques[index]->push(job);
+    }
+    else {
+        std::lock_guard<std::mutex> lock(m_inboxMutex);
+        queued = m_inbox.size() < kInboxCapacity;
+        if (queued) {
+            m_inbox.push_back(job);
+            m_inboxSize.store(static_cast<int>(m_inbox.size()), std::memory_order_release);
+        }
+    }
+
+    // No room: nobody else will see it, so do it now
+    if (!queued) {
+        execute(job);
+        return;
+    }
+    wakeWorkers(1);
+}
+
+void ThreadPool::wakeWorkers(int count)
+{
+    m_epoch.fetch_add(1, std::memory_order_seq_cst);
+    if (m_sleepers.load(std::memory_order_seq_cst) == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    if (count == 1) {
+        m_wake.notify_one();
+    }
+    else {
+        m_wake.notify_all();
+    }
+}
+
+ThreadPool::Job* ThreadPool::findJob(int index)
+{
+    if (index >= 0) {
+        if (Job* job = m_deques[index]->pop()) {
+            return job;
+        }
+    }
+
+    if (m_inboxSize.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(m_inboxMutex);
+        if (!m_inbox.empty()) {
+            // Oldest first, like a steal
+            Job* job = m_inbox.front();
+            m_inbox.erase(m_inbox.begin());
+            m_inboxSize.store(static_cast<int>(m_inbox.size()), std::memory_order_release);
+            return job;
+        }
+    }
+
+    // Start at the next deque over so thieves spread out
+    const int count = static_cast<int>(m_deques.size());
+    for (int i = 1; i <= count; i++) {
+        const int victim = (index + i + count) % count;
+        if (victim == index) {
+            continue;
+        }
+        if (Job* job = m_deques[victim]->steal()) {
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void ThreadPool::execute(Job* job)
+{
+    // The job may be gone once its counter drops, so read the counter first
+    std::atomic<int>* pending = job->pending;
+    job->run(job);
+    if (pending->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(m_doneMutex);
+        m_done.notify_all();
+    }
+}
+
+void ThreadPool::wait(std::atomic<int>& pending)
+{
+    const int index = workerIndex();
+    int idleRounds = 0;
+
+    while (pending.load(std::memory_order_acquire) > 0) {
+        if (Job* job = findJob(index)) {
+            execute(job);
+            idleRounds = 0;
+            continue;
+        }
+
+        // The remaining jobs are running elsewhere. Spin briefly, then sleep; wake up
+        // now and then in case new work shows up that this thread could help with.
+        if (++idleRounds < kSpinRounds) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_doneMutex);
+        m_done.wait_for(lock, std::chrono::milliseconds(1), [&] {
+            return pending.load(std::memory_order_acquire) == 0;
+        });
+    }
+}
+
+void ThreadPool::workerLoop(int index)
+{
+    t_pool = this;
+    t_workerIndex = index;
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "pool worker %d", index);
+    Tracer::instance().setThreadName(name);
+
+    for (;;) {
+        const unsigned epoch = m_epoch.load(std::memory_order_seq_cst);
+
+        if (Job* job = findJob(index)) {
+            execute(job);
+            continue;
+        }
+
+        // Anything pushed after the epoch was read moves it, so the wait below can't
+        // miss a job that this scan didn't see
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        if (m_stopping) {
+            return;
+        }
+        m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+        m_wake.wait(lock, [&] {
+            return m_stopping || m_epoch.load(std::memory_order_seq_cst) != epoch;
+        });
+        m_sleepers.fetch_sub(1, std::memory_order_seq_cst);
+        if (m_stopping) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#include "incl/TraceReplaySource.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+#include <thread>
+
+namespace {
+    // Real-time mode sleeps at most this long per call, so the caller can still stop
+    constexpr auto kMaxWait = std::chrono::milliseconds(50);
+}
+
+TraceReplaySource::TraceReplaySource(const Settings& settings)
+    : m_settings(settings)
+{
+}
+
+bool TraceReplaySource::initialize()
+{
+    if (!m_reader.open(m_settings.path)) {
+        m_error = m_reader.lastError();
+        return false;
+    }
+    if (m_reader.frameCount() == 0) {
+        m_error = "capture trace has no frames";
+        return false;
+    }
+    m_damage.reserve(256);
+    m_firstTimestamp = m_reader.record(0).timestampUs;
+    m_loopOffset = 0;
+    restart();
+    return true;
+}
+
+void TraceReplaySource::restart()
+{
+    m_next = 0;
+    m_atEnd = false;
+    m_start = Clock::now();
+}
+
+bool TraceReplaySource::acquireFrame(SourceFrame& frame)
+{
+    TraceScope trace("capture");
+    for (;;) {
+        if (m_next >= m_reader.recordCount()) {
+            if (!m_settings.loop) {
+                m_atEnd = true;
+                return false;
+            }
+            // The first frame is a keyframe, so the picture starts over cleanly
+            const int64_t elapsed = m_reader.duration() + (m_reader.duration() / std::max<size_t>(m_reader.frameCount(), 1));
+            m_loopOffset += elapsed;
+            m_start += std::chrono::microseconds(elapsed);
+            m_next = 0;
+        }
+
+        const CaptureTraceReader::Record& record = m_reader.record(m_next);
+        if (m_settings.realtime) {
+            const Clock::time_point due = m_start + std::chrono::microseconds(record.timestampUs - m_firstTimestamp);
+            const Clock::time_point now = Clock::now();
+            if (due > now + kMaxWait) {
+                std::this_thread::sleep_for(kMaxWait);
+                return false;
+            }
+            std::this_thread::sleep_until(due);
+        }
+
+        const size_t index = m_next++;
+        const int64_t timestampUs = record.timestampUs + m_loopOffset;
+        if (record.type == CaptureTrace::Cursor) {
+            // Several updates before one frame fold into one, keeping the newest shape
+            CursorUpdate update;
+            if (m_reader.readCursor(index, update)) {
+                if (update.shapeType == CursorUpdate::Unchanged && m_cursorPending) {
+                    m_cursor.x = update.x;
+                    m_cursor.y = update.y;
+                    m_cursor.visible = update.visible;
+                }
+                else {
+                    m_cursor = update;
+                }
+                m_cursorPending = true;
+            }
+            continue;
+        }
+        if (record.type == CaptureTrace::Audio) {
+            CaptureTraceReader::AudioPacket packet;
+            if (m_audioSink && m_reader.readAudio(index, packet)) {
+                m_audioSink(timestampUs, packet);
+            }
+            continue;
+        }
+        if (record.type != CaptureTrace::Frame) {
+            continue;
+        }
+
+        if (!m_reader.applyFrame(index, m_frame, m_damage)) {
+            m_error = "corrupt frame record " + std::to_string(index);
+            m_atEnd = true;
+            return false;
+        }
+        const FrameView view = m_frame.view();
+        m_changes.clear(view.width, view.height, FrameChangeDetector::kTileSize);
+        for (const SceneRect& rect : m_damage) {
+            m_changes.markRect(rect.x, rect.y, rect.width, rect.height);
+        }
+
+        frame.pixels = view;
+        frame.changes = &m_changes;
+        frame.timestampUs = timestampUs;
+        frame.cursor = m_cursorPending ? &m_cursor : nullptr;
+        m_cursorPending = false;
+        return true;
+    }
+}
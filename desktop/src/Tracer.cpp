@@ -0,0 +1,297 @@
+#include "incl/Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+    enum EventType
+    {
+        EventBegin,
+        EventEnd,
+        EventCounter
+    };
+
+    int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Plain copy of an event, taken while flushing
+    struct EventCopy
+    {
+        const char* name;
+        int64_t timeNs;
+        int64_t value;
+        int type;
+    };
+
+    void writeString(std::ofstream& file, const char* text)
+    {
+        file.put('"');
+        for (const char* c = text; *c; c++) {
+            if (*c == '"' || *c == '\\') {
+                file.put('\\');
+                file.put(*c);
+            }
+            else if (static_cast<unsigned char>(*c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+                file << escaped;
+            }
+            else {
+                file.put(*c);
+            }
+        }
+        file.put('"');
+    }
+}
+
+// Single-writer ring. The fields are relaxed atomics so the flushing thread can read a
+// slot while its owner overwrites it; the flush throws away any slot that may have
+// been reused during the copy, the same check a seqlock reader makes.
+struct TraceEvent
+{
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<int64_t> timeNs{ 0 };
+    std::atomic<int64_t> value{ 0 };
+    std::atomic<int> type{ 0 };
+};
+
+struct TraceBuffer
+{
+    int threadId = 0;
+    char threadName[64] = {}; // guarded by Tracer::m_mutex
+    std::unique_ptr<TraceEvent[]> events{ new TraceEvent[Tracer::kEventsPerThread] };
+    std::atomic<uint64_t> head{ 0 };  // events ever written
+    std::atomic<uint64_t> start{ 0 }; // first event after the last clear()
+};
+
+std::atomic<bool> Tracer::s_enabled{ false };
+
+namespace {
+    thread_local TraceBuffer* t_buffer = nullptr;
+    thread_local char t_threadName[64] = {}; // kept until the thread's first event
+    thread_local bool t_exited = false;      // ring already released, drop late events
+
+    // What writeJson needs from a ring, copied under the lock so the file is written
+    // without it
+    struct BufferCopy
+    {
+        const TraceBuffer* buffer;
+        int threadId;
+        char threadName[64];
+        uint64_t start;
+        uint64_t head;
+    };
+}
+
+// Built on a thread's first event; hands its ring back when the thread exits
+struct TraceThreadExit
+{
+    ~TraceThreadExit()
+    {
+        Tracer::instance().releaseThreadBuffer();
+    }
+};
+
+Tracer& Tracer::instance()
+{
+    static Tracer* tracer = new Tracer();
+    return *tracer;
+}
+
+Tracer::Tracer()
+    : m_epochNs(nowNs())
+{
+}
+
+void Tracer::setEnabled(bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+TraceBuffer* Tracer::threadBuffer()
+{
+    if (!t_buffer) {
+        if (t_exited) {
+            return nullptr;
+        }
+        thread_local TraceThreadExit exitHook;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        TraceBuffer* buffer = nullptr;
+        if (!m_free.empty()) {
+            buffer = m_free.front();
+            m_free.erase(m_free.begin());
+            // The last owner's events would show under this thread's id
+            buffer->start.store(buffer->head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        else {
+            lock.unlock();
+            auto fresh = std::make_unique<TraceBuffer>();
+            lock.lock();
+            buffer = fresh.get();
+            m_buffers.push_back(std::move(fresh));
+        }
+        buffer->threadId = m_nextThreadId++;
+        if (t_threadName[0]) {
+            std::snprintf(buffer->threadName, sizeof(buffer->threadName), "%s", t_threadName);
+        }
+        else {
+            std::snprintf(buffer->threadName, sizeof(buffer->threadName), "thread %d", buffer->threadId);
+        }
+        t_buffer = buffer;
+    }
+    return t_buffer;
+}
+
+void Tracer::releaseThreadBuffer()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free.push_back(t_buffer);
+    t_buffer = nullptr;
+    t_exited = true;
+}
+
+void Tracer::record(int type, const char* name, int64_t value)
+{
+    TraceBuffer* buffer = threadBuffer();
+    if (!buffer) {
+        return;
+    }
+    const uint64_t index = buffer->head.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[index & (kEventsPerThread - 1)];
+    event.name.store(name, std::memory_order_relaxed);
+    event.timeNs.store(nowNs() - m_epochNs, std::memory_order_relaxed);
+    event.value.store(value, std::memory_order_relaxed);
+    event.type.store(type, std::memory_order_relaxed);
+    buffer->head.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::begin(const char* name)
+{
+    record(EventBegin, name, 0);
+}
+
+void Tracer::end(const char* name)
+{
+    record(EventEnd, name, 0);
+}
+
+void Tracer::counter(const char* name, int64_t value)
+{
+    record(EventCounter, name, value);
+}
+
+void Tracer::setThreadName(const char* name)
+{
+    // Threads that never record shouldn't get a ring just for their name
+    std::snprintf(t_threadName, sizeof(t_threadName), "%s", name);
+    if (t_buffer) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::snprintf(t_buffer->threadName, sizeof(t_buffer->threadName), "%s", name);
+    }
+}
+
+void Tracer::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& buffer : m_buffers) {
+        buffer->start.store(buffer->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+bool Tracer::writeJson(const std::filesystem::path& path) const
+{
+    // Threads starting to record take the same lock, so hold it only for the copy
+    std::vector<BufferCopy> buffers;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        buffers.reserve(m_buffers.size());
+        for (const auto& buffer : m_buffers) {
+            BufferCopy copy;
+            copy.buffer = buffer.get();
+            copy.threadId = buffer->threadId;
+            std::memcpy(copy.threadName, buffer->threadName, sizeof(copy.threadName));
+            copy.start = buffer->start.load(std::memory_order_relaxed);
+            copy.head = buffer->head.load(std::memory_order_acquire);
+            buffers.push_back(copy);
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    auto separator = [&] {
+        if (!first) {
+            file << ",\n";
+        }
+        first = false;
+    };
+    char text[160];
+
+    std::vector<EventCopy> events;
+    events.reserve(kEventsPerThread);
+
+    for (const BufferCopy& copy : buffers) {
+        const TraceBuffer* buffer = copy.buffer;
+        separator();
+        std::snprintf(text, sizeof(text), "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", copy.threadId);
+        file << text;
+        writeString(file, copy.threadName);
+        file << "}}";
+
+        // Events recorded after the copy, by this owner or the ring's next one, are left out
+        const uint64_t head = copy.head;
+        const uint64_t oldest = std::max(copy.start,
+            head > static_cast<uint64_t>(kEventsPerThread) ? head - kEventsPerThread : 0);
+        events.clear();
+        for (uint64_t i = oldest; i < head; i++) {
+            const TraceEvent& event = buffer->events[i & (kEventsPerThread - 1)];
+            events.push_back(EventCopy{ event.name.load(std::memory_order_relaxed),
+                event.timeNs.load(std::memory_order_relaxed), event.value.load(std::memory_order_relaxed),
+                event.type.load(std::memory_order_relaxed) });
+        }
+
+        // Slots the owner reached again while we were copying hold newer events
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t headAfter = buffer->head.load(std::memory_order_relaxed);
+        const uint64_t overwritten = headAfter > static_cast<uint64_t>(kEventsPerThread) ? headAfter - kEventsPerThread : 0;
+        const size_t skip = overwritten > oldest ? static_cast<size_t>(std::min<uint64_t>(overwritten - oldest, events.size())) : 0;
+
+        // The ring may start inside a scope; drop ends whose begin was overwritten
+        int depth = 0;
+        for (size_t i = skip; i < events.size(); i++) {
+            const EventCopy& event = events[i];
+            if (!event.name) {
+                continue;
+            }
+            if (event.type == EventEnd && depth == 0) {
+                continue;
+            }
+            depth += event.type == EventBegin ? 1 : event.type == EventEnd ? -1 : 0;
+
+            separator();
+            std::snprintf(text, sizeof(text), "{\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"name\":",
+                event.type == EventBegin ? 'B' : event.type == EventEnd ? 'E' : 'C',
+                copy.threadId, event.timeNs / 1000.0);
+            file << text;
+            writeString(file, event.name);
+            if (event.type == EventCounter) {
+                std::snprintf(text, sizeof(text), ",\"args\":{\"value\":%lld}", static_cast<long long>(event.value));
+                file << text;
+            }
+            file.put('}');
+        }
+    }
+
+    file << "\n]}\n";
+    file.close();
+    return !file.fail();
+}
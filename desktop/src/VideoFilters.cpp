@@ -0,0 +1,137 @@
+#include "incl/VideoFilters.h"
+#include "incl/Simd.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    inline uint8_t clampByte(int32_t v)
+    {
+        return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+    }
+
+    inline uint32_t div255(uint32_t x)
+    {
+        x += 128;
+        return (x + (x >> 8)) >> 8;
+    }
+}
+
+ColorMatrix::ColorMatrix()
+{
+    const float identity[3][4] = {
+        { 1.0f, 0.0f, 0.0f, 0.0f },
+        { 0.0f, 1.0f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, 1.0f, 0.0f },
+    };
+    *this = ColorMatrix(identity);
+}
+
+ColorMatrix::ColorMatrix(const float matrix[3][4])
+{
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            m_coeff[r][c] = static_cast<int32_t>(std::lround(matrix[r][c] * (1 << kFracBits)));
+        }
+        // Offset carries the rounding term so apply() only needs a shift
+        m_coeff[r][3] = static_cast<int32_t>(std::lround(matrix[r][3] * (1 << kFracBits))) + (1 << (kFracBits - 1));
+    }
+}
+
+ColorMatrix ColorMatrix::fromAdjustments(float brightness, float contrast, float saturation)
+{
+    // Saturation mixes towards BT.709 luma, contrast pivots around mid grey
+    const float luma[3] = { 0.2126f, 0.7152f, 0.0722f };
+    float m[3][4];
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+            float sat = (1.0f - saturation) * luma[c] + (r == c ? saturation : 0.0f);
+            m[r][c] = contrast * sat;
+        }
+        m[r][3] = 128.0f * (1.0f - contrast) + brightness * 255.0f;
+    }
+    return ColorMatrix(m);
+}
+
+void ColorMatrix::apply(uint8_t* bgra, int count) const
+{
+    for (int i = 0; i < count; i++, bgra += 4) {
+        const int32_t b = bgra[0];
+        const int32_t g = bgra[1];
+        const int32_t r = bgra[2];
+        const int32_t outR = (m_coeff[0][0] * r + m_coeff[0][1] * g + m_coeff[0][2] * b + m_coeff[0][3]) >> kFracBits;
+        const int32_t outG = (m_coeff[1][0] * r + m_coeff[1][1] * g + m_coeff[1][2] * b + m_coeff[1][3]) >> kFracBits;
+        const int32_t outB = (m_coeff[2][0] * r + m_coeff[2][1] * g + m_coeff[2][2] * b + m_coeff[2][3]) >> kFracBits;
+        bgra[0] = clampByte(outB);
+        bgra[1] = clampByte(outG);
+        bgra[2] = clampByte(outR);
+    }
+}
+
+Lut1D::Lut1D()
+{
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < 256; i++) {
+            m_table[c][i] = static_cast<uint8_t>(i);
+        }
+    }
+}
+
+Lut1D Lut1D::gamma(float gamma)
+{
+    Lut1D lut;
+    const float exponent = gamma > 0.0f ? 1.0f / gamma : 1.0f;
+    for (int i = 0; i < 256; i++) {
+        const uint8_t v = static_cast<uint8_t>(std::lround(std::pow(i / 255.0f, exponent) * 255.0f));
+        lut.m_table[0][i] = v;
+        lut.m_table[1][i] = v;
+        lut.m_table[2][i] = v;
+    }
+    return lut;
+}
+
+void Lut1D::apply(uint8_t* bgra, int count) const
+{
+    for (int i = 0; i < count; i++, bgra += 4) {
+        bgra[0] = m_table[0][bgra[0]];
+        bgra[1] = m_table[1][bgra[1]];
+        bgra[2] = m_table[2][bgra[2]];
+    }
+}
+
+void ForceOpaque::apply(uint8_t* bgra, int count) const
+{
+    uint32_t* px = reinterpret_cast<uint32_t*>(bgra);
+    int i = 0;
+#ifdef OBS_HAVE_SSE2
+    if (useSse2()) {
+        const __m128i mask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+        for (; i + 4 <= count; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(px + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(px + i), _mm_or_si128(v, mask));
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        px[i] |= 0xFF000000u;
+    }
+}
+
+void Premultiply::apply(uint8_t* bgra, int count) const
+{
+    for (int i = 0; i < count; i++, bgra += 4) {
+        const uint32_t a = bgra[3];
+        if (a == 255) {
+            continue;
+        }
+        bgra[0] = static_cast<uint8_t>(div255(bgra[0] * a));
+        bgra[1] = static_cast<uint8_t>(div255(bgra[1] * a));
+        bgra[2] = static_cast<uint8_t>(div255(bgra[2] * a));
+    }
+}
+
+void SwapRedBlue::apply(uint8_t* bgra, int count) const
+{
+    for (int i = 0; i < count; i++, bgra += 4) {
+        std::swap(bgra[0], bgra[2]);
+    }
+}
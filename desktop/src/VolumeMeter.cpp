@@ -1,84 +1,226 @@
 #include "incl/VolumeMeter.h"
+#include "incl/Tracer.h"
 #include <QPainter>
+#include <QPaintEvent>
+#include <QCoreApplication>
 #include <QLinearGradient>
-#include <QFontMetrics>
+#include <QPixmapCache>
+#include <QPointer>
+#include <QTimer>
+#include <QVector>
+
+namespace {
+    constexpr float kMinDb = -60.0f;
+    constexpr float kMaxDb = 0.0f;
+
+    // One timer animates every meter, so dozens of sources cost one wakeup per frame.
+    // A child of the application, so the timer goes while QApplication is still there.
+    class MeterClock : public QObject
+    {
+    public:
+        // Null once the application is gone
+        static MeterClock* instance()
+        {
+            static QPointer<MeterClock> clock;
+            if (!clock && QCoreApplication::instance())
+                clock = new MeterClock(QCoreApplication::instance());
+            return clock;
+        }
+
+        void add(VolumeMeter* meter)
+        {
+            m_meters.append(meter);
+            if (!m_timer->isActive())
+                m_timer->start();
+        }
+
+        void remove(VolumeMeter* meter)
+        {
+            m_meters.removeOne(meter);
+            if (m_meters.isEmpty())
+                m_timer->stop();
+        }
+
+    private:
+        explicit MeterClock(QObject* parent) : QObject(parent), m_timer(new QTimer(this))
+        {
+            m_timer->setInterval(16); // ~60 FPS
+            QObject::connect(m_timer, &QTimer::timeout, this, [this] {
+                for (VolumeMeter* meter : m_meters)
+                    meter->tick();
+            });
+        }
+
+        QTimer* m_timer;
+        QVector<VolumeMeter*> m_meters;
+    };
+
+    // Gradient pixmaps per bar size, shared by all meters. Only looked up on resize.
+    QPixmap gradientPixmap(const QSize& size)
+    {
+        const QString key = QStringLiteral("VolumeMeter/%1x%2").arg(size.width()).arg(size.height());
+        QPixmap pixmap;
+        if (QPixmapCache::find(key, &pixmap))
+            return pixmap;
+
+        pixmap = QPixmap(size);
+        QPainter painter(&pixmap);
+        QLinearGradient gradient(0, 0, size.width(), 0);
+        gradient.setColorAt(0.0, Qt::green);
+        gradient.setColorAt(0.66, Qt::yellow);
+        gradient.setColorAt(1.0, Qt::red);
+        painter.fillRect(pixmap.rect(), gradient);
+        painter.end();
+
+        QPixmapCache::insert(key, pixmap);
+        return pixmap;
+    }
+}
 
 VolumeMeter::VolumeMeter(QWidget* parent, const QString& label)
     : QWidget(parent),
-    m_currentLevel(-60.0f),
-    m_targetLevel(-60.0f),
-    m_peakLevel(-60.0f),
+    m_currentLevel(kMinDb),
+    m_targetLevel(kMinDb),
+    m_inputPeak(kMinDb),
+    m_peakLevel(kMinDb),
+    m_momentary(kMinDb),
+    m_integrated(kMinDb),
     m_label(label)
 {
-    setMinimumHeight(30);
-    m_animationTimer.setInterval(16); // ~60 FPS
-    connect(&m_animationTimer, &QTimer::timeout, this, &VolumeMeter::updateAnimation);
-    m_animationTimer.start();
+    setMinimumHeight(40);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    MeterClock::instance()->add(this);
+}
+
+VolumeMeter::~VolumeMeter()
+{
+    if (MeterClock* clock = MeterClock::instance())
+        clock->remove(this);
 }
 
 void VolumeMeter::setLevel(float dbLevel)
 {
-    dbLevel = qBound(-60.0f, dbLevel, 0.0f);
-    m_targetLevel = dbLevel;
+    dbLevel = qBound(kMinDb, dbLevel, kMaxDb);
+    m_targetLevel.store(dbLevel, std::memory_order_relaxed);
 
-    if (dbLevel > m_peakLevel)
-        m_peakLevel = dbLevel;
+    // Keep the highest level until the GUI thread picks it up
+    float peak = m_inputPeak.load(std::memory_order_relaxed);
+    while (dbLevel > peak && !m_inputPeak.compare_exchange_weak(peak, dbLevel, std::memory_order_relaxed)) {
+    }
 }
 
-void VolumeMeter::updateAnimation()
+void VolumeMeter::setLoudness(float momentaryLufs, float integratedLufs)
 {
+    m_momentary.store(qBound(kMinDb, momentaryLufs, kMaxDb), std::memory_order_relaxed);
+    m_integrated.store(qBound(kMinDb, integratedLufs, kMaxDb), std::memory_order_relaxed);
+}
+
+void VolumeMeter::tick()
+{
+    const float target = m_targetLevel.load(std::memory_order_relaxed);
+    const float inputPeak = m_inputPeak.exchange(kMinDb, std::memory_order_relaxed);
+
     // Simple smoothing for animation
     const float smoothing = 0.2f;
-    m_currentLevel = m_currentLevel * (1.0f - smoothing) + m_targetLevel * smoothing;
+    m_currentLevel = m_currentLevel * (1.0f - smoothing) + target * smoothing;
 
     // Slowly decay peak
     m_peakLevel -= 0.5f;
+    if (inputPeak > m_peakLevel)
+        m_peakLevel = inputPeak;
     if (m_peakLevel < m_currentLevel)
         m_peakLevel = m_currentLevel;
 
-    update();
+    if (!isVisible() || m_barRect.isEmpty())
+        return;
+
+    const int integrated = qRound(m_integrated.load(std::memory_order_relaxed) * 10.0f);
+    if (integrated != m_paintedIntegrated)
+        update(m_loudnessRect);
+
+    // Repaint only the span between the old and new bar end / peak / loudness markers
+    const int levelX = levelToX(m_currentLevel);
+    const int peakX = levelToX(m_peakLevel);
+    const int momentaryX = levelToX(m_momentary.load(std::memory_order_relaxed));
+    if (levelX == m_paintedLevelX && peakX == m_paintedPeakX && momentaryX == m_paintedMomentaryX)
+        return;
+
+    int left = qMin(levelX, qMin(peakX, momentaryX));
+    int right = qMax(levelX, qMax(peakX, momentaryX));
+    if (m_paintedLevelX >= 0) {
+        left = qMin(left, qMin(m_paintedLevelX, qMin(m_paintedPeakX, m_paintedMomentaryX)));
+        right = qMax(right, qMax(m_paintedLevelX, qMax(m_paintedPeakX, m_paintedMomentaryX)));
+    }
+    update(QRect(left - 1, m_barRect.top(), right - left + 3, m_barRect.height()).intersected(m_barRect));
 }
 
-QLinearGradient VolumeMeter::createColorGradient() const
+int VolumeMeter::levelToX(float dbLevel) const
 {
-    QLinearGradient gradient(0, 0, width(), 0);
-    gradient.setColorAt(0.0, Qt::green);
-    gradient.setColorAt(0.66, Qt::yellow);
-    gradient.setColorAt(1.0, Qt::red);
-    return gradient;
+    float normalizedLevel = (dbLevel - kMinDb) / (kMaxDb - kMinDb);
+    // Clamped so the peak line at 0 dB stays inside the bar
+    return qMin(m_barRect.left() + static_cast<int>(m_barRect.width() * normalizedLevel), m_barRect.right());
 }
 
-void VolumeMeter::paintEvent(QPaintEvent*)
+void VolumeMeter::resizeEvent(QResizeEvent* event)
 {
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);
-
-    QRect barRect = rect().adjusted(100, 8, -10, -8); // leave space for label
-
-    // Draw background
-    painter.setBrush(Qt::black);
-    painter.setPen(Qt::NoPen);
-    painter.drawRect(barRect);
-
-    // Draw volume bar
-    float normalizedLevel = (m_currentLevel + 60.0f) / 60.0f;
-    int levelWidth = static_cast<int>(barRect.width() * normalizedLevel);
-
-    QRect levelRect = barRect;
-    levelRect.setWidth(levelWidth);
+    QWidget::resizeEvent(event);
+
+    m_barRect = rect().adjusted(100, 8, -10, -8); // leave space for label
+    m_loudnessRect = QRect(0, height() / 2 + 8, m_barRect.left() - 4, height() / 2 - 8);
+    m_gradient = m_barRect.isEmpty() ? QPixmap() : gradientPixmap(m_barRect.size());
+    m_paintedLevelX = -1;
+    m_paintedPeakX = -1;
+    m_paintedMomentaryX = -1;
+}
 
-    QBrush gradientBrush(createColorGradient());
-    painter.setBrush(gradientBrush);
-    painter.drawRect(levelRect);
+void VolumeMeter::paintEvent(QPaintEvent* event)
+{
+    TraceScope trace("meter paint");
+    QPainter painter(this);
+    const QRect dirty = event->rect();
+
+    // Widget background and labels, only when the area outside the bar is exposed
+    if (!m_barRect.contains(dirty)) {
+        painter.fillRect(rect(), palette().window());
+        painter.setPen(Qt::white);
+        painter.drawText(10, height() / 2, m_label);
+
+        // Integrated loudness (EBU R128)
+        m_paintedIntegrated = qRound(m_integrated.load(std::memory_order_relaxed) * 10.0f);
+        const QString loudness = m_paintedIntegrated <= qRound(kMinDb * 10.0f)
+            ? QStringLiteral("-- LUFS")
+            : QString::number(m_paintedIntegrated / 10.0, 'f', 1) + QStringLiteral(" LUFS");
+        painter.setPen(Qt::lightGray);
+        painter.drawText(m_loudnessRect.adjusted(10, 0, 0, 0), Qt::AlignLeft | Qt::AlignTop, loudness);
+    }
+
+    if (m_barRect.isEmpty())
+        return;
+
+    const int levelX = levelToX(m_currentLevel);
+    const int peakX = levelToX(m_peakLevel);
+
+    // Draw volume bar from the cached gradient, then the background behind it
+    const QRect levelRect = QRect(m_barRect.left(), m_barRect.top(), levelX - m_barRect.left(), m_barRect.height()).intersected(dirty);
+    if (!levelRect.isEmpty())
+        painter.drawPixmap(levelRect, m_gradient, levelRect.translated(-m_barRect.topLeft()));
+
+    const QRect backgroundRect = QRect(levelX, m_barRect.top(), m_barRect.right() - levelX + 1, m_barRect.height()).intersected(dirty);
+    if (!backgroundRect.isEmpty())
+        painter.fillRect(backgroundRect, Qt::black);
+
+    // Draw momentary loudness marker
+    const int momentaryX = levelToX(m_momentary.load(std::memory_order_relaxed));
+    if (momentaryX > m_barRect.left()) {
+        painter.setPen(Qt::cyan);
+        painter.drawLine(momentaryX, m_barRect.top(), momentaryX, m_barRect.top() + m_barRect.height() / 3);
+    }
 
     // Draw peak indicator
-    float peakNormalized = (m_peakLevel + 60.0f) / 60.0f;
-    int peakX = barRect.left() + static_cast<int>(barRect.width() * peakNormalized);
-
     painter.setPen(Qt::white);
-    painter.drawLine(peakX, barRect.top(), peakX, barRect.bottom());
+    painter.drawLine(peakX, m_barRect.top(), peakX, m_barRect.bottom());
 
-    // Draw label
-    painter.setPen(Qt::white);
-    painter.drawText(10, height() / 2 + 6, m_label);
+    m_paintedLevelX = levelX;
+    m_paintedPeakX = peakX;
+    m_paintedMomentaryX = momentaryX;
 }
@@ -0,0 +1,231 @@
+#include "incl/X11Capture.h"
+#include "incl/ThreadPool.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#ifdef OBS_HAVE_XFIXES
+#include <X11/extensions/Xfixes.h>
+#endif
+
+struct X11Capture::State
+{
+    Display* display = nullptr;
+    Window root = 0;
+    int width = 0;
+    int height = 0;
+    XImage* image = nullptr;
+    XShmSegmentInfo shm = {};
+    bool attached = false;
+    bool hasXfixes = false;
+};
+
+X11Capture::X11Capture(const std::string& display)
+    : m_displayName(display)
+{
+}
+
+X11Capture::~X11Capture()
+{
+    cleanup();
+}
+
+bool X11Capture::initialize()
+{
+    cleanup();
+    m_state = std::make_unique<State>();
+    State& s = *m_state;
+
+    s.display = XOpenDisplay(m_displayName.empty() ? nullptr : m_displayName.c_str());
+    if (!s.display) {
+        const char* name = m_displayName.empty() ? std::getenv("DISPLAY") : m_displayName.c_str();
+        m_error = std::string("cannot open X display ") + (name ? name : "(DISPLAY not set)");
+        cleanup();
+        return false;
+    }
+    if (!XShmQueryExtension(s.display)) {
+        m_error = "X server has no MIT-SHM extension";
+        cleanup();
+        return false;
+    }
+
+    const int screen = DefaultScreen(s.display);
+    s.root = RootWindow(s.display, screen);
+    XWindowAttributes attributes;
+    XGetWindowAttributes(s.display, s.root, &attributes);
+    s.width = attributes.width;
+    s.height = attributes.height;
+
+    s.image = XShmCreateImage(s.display, DefaultVisual(s.display, screen), DefaultDepth(s.display, screen),
+        ZPixmap, nullptr, &s.shm, s.width, s.height);
+    if (!s.image || s.image->bits_per_pixel != 32) {
+        m_error = "only 24/32-bit displays are supported";
+        cleanup();
+        return false;
+    }
+
+    s.shm.shmid = shmget(IPC_PRIVATE, static_cast<size_t>(s.image->bytes_per_line) * s.image->height, IPC_CREAT | 0600);
+    if (s.shm.shmid < 0) {
+        m_error = "shmget failed";
+        cleanup();
+        return false;
+    }
+    s.shm.shmaddr = s.image->data = static_cast<char*>(shmat(s.shm.shmid, nullptr, 0));
+    s.shm.readOnly = False;
+    if (s.shm.shmaddr == reinterpret_cast<char*>(-1)) {
+        s.shm.shmaddr = s.image->data = nullptr;
+        m_error = "shmat failed";
+        cleanup();
+        return false;
+    }
+    s.attached = XShmAttach(s.display, &s.shm) != 0;
+    XSync(s.display, False);
+
+    // Mark the segment for removal now; it goes away once both sides detach, even on a crash
+    shmctl(s.shm.shmid, IPC_RMID, nullptr);
+    if (!s.attached) {
+        m_error = "XShmAttach failed";
+        cleanup();
+        return false;
+    }
+
+#ifdef OBS_HAVE_XFIXES
+    int eventBase = 0;
+    int errorBase = 0;
+    s.hasXfixes = XFixesQueryExtension(s.display, &eventBase, &errorBase) != 0;
+#endif
+
+    m_changeDetector.reset();
+    return true;
+}
+
+void X11Capture::cleanup()
+{
+    if (!m_state) {
+        return;
+    }
+
+    State& s = *m_state;
+    if (s.attached) {
+        XShmDetach(s.display, &s.shm);
+    }
+    if (s.image) {
+        s.image->data = nullptr; // ours, not Xlib's to free
+        XDestroyImage(s.image);
+    }
+    if (s.shm.shmaddr) {
+        shmdt(s.shm.shmaddr);
+    }
+    if (s.display) {
+        XCloseDisplay(s.display);
+    }
+    m_state.reset();
+}
+
+bool X11Capture::acquireFrame(SourceFrame& frame)
+{
+    if (!m_state) {
+        return false;
+    }
+
+    TraceScope trace("capture");
+    State& s = *m_state;
+    bool grabbed;
+    {
+        TraceScope grabTrace("XShmGetImage");
+        grabbed = XShmGetImage(s.display, s.root, s.image, 0, 0, AllPlanes);
+    }
+    if (!grabbed) {
+        m_error = "XShmGetImage failed";
+        return false;
+    }
+
+    FrameView view(reinterpret_cast<uint8_t*>(s.image->data), s.width, s.height, s.image->bytes_per_line);
+    const bool cursorChanged = drawCursor(view);
+
+    frame.pixels = view;
+    frame.cursor = cursorChanged ? &m_cursor : nullptr;
+    frame.changes = &m_changeDetector.detect(view, &ThreadPool::instance());
+    frame.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    return true;
+}
+
+bool X11Capture::drawCursor(const FrameView& frame)
+{
+#ifdef OBS_HAVE_XFIXES
+    TraceScope trace("cursor");
+    if (!m_state->hasXfixes) {
+        return false;
+    }
+    XFixesCursorImage* cursor = XFixesGetCursorImage(m_state->display);
+    if (!cursor) {
+        return false;
+    }
+
+    // Premultiplied ARGB, one pixel per unsigned long
+    const int x0 = cursor->x - cursor->xhot;
+    const int y0 = cursor->y - cursor->yhot;
+    const int firstCol = std::max(0, -x0);
+    const int firstRow = std::max(0, -y0);
+    const int lastCol = std::min<int>(cursor->width, frame.width - x0);
+    const int lastRow = std::min<int>(cursor->height, frame.height - y0);
+
+    for (int row = firstRow; row < lastRow; row++) {
+        uint32_t* dst = reinterpret_cast<uint32_t*>(frame.row(y0 + row)) + x0;
+        const unsigned long* src = cursor->pixels + static_cast<size_t>(row) * cursor->width;
+        for (int col = firstCol; col < lastCol; col++) {
+            const uint32_t pixel = static_cast<uint32_t>(src[col]);
+            const uint32_t alpha = pixel >> 24;
+            if (alpha == 0) {
+                continue;
+            }
+            uint32_t out = dst[col] & 0xFF000000;
+            for (int shift = 0; shift < 24; shift += 8) {
+                const uint32_t d = (dst[col] >> shift) & 0xFF;
+                const uint32_t blended = ((pixel >> shift) & 0xFF) + (d * (255 - alpha) + 127) / 255;
+                out |= std::min<uint32_t>(blended, 255) << shift;
+            }
+            dst[col] = out;
+        }
+    }
+
+    // Report moves, and the shape when the server's serial says it changed
+    const bool shapeChanged = cursor->cursor_serial != m_cursorSerial || m_cursorShape.empty();
+    const bool changed = shapeChanged || x0 != m_cursor.x || y0 != m_cursor.y || !m_cursor.visible;
+    m_cursor.x = x0;
+    m_cursor.y = y0;
+    m_cursor.visible = true;
+    m_cursor.shapeType = CursorUpdate::Unchanged;
+    if (shapeChanged) {
+        m_cursorSerial = cursor->cursor_serial;
+        m_cursorShape.resize(static_cast<size_t>(cursor->width) * cursor->height);
+        for (size_t i = 0; i < m_cursorShape.size(); i++) {
+            const uint32_t pixel = static_cast<uint32_t>(cursor->pixels[i]);
+            const uint32_t alpha = pixel >> 24;
+            uint32_t straight = pixel & 0xFF000000;
+            for (int shift = 0; alpha && shift < 24; shift += 8) {
+                straight |= std::min<uint32_t>((((pixel >> shift) & 0xFF) * 255 + alpha / 2) / alpha, 255) << shift;
+            }
+            m_cursorShape[i] = straight;
+        }
+        m_cursor.shapeType = CursorUpdate::Color;
+        m_cursor.width = cursor->width;
+        m_cursor.height = cursor->height;
+        m_cursor.pitch = cursor->width * 4;
+        m_cursor.hotX = cursor->xhot;
+        m_cursor.hotY = cursor->yhot;
+        m_cursor.shape = reinterpret_cast<const uint8_t*>(m_cursorShape.data());
+    }
+    XFree(cursor);
+    return changed;
+#else
+    (void)frame;
+    return false;
+#endif
+}
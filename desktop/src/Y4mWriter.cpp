@@ -0,0 +1,109 @@
+#include "incl/Y4mWriter.h"
+#include "incl/ThreadPool.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+#include <string>
+
+namespace {
+    // BT.709 limited range in 8.8 fixed point, BGRA byte order
+    inline uint8_t lumaOf(const uint8_t* p)
+    {
+        return static_cast<uint8_t>((47 * p[2] + 157 * p[1] + 16 * p[0] + 128 + (16 << 8)) >> 8);
+    }
+
+    int chromaWidth(int width) { return (width + 1) / 2; }
+    int chromaHeight(int height) { return (height + 1) / 2; }
+}
+
+bool Y4mWriter::open(const std::filesystem::path& path, int width, int height, int fps)
+{
+    close();
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    const size_t lumaSize = static_cast<size_t>(width) * height;
+    const size_t chromaSize = static_cast<size_t>(chromaWidth(width)) * chromaHeight(height);
+    m_planes = BufferPool::instance().acquire(lumaSize + chromaSize * 2);
+    if (!m_planes) {
+        m_file.close();
+        return false;
+    }
+
+    const std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) +
+        " F" + std::to_string(std::max(fps, 1)) + ":1 Ip A1:1 C420jpeg XYSCSS=420JPEG\n";
+    m_file.write(header.data(), header.size());
+    return static_cast<bool>(m_file);
+}
+
+void Y4mWriter::close()
+{
+    if (m_file.is_open()) {
+        m_file.close();
+    }
+    m_planes.reset();
+}
+
+bool Y4mWriter::write(const FrameView& frame, ThreadPool* pool)
+{
+    TraceScope trace("y4m write");
+    if (!isOpen() || frame.width != m_width || frame.height != m_height) {
+        return false;
+    }
+
+    const int cw = chromaWidth(m_width);
+    const int ch = chromaHeight(m_height);
+    uint8_t* yPlane = m_planes.data();
+    uint8_t* uPlane = yPlane + static_cast<size_t>(m_width) * m_height;
+    uint8_t* vPlane = uPlane + static_cast<size_t>(cw) * ch;
+
+    // One chroma row (two luma rows) per step
+    auto convertRows = [&](int begin, int end) {
+        for (int cy = begin; cy < end; cy++) {
+            const int y0 = cy * 2;
+            const int y1 = std::min(y0 + 1, m_height - 1);
+            const uint8_t* row0 = frame.row(y0);
+            const uint8_t* row1 = frame.row(y1);
+
+            for (int x = 0; x < m_width; x++) {
+                yPlane[static_cast<size_t>(y0) * m_width + x] = lumaOf(row0 + x * 4);
+                if (y1 != y0) {
+                    yPlane[static_cast<size_t>(y1) * m_width + x] = lumaOf(row1 + x * 4);
+                }
+            }
+
+            for (int cx = 0; cx < cw; cx++) {
+                const int x0 = cx * 2;
+                const int x1 = std::min(x0 + 1, m_width - 1);
+                int b = 0, g = 0, r = 0;
+                for (const uint8_t* p : { row0 + x0 * 4, row0 + x1 * 4, row1 + x0 * 4, row1 + x1 * 4 }) {
+                    b += p[0];
+                    g += p[1];
+                    r += p[2];
+                }
+                // Sums of four samples, so the shift is 8 + 2
+                uPlane[static_cast<size_t>(cy) * cw + cx] = static_cast<uint8_t>((-26 * r - 87 * g + 112 * b + (512 << 8) + 512) >> 10);
+                vPlane[static_cast<size_t>(cy) * cw + cx] = static_cast<uint8_t>((112 * r - 102 * g - 10 * b + (512 << 8) + 512) >> 10);
+            }
+        }
+    };
+
+    if (pool) {
+        pool->parallelFor(ch, convertRows, 8);
+    }
+    else {
+        convertRows(0, ch);
+    }
+
+    static const char frameHeader[] = "FRAME\n";
+    m_file.write(frameHeader, sizeof(frameHeader) - 1);
+    m_file.write(reinterpret_cast<const char*>(yPlane), static_cast<std::streamsize>(uPlane - yPlane) + static_cast<std::streamsize>(cw) * ch * 2);
+    return static_cast<bool>(m_file);
+}
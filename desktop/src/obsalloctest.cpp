@@ -0,0 +1,186 @@
+// Steady-state allocation check for the GUI frame path: SyntheticSource frames go
+// through the same steps as MainWindow's tick — the capture layer of a SceneCompositor
+// marked dirty per changed tile, compose() on the shared ThreadPool, then the preview
+// FilterChain into a reused FrameBuffer — counting operator new calls and BufferPool
+// misses per frame. The first pass through the workload script warms everything up;
+// after that every frame must come out of pooled and reused buffers. Built with its
+// own copy of AllocationCounter.cpp and OBS_COUNT_ALLOCATIONS, so counting is always
+// on. Exits non-zero when a frame after warm-up allocates or counting isn't live.
+
+#include "incl/AllocationCounter.h"
+#include "incl/BufferPool.h"
+#include "incl/FilterChain.h"
+#include "incl/SceneCompositor.h"
+#include "incl/SyntheticSource.h"
+#include "incl/ThreadPool.h"
+#include "incl/VideoFilters.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+    struct Options
+    {
+        int width = 1280;
+        int height = 720;
+        int frames = 600;
+        std::string script = "typing:60,drag:60,scroll:60,noise:30,cursor:60,idle:30";
+    };
+
+    const char* const kUsage =
+        "usage: obs-alloc-test [options]\n"
+        "  --size WxH      synthetic desktop size (default: 1280x720)\n"
+        "  --frames N      frames checked after the warm-up pass (default: 600)\n"
+        "  --script S      SyntheticSource workloads, e.g. typing:60,drag:60\n"
+        "                  (default: typing:60,drag:60,scroll:60,noise:30,cursor:60,idle:30)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--size") {
+                if (std::sscanf(value.c_str(), "%dx%d", &options.width, &options.height) != 2) {
+                    return false;
+                }
+            }
+            else if (arg == "--frames") {
+                options.frames = std::atoi(value.c_str());
+            }
+            else if (arg == "--script") {
+                options.script = value;
+            }
+            else {
+                return false;
+            }
+        }
+        return options.width > 0 && options.height > 0 && options.frames > 0;
+    }
+
+    uint64_t allocationsSoFar()
+    {
+        return AllocationCounter::count() + BufferPool::instance().stats().misses;
+    }
+
+    // MainWindow's per-frame work from an acquired frame to the preview buffer
+    class FramePath
+    {
+    public:
+        FramePath(int previewWidth, int previewHeight) : m_preview(previewWidth, previewHeight) {}
+
+        void process(const SourceFrame& frame)
+        {
+            const FrameView& pixels = frame.pixels;
+            SceneLayer layer;
+            layer.source = pixels;
+            layer.opaque = true;
+            layer.dest = SceneRect{ 0, 0, pixels.width, pixels.height };
+
+            m_scene.setCanvasSize(pixels.width, pixels.height);
+            if (m_captureLayerId == 0) {
+                m_captureLayerId = m_scene.addLayer(layer);
+            }
+            else {
+                m_scene.setLayer(m_captureLayerId, layer);
+                if (!frame.changes) {
+                    m_scene.markContentChanged(m_captureLayerId);
+                }
+                else {
+                    const ChangeMap& changes = *frame.changes;
+                    for (int ty = 0; ty < changes.tilesY; ty++) {
+                        if (!changes.rowChanged[ty]) {
+                            continue;
+                        }
+                        for (int tx = 0; tx < changes.tilesX; tx++) {
+                            if (changes.isChanged(tx, ty)) {
+                                m_scene.markContentChanged(m_captureLayerId, SceneRect{
+                                    tx * changes.tileSize, ty * changes.tileSize, changes.tileSize, changes.tileSize });
+                            }
+                        }
+                    }
+                }
+            }
+            m_scene.compose(&ThreadPool::instance());
+            m_previewChain.process(m_scene.canvas(), m_preview.view(), &ThreadPool::instance());
+        }
+
+    private:
+        SceneCompositor m_scene;
+        int m_captureLayerId = 0;
+        FilterChain<ForceOpaque> m_previewChain{ ForceOpaque() };
+        FrameBuffer m_preview;
+    };
+
+    // A test that can't see allocations passes whatever the frame path does. Calls
+    // operator new directly, which unlike a new-expression may not be elided.
+    bool countingIsLive()
+    {
+        const uint64_t before = AllocationCounter::count();
+        void* probe = ::operator new(16);
+        const uint64_t after = AllocationCounter::count();
+        ::operator delete(probe);
+        return AllocationCounter::enabled() && after > before;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    SyntheticSource::Settings settings;
+    settings.width = options.width;
+    settings.height = options.height;
+    std::string error;
+    if (!SyntheticSource::parseScript(options.script, settings.script, error)) {
+        std::fprintf(stderr, "%s\n\n%s", error.c_str(), kUsage);
+        return 2;
+    }
+    if (!countingIsLive()) {
+        std::puts("FAIL: operator new is not being counted");
+        return 1;
+    }
+
+    int warmupFrames = 0;
+    for (const SyntheticSource::Step& step : settings.script) {
+        warmupFrames += step.frames > 0 ? step.frames : 1;
+    }
+
+    SyntheticSource source(settings);
+    if (!source.initialize()) {
+        std::puts("FAIL: SyntheticSource did not initialize");
+        return 1;
+    }
+    FramePath path(options.width / 2, options.height / 2);
+    SourceFrame frame;
+
+    int allocatingFrames = 0;
+    uint64_t total = 0;
+    for (int i = 0; i < warmupFrames + options.frames; i++) {
+        const uint64_t before = allocationsSoFar();
+        if (!source.acquireFrame(frame)) {
+            std::printf("FAIL: frame %d: SyntheticSource returned no frame\n", i);
+            return 1;
+        }
+        path.process(frame);
+        const uint64_t allocations = allocationsSoFar() - before;
+        if (i < warmupFrames || allocations == 0) {
+            continue;
+        }
+        if (allocatingFrames++ < 10) {
+            std::printf("FAIL: frame %d (%s) made %llu heap allocations after warm-up\n", i,
+                SyntheticSource::workloadName(source.workload()), static_cast<unsigned long long>(allocations));
+        }
+        total += allocations;
+    }
+
+    std::printf("%d frames at %dx%d after a %d-frame warm-up: %d allocated, %llu allocations\n", options.frames,
+        options.width, options.height, warmupFrames, allocatingFrames, static_cast<unsigned long long>(total));
+    return allocatingFrames == 0 ? 0 : 1;
+}
@@ -0,0 +1,323 @@
+// Audio filter chain behaviour and cost. Checks, on stereo 48 kHz audio in 10 ms
+// blocks: the limiter keeps noise with +12 dBFS bursts at or under its ceiling, also
+// after the ceiling is lowered mid-stream; a peak EQ band at its centre frequency
+// gives the gain it was set to; the gate shuts out noise under its close threshold
+// and passes a tone over its open threshold untouched; the compressor brings a
+// steady tone over its threshold down by the ratio. Then times the full chain (gate,
+// 4-band EQ, compressor, limiter) over many instances and reports how many fit on
+// one core in real time. Exits non-zero when a check fails.
+
+#include "incl/AudioFilterChain.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr double kPi = 3.14159265358979323846;
+    constexpr int kSampleRate = 48000;
+    constexpr int kChannels = 2;
+    constexpr int kBlockFrames = 480; // 10 ms
+
+    constexpr double kEqToleranceDb = 0.1;
+    constexpr double kCompressorToleranceDb = 0.1;
+    constexpr double kGateClosedDb = -90.0;
+
+    struct Options
+    {
+        int instances = 64;
+        double seconds = 2.0;
+    };
+
+    const char* const kUsage =
+        "usage: obs-audiofilter-bench [options]\n"
+        "  --instances N   chains timed side by side (default: 64)\n"
+        "  --seconds S     audio each timed chain processes (default: 2)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const char* value = argv[++i];
+            if (arg == "--instances") {
+                options.instances = std::atoi(value);
+            }
+            else if (arg == "--seconds") {
+                options.seconds = std::atof(value);
+            }
+            else {
+                return false;
+            }
+        }
+        return options.instances > 0 && options.seconds > 0.0;
+    }
+
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed) : m_state(seed ? seed : 1) {}
+
+        // Uniform in [-1, 1)
+        float next()
+        {
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 17;
+            m_state ^= m_state << 5;
+            return static_cast<float>(static_cast<int32_t>(m_state)) / 2147483648.0f;
+        }
+
+    private:
+        uint32_t m_state;
+    };
+
+    double toDb(double gain)
+    {
+        return 20.0 * std::log10(std::max(gain, 1e-12));
+    }
+
+    // Runs `seconds` of audio through the chain. generate(block, start, frames, random)
+    // fills interleaved stereo from frame `start` on; measure(block, start, frames) sees
+    // the output.
+    template <typename Generate, typename Measure>
+    void run(AudioFilterChain& chain, Generate generate, double seconds, Measure measure)
+    {
+        Random random(12345);
+        std::vector<float> block(static_cast<size_t>(kBlockFrames) * kChannels);
+        const long long total = static_cast<long long>(seconds * kSampleRate);
+        for (long long start = 0; start < total; start += kBlockFrames) {
+            generate(block.data(), start, kBlockFrames, random);
+            chain.process(block.data(), kBlockFrames);
+            measure(block.data(), start, kBlockFrames);
+        }
+    }
+
+    double peakOf(const float* block, int frames)
+    {
+        double peak = 0.0;
+        for (int i = 0; i < frames * kChannels; i++) {
+            peak = std::max(peak, static_cast<double>(std::fabs(block[i])));
+        }
+        return peak;
+    }
+
+    void fillSine(float* block, long long start, int frames, double frequency, double amplitude)
+    {
+        for (int i = 0; i < frames; i++) {
+            const float value = static_cast<float>(amplitude * std::sin(2.0 * kPi * frequency * (start + i) / kSampleRate));
+            block[i * kChannels] = value;
+            block[i * kChannels + 1] = value;
+        }
+    }
+
+    // -20 dBFS noise with a +12 dBFS burst of 5 ms every 100 ms
+    void burstyNoise(float* block, long long start, int frames, Random& random)
+    {
+        for (int i = 0; i < frames; i++) {
+            const bool burst = (start + i) % (kSampleRate / 10) < kSampleRate / 200;
+            const float scale = burst ? 4.0f : 0.1f;
+            block[i * kChannels] = random.next() * scale;
+            block[i * kChannels + 1] = random.next() * scale;
+        }
+    }
+
+    bool checkLimiter()
+    {
+        AudioFilterChain chain;
+        Limiter* limiter = chain.addFilter(std::make_unique<Limiter>());
+        limiter->setCeiling(-1.0f);
+        chain.configure(kSampleRate, kChannels, kBlockFrames);
+
+        // The ceiling glides for a few tens of ms after a change; judge it once settled
+        double ceiling = std::pow(10.0, -1.0 / 20.0);
+        double worst = 0.0;
+        long long settledFrom = 0;
+        run(chain, burstyNoise, 4.0, [&](const float* block, long long start, int frames) {
+            if (start == 2 * kSampleRate) {
+                limiter->setCeiling(-6.0f);
+                ceiling = std::pow(10.0, -6.0 / 20.0);
+                settledFrom = start + kSampleRate / 5;
+            }
+            if (start >= settledFrom) {
+                worst = std::max(worst, peakOf(block, frames) / ceiling);
+            }
+        });
+        const bool ok = worst <= 1.0 + 1e-6;
+        std::printf("limiter: peak %+.4f dB against the ceiling%s\n", toDb(worst), ok ? "" : "  FAIL");
+        if (!ok) {
+            std::printf("FAIL: limiter output went %.4f dB over its ceiling\n", toDb(worst));
+        }
+        return ok;
+    }
+
+    // Output over input level of a sine at the band's centre, once the band has settled
+    bool checkEq(float frequency, float gainDb, float q)
+    {
+        AudioFilterChain chain;
+        ParametricEq* eq = chain.addFilter(std::make_unique<ParametricEq>());
+        eq->setBand(0, ParametricEq::BandType::Peak, frequency, gainDb, q);
+        eq->setBandEnabled(0, true);
+        chain.configure(kSampleRate, kChannels, kBlockFrames);
+
+        double sumSquares = 0.0;
+        long long counted = 0;
+        run(chain, [frequency](float* block, long long start, int frames, Random&) { fillSine(block, start, frames, frequency, 0.25); },
+            2.0, [&](const float* block, long long start, int frames) {
+                if (start < kSampleRate) {
+                    return;
+                }
+                for (int i = 0; i < frames * kChannels; i++) {
+                    sumSquares += static_cast<double>(block[i]) * block[i];
+                }
+                counted += frames * kChannels;
+            });
+        const double measured = toDb(std::sqrt(sumSquares / counted) / (0.25 / std::sqrt(2.0)));
+        const bool ok = std::fabs(measured - gainDb) <= kEqToleranceDb;
+        std::printf("eq: %6.0f Hz band set to %+5.1f dB, Q %.2f: %+6.2f dB%s\n", frequency, gainDb, q, measured, ok ? "" : "  FAIL");
+        if (!ok) {
+            std::printf("FAIL: EQ band at %.0f Hz gives %+.2f dB, set to %+.1f dB\n", frequency, measured, gainDb);
+        }
+        return ok;
+    }
+
+    // Noise at -50 dBFS, under the -32 dB close threshold, for two seconds, then a
+    // -10 dBFS tone for two
+    bool checkGate()
+    {
+        AudioFilterChain chain;
+        chain.addFilter(std::make_unique<NoiseGate>());
+        chain.configure(kSampleRate, kChannels, kBlockFrames);
+
+        double noisePeak = 0.0;
+        double tonePeak = 0.0;
+        run(chain, [](float* block, long long start, int frames, Random& random) {
+            if (start < 2 * kSampleRate) {
+                for (int i = 0; i < frames * kChannels; i++) {
+                    block[i] = random.next() * 0.00316f;
+                }
+            }
+            else {
+                fillSine(block, start, frames, 440.0, 0.316);
+            }
+        }, 4.0, [&](const float* block, long long start, int frames) {
+            if (start >= kSampleRate && start < 2 * kSampleRate) {
+                noisePeak = std::max(noisePeak, peakOf(block, frames));
+            }
+            else if (start >= 3 * kSampleRate) {
+                tonePeak = std::max(tonePeak, peakOf(block, frames));
+            }
+        });
+        const double toneDb = toDb(tonePeak / 0.316);
+        const bool ok = toDb(noisePeak) <= kGateClosedDb && std::fabs(toneDb) <= kEqToleranceDb;
+        std::printf("gate: noise under the threshold comes out at %.1f dBFS, a tone over it at %+.2f dB%s\n", toDb(noisePeak),
+            toneDb, ok ? "" : "  FAIL");
+        if (!ok) {
+            std::puts("FAIL: the gate let noise through or changed a tone above its threshold");
+        }
+        return ok;
+    }
+
+    // A tone peaking 12 dB over a -18 dB threshold at 4:1 and no knee comes out at -15
+    // dBFS. Instant attack and a long release hold the envelope on the sine's peaks.
+    bool checkCompressor()
+    {
+        AudioFilterChain chain;
+        Compressor* compressor = chain.addFilter(std::make_unique<Compressor>());
+        compressor->setThreshold(-18.0f);
+        compressor->setRatio(4.0f);
+        compressor->setKnee(0.0f);
+        compressor->setMakeupGain(0.0f);
+        compressor->setAttack(0.0f);
+        compressor->setRelease(1000.0f);
+        chain.configure(kSampleRate, kChannels, kBlockFrames);
+
+        double peak = 0.0;
+        run(chain, [](float* block, long long start, int frames, Random&) { fillSine(block, start, frames, 1000.0, 0.5); },
+            2.0, [&](const float* block, long long start, int frames) {
+                if (start >= kSampleRate) {
+                    peak = std::max(peak, peakOf(block, frames));
+                }
+            });
+        const double expected = -18.0 + (toDb(0.5) + 18.0) / 4.0;
+        const bool ok = std::fabs(toDb(peak) - expected) <= kCompressorToleranceDb;
+        std::printf("compressor: %.1f dBFS tone at 4:1 over -18 dB peaks at %.2f dBFS (expected %.2f)%s\n", toDb(0.5),
+            toDb(peak), expected, ok ? "" : "  FAIL");
+        if (!ok) {
+            std::puts("FAIL: compressor output level does not follow its ratio");
+        }
+        return ok;
+    }
+
+    // The mic chain with every filter on and a 4-band EQ
+    std::unique_ptr<AudioFilterChain> fullChain()
+    {
+        auto chain = std::make_unique<AudioFilterChain>();
+        NoiseGate* gate = chain->addFilter(std::make_unique<NoiseGate>());
+        gate->setOpenThreshold(-40.0f);
+        gate->setCloseThreshold(-46.0f);
+        ParametricEq* eq = chain->addFilter(std::make_unique<ParametricEq>());
+        eq->setBand(0, ParametricEq::BandType::HighPass, 80.0f, 0.0f, 0.707f);
+        eq->setBand(1, ParametricEq::BandType::Peak, 300.0f, -3.0f, 1.0f);
+        eq->setBand(2, ParametricEq::BandType::Peak, 3000.0f, 2.0f, 1.5f);
+        eq->setBand(3, ParametricEq::BandType::HighShelf, 10000.0f, 3.0f, 0.707f);
+        for (int band = 0; band < 4; band++) {
+            eq->setBandEnabled(band, true);
+        }
+        chain->addFilter(std::make_unique<Compressor>());
+        chain->addFilter(std::make_unique<Limiter>());
+        chain->configure(kSampleRate, kChannels, kBlockFrames);
+        return chain;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    bool ok = checkLimiter();
+    for (float frequency : { 100.0f, 1000.0f, 8000.0f }) {
+        for (float gainDb : { -12.0f, 6.0f, 12.0f }) {
+            ok = checkEq(frequency, gainDb, 1.0f) && ok;
+        }
+    }
+    ok = checkGate() && ok;
+    ok = checkCompressor() && ok;
+
+    // Every instance has its own buffers and state, as every source has in the app
+    std::vector<std::unique_ptr<AudioFilterChain>> chains;
+    for (int i = 0; i < options.instances; i++) {
+        chains.push_back(fullChain());
+    }
+    std::vector<float> input(static_cast<size_t>(kBlockFrames) * kChannels);
+    Random random(99);
+    for (float& sample : input) {
+        sample = random.next() * 0.3f;
+    }
+    std::vector<float> block(input.size());
+    const int blocks = std::max(1, static_cast<int>(options.seconds * kSampleRate / kBlockFrames));
+    const Clock::time_point start = Clock::now();
+    for (int b = 0; b < blocks; b++) {
+        for (auto& chain : chains) {
+            block = input;
+            chain->process(block.data(), kBlockFrames);
+        }
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const double perBlockUs = seconds * 1e6 / (static_cast<double>(blocks) * options.instances);
+    std::printf("\nfull chain (gate, 4-band EQ, compressor, limiter), stereo %d Hz, %d-frame blocks:\n", kSampleRate, kBlockFrames);
+    std::printf("%.1f us per block per instance, %.0f instances per core in real time\n", perBlockUs,
+        kBlockFrames * 1e6 / kSampleRate / perBlockUs);
+    return ok ? 0 : 1;
+}
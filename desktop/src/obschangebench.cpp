@@ -0,0 +1,233 @@
+// Change detection benchmark: runs FrameChangeDetector over scripted synthetic
+// desktop workloads (idle, typing, window drag, scrolling, full-frame video noise,
+// cursor motion) and reports how much of each frame changed, how long hashing took,
+// and what skipping unchanged strips saves a downstream ScalerPyramid. The ground
+// truth is a byte comparison of every tile against the previous frame. Exits non-zero
+// when the detector misses a changed tile or flags an unchanged one, or when the
+// skipping pyramid's output differs from one that rescaled every frame in full.
+
+#include "incl/FrameChangeDetector.h"
+#include "incl/ScalerPyramid.h"
+#include "incl/SyntheticSource.h"
+#include "incl/ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        int width = 1920;
+        int height = 1080;
+        int frames = 120;
+        int threads = 0;
+        std::vector<std::string> workloads{ "idle", "typing", "drag", "scroll", "noise", "cursor" };
+    };
+
+    const char* const kUsage =
+        "usage: obs-change-bench [options]\n"
+        "  --size WxH       frame size (default: 1920x1080)\n"
+        "  --frames N       frames per workload (default: 120)\n"
+        "  --threads N      pool threads (default: one per core)\n"
+        "  --workloads ..   comma separated (default: idle,typing,drag,scroll,noise,cursor)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--size") {
+                if (std::sscanf(value.c_str(), "%dx%d", &options.width, &options.height) != 2 ||
+                    options.width <= 0 || options.height <= 0) {
+                    return false;
+                }
+            }
+            else if (arg == "--frames") {
+                options.frames = std::atoi(value.c_str());
+            }
+            else if (arg == "--threads") {
+                options.threads = std::atoi(value.c_str());
+            }
+            else if (arg == "--workloads") {
+                options.workloads.clear();
+                for (size_t begin = 0; begin < value.size();) {
+                    const size_t comma = std::min(value.find(',', begin), value.size());
+                    options.workloads.push_back(value.substr(begin, comma - begin));
+                    begin = comma + 1;
+                }
+            }
+            else {
+                return false;
+            }
+        }
+        return options.frames > 1 && options.threads >= 0 && !options.workloads.empty() &&
+               options.width <= SyntheticSource::kMaxWidth && options.height <= SyntheticSource::kMaxHeight;
+    }
+
+    struct Result
+    {
+        int frames = 0;          // compared against a previous frame
+        int duplicates = 0;
+        uint64_t changedTiles = 0;
+        uint64_t missed = 0;     // changed, but the detector said it wasn't
+        uint64_t spurious = 0;   // flagged, but byte-identical
+        double detectMs = 0.0;
+        double fullScaleMs = 0.0;
+        double skipScaleMs = 0.0;
+        bool scaledSame = true;
+    };
+
+    bool tileChanged(const FrameView& a, const FrameView& b, int x, int y, int width, int height)
+    {
+        for (int row = y; row < y + height; row++) {
+            if (std::memcmp(a.row(row) + x * 4, b.row(row) + x * 4, static_cast<size_t>(width) * 4) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void copyFrame(const FrameView& src, FrameBuffer& dst)
+    {
+        dst.resize(src.width, src.height);
+        const FrameView out = dst.view();
+        for (int y = 0; y < src.height; y++) {
+            std::memcpy(out.row(y), src.row(y), static_cast<size_t>(src.width) * 4);
+        }
+    }
+
+    bool sameLevels(ScalerPyramid& a, ScalerPyramid& b)
+    {
+        for (int i = 0; i < a.levelCount(); i++) {
+            const FrameView va = a.level(i);
+            const FrameView vb = b.level(i);
+            for (int y = 0; y < va.height; y++) {
+                if (std::memcmp(va.row(y), vb.row(y), static_cast<size_t>(va.width) * 4) != 0) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    double msSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    bool runWorkload(const Options& options, const std::string& workload, ThreadPool& pool, Result& result)
+    {
+        SyntheticSource::Settings settings;
+        settings.width = options.width;
+        settings.height = options.height;
+        std::string error;
+        if (!SyntheticSource::parseScript(workload, settings.script, error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return false;
+        }
+        SyntheticSource source(settings);
+        if (!source.initialize()) {
+            std::fprintf(stderr, "%s\n", source.lastError().c_str());
+            return false;
+        }
+
+        const std::vector<Rendition> renditions{ { options.width * 2 / 3, options.height * 2 / 3 }, { options.width / 3, options.height / 3 } };
+        ScalerPyramid full;
+        ScalerPyramid skipping;
+        full.configure(options.width, options.height, renditions);
+        skipping.configure(options.width, options.height, renditions);
+
+        FrameChangeDetector detector;
+        FrameBuffer previous;
+        const int tile = FrameChangeDetector::kTileSize;
+
+        for (int f = 0; f < options.frames; f++) {
+            SourceFrame frame;
+            if (!source.acquireFrame(frame)) {
+                std::fprintf(stderr, "synthetic source gave no frame\n");
+                return false;
+            }
+
+            Clock::time_point start = Clock::now();
+            const ChangeMap& changes = detector.detect(frame.pixels, &pool);
+            const double detectMs = msSince(start);
+            start = Clock::now();
+            full.process(frame.pixels, &pool);
+            const double fullMs = msSince(start);
+            start = Clock::now();
+            skipping.process(frame.pixels, &pool, &changes);
+            const double skipMs = msSince(start);
+
+            // The first frame has nothing to compare with
+            if (f > 0) {
+                const FrameView before = previous.view();
+                for (int ty = 0; ty < changes.tilesY; ty++) {
+                    for (int tx = 0; tx < changes.tilesX; tx++) {
+                        const int x = tx * tile;
+                        const int y = ty * tile;
+                        const bool changed = tileChanged(frame.pixels, before, x, y,
+                            std::min(tile, options.width - x), std::min(tile, options.height - y));
+                        result.changedTiles += changed ? 1 : 0;
+                        result.missed += changed && !changes.isChanged(tx, ty) ? 1 : 0;
+                        result.spurious += !changed && changes.isChanged(tx, ty) ? 1 : 0;
+                    }
+                }
+                result.frames++;
+                result.duplicates += changes.isDuplicate() ? 1 : 0;
+                result.detectMs += detectMs;
+                result.fullScaleMs += fullMs;
+                result.skipScaleMs += skipMs;
+                result.scaledSame = result.scaledSame && sameLevels(full, skipping);
+            }
+            copyFrame(frame.pixels, previous);
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    ThreadPool pool(options.threads);
+    const int tiles = ((options.width + FrameChangeDetector::kTileSize - 1) / FrameChangeDetector::kTileSize) *
+                      ((options.height + FrameChangeDetector::kTileSize - 1) / FrameChangeDetector::kTileSize);
+    std::printf("%dx%d, %d frames per workload, %d threads\n", options.width, options.height, options.frames, pool.threadCount());
+    std::printf("%-8s %9s %6s %11s %12s %12s\n", "workload", "changed", "dups", "detect ms", "scale ms", "skipping ms");
+
+    bool ok = true;
+    for (const std::string& workload : options.workloads) {
+        Result result;
+        if (!runWorkload(options, workload, pool, result)) {
+            return 2;
+        }
+        const double frames = result.frames;
+        std::printf("%-8s %8.1f%% %6d %11.2f %12.2f %12.2f\n", workload.c_str(),
+            100.0 * result.changedTiles / (frames * tiles), result.duplicates,
+            result.detectMs / frames, result.fullScaleMs / frames, result.skipScaleMs / frames);
+
+        if (result.missed > 0 || result.spurious > 0) {
+            std::printf("FAIL: %s: %llu changed tiles missed, %llu unchanged tiles flagged\n", workload.c_str(),
+                static_cast<unsigned long long>(result.missed), static_cast<unsigned long long>(result.spurious));
+            ok = false;
+        }
+        if (!result.scaledSame) {
+            std::printf("FAIL: %s: skipping unchanged strips changed the scaled output\n", workload.c_str());
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}
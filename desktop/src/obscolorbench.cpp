@@ -0,0 +1,370 @@
+// Color filter golden images and throughput: runs Lut3D and ChromaKey over small
+// synthetic frames whose expected output is known (identity, inverting and corner
+// LUTs; key-colored, shadowed, gray and far-off pixels through CbCr and HSV keying),
+// once per SIMD level, then times both filters strip-parallel through FilterChain at
+// 1080p and 4K. Exits non-zero when an output pixel is off by more than one step.
+
+#include "incl/ChromaKey.h"
+#include "incl/FilterChain.h"
+#include "incl/Lut3D.h"
+#include "incl/Simd.h"
+#include "incl/ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        std::vector<std::pair<int, int>> sizes{ { 1920, 1080 }, { 3840, 2160 } };
+        int frames = 30;
+        int threads = 0;
+    };
+
+    const char* const kUsage =
+        "usage: obs-color-bench [options]\n"
+        "  --sizes WxH,..  timed frame sizes (default: 1920x1080,3840x2160)\n"
+        "  --frames N      timed frames per filter and size (default: 30)\n"
+        "  --threads N     pool threads (default: one per core)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--sizes") {
+                options.sizes.clear();
+                for (size_t begin = 0; begin < value.size();) {
+                    const size_t comma = std::min(value.find(',', begin), value.size());
+                    int width = 0;
+                    int height = 0;
+                    if (std::sscanf(value.substr(begin, comma - begin).c_str(), "%dx%d", &width, &height) != 2 ||
+                        width <= 0 || height <= 0) {
+                        return false;
+                    }
+                    options.sizes.emplace_back(width, height);
+                    begin = comma + 1;
+                }
+            }
+            else if (arg == "--frames") {
+                options.frames = std::atoi(value.c_str());
+            }
+            else if (arg == "--threads") {
+                options.threads = std::atoi(value.c_str());
+            }
+            else {
+                return false;
+            }
+        }
+        return options.frames > 0 && options.threads >= 0 && !options.sizes.empty();
+    }
+
+    const char* levelName(SimdLevel level)
+    {
+        switch (level) {
+        case SimdLevel::Scalar: return "scalar";
+        case SimdLevel::Sse2: return "sse2";
+        case SimdLevel::Avx2: return "avx2";
+        }
+        return "?";
+    }
+
+    // Largest per-channel difference between two BGRA buffers
+    int maxDifference(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+    {
+        int worst = 0;
+        for (size_t i = 0; i < a.size(); i++) {
+            worst = std::max(worst, std::abs(a[i] - b[i]));
+        }
+        return worst;
+    }
+
+    // Builds a .cube of the given size from a function of the grid color
+    template <typename Fn>
+    Lut3D makeLut(int size, Fn fn)
+    {
+        std::ostringstream cube;
+        cube << "LUT_3D_SIZE " << size << "\n";
+        for (int b = 0; b < size; b++) {
+            for (int g = 0; g < size; g++) {
+                for (int r = 0; r < size; r++) {
+                    double out[3];
+                    fn(static_cast<double>(r) / (size - 1), static_cast<double>(g) / (size - 1), static_cast<double>(b) / (size - 1), out);
+                    cube << out[0] << ' ' << out[1] << ' ' << out[2] << "\n";
+                }
+            }
+        }
+        std::istringstream in(cube.str());
+        Lut3D lut;
+        lut.parseCube(in);
+        return lut;
+    }
+
+    // Every byte value on every channel, with alpha walking the other way
+    std::vector<uint8_t> rampFrame()
+    {
+        std::vector<uint8_t> frame(256 * 4);
+        for (int i = 0; i < 256; i++) {
+            frame[i * 4 + 0] = static_cast<uint8_t>(i * 7);
+            frame[i * 4 + 1] = static_cast<uint8_t>(255 - i);
+            frame[i * 4 + 2] = static_cast<uint8_t>(i);
+            frame[i * 4 + 3] = static_cast<uint8_t>(i * 3);
+        }
+        return frame;
+    }
+
+    bool check(const char* name, const std::vector<uint8_t>& actual, const std::vector<uint8_t>& expected, int tolerance)
+    {
+        const int difference = maxDifference(actual, expected);
+        if (difference > tolerance) {
+            std::printf("FAIL: %s at %s: off by %d\n", name, levelName(simdLevel()), difference);
+            return false;
+        }
+        return true;
+    }
+
+    bool lutGoldens()
+    {
+        bool ok = true;
+        const std::vector<uint8_t> ramp = rampFrame();
+
+        // Identity and inversion are linear, so interpolation has to reproduce them exactly
+        for (int size : { 2, 17, 33 }) {
+            std::vector<uint8_t> out = ramp;
+            Lut3D::identity(size).apply(out.data(), 256);
+            ok = check("lut3d identity", out, ramp, 0) && ok;
+        }
+        const Lut3D invert = makeLut(5, [](double r, double g, double b, double out[3]) {
+            out[0] = 1.0 - r;
+            out[1] = 1.0 - g;
+            out[2] = 1.0 - b;
+        });
+        std::vector<uint8_t> inverted = ramp;
+        invert.apply(inverted.data(), 256);
+        std::vector<uint8_t> expected = ramp;
+        for (size_t i = 0; i < expected.size(); i++) {
+            expected[i] = (i & 3) == 3 ? expected[i] : static_cast<uint8_t>(255 - expected[i]);
+        }
+        ok = check("lut3d invert", inverted, expected, 0) && ok;
+
+        // 2^3 cube: each corner color comes out as exactly that table entry. Entries are
+        // multiples of 0.2, i.e. of 51.
+        const Lut3D corners = makeLut(2, [](double r, double g, double b, double out[3]) {
+            out[0] = 0.2 + 0.6 * g;
+            out[1] = 0.4 * r + 0.4 * b;
+            out[2] = 1.0 - 0.8 * r;
+        });
+        std::vector<uint8_t> cornerFrame;
+        std::vector<uint8_t> cornerExpected{
+            // B, G, R, A expected for the corners in the order below
+            255, 0, 51, 255,  // black
+            51, 102, 51, 128, // red
+            255, 0, 204, 64,  // green
+            255, 102, 51, 32, // blue
+            51, 102, 204, 16, // yellow
+            51, 204, 51, 8,   // magenta
+            255, 102, 204, 4, // cyan
+            51, 204, 204, 0,  // white
+        };
+        const uint8_t cornerColors[8][4] = {
+            { 0, 0, 0, 255 }, { 0, 0, 255, 128 }, { 0, 255, 0, 64 }, { 255, 0, 0, 32 },
+            { 0, 255, 255, 16 }, { 255, 0, 255, 8 }, { 255, 255, 0, 4 }, { 255, 255, 255, 0 },
+        };
+        for (const auto& color : cornerColors) {
+            cornerFrame.insert(cornerFrame.end(), color, color + 4);
+        }
+        corners.apply(cornerFrame.data(), 8);
+        ok = check("lut3d corners", cornerFrame, cornerExpected, 0) && ok;
+
+        // Anything else against the double-precision reference
+        const Lut3D grade = makeLut(33, [](double r, double g, double b, double out[3]) {
+            out[0] = std::pow(r, 0.8) * 0.9 + 0.05 * b;
+            out[1] = std::sqrt(g) * 0.5 + 0.5 * g * r;
+            out[2] = b * b;
+        });
+        std::vector<uint8_t> graded = ramp;
+        grade.apply(graded.data(), 256);
+        std::vector<uint8_t> reference = ramp;
+        for (int i = 0; i < 256; i++) {
+            double out[3];
+            grade.lookup(ramp[i * 4 + 2] / 255.0, ramp[i * 4 + 1] / 255.0, ramp[i * 4 + 0] / 255.0, out);
+            reference[i * 4 + 0] = static_cast<uint8_t>(std::lround(std::clamp(out[2], 0.0, 1.0) * 255.0));
+            reference[i * 4 + 1] = static_cast<uint8_t>(std::lround(std::clamp(out[1], 0.0, 1.0) * 255.0));
+            reference[i * 4 + 2] = static_cast<uint8_t>(std::lround(std::clamp(out[0], 0.0, 1.0) * 255.0));
+        }
+        ok = check("lut3d grade", graded, reference, 1) && ok;
+        return ok;
+    }
+
+    struct KeyGolden
+    {
+        const char* name;
+        ChromaKey::Space space;
+        uint32_t keyColor;
+        uint8_t in[4];       // R, G, B, A (straight)
+        uint8_t expected[4];
+    };
+
+    // Default similarity, smoothness and spill. Keyed pixels turn into their own luma
+    // (0.7152 * 255 = 182 for pure green) with alpha 0.
+    const KeyGolden kKeyGoldens[] = {
+        { "key color", ChromaKey::Space::CbCr, 0x00FF00, { 0, 255, 0, 255 }, { 182, 182, 182, 0 } },
+        { "white", ChromaKey::Space::CbCr, 0x00FF00, { 255, 255, 255, 200 }, { 255, 255, 255, 200 } },
+        { "red", ChromaKey::Space::CbCr, 0x00FF00, { 255, 0, 0, 255 }, { 255, 0, 0, 255 } },
+        { "near black", ChromaKey::Space::CbCr, 0x00FF00, { 3, 4, 3, 255 }, { 3, 4, 3, 255 } },
+        // CbCr scales with brightness: shadowed green lands in the soft edge and keeps
+        // most of its alpha, with part of the green pulled out
+        { "shadowed green", ChromaKey::Space::CbCr, 0x00FF00, { 0, 50, 0, 255 }, { 11, 46, 11, 250 } },
+        { "blue screen", ChromaKey::Space::CbCr, 0x0000FF, { 0, 0, 255, 255 }, { 18, 18, 18, 0 } },
+        // HSV ignores brightness: the same shadow keys fully, gray and black don't key
+        { "key color", ChromaKey::Space::Hsv, 0x00FF00, { 0, 255, 0, 255 }, { 182, 182, 182, 0 } },
+        { "shadowed green", ChromaKey::Space::Hsv, 0x00FF00, { 0, 50, 0, 255 }, { 36, 36, 36, 0 } },
+        { "gray", ChromaKey::Space::Hsv, 0x00FF00, { 128, 128, 128, 255 }, { 128, 128, 128, 255 } },
+        { "near black", ChromaKey::Space::Hsv, 0x00FF00, { 3, 4, 3, 255 }, { 3, 4, 3, 255 } },
+        { "red", ChromaKey::Space::Hsv, 0x00FF00, { 255, 0, 0, 255 }, { 255, 0, 0, 255 } },
+        { "blue screen", ChromaKey::Space::Hsv, 0x0000FF, { 0, 0, 40, 255 }, { 3, 3, 3, 0 } },
+    };
+
+    bool keyGoldens()
+    {
+        // 37 copies, so each pixel goes through the vector loop and the scalar tail
+        constexpr int kCopies = 37;
+        bool ok = true;
+        for (const KeyGolden& golden : kKeyGoldens) {
+            ChromaKey::Settings settings;
+            settings.keyColor = golden.keyColor;
+            settings.space = golden.space;
+            const ChromaKey key(settings);
+
+            const uint8_t in[4] = { golden.in[2], golden.in[1], golden.in[0], golden.in[3] };
+            const uint8_t expected[4] = { golden.expected[2], golden.expected[1], golden.expected[0], golden.expected[3] };
+            std::vector<uint8_t> frame;
+            std::vector<uint8_t> reference;
+            for (int i = 0; i < kCopies; i++) {
+                frame.insert(frame.end(), in, in + 4);
+                reference.insert(reference.end(), expected, expected + 4);
+            }
+            key.apply(frame.data(), kCopies);
+
+            std::string name = std::string("chroma key ") + (golden.space == ChromaKey::Space::Hsv ? "hsv " : "cbcr ") + golden.name;
+            ok = check(name.c_str(), frame, reference, 1) && ok;
+        }
+        return ok;
+    }
+
+    // A webcam-like frame: green backdrop with a falloff, a skin-toned subject, and
+    // sensor noise everywhere
+    void fillKeyFrame(const FrameView& view)
+    {
+        uint32_t state = 1;
+        for (int y = 0; y < view.height; y++) {
+            uint8_t* row = view.row(y);
+            for (int x = 0; x < view.width; x++) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                const int noise = static_cast<int>(state & 15) - 8;
+                const double dx = (x - view.width * 0.5) / (view.width * 0.2);
+                const double dy = (y - view.height * 0.6) / (view.height * 0.4);
+                const bool subject = dx * dx + dy * dy < 1.0;
+                const int light = 200 - 60 * std::abs(x - view.width / 2) / std::max(1, view.width / 2);
+                const int r = subject ? 210 : 40;
+                const int g = subject ? 160 : light;
+                const int b = subject ? 130 : 50;
+                row[x * 4 + 0] = static_cast<uint8_t>(std::clamp(b + noise, 0, 255));
+                row[x * 4 + 1] = static_cast<uint8_t>(std::clamp(g + noise, 0, 255));
+                row[x * 4 + 2] = static_cast<uint8_t>(std::clamp(r + noise, 0, 255));
+                row[x * 4 + 3] = 255;
+            }
+        }
+    }
+
+    // Milliseconds per frame for a chain running in place over a copy of the frame
+    template <typename Chain>
+    double timeChain(Chain& chain, const FrameBuffer& frame, int frames, ThreadPool& pool)
+    {
+        FrameBuffer work(frame.width(), frame.height());
+        const FrameView in = const_cast<FrameBuffer&>(frame).view();
+        const FrameView out = work.view();
+        double seconds = 0.0;
+        for (int f = 0; f < frames; f++) {
+            for (int y = 0; y < in.height; y++) {
+                std::memcpy(out.row(y), in.row(y), static_cast<size_t>(in.width) * 4);
+            }
+            const Clock::time_point start = Clock::now();
+            chain.process(out, out, &pool);
+            seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        }
+        return seconds * 1000.0 / frames;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    // Goldens at every level the machine has, so each kernel is held to them
+    bool ok = true;
+    int levels = 0;
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2 }) {
+        setSimdLevel(level);
+        if (simdLevel() != level) {
+            continue;
+        }
+        ok = lutGoldens() && ok;
+        ok = keyGoldens() && ok;
+        levels++;
+    }
+    setSimdLevel(SimdLevel::Avx2);
+    std::printf("golden frames %s at %d SIMD levels\n\n", ok ? "match" : "differ", levels);
+
+    ThreadPool pool(options.threads);
+    const Lut3D grade = makeLut(33, [](double r, double g, double b, double out[3]) {
+        out[0] = std::pow(r, 0.9);
+        out[1] = std::pow(g, 1.05);
+        out[2] = std::pow(b, 1.2) * 0.95;
+    });
+    ChromaKey::Settings hsvSettings;
+    hsvSettings.space = ChromaKey::Space::Hsv;
+    FilterChain<Lut3D> lutChain(grade);
+    FilterChain<ChromaKey> cbcrChain{ ChromaKey() };
+    FilterChain<ChromaKey> hsvChain{ ChromaKey(hsvSettings) };
+
+    std::printf("%d threads, %s kernels\n", pool.threadCount(), levelName(simdLevel()));
+    std::printf("%-11s %-14s %10s %10s\n", "size", "filter", "ms/frame", "Mpix/s");
+    for (const auto& size : options.sizes) {
+        FrameBuffer frame(size.first, size.second);
+        fillKeyFrame(frame.view());
+        const double megapixels = size.first * static_cast<double>(size.second) / 1e6;
+        const struct
+        {
+            const char* name;
+            double ms;
+        } rows[] = {
+            { "lut3d 33^3", timeChain(lutChain, frame, options.frames, pool) },
+            { "chroma cbcr", timeChain(cbcrChain, frame, options.frames, pool) },
+            { "chroma hsv", timeChain(hsvChain, frame, options.frames, pool) },
+        };
+        for (const auto& row : rows) {
+            char label[32];
+            std::snprintf(label, sizeof(label), "%dx%d", size.first, size.second);
+            std::printf("%-11s %-14s %10.2f %10.0f\n", label, row.name, row.ms, megapixels * 1000.0 / row.ms);
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+// Dirty-tile test for SceneCompositor: a scene with zoomed, shrunk, same-size,
+// translucent and solid layers is updated a few pixels at a time through
+// markContentChanged(), and after every compose() the canvas has to match a fresh
+// compositor that redrew every tile. Exits non-zero on the first frame that differs.
+
+#include "incl/SceneCompositor.h"
+#include "incl/ThreadPool.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Options
+    {
+        int frames = 200;
+        uint32_t seed = 1;
+        int threads = 0;
+    };
+
+    const char* const kUsage =
+        "usage: obs-compositor-test [options]\n"
+        "  --frames N   incremental updates to check (default: 200)\n"
+        "  --seed N     random seed (default: 1)\n"
+        "  --threads N  pool threads (default: one per core)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const int value = std::atoi(argv[++i]);
+            if (arg == "--frames") {
+                options.frames = value;
+            }
+            else if (arg == "--seed") {
+                options.seed = static_cast<uint32_t>(value);
+            }
+            else if (arg == "--threads") {
+                options.threads = value;
+            }
+            else {
+                return false;
+            }
+        }
+        return options.frames > 0 && options.threads >= 0;
+    }
+
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed) : m_state(seed ? seed : 1) {}
+
+        uint32_t next()
+        {
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 17;
+            m_state ^= m_state << 5;
+            return m_state;
+        }
+
+        int below(int n) { return static_cast<int>(next() % static_cast<uint32_t>(n)); }
+
+    private:
+        uint32_t m_state;
+    };
+
+    // A source image and the layer showing it
+    struct Source
+    {
+        FrameBuffer pixels;
+        SceneLayer layer;
+        bool straightAlpha = false; // random alpha, otherwise opaque
+        int id = 0;
+    };
+
+    uint32_t randomPixel(Random& random, bool straightAlpha)
+    {
+        const uint32_t color = random.next() & 0x00FFFFFFu;
+        const uint32_t alpha = straightAlpha ? static_cast<uint32_t>(random.below(256)) : 255u;
+        return color | alpha << 24;
+    }
+
+    void fill(const FrameView& view, const SceneRect& rect, Random& random, bool straightAlpha)
+    {
+        for (int y = rect.y; y < rect.y + rect.height; y++) {
+            uint32_t* row = reinterpret_cast<uint32_t*>(view.row(y));
+            for (int x = rect.x; x < rect.x + rect.width; x++) {
+                row[x] = randomPixel(random, straightAlpha);
+            }
+        }
+    }
+
+    bool sameCanvas(const FrameView& a, const FrameView& b, int& badX, int& badY)
+    {
+        for (int y = 0; y < a.height; y++) {
+            const uint32_t* pa = reinterpret_cast<const uint32_t*>(a.row(y));
+            const uint32_t* pb = reinterpret_cast<const uint32_t*>(b.row(y));
+            for (int x = 0; x < a.width; x++) {
+                if (pa[x] != pb[x]) {
+                    badX = x;
+                    badY = y;
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    constexpr int kCanvasWidth = 1280;
+    constexpr int kCanvasHeight = 720;
+    Random random(options.seed);
+
+    // Zoomed crop (8x), non-uniform zoom, shrink, 1:1 and a translucent overlay
+    Source sources[5] = {
+        { FrameBuffer(1920, 1080), {}, false }, // desktop, shrunk to the canvas
+        { FrameBuffer(640, 360), {}, false },   // 60x40 crop zoomed 8x
+        { FrameBuffer(160, 90), {}, true },     // stretched 3.5x2.2
+        { FrameBuffer(300, 200), {}, true },    // 1:1 at 70% opacity
+        { FrameBuffer(320, 240), {}, true },    // straight alpha, slightly enlarged
+    };
+    sources[0].layer.dest = { 0, 0, kCanvasWidth, kCanvasHeight };
+    sources[0].layer.opaque = true;
+    sources[1].layer.crop = { 200, 100, 60, 40 };
+    sources[1].layer.dest = { 700, 40, 480, 320 };
+    sources[2].layer.dest = { 90, 380, 560, 200 };
+    sources[3].layer.dest = { 813, 411, 300, 200 };
+    sources[3].layer.opacity = 0.7f;
+    sources[4].layer.dest = { 37, 29, 417, 301 };
+
+    SceneLayer solid;
+    solid.kind = SceneLayer::Kind::SolidColor;
+    solid.color = 0x80204060;
+    solid.dest = { 500, 250, 200, 150 };
+
+    ThreadPool pool(options.threads);
+    SceneCompositor incremental;
+    incremental.setCanvasSize(kCanvasWidth, kCanvasHeight);
+    for (int i = 0; i < 5; i++) {
+        Source& source = sources[i];
+        fill(source.pixels.view(), SceneRect{ 0, 0, source.pixels.width(), source.pixels.height() }, random, source.straightAlpha);
+        source.layer.source = source.pixels.view();
+        source.id = incremental.addLayer(source.layer);
+        if (i == 2) {
+            incremental.addLayer(solid);
+        }
+    }
+    incremental.compose(&pool);
+
+    int redrawn = 0;
+    for (int frame = 0; frame < options.frames; frame++) {
+        // A few small changes per frame, in one or two of the sources
+        const int changes = 1 + random.below(3);
+        for (int c = 0; c < changes; c++) {
+            Source& source = sources[random.below(5)];
+            const FrameView view = source.pixels.view();
+            SceneRect rect;
+            if (source.layer.crop.isEmpty() || random.below(4) == 0) {
+                rect.x = random.below(view.width);
+                rect.y = random.below(view.height);
+            }
+            else {
+                // Mostly inside the cropped part, so the zoom has something to spread
+                rect.x = source.layer.crop.x + random.below(source.layer.crop.width);
+                rect.y = source.layer.crop.y + random.below(source.layer.crop.height);
+            }
+            rect.width = std::min(1 + random.below(6), view.width - rect.x);
+            rect.height = std::min(1 + random.below(6), view.height - rect.y);
+            fill(view, rect, random, source.straightAlpha);
+            incremental.markContentChanged(source.id, rect);
+        }
+        redrawn += incremental.compose(&pool);
+
+        SceneCompositor full;
+        full.setCanvasSize(kCanvasWidth, kCanvasHeight);
+        for (int i = 0; i < 5; i++) {
+            full.addLayer(sources[i].layer);
+            if (i == 2) {
+                full.addLayer(solid);
+            }
+        }
+        full.compose(&pool);
+
+        int x = 0;
+        int y = 0;
+        if (!sameCanvas(incremental.canvas(), full.canvas(), x, y)) {
+            std::printf("FAIL: frame %d differs from a full recomposite at %d,%d (tile %d,%d)\n", frame, x, y,
+                x / SceneCompositor::kTileSize, y / SceneCompositor::kTileSize);
+            return 1;
+        }
+    }
+
+    const int tiles = ((kCanvasWidth + SceneCompositor::kTileSize - 1) / SceneCompositor::kTileSize) *
+                      ((kCanvasHeight + SceneCompositor::kTileSize - 1) / SceneCompositor::kTileSize);
+    std::printf("%d incremental frames match a full recomposite, %.1f of %d tiles redrawn per frame\n",
+        options.frames, static_cast<double>(redrawn) / options.frames, tiles);
+    return 0;
+}
@@ -0,0 +1,295 @@
+// FFT accuracy and speed: checks RealFft against a naive double-precision DFT for every
+// size from 8 to 8192, checks that pure tones put their energy in the right bin and
+// nowhere else and that Parseval's identity holds on noise, each with setSimdLevel()
+// capped at scalar, SSE2 and AVX2 in turn. Then it feeds SpectrumAnalyzer a full-scale
+// tone and checks its band reads 0 dBFS, and times forward() at 512 to 8192 points per
+// SIMD level. Exits non-zero when a check fails.
+
+#include "incl/Fft.h"
+#include "incl/Simd.h"
+#include "incl/SpectrumAnalyzer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr double kPi = 3.14159265358979323846;
+
+    // RMS error against the DFT relative to the spectrum's RMS; single precision
+    // butterflies land around 1e-7 and grow with log2(N)
+    constexpr double kDftTolerance = 1e-5;
+
+    // Energy that may leak from a bin-centred tone into other bins, relative to the tone
+    constexpr double kLeakageDb = -100.0;
+
+    constexpr double kParsevalTolerance = 1e-5;
+    constexpr double kAnalyzerToleranceDb = 0.1;
+
+    constexpr int kMinSize = 8;
+    constexpr int kMaxSize = 8192;
+    constexpr int kMinTimedSize = 512;
+
+    struct Options
+    {
+        int runs = 5000;
+    };
+
+    const char* const kUsage =
+        "usage: obs-fft-bench [options]\n"
+        "  --runs N   timed transforms per size and level (default: 5000)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const int value = std::atoi(argv[++i]);
+            if (arg == "--runs") {
+                options.runs = value;
+            }
+            else {
+                return false;
+            }
+        }
+        return options.runs > 0;
+    }
+
+    const char* levelName(SimdLevel level)
+    {
+        switch (level) {
+        case SimdLevel::Scalar: return "scalar";
+        case SimdLevel::Sse2: return "sse2";
+        case SimdLevel::Avx2: return "avx2";
+        }
+        return "?";
+    }
+
+    std::vector<float> noise(int size)
+    {
+        std::vector<float> samples(size);
+        uint32_t state = 0x2545F491u;
+        for (float& sample : samples) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            sample = static_cast<float>(static_cast<int32_t>(state)) / 2147483648.0f;
+        }
+        return samples;
+    }
+
+    // Transforms `in` and returns the spectrum as doubles
+    void transform(int size, const std::vector<float>& in, std::vector<double>& re, std::vector<double>& im)
+    {
+        RealFft fft;
+        fft.configure(size);
+        std::vector<float> outRe(fft.bins());
+        std::vector<float> outIm(fft.bins());
+        fft.forward(in.data(), outRe.data(), outIm.data());
+        re.assign(outRe.begin(), outRe.end());
+        im.assign(outIm.begin(), outIm.end());
+    }
+
+    // Every bin of the naive O(N^2) DFT, twiddles from one table
+    bool checkDft(int size)
+    {
+        const std::vector<float> in = noise(size);
+        std::vector<double> re, im;
+        transform(size, in, re, im);
+
+        std::vector<double> cosines(size), sines(size);
+        for (int i = 0; i < size; i++) {
+            cosines[i] = std::cos(2.0 * kPi * i / size);
+            sines[i] = std::sin(2.0 * kPi * i / size);
+        }
+        double error = 0.0;
+        double energy = 0.0;
+        for (int k = 0; k < size / 2 + 1; k++) {
+            double sumRe = 0.0, sumIm = 0.0;
+            for (int n = 0, phase = 0; n < size; n++, phase = (phase + k) & (size - 1)) {
+                sumRe += in[n] * cosines[phase];
+                sumIm -= in[n] * sines[phase];
+            }
+            error += (re[k] - sumRe) * (re[k] - sumRe) + (im[k] - sumIm) * (im[k] - sumIm);
+            energy += sumRe * sumRe + sumIm * sumIm;
+        }
+        const double relative = std::sqrt(error / energy);
+        if (relative > kDftTolerance) {
+            std::printf("FAIL: %d-point FFT at %s: relative error %.2e against the DFT\n", size, levelName(simdLevel()), relative);
+            return false;
+        }
+        return true;
+    }
+
+    // A cosine on bin k gives |X[k]| = N/2 (N at DC and Nyquist) and nothing else
+    bool checkTone(int size, int bin)
+    {
+        std::vector<float> in(size);
+        for (int n = 0; n < size; n++) {
+            in[n] = static_cast<float>(std::cos(2.0 * kPi * bin * n / size + 0.3));
+        }
+        std::vector<double> re, im;
+        transform(size, in, re, im);
+
+        const bool edge = bin == 0 || bin == size / 2;
+        // Phase only survives off the edges; there the real cosine keeps cos(0.3) of it
+        const double expected = edge ? size * std::cos(0.3) : size / 2.0;
+        const double magnitude = std::hypot(re[bin], im[bin]);
+        double leakage = 0.0;
+        for (int k = 0; k < size / 2 + 1; k++) {
+            if (k != bin) {
+                leakage = std::max(leakage, re[k] * re[k] + im[k] * im[k]);
+            }
+        }
+        const double leakageDb = 10.0 * std::log10(std::max(leakage, 1e-300) / (magnitude * magnitude));
+        if (std::fabs(magnitude / expected - 1.0) > 1e-5 || leakageDb > kLeakageDb) {
+            std::printf("FAIL: %d-point FFT at %s: tone on bin %d reads %.6g (expected %.6g), %.1f dB in other bins\n", size,
+                levelName(simdLevel()), bin, magnitude, expected, leakageDb);
+            return false;
+        }
+        return true;
+    }
+
+    // sum x^2 = (|X0|^2 + 2 * sum |Xk|^2 + |X(N/2)|^2) / N over the one-sided spectrum
+    bool checkParseval(int size)
+    {
+        const std::vector<float> in = noise(size);
+        std::vector<double> re, im;
+        transform(size, in, re, im);
+
+        double time = 0.0;
+        for (float sample : in) {
+            time += static_cast<double>(sample) * sample;
+        }
+        double frequency = 0.0;
+        for (int k = 0; k < size / 2 + 1; k++) {
+            const double power = re[k] * re[k] + im[k] * im[k];
+            frequency += k == 0 || k == size / 2 ? power : 2.0 * power;
+        }
+        frequency /= size;
+        if (std::fabs(frequency / time - 1.0) > kParsevalTolerance) {
+            std::printf("FAIL: %d-point FFT at %s: Parseval off by %.2e\n", size, levelName(simdLevel()), frequency / time - 1.0);
+            return false;
+        }
+        return true;
+    }
+
+    // A full-scale sine centred on a bin must read 0 dBFS in its band and be the loudest
+    bool checkAnalyzer()
+    {
+        constexpr int kSampleRate = 48000;
+        SpectrumAnalyzer::Settings settings;
+        const int bin = 43; // ~1 kHz at 2048 points
+        const double frequency = static_cast<double>(bin) * kSampleRate / settings.fftSize;
+
+        SpectrumAnalyzer analyzer;
+        if (!analyzer.start(kSampleRate, settings)) {
+            std::puts("FAIL: SpectrumAnalyzer did not start");
+            return false;
+        }
+        std::vector<float> tone(settings.fftSize * 2);
+        for (size_t n = 0; n < tone.size(); n++) {
+            tone[n] = static_cast<float>(std::sin(2.0 * kPi * frequency * n / kSampleRate));
+        }
+        analyzer.push(tone.data(), static_cast<int>(tone.size()), 1);
+
+        // One spectrum for the first fftSize samples, then one per hop; wait for the last
+        const int hop = static_cast<int>(settings.fftSize * (1.0f - settings.overlap));
+        const int spectra = 1 + (static_cast<int>(tone.size()) - settings.fftSize) / hop;
+        const Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+        const SpectrumAnalyzer::Snapshot* snapshot = &analyzer.latest();
+        while (snapshot->sequence < static_cast<uint64_t>(spectra) && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            snapshot = &analyzer.latest();
+        }
+        const std::vector<float> levels = snapshot->levels;
+        const uint64_t sequence = snapshot->sequence;
+        analyzer.stop();
+        if (sequence < static_cast<uint64_t>(spectra)) {
+            std::printf("FAIL: SpectrumAnalyzer published %llu of %d spectra\n", static_cast<unsigned long long>(sequence), spectra);
+            return false;
+        }
+
+        const int loudest = static_cast<int>(std::max_element(levels.begin(), levels.end()) - levels.begin());
+        const double ratio = std::log(static_cast<double>(settings.maxFrequency) / settings.minFrequency);
+        const int band = static_cast<int>(std::log(frequency / settings.minFrequency) / ratio * settings.bands);
+        if (loudest != band || std::fabs(levels[band]) > kAnalyzerToleranceDb) {
+            std::printf("FAIL: SpectrumAnalyzer: %.1f Hz tone reads %.2f dBFS in band %d, loudest band %d\n", frequency,
+                levels[band], band, loudest);
+            return false;
+        }
+        return true;
+    }
+
+    // Microseconds per forward() at the current SIMD level
+    double timeForward(int size, int runs)
+    {
+        RealFft fft;
+        fft.configure(size);
+        const std::vector<float> in = noise(size);
+        std::vector<float> re(fft.bins());
+        std::vector<float> im(fft.bins());
+        fft.forward(in.data(), re.data(), im.data());
+        const Clock::time_point start = Clock::now();
+        for (int i = 0; i < runs; i++) {
+            fft.forward(in.data(), re.data(), im.data());
+        }
+        return std::chrono::duration<double>(Clock::now() - start).count() * 1e6 / runs;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    const SimdLevel allLevels[] = { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2 };
+    std::vector<SimdLevel> levels;
+    bool ok = true;
+    for (SimdLevel level : allLevels) {
+        setSimdLevel(level);
+        if (simdLevel() != level) {
+            continue;
+        }
+        levels.push_back(level);
+        for (int size = kMinSize; size <= kMaxSize; size *= 2) {
+            ok = checkDft(size) && ok;
+            ok = checkParseval(size) && ok;
+            for (int bin : { 0, 1, size / 8 + 1, size / 2 - 1, size / 2 }) {
+                ok = checkTone(size, bin) && ok;
+            }
+        }
+    }
+    setSimdLevel(SimdLevel::Avx2);
+    ok = checkAnalyzer() && ok;
+    std::printf("FFT %d to %d points %s the DFT, tones and Parseval at %d SIMD levels\n\n", kMinSize, kMaxSize,
+        ok ? "matches" : "fails", static_cast<int>(levels.size()));
+
+    std::printf("%-6s", "size");
+    for (SimdLevel level : levels) {
+        std::printf(" %10s us", levelName(level));
+    }
+    std::printf("\n");
+    for (int size = kMinTimedSize; size <= kMaxSize; size *= 2) {
+        std::printf("%-6d", size);
+        for (SimdLevel level : levels) {
+            setSimdLevel(level);
+            // Same number of samples per size, so every row takes about as long
+            std::printf(" %13.2f", timeForward(size, std::max(1, options.runs * kMinTimedSize / size)));
+        }
+        std::printf("\n");
+    }
+    setSimdLevel(SimdLevel::Avx2);
+    return ok ? 0 : 1;
+}
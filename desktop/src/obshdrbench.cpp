@@ -0,0 +1,530 @@
+// HDR conversion accuracy and speed: runs HdrConverter over synthetic HDR10 (PQ), HLG
+// and FP16 scRGB frames, a grey ramp plus random colors, and compares each toSdr()
+// pixel and each toP010() luma sample against a double-precision model of the
+// documented pipeline (exact PQ/HLG/half decode with the HLG OOTF, BT.2020 <-> BT.709,
+// the curve on max(R, G, B), exact sRGB; PQ encode for P010). Every curve is checked
+// at every SIMD level, for two display peaks, along with fixed points: black stays
+// black and the display peak becomes SDR white. Then it times both conversions per
+// format and kernel set. Exits non-zero when a pixel is off by more than one code.
+
+#include "incl/HdrConverter.h"
+#include "incl/Simd.h"
+#include "incl/ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Codes a reading may be off by: one 8-bit SDR step, one 10-bit P010 step
+    constexpr int kSdrTolerance = 1;
+    constexpr int kP010Tolerance = 1;
+
+    struct Options
+    {
+        int width = 3840;
+        int height = 2160;
+        int frames = 10;
+        int threads = 0;
+    };
+
+    const char* const kUsage =
+        "usage: obs-hdr-bench [options]\n"
+        "  --size WxH      timed frame size (default: 3840x2160)\n"
+        "  --frames N      timed frames per conversion (default: 10)\n"
+        "  --threads N     pool threads (default: one per core)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--size") {
+                if (std::sscanf(value.c_str(), "%dx%d", &options.width, &options.height) != 2) {
+                    return false;
+                }
+            }
+            else if (arg == "--frames") {
+                options.frames = std::atoi(value.c_str());
+            }
+            else if (arg == "--threads") {
+                options.threads = std::atoi(value.c_str());
+            }
+            else {
+                return false;
+            }
+        }
+        return options.width > 0 && options.height > 0 && options.frames > 0 && options.threads >= 0;
+    }
+
+    const char* levelName(SimdLevel level)
+    {
+        switch (level) {
+        case SimdLevel::Scalar: return "scalar";
+        case SimdLevel::Sse2: return "sse2";
+        case SimdLevel::Avx2: return "avx2";
+        }
+        return "?";
+    }
+
+    const char* curveName(ToneCurve curve)
+    {
+        switch (curve) {
+        case ToneCurve::Clip: return "clip";
+        case ToneCurve::Reinhard: return "reinhard";
+        case ToneCurve::Hable: return "hable";
+        case ToneCurve::Bt2390: return "bt2390";
+        }
+        return "?";
+    }
+
+    class Random
+    {
+    public:
+        uint32_t next()
+        {
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 17;
+            m_state ^= m_state << 5;
+            return m_state;
+        }
+
+    private:
+        uint32_t m_state = 0x2545F491u;
+    };
+
+    const char* formatName(HdrFormat format)
+    {
+        switch (format) {
+        case HdrFormat::ScRgb16F: return "scrgb";
+        case HdrFormat::Hdr10: return "pq";
+        case HdrFormat::Hlg10: return "hlg";
+        }
+        return "?";
+    }
+
+    constexpr HdrFormat kFormats[] = { HdrFormat::Hdr10, HdrFormat::Hlg10, HdrFormat::ScRgb16F };
+
+    uint32_t pack(int r, int g, int b)
+    {
+        return static_cast<uint32_t>(r) | (static_cast<uint32_t>(g) << 10) | (static_cast<uint32_t>(b) << 20) | (3u << 30);
+    }
+
+    // Nearest half, ties to even; the frames stay well inside the half range
+    uint16_t floatToHalf(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, 4);
+        const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+        const float magnitude = std::fabs(value);
+        if (magnitude < 6.103515625e-05f) {
+            // Subnormal: a count of 2^-24 steps, which rounds up into the first normal
+            return static_cast<uint16_t>(sign | static_cast<uint16_t>(std::nearbyint(magnitude * 16777216.0f)));
+        }
+        const uint32_t mantissa = bits & 0x7FFFFF;
+        uint32_t half = ((((bits >> 23) & 0xFF) - 112) << 10) | (mantissa >> 13);
+        const uint32_t rest = mantissa & 0x1FFF;
+        if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+            half++;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    double halfToDouble(uint16_t h)
+    {
+        const int exponent = (h >> 10) & 0x1F;
+        const double mantissa = h & 0x3FF;
+        const double value = exponent == 0 ? std::ldexp(mantissa, -24) : std::ldexp(1024.0 + mantissa, exponent - 25);
+        return h & 0x8000 ? -value : value;
+    }
+
+    // An HDR frame in any of the formats, tightly packed
+    struct Frame
+    {
+        std::vector<uint8_t> bytes;
+        int width = 0;
+        int height = 0;
+        HdrFormat format = HdrFormat::Hdr10;
+
+        Frame(int width, int height, HdrFormat format)
+            : bytes(static_cast<size_t>(width) * height * pixelBytes(format)), width(width), height(height), format(format)
+        {
+        }
+
+        static int pixelBytes(HdrFormat format) { return format == HdrFormat::ScRgb16F ? 8 : 4; }
+
+        HdrView view() const { return HdrView(bytes.data(), width, height, width * pixelBytes(format), format); }
+        uint8_t* pixel(size_t i) { return bytes.data() + i * pixelBytes(format); }
+        const uint8_t* pixel(size_t i) const { return bytes.data() + i * pixelBytes(format); }
+
+        void setPacked(size_t i, uint32_t px) { std::memcpy(pixel(i), &px, 4); }
+        void setScRgb(size_t i, float r, float g, float b)
+        {
+            const uint16_t halves[4] = { floatToHalf(r), floatToHalf(g), floatToHalf(b), floatToHalf(1.0f) };
+            std::memcpy(pixel(i), halves, 8);
+        }
+    };
+
+    // --- Reference model, all in double ---
+
+    double pqDecode(double e)
+    {
+        const double m1 = 2610.0 / 16384.0, m2 = 2523.0 / 4096.0 * 128.0;
+        const double c1 = 3424.0 / 4096.0, c2 = 2413.0 / 4096.0 * 32.0, c3 = 2392.0 / 4096.0 * 32.0;
+        const double ep = std::pow(e, 1.0 / m2);
+        return 10000.0 * std::pow(std::max(ep - c1, 0.0) / (c2 - c3 * ep), 1.0 / m1);
+    }
+
+    double pqEncode(double nits)
+    {
+        const double m1 = 2610.0 / 16384.0, m2 = 2523.0 / 4096.0 * 128.0;
+        const double c1 = 3424.0 / 4096.0, c2 = 2413.0 / 4096.0 * 32.0, c3 = 2392.0 / 4096.0 * 32.0;
+        const double ym = std::pow(std::min(std::max(nits, 0.0), 10000.0) / 10000.0, m1);
+        return std::pow((c1 + c2 * ym) / (1.0 + c3 * ym), m2);
+    }
+
+    double hlgDecode(double e)
+    {
+        const double a = 0.17883277, b = 1.0 - 4.0 * a, c = 0.5 - a * std::log(4.0 * a);
+        return e <= 0.5 ? e * e / 3.0 : (std::exp((e - c) / a) + b) / 12.0;
+    }
+
+    double hable(double x)
+    {
+        return (x * (0.15 * x + 0.05) + 0.004) / (x * (0.15 * x + 0.5) + 0.06) - 0.02 / 0.3;
+    }
+
+    // Where the pipeline says a pixel ends up
+    struct Reference
+    {
+        HdrConverter::Settings settings;
+
+        // Code values -> linear BT.2020 display light in nits
+        void decode(uint32_t px, HdrFormat format, double rgb[3]) const
+        {
+            for (int c = 0; c < 3; c++) {
+                const double e = ((px >> (10 * c)) & 0x3FF) / 1023.0;
+                rgb[c] = format == HdrFormat::Hdr10 ? pqDecode(e) : hlgDecode(e);
+            }
+            if (format == HdrFormat::Hlg10) {
+                // BT.2100 OOTF: Fd = Lw * Ys^(gamma - 1) * E
+                const double lw = settings.peakNits;
+                const double gamma = 1.2 + 0.42 * std::log10(lw / 1000.0);
+                const double ys = 0.2627 * rgb[0] + 0.6780 * rgb[1] + 0.0593 * rgb[2];
+                const double gain = ys > 0.0 ? lw * std::pow(ys, gamma - 1.0) : 0.0;
+                for (int c = 0; c < 3; c++) {
+                    rgb[c] *= gain;
+                }
+            }
+        }
+
+        // x is the max channel in units of SDR white
+        double curve(double x) const
+        {
+            const double white = settings.sdrWhiteNits;
+            const double peak = settings.peakNits / white;
+            if (x >= peak) {
+                return 1.0;
+            }
+            switch (settings.curve) {
+            case ToneCurve::Reinhard:
+                return x * (1.0 + x / (peak * peak)) / (1.0 + x);
+            case ToneCurve::Hable:
+                return hable(x * 2.0) / hable(peak * 2.0);
+            case ToneCurve::Bt2390: {
+                // EETF with zero blacks, Hermite spline from the knee in PQ space
+                const double pqPeak = pqEncode(settings.peakNits);
+                const double target = pqEncode(white) / pqPeak;
+                const double knee = std::min(1.5 * target - 0.5, 1.0);
+                double e = std::min(pqEncode(x * white) / pqPeak, 1.0);
+                if (e > knee) {
+                    const double t = (e - knee) / (1.0 - knee);
+                    e = (2 * t * t * t - 3 * t * t + 1) * knee + (t * t * t - 2 * t * t + t) * (1.0 - knee) + (-2 * t * t * t + 3 * t * t) * target;
+                }
+                return pqDecode(e * pqPeak) / white;
+            }
+            case ToneCurve::Clip:
+            default:
+                return x;
+            }
+        }
+
+        // Any pixel -> linear display light in nits, BT.709 or BT.2020 primaries
+        void linear(const uint8_t* px, HdrFormat format, bool to709, double rgb[3]) const
+        {
+            double in[3];
+            bool is709 = false;
+            if (format == HdrFormat::ScRgb16F) {
+                for (int c = 0; c < 3; c++) {
+                    uint16_t half;
+                    std::memcpy(&half, px + c * 2, 2);
+                    in[c] = halfToDouble(half) * 80.0;
+                }
+                is709 = true;
+            }
+            else {
+                uint32_t packed;
+                std::memcpy(&packed, px, 4);
+                decode(packed, format, in);
+            }
+            if (is709 == to709) {
+                std::copy(in, in + 3, rgb);
+            }
+            else if (to709) {
+                rgb[0] = 1.660491 * in[0] - 0.587641 * in[1] - 0.072850 * in[2];
+                rgb[1] = -0.124550 * in[0] + 1.132900 * in[1] - 0.008349 * in[2];
+                rgb[2] = -0.018151 * in[0] - 0.100579 * in[1] + 1.118730 * in[2];
+            }
+            else {
+                rgb[0] = 0.627404 * in[0] + 0.329283 * in[1] + 0.043313 * in[2];
+                rgb[1] = 0.069097 * in[0] + 0.919540 * in[1] + 0.011362 * in[2];
+                rgb[2] = 0.016391 * in[0] + 0.088013 * in[1] + 0.895595 * in[2];
+            }
+        }
+
+        // BGRA the way toSdr() should write it
+        void sdr(const uint8_t* px, HdrFormat format, uint8_t out[4]) const
+        {
+            double rgb[3];
+            linear(px, format, true, rgb);
+            const double white = settings.sdrWhiteNits;
+            const double m = std::max(std::max(std::max(rgb[0], rgb[1]), rgb[2]) / white, 0.0);
+            const double k = m > 0.0 ? std::min(curve(m), 1.0) / m / white : 0.0;
+            for (int c = 0; c < 3; c++) {
+                const double v = std::min(std::max(rgb[c] * k, 0.0), 1.0);
+                const double s = v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+                out[2 - c] = static_cast<uint8_t>(std::lround(s * 255.0));
+            }
+            out[3] = 255;
+        }
+
+        // 10-bit limited range luma code of the PQ BT.2020 signal
+        int p010Luma(const uint8_t* px, HdrFormat format) const
+        {
+            double e[3];
+            if (format == HdrFormat::Hdr10) {
+                uint32_t packed;
+                std::memcpy(&packed, px, 4);
+                for (int c = 0; c < 3; c++) {
+                    e[c] = ((packed >> (10 * c)) & 0x3FF) / 1023.0;
+                }
+            }
+            else {
+                linear(px, format, false, e);
+                for (int c = 0; c < 3; c++) {
+                    e[c] = pqEncode(e[c]);
+                }
+            }
+            const double y = 64.0 + 876.0 * (0.2627 * e[0] + 0.6780 * e[1] + 0.0593 * e[2]);
+            return static_cast<int>(std::min(std::max(std::lround(y), 0L), 1023L));
+        }
+    };
+
+    // Row 0 is a grey ramp, the other rows random colors. Packed formats walk every
+    // 10-bit code; scRGB goes up to 5120 nits with a few out-of-gamut negatives.
+    Frame testFrame(int width, int height, HdrFormat format)
+    {
+        Frame frame(width, height, format);
+        Random random;
+        const size_t pixels = static_cast<size_t>(width) * height;
+        auto unit = [&random] { return (random.next() >> 8) * (1.0f / 16777216.0f); };
+        for (int x = 0; x < width; x++) {
+            const float t = static_cast<float>(x) / (width - 1);
+            if (format == HdrFormat::ScRgb16F) {
+                frame.setScRgb(x, 64.0f * t * t, 64.0f * t * t, 64.0f * t * t);
+            }
+            else {
+                const int code = static_cast<int>(std::lround(t * 1023.0f));
+                frame.setPacked(x, pack(code, code, code));
+            }
+        }
+        for (size_t i = width; i < pixels; i++) {
+            if (format == HdrFormat::ScRgb16F) {
+                float rgb[3];
+                for (float& v : rgb) {
+                    const float u = unit();
+                    v = random.next() % 8 == 0 ? -0.25f * u : 64.0f * u * u * u;
+                }
+                frame.setScRgb(i, rgb[0], rgb[1], rgb[2]);
+            }
+            else {
+                const uint32_t bits = random.next();
+                frame.setPacked(i, pack(bits & 0x3FF, (bits >> 10) & 0x3FF, (bits >> 20) & 0x3FF));
+            }
+        }
+        return frame;
+    }
+
+    // Converts the frame both ways and compares every pixel against the model
+    bool checkFrame(const HdrConverter& converter, const Reference& reference, const Frame& frame, const char* name)
+    {
+        const int width = frame.width;
+        const int height = frame.height;
+        std::vector<uint8_t> sdr(static_cast<size_t>(width) * height * 4);
+        converter.toSdr(frame.view(), FrameView(sdr.data(), width, height, width * 4));
+        P010Buffer p010;
+        converter.toP010(frame.view(), p010);
+
+        int sdrWorst = 0;
+        int lumaWorst = 0;
+        for (size_t i = 0; i < static_cast<size_t>(width) * height; i++) {
+            uint8_t expected[4];
+            reference.sdr(frame.pixel(i), frame.format, expected);
+            for (int c = 0; c < 4; c++) {
+                sdrWorst = std::max(sdrWorst, std::abs(sdr[i * 4 + c] - expected[c]));
+            }
+            lumaWorst = std::max(lumaWorst, std::abs((p010.luma[i] >> 6) - reference.p010Luma(frame.pixel(i), frame.format)));
+        }
+
+        bool ok = true;
+        if (sdrWorst > kSdrTolerance) {
+            std::printf("FAIL: %s toSdr %s: off by %d codes\n", name, levelName(simdLevel()), sdrWorst);
+            ok = false;
+        }
+        if (lumaWorst > kP010Tolerance) {
+            std::printf("FAIL: %s toP010 luma %s: off by %d codes\n", name, levelName(simdLevel()), lumaWorst);
+            ok = false;
+        }
+        return ok;
+    }
+
+    // Fixed points that hold for every curve
+    bool checkAnchors(const HdrConverter& converter, HdrFormat format, const char* name)
+    {
+        // Black, then a signal at or past the display peak
+        const float peakNits = converter.settings().peakNits;
+        Frame pixels(2, 1, format);
+        if (format == HdrFormat::ScRgb16F) {
+            pixels.setScRgb(0, 0.0f, 0.0f, 0.0f);
+            pixels.setScRgb(1, peakNits / 80.0f, peakNits / 80.0f, peakNits / 80.0f);
+        }
+        else {
+            const int peakCode = format == HdrFormat::Hdr10 ? static_cast<int>(std::ceil(pqEncode(peakNits) * 1023.0)) : 1023;
+            pixels.setPacked(0, pack(0, 0, 0));
+            pixels.setPacked(1, pack(peakCode, peakCode, peakCode));
+        }
+        const uint8_t expected[2] = { 0, 255 };
+        uint8_t out[8];
+        converter.toSdr(pixels.view(), FrameView(out, 2, 1, 8));
+        bool ok = true;
+        for (int i = 0; i < 2; i++) {
+            if (out[i * 4] != expected[i] || out[i * 4 + 1] != expected[i] || out[i * 4 + 2] != expected[i]) {
+                std::printf("FAIL: %s %s: %s gave %d,%d,%d\n", name, levelName(simdLevel()), i ? "peak" : "black",
+                    out[i * 4 + 2], out[i * 4 + 1], out[i * 4]);
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    bool checkAll()
+    {
+        bool ok = true;
+        for (float peakNits : { 1000.0f, 4000.0f }) {
+            for (ToneCurve curve : { ToneCurve::Clip, ToneCurve::Reinhard, ToneCurve::Hable, ToneCurve::Bt2390 }) {
+                Reference reference;
+                reference.settings.curve = curve;
+                reference.settings.peakNits = peakNits;
+                const HdrConverter converter(reference.settings);
+                for (HdrFormat format : kFormats) {
+                    char name[64];
+                    std::snprintf(name, sizeof(name), "%s %s %g nits", formatName(format), curveName(curve), peakNits);
+                    ok = checkFrame(converter, reference, testFrame(1024, 48, format), name) && ok;
+                    ok = checkAnchors(converter, format, name) && ok;
+                }
+            }
+        }
+        return ok;
+    }
+
+    // Gradients from black to past the peak in every channel
+    Frame timingFrame(int width, int height, HdrFormat format)
+    {
+        Frame frame(width, height, format);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const size_t i = static_cast<size_t>(y) * width + x;
+                const float r = static_cast<float>(x) / width;
+                const float g = static_cast<float>(y) / height;
+                if (format == HdrFormat::ScRgb16F) {
+                    frame.setScRgb(i, 16.0f * r, 16.0f * g, 8.0f * (r + g));
+                }
+                else {
+                    frame.setPacked(i, pack(static_cast<int>(1023 * r), static_cast<int>(1023 * g), static_cast<int>(511.5f * (r + g))));
+                }
+            }
+        }
+        return frame;
+    }
+
+    double timeConversion(const HdrConverter& converter, const HdrView& src, bool toP010, int frames, ThreadPool& pool)
+    {
+        std::vector<uint8_t> sdr(static_cast<size_t>(src.width) * src.height * 4);
+        const FrameView dst(sdr.data(), src.width, src.height, src.width * 4);
+        P010Buffer p010;
+        auto run = [&] {
+            if (toP010) {
+                converter.toP010(src, p010, &pool);
+            }
+            else {
+                converter.toSdr(src, dst, &pool);
+            }
+        };
+        run();
+        const Clock::time_point start = Clock::now();
+        for (int f = 0; f < frames; f++) {
+            run();
+        }
+        return std::chrono::duration<double>(Clock::now() - start).count() * 1000.0 / frames;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    // Scalar and SSE2 run the C++ kernels, AVX2 its own
+    bool ok = true;
+    int levels = 0;
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2 }) {
+        setSimdLevel(level);
+        if (simdLevel() != level) {
+            continue;
+        }
+        ok = checkAll() && ok;
+        levels++;
+    }
+    setSimdLevel(SimdLevel::Avx2);
+    std::printf("pq, hlg and scrgb conversions %s the reference at %d SIMD levels\n\n", ok ? "match" : "differ from", levels);
+
+    ThreadPool pool(options.threads);
+    const HdrConverter::Settings settings;
+    HdrConverter converter(settings);
+    std::printf("%dx%d, %d threads\n", options.width, options.height, pool.threadCount());
+    std::printf("%-6s %-8s %12s %12s\n", "format", "output", "C++ ms", "SIMD ms");
+    for (HdrFormat format : kFormats) {
+        const Frame frame = timingFrame(options.width, options.height, format);
+        const HdrView src = frame.view();
+        for (bool toP010 : { false, true }) {
+            converter.setUseSimd(false);
+            const double plain = timeConversion(converter, src, toP010, options.frames, pool);
+            converter.setUseSimd(true);
+            const double simd = timeConversion(converter, src, toP010, options.frames, pool);
+            std::printf("%-6s %-8s %12.2f %12.2f\n", formatName(format), toP010 ? "p010" : "sdr", plain, simd);
+        }
+    }
+    return ok ? 0 : 1;
+}
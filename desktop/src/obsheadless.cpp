@@ -0,0 +1,18 @@
+#include "incl/HeadlessPipeline.h"
+#include <cstdio>
+
+int main(int argc, char* argv[])
+{
+    HeadlessConfig config;
+    std::string error;
+    if (!config.parseArgs(argc, argv, error)) {
+        if (!error.empty()) {
+            std::fprintf(stderr, "%s\n\n", error.c_str());
+        }
+        std::fputs(HeadlessConfig::usage(), error.empty() ? stdout : stderr);
+        return error.empty() ? 0 : 2;
+    }
+
+    HeadlessPipeline pipeline(config);
+    return pipeline.run();
+}
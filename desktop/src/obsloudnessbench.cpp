@@ -0,0 +1,250 @@
+// Loudness meter accuracy and speed: feeds LoudnessMeter the synthetic test signals of
+// EBU Tech 3341 (momentary, short-term and integrated loudness) and Tech 3342 (loudness
+// range) in 10 ms blocks, the way the capture delivers them, and checks the readings
+// against the tolerances those documents give. Then it times the meter on noise for
+// stereo and 5.1 and reports how many times faster than real time it runs. Exits
+// non-zero when a reading is out of tolerance.
+
+#include "incl/LoudnessMeter.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr double kPi = 3.14159265358979323846;
+    constexpr int kSampleRate = 48000;
+    constexpr int kBlockFrames = kSampleRate / 100;
+
+    // Tech 3341 allows +-0.1 LU on M, S and I; Tech 3342 allows +-1 LU on LRA
+    constexpr double kLoudnessTolerance = 0.1;
+    constexpr double kRangeTolerance = 1.0;
+
+    struct Options
+    {
+        int seconds = 600;
+    };
+
+    const char* const kUsage =
+        "usage: obs-loudness-bench [options]\n"
+        "  --seconds N   audio timed per channel layout (default: 600)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const int value = std::atoi(argv[++i]);
+            if (arg == "--seconds") {
+                options.seconds = value;
+            }
+            else {
+                return false;
+            }
+        }
+        return options.seconds > 0;
+    }
+
+    // A stretch of 1 kHz sine with a peak level per channel; -inf leaves a channel silent
+    struct Segment
+    {
+        double seconds;
+        double dbfs[LoudnessMeter::kMaxChannels];
+    };
+
+    // What a test expects; NAN means the reading isn't checked
+    struct Expected
+    {
+        double momentary = NAN;  // at the end of the signal
+        double shortTerm = NAN;  // at the end, or after every block once 3 s are in
+        bool shortTermThroughout = false;
+        double integrated = NAN;
+        double range = NAN;
+    };
+
+    struct Case
+    {
+        const char* name;
+        int channels;
+        std::vector<Segment> segments;
+        Expected expected;
+    };
+
+    Segment stereo(double seconds, double dbfs)
+    {
+        Segment segment{ seconds, {} };
+        std::fill(std::begin(segment.dbfs), std::end(segment.dbfs), -INFINITY);
+        segment.dbfs[0] = dbfs;
+        segment.dbfs[1] = dbfs;
+        return segment;
+    }
+
+    std::vector<Case> testCases()
+    {
+        std::vector<Case> cases;
+        Expected e;
+
+        // Tech 3341 cases 1 and 2: steady tones
+        e = Expected();
+        e.momentary = e.shortTerm = e.integrated = -23.0;
+        cases.push_back({ "3341-1 -23 dBFS", 2, { stereo(20.0, -23.0) }, e });
+        e.momentary = e.shortTerm = e.integrated = -33.0;
+        cases.push_back({ "3341-2 -33 dBFS", 2, { stereo(20.0, -33.0) }, e });
+
+        // Cases 3 to 5: the relative and absolute gates
+        e = Expected();
+        e.integrated = -23.0;
+        cases.push_back({ "3341-3 gating", 2, { stereo(10.0, -36.0), stereo(60.0, -23.0), stereo(10.0, -36.0) }, e });
+        cases.push_back({ "3341-4 gating", 2,
+            { stereo(10.0, -72.0), stereo(10.0, -36.0), stereo(60.0, -23.0), stereo(10.0, -36.0), stereo(10.0, -72.0) }, e });
+        cases.push_back({ "3341-5 gating", 2, { stereo(20.0, -26.0), stereo(20.1, -20.0), stereo(20.0, -26.0) }, e });
+
+        // Case 6: 5.0 channel weights (L R C Ls Rs, no LFE)
+        Segment surround{ 20.0, {} };
+        std::fill(std::begin(surround.dbfs), std::end(surround.dbfs), -INFINITY);
+        surround.dbfs[0] = surround.dbfs[1] = -28.0;
+        surround.dbfs[2] = -24.0;
+        surround.dbfs[4] = surround.dbfs[5] = -30.0;
+        cases.push_back({ "3341-6 5.0", 6, { surround }, e });
+
+        // Case 9: a 3 s cycle of loud and quiet, so every short-term window holds the same
+        e = Expected();
+        e.shortTerm = -23.0;
+        e.shortTermThroughout = true;
+        std::vector<Segment> bursts;
+        for (int i = 0; i < 20; i++) {
+            bursts.push_back(stereo(1.34, -20.0));
+            bursts.push_back(stereo(1.66, -30.0));
+        }
+        cases.push_back({ "3341-9 short-term", 2, bursts, e });
+
+        // Tech 3342 cases 1 to 4: loudness range
+        e = Expected();
+        e.range = 10.0;
+        cases.push_back({ "3342-1 LRA 10", 2, { stereo(20.0, -20.0), stereo(20.0, -30.0) }, e });
+        e.range = 5.0;
+        cases.push_back({ "3342-2 LRA 5", 2, { stereo(20.0, -20.0), stereo(20.0, -15.0) }, e });
+        e.range = 20.0;
+        cases.push_back({ "3342-3 LRA 20", 2, { stereo(20.0, -40.0), stereo(20.0, -20.0) }, e });
+        e.range = 15.0;
+        cases.push_back({ "3342-4 LRA 15", 2,
+            { stereo(20.0, -50.0), stereo(20.0, -35.0), stereo(20.0, -20.0), stereo(20.0, -35.0), stereo(20.0, -50.0) }, e });
+        return cases;
+    }
+
+    // Renders the segments back to back with a continuous phase
+    std::vector<float> render(const Case& test)
+    {
+        size_t total = 0;
+        for (const Segment& segment : test.segments) {
+            total += static_cast<size_t>(std::lround(segment.seconds * kSampleRate));
+        }
+        std::vector<float> samples(total * test.channels);
+        size_t frame = 0;
+        for (const Segment& segment : test.segments) {
+            double amplitude[LoudnessMeter::kMaxChannels];
+            for (int c = 0; c < test.channels; c++) {
+                amplitude[c] = std::pow(10.0, segment.dbfs[c] / 20.0);
+            }
+            const size_t end = frame + static_cast<size_t>(std::lround(segment.seconds * kSampleRate));
+            for (; frame < end; frame++) {
+                const double s = std::sin(2.0 * kPi * 1000.0 * frame / kSampleRate);
+                for (int c = 0; c < test.channels; c++) {
+                    samples[frame * test.channels + c] = static_cast<float>(amplitude[c] * s);
+                }
+            }
+        }
+        return samples;
+    }
+
+    bool within(double actual, double expected, double tolerance)
+    {
+        return std::isnan(expected) || std::fabs(actual - expected) <= tolerance;
+    }
+
+    // Runs one case; prints the readings and returns whether they're in tolerance
+    bool runCase(const Case& test)
+    {
+        const std::vector<float> samples = render(test);
+        const int frames = static_cast<int>(samples.size() / test.channels);
+        LoudnessMeter meter;
+        meter.configure(kSampleRate, test.channels);
+
+        double worstShortTerm = 0.0;
+        for (int frame = 0; frame < frames; frame += kBlockFrames) {
+            meter.process(samples.data() + static_cast<size_t>(frame) * test.channels, std::min(kBlockFrames, frames - frame));
+            if (test.expected.shortTermThroughout && frame + kBlockFrames >= 3 * kSampleRate) {
+                worstShortTerm = std::max(worstShortTerm, std::fabs(meter.snapshot().shortTerm - test.expected.shortTerm));
+            }
+        }
+
+        const LoudnessMeter::Snapshot& s = meter.snapshot();
+        std::printf("%-18s %9.2f %9.2f %9.2f %7.2f\n", test.name, s.momentary, s.shortTerm, s.integrated, s.range);
+
+        bool ok = within(s.momentary, test.expected.momentary, kLoudnessTolerance) &&
+                  within(s.integrated, test.expected.integrated, kLoudnessTolerance) &&
+                  within(s.range, test.expected.range, kRangeTolerance);
+        if (test.expected.shortTermThroughout) {
+            ok = ok && worstShortTerm <= kLoudnessTolerance;
+        }
+        else {
+            ok = ok && within(s.shortTerm, test.expected.shortTerm, kLoudnessTolerance);
+        }
+        if (!ok) {
+            std::printf("FAIL: %s out of tolerance (expected M %g, S %g, I %g, LRA %g)\n", test.name,
+                test.expected.momentary, test.expected.shortTerm, test.expected.integrated, test.expected.range);
+        }
+        return ok;
+    }
+
+    // Seconds of audio metered per second of wall time
+    double realtimeFactor(int channels, int seconds)
+    {
+        // One second of noise, fed over and over
+        std::vector<float> noise(static_cast<size_t>(kSampleRate) * channels);
+        uint32_t state = 1;
+        for (float& sample : noise) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            sample = static_cast<float>(static_cast<int32_t>(state)) / 2147483648.0f * 0.5f;
+        }
+
+        LoudnessMeter meter;
+        meter.configure(kSampleRate, channels);
+        const Clock::time_point start = Clock::now();
+        for (int s = 0; s < seconds; s++) {
+            for (int frame = 0; frame < kSampleRate; frame += kBlockFrames) {
+                meter.process(noise.data() + static_cast<size_t>(frame) * channels, kBlockFrames);
+            }
+        }
+        return seconds / std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    std::printf("%-18s %9s %9s %9s %7s\n", "signal", "M LUFS", "S LUFS", "I LUFS", "LRA LU");
+    bool ok = true;
+    for (const Case& test : testCases()) {
+        ok = runCase(test) && ok;
+    }
+
+    std::printf("\n%d s of noise per layout at %d Hz\n", options.seconds, kSampleRate);
+    std::printf("stereo: %.0fx real time\n", realtimeFactor(2, options.seconds));
+    std::printf("5.1:    %.0fx real time\n", realtimeFactor(6, options.seconds));
+    return ok ? 0 : 1;
+}
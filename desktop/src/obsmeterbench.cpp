@@ -0,0 +1,188 @@
+// VolumeMeter GUI cost: a window of 32 meters (by default) on the shared clock, fed
+// levels and loudness from a thread the way the audio lanes do, every 10 ms per meter.
+// Reports the GUI thread's CPU time per second and per clock tick, and the paint
+// events and repainted pixels per second, against the full widget area. Then feeds
+// one steady level and checks every meter settles on it. Exits non-zero when a meter
+// was never painted or didn't follow its level. Needs a Qt platform; under ctest it
+// runs on the offscreen one.
+
+#include "incl/VolumeMeter.h"
+#include <QApplication>
+#include <QEvent>
+#include <QPaintEvent>
+#include <QTimer>
+#include <QVBoxLayout>
+#include <QWidget>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace {
+    constexpr int kFeedPeriodMs = 10;
+    constexpr float kSettleDb = -20.0f;
+    constexpr float kSettleToleranceDb = 0.5f;
+    constexpr int kSettleMs = 1000;
+
+    struct Options
+    {
+        int meters = 32;
+        double seconds = 5.0;
+    };
+
+    const char* const kUsage =
+        "usage: obs-meter-bench [options]\n"
+        "  --meters N    meters in the window (default: 32)\n"
+        "  --seconds S   measured run time (default: 5)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const char* value = argv[++i];
+            if (arg == "--meters") {
+                options.meters = std::atoi(value);
+            }
+            else if (arg == "--seconds") {
+                options.seconds = std::atof(value);
+            }
+            else {
+                return false;
+            }
+        }
+        return options.meters > 0 && options.seconds > 0.0;
+    }
+
+    // CPU time of the calling thread, in seconds
+    double threadCpuSeconds()
+    {
+#ifdef _WIN32
+        FILETIME created, exited, kernel, user;
+        GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user);
+        const auto ticks = [](const FILETIME& t) { return (static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime; };
+        return (ticks(kernel) + ticks(user)) * 1e-7;
+#else
+        timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+    }
+
+    // Counts paint events and the pixels they cover on every meter
+    class PaintCounter : public QObject
+    {
+    public:
+        uint64_t events = 0;
+        uint64_t pixels = 0;
+        std::vector<uint64_t> perMeter;
+
+        bool eventFilter(QObject* watched, QEvent* event) override
+        {
+            if (event->type() == QEvent::Paint) {
+                const QRect rect = static_cast<QPaintEvent*>(event)->rect();
+                events++;
+                pixels += static_cast<uint64_t>(rect.width()) * rect.height();
+                perMeter[watched->property("meterIndex").toInt()]++;
+            }
+            return false;
+        }
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+    QApplication app(argc, argv);
+
+    QWidget window;
+    QVBoxLayout* layout = new QVBoxLayout(&window);
+    PaintCounter counter;
+    counter.perMeter.assign(options.meters, 0);
+    std::vector<VolumeMeter*> meters;
+    for (int i = 0; i < options.meters; i++) {
+        VolumeMeter* meter = new VolumeMeter(&window, QStringLiteral("Source %1").arg(i + 1));
+        meter->setProperty("meterIndex", i);
+        meter->installEventFilter(&counter);
+        layout->addWidget(meter);
+        meters.push_back(meter);
+    }
+    window.resize(480, 44 * options.meters);
+    window.show();
+
+    // The audio side: a different moving level per meter, then one steady level
+    std::atomic<bool> feeding{ true };
+    std::atomic<bool> settle{ false };
+    std::thread feeder([&] {
+        int block = 0;
+        while (feeding.load()) {
+            for (int i = 0; i < options.meters; i++) {
+                const float level = settle.load() ? kSettleDb
+                    : -30.0f + 25.0f * static_cast<float>(std::sin(block * 0.05 + i * 0.7));
+                meters[i]->setLevel(level);
+                meters[i]->setLoudness(level - 3.0f, -23.0f);
+            }
+            block++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(kFeedPeriodMs));
+        }
+    });
+
+    // Measure after the first layout and full paint are done
+    double cpuStart = 0.0;
+    double cpuSeconds = 0.0;
+    uint64_t eventsStart = 0;
+    uint64_t pixelsStart = 0;
+    uint64_t events = 0;
+    uint64_t pixels = 0;
+    const int measureMs = static_cast<int>(options.seconds * 1000.0);
+    QTimer::singleShot(500, &app, [&] {
+        cpuStart = threadCpuSeconds();
+        eventsStart = counter.events;
+        pixelsStart = counter.pixels;
+    });
+    QTimer::singleShot(500 + measureMs, &app, [&] {
+        cpuSeconds = threadCpuSeconds() - cpuStart;
+        events = counter.events - eventsStart;
+        pixels = counter.pixels - pixelsStart;
+        settle.store(true);
+    });
+    QTimer::singleShot(500 + measureMs + kSettleMs, &app, &QApplication::quit);
+    app.exec();
+    feeding.store(false);
+    feeder.join();
+
+    const double ticks = options.seconds * 1000.0 / 16.0;
+    const double fullPixels = static_cast<double>(meters[0]->width()) * meters[0]->height() * options.meters;
+    std::printf("%d meters, %.1f s: GUI thread %.2f%% of a core, %.1f us per clock tick\n", options.meters,
+        options.seconds, cpuSeconds / options.seconds * 100.0, cpuSeconds * 1e6 / ticks);
+    std::printf("%.0f paint events/s, %.2f Mpixel/s repainted (%.1f%% of repainting every meter every tick)\n",
+        events / options.seconds, pixels / options.seconds / 1e6, pixels / (fullPixels * ticks) * 100.0);
+
+    bool ok = true;
+    for (int i = 0; i < options.meters; i++) {
+        if (counter.perMeter[i] == 0) {
+            std::printf("FAIL: meter %d was never painted\n", i + 1);
+            ok = false;
+        }
+        if (std::fabs(meters[i]->getCurrentLevel() - kSettleDb) > kSettleToleranceDb) {
+            std::printf("FAIL: meter %d reads %.1f dB, fed %.1f dB\n", i + 1, meters[i]->getCurrentLevel(), kSettleDb);
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}
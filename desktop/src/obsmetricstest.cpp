@@ -0,0 +1,361 @@
+// MetricsServer end to end: starts the server on an ephemeral port with a registry of
+// known counters, gauges and a latency summary, scrapes /metrics over a real socket and
+// checks the HTTP response (status, Content-Type version 0.0.4, Content-Length), the
+// exposition format (one HELP and TYPE per family before its samples, valid metric and
+// label names, counters named _total, every value a number) and that every sample
+// reads what the collectors wrote, the buffer pool's included. A second collector adds
+// samples to families the first one wrote, and they must join those families' blocks
+// rather than repeat HELP and TYPE, as several devices report obs_device_losses_total.
+// Then scrapes repeatedly
+// while another thread counts, checking counters only go up, and checks the 404/405
+// answers and that stop() closes the port. Exits non-zero when a check fails.
+
+#include "incl/BufferPool.h"
+#include "incl/LatencyHistogram.h"
+#include "incl/Metrics.h"
+#include "incl/MetricsServer.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <netinet/in.h>
+#include <set>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+    struct Options
+    {
+        int scrapes = 200;
+    };
+
+    const char* const kUsage =
+        "usage: obs-metrics-test [options]\n"
+        "  --scrapes N   scrapes while a counter is running (default: 200)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const int value = std::atoi(argv[++i]);
+            if (arg == "--scrapes") {
+                options.scrapes = value;
+            }
+            else {
+                return false;
+            }
+        }
+        return options.scrapes > 0;
+    }
+
+    struct Response
+    {
+        int status = 0;
+        std::string headers;
+        std::string body;
+    };
+
+    // One request per connection, as the server expects; reads until it hangs up
+    bool request(int port, const char* text, Response& response)
+    {
+        const int s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (s < 0) {
+            return false;
+        }
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        if (connect(s, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            close(s);
+            return false;
+        }
+        send(s, text, std::strlen(text), MSG_NOSIGNAL);
+
+        std::string raw;
+        char buffer[4096];
+        ssize_t n;
+        while ((n = recv(s, buffer, sizeof(buffer), 0)) > 0) {
+            raw.append(buffer, static_cast<size_t>(n));
+        }
+        close(s);
+
+        const size_t end = raw.find("\r\n\r\n");
+        if (end == std::string::npos || std::sscanf(raw.c_str(), "HTTP/1.1 %d", &response.status) != 1) {
+            return false;
+        }
+        response.headers = raw.substr(0, end + 2);
+        response.body = raw.substr(end + 4);
+        return true;
+    }
+
+    bool validName(const std::string& name)
+    {
+        if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+            return false;
+        }
+        for (char c : name) {
+            if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_' && c != ':') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // name="value" pairs, comma separated, values escaped as the format says
+    bool validLabels(const std::string& labels)
+    {
+        size_t i = 0;
+        while (i < labels.size()) {
+            const size_t equals = labels.find('=', i);
+            if (equals == std::string::npos || !validName(labels.substr(i, equals - i)) || labels.compare(equals, 2, "=\"") != 0) {
+                return false;
+            }
+            i = equals + 2;
+            while (i < labels.size() && labels[i] != '"') {
+                i += labels[i] == '\\' ? 2 : 1;
+            }
+            if (i >= labels.size()) {
+                return false;
+            }
+            i++;
+            if (i < labels.size() && labels[i++] != ',') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Samples keyed by name{labels}, checked against the text format as they're read
+    bool parseExposition(const std::string& body, std::map<std::string, double>& samples)
+    {
+        std::map<std::string, std::string> types;
+        std::set<std::string> helped;
+        std::string family;
+        bool ok = true;
+        size_t begin = 0;
+        int lineNumber = 0;
+        while (begin < body.size()) {
+            size_t end = body.find('\n', begin);
+            if (end == std::string::npos) {
+                std::puts("FAIL: exposition does not end with a newline");
+                return false;
+            }
+            const std::string line = body.substr(begin, end - begin);
+            begin = end + 1;
+            lineNumber++;
+
+            char name[256], rest[256];
+            if (line.compare(0, 7, "# HELP ") == 0) {
+                if (std::sscanf(line.c_str() + 7, "%255s %255[^\n]", name, rest) != 2 || !helped.insert(name).second) {
+                    std::printf("FAIL: line %d: bad or repeated HELP: %s\n", lineNumber, line.c_str());
+                    ok = false;
+                }
+                continue;
+            }
+            if (line.compare(0, 7, "# TYPE ") == 0) {
+                const bool parsed = std::sscanf(line.c_str() + 7, "%255s %255s", name, rest) == 2;
+                const std::string type = parsed ? rest : "";
+                if (!parsed || types.count(name) || !helped.count(name) ||
+                    (type != "counter" && type != "gauge" && type != "summary")) {
+                    std::printf("FAIL: line %d: bad, repeated or unexplained TYPE: %s\n", lineNumber, line.c_str());
+                    ok = false;
+                }
+                types[name] = type;
+                family = name;
+                continue;
+            }
+
+            // name{labels} value
+            const size_t space = line.rfind(' ');
+            const size_t brace = line.find('{');
+            const std::string key = line.substr(0, space);
+            const std::string sampleName = line.substr(0, std::min(brace, space));
+            const std::string labels = brace < space ? line.substr(brace + 1, space - brace - 2) : "";
+            char* parsedEnd = nullptr;
+            const double value = space == std::string::npos ? 0.0 : std::strtod(line.c_str() + space + 1, &parsedEnd);
+            if (space == std::string::npos || !parsedEnd || *parsedEnd != '\0' || !validName(sampleName) ||
+                (brace < space && (line[space - 1] != '}' || !validLabels(labels)))) {
+                std::printf("FAIL: line %d: not a sample: %s\n", lineNumber, line.c_str());
+                ok = false;
+                continue;
+            }
+
+            // Samples follow their family's TYPE; summaries add _sum and _count
+            const std::string& type = types[family];
+            const bool inFamily = sampleName == family ||
+                (type == "summary" && (sampleName == family + "_sum" || sampleName == family + "_count"));
+            if (!inFamily) {
+                std::printf("FAIL: line %d: %s outside its family (after TYPE %s)\n", lineNumber, sampleName.c_str(), family.c_str());
+                ok = false;
+            }
+            if (type == "counter" && (sampleName.size() < 6 || sampleName.compare(sampleName.size() - 6, 6, "_total") != 0)) {
+                std::printf("FAIL: line %d: counter %s is not named _total\n", lineNumber, sampleName.c_str());
+                ok = false;
+            }
+            if (!samples.emplace(key, value).second) {
+                std::printf("FAIL: line %d: %s repeated\n", lineNumber, key.c_str());
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    bool scrape(int port, std::map<std::string, double>& samples)
+    {
+        Response response;
+        if (!request(port, "GET /metrics HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n", response)) {
+            std::printf("FAIL: no HTTP response from 127.0.0.1:%d\n", port);
+            return false;
+        }
+        bool ok = true;
+        if (response.status != 200) {
+            std::printf("FAIL: GET /metrics answered %d\n", response.status);
+            ok = false;
+        }
+        if (response.headers.find("Content-Type: text/plain; version=0.0.4") == std::string::npos) {
+            std::puts("FAIL: GET /metrics without the 0.0.4 text Content-Type");
+            ok = false;
+        }
+        const size_t length = response.headers.find("Content-Length: ");
+        if (length == std::string::npos || std::strtoull(response.headers.c_str() + length + 16, nullptr, 10) != response.body.size()) {
+            std::printf("FAIL: Content-Length does not match the %zu-byte body\n", response.body.size());
+            ok = false;
+        }
+        samples.clear();
+        return parseExposition(response.body, samples) && ok;
+    }
+
+    // Values print as integers or with 9 significant digits
+    bool expect(const std::map<std::string, double>& samples, const std::string& key, double expected)
+    {
+        const auto it = samples.find(key);
+        if (it == samples.end()) {
+            std::printf("FAIL: %s missing from the scrape\n", key.c_str());
+            return false;
+        }
+        if (std::fabs(it->second - expected) > std::fabs(expected) * 1e-8) {
+            std::printf("FAIL: %s reads %.9g, expected %.9g\n", key.c_str(), it->second, expected);
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    std::atomic<uint64_t> frames{ 12345 };
+    LatencyHistogram latency;
+    for (int i = 1; i <= 1000; i++) {
+        latency.record(i * 20);
+    }
+    MetricsRegistry registry;
+    MetricsRegistration registration = registry.add([&](MetricsWriter& writer) {
+        writer.counter("obs_test_frames_total", "Frames counted by the test.", static_cast<double>(frames.load()));
+        writer.counter("obs_test_drops_total", "Drops by reason.", 3, "reason=\"late\"");
+        writer.counter("obs_test_drops_total", "Drops by reason.", 4, "reason=\"queue \\\"full\\\"\"");
+        writer.gauge("obs_test_fill_ratio", "A fractional gauge.", 0.125);
+        writer.summary("obs_test_latency_seconds", "Latency of the test stage.", latency, "stage=\"test\"");
+    });
+    LatencyHistogram idle;
+    MetricsRegistration second = registry.add([&idle](MetricsWriter& writer) {
+        writer.counter("obs_test_drops_total", "Drops by reason.", 5, "reason=\"second\"");
+        writer.gauge("obs_test_second_ratio", "A gauge only the second collector writes.", 0.5);
+        writer.summary("obs_test_latency_seconds", "Latency of the test stage.", idle, "stage=\"second\"");
+        writer.counter("obs_buffer_pool_hits_total", "Pool acquires served from a free list.", 7, "pool=\"second\"");
+    });
+
+    // Some pool traffic, so its counters aren't all zero
+    { PooledBuffer block = BufferPool::instance().acquire(4096); }
+    { PooledBuffer block = BufferPool::instance().acquire(4096); }
+    const BufferPool::Stats pool = BufferPool::instance().stats();
+
+    MetricsServer server;
+    if (!server.start(0, registry) || server.port() == 0) {
+        std::printf("FAIL: MetricsServer did not start on an ephemeral port: %s\n", server.lastError().c_str());
+        return 1;
+    }
+    const int port = server.port();
+
+    std::map<std::string, double> samples;
+    bool ok = scrape(port, samples);
+    ok = expect(samples, "obs_test_frames_total", 12345) && ok;
+    ok = expect(samples, "obs_test_drops_total{reason=\"late\"}", 3) && ok;
+    ok = expect(samples, "obs_test_drops_total{reason=\"queue \\\"full\\\"\"}", 4) && ok;
+    ok = expect(samples, "obs_test_fill_ratio", 0.125) && ok;
+    ok = expect(samples, "obs_test_drops_total{reason=\"second\"}", 5) && ok;
+    ok = expect(samples, "obs_test_second_ratio", 0.5) && ok;
+    ok = expect(samples, "obs_test_latency_seconds_count{stage=\"second\"}", 0) && ok;
+    ok = expect(samples, "obs_buffer_pool_hits_total{pool=\"second\"}", 7) && ok;
+    ok = expect(samples, "obs_test_latency_seconds_count{stage=\"test\"}", 1000) && ok;
+    ok = expect(samples, "obs_test_latency_seconds_sum{stage=\"test\"}", 20.0 * 500 * 1001 / 1e6) && ok;
+    for (double q : { 0.5, 0.9, 0.99 }) {
+        char key[96];
+        std::snprintf(key, sizeof(key), "obs_test_latency_seconds{stage=\"test\",quantile=\"%g\"}", q);
+        ok = expect(samples, key, latency.quantileMicros(q) / 1e6) && ok;
+    }
+    ok = expect(samples, "obs_buffer_pool_hits_total", static_cast<double>(pool.hits)) && ok;
+    ok = expect(samples, "obs_buffer_pool_misses_total", static_cast<double>(pool.misses)) && ok;
+    ok = expect(samples, "obs_buffer_pool_allocated_bytes", static_cast<double>(pool.allocatedBytes)) && ok;
+    std::printf("scraped %zu samples from 127.0.0.1:%d\n", samples.size(), port);
+
+    // Scrapes read live values: a running counter must never go back or run ahead
+    std::atomic<bool> counting{ true };
+    std::thread counter([&] {
+        while (counting.load(std::memory_order_relaxed)) {
+            frames.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    double previous = 0.0;
+    for (int i = 0; i < options.scrapes && ok; i++) {
+        ok = scrape(port, samples);
+        const double value = samples["obs_test_frames_total"];
+        if (value < previous || value > static_cast<double>(frames.load())) {
+            std::printf("FAIL: scrape %d: obs_test_frames_total read %.0f after %.0f\n", i, value, previous);
+            ok = false;
+        }
+        previous = value;
+    }
+    counting.store(false, std::memory_order_relaxed);
+    counter.join();
+    if (ok && previous <= 12345) {
+        std::puts("FAIL: obs_test_frames_total never moved while counting");
+        ok = false;
+    }
+    std::printf("%d scrapes while counting, last read %.0f\n", options.scrapes, previous);
+
+    Response response;
+    if (!request(port, "GET /other HTTP/1.1\r\n\r\n", response) || response.status != 404) {
+        std::printf("FAIL: GET /other answered %d, expected 404\n", response.status);
+        ok = false;
+    }
+    response = Response();
+    if (!request(port, "POST /metrics HTTP/1.1\r\nContent-Length: 0\r\n\r\n", response) || response.status != 405) {
+        std::printf("FAIL: POST /metrics answered %d, expected 405\n", response.status);
+        ok = false;
+    }
+
+    server.stop();
+    if (request(port, "GET /metrics HTTP/1.1\r\n\r\n", response)) {
+        std::puts("FAIL: still answering after stop()");
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+// BufferPool against malloc: runs the allocation patterns the pipeline has — a 4K
+// frame dropped and re-created every frame, per-thread scratch rows of a few sizes,
+// and encoded packets of random size that live for a while — once through the shared
+// BufferPool and once through malloc/free, touching every page of each block as the
+// real users would. Reports ns per acquire/release pair and the pool's hit rate for
+// each pattern. Exits non-zero when a pattern's hit rate after warm-up falls below
+// 99% or a block comes back misaligned.
+
+#include "incl/BufferPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr double kMinHitRate = 0.99;
+
+    // Rounds that fill the pool before anything is timed or counted; enough for every
+    // packet size class to have seen its usual number in flight
+    constexpr int kWarmupRounds = 32;
+    constexpr size_t kPage = 4096;
+
+    struct Options
+    {
+        int iterations = 2000;
+        int threads = 4;
+    };
+
+    const char* const kUsage =
+        "usage: obs-pool-bench [options]\n"
+        "  --iterations N   rounds per pattern (default: 2000)\n"
+        "  --threads N      threads for the scratch pattern (default: 4)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const int value = std::atoi(argv[++i]);
+            if (arg == "--iterations") {
+                options.iterations = value;
+            }
+            else if (arg == "--threads") {
+                options.threads = value;
+            }
+            else {
+                return false;
+            }
+        }
+        return options.iterations > 0 && options.threads > 0;
+    }
+
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed) : m_state(seed ? seed : 1) {}
+
+        uint32_t next()
+        {
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 17;
+            m_state ^= m_state << 5;
+            return m_state;
+        }
+
+    private:
+        uint32_t m_state;
+    };
+
+    // Writes one byte per page, so fresh memory pays its page faults here
+    void touch(uint8_t* data, size_t bytes)
+    {
+        for (size_t i = 0; i < bytes; i += kPage) {
+            data[i] = static_cast<uint8_t>(i);
+        }
+        data[bytes - 1] = 1;
+    }
+
+    // The two allocators behind one interface; Block owns whichever it got
+    struct PoolAllocator
+    {
+        bool misaligned = false;
+
+        PooledBuffer acquire(size_t bytes)
+        {
+            PooledBuffer buffer = BufferPool::instance().acquire(bytes);
+            misaligned = misaligned || reinterpret_cast<uintptr_t>(buffer.data()) % BufferPool::kAlignment != 0;
+            touch(buffer.data(), bytes);
+            return buffer;
+        }
+    };
+
+    struct MallocBlock
+    {
+        uint8_t* data = nullptr;
+
+        MallocBlock() = default;
+        explicit MallocBlock(size_t bytes) : data(static_cast<uint8_t*>(std::malloc(bytes))) { touch(data, bytes); }
+        MallocBlock(MallocBlock&& other) noexcept : data(other.data) { other.data = nullptr; }
+        MallocBlock& operator=(MallocBlock&& other) noexcept
+        {
+            std::swap(data, other.data);
+            return *this;
+        }
+        ~MallocBlock() { std::free(data); }
+    };
+
+    struct MallocAllocator
+    {
+        bool misaligned = false;
+        MallocBlock acquire(size_t bytes) { return MallocBlock(bytes); }
+    };
+
+    struct Result
+    {
+        double poolNs = 0.0;
+        double mallocNs = 0.0;
+        double hitRate = 0.0; // after warm-up
+    };
+
+    // Runs pattern(allocator, rounds) for both allocators after the same warm-up
+    template <typename Pattern>
+    Result measure(Pattern pattern, int iterations, int operationsPerRound, bool& misaligned)
+    {
+        const double operations = static_cast<double>(iterations) * operationsPerRound;
+        Result result;
+        PoolAllocator pool;
+        pattern(pool, kWarmupRounds);
+        const BufferPool::Stats before = BufferPool::instance().stats();
+        Clock::time_point start = Clock::now();
+        pattern(pool, iterations);
+        result.poolNs = std::chrono::duration<double>(Clock::now() - start).count() * 1e9 / operations;
+        const BufferPool::Stats after = BufferPool::instance().stats();
+        const double hits = static_cast<double>(after.hits - before.hits);
+        result.hitRate = hits / std::max(1.0, hits + static_cast<double>(after.misses - before.misses));
+        misaligned = misaligned || pool.misaligned;
+
+        MallocAllocator heap;
+        pattern(heap, kWarmupRounds);
+        start = Clock::now();
+        pattern(heap, iterations);
+        result.mallocNs = std::chrono::duration<double>(Clock::now() - start).count() * 1e9 / operations;
+        return result;
+    }
+
+    // A 3840x2160 BGRA frame, created and dropped every frame
+    constexpr size_t kFrameBytes = size_t(3840) * 2160 * 4;
+
+    struct FramePattern
+    {
+        template <typename Allocator>
+        void operator()(Allocator& allocator, int rounds) const
+        {
+            for (int i = 0; i < rounds; i++) {
+                auto frame = allocator.acquire(kFrameBytes);
+            }
+        }
+    };
+
+    // Each thread takes scratch rows for a 4K strip (a BGRA row, a float RGB row and a
+    // P010 row pair) and hands them back, the way the conversion kernels do
+    struct ScratchPattern
+    {
+        int threads;
+
+        template <typename Allocator>
+        void operator()(Allocator& allocator, int rounds) const
+        {
+            std::vector<std::thread> workers;
+            std::vector<Allocator> allocators(threads, allocator);
+            for (int t = 0; t < threads; t++) {
+                workers.emplace_back([&, t] {
+                    for (int i = 0; i < rounds; i++) {
+                        for (int strip = 0; strip < 16; strip++) {
+                            auto bgra = allocators[t].acquire(3840 * 4);
+                            auto rgb = allocators[t].acquire(3840 * 3 * 4);
+                            auto p010 = allocators[t].acquire(3840 * 2 * 2);
+                        }
+                    }
+                });
+            }
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+            for (const Allocator& a : allocators) {
+                allocator.misaligned = allocator.misaligned || a.misaligned;
+            }
+        }
+    };
+
+    // Encoded packets between 1 KB and 256 KB, each kept until 32 more have been made,
+    // like the RTMP send queue
+    struct PacketPattern
+    {
+        static constexpr int kInFlight = 32;
+        static constexpr int kPerRound = 64;
+
+        // Carries on across calls, so timed rounds don't replay the warm-up's sizes
+        mutable Random random{ 7 };
+
+        template <typename Allocator>
+        void operator()(Allocator& allocator, int rounds) const
+        {
+            using Block = decltype(allocator.acquire(0));
+            std::vector<Block> queue(kInFlight);
+            for (int i = 0; i < rounds * kPerRound; i++) {
+                const size_t bytes = 1024 + random.next() % (255 * 1024);
+                queue[i % kInFlight] = allocator.acquire(bytes);
+            }
+        }
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    struct Row
+    {
+        const char* name;
+        Result result;
+    };
+    bool misaligned = false;
+    const Row rows[] = {
+        { "4K frame", measure(FramePattern(), std::max(1, options.iterations / 20), 1, misaligned) },
+        { "scratch rows", measure(ScratchPattern{ options.threads }, options.iterations, 16 * 3 * options.threads, misaligned) },
+        { "packets", measure(PacketPattern(), options.iterations, PacketPattern::kPerRound, misaligned) },
+    };
+
+    std::printf("%-14s %12s %12s %10s %10s\n", "pattern", "pool ns/op", "malloc ns/op", "speedup", "hit rate");
+    bool ok = !misaligned;
+    for (const Row& row : rows) {
+        std::printf("%-14s %12.0f %12.0f %9.1fx %9.2f%%\n", row.name, row.result.poolNs, row.result.mallocNs,
+            row.result.mallocNs / row.result.poolNs, row.result.hitRate * 100.0);
+        if (row.result.hitRate < kMinHitRate) {
+            std::printf("FAIL: %s: hit rate %.2f%% after warm-up\n", row.name, row.result.hitRate * 100.0);
+            ok = false;
+        }
+    }
+    if (misaligned) {
+        std::printf("FAIL: a pooled block was not %zu-byte aligned\n", BufferPool::kAlignment);
+    }
+
+    const BufferPool::Stats stats = BufferPool::instance().stats();
+    std::printf("pool owns %.1f MB, %.1f MB of it on the shared free lists\n", stats.allocatedBytes / 1e6, stats.cachedBytes / 1e6);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,465 @@
+// Device-loss benchmark: a synthetic video source and an audio device that go away on
+// a schedule and take a while (and a few failed attempts) to come back, driven on a
+// fixed cadence. The video runs once with the reinit inline on the capture tick, as
+// ScreenCapture used to, and once through RecoveringSource, then DeviceRecovery is
+// stopped in the middle of outages. Exits non-zero if the background recovery leaves
+// a tick without a frame, spends over half a period in a tick, lets more than a period
+// and 2 ms pass between frames, touches a device while it is being reinitialized, lets
+// the audio timeline drift, or doesn't pick an outage back up after stop(). The gap is
+// taken less the tick's own late wake-up, which is the OS scheduler's and not the
+// source's; the raw gap and the latest wake-up are reported next to it.
+
+#include "incl/DeviceRecovery.h"
+#include "incl/LatencyHistogram.h"
+#include "incl/RecoveringSource.h"
+#include "incl/SyntheticSource.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr int64_t kJitterUs = 2000; // a frame may come this much past its period
+
+    struct Options
+    {
+        double seconds = 4.0;
+        int fps = 60;
+        int width = 1280;
+        int height = 720;
+        int loseEveryMs = 1000; // of running time between losses
+        int initMs = 120;       // each reinit attempt
+        int failAttempts = 2;   // attempts that fail before one succeeds
+        int audioRate = 48000;
+        int audioPeriodMs = 10;
+    };
+
+    const char* const kUsage =
+        "usage: obs-recovery-bench [options]\n"
+        "  --seconds S        run time per mode (default: 4)\n"
+        "  --fps N            capture cadence (default: 60)\n"
+        "  --size WxH         synthetic video size (default: 1280x720)\n"
+        "  --lose-every MS    running time between device losses (default: 1000)\n"
+        "  --init-ms MS       time each reinit attempt takes (default: 120)\n"
+        "  --fail-attempts N  attempts that fail before the device comes back (default: 2)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--seconds") {
+                options.seconds = std::atof(value.c_str());
+            }
+            else if (arg == "--size") {
+                if (std::sscanf(value.c_str(), "%dx%d", &options.width, &options.height) != 2 ||
+                    options.width <= 0 || options.height <= 0) {
+                    return false;
+                }
+            }
+            else if (arg == "--fps" || arg == "--lose-every" || arg == "--init-ms" || arg == "--fail-attempts") {
+                const int number = std::atoi(value.c_str());
+                (arg == "--fps" ? options.fps : arg == "--lose-every" ? options.loseEveryMs :
+                    arg == "--init-ms" ? options.initMs : options.failAttempts) = number;
+            }
+            else {
+                return false;
+            }
+        }
+        return options.seconds > 0.0 && options.fps > 0 && options.loseEveryMs > 0 && options.initMs >= 0 &&
+            options.failAttempts >= 0;
+    }
+
+    int64_t microsBetween(Clock::time_point a, Clock::time_point b)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(b - a).count();
+    }
+
+    // Synthetic frames until the scheduled loss; then every reinit takes initMs and the
+    // first failAttempts of them fail. Counts any call that reaches it while lost or
+    // while an init is running, which RecoveringSource must never let happen.
+    class FaultySource : public VideoSource
+    {
+    public:
+        FaultySource(const SyntheticSource::Settings& settings, const Options& options)
+            : m_inner(settings), m_options(options)
+        {
+        }
+
+        const char* name() const override { return "faulty synthetic"; }
+
+        bool initialize() override
+        {
+            if (m_initializing.exchange(true)) {
+                m_violations++;
+            }
+            bool ok = true;
+            if (m_started) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(m_options.initMs));
+                ok = m_failures++ >= m_options.failAttempts;
+            }
+            else {
+                ok = m_inner.initialize();
+            }
+            if (ok) {
+                m_started = true;
+                m_failures = 0;
+                m_lost.store(false);
+                m_runningSince = Clock::now();
+            }
+            else {
+                m_error = "injected init failure";
+            }
+            m_initializing.store(false);
+            return ok;
+        }
+
+        bool acquireFrame(SourceFrame& frame) override
+        {
+            if (m_initializing.load() || m_lost.load()) {
+                m_violations++;
+                return false;
+            }
+            if (Clock::now() - m_runningSince >= std::chrono::milliseconds(m_options.loseEveryMs)) {
+                m_lost.store(true);
+                m_error = "injected device loss";
+                return false;
+            }
+            return m_inner.acquireFrame(frame);
+        }
+
+        bool isLost() const override { return m_lost.load(); }
+        uint64_t violations() const { return m_violations.load(); }
+
+    private:
+        SyntheticSource m_inner;
+        const Options& m_options;
+        bool m_started = false;
+        int m_failures = 0;
+        Clock::time_point m_runningSince;
+        std::atomic<bool> m_lost{ false };
+        std::atomic<bool> m_initializing{ false };
+        std::atomic<uint64_t> m_violations{ 0 };
+    };
+
+    struct VideoResult
+    {
+        uint64_t ticks = 0;
+        uint64_t live = 0;
+        uint64_t held = 0;
+        uint64_t missing = 0; // ticks that produced no frame
+        int64_t maxAcquireUs = 0;
+        int64_t maxGapUs = 0;    // between consecutive output frames
+        int64_t maxLateUs = 0;   // the OS waking a tick after its slot
+        int64_t maxPacedUs = 0;  // gap less the tick's own late wake-up
+        uint64_t losses = 0;
+        uint64_t recoveries = 0;
+        uint64_t violations = 0;
+        LatencyHistogram acquire;
+    };
+
+    void runVideo(const Options& options, bool background, VideoResult& result)
+    {
+        SyntheticSource::Settings settings;
+        settings.width = options.width;
+        settings.height = options.height;
+        settings.fps = options.fps;
+        auto faulty = std::make_unique<FaultySource>(settings, options);
+        FaultySource* device = faulty.get();
+
+        DeviceRecovery::Settings recoverySettings;
+        recoverySettings.name = "video";
+        recoverySettings.initialBackoffMs = 20;
+        RecoveringSource recovering(std::move(faulty), recoverySettings);
+        VideoSource& source = background ? static_cast<VideoSource&>(recovering) : *device;
+        if (!source.initialize()) {
+            std::fprintf(stderr, "source failed to start: %s\n", source.lastError().c_str());
+            return;
+        }
+
+        const auto period = std::chrono::microseconds(1000000 / options.fps);
+        const Clock::time_point start = Clock::now();
+        const Clock::time_point end = start + std::chrono::microseconds(static_cast<int64_t>(options.seconds * 1e6));
+        Clock::time_point next = start;
+        Clock::time_point lastOutput = start;
+        while (Clock::now() < end) {
+            const Clock::time_point tickStart = Clock::now();
+            const int64_t lateUs = std::max<int64_t>(0, microsBetween(next, tickStart));
+            result.maxLateUs = std::max(result.maxLateUs, lateUs);
+            SourceFrame frame;
+            bool produced = source.acquireFrame(frame);
+            if (!produced && !background && device->isLost()) {
+                // What the capture tick used to do: reinit right here, one attempt per tick
+                result.losses++;
+                while (!device->initialize() && Clock::now() < end) {
+                }
+                result.recoveries++;
+                produced = source.acquireFrame(frame);
+            }
+            const Clock::time_point after = Clock::now();
+
+            const int64_t acquireUs = microsBetween(tickStart, after);
+            result.acquire.record(acquireUs);
+            result.maxAcquireUs = std::max(result.maxAcquireUs, acquireUs);
+            result.ticks++;
+            if (produced) {
+                (frame.held ? result.held : result.live)++;
+                const int64_t gapUs = microsBetween(lastOutput, after);
+                result.maxGapUs = std::max(result.maxGapUs, gapUs);
+                result.maxPacedUs = std::max(result.maxPacedUs, gapUs - lateUs);
+                lastOutput = after;
+            }
+            else {
+                result.missing++;
+            }
+
+            next += period;
+            if (next < after) {
+                next = after;
+            }
+            std::this_thread::sleep_until(next);
+        }
+
+        if (background) {
+            result.losses = recovering.recovery().losses();
+            result.recoveries = recovering.recovery().recoveries();
+        }
+        result.violations = device->violations();
+    }
+
+    struct AudioResult
+    {
+        uint64_t deviceFrames = 0;
+        uint64_t silenceFrames = 0;
+        uint64_t expectedFrames = 0;
+        int64_t maxGapUs = 0; // between ticks that delivered audio
+        uint64_t losses = 0;
+        uint64_t recoveries = 0;
+    };
+
+    // The audio lane: every period it takes what the device has (by the clock, like a
+    // WASAPI buffer) or, while the device is lost, what DeviceRecovery says is due as silence
+    void runAudio(const Options& options, AudioResult& result)
+    {
+        DeviceRecovery::Settings settings;
+        settings.name = "audio";
+        settings.initialBackoffMs = 20;
+        DeviceRecovery recovery(settings);
+        std::atomic<int> failures{ 0 };
+
+        const Clock::time_point start = Clock::now();
+        const Clock::time_point end = start + std::chrono::microseconds(static_cast<int64_t>(options.seconds * 1e6));
+        Clock::time_point deviceSince = start;
+        uint64_t deviceTaken = 0;
+        Clock::time_point next = start;
+        Clock::time_point lastOutput = start;
+        Clock::time_point now = start;
+        // Half a loss interval out of step with the video
+        Clock::time_point loseAt = start + std::chrono::milliseconds(options.loseEveryMs / 2);
+
+        while ((now = Clock::now()) < end) {
+            uint64_t delivered = 0;
+            bool running = true;
+            if (recovery.isRecovering()) {
+                const int silence = recovery.fallbackFramesDue(options.audioRate, options.audioRate);
+                result.silenceFrames += silence;
+                delivered += silence;
+                running = recovery.poll();
+                if (running) {
+                    deviceSince = Clock::now();
+                    deviceTaken = 0;
+                    loseAt = deviceSince + std::chrono::milliseconds(options.loseEveryMs);
+                }
+            }
+            if (running) {
+                const Clock::time_point at = Clock::now();
+                const uint64_t due = static_cast<uint64_t>(microsBetween(deviceSince, at)) * options.audioRate / 1000000;
+                result.deviceFrames += due - deviceTaken;
+                delivered += due - deviceTaken;
+                deviceTaken = due;
+                if (at >= loseAt) {
+                    failures = 0;
+                    recovery.reportLost([&options, &failures](std::string& error) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(options.initMs));
+                        if (failures++ < options.failAttempts) {
+                            error = "injected init failure";
+                            return false;
+                        }
+                        return true;
+                    }, "injected device loss");
+                }
+            }
+            if (delivered > 0) {
+                result.maxGapUs = std::max(result.maxGapUs, microsBetween(lastOutput, now));
+                lastOutput = now;
+            }
+
+            next += std::chrono::milliseconds(options.audioPeriodMs);
+            std::this_thread::sleep_until(next);
+        }
+        recovery.stop();
+        result.expectedFrames = static_cast<uint64_t>(microsBetween(start, lastOutput)) * options.audioRate / 1000000;
+        result.losses = recovery.losses();
+        result.recoveries = recovery.recoveries();
+    }
+
+    // Calls done() until it returns true, for a few seconds at most
+    template <typename Done>
+    bool waitFor(Done done)
+    {
+        const Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+        while (!done()) {
+            if (Clock::now() >= deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    // stop() during an outage, as when capture is stopped and restarted with the device
+    // gone: while attempts are failing the device must stay lost, and the driving
+    // thread's next poll() must restart them with the same reinit; after one succeeded
+    // the device must still be handed back by poll()
+    bool checkStopDuringOutage(const Options& options)
+    {
+        DeviceRecovery::Settings settings;
+        settings.name = "stop test";
+        settings.initialBackoffMs = 20;
+        DeviceRecovery recovery(settings);
+        std::atomic<int> attempts{ 0 };
+        std::atomic<bool> deviceBack{ false };
+        const auto reinit = [&options, &attempts, &deviceBack](std::string& error) {
+            attempts++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(options.initMs / 4));
+            if (!deviceBack.load()) {
+                error = "injected init failure";
+                return false;
+            }
+            return true;
+        };
+
+        bool ok = true;
+        recovery.reportLost(reinit, "injected device loss");
+        waitFor([&] { return attempts.load() > 0; });
+        recovery.stop();
+        if (recovery.state() != DeviceRecovery::State::Stopped || recovery.fallbackFramesDue(48000, 48000) != 0) {
+            std::puts("FAIL: stop() during a failing attempt did not leave the device lost and stopped");
+            ok = false;
+        }
+        const int attemptsAtStop = attempts.load();
+        if (recovery.poll() || recovery.state() != DeviceRecovery::State::Recovering ||
+            !waitFor([&] { return attempts.load() > attemptsAtStop; })) {
+            std::puts("FAIL: poll() after stop() did not restart the attempts");
+            ok = false;
+        }
+        deviceBack = true;
+        if (!waitFor([&] { return recovery.poll(); }) || recovery.losses() != 1 || recovery.recoveries() != 1) {
+            std::puts("FAIL: the device did not come back after its recovery was stopped and restarted");
+            ok = false;
+        }
+
+        recovery.reportLost(reinit, "injected device loss");
+        waitFor([&] { return recovery.state() == DeviceRecovery::State::Recovered; });
+        recovery.stop();
+        if (recovery.state() != DeviceRecovery::State::Recovered || !recovery.poll() || recovery.recoveries() != 2) {
+            std::puts("FAIL: stop() after a successful attempt did not leave the device for poll()");
+            ok = false;
+        }
+        std::printf("stop during an outage: %llu losses, %llu back\n", static_cast<unsigned long long>(recovery.losses()),
+            static_cast<unsigned long long>(recovery.recoveries()));
+        return ok;
+    }
+
+    void printVideo(const char* mode, const VideoResult& result)
+    {
+        std::printf("%-22s %6llu %6llu %6llu %7llu %9.2f %9.2f %9.2f %6llu/%llu\n", mode,
+            static_cast<unsigned long long>(result.ticks), static_cast<unsigned long long>(result.live),
+            static_cast<unsigned long long>(result.held), static_cast<unsigned long long>(result.missing),
+            result.acquire.quantileMicros(0.99) / 1000.0, result.maxAcquireUs / 1000.0, result.maxGapUs / 1000.0,
+            static_cast<unsigned long long>(result.recoveries), static_cast<unsigned long long>(result.losses));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    std::printf("device lost every %d ms of running time, reinit %d ms per attempt, %d failing attempts first\n\n",
+        options.loseEveryMs, options.initMs, options.failAttempts);
+    std::printf("video %dx%d at %d fps\n", options.width, options.height, options.fps);
+    std::printf("%-22s %6s %6s %6s %7s %9s %9s %9s %8s\n", "mode", "ticks", "live", "held", "missing",
+        "p99 ms", "max ms", "max gap", "back/lost");
+
+    VideoResult inlineResult;
+    runVideo(options, false, inlineResult);
+    printVideo("reinit on the tick", inlineResult);
+
+    // Audio runs alongside, as it does in the app
+    VideoResult background;
+    AudioResult audio;
+    std::thread audioThread([&] { runAudio(options, audio); });
+    runVideo(options, true, background);
+    audioThread.join();
+    printVideo("background recovery", background);
+    std::printf("latest wake-up %.1f ms after its slot, largest gap less that %.1f ms\n", background.maxLateUs / 1000.0,
+        background.maxPacedUs / 1000.0);
+
+    std::printf("\naudio %d Hz, %d ms lane: %llu device + %llu silence frames of %llu expected, max gap %.1f ms, %llu/%llu back\n\n",
+        options.audioRate, options.audioPeriodMs, static_cast<unsigned long long>(audio.deviceFrames),
+        static_cast<unsigned long long>(audio.silenceFrames), static_cast<unsigned long long>(audio.expectedFrames),
+        audio.maxGapUs / 1000.0, static_cast<unsigned long long>(audio.recoveries), static_cast<unsigned long long>(audio.losses));
+
+    // A frame every tick, no tick waiting on a reinit, no device touched while it was
+    // being brought back, and the audio timeline without a hole
+    const int64_t periodUs = 1000000 / options.fps;
+    bool ok = checkStopDuringOutage(options);
+    if (background.losses == 0) {
+        std::printf("FAIL: no device loss happened; run longer than --lose-every\n");
+        ok = false;
+    }
+    if (background.missing > 0) {
+        std::printf("FAIL: %llu ticks without a frame\n", static_cast<unsigned long long>(background.missing));
+        ok = false;
+    }
+    if (background.maxAcquireUs > periodUs / 2) {
+        std::printf("FAIL: a tick spent %.1f ms in the source, over half the %.1f ms period\n",
+            background.maxAcquireUs / 1000.0, periodUs / 1000.0);
+        ok = false;
+    }
+    if (background.maxPacedUs > periodUs + kJitterUs) {
+        std::printf("FAIL: %.1f ms between frames after a late wake-up, over the %.1f ms period and %.1f ms\n",
+            background.maxPacedUs / 1000.0, periodUs / 1000.0, kJitterUs / 1000.0);
+        ok = false;
+    }
+    if (background.violations > 0) {
+        std::printf("FAIL: the device was used %llu times while lost or reinitializing\n",
+            static_cast<unsigned long long>(background.violations));
+        ok = false;
+    }
+    const uint64_t audioOut = audio.deviceFrames + audio.silenceFrames;
+    const uint64_t slack = static_cast<uint64_t>(options.audioRate) * options.audioPeriodMs / 1000;
+    if (audioOut + slack < audio.expectedFrames || audioOut > audio.expectedFrames + slack) {
+        std::printf("FAIL: audio timeline off by %lld frames\n",
+            static_cast<long long>(audioOut) - static_cast<long long>(audio.expectedFrames));
+        ok = false;
+    }
+    if (audio.maxGapUs > options.audioPeriodMs * 3000) {
+        std::printf("FAIL: audio stalled for %.1f ms\n", audio.maxGapUs / 1000.0);
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
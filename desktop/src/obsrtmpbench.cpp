@@ -0,0 +1,785 @@
+// RTMP output against an in-process server on loopback. The server speaks enough RTMP
+// to take a publish, reads at a limited rate like a `tc tbf` shaped link, and checks
+// what arrives: every audio packet in order, and no video frame whose references were
+// dropped. A synthetic encoder feeds H.264-shaped GOPs (I, then P and B frames) and AAC-
+// sized audio in real time. Runs on a clear link, on a throttled link at a fixed
+// bitrate, on the same link with the encoder following the output's bitrate hint, and
+// with the throttle lifting halfway. Exits non-zero if audio is lost, a frame arrives undecodable,
+// drops don't go disposable-first, the queue outgrows its bound or the hint doesn't
+// track the link.
+
+#include "incl/Amf0.h"
+#include "incl/Flv.h"
+#include "incl/RtmpOutput.h"
+#include "incl/RtmpProtocol.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <netinet/in.h>
+#include <string>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        double seconds = 6.0; // per throttled run, long enough for the hint to settle; the clear run takes half
+        int videoKbps = 6000;
+        int audioKbps = 160;
+        int linkKbps = 3500;
+        int fps = 30;
+        double gopSeconds = 2.0;
+        std::string dump; // .flv of what the server received in the last run
+    };
+
+    const char* const kUsage =
+        "usage: obs-rtmp-bench [options]\n"
+        "  --seconds S        length of each throttled run, at least 4 (default: 6)\n"
+        "  --video-kbps N     encoder bitrate and hint ceiling (default: 6000)\n"
+        "  --audio-kbps N     audio bitrate (default: 160)\n"
+        "  --link-kbps N      throttled link rate (default: 3500)\n"
+        "  --fps N            video frame rate (default: 30)\n"
+        "  --gop S            keyframe interval in seconds (default: 2)\n"
+        "  --dump FILE        write what the server received in the last run as FLV\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--seconds" || arg == "--gop") {
+                (arg == "--seconds" ? options.seconds : options.gopSeconds) = std::atof(value.c_str());
+            }
+            else if (arg == "--video-kbps" || arg == "--audio-kbps" || arg == "--link-kbps" || arg == "--fps") {
+                const int number = std::atoi(value.c_str());
+                (arg == "--video-kbps" ? options.videoKbps : arg == "--audio-kbps" ? options.audioKbps :
+                    arg == "--link-kbps" ? options.linkKbps : options.fps) = number;
+            }
+            else if (arg == "--dump") {
+                options.dump = value;
+            }
+            else {
+                return false;
+            }
+        }
+        return options.seconds >= 4.0 && options.videoKbps > 0 && options.audioKbps > 0 && options.linkKbps > 0 &&
+            options.fps > 0 && options.gopSeconds > 0.0;
+    }
+
+    // What the synthetic encoder puts at the start of every packet, so the server can
+    // tell what it got: audio carries its sequence number, video its frame number and
+    // the frames it references (-1 for none)
+    struct VideoTag
+    {
+        int32_t frame;
+        int32_t priority;
+        int32_t references[2];
+    };
+
+    struct Received
+    {
+        bool published = false;
+        bool metadata = false;
+        bool unpublished = false;
+        bool pong = false;
+        std::string app;
+        std::string key;
+        std::string error;
+        uint64_t bytes = 0;
+        uint64_t audio = 0;
+        uint64_t audioGaps = 0;   // sequence numbers skipped or out of order
+        uint64_t video = 0;
+        uint64_t keyframes = 0;
+        uint64_t undecodable = 0; // frames that arrived after a frame they reference was dropped
+        uint64_t backwards = 0;   // timestamps going back within audio or video
+        std::vector<uint8_t> flv;
+    };
+
+    // One publisher at a time on 127.0.0.1, reading no faster than the link rate. The
+    // receive buffer is kept small so the limit reaches the sender quickly, as it would
+    // through a shaped router.
+    class LoopbackServer
+    {
+    public:
+        ~LoopbackServer() { stop(); }
+
+        bool start(bool dump)
+        {
+            m_listen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (m_listen < 0) {
+                return false;
+            }
+            int reuse = 1;
+            setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            int buffer = kReceiveBufferBytes;
+            setsockopt(m_listen, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+            sockaddr_in address;
+            std::memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (bind(m_listen, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(m_listen, 1) != 0) {
+                close(m_listen);
+                return false;
+            }
+            socklen_t length = sizeof(address);
+            getsockname(m_listen, reinterpret_cast<sockaddr*>(&address), &length);
+            m_port = ntohs(address.sin_port);
+            m_dump = dump;
+            m_thread = std::thread(&LoopbackServer::run, this);
+            return true;
+        }
+
+        void stop()
+        {
+            if (m_thread.joinable()) {
+                m_stopping.store(true);
+                m_thread.join();
+                close(m_listen);
+            }
+        }
+
+        int port() const { return m_port; }
+        void setRateKbps(int kbps) { m_rateKbps.store(kbps); } // 0 = as fast as it comes
+        const Received& received() const { return m_received; } // after stop()
+
+    private:
+        static constexpr int kReceiveBufferBytes = 32 * 1024;
+        static constexpr int kBurstBytes = 16 * 1024; // of the token bucket
+
+        void run()
+        {
+            int client = -1;
+            while (client < 0 && !m_stopping.load()) {
+                if (waitReadable(m_listen, 50)) {
+                    client = accept(m_listen, nullptr, nullptr);
+                }
+            }
+            if (client < 0) {
+                return;
+            }
+            if (m_dump) {
+                Flv::writeFileHeader(m_received.flv, true, true);
+            }
+            serve(client);
+            close(client);
+        }
+
+        static bool waitReadable(int s, int timeoutMs)
+        {
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(s, &readable);
+            timeval timeout{ 0, timeoutMs * 1000 };
+            return select(s + 1, &readable, nullptr, nullptr, &timeout) > 0;
+        }
+
+        bool readExact(int s, uint8_t* data, size_t size)
+        {
+            while (size > 0 && !m_stopping.load()) {
+                if (!waitReadable(s, 50)) {
+                    continue;
+                }
+                const ssize_t n = recv(s, data, size, 0);
+                if (n <= 0) {
+                    return false;
+                }
+                data += n;
+                size -= n;
+            }
+            return size == 0;
+        }
+
+        void send(int s, uint32_t chunkStream, uint8_t type, uint32_t streamId, const std::vector<uint8_t>& payload)
+        {
+            m_out.clear();
+            m_writer.write(m_out, chunkStream, type, streamId, 0, payload);
+            ::send(s, m_out.data(), m_out.size(), MSG_NOSIGNAL);
+        }
+
+        void sendControl(int s, uint8_t type, uint32_t value, int extra = -1)
+        {
+            std::vector<uint8_t> payload(extra < 0 ? 4 : 5);
+            Rtmp::putBig32(payload.data(), value);
+            if (extra >= 0) {
+                payload[4] = static_cast<uint8_t>(extra);
+            }
+            send(s, Rtmp::ControlChunks, type, 0, payload);
+        }
+
+        void sendStatus(int s, const char* name, double transaction, const char* code, uint32_t streamId)
+        {
+            std::vector<uint8_t> payload;
+            Amf0::writeString(payload, name);
+            Amf0::writeNumber(payload, transaction);
+            Amf0::writeNull(payload);
+            Amf0::beginObject(payload);
+            Amf0::writeKey(payload, "level");
+            Amf0::writeString(payload, "status");
+            Amf0::writeKey(payload, "code");
+            Amf0::writeString(payload, code);
+            Amf0::writeKey(payload, "description");
+            Amf0::writeString(payload, code);
+            Amf0::endObject(payload);
+            send(s, Rtmp::CommandChunks, Rtmp::CommandMessage, streamId, payload);
+        }
+
+        void serve(int s)
+        {
+            uint8_t hello[1 + Rtmp::kHandshakeBytes];
+            if (!readExact(s, hello, sizeof(hello))) {
+                m_received.error = "no handshake";
+                return;
+            }
+            std::vector<uint8_t> answer(1 + 2 * Rtmp::kHandshakeBytes);
+            answer[0] = Rtmp::kVersion;
+            Rtmp::fillHandshake(answer.data() + 1, 1);
+            std::memcpy(answer.data() + 1 + Rtmp::kHandshakeBytes, hello + 1, Rtmp::kHandshakeBytes);
+            ::send(s, answer.data(), answer.size(), MSG_NOSIGNAL);
+            if (!readExact(s, hello, Rtmp::kHandshakeBytes)) {
+                m_received.error = "no C2";
+                return;
+            }
+
+            RtmpChunkReader reader;
+            Rtmp::Message message;
+            std::vector<uint8_t> buffer(64 * 1024);
+            double tokens = kBurstBytes;
+            Clock::time_point refilled = Clock::now();
+            while (!m_stopping.load()) {
+                // Token bucket: take at most what the link rate has earned since the last read
+                size_t budget = buffer.size();
+                const int rate = m_rateKbps.load();
+                if (rate > 0) {
+                    const Clock::time_point now = Clock::now();
+                    tokens = std::min<double>(kBurstBytes,
+                        tokens + std::chrono::duration<double>(now - refilled).count() * rate * 125.0);
+                    refilled = now;
+                    if (tokens < 1024) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                        continue;
+                    }
+                    budget = std::min(budget, static_cast<size_t>(tokens));
+                }
+                if (!waitReadable(s, 20)) {
+                    continue;
+                }
+                const ssize_t n = recv(s, buffer.data(), budget, 0);
+                if (n <= 0) {
+                    break;
+                }
+                tokens -= n;
+                m_received.bytes += n;
+                reader.append(buffer.data(), n);
+                while (reader.next(message)) {
+                    handle(s, message);
+                }
+                if (reader.failed()) {
+                    m_received.error = "chunk stream: " + reader.error();
+                    break;
+                }
+            }
+        }
+
+        void handle(int s, const Rtmp::Message& message)
+        {
+            const std::vector<uint8_t>& payload = message.payload;
+            if (message.type == Rtmp::UserControl && payload.size() >= 2 && payload[1] == Rtmp::PingResponse) {
+                m_received.pong = true;
+            }
+            else if (message.type == Rtmp::CommandMessage) {
+                command(s, message);
+            }
+            else if (message.type == Rtmp::DataMessage) {
+                Amf0Reader reader(payload.data(), payload.size());
+                std::string name;
+                m_received.metadata = reader.readString(name) && name == "@setDataFrame";
+                if (m_dump && m_received.metadata) {
+                    Flv::writeTag(m_received.flv, Flv::ScriptTag, 0, payload.data() + 16, payload.size() - 16);
+                }
+            }
+            else if (message.type == Rtmp::AudioMessage) {
+                audio(message);
+            }
+            else if (message.type == Rtmp::VideoMessage) {
+                video(message);
+            }
+        }
+
+        void command(int s, const Rtmp::Message& message)
+        {
+            Amf0Reader reader(message.payload.data(), message.payload.size());
+            std::string name;
+            double transaction = 0;
+            if (!reader.readString(name) || !reader.readNumber(transaction)) {
+                m_received.error = "unreadable command";
+                return;
+            }
+            if (name == "connect") {
+                std::vector<std::pair<std::string, std::string>> properties;
+                reader.readObject(properties);
+                for (const auto& property : properties) {
+                    if (property.first == "app") {
+                        m_received.app = property.second;
+                    }
+                }
+                sendControl(s, Rtmp::WindowAckSize, 2500000);
+                sendControl(s, Rtmp::SetPeerBandwidth, 2500000, 2);
+                sendControl(s, Rtmp::SetChunkSize, 4096);
+                m_writer.setChunkSize(4096);
+                sendStatus(s, "_result", transaction, "NetConnection.Connect.Success", 0);
+            }
+            else if (name == "createStream") {
+                std::vector<uint8_t> payload;
+                Amf0::writeString(payload, "_result");
+                Amf0::writeNumber(payload, transaction);
+                Amf0::writeNull(payload);
+                Amf0::writeNumber(payload, kStreamId);
+                send(s, Rtmp::CommandChunks, Rtmp::CommandMessage, 0, payload);
+            }
+            else if (name == "publish") {
+                reader.skip();
+                reader.readString(m_received.key);
+                m_received.published = true;
+                sendStatus(s, "onStatus", 0, "NetStream.Publish.Start", kStreamId);
+                // A ping the client has to answer between its media messages
+                const std::vector<uint8_t> ping = { 0, Rtmp::PingRequest, 0, 0, 0x12, 0x34 };
+                send(s, Rtmp::ControlChunks, Rtmp::UserControl, 0, ping);
+            }
+            else if (name == "FCUnpublish" || name == "deleteStream") {
+                m_received.unpublished = true;
+            }
+        }
+
+        void audio(const Rtmp::Message& message)
+        {
+            if (message.payload.size() < 2 || message.payload[1] == 0) {
+                return; // AudioSpecificConfig
+            }
+            m_received.audio++;
+            uint32_t sequence = 0;
+            if (message.payload.size() >= 2 + sizeof(sequence)) {
+                std::memcpy(&sequence, message.payload.data() + 2, sizeof(sequence));
+            }
+            m_received.audioGaps += sequence != m_nextAudio;
+            m_nextAudio = sequence + 1;
+            m_received.backwards += message.timestamp < m_lastAudioTime;
+            m_lastAudioTime = message.timestamp;
+            dumpTag(Flv::AudioTag, message);
+        }
+
+        void video(const Rtmp::Message& message)
+        {
+            if (message.payload.size() < 5 || message.payload[1] == 0) {
+                return; // AVCDecoderConfigurationRecord
+            }
+            VideoTag tag;
+            if (message.payload.size() < 5 + sizeof(tag)) {
+                m_received.error = "short video message";
+                return;
+            }
+            std::memcpy(&tag, message.payload.data() + 5, sizeof(tag));
+            m_received.video++;
+            m_received.keyframes += tag.priority == EncodedPacket::Keyframe;
+            if ((message.payload[0] >> 4) != (tag.priority == EncodedPacket::Keyframe ? 1 : 2)) {
+                m_received.error = "FLV frame type doesn't match the frame";
+            }
+            for (int reference : tag.references) {
+                if (reference >= 0 && (reference >= static_cast<int>(m_frames.size()) || !m_frames[reference])) {
+                    m_received.undecodable++;
+                    break;
+                }
+            }
+            if (tag.frame >= static_cast<int>(m_frames.size())) {
+                m_frames.resize(tag.frame + 1, false);
+            }
+            m_frames[tag.frame] = true;
+            m_received.backwards += message.timestamp < m_lastVideoTime;
+            m_lastVideoTime = message.timestamp;
+            dumpTag(Flv::VideoTag, message);
+        }
+
+        void dumpTag(Flv::TagType type, const Rtmp::Message& message)
+        {
+            if (m_dump) {
+                Flv::writeTag(m_received.flv, type, message.timestamp, message.payload.data(), message.payload.size());
+            }
+        }
+
+        static constexpr uint32_t kStreamId = 1;
+
+        int m_listen = -1;
+        int m_port = 0;
+        bool m_dump = false;
+        std::thread m_thread;
+        std::atomic<bool> m_stopping{ false };
+        std::atomic<int> m_rateKbps{ 0 };
+        RtmpChunkWriter m_writer;
+        std::vector<uint8_t> m_out;
+        Received m_received;
+        uint32_t m_nextAudio = 0;
+        uint32_t m_lastAudioTime = 0;
+        uint32_t m_lastVideoTime = 0;
+        std::vector<bool> m_frames; // received, by frame number
+    };
+
+    // Stands in for x264 and AAC: GOPs of an I frame, then P and B frames alternating
+    // in decode order, each B referencing the two reference frames sent before it,
+    // sized so a GOP averages the bitrate; AAC frames of 1024 samples at 48 kHz
+    class SyntheticEncoder
+    {
+    public:
+        SyntheticEncoder(const Options& options) : m_options(options), m_gopFrames(std::max(1, static_cast<int>(options.gopSeconds * options.fps)))
+        {
+            m_data.resize(1 << 20);
+            for (size_t i = 0; i < m_data.size(); i++) {
+                m_data[i] = static_cast<uint8_t>(i * 7);
+            }
+        }
+
+        void setVideoKbps(int kbps) { m_videoKbps = kbps; }
+        int videoKbps() const { return m_videoKbps; }
+
+        EncodedPacket videoConfig() const { return config(EncodedPacket::Video); }
+        EncodedPacket audioConfig() const { return config(EncodedPacket::Audio); }
+
+        int64_t nextVideoMs() const { return m_frame * 1000LL / m_options.fps; }
+        int64_t nextAudioMs() const { return static_cast<int64_t>(m_audioFrame) * 1024 * 1000 / 48000; }
+
+        EncodedPacket nextVideo()
+        {
+            const int inGop = m_frame % m_gopFrames;
+            EncodedPacket packet;
+            packet.type = EncodedPacket::Video;
+            packet.dtsMs = nextVideoMs();
+            VideoTag tag{ m_frame, EncodedPacket::Keyframe, { -1, -1 } };
+            if (inGop == 0) {
+                m_lastReference = m_frame;
+            }
+            else if (inGop % 2 == 1 || inGop == m_gopFrames - 1) {
+                packet.priority = EncodedPacket::Reference;
+                packet.compositionMs = 1000 / m_options.fps;
+                tag = { m_frame, EncodedPacket::Reference, { m_lastReference, -1 } };
+                m_previousReference = m_lastReference;
+                m_lastReference = m_frame;
+            }
+            else {
+                // Between the two references around it, which both went out before it
+                packet.priority = EncodedPacket::Disposable;
+                tag = { m_frame, EncodedPacket::Disposable, { m_previousReference, m_lastReference } };
+            }
+            tag.priority = packet.priority;
+
+            // Weights 8 : 1 : 0.5 for I : P : B, scaled so a GOP averages the bitrate
+            const double pb = (m_gopFrames - 1) / 2.0;
+            const double unit = m_videoKbps * 125.0 * m_gopFrames / m_options.fps / (8.0 + pb * 1.0 + pb * 0.5);
+            const double weight = packet.priority == EncodedPacket::Keyframe ? 8.0 : packet.priority == EncodedPacket::Reference ? 1.0 : 0.5;
+            packet.size = std::min(m_data.size(), std::max(sizeof(tag), static_cast<size_t>(unit * weight)));
+            std::memcpy(m_data.data(), &tag, sizeof(tag));
+            packet.data = m_data.data();
+            m_frame++;
+            return packet;
+        }
+
+        EncodedPacket nextAudio()
+        {
+            EncodedPacket packet;
+            packet.type = EncodedPacket::Audio;
+            packet.dtsMs = nextAudioMs();
+            packet.size = static_cast<size_t>(m_options.audioKbps * 125.0 * 1024 / 48000);
+            std::memcpy(m_audio, &m_audioFrame, sizeof(m_audioFrame));
+            packet.data = m_audio;
+            m_audioFrame++;
+            return packet;
+        }
+
+        int frames() const { return m_frame; }
+        uint32_t audioFrames() const { return m_audioFrame; }
+
+    private:
+        EncodedPacket config(EncodedPacket::Type type) const
+        {
+            static const uint8_t kConfig[8] = { 1, 0x64, 0, 0x28, 0xFF, 0xE1, 0, 0 };
+            EncodedPacket packet;
+            packet.type = type;
+            packet.config = true;
+            packet.data = kConfig;
+            packet.size = type == EncodedPacket::Video ? sizeof(kConfig) : 2;
+            return packet;
+        }
+
+        const Options& m_options;
+        const int m_gopFrames;
+        int m_videoKbps = 0;
+        int m_frame = 0;
+        int m_lastReference = -1;
+        int m_previousReference = -1;
+        uint32_t m_audioFrame = 0;
+        std::vector<uint8_t> m_data;
+        uint8_t m_audio[4096] = {};
+    };
+
+    struct Run
+    {
+        const char* name;
+        double seconds;
+        int linkKbps;      // 0 = unthrottled
+        double liftAt;     // fraction of the run after which the throttle goes, 0 = never
+        bool followHint;
+    };
+
+    struct RunResult
+    {
+        bool live = false;
+        std::string error;
+        RtmpOutput::Stats stats;
+        Received received;
+        uint32_t audioSent = 0;
+        int framesEncoded = 0;
+        bool referenceBeforeDisposable = false; // a reference frame went while no disposable one had
+        int hintAtLift = 0;
+        int lowestHint = 0;
+        int hintAtEnd = 0;
+        uint64_t lateGopBreaks = 0; // reference and keyframe drops in the last third while throttled
+    };
+
+    RunResult runOnce(const Options& options, const Run& run, bool dump)
+    {
+        RunResult result;
+        LoopbackServer server;
+        if (!server.start(dump)) {
+            result.error = "cannot listen on loopback";
+            return result;
+        }
+        server.setRateKbps(run.linkKbps);
+
+        RtmpOutput output;
+        RtmpOutput::Settings settings;
+        settings.url = "rtmp://127.0.0.1:" + std::to_string(server.port()) + "/live";
+        settings.streamKey = "bench";
+        settings.stream.videoKbps = options.videoKbps;
+        settings.stream.audioKbps = options.audioKbps;
+        settings.stream.fps = options.fps;
+        settings.sendBufferBytes = 32 * 1024;
+        output.start(settings);
+        result.live = output.waitUntilLive(5000);
+        if (!result.live) {
+            result.error = output.lastError();
+            return result;
+        }
+
+        SyntheticEncoder encoder(options);
+        encoder.setVideoKbps(options.videoKbps);
+        output.push(encoder.videoConfig());
+        output.push(encoder.audioConfig());
+
+        const Clock::time_point start = Clock::now();
+        const int64_t runMs = static_cast<int64_t>(run.seconds * 1000);
+        const int64_t liftMs = run.liftAt > 0.0 ? static_cast<int64_t>(runMs * run.liftAt) : runMs + 1;
+        const int64_t lateFrom = std::min(liftMs, runMs) * 2 / 3;
+        bool lifted = false;
+        uint64_t dropsAtLate = 0;
+        result.lowestHint = options.videoKbps;
+        for (;;) {
+            const int64_t due = std::min(encoder.nextVideoMs(), encoder.nextAudioMs());
+            if (due >= runMs) {
+                break;
+            }
+            std::this_thread::sleep_until(start + std::chrono::milliseconds(due));
+
+            if (!lifted && due >= liftMs) {
+                lifted = true;
+                result.hintAtLift = output.bitrateHintKbps();
+                server.setRateKbps(0);
+            }
+            if (dropsAtLate == 0 && due >= lateFrom) {
+                const RtmpOutput::Stats stats = output.stats();
+                dropsAtLate = 1 + stats.dropped[EncodedPacket::Reference] + stats.dropped[EncodedPacket::Keyframe];
+            }
+
+            const bool audio = encoder.nextAudioMs() <= encoder.nextVideoMs();
+            if (!audio && run.followHint) {
+                encoder.setVideoKbps(output.bitrateHintKbps());
+            }
+            if (!output.push(audio ? encoder.nextAudio() : encoder.nextVideo())) {
+                result.error = output.lastError();
+                break;
+            }
+            const RtmpOutput::Stats stats = output.stats();
+            if (stats.dropped[EncodedPacket::Reference] > 0 && stats.dropped[EncodedPacket::Disposable] == 0) {
+                result.referenceBeforeDisposable = true;
+            }
+            if (!lifted) {
+                result.lowestHint = std::min(result.lowestHint, stats.bitrateHintKbps);
+            }
+        }
+
+        const RtmpOutput::Stats beforeStop = output.stats();
+        if (dropsAtLate > 0 && !lifted) {
+            result.lateGopBreaks = beforeStop.dropped[EncodedPacket::Reference] + beforeStop.dropped[EncodedPacket::Keyframe] -
+                (dropsAtLate - 1);
+        }
+        result.hintAtEnd = output.bitrateHintKbps();
+        output.stop(10000);
+        if (result.error.empty() && output.state() == RtmpOutput::State::Failed) {
+            result.error = output.lastError();
+        }
+        result.stats = output.stats();
+        result.audioSent = encoder.audioFrames();
+        result.framesEncoded = encoder.frames();
+
+        // Let the server read the tail (unpublish included) before it stops
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        server.stop();
+        result.received = server.received();
+        if (dump && !options.dump.empty()) {
+            std::ofstream file(options.dump, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(result.received.flv.data()), result.received.flv.size());
+        }
+        return result;
+    }
+
+    void printRun(const Run& run, const RunResult& result)
+    {
+        const RtmpOutput::Stats& stats = result.stats;
+        std::printf("%-26s %6d %6llu %6llu %5llu/%-5llu/%-3llu %7d %7d %7d %7d\n", run.name, result.framesEncoded,
+            static_cast<unsigned long long>(result.received.video), static_cast<unsigned long long>(result.received.audio),
+            static_cast<unsigned long long>(stats.dropped[EncodedPacket::Disposable]),
+            static_cast<unsigned long long>(stats.dropped[EncodedPacket::Reference]),
+            static_cast<unsigned long long>(stats.dropped[EncodedPacket::Keyframe]),
+            stats.maxQueuedVideoMs, stats.linkKbps, result.lowestHint, result.hintAtEnd);
+    }
+
+    uint64_t droppedFrames(const RunResult& result)
+    {
+        return result.stats.dropped[0] + result.stats.dropped[1] + result.stats.dropped[2];
+    }
+
+    // fixedRate: the throttled run that ignored the hint, once it has been run
+    bool check(const Options& options, const Run& run, const RunResult& result, const RunResult* fixedRate)
+    {
+        bool ok = true;
+        auto failed = [&](const std::string& what) {
+            std::printf("FAIL (%s): %s\n", run.name, what.c_str());
+            ok = false;
+        };
+
+        const Received& received = result.received;
+        if (!result.live || !result.error.empty()) {
+            failed(result.error.empty() ? "never went live" : result.error);
+            return false;
+        }
+        if (!received.error.empty()) {
+            failed("server: " + received.error);
+        }
+        if (!received.published || received.app != "live" || received.key != "bench" || !received.metadata) {
+            failed("publish handshake incomplete");
+        }
+        if (!received.pong) {
+            failed("ping not answered");
+        }
+        if (!received.unpublished) {
+            failed("no unpublish on stop");
+        }
+        // Audio is never dropped: all of it, in order
+        if (received.audio != result.audioSent || received.audioGaps > 0) {
+            failed("audio: " + std::to_string(received.audio) + " of " + std::to_string(result.audioSent) +
+                " packets, " + std::to_string(received.audioGaps) + " gaps");
+        }
+        if (received.undecodable > 0) {
+            failed(std::to_string(received.undecodable) + " frames arrived without their references");
+        }
+        if (received.backwards > 0) {
+            failed("timestamps went backwards");
+        }
+        const uint64_t dropped = droppedFrames(result);
+        if (received.video + dropped != static_cast<uint64_t>(result.framesEncoded)) {
+            failed("frames neither received nor counted as dropped");
+        }
+        if (result.referenceBeforeDisposable) {
+            failed("a reference frame was dropped before any disposable one");
+        }
+
+        // Past the reference threshold the queue is cleared down to the next keyframe
+        const RtmpOutput::Settings defaults;
+        if (result.stats.maxQueuedVideoMs > defaults.dropReferenceMs + 2000 / options.fps) {
+            failed("video queue reached " + std::to_string(result.stats.maxQueuedVideoMs) + " ms");
+        }
+
+        if (run.linkKbps == 0) {
+            if (dropped > 0) {
+                failed("dropped frames on a clear link");
+            }
+            if (result.hintAtEnd != options.videoKbps) {
+                failed("hint below the ceiling on a clear link");
+            }
+            return ok;
+        }
+        if (!run.followHint && dropped == 0) {
+            failed("a link below the bitrate dropped nothing");
+        }
+        if (run.followHint) {
+            // Settles under the link (what is left of it after audio) and stops dropping
+            const int videoShare = run.linkKbps - options.audioKbps;
+            if (result.lowestHint > videoShare) {
+                failed("hint never went below the link: lowest " + std::to_string(result.lowestHint) + " kbps");
+            }
+            // Keyframe bursts may still cost a disposable frame, never a broken GOP
+            if (result.lateGopBreaks > 0 && run.liftAt == 0.0) {
+                failed(std::to_string(result.lateGopBreaks) + " reference frames dropped after the hint settled");
+            }
+            if (fixedRate && droppedFrames(result) * 2 > droppedFrames(*fixedRate) && run.liftAt == 0.0) {
+                failed("following the hint dropped " + std::to_string(droppedFrames(result)) + " frames, ignoring it " +
+                    std::to_string(droppedFrames(*fixedRate)));
+            }
+            if (run.liftAt > 0.0 && result.hintAtEnd <= result.hintAtLift) {
+                failed("hint didn't recover once the throttle lifted");
+            }
+        }
+        return ok;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    const Run runs[] = {
+        { "clear link", options.seconds / 2, 0, 0.0, false },
+        { "throttled, fixed bitrate", options.seconds, options.linkKbps, 0.0, false },
+        { "throttled, following hint", options.seconds, options.linkKbps, 0.0, true },
+        { "throttle lifted halfway", options.seconds * 1.5, options.linkKbps, 0.5, true },
+    };
+
+    std::printf("video %d kbps at %d fps, %.1f s GOP; audio %d kbps; throttled link %d kbps\n\n",
+        options.videoKbps, options.fps, options.gopSeconds, options.audioKbps, options.linkKbps);
+    std::printf("%-26s %6s %6s %6s %17s %7s %7s %7s %7s\n", "run", "frames", "video", "audio",
+        "dropped B/P/I", "max q", "link", "min hint", "hint");
+
+    RunResult results[sizeof(runs) / sizeof(runs[0])];
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+        results[i] = runOnce(options, runs[i], i + 1 == sizeof(runs) / sizeof(runs[0]));
+        const RunResult& result = results[i];
+        printRun(runs[i], result);
+        ok = check(options, runs[i], result, i > 1 ? &results[1] : nullptr) && ok;
+    }
+    std::printf("\n%s\n", ok ? "all checks passed" : "checks failed");
+    return ok ? 0 : 1;
+}
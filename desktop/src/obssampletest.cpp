@@ -0,0 +1,358 @@
+// SampleConverter conformance: every source and destination format, interleaved and
+// planar on both sides, 1 to 8 channels, with setSimdLevel() capped at scalar, SSE2
+// and AVX2 in turn. Random samples plus the extremes of each format go through the
+// converter and every output sample is compared with a plain reference written here:
+// integer to integer and anything to float must match exactly, float to 24/32-bit
+// must round to nearest and saturate, and the dithered float to 8/16-bit conversions
+// must stay within the dither's reach of the input. Guard bytes after every buffer
+// catch kernels that write past the end, and a constant input checks the dither
+// averages out to the signal. Exits non-zero on the first configuration that fails.
+
+#include "incl/SampleConverter.h"
+#include "incl/Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+    // Bytes after each buffer that no conversion may touch
+    constexpr int kGuardBytes = 32;
+    constexpr uint8_t kGuard = 0xA5;
+
+    // A dithered sample may land this far from the exact value: rounding plus up to
+    // one LSB of triangular dither
+    constexpr double kDitherReach = 1.5;
+
+    struct Options
+    {
+        int frames = 613; // crosses the converter's 256-frame chunks and leaves a SIMD tail
+        uint32_t seed = 1;
+    };
+
+    const char* const kUsage =
+        "usage: obs-sample-test [options]\n"
+        "  --frames N   frames per conversion (default: 613)\n"
+        "  --seed N     random seed (default: 1)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const int value = std::atoi(argv[++i]);
+            if (arg == "--frames") {
+                options.frames = value;
+            }
+            else if (arg == "--seed") {
+                options.seed = static_cast<uint32_t>(value);
+            }
+            else {
+                return false;
+            }
+        }
+        return options.frames > 0;
+    }
+
+    const char* levelName(SimdLevel level)
+    {
+        switch (level) {
+        case SimdLevel::Scalar: return "scalar";
+        case SimdLevel::Sse2: return "sse2";
+        case SimdLevel::Avx2: return "avx2";
+        }
+        return "?";
+    }
+
+    const char* formatName(SampleFormat format)
+    {
+        switch (format) {
+        case SampleFormat::U8: return "u8";
+        case SampleFormat::S16: return "s16";
+        case SampleFormat::S24: return "s24";
+        case SampleFormat::S32: return "s32";
+        case SampleFormat::F32: return "f32";
+        }
+        return "?";
+    }
+
+    constexpr SampleFormat kFormats[] = { SampleFormat::U8, SampleFormat::S16, SampleFormat::S24, SampleFormat::S32, SampleFormat::F32 };
+
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed) : m_state(seed ? seed : 1) {}
+
+        uint32_t next()
+        {
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 17;
+            m_state ^= m_state << 5;
+            return m_state;
+        }
+
+    private:
+        uint32_t m_state;
+    };
+
+    // --- Reference ---
+
+    // Integer sample as a signed value in its own range (U8 recentred on zero)
+    int64_t readInt(SampleFormat format, const uint8_t* p)
+    {
+        switch (format) {
+        case SampleFormat::U8:
+            return static_cast<int64_t>(p[0]) - 128;
+        case SampleFormat::S16:
+            return static_cast<int16_t>(p[0] | p[1] << 8);
+        case SampleFormat::S24: {
+            const int32_t v = p[0] | p[1] << 8 | p[2] << 16;
+            return v >= (1 << 23) ? v - (1 << 24) : v;
+        }
+        default:
+            return static_cast<int32_t>(static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+                static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24);
+        }
+    }
+
+    void writeInt(SampleFormat format, int64_t v, uint8_t* p)
+    {
+        if (format == SampleFormat::U8) {
+            p[0] = static_cast<uint8_t>(v + 128);
+            return;
+        }
+        for (int i = 0; i < bytesPerSample(format); i++) {
+            p[i] = static_cast<uint8_t>(static_cast<uint64_t>(v) >> (8 * i));
+        }
+    }
+
+    int bits(SampleFormat format)
+    {
+        return bytesPerSample(format) * 8;
+    }
+
+    float readFloat(const uint8_t* p)
+    {
+        float v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+
+    // Writes what the converter should produce for one sample. Returns false for the
+    // dithered conversions, which only fill `exact` with the undithered value.
+    bool expected(SampleFormat src, const uint8_t* in, SampleFormat dst, uint8_t* out, double& exact)
+    {
+        if (src != SampleFormat::F32 && dst != SampleFormat::F32) {
+            // Integers keep their top bits: widening is exact, narrowing truncates
+            const int64_t v = readInt(src, in);
+            const int shift = bits(dst) - bits(src);
+            writeInt(dst, shift >= 0 ? v * (int64_t(1) << shift) : v >> -shift, out);
+            return true;
+        }
+        if (dst == SampleFormat::F32) {
+            const float v = src == SampleFormat::F32
+                ? readFloat(in)
+                : static_cast<float>(static_cast<double>(readInt(src, in)) / std::ldexp(1.0, bits(src) - 1));
+            std::memcpy(out, &v, 4);
+            return true;
+        }
+
+        // Float to integer: scale, then round to nearest even and saturate. 32-bit stops
+        // at the largest float below 2^31, where the converter has to.
+        const double full = std::ldexp(1.0, bits(dst) - 1);
+        const double top = dst == SampleFormat::S32 ? 2147483520.0 : full - 1.0;
+        exact = std::min(std::max(static_cast<double>(readFloat(in)) * full, -full), top);
+        if (dst == SampleFormat::U8 || dst == SampleFormat::S16) {
+            return false;
+        }
+        writeInt(dst, static_cast<int64_t>(std::nearbyint(exact)), out);
+        return true;
+    }
+
+    // One side of a conversion: a single interleaved buffer or a plane per channel,
+    // each followed by guard bytes
+    struct Buffers
+    {
+        std::vector<std::vector<uint8_t>> storage;
+        std::vector<void*> pointers;
+        SampleFormat format;
+        bool planar;
+        int channels;
+        int frames;
+
+        Buffers(SampleFormat format, bool planar, int channels, int frames)
+            : format(format), planar(planar), channels(channels), frames(frames)
+        {
+            const size_t bytes = static_cast<size_t>(frames) * bytesPerSample(format) * (planar ? 1 : channels);
+            storage.assign(planar ? channels : 1, std::vector<uint8_t>(bytes + kGuardBytes, kGuard));
+            for (auto& buffer : storage) {
+                pointers.push_back(buffer.data());
+            }
+        }
+
+        uint8_t* sample(int frame, int channel)
+        {
+            const int size = bytesPerSample(format);
+            if (planar) {
+                return storage[channel].data() + static_cast<size_t>(frame) * size;
+            }
+            return storage[0].data() + (static_cast<size_t>(frame) * channels + channel) * size;
+        }
+
+        bool guardsIntact() const
+        {
+            for (const auto& buffer : storage) {
+                if (std::any_of(buffer.end() - kGuardBytes, buffer.end(), [](uint8_t b) { return b != kGuard; })) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    // Random samples, with the first frames walking through each format's edge values
+    void fill(Buffers& buffers, Random& random)
+    {
+        static const float kFloatEdges[] = { 0.0f, -0.0f, 1.0f, -1.0f, 0.99999994f, -0.99999994f, 1.5f, -1.5f, 1e-9f, -1e-9f,
+            0.5f / 32768.0f, 1.5f / 32768.0f, -0.5f / 128.0f, 0.5f / 8388608.0f, 2.5f / 8388608.0f, 100.0f, -100.0f };
+        static const uint8_t kIntEdges[][4] = { { 0, 0, 0, 0 }, { 0xFF, 0xFF, 0xFF, 0xFF }, { 0xFF, 0xFF, 0xFF, 0x7F },
+            { 0, 0, 0, 0x80 }, { 0x80, 0x80, 0x80, 0x80 }, { 0x7F, 0x7F, 0x7F, 0x7F }, { 1, 0, 0, 0 } };
+        constexpr int floatEdges = sizeof(kFloatEdges) / sizeof(kFloatEdges[0]);
+        constexpr int intEdges = sizeof(kIntEdges) / sizeof(kIntEdges[0]);
+        const int size = bytesPerSample(buffers.format);
+
+        int edge = 0;
+        for (int f = 0; f < buffers.frames; f++) {
+            for (int c = 0; c < buffers.channels; c++, edge++) {
+                uint8_t* p = buffers.sample(f, c);
+                if (buffers.format == SampleFormat::F32) {
+                    // Mostly in range, some past full scale to hit the clamps
+                    float v = edge < floatEdges ? kFloatEdges[edge] : static_cast<float>(static_cast<int32_t>(random.next())) / 1.8e9f;
+                    std::memcpy(p, &v, 4);
+                }
+                else if (edge < intEdges) {
+                    std::memcpy(p, kIntEdges[edge] + 4 - size, size);
+                }
+                else {
+                    const uint32_t bits = random.next();
+                    std::memcpy(p, &bits, size);
+                }
+            }
+        }
+    }
+
+    // Converts one configuration and checks every sample; prints the first mismatch
+    bool checkConversion(SampleFormat srcFormat, bool srcPlanar, SampleFormat dstFormat, bool dstPlanar, int channels,
+        int frames, Random& random)
+    {
+        Buffers src(srcFormat, srcPlanar, channels, frames);
+        Buffers dst(dstFormat, dstPlanar, channels, frames);
+        fill(src, random);
+
+        char name[96];
+        std::snprintf(name, sizeof(name), "%s %s -> %s %s, %d ch, %s", formatName(srcFormat), srcPlanar ? "planar" : "interleaved",
+            formatName(dstFormat), dstPlanar ? "planar" : "interleaved", channels, levelName(simdLevel()));
+
+        SampleConverter converter;
+        if (!converter.configure(srcFormat, srcPlanar, dstFormat, dstPlanar, channels)) {
+            std::printf("FAIL: %s: configure() refused\n", name);
+            return false;
+        }
+        converter.convert(src.pointers.data(), dst.pointers.data(), frames);
+
+        if (!dst.guardsIntact()) {
+            std::printf("FAIL: %s: wrote past the end of the output\n", name);
+            return false;
+        }
+        const int size = bytesPerSample(dstFormat);
+        for (int f = 0; f < frames; f++) {
+            for (int c = 0; c < channels; c++) {
+                uint8_t want[4];
+                double exact = 0.0;
+                const uint8_t* got = dst.sample(f, c);
+                if (expected(srcFormat, src.sample(f, c), dstFormat, want, exact)) {
+                    if (std::memcmp(got, want, size) != 0) {
+                        std::printf("FAIL: %s: frame %d channel %d differs from the reference\n", name, f, c);
+                        return false;
+                    }
+                }
+                else if (std::fabs(static_cast<double>(readInt(dstFormat, got)) - exact) > kDitherReach) {
+                    std::printf("FAIL: %s: frame %d channel %d is %lld, input %.3f LSB\n", name, f, c,
+                        static_cast<long long>(readInt(dstFormat, got)), exact);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // A constant a quarter LSB above zero has to come out as a quarter LSB on average,
+    // which only happens when the dither is there
+    bool checkDither(SampleFormat dstFormat)
+    {
+        constexpr int frames = 8192;
+        const double lsb = dstFormat == SampleFormat::U8 ? 1.0 / 128.0 : 1.0 / 32768.0;
+        std::vector<float> in(frames * 2, static_cast<float>(0.25 * lsb));
+        Buffers dst(dstFormat, false, 2, frames);
+        SampleConverter converter;
+        converter.configure(SampleFormat::F32, false, dstFormat, false, 2);
+        converter.convert(in.data(), dst.pointers[0], frames);
+
+        double sum = 0.0;
+        for (int f = 0; f < frames; f++) {
+            for (int c = 0; c < 2; c++) {
+                sum += static_cast<double>(readInt(dstFormat, dst.sample(f, c)));
+            }
+        }
+        const double mean = sum / (frames * 2);
+        if (std::fabs(mean - 0.25) > 0.05) {
+            std::printf("FAIL: f32 -> %s dither at %s averages %.3f LSB for a 0.25 LSB input\n", formatName(dstFormat),
+                levelName(simdLevel()), mean);
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    bool ok = true;
+    int levels = 0;
+    int conversions = 0;
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2 }) {
+        setSimdLevel(level);
+        if (simdLevel() != level) {
+            continue;
+        }
+        levels++;
+        Random random(options.seed);
+        for (SampleFormat srcFormat : kFormats) {
+            for (SampleFormat dstFormat : kFormats) {
+                for (int layout = 0; layout < 4; layout++) {
+                    for (int channels = 1; channels <= SampleConverter::kMaxChannels; channels++) {
+                        ok = checkConversion(srcFormat, (layout & 1) != 0, dstFormat, (layout & 2) != 0, channels, options.frames, random) && ok;
+                        conversions++;
+                    }
+                }
+            }
+        }
+        ok = checkDither(SampleFormat::U8) && ok;
+        ok = checkDither(SampleFormat::S16) && ok;
+    }
+    setSimdLevel(SimdLevel::Avx2);
+
+    std::printf("%d conversions of %d frames at %d SIMD levels %s the reference\n", conversions, options.frames, levels,
+        ok ? "match" : "differ from");
+    return ok ? 0 : 1;
+}
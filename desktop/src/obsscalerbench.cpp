@@ -0,0 +1,252 @@
+// Simulcast scaling benchmark: ScalerPyramid against one Scaler per rendition, each
+// reading the full source frame (the way every output scaled the capture on its own).
+// Both run on the same thread pool over the same synthetic desktop. Exits non-zero
+// when a level the pyramid reads from the source differs from the plain Scaler's
+// output, or when a derived level loses too much against scaling from the source.
+
+#include "incl/ScalerPyramid.h"
+#include "incl/Scaler.h"
+#include "incl/SyntheticSource.h"
+#include "incl/ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Output rows per strip, as ScalerPyramid splits them
+    constexpr int kStripRows = 16;
+
+    // A derived level may be this much worse than scaling straight from the source
+    constexpr double kMinDerivedPsnr = 34.0;
+
+    struct Options
+    {
+        int width = 3840;
+        int height = 2160;
+        std::vector<Rendition> renditions{ { 1920, 1080 }, { 1280, 720 }, { 854, 480 } };
+        int frames = 60;
+        int threads = 0;
+        std::string workload = "typing";
+    };
+
+    const char* const kUsage =
+        "usage: obs-scaler-bench [options]\n"
+        "  --size WxH           source size (default: 3840x2160)\n"
+        "  --renditions WxH,..  outputs (default: 1920x1080,1280x720,854x480)\n"
+        "  --frames N           timed frames per strategy (default: 60)\n"
+        "  --threads N          pool threads (default: one per core)\n"
+        "  --workload SCRIPT    synthetic desktop script (default: typing; noise is the worst\n"
+        "                       case for derived levels)\n";
+
+    bool parseSize(const std::string& text, int& width, int& height)
+    {
+        return std::sscanf(text.c_str(), "%dx%d", &width, &height) == 2 && width > 0 && height > 0;
+    }
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--size") {
+                if (!parseSize(value, options.width, options.height)) {
+                    return false;
+                }
+            }
+            else if (arg == "--renditions") {
+                options.renditions.clear();
+                for (size_t begin = 0; begin < value.size();) {
+                    const size_t comma = std::min(value.find(',', begin), value.size());
+                    Rendition rendition;
+                    if (!parseSize(value.substr(begin, comma - begin), rendition.width, rendition.height)) {
+                        return false;
+                    }
+                    options.renditions.push_back(rendition);
+                    begin = comma + 1;
+                }
+            }
+            else if (arg == "--frames") {
+                options.frames = std::atoi(value.c_str());
+            }
+            else if (arg == "--threads") {
+                options.threads = std::atoi(value.c_str());
+            }
+            else if (arg == "--workload") {
+                options.workload = value;
+            }
+            else {
+                return false;
+            }
+        }
+        return options.frames > 0 && options.threads >= 0 && !options.renditions.empty() &&
+               options.width <= SyntheticSource::kMaxWidth && options.height <= SyntheticSource::kMaxHeight;
+    }
+
+    // The baseline: every rendition scales the whole source on its own, strip-parallel
+    struct Independent
+    {
+        std::vector<Scaler> scalers;
+        std::vector<FrameBuffer> outputs;
+
+        void configure(const Options& options)
+        {
+            scalers.resize(options.renditions.size());
+            outputs.resize(options.renditions.size());
+            for (size_t i = 0; i < options.renditions.size(); i++) {
+                const Rendition& r = options.renditions[i];
+                scalers[i].configure(options.width, options.height, r.width, r.height);
+                outputs[i].resize(r.width, r.height);
+            }
+        }
+
+        void process(const FrameView& src, ThreadPool& pool)
+        {
+            for (size_t i = 0; i < scalers.size(); i++) {
+                const Scaler& scaler = scalers[i];
+                const FrameView dst = outputs[i].view();
+                const int strips = (dst.height + kStripRows - 1) / kStripRows;
+                pool.parallelFor(strips, [&](int begin, int end) {
+                    scaler.scaleRows(src, dst, begin * kStripRows, std::min(end * kStripRows, dst.height));
+                });
+            }
+        }
+    };
+
+    double psnr(const FrameView& a, const FrameView& b)
+    {
+        double squared = 0.0;
+        for (int y = 0; y < a.height; y++) {
+            const uint8_t* pa = a.row(y);
+            const uint8_t* pb = b.row(y);
+            for (int x = 0; x < a.width * 4; x++) {
+                if ((x & 3) != 3) {
+                    const double d = static_cast<double>(pa[x]) - pb[x];
+                    squared += d * d;
+                }
+            }
+        }
+        const double mse = squared / (3.0 * a.width * a.height);
+        return mse == 0.0 ? INFINITY : 10.0 * std::log10(255.0 * 255.0 / mse);
+    }
+
+    bool identical(const FrameView& a, const FrameView& b)
+    {
+        for (int y = 0; y < a.height; y++) {
+            if (std::memcmp(a.row(y), b.row(y), static_cast<size_t>(a.width) * 4) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Source bytes each strategy pulls through the cache per frame, ignoring overlap
+    // between neighbouring strips
+    double sourceMegabytes(const Options& options, int sourceReads)
+    {
+        return static_cast<double>(options.width) * options.height * 4 * sourceReads / 1e6;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    SyntheticSource::Settings settings;
+    settings.width = options.width;
+    settings.height = options.height;
+    std::string error;
+    if (!SyntheticSource::parseScript(options.workload, settings.script, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+    SyntheticSource source(settings);
+    if (!source.initialize()) {
+        std::fprintf(stderr, "%s\n", source.lastError().c_str());
+        return 1;
+    }
+
+    ThreadPool pool(options.threads);
+    Independent independent;
+    independent.configure(options);
+    ScalerPyramid pyramid;
+    if (!pyramid.configure(options.width, options.height, options.renditions)) {
+        std::fputs("Bad renditions\n", stderr);
+        return 2;
+    }
+
+    int sourceLevels = 0;
+    std::printf("%dx%d source, %d threads\n", options.width, options.height, pool.threadCount());
+    for (int i = 0; i < pyramid.levelCount(); i++) {
+        const Rendition& r = options.renditions[i];
+        const int parent = pyramid.parentOf(i);
+        if (parent < 0) {
+            sourceLevels++;
+            std::printf("  %dx%d from the source\n", r.width, r.height);
+        }
+        else {
+            std::printf("  %dx%d from %dx%d\n", r.width, r.height, options.renditions[parent].width, options.renditions[parent].height);
+        }
+    }
+
+    // Warm up both, then alternate so neither gets a quieter machine
+    SourceFrame frame;
+    source.acquireFrame(frame);
+    independent.process(frame.pixels, pool);
+    pyramid.process(frame.pixels, &pool);
+
+    double independentSeconds = 0.0;
+    double pyramidSeconds = 0.0;
+    for (int f = 0; f < options.frames; f++) {
+        source.acquireFrame(frame);
+        Clock::time_point start = Clock::now();
+        independent.process(frame.pixels, pool);
+        independentSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+        start = Clock::now();
+        pyramid.process(frame.pixels, &pool);
+        pyramidSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    const double independentMs = independentSeconds * 1000.0 / options.frames;
+    const double pyramidMs = pyramidSeconds * 1000.0 / options.frames;
+    std::printf("\n%-13s %10s %12s\n", "strategy", "ms/frame", "source MB");
+    std::printf("%-13s %10.2f %12.1f\n", "independent", independentMs,
+        sourceMegabytes(options, static_cast<int>(options.renditions.size())));
+    std::printf("%-13s %10.2f %12.1f\n", "pyramid", pyramidMs, sourceMegabytes(options, sourceLevels > 0 ? 1 : 0));
+    std::printf("pyramid speedup: %.2fx\n\n", independentMs / pyramidMs);
+
+    // Both now hold the same (last) frame
+    bool ok = true;
+    for (int i = 0; i < pyramid.levelCount(); i++) {
+        const FrameView expected = independent.outputs[i].view();
+        const FrameView actual = pyramid.level(i);
+        const Rendition& r = options.renditions[i];
+        if (pyramid.parentOf(i) < 0) {
+            if (!identical(expected, actual)) {
+                std::printf("FAIL: %dx%d differs from scaling the source directly\n", r.width, r.height);
+                ok = false;
+            }
+            continue;
+        }
+        const double quality = psnr(expected, actual);
+        std::printf("%dx%d derived: %.1f dB PSNR against scaling the source\n", r.width, r.height, quality);
+        if (quality < kMinDerivedPsnr) {
+            std::printf("FAIL: %dx%d derived level below %.0f dB\n", r.width, r.height, kMinDerivedPsnr);
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+// ThreadPool and TaskGraph scaling on SchedulerBenchmark's synthetic frame graph:
+// capture, change detection and two scalers, compose, preview and encoder conversion
+// with an audio chain alongside, every video task split into strips. Times the graph
+// from one thread up to one per core (by default) and reports ms per frame, frames per
+// second, speedup and efficiency for each. Exits non-zero when any parallel run has
+// lower throughput than the single-thread run, past a small allowance for timer noise.
+
+#include "incl/SchedulerBenchmark.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    // A parallel run may come in this much under one thread before it counts as a drop
+    constexpr double kNoiseAllowance = 0.05;
+
+    struct Options
+    {
+        int width = 1920;
+        int height = 1080;
+        int frames = 60;
+        int threads = 0;
+    };
+
+    const char* const kUsage =
+        "usage: obs-scheduler-bench [options]\n"
+        "  --size WxH    synthetic frame size (default: 1920x1080)\n"
+        "  --frames N    timed frames per thread count (default: 60)\n"
+        "  --threads N   highest thread count (default: one per core)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--size") {
+                if (std::sscanf(value.c_str(), "%dx%d", &options.width, &options.height) != 2) {
+                    return false;
+                }
+            }
+            else if (arg == "--frames") {
+                options.frames = std::atoi(value.c_str());
+            }
+            else if (arg == "--threads") {
+                options.threads = std::atoi(value.c_str());
+            }
+            else {
+                return false;
+            }
+        }
+        return options.width > 0 && options.height > 0 && options.frames > 0 && options.threads >= 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    SchedulerBenchmark::Settings settings;
+    settings.width = options.width;
+    settings.height = options.height;
+    settings.frames = options.frames;
+    settings.maxThreads = options.threads;
+    if (settings.maxThreads == 0) {
+        settings.maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    std::printf("scheduler scaling, synthetic %dx%d frame graph, %d frames per run, 1 to %d threads\n",
+        settings.width, settings.height, settings.frames, settings.maxThreads);
+    std::printf("%8s %10s %10s %9s %11s\n", "threads", "ms/frame", "frames/s", "speedup", "efficiency");
+    const std::vector<SchedulerBenchmark::Result> results = SchedulerBenchmark::run(settings);
+    for (const SchedulerBenchmark::Result& result : results) {
+        std::printf("%8d %10.2f %10.1f %8.2fx %10.0f%%\n", result.threads, result.msPerFrame, 1000.0 / result.msPerFrame,
+            result.speedup, result.efficiency * 100.0);
+    }
+
+    bool ok = true;
+    for (const SchedulerBenchmark::Result& result : results) {
+        if (result.threads > 1 && result.speedup < 1.0 - kNoiseAllowance) {
+            std::printf("FAIL: %d threads run at %.1f frames/s, one thread at %.1f\n", result.threads,
+                1000.0 / result.msPerFrame, 1000.0 / results.front().msPerFrame);
+            ok = false;
+        }
+    }
+    if (results.size() < 2) {
+        std::puts("one thread only, no parallel run to check");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,276 @@
+// Multi-reader benchmark for the shared-memory frame ring: one producer publishes
+// frames, N forked reader processes consume them, and each reports what it received,
+// what it skipped or caught torn, and the publish-to-read latency. Exits non-zero when
+// a reader process fails or receives no whole frame.
+
+#include "incl/LatencyHistogram.h"
+#include "incl/SharedFrameOutput.h"
+#include "incl/SharedFrameReader.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    struct Options
+    {
+        int width = 1920;
+        int height = 1080;
+        int frames = 600;
+        int fps = 60; // 0 = flat out
+        int slots = SharedFrameOutput::kDefaultSlots;
+        bool copy = false;
+        std::vector<int> readerCounts{ 1, 2, 4 };
+    };
+
+    // What a reader process sends back through its pipe
+    struct ReaderResult
+    {
+        uint64_t frames = 0;
+        uint64_t skipped = 0;
+        uint64_t torn = 0;    // lapped while reading, or the stamp didn't match
+        uint64_t bytes = 0;
+        int64_t p50Us = 0;
+        int64_t p99Us = 0;
+        int64_t maxUs = 0;
+        double seconds = 0.0;
+    };
+
+    const char* const kUsage =
+        "usage: obs-shm-bench [options]\n"
+        "  --size WxH        frame size (default: 1920x1080)\n"
+        "  --frames N        frames per run (default: 600)\n"
+        "  --fps N           publish rate, 0 = flat out (default: 60)\n"
+        "  --slots N         ring slots (default: 3)\n"
+        "  --readers N,..    reader process counts to run (default: 1,2,4)\n"
+        "  --copy            readers copy every frame out instead of reading it in place\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (arg == "--copy") {
+                options.copy = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--size") {
+                if (std::sscanf(value.c_str(), "%dx%d", &options.width, &options.height) != 2 ||
+                    options.width <= 0 || options.height <= 0) {
+                    return false;
+                }
+            }
+            else if (arg == "--frames" || arg == "--fps" || arg == "--slots") {
+                const int number = std::atoi(value.c_str());
+                (arg == "--frames" ? options.frames : arg == "--fps" ? options.fps : options.slots) = number;
+            }
+            else if (arg == "--readers") {
+                options.readerCounts.clear();
+                for (size_t begin = 0; begin < value.size();) {
+                    const int count = std::atoi(value.c_str() + begin);
+                    if (count <= 0) {
+                        return false;
+                    }
+                    options.readerCounts.push_back(count);
+                    const size_t comma = value.find(',', begin);
+                    begin = comma == std::string::npos ? value.size() : comma + 1;
+                }
+            }
+            else {
+                return false;
+            }
+        }
+        return options.frames > 0 && options.fps >= 0 && !options.readerCounts.empty();
+    }
+
+    // The producer stamps the frame number into the first and last pixel, so a reader
+    // can tell a torn frame from a whole one without trusting the seqlock
+    uint32_t stampAt(const uint8_t* data, int width, int height, int stride, bool last)
+    {
+        uint32_t stamp;
+        const uint8_t* pixel = last ? data + static_cast<size_t>(height - 1) * stride + (width - 1) * 4 : data;
+        std::memcpy(&stamp, pixel, 4);
+        return stamp;
+    }
+
+    ReaderResult runReader(const std::string& name, const Options& options, int readyFd)
+    {
+        ReaderResult result;
+        SharedFrameReader reader;
+        if (!reader.open(name)) {
+            std::fprintf(stderr, "reader: %s\n", reader.lastError().c_str());
+            return result;
+        }
+        const char ready = 1;
+        if (write(readyFd, &ready, 1) != 1) {
+            return result;
+        }
+
+        LatencyHistogram latency;
+        std::vector<uint8_t> copy;
+        copy.reserve(static_cast<size_t>(options.width) * options.height * 4);
+        const int64_t start = SharedFrameRing::monotonicMicros();
+        int64_t last = start;
+        SharedFrame frame;
+
+        for (;;) {
+            bool received;
+            if (options.copy) {
+                received = reader.copyFrame(frame, copy, 2000);
+            }
+            else {
+                received = reader.waitFrame(frame, 2000);
+                if (received) {
+                    // Touch one word per page, as a consumer reading the frame in place would
+                    uint64_t sum = 0;
+                    const size_t bytes = static_cast<size_t>(frame.stride) * frame.height;
+                    for (size_t offset = 0; offset < bytes; offset += SharedFrameRing::kPageSize) {
+                        sum += frame.data[offset];
+                    }
+                    volatile uint64_t sink = sum;
+                    (void)sink;
+                }
+            }
+            if (!received) {
+                break;
+            }
+
+            const uint32_t expected = static_cast<uint32_t>(frame.frameNumber);
+            const bool whole = stampAt(frame.data, frame.width, frame.height, frame.stride, false) == expected &&
+                stampAt(frame.data, frame.width, frame.height, frame.stride, true) == expected;
+            if (!whole || (!options.copy && !reader.isValid(frame))) {
+                result.torn++;
+                continue;
+            }
+            last = SharedFrameRing::monotonicMicros();
+            latency.record(last - frame.publishedUs);
+            result.frames++;
+            result.bytes += static_cast<uint64_t>(frame.width) * frame.height * 4;
+        }
+
+        result.skipped = reader.skippedFrames();
+        result.p50Us = latency.quantileMicros(0.5);
+        result.p99Us = latency.quantileMicros(0.99);
+        result.maxUs = latency.maxMicros();
+        result.seconds = (last - start) / 1e6;
+        return result;
+    }
+
+    bool runOnce(const Options& options, int readerCount)
+    {
+        const std::string name = "/obs-shm-bench-" + std::to_string(getpid());
+        SharedFrameOutput output;
+        if (!output.open(name, options.width, options.height, options.slots)) {
+            std::fprintf(stderr, "%s\n", output.lastError().c_str());
+            return false;
+        }
+
+        int ready[2];
+        if (pipe(ready) != 0) {
+            return false;
+        }
+        std::vector<pid_t> children;
+        std::vector<int> resultFds;
+        for (int r = 0; r < readerCount; r++) {
+            int results[2];
+            if (pipe(results) != 0) {
+                return false;
+            }
+            const pid_t pid = fork();
+            if (pid == 0) {
+                ::close(ready[0]);
+                ::close(results[0]);
+                const ReaderResult result = runReader(name, options, ready[1]);
+                const ssize_t written = write(results[1], &result, sizeof(result));
+                _exit(written == static_cast<ssize_t>(sizeof(result)) ? 0 : 1);
+            }
+            ::close(results[1]);
+            children.push_back(pid);
+            resultFds.push_back(results[0]);
+        }
+        ::close(ready[1]);
+        for (int r = 0; r < readerCount; r++) {
+            char byte;
+            if (read(ready[0], &byte, 1) != 1) {
+                std::fprintf(stderr, "a reader failed to attach\n");
+                break;
+            }
+        }
+        ::close(ready[0]);
+
+        // Publish: a gray frame stamped with its number
+        FrameBuffer source(options.width, options.height);
+        const FrameView view = source.view();
+        for (int y = 0; y < view.height; y++) {
+            std::memset(view.row(y), 0x80, static_cast<size_t>(view.width) * 4);
+        }
+        using Clock = std::chrono::steady_clock;
+        const auto period = std::chrono::microseconds(options.fps > 0 ? 1000000 / options.fps : 0);
+        const Clock::time_point start = Clock::now();
+        Clock::time_point next = start;
+        for (int i = 0; i < options.frames; i++) {
+            const uint32_t stamp = static_cast<uint32_t>(i);
+            std::memcpy(view.data, &stamp, 4);
+            std::memcpy(view.row(view.height - 1) + (view.width - 1) * 4, &stamp, 4);
+            output.publish(view, SharedFrameRing::monotonicMicros());
+            if (options.fps > 0) {
+                next += period;
+                std::this_thread::sleep_until(next);
+            }
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        output.close();
+
+        std::printf("%d reader%s, %d frames in %.2f s (%.0f fps published)\n", readerCount, readerCount == 1 ? "" : "s",
+            options.frames, seconds, options.frames / seconds);
+        std::printf("%7s %8s %8s %6s %9s %9s %9s %9s\n", "reader", "frames", "skipped", "torn", "GB/s", "p50 us", "p99 us", "max us");
+        bool ok = true;
+        for (int r = 0; r < readerCount; r++) {
+            ReaderResult result;
+            const bool received = read(resultFds[r], &result, sizeof(result)) == static_cast<ssize_t>(sizeof(result));
+            ::close(resultFds[r]);
+            int status = 0;
+            waitpid(children[r], &status, 0);
+            if (!received || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                std::printf("%7d failed\n", r);
+                ok = false;
+                continue;
+            }
+            std::printf("%7d %8llu %8llu %6llu %9.2f %9lld %9lld %9lld\n", r,
+                static_cast<unsigned long long>(result.frames), static_cast<unsigned long long>(result.skipped),
+                static_cast<unsigned long long>(result.torn), result.seconds > 0.0 ? result.bytes / result.seconds / 1e9 : 0.0,
+                static_cast<long long>(result.p50Us), static_cast<long long>(result.p99Us), static_cast<long long>(result.maxUs));
+            if (result.frames == 0) {
+                std::printf("FAIL: reader %d received no whole frame\n", r);
+                ok = false;
+            }
+        }
+        std::printf("\n");
+        return ok;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    std::printf("shared memory ring: %dx%d BGRA, %d slots, readers %s\n\n", options.width, options.height, options.slots,
+        options.copy ? "copy each frame" : "read in place");
+    bool ok = true;
+    for (int readers : options.readerCounts) {
+        ok = runOnce(options, readers) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,508 @@
+// SIMD dispatch benchmark: runs every runtime-dispatched kernel on the same data with
+// setSimdLevel() capped at scalar, SSE2 and AVX2 in turn and reports the time of each
+// path. Outputs have to match the scalar run bit for bit, except for ChromaKey, HLG and
+// the dithered conversion, which get the tolerance noted next to them. Levels the CPU
+// (or the build) lacks are skipped. Exits non-zero when any path disagrees with the
+// scalar one.
+
+#include "incl/ChromaKey.h"
+#include "incl/Fft.h"
+#include "incl/FrameChangeDetector.h"
+#include "incl/HdrConverter.h"
+#include "incl/Lut3D.h"
+#include "incl/SampleConverter.h"
+#include "incl/SceneCompositor.h"
+#include "incl/Simd.h"
+#include "incl/VideoFilters.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        int width = 1920;
+        int height = 1080;
+        int samples = 480000;
+        int runs = 10;
+        uint32_t seed = 1;
+    };
+
+    const char* const kUsage =
+        "usage: obs-simd-bench [options]\n"
+        "  --size WxH    video frame size (default: 1920x1080)\n"
+        "  --samples N   audio samples per conversion (default: 480000)\n"
+        "  --runs N      timed runs per kernel and level, best one reported (default: 10)\n"
+        "  --seed N      random seed (default: 1)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--size") {
+                if (std::sscanf(value.c_str(), "%dx%d", &options.width, &options.height) != 2 ||
+                    options.width <= 0 || options.height <= 0) {
+                    return false;
+                }
+            }
+            else if (arg == "--samples") {
+                options.samples = std::atoi(value.c_str());
+            }
+            else if (arg == "--runs") {
+                options.runs = std::atoi(value.c_str());
+            }
+            else if (arg == "--seed") {
+                options.seed = static_cast<uint32_t>(std::atoi(value.c_str()));
+            }
+            else {
+                return false;
+            }
+        }
+        // Stereo interleave/deinterleave and the FFT blocks want an even sample count
+        return options.samples >= 8192 && options.samples % 2 == 0 && options.runs > 0;
+    }
+
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed) : m_state(seed ? seed : 1) {}
+
+        uint32_t next()
+        {
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 17;
+            m_state ^= m_state << 5;
+            return m_state;
+        }
+
+        // Uniform in [-1, 1)
+        float signedUnit() { return static_cast<float>(static_cast<int32_t>(next())) / 2147483648.0f; }
+
+    private:
+        uint32_t m_state;
+    };
+
+    // Everything the kernels read; built once so every level sees the same data
+    struct Inputs
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> bgra;    // straight alpha, random colors and alpha
+        std::vector<uint8_t> hdr10;   // random R10G10B10A2 words
+        std::vector<uint16_t> scRgb;  // halfs of both signs up to a few hundred nits
+        std::vector<float> audio;     // [-1.1, 1.1), so conversions clip now and then
+        std::vector<int16_t> s16;
+        std::vector<uint8_t> s24;
+        std::vector<int32_t> s32;
+        Lut3D lut;
+
+        void build(const Options& options)
+        {
+            Random random(options.seed);
+            width = options.width;
+            height = options.height;
+            const size_t pixels = static_cast<size_t>(width) * height;
+            bgra.resize(pixels * 4);
+            for (uint8_t& byte : bgra) {
+                byte = static_cast<uint8_t>(random.next() >> 24);
+            }
+            hdr10.resize(pixels * 4);
+            for (uint8_t& byte : hdr10) {
+                byte = static_cast<uint8_t>(random.next() >> 24);
+            }
+            scRgb.resize(pixels * 4);
+            for (uint16_t& half : scRgb) {
+                const uint32_t bits = random.next();
+                const uint32_t exponent = (bits >> 16) % 18; // up to 4.0, i.e. 320 nits
+                half = static_cast<uint16_t>((bits & 0x8000u) | exponent << 10 | (bits & 0x3FFu));
+            }
+
+            const size_t samples = static_cast<size_t>(options.samples);
+            audio.resize(samples);
+            s16.resize(samples);
+            s24.resize(samples * 3);
+            s32.resize(samples);
+            for (size_t i = 0; i < samples; i++) {
+                audio[i] = random.signedUnit() * 1.1f;
+                s16[i] = static_cast<int16_t>(random.next() >> 16);
+                s32[i] = static_cast<int32_t>(random.next());
+                const uint32_t word = random.next();
+                s24[i * 3 + 0] = static_cast<uint8_t>(word);
+                s24[i * 3 + 1] = static_cast<uint8_t>(word >> 8);
+                s24[i * 3 + 2] = static_cast<uint8_t>(word >> 16);
+            }
+
+            // A warm, slightly crushed grade, so the lookup isn't the identity
+            std::ostringstream cube;
+            constexpr int kLutSize = 17;
+            cube << "LUT_3D_SIZE " << kLutSize << "\n";
+            for (int b = 0; b < kLutSize; b++) {
+                for (int g = 0; g < kLutSize; g++) {
+                    for (int r = 0; r < kLutSize; r++) {
+                        const double scale = 1.0 / (kLutSize - 1);
+                        cube << std::pow(r * scale, 0.9) << ' ' << std::pow(g * scale, 1.05) << ' '
+                             << std::pow(b * scale, 1.2) * 0.95 << "\n";
+                    }
+                }
+            }
+            std::istringstream in(cube.str());
+            lut.parseCube(in);
+        }
+    };
+
+    // How a kernel's output is compared against the scalar run
+    enum class Element
+    {
+        U8,
+        S16,
+        S32,
+        F32,
+        U64,
+    };
+
+    // Runs the kernel once on fresh copies of the inputs, leaves its output in out and
+    // returns the milliseconds spent in the kernel itself
+    using KernelRun = double (*)(const Inputs& inputs, std::vector<uint8_t>& out);
+
+    struct Kernel
+    {
+        const char* name;
+        Element element;
+        double tolerance; // largest difference from the scalar output per element
+        KernelRun run;
+    };
+
+    double msSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    int pixelCount(const Inputs& inputs) { return inputs.width * inputs.height; }
+
+    int sampleCount(const Inputs& inputs) { return static_cast<int>(inputs.audio.size()); }
+
+    template <typename T>
+    void copyTo(const std::vector<T>& from, std::vector<uint8_t>& out)
+    {
+        out.resize(from.size() * sizeof(T));
+        std::memcpy(out.data(), from.data(), out.size());
+    }
+
+    // In-place BGRA filters run over a copy of the frame
+    template <typename Filter>
+    double runPixelFilter(const Inputs& inputs, std::vector<uint8_t>& out, const Filter& filter)
+    {
+        copyTo(inputs.bgra, out);
+        const Clock::time_point start = Clock::now();
+        filter.apply(out.data(), pixelCount(inputs));
+        return msSince(start);
+    }
+
+    double runCompose(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        const FrameView frame(const_cast<uint8_t*>(inputs.bgra.data()), inputs.width, inputs.height, inputs.width * 4);
+        SceneCompositor compositor;
+        compositor.setCanvasSize(inputs.width, inputs.height);
+
+        // Opaque base, a same-size straight-alpha overlay at 60% and a translucent fill:
+        // every canvas pixel goes through the blend rows
+        SceneLayer base;
+        base.source = frame;
+        base.opaque = true;
+        base.dest = { 0, 0, inputs.width, inputs.height };
+        compositor.addLayer(base);
+        SceneLayer overlay;
+        overlay.source = frame;
+        overlay.premultiplied = false;
+        overlay.opacity = 0.6f;
+        overlay.dest = { 0, 0, inputs.width, inputs.height };
+        compositor.addLayer(overlay);
+        SceneLayer solid;
+        solid.kind = SceneLayer::Kind::SolidColor;
+        solid.color = 0x80204060;
+        solid.dest = { 0, 0, inputs.width, inputs.height };
+        compositor.addLayer(solid);
+
+        const Clock::time_point start = Clock::now();
+        compositor.compose();
+        const double ms = msSince(start);
+
+        const FrameView canvas = compositor.canvas();
+        out.resize(static_cast<size_t>(inputs.width) * inputs.height * 4);
+        for (int y = 0; y < canvas.height; y++) {
+            std::memcpy(out.data() + static_cast<size_t>(y) * inputs.width * 4, canvas.row(y), static_cast<size_t>(inputs.width) * 4);
+        }
+        return ms;
+    }
+
+    double runTileHash(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        const FrameView frame(const_cast<uint8_t*>(inputs.bgra.data()), inputs.width, inputs.height, inputs.width * 4);
+        const int tile = FrameChangeDetector::kTileSize;
+        std::vector<uint64_t> hashes;
+        hashes.reserve(static_cast<size_t>((inputs.width + tile - 1) / tile) * ((inputs.height + tile - 1) / tile));
+
+        const Clock::time_point start = Clock::now();
+        for (int y = 0; y < inputs.height; y += tile) {
+            for (int x = 0; x < inputs.width; x += tile) {
+                hashes.push_back(FrameChangeDetector::hashTile(frame, x, y, std::min(tile, inputs.width - x), std::min(tile, inputs.height - y)));
+            }
+        }
+        const double ms = msSince(start);
+        copyTo(hashes, out);
+        return ms;
+    }
+
+    double runForceOpaque(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        return runPixelFilter(inputs, out, ForceOpaque());
+    }
+
+    double runLut3D(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        return runPixelFilter(inputs, out, inputs.lut);
+    }
+
+    double runChromaKey(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        // The kernel is picked at construction, so build it under the current level
+        return runPixelFilter(inputs, out, ChromaKey());
+    }
+
+    double runChromaKeyHsv(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        ChromaKey::Settings settings;
+        settings.space = ChromaKey::Space::Hsv;
+        return runPixelFilter(inputs, out, ChromaKey(settings));
+    }
+
+    template <typename Src, typename Dst>
+    double runConversion(const std::vector<Src>& src, SampleFormat srcFormat, bool srcPlanar, SampleFormat dstFormat,
+        bool dstPlanar, int channels, size_t samples, std::vector<uint8_t>& out)
+    {
+        SampleConverter converter;
+        converter.configure(srcFormat, srcPlanar, dstFormat, dstPlanar, channels);
+        std::vector<Dst> dst(samples * bytesPerSample(dstFormat) / sizeof(Dst));
+        const int frames = static_cast<int>(samples) / channels;
+
+        // Planar layouts get one pointer per channel into the same buffer
+        const void* srcPlanes[SampleConverter::kMaxChannels];
+        void* dstPlanes[SampleConverter::kMaxChannels];
+        const size_t srcPlane = static_cast<size_t>(frames) * bytesPerSample(srcFormat);
+        const size_t dstPlane = static_cast<size_t>(frames) * bytesPerSample(dstFormat);
+        for (int c = 0; c < channels; c++) {
+            srcPlanes[c] = reinterpret_cast<const uint8_t*>(src.data()) + (srcPlanar ? c * srcPlane : 0);
+            dstPlanes[c] = reinterpret_cast<uint8_t*>(dst.data()) + (dstPlanar ? c * dstPlane : 0);
+        }
+
+        const Clock::time_point start = Clock::now();
+        converter.convert(srcPlanes, dstPlanes, frames);
+        const double ms = msSince(start);
+        copyTo(dst, out);
+        return ms;
+    }
+
+    double runS16ToF32(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        return runConversion<int16_t, float>(inputs.s16, SampleFormat::S16, false, SampleFormat::F32, false, 2, inputs.s16.size(), out);
+    }
+
+    double runS24ToF32(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        return runConversion<uint8_t, float>(inputs.s24, SampleFormat::S24, false, SampleFormat::F32, false, 2, inputs.s32.size(), out);
+    }
+
+    double runS32ToF32(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        return runConversion<int32_t, float>(inputs.s32, SampleFormat::S32, false, SampleFormat::F32, false, 2, inputs.s32.size(), out);
+    }
+
+    double runF32ToS32(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        return runConversion<float, int32_t>(inputs.audio, SampleFormat::F32, false, SampleFormat::S32, false, 2, inputs.audio.size(), out);
+    }
+
+    double runF32ToS16(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        return runConversion<float, int16_t>(inputs.audio, SampleFormat::F32, false, SampleFormat::S16, false, 2, inputs.audio.size(), out);
+    }
+
+    double runDeinterleave(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        return runConversion<float, float>(inputs.audio, SampleFormat::F32, false, SampleFormat::F32, true, 2, inputs.audio.size(), out);
+    }
+
+    double runInterleave(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        return runConversion<float, float>(inputs.audio, SampleFormat::F32, true, SampleFormat::F32, false, 2, inputs.audio.size(), out);
+    }
+
+    double runFft(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        constexpr int kSize = 4096;
+        RealFft fft;
+        fft.configure(kSize);
+        const int blocks = sampleCount(inputs) / kSize;
+        std::vector<float> spectrum(static_cast<size_t>(blocks) * fft.bins() * 2);
+
+        const Clock::time_point start = Clock::now();
+        for (int i = 0; i < blocks; i++) {
+            float* re = spectrum.data() + static_cast<size_t>(i) * fft.bins() * 2;
+            fft.forward(inputs.audio.data() + static_cast<size_t>(i) * kSize, re, re + fft.bins());
+        }
+        const double ms = msSince(start);
+        copyTo(spectrum, out);
+        return ms;
+    }
+
+    template <HdrFormat Format>
+    double runHdrToSdr(const Inputs& inputs, std::vector<uint8_t>& out)
+    {
+        // HLG has the same packing as HDR10, so both read the 10-bit frame
+        const bool packed = Format != HdrFormat::ScRgb16F;
+        const uint8_t* data = packed ? inputs.hdr10.data() : reinterpret_cast<const uint8_t*>(inputs.scRgb.data());
+        const int stride = inputs.width * (packed ? 4 : 8);
+        const HdrView src(data, inputs.width, inputs.height, stride, Format);
+        HdrConverter::Settings settings;
+        settings.peakNits = 1000.0f;
+        const HdrConverter converter(settings);
+        out.resize(static_cast<size_t>(inputs.width) * inputs.height * 4);
+        const FrameView dst(out.data(), inputs.width, inputs.height, inputs.width * 4);
+
+        const Clock::time_point start = Clock::now();
+        converter.toSdr(src, dst);
+        return msSince(start);
+    }
+
+    // Largest per-element difference between two outputs of the same kernel
+    double maxDifference(Element element, const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+    {
+        double worst = 0.0;
+        auto scan = [&](auto tag) {
+            using T = decltype(tag);
+            const size_t count = a.size() / sizeof(T);
+            for (size_t i = 0; i < count; i++) {
+                T x;
+                T y;
+                std::memcpy(&x, a.data() + i * sizeof(T), sizeof(T));
+                std::memcpy(&y, b.data() + i * sizeof(T), sizeof(T));
+                if (x != y) {
+                    // Hashes only count as equal or not
+                    const double d = sizeof(T) == 8 ? INFINITY : std::fabs(static_cast<double>(x) - static_cast<double>(y));
+                    worst = std::max(worst, std::isnan(d) ? INFINITY : d);
+                }
+            }
+        };
+        switch (element) {
+        case Element::U8: scan(uint8_t()); break;
+        case Element::S16: scan(int16_t()); break;
+        case Element::S32: scan(int32_t()); break;
+        case Element::F32: scan(float()); break;
+        case Element::U64: scan(uint64_t()); break;
+        }
+        return a.size() == b.size() ? worst : INFINITY;
+    }
+
+    const char* levelName(SimdLevel level)
+    {
+        switch (level) {
+        case SimdLevel::Scalar: return "scalar";
+        case SimdLevel::Sse2: return "sse2";
+        case SimdLevel::Avx2: return "avx2";
+        }
+        return "?";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    // Two kernels don't promise bit-exact agreement: the f32 -> s16 TPDF dither (up to
+    // one LSB either way) draws its noise in a different order per path, so two paths
+    // may land two steps apart, and ChromaKey rounds through cvtps instead of lround.
+    const Kernel kernels[] = {
+        { "compose", Element::U8, 0.0, runCompose },
+        { "tile hash", Element::U64, 0.0, runTileHash },
+        { "force opaque", Element::U8, 0.0, runForceOpaque },
+        { "lut3d", Element::U8, 0.0, runLut3D },
+        { "chroma key", Element::U8, 1.0, runChromaKey },
+        { "chroma key hsv", Element::U8, 1.0, runChromaKeyHsv },
+        { "s16 -> f32", Element::F32, 0.0, runS16ToF32 },
+        { "s24 -> f32", Element::F32, 0.0, runS24ToF32 },
+        { "s32 -> f32", Element::F32, 0.0, runS32ToF32 },
+        { "f32 -> s32", Element::S32, 0.0, runF32ToS32 },
+        { "f32 -> s16", Element::S16, 2.0, runF32ToS16 },
+        { "deinterleave", Element::F32, 0.0, runDeinterleave },
+        { "interleave", Element::F32, 0.0, runInterleave },
+        { "fft 4096", Element::F32, 0.0, runFft },
+        { "hdr10 -> sdr", Element::U8, 0.0, runHdrToSdr<HdrFormat::Hdr10> },
+        { "hlg -> sdr", Element::U8, 1.0, runHdrToSdr<HdrFormat::Hlg10> }, // the fused BT.2020 -> BT.709 matrix rounds differently
+        { "scrgb -> sdr", Element::U8, 0.0, runHdrToSdr<HdrFormat::ScRgb16F> },
+    };
+
+    Inputs inputs;
+    inputs.build(options);
+
+    std::vector<SimdLevel> levels{ SimdLevel::Scalar };
+    setSimdLevel(SimdLevel::Sse2);
+    if (useSse2()) {
+        levels.push_back(SimdLevel::Sse2);
+    }
+    setSimdLevel(SimdLevel::Avx2);
+    if (useAvx2()) {
+        levels.push_back(SimdLevel::Avx2);
+    }
+
+    std::printf("%dx%d frames, %d audio samples, best of %d runs\n", options.width, options.height, options.samples, options.runs);
+    std::printf("%-15s", "kernel");
+    for (SimdLevel level : levels) {
+        std::printf(" %9s ms", levelName(level));
+    }
+    std::printf(" %9s\n", "max diff");
+
+    bool ok = true;
+    std::vector<uint8_t> reference;
+    std::vector<uint8_t> output;
+    for (const Kernel& kernel : kernels) {
+        std::printf("%-15s", kernel.name);
+        double worst = 0.0;
+        for (SimdLevel level : levels) {
+            setSimdLevel(level);
+            double best = INFINITY;
+            for (int run = 0; run < options.runs; run++) {
+                best = std::min(best, kernel.run(inputs, level == SimdLevel::Scalar ? reference : output));
+            }
+            std::printf(" %12.2f", best);
+            if (level != SimdLevel::Scalar) {
+                const double difference = maxDifference(kernel.element, reference, output);
+                worst = std::max(worst, difference);
+                if (difference > kernel.tolerance) {
+                    ok = false;
+                }
+            }
+        }
+        std::printf(" %9g\n", worst);
+        if (worst > kernel.tolerance) {
+            std::printf("FAIL: %s: SIMD output differs from scalar by %g (allowed %g)\n", kernel.name, worst, kernel.tolerance);
+        }
+    }
+    setSimdLevel(SimdLevel::Avx2);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,369 @@
+// Startup benchmark: brings up a video source and two audio devices with artificial
+// init delays, the way the GUI used to (one after another on the UI thread, giving up
+// on everything when the screen fails) and through StartupSequencer, and reports how
+// long the UI was blocked and when each source became usable. Exits non-zero when
+// parallel startup doesn't finish in about the slowest phase, or when a failing
+// backend keeps the others from coming up.
+
+#include "incl/StartupSequencer.h"
+#include "incl/SyntheticAudioSource.h"
+#include "incl/SyntheticSource.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    enum Backend
+    {
+        BackendVideo,
+        BackendMic,
+        BackendDesktop,
+        BackendCount
+    };
+
+    const char* const kBackendNames[BackendCount] = { "video", "mic", "desktop" };
+
+    struct Options
+    {
+        int delayMs[BackendCount] = { 400, 150, 150 }; // D3D device + duplication, WASAPI x2
+        int width = 1280;
+        int height = 720;
+        int runs = 3;
+        std::vector<unsigned> scenarios{ 0, 1u << BackendVideo }; // bitmask of failing backends
+    };
+
+    const char* const kUsage =
+        "usage: obs-startup-bench [options]\n"
+        "  --video-delay MS    video source init time (default: 400)\n"
+        "  --mic-delay MS      mic init time (default: 150)\n"
+        "  --desktop-delay MS  desktop audio init time (default: 150)\n"
+        "  --fail LIST         backends whose init fails, e.g. video,mic; \"none\" for none\n"
+        "                      (default: one run with none, one with video)\n"
+        "  --size WxH          synthetic video size (default: 1280x720)\n"
+        "  --runs N            runs per strategy, the fastest is reported (default: 3)\n";
+
+    bool parseFailList(const std::string& value, unsigned& mask)
+    {
+        mask = 0;
+        if (value == "none") {
+            return true;
+        }
+        for (size_t begin = 0; begin < value.size();) {
+            const size_t comma = std::min(value.find(',', begin), value.size());
+            const std::string name = value.substr(begin, comma - begin);
+            const auto found = std::find_if(std::begin(kBackendNames), std::end(kBackendNames),
+                [&](const char* backend) { return name == backend; });
+            if (found == std::end(kBackendNames)) {
+                return false;
+            }
+            mask |= 1u << (found - std::begin(kBackendNames));
+            begin = comma + 1;
+        }
+        return true;
+    }
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--video-delay" || arg == "--mic-delay" || arg == "--desktop-delay") {
+                const Backend backend = arg == "--video-delay" ? BackendVideo : arg == "--mic-delay" ? BackendMic : BackendDesktop;
+                options.delayMs[backend] = std::atoi(value.c_str());
+                if (options.delayMs[backend] < 0) {
+                    return false;
+                }
+            }
+            else if (arg == "--fail") {
+                unsigned mask;
+                if (!parseFailList(value, mask)) {
+                    return false;
+                }
+                options.scenarios = { mask };
+            }
+            else if (arg == "--size") {
+                if (std::sscanf(value.c_str(), "%dx%d", &options.width, &options.height) != 2 ||
+                    options.width <= 0 || options.height <= 0) {
+                    return false;
+                }
+            }
+            else if (arg == "--runs") {
+                options.runs = std::atoi(value.c_str());
+            }
+            else {
+                return false;
+            }
+        }
+        return options.runs > 0;
+    }
+
+    // A video source whose initialize() takes as long as a real device's and may fail
+    class DelayedSource : public VideoSource
+    {
+    public:
+        DelayedSource(std::unique_ptr<VideoSource> inner, int delayMs, bool fail)
+            : m_inner(std::move(inner)), m_delayMs(delayMs), m_fail(fail)
+        {
+        }
+
+        const char* name() const override { return m_inner->name(); }
+
+        bool initialize() override
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(m_delayMs));
+            if (m_fail) {
+                m_error = "injected failure";
+                return false;
+            }
+            if (!m_inner->initialize()) {
+                m_error = m_inner->lastError();
+                return false;
+            }
+            return true;
+        }
+
+        bool acquireFrame(SourceFrame& frame) override { return m_inner->acquireFrame(frame); }
+
+    private:
+        std::unique_ptr<VideoSource> m_inner;
+        int m_delayMs;
+        bool m_fail;
+    };
+
+    // The audio side: a device that takes its time to open, then delivers one packet
+    struct DelayedAudio
+    {
+        SyntheticAudioSource source;
+        std::vector<uint8_t> packet;
+        int delayMs = 0;
+        bool fail = false;
+
+        bool initialize(std::string& error)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+            if (fail) {
+                error = "injected failure";
+                return false;
+            }
+            if (!source.configure(SyntheticAudioSource::Settings())) {
+                error = "bad audio settings";
+                return false;
+            }
+            packet.assign(static_cast<size_t>(480) * source.bytesPerFrame(), 0);
+            source.generate(packet.data(), 480);
+            return true;
+        }
+    };
+
+    // What a strategy achieved, in ms since it started; -1 = never
+    struct Result
+    {
+        double uiBlockedMs = 0.0;
+        double firstFrameMs = -1.0;
+        double audioReadyMs = -1.0; // first audio device delivering
+        double allReadyMs = -1.0;   // every backend that was going to come up did
+        int up = 0;
+    };
+
+    enum Strategy
+    {
+        SerialOnUiThread,
+        SerialBackground,
+        Parallel,
+        StrategyCount
+    };
+
+    const char* const kStrategyNames[StrategyCount] = { "serial, UI thread", "serial, background", "parallel" };
+
+    double msSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    Result runStrategy(Strategy strategy, const Options& options, unsigned failing)
+    {
+        SyntheticSource::Settings settings;
+        settings.width = options.width;
+        settings.height = options.height;
+        DelayedSource video(std::make_unique<SyntheticSource>(settings), options.delayMs[BackendVideo],
+            (failing & (1u << BackendVideo)) != 0);
+        DelayedAudio audio[2];
+        for (int i = 0; i < 2; i++) {
+            audio[i].delayMs = options.delayMs[BackendMic + i];
+            audio[i].fail = (failing & (1u << (BackendMic + i))) != 0;
+        }
+
+        Result result;
+        std::atomic<int> up{ 0 };
+        std::atomic<int64_t> firstFrameUs{ -1 };
+        std::atomic<int64_t> audioReadyUs{ -1 };
+        const Clock::time_point start = Clock::now();
+        auto stamp = [&](std::atomic<int64_t>& at) {
+            int64_t expected = -1;
+            at.compare_exchange_strong(expected, std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+        };
+        auto videoUp = [&] {
+            SourceFrame frame;
+            if (video.acquireFrame(frame)) {
+                stamp(firstFrameUs);
+            }
+            up++;
+        };
+        auto audioUp = [&] {
+            stamp(audioReadyUs);
+            up++;
+        };
+
+        if (strategy == SerialOnUiThread) {
+            // What the MainWindow constructor did before the window could appear
+            if (video.initialize()) {
+                videoUp();
+                std::string error;
+                if (audio[0].initialize(error) && audio[1].initialize(error)) {
+                    audioUp();
+                    audioUp();
+                }
+            }
+            result.uiBlockedMs = msSince(start);
+            result.allReadyMs = result.uiBlockedMs;
+        }
+        else {
+            StartupSequencer startup;
+            startup.add("video", [&](std::string& error) {
+                if (!video.initialize()) {
+                    error = video.lastError();
+                    return false;
+                }
+                return true;
+            }, [&](const StartupSequencer::Phase& phase) {
+                if (phase.ok) {
+                    videoUp();
+                }
+            });
+            for (int i = 0; i < 2; i++) {
+                startup.add(kBackendNames[BackendMic + i], [&audio, i](std::string& error) { return audio[i].initialize(error); },
+                    [&](const StartupSequencer::Phase& phase) {
+                        if (phase.ok) {
+                            audioUp();
+                        }
+                    });
+            }
+            startup.start(strategy == Parallel);
+            result.uiBlockedMs = msSince(start);
+
+            // The UI thread keeps running its event loop meanwhile
+            while (!startup.waitFor(std::chrono::milliseconds(16))) {
+            }
+            result.allReadyMs = startup.elapsedMicros() / 1000.0;
+        }
+
+        result.up = up.load();
+        result.firstFrameMs = firstFrameUs.load() < 0 ? -1.0 : firstFrameUs.load() / 1000.0;
+        result.audioReadyMs = audioReadyUs.load() < 0 ? -1.0 : audioReadyUs.load() / 1000.0;
+        return result;
+    }
+
+    void printMs(double ms)
+    {
+        if (ms < 0.0) {
+            std::printf(" %11s", "never");
+        }
+        else {
+            std::printf(" %8.1f ms", ms);
+        }
+    }
+
+    // Fastest of the runs, per column
+    Result best(const std::vector<Result>& runs)
+    {
+        auto pick = [](double a, double b) { return a < 0.0 ? b : b < 0.0 ? a : std::min(a, b); };
+        Result result = runs.front();
+        for (const Result& run : runs) {
+            result.uiBlockedMs = std::min(result.uiBlockedMs, run.uiBlockedMs);
+            result.firstFrameMs = pick(result.firstFrameMs, run.firstFrameMs);
+            result.audioReadyMs = pick(result.audioReadyMs, run.audioReadyMs);
+            result.allReadyMs = pick(result.allReadyMs, run.allReadyMs);
+            result.up = std::max(result.up, run.up);
+        }
+        return result;
+    }
+
+    bool runScenario(const Options& options, unsigned failing)
+    {
+        std::string failed;
+        for (int b = 0; b < BackendCount; b++) {
+            if (failing & (1u << b)) {
+                failed += failed.empty() ? kBackendNames[b] : std::string(", ") + kBackendNames[b];
+            }
+        }
+        std::printf("video %d ms, mic %d ms, desktop %d ms; failing: %s\n", options.delayMs[BackendVideo],
+            options.delayMs[BackendMic], options.delayMs[BackendDesktop], failed.empty() ? "none" : failed.c_str());
+        std::printf("%-20s %11s %11s %11s %11s %4s\n", "strategy", "UI blocked", "1st frame", "audio", "all ready", "up");
+
+        Result results[StrategyCount];
+        for (int s = 0; s < StrategyCount; s++) {
+            std::vector<Result> runs;
+            for (int r = 0; r < options.runs; r++) {
+                runs.push_back(runStrategy(static_cast<Strategy>(s), options, failing));
+            }
+            results[s] = best(runs);
+            std::printf("%-20s", kStrategyNames[s]);
+            printMs(results[s].uiBlockedMs);
+            printMs(results[s].firstFrameMs);
+            printMs(results[s].audioReadyMs);
+            printMs(results[s].allReadyMs);
+            std::printf(" %2d/%d\n", results[s].up, BackendCount);
+        }
+        std::printf("\n");
+
+        // Parallel: the UI is never held up, everything that can start does, and it is
+        // done in about the slowest phase rather than the sum
+        const Result& parallel = results[Parallel];
+        int expectedUp = 0;
+        int slowestMs = 0;
+        for (int b = 0; b < BackendCount; b++) {
+            expectedUp += (failing & (1u << b)) ? 0 : 1;
+            slowestMs = std::max(slowestMs, options.delayMs[b]);
+        }
+        bool ok = true;
+        if (parallel.uiBlockedMs > 5.0) {
+            std::printf("FAIL: parallel startup blocked the UI thread for %.1f ms\n", parallel.uiBlockedMs);
+            ok = false;
+        }
+        if (parallel.up != expectedUp) {
+            std::printf("FAIL: %d of %d working backends came up\n", parallel.up, expectedUp);
+            ok = false;
+        }
+        if (parallel.allReadyMs > slowestMs * 1.2 + 30.0) {
+            std::printf("FAIL: parallel startup took %.1f ms, slowest phase is %d ms\n", parallel.allReadyMs, slowestMs);
+            ok = false;
+        }
+        return ok;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    bool ok = true;
+    for (unsigned failing : options.scenarios) {
+        ok = runScenario(options, failing) && ok;
+    }
+    return ok ? 0 : 1;
+}
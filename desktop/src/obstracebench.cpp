@@ -0,0 +1,268 @@
+// Tracer overhead on the capture pipeline: SyntheticSource frames go through compose
+// and a two-rendition ScalerPyramid on a ThreadPool, in alternating blocks with the
+// tracer off and on, and the per-frame times are compared. That difference is noisy,
+// so the check is built from parts that aren't: the events a frame records (counted in
+// a writeJson export) times the measured cost of one event, against the 16.7 ms of a
+// 4K60 frame. Also starts and ends short-lived threads that record, and checks they
+// reuse one ring instead of keeping one each. Exits non-zero when the modelled
+// overhead reaches 1% or exited threads' rings aren't reused.
+
+#include "incl/SceneCompositor.h"
+#include "incl/ScalerPyramid.h"
+#include "incl/SyntheticSource.h"
+#include "incl/ThreadPool.h"
+#include "incl/Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr double kFrameBudgetMs = 1000.0 / 60.0;
+    constexpr double kMaxOverheadPercent = 1.0;
+    constexpr int kEventPairs = 1000000;
+    constexpr int kShortThreads = 32;
+
+    struct Options
+    {
+        int width = 3840;
+        int height = 2160;
+        int frames = 60;
+        int rounds = 4;
+        int threads = 0;
+    };
+
+    const char* const kUsage =
+        "usage: obs-trace-bench [options]\n"
+        "  --size WxH    synthetic desktop size (default: 3840x2160)\n"
+        "  --frames N    frames per timed block (default: 60)\n"
+        "  --rounds N    off/on block pairs (default: 4)\n"
+        "  --threads N   pool threads (default: one per core)\n";
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            const std::string value = argv[++i];
+            if (arg == "--size") {
+                if (std::sscanf(value.c_str(), "%dx%d", &options.width, &options.height) != 2) {
+                    return false;
+                }
+            }
+            else if (arg == "--frames") {
+                options.frames = std::atoi(value.c_str());
+            }
+            else if (arg == "--rounds") {
+                options.rounds = std::atoi(value.c_str());
+            }
+            else if (arg == "--threads") {
+                options.threads = std::atoi(value.c_str());
+            }
+            else {
+                return false;
+            }
+        }
+        return options.width >= 64 && options.height >= 64 && options.frames > 0 && options.rounds > 0 &&
+            options.threads >= 0;
+    }
+
+    SyntheticSource::Settings sourceSettings(const Options& options)
+    {
+        SyntheticSource::Settings settings;
+        settings.width = options.width;
+        settings.height = options.height;
+        std::string error;
+        SyntheticSource::parseScript("typing:60,drag:60,scroll:60,cursor:60", settings.script, error);
+        return settings;
+    }
+
+    // Capture, compose and scale, the instrumented part of HeadlessPipeline's frame
+    class FramePath
+    {
+    public:
+        FramePath(const Options& options, ThreadPool& pool) : m_pool(pool), m_source(sourceSettings(options))
+        {
+            m_ok = m_source.initialize() &&
+                m_pyramid.configure(options.width, options.height, { { (options.width / 2) & ~1, (options.height / 2) & ~1 },
+                    { (options.width / 3) & ~1, (options.height / 3) & ~1 } });
+        }
+
+        bool ok() const { return m_ok; }
+
+        bool process()
+        {
+            TraceScope trace("frame");
+            if (!m_source.acquireFrame(m_frame)) {
+                return false;
+            }
+            const FrameView& pixels = m_frame.pixels;
+            SceneLayer layer;
+            layer.source = pixels;
+            layer.opaque = true;
+            layer.dest = SceneRect{ 0, 0, pixels.width, pixels.height };
+            m_scene.setCanvasSize(pixels.width, pixels.height);
+            if (m_captureLayerId == 0) {
+                m_captureLayerId = m_scene.addLayer(layer);
+            }
+            else {
+                m_scene.setLayer(m_captureLayerId, layer);
+                m_scene.markContentChanged(m_captureLayerId);
+            }
+            m_scene.compose(&m_pool);
+            m_pyramid.process(m_scene.canvas(), &m_pool, m_frame.changes);
+            return true;
+        }
+
+    private:
+        ThreadPool& m_pool;
+        SyntheticSource m_source;
+        SourceFrame m_frame;
+        SceneCompositor m_scene;
+        int m_captureLayerId = 0;
+        ScalerPyramid m_pyramid;
+        bool m_ok = false;
+    };
+
+    size_t countOf(const std::string& text, const char* needle)
+    {
+        size_t count = 0;
+        for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)) {
+            count++;
+        }
+        return count;
+    }
+
+    // Exports the trace and counts recorded events and thread rings in it
+    bool exportCounts(const std::filesystem::path& path, size_t& events, size_t& threads)
+    {
+        if (!Tracer::instance().writeJson(path)) {
+            return false;
+        }
+        std::ifstream file(path, std::ios::binary);
+        const std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        events = countOf(json, "\"ph\":\"B\"") + countOf(json, "\"ph\":\"E\"") + countOf(json, "\"ph\":\"C\"");
+        threads = countOf(json, "\"thread_name\"");
+        return true;
+    }
+
+    // Nanoseconds per event for begin/end pairs on the calling thread, best of three
+    double nsPerEvent()
+    {
+        double best = 1e30;
+        for (int run = 0; run < 3; run++) {
+            const Clock::time_point start = Clock::now();
+            for (int i = 0; i < kEventPairs; i++) {
+                TraceScope trace("bench");
+            }
+            const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            best = std::min(best, ns / (2.0 * kEventPairs));
+        }
+        return best;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        std::fputs(kUsage, stderr);
+        return 2;
+    }
+
+    ThreadPool pool(options.threads);
+    FramePath path(options, pool);
+    if (!path.ok()) {
+        std::puts("FAIL: frame path did not initialize");
+        return 1;
+    }
+    for (int i = 0; i < options.frames; i++) {
+        path.process();
+    }
+
+    // Alternating blocks, so both modes see the same mix of workloads
+    double seconds[2] = {};
+    for (int round = 0; round < options.rounds; round++) {
+        for (int traced = 0; traced < 2; traced++) {
+            Tracer::instance().setEnabled(traced != 0);
+            const Clock::time_point start = Clock::now();
+            for (int i = 0; i < options.frames; i++) {
+                if (!path.process()) {
+                    std::puts("FAIL: SyntheticSource returned no frame");
+                    return 1;
+                }
+            }
+            seconds[traced] += std::chrono::duration<double>(Clock::now() - start).count();
+        }
+    }
+    Tracer::instance().setEnabled(false);
+    const int timedFrames = options.frames * options.rounds;
+    const double offMs = seconds[0] * 1000.0 / timedFrames;
+    const double onMs = seconds[1] * 1000.0 / timedFrames;
+    std::printf("%dx%d on %d threads: %.3f ms/frame tracer off, %.3f ms/frame on (%+.2f%%, noisy)\n", options.width,
+        options.height, pool.threadCount(), offMs, onMs, (onMs - offMs) / offMs * 100.0);
+
+    const std::filesystem::path json = std::filesystem::temp_directory_path() / "obs-trace-bench.json";
+    size_t events = 0;
+    size_t threads = 0;
+    Tracer::instance().clear();
+    Tracer::instance().setEnabled(true);
+    for (int i = 0; i < options.frames; i++) {
+        path.process();
+    }
+    Tracer::instance().setEnabled(false);
+    if (!exportCounts(json, events, threads)) {
+        std::printf("FAIL: cannot write %s\n", json.string().c_str());
+        return 1;
+    }
+    const double eventsPerFrame = static_cast<double>(events) / options.frames;
+
+    Tracer::instance().setEnabled(true);
+    const double enabledNs = nsPerEvent();
+    Tracer::instance().setEnabled(false);
+    const double disabledNs = nsPerEvent();
+    const double overhead = eventsPerFrame * enabledNs / (kFrameBudgetMs * 1e6) * 100.0;
+    std::printf("%.1f events per frame, %.1f ns per event on, %.2f ns per scope off\n", eventsPerFrame, enabledNs,
+        disabledNs * 2.0);
+    std::printf("modelled overhead: %.4f%% of a %.1f ms 4K60 frame, %.4f%% of this run's frame\n", overhead,
+        kFrameBudgetMs, eventsPerFrame * enabledNs / (offMs * 1e6) * 100.0);
+
+    bool ok = true;
+    if (events == 0) {
+        std::puts("FAIL: the traced frames recorded no events");
+        ok = false;
+    }
+    if (overhead >= kMaxOverheadPercent) {
+        std::printf("FAIL: tracing costs %.3f%% of a 4K60 frame, limit %.1f%%\n", overhead, kMaxOverheadPercent);
+        ok = false;
+    }
+
+    // Each short thread records once and exits; all but the first should get a used ring
+    Tracer::instance().setEnabled(true);
+    for (int i = 0; i < kShortThreads; i++) {
+        std::thread([] { TraceScope trace("short thread"); }).join();
+    }
+    Tracer::instance().setEnabled(false);
+    size_t threadsAfter = 0;
+    if (!exportCounts(json, events, threadsAfter)) {
+        std::printf("FAIL: cannot write %s\n", json.string().c_str());
+        return 1;
+    }
+    std::printf("%d short-lived threads added %zu rings\n", kShortThreads, threadsAfter - threads);
+    if (threadsAfter - threads > 1) {
+        std::printf("FAIL: exited threads' rings were not reused\n");
+        ok = false;
+    }
+    std::error_code ignored;
+    std::filesystem::remove(json, ignored);
+    return ok ? 0 : 1;
+}